@@ -52,3 +52,18 @@ elseif(UNIX)
         list(APPEND DEFAULT_COMPILE_DEFINITIONS KY_PLATFORM_LINUX)
     endif()
 endif()
+
+# Kryos configuration definitions
+# ------------------------------------------------------------------------------
+if(DEFINED KY_ERROR_MIN_LEVEL)
+    list(APPEND DEFAULT_COMPILE_DEFINITIONS KY_ERROR_MIN_LEVEL=KY_ERROR_LEVEL_${KY_ERROR_MIN_LEVEL})
+endif()
+if(DEFINED KY_ENABLE_PROFILER AND NOT KY_ENABLE_PROFILER)
+    list(APPEND DEFAULT_COMPILE_DEFINITIONS KY_PROFILER_ENABLED=0)
+endif()
+if(DEFINED KY_ENABLE_MEMORY_TRACKING AND NOT KY_ENABLE_MEMORY_TRACKING)
+    list(APPEND DEFAULT_COMPILE_DEFINITIONS KY_MEMORY_TRACKING_ENABLED=0)
+endif()
+if(KY_ENABLE_VULKAN_BACKEND)
+    list(APPEND DEFAULT_COMPILE_DEFINITIONS KY_RHI_VULKAN_ENABLED=1)
+endif()
@@ -0,0 +1,147 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "assets/asset_pack.h"
+#include "bench.h"
+#include "core/compression.h"
+#include "core/error.h"
+#include "core/jobs.h"
+#include "core/time.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ky {
+
+// Text like data so LZ4 has something to find, roughly matching cooked shaders and configs
+static void fill_asset(std::vector<uint8_t>& data, std::mt19937& rng) {
+    static constexpr const char* WORDS[] = {
+            "vec4 ",   "uniform ", "float ", "return ", "layout ", "material ",
+            "normal ", "texture ", "mesh ",  "= ",      "; ",      "\n",
+    };
+    size_t offset = 0;
+    while (offset < data.size()) {
+        const char* word = WORDS[rng() % (sizeof(WORDS) / sizeof(WORDS[0]))];
+        for (; *word != '\0' && offset < data.size(); word++) {
+            data[offset++] = (uint8_t)*word;
+        }
+    }
+}
+
+// 10k small assets cooked into one pack, compared against opening the same assets as loose files
+KY_BENCHMARK(asset_pack) {
+    constexpr size_t ASSETS = 10000;
+    constexpr size_t LARGE_SIZE = 64 * 1024 * 1024;
+
+    error::init();
+    {
+        JobSystem job_system;
+        JobSystem::init(job_system, (int32_t)std::thread::hardware_concurrency() - 1);
+        std::filesystem::path directory =
+                std::filesystem::temp_directory_path() / "kryos_asset_pack_bench";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory / "loose");
+        std::string pack_path = (directory / "assets.kypk").string();
+
+        std::mt19937 rng(7);
+        std::vector<std::string> names(ASSETS);
+        std::vector<uint8_t> data;
+        size_t total_size = 0;
+        {
+            AssetPackWriter writer;
+            writer.open(pack_path.c_str());
+            for (size_t i = 0; i < ASSETS; i++) {
+                names[i] = "loose/asset_" + std::to_string(i) + ".txt";
+                data.resize(512 + rng() % 8192);
+                fill_asset(data, rng);
+                total_size += data.size();
+                writer.add(names[i], data.data(), data.size());
+                std::FILE* file = std::fopen((directory / names[i]).string().c_str(), "wb");
+                std::fwrite(data.data(), 1, data.size(), file);
+                std::fclose(file);
+            }
+            data.resize(LARGE_SIZE);
+            fill_asset(data, rng);
+            writer.add("large.bin", data.data(), data.size());
+            writer.finish();
+        }
+
+        AssetPack pack;
+        double open_ns = bench::measure_ns(20, [&](size_t) {
+            pack.close();
+            pack.open(pack_path.c_str());
+        });
+
+        double find_ns = bench::measure_ns(5, [&](size_t) {
+            for (const std::string& name : names) {
+                bench::do_not_optimize(pack.find(name));
+            }
+        });
+
+        std::vector<uint8_t> buffer(16 * 1024);
+        double pack_read_ns = bench::measure_ns(3, [&](size_t) {
+            for (const std::string& name : names) {
+                const AssetPackEntry* entry = pack.find(name);
+                pack.read(*entry, buffer.data());
+                bench::do_not_optimize(buffer[0]);
+            }
+        });
+
+        double loose_read_ns = bench::measure_ns(3, [&](size_t) {
+            for (const std::string& name : names) {
+                std::FILE* file = std::fopen((directory / name).string().c_str(), "rb");
+                std::fseek(file, 0, SEEK_END);
+                long size = std::ftell(file);
+                std::fseek(file, 0, SEEK_SET);
+                std::fread(buffer.data(), 1, (size_t)size, file);
+                std::fclose(file);
+                bench::do_not_optimize(buffer[0]);
+            }
+        });
+
+        const AssetPackEntry* large = pack.find("large.bin");
+        double decompress_ns = bench::measure_ns(5, [&](size_t) {
+            pack.read(*large, data.data());
+            bench::do_not_optimize(data[0]);
+        });
+        double verify_ns = bench::measure_ns(5, [&](size_t) {
+            pack.read(*large, data.data(), true);
+            bench::do_not_optimize(data[0]);
+        });
+
+        double pack_size = (double)pack.file().size();
+        double ratio = (double)large->uncompressed_size / (double)large->size;
+        pack.close();
+        std::filesystem::remove_all(directory);
+
+        bench::report("pack size", pack_size / (1024.0 * 1024.0), "MiB");
+        bench::report("compression ratio", ratio, "x");
+        bench::report("open", open_ns * 1e-3, "us");
+        bench::report("find", find_ns / (double)ASSETS, "ns/asset");
+        bench::report("pack read", pack_read_ns / (double)ASSETS, "ns/asset");
+        bench::report("loose file read", loose_read_ns / (double)ASSETS, "ns/asset");
+        bench::report("small asset throughput", (double)total_size / pack_read_ns, "GB/s");
+        bench::report("large decompress", (double)LARGE_SIZE / decompress_ns, "GB/s");
+        bench::report("large decompress + verify", (double)LARGE_SIZE / verify_ns, "GB/s");
+        JobSystem::shutdown();
+    }
+    error::shutdown();
+}
+
+} // namespace ky
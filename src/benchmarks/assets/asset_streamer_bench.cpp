@@ -0,0 +1,157 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "assets/asset_streamer.h"
+#include "bench.h"
+#include "core/error.h"
+#include "core/time.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef KY_PLATFORM_LINUX
+#    include <fcntl.h>
+#    include <unistd.h>
+#endif
+
+namespace ky {
+
+// Drops the pack from the page cache so reads hit the device, a no-op elsewhere
+static void evict_page_cache(const std::string& path) {
+#ifdef KY_PLATFORM_LINUX
+    int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor >= 0) {
+        posix_fadvise(descriptor, 0, 0, POSIX_FADV_DONTNEED);
+        close(descriptor);
+    }
+#else
+    (void)path;
+#endif
+}
+
+// Streams 8k small uncompressed assets through each backend, with the page cache dropped and
+// warm, against reading them one after another with blocking reads
+KY_BENCHMARK(asset_streamer) {
+    constexpr size_t ASSETS = 8192;
+    constexpr size_t ASSET_SIZE = 16 * 1024;
+
+    error::init();
+    {
+        std::string path =
+                (std::filesystem::temp_directory_path() / "kryos_asset_streamer_bench.kypk")
+                        .string();
+        std::vector<std::string> names(ASSETS);
+        {
+            std::mt19937 rng(3);
+            std::vector<uint8_t> data(ASSET_SIZE);
+            AssetPackWriter writer;
+            writer.open(path.c_str());
+            for (size_t i = 0; i < ASSETS; i++) {
+                for (uint8_t& byte : data) {
+                    byte = (uint8_t)rng();
+                }
+                names[i] = "streamed/asset_" + std::to_string(i);
+                writer.add(names[i], data.data(), data.size(), ASSET_COMPRESSION_NONE);
+            }
+            writer.finish();
+        }
+        double total_bytes = (double)(ASSETS * ASSET_SIZE);
+
+        std::vector<AssetHandle> handles(ASSETS);
+        auto stream_all = [&](AsyncIoBackend backend, bool cold, double& request_ns) {
+            AssetStreamerSettings settings;
+            settings.backend = backend;
+            AssetStreamer streamer;
+            streamer.init(path.c_str(), settings);
+            if (cold) {
+                evict_page_cache(path);
+            }
+
+            int64_t start = Clock::now();
+            for (size_t i = 0; i < ASSETS; i++) {
+                handles[i] = streamer.request(names[i]);
+            }
+            request_ns = (double)(Clock::now() - start) / (double)ASSETS;
+            for (const AssetHandle& handle : handles) {
+                while (!handle.ready()) {
+                    std::this_thread::yield();
+                }
+            }
+            double elapsed_ns = (double)(Clock::now() - start);
+            for (AssetHandle& handle : handles) {
+                handle.reset();
+            }
+            return elapsed_ns;
+        };
+
+        AsyncFile file;
+        AssetPack pack;
+        file.open(path.c_str());
+        pack.open(path.c_str());
+        // Every asset gets its own allocation like the streamed ones, which stay resident
+        std::vector<uint8_t*> loaded(ASSETS);
+        auto read_blocking = [&](bool cold) {
+            if (cold) {
+                evict_page_cache(path);
+            }
+            int64_t start = Clock::now();
+            for (size_t i = 0; i < ASSETS; i++) {
+                const AssetPackEntry* entry = pack.find(names[i]);
+                loaded[i] = (uint8_t*)memory::allocate(entry->size, MEMORY_TAG_ASSETS);
+                file.read(entry->offset, loaded[i], entry->size);
+            }
+            double elapsed_ns = (double)(Clock::now() - start);
+            for (uint8_t* data : loaded) {
+                memory::deallocate(data, ASSET_SIZE, MEMORY_TAG_ASSETS);
+            }
+            return elapsed_ns;
+        };
+
+        double blocking_cold_ns = read_blocking(true);
+        double blocking_warm_ns = read_blocking(false);
+        pack.close();
+        file.close();
+        bench::report("blocking reads, cold", total_bytes / blocking_cold_ns, "GB/s");
+        bench::report("blocking reads, warm", total_bytes / blocking_warm_ns, "GB/s");
+
+        for (uint32_t backend = 0; backend < ASYNC_IO_BACKEND_COUNT; backend++) {
+            if (!AsyncIoQueue::supported((AsyncIoBackend)backend)) {
+                continue;
+            }
+            const char* name = AsyncIoQueue::backend_name((AsyncIoBackend)backend);
+            double request_ns;
+            double cold_ns = stream_all((AsyncIoBackend)backend, true, request_ns);
+            double warm_ns = stream_all((AsyncIoBackend)backend, false, request_ns);
+
+            char label[64];
+            std::snprintf(label, sizeof(label), "%s, cold", name);
+            bench::report(label, total_bytes / cold_ns, "GB/s");
+            std::snprintf(label, sizeof(label), "%s, warm", name);
+            bench::report(label, total_bytes / warm_ns, "GB/s");
+            std::snprintf(label, sizeof(label), "%s, warm requests", name);
+            bench::report(label, (double)ASSETS / (warm_ns * 1e-9) * 1e-3, "k/s");
+            std::snprintf(label, sizeof(label), "%s, request call", name);
+            bench::report(label, request_ns, "ns");
+        }
+        std::remove(path.c_str());
+    }
+    error::shutdown();
+}
+
+} // namespace ky
@@ -0,0 +1,68 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_BENCHMARKS__BENCH_H
+#define KRYOS_BENCHMARKS__BENCH_H
+
+#include "core/macros.h"
+
+#include <chrono>
+#include <cstddef>
+
+// Defines a benchmark function which is registered before `main` and run by the benchmarks
+// executable. Pass a name filter on the command line to only run matching benchmarks.
+#define KY_BENCHMARK(_name)                                                             \
+    static void _name();                                                                \
+    static const int _name##_registered = ky::bench::register_benchmark(#_name, _name); \
+    static void _name()
+
+namespace ky {
+namespace bench {
+
+    using BenchmarkFunction = void (*)();
+
+    int register_benchmark(const char* name, BenchmarkFunction function);
+
+    // Prints a single result line in the form `name: value unit`.
+    void report(const char* name, double value, const char* unit);
+
+    // Calls `body` `iterations` times and returns the average cost of a call in nanoseconds.
+    template <typename _Body>
+    double measure_ns(size_t iterations, _Body&& body) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            body(i);
+        }
+        auto end = std::chrono::steady_clock::now();
+        double elapsed = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+                             .count();
+        return elapsed / (double)iterations;
+    }
+
+    // Keeps the compiler from optimizing away a value computed by a benchmark body.
+    template <typename _Type>
+    KY_FORCE_INLINE void do_not_optimize(const _Type& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile const void* sink;
+        sink = &value;
+#endif
+    }
+
+} // namespace bench
+} // namespace ky
+
+#endif
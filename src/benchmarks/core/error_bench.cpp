@@ -0,0 +1,59 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bench.h"
+
+#include "core/error.h"
+
+#include <cstdio>
+
+#ifdef KY_PLATFORM_WINDOWS
+#    define _KY_NULL_DEVICE "NUL"
+#else
+#    define _KY_NULL_DEVICE "/dev/null"
+#endif
+
+namespace ky {
+
+// Producer side cost of reporting an error. Errors are written to stderr by the console handler,
+// which is redirected to the null device so the synchronous path still pays for real stdio. Calls
+// are issued in bursts of half the ring capacity so the asynchronous path never drops messages.
+static void bench_print_error(ErrorDispatchMode mode, const char* name) {
+    constexpr size_t BURSTS = 400;
+    constexpr size_t BURST_SIZE = KY_ERROR_ASYNC_RING_CAPACITY / 2;
+
+    error::init(mode);
+    std::FILE* null_stderr = std::freopen(_KY_NULL_DEVICE, "w", stderr);
+    KY_ERROR_CONDITION_MSG(null_stderr != nullptr, "Failed to redirect stderr");
+
+    double total_ns = 0.0;
+    for (size_t burst = 0; burst < BURSTS; burst++) {
+        total_ns += bench::measure_ns(BURST_SIZE, [](size_t i) {
+            error_internal::print_error(KY_FUNCTION_STR, __FILE__, __LINE__, ErrorCode::ERROR,
+                                        "Entity %zu has invalid component data", i);
+        });
+        error::flush();
+    }
+    bench::report(name, total_ns / (double)BURSTS, "ns/call");
+
+    error::shutdown();
+}
+
+KY_BENCHMARK(error_print_error) {
+    bench_print_error(ErrorDispatchMode::SYNC, "sync producer");
+    bench_print_error(ErrorDispatchMode::ASYNC, "async producer");
+}
+
+} // namespace ky
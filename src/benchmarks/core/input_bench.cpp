@@ -0,0 +1,71 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bench.h"
+
+#include "core/error.h"
+#include "core/input.h"
+#include "core/window.h"
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+namespace ky {
+
+// Query cost with hundreds of bindings checked every frame, compared against polling GLFW for
+// each query as the previous implementation did.
+KY_BENCHMARK(input_queries) {
+    constexpr size_t BINDINGS = 512;
+    constexpr size_t FRAMES = 2000;
+
+    error::init();
+    // Benchmarks have to run without a display
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    {
+        WindowManager window_manager("Input benchmark");
+        Input input;
+        Input::init(input, window_manager);
+
+        KeyCode codes[BINDINGS];
+        for (size_t i = 0; i < BINDINGS; i++) {
+            codes[i] = (KeyCode)(KeyCode_Space + i % (KeyCode_Last - KeyCode_Space + 1));
+        }
+
+        double pressed_ns = 0.0;
+        double press_ns = 0.0;
+        double polling_ns = 0.0;
+        GLFWwindow* glfw_handle = window_manager.main().glfw_handle();
+        for (size_t frame = 0; frame < FRAMES; frame++) {
+            input.poll_events();
+            pressed_ns += bench::measure_ns(BINDINGS, [&](size_t i) {
+                bench::do_not_optimize(Input::key_pressed(codes[i]));
+            });
+            press_ns += bench::measure_ns(BINDINGS, [&](size_t i) {
+                bench::do_not_optimize(Input::key_press(codes[i]));
+            });
+            polling_ns += bench::measure_ns(BINDINGS, [&](size_t i) {
+                bench::do_not_optimize(glfwGetKey(glfw_handle, codes[i]) == GLFW_PRESS);
+            });
+        }
+
+        bench::report("key_pressed (edge)", pressed_ns / FRAMES, "ns/query");
+        bench::report("key_press (held)", press_ns / FRAMES, "ns/query");
+        bench::report("glfwGetKey", polling_ns / FRAMES, "ns/query");
+        bench::report("key_pressed, 512 bindings", pressed_ns / FRAMES * BINDINGS, "ns/frame");
+    }
+    error::shutdown();
+}
+
+} // namespace ky
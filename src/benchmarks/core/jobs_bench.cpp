@@ -0,0 +1,108 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bench.h"
+
+#include "core/error.h"
+#include "core/jobs.h"
+#include "core/time.h"
+
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace ky {
+
+// Scheduling cost of a job doing nothing, measured on 1 to N threads. Everything above the
+// single threaded cost is contention on the deques.
+KY_BENCHMARK(jobs_empty_job_overhead) {
+    constexpr size_t JOBS = 4000;
+    constexpr size_t ROUNDS = 50;
+
+    error::init();
+    uint32_t hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (uint32_t threads = 1; threads <= hardware_threads; threads++) {
+        JobSystem job_system;
+        JobSystem::init(job_system, (int32_t)threads - 1);
+
+        double job_ns = 0.0;
+        for (size_t round = 0; round < ROUNDS; round++) {
+            JobCounter counter;
+            job_ns += bench::measure_ns(JOBS, [&](size_t) { JobSystem::run(counter, []() {}); });
+            int64_t start = Clock::now();
+            JobSystem::wait(counter);
+            job_ns += (double)(Clock::now() - start) / JOBS;
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "%u threads", threads);
+        bench::report(name, job_ns / ROUNDS, "ns/job");
+        JobSystem::shutdown();
+    }
+    error::shutdown();
+}
+
+// Synthetic per entity update over 1M entities with `parallel_for`, measured on 1 to N threads.
+KY_BENCHMARK(jobs_entity_update) {
+    constexpr size_t ENTITIES = 1000000;
+    constexpr size_t FRAMES = 20;
+
+    struct Entity {
+        float position[3];
+        float velocity[3];
+    };
+
+    error::init();
+    std::vector<Entity> entities(ENTITIES);
+    for (size_t i = 0; i < ENTITIES; i++) {
+        entities[i] = Entity {{(float)i, 0.0f, 0.0f}, {1.0f, (float)(i % 7), 0.5f}};
+    }
+
+    double single_thread_ms = 0.0;
+    uint32_t hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (uint32_t threads = 1; threads <= hardware_threads; threads++) {
+        JobSystem job_system;
+        JobSystem::init(job_system, (int32_t)threads - 1);
+
+        double frame_ns = bench::measure_ns(FRAMES, [&](size_t) {
+            JobSystem::parallel_for(
+                ENTITIES,
+                [&entities](size_t i) {
+                    Entity& entity = entities[i];
+                    float speed = std::sqrt(entity.velocity[0] * entity.velocity[0] +
+                                            entity.velocity[1] * entity.velocity[1] +
+                                            entity.velocity[2] * entity.velocity[2]);
+                    float drag = 1.0f / (1.0f + speed * 0.01f);
+                    for (int axis = 0; axis < 3; axis++) {
+                        entity.velocity[axis] *= drag;
+                        entity.position[axis] += entity.velocity[axis] * (1.0f / 60.0f);
+                    }
+                },
+                4096);
+        });
+        bench::do_not_optimize(entities[ENTITIES / 2].position[0]);
+
+        double frame_ms = frame_ns * 1e-6;
+        single_thread_ms = threads == 1 ? frame_ms : single_thread_ms;
+        char name[48];
+        snprintf(name, sizeof(name), "%u threads (%.2fx)", threads, single_thread_ms / frame_ms);
+        bench::report(name, frame_ms, "ms/frame");
+        JobSystem::shutdown();
+    }
+    error::shutdown();
+}
+
+} // namespace ky
@@ -0,0 +1,140 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bench.h"
+
+#include "core/error.h"
+#include "core/memory.h"
+
+#include <cstdlib>
+#include <list>
+#include <vector>
+
+namespace ky {
+
+struct BenchParticle {
+    float position[3];
+    float velocity[3];
+    float lifetime;
+};
+
+// Transient per frame allocations, heap against the frame allocator. Each round allocates a
+// frame's worth of blocks and then releases them the way each allocator does it.
+KY_BENCHMARK(memory_transient_allocations) {
+    constexpr size_t ALLOCATIONS = 10000;
+    constexpr size_t ROUNDS = 20;
+
+    error::init();
+    std::vector<void*> blocks(ALLOCATIONS);
+    double malloc_ns = 0.0;
+    double frame_ns = 0.0;
+    {
+        FrameAllocator frame_allocator;
+        FrameAllocator::init(frame_allocator);
+        for (size_t round = 0; round < ROUNDS; round++) {
+            malloc_ns += bench::measure_ns(ALLOCATIONS, [&](size_t i) {
+                blocks[i] = std::malloc(16 + (i & 255));
+                bench::do_not_optimize(blocks[i]);
+            });
+            for (void* block : blocks) {
+                std::free(block);
+            }
+
+            frame_allocator.begin_frame();
+            frame_ns += bench::measure_ns(ALLOCATIONS, [&](size_t i) {
+                blocks[i] = FrameAllocator::allocate(16 + (i & 255));
+                bench::do_not_optimize(blocks[i]);
+            });
+        }
+    }
+    bench::report("malloc", malloc_ns / ROUNDS, "ns/alloc");
+    bench::report("frame allocator", frame_ns / ROUNDS, "ns/alloc");
+    error::shutdown();
+}
+
+// Creating and destroying small objects, heap against a typed pool.
+KY_BENCHMARK(memory_pool_churn) {
+    constexpr size_t OBJECTS = 10000;
+    constexpr size_t ROUNDS = 20;
+
+    std::vector<BenchParticle*> particles(OBJECTS);
+    double new_ns = 0.0;
+    double pool_ns = 0.0;
+    Pool<BenchParticle> pool;
+    for (size_t round = 0; round < ROUNDS; round++) {
+        new_ns += bench::measure_ns(OBJECTS, [&](size_t i) {
+            particles[i] = new BenchParticle {};
+            bench::do_not_optimize(particles[i]);
+        });
+        for (BenchParticle* particle : particles) {
+            delete particle;
+        }
+
+        pool_ns += bench::measure_ns(OBJECTS, [&](size_t i) {
+            particles[i] = pool.create();
+            bench::do_not_optimize(particles[i]);
+        });
+        for (BenchParticle* particle : particles) {
+            pool.destroy(particle);
+        }
+    }
+    bench::report("new", new_ns / ROUNDS, "ns/object");
+    bench::report("pool", pool_ns / ROUNDS, "ns/object");
+}
+
+// STL containers on the default allocator against the adapters: a scratch vector grown from
+// empty every frame and a list built node by node.
+KY_BENCHMARK(memory_stl_adapters) {
+    constexpr size_t ELEMENTS = 10000;
+    constexpr size_t ROUNDS = 20;
+
+    double vector_ns = 0.0;
+    double arena_vector_ns = 0.0;
+    double list_ns = 0.0;
+    double pool_list_ns = 0.0;
+    LinearArena arena(1024 * 1024);
+    // Big enough for a list node, the value and two links
+    FixedPool nodes(4 * sizeof(void*), alignof(void*));
+    for (size_t round = 0; round < ROUNDS; round++) {
+        {
+            std::vector<int> values;
+            vector_ns += bench::measure_ns(ELEMENTS, [&](size_t i) { values.push_back((int)i); });
+            bench::do_not_optimize(values.data());
+        }
+        {
+            ArenaVector<int> values {ArenaStlAllocator<int>(arena)};
+            arena_vector_ns +=
+                    bench::measure_ns(ELEMENTS, [&](size_t i) { values.push_back((int)i); });
+            bench::do_not_optimize(values.data());
+        }
+        arena.reset();
+
+        {
+            std::list<int> values;
+            list_ns += bench::measure_ns(ELEMENTS, [&](size_t i) { values.push_back((int)i); });
+        }
+        {
+            std::list<int, PoolStlAllocator<int>> values {PoolStlAllocator<int>(nodes)};
+            pool_list_ns +=
+                    bench::measure_ns(ELEMENTS, [&](size_t i) { values.push_back((int)i); });
+        }
+    }
+    bench::report("std::vector", vector_ns / ROUNDS, "ns/push");
+    bench::report("arena vector", arena_vector_ns / ROUNDS, "ns/push");
+    bench::report("std::list", list_ns / ROUNDS, "ns/push");
+    bench::report("pool list", pool_list_ns / ROUNDS, "ns/push");
+}
+
+} // namespace ky
@@ -0,0 +1,92 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bench.h"
+
+#include "core/error.h"
+#include "core/input.h"
+#include "core/window.h"
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+namespace ky {
+
+// Cached window property queries compared against asking GLFW for each one.
+KY_BENCHMARK(window_queries) {
+    constexpr size_t QUERIES = 1000000;
+
+    error::init();
+    // Benchmarks have to run without a display
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    {
+        WindowManager window_manager("Window benchmark");
+        WindowHandle window = window_manager.main();
+        GLFWwindow* glfw_handle = window.glfw_handle();
+
+        double cached_ns = bench::measure_ns(QUERIES, [&](size_t) {
+            bench::do_not_optimize(window.size());
+            bench::do_not_optimize(window.framebuffer_size());
+        });
+        double glfw_ns = bench::measure_ns(QUERIES, [&](size_t) {
+            glm::ivec2 size;
+            glm::ivec2 framebuffer_size;
+            glfwGetWindowSize(glfw_handle, &size.x, &size.y);
+            glfwGetFramebufferSize(glfw_handle, &framebuffer_size.x, &framebuffer_size.y);
+            bench::do_not_optimize(size);
+            bench::do_not_optimize(framebuffer_size);
+        });
+        bench::report("size + framebuffer_size (cached)", cached_ns, "ns/query");
+        bench::report("glfwGetWindowSize + glfwGetFramebufferSize", glfw_ns, "ns/query");
+    }
+    error::shutdown();
+}
+
+// Per frame cost of the runtime loop's window and input work with the headless backend, the
+// overhead a dedicated server tick pays for the loop.
+KY_BENCHMARK(headless_runtime_loop) {
+    constexpr size_t FRAMES = 100000;
+
+    error::init();
+    {
+        WindowManager window_manager("Headless benchmark", KY_WINDOW_HANDLE_DEFAULT,
+                                     WINDOW_BACKEND_HEADLESS);
+        Input input;
+        Input::init(input, window_manager);
+
+        double frame_ns = bench::measure_ns(FRAMES, [&](size_t) {
+            bench::do_not_optimize(window_manager.continue_runtime_loop());
+            window_manager.swap_buffers();
+            input.poll_events();
+        });
+        bench::report("frame, 1 window", frame_ns, "ns/frame");
+
+        for (int i = 0; i < 8; i++) {
+            window_manager.create_window("Child", 320, 240);
+        }
+        frame_ns = bench::measure_ns(FRAMES, [&](size_t) {
+            bench::do_not_optimize(window_manager.continue_runtime_loop());
+            window_manager.swap_buffers();
+            input.poll_events();
+        });
+        bench::report("frame, 9 windows", frame_ns, "ns/frame");
+
+        window_manager.main().close();
+        bench::do_not_optimize(window_manager.continue_runtime_loop());
+    }
+    error::shutdown();
+}
+
+} // namespace ky
@@ -0,0 +1,58 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bench.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace ky {
+namespace bench {
+
+    struct _Benchmark {
+        const char* name;
+        BenchmarkFunction function;
+    };
+
+    static constexpr size_t _MAX_BENCHMARKS = 128;
+    static _Benchmark _benchmarks[_MAX_BENCHMARKS];
+    static size_t _benchmark_count = 0;
+
+    int register_benchmark(const char* name, BenchmarkFunction function) {
+        if (_benchmark_count < _MAX_BENCHMARKS) {
+            _benchmarks[_benchmark_count++] = _Benchmark {name, function};
+        }
+        return (int)_benchmark_count;
+    }
+
+    void report(const char* name, double value, const char* unit) {
+        printf("    %-48s %14.2f %s\n", name, value, unit);
+        fflush(stdout);
+    }
+
+} // namespace bench
+} // namespace ky
+
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    for (size_t i = 0; i < ky::bench::_benchmark_count; i++) {
+        const ky::bench::_Benchmark& benchmark = ky::bench::_benchmarks[i];
+        if (filter != nullptr && std::strstr(benchmark.name, filter) == nullptr) {
+            continue;
+        }
+        printf("%s\n", benchmark.name);
+        benchmark.function();
+    }
+}
@@ -0,0 +1,174 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bench.h"
+#include "core/error.h"
+#include "core/jobs.h"
+#include "render_hardware/base/context.h"
+#include "render_hardware/null/null_device.h"
+
+#include <cstdio>
+#include <thread>
+
+namespace ky {
+
+// Smallest module passing the SPIR-V checks, the null backend never compiles it
+static const uint32_t BENCH_SPIRV[] = {0x07230203, 0x00010000, 0, 1, 0};
+
+struct BenchScene {
+    TextureHandle target;
+    BufferHandle vertices;
+    ShaderHandle vertex_shader;
+    ShaderHandle fragment_shader;
+    PipelineHandle pipeline;
+};
+
+static BenchScene create_scene(RenderContext& context) {
+    BenchScene scene;
+    TextureDesc target_desc;
+    target_desc.width = 1920;
+    target_desc.height = 1080;
+    target_desc.usage = TEXTURE_USAGE_COLOR_ATTACHMENT_BIT;
+    scene.target = context.create_texture(target_desc);
+
+    BufferDesc vertices_desc;
+    vertices_desc.size = 3 * sizeof(float) * 3;
+    vertices_desc.usage = BUFFER_USAGE_VERTEX_BIT;
+    scene.vertices = context.create_buffer(vertices_desc);
+
+    ShaderDesc shader_desc;
+    shader_desc.code = BENCH_SPIRV;
+    shader_desc.code_size = sizeof(BENCH_SPIRV);
+    scene.vertex_shader = context.create_shader(shader_desc);
+    shader_desc.stage = SHADER_STAGE_FRAGMENT;
+    scene.fragment_shader = context.create_shader(shader_desc);
+
+    PipelineDesc pipeline_desc;
+    pipeline_desc.vertex_shader = scene.vertex_shader;
+    pipeline_desc.fragment_shader = scene.fragment_shader;
+    pipeline_desc.vertex_bindings[0].stride = sizeof(float) * 3;
+    pipeline_desc.vertex_binding_count = 1;
+    pipeline_desc.vertex_attribute_count = 1;
+    pipeline_desc.color_formats[0] = target_desc.format;
+    pipeline_desc.color_count = 1;
+    scene.pipeline = context.create_pipeline(pipeline_desc);
+    return scene;
+}
+
+static void destroy_scene(RenderContext& context, const BenchScene& scene) {
+    context.destroy(scene.pipeline);
+    context.destroy(scene.fragment_shader);
+    context.destroy(scene.vertex_shader);
+    context.destroy(scene.vertices);
+    context.destroy(scene.target);
+}
+
+// Draws of one chunk, each with its own push constants like per object transforms would be
+static void record_draws(CommandList& list, const BenchScene& scene, size_t begin, size_t end) {
+    list.bind_pipeline(scene.pipeline);
+    list.bind_vertex_buffer(0, scene.vertices);
+    for (size_t i = begin; i < end; i++) {
+        float constants[4] = {(float)i, 0.0f, 0.0f, 1.0f};
+        list.push_constants(constants, sizeof(constants));
+        list.draw(3);
+    }
+}
+
+// Records a pass of 100k draws into one command list and in parallel across lists on every
+// hardware thread, then submits them to the null backend which validates the whole stream.
+KY_BENCHMARK(command_list_recording) {
+    constexpr size_t DRAWS = 100000;
+    constexpr size_t CHUNK_SIZE = 4096;
+    constexpr size_t FRAMES = 20;
+
+    error::init();
+    {
+        JobSystem job_system;
+        JobSystem::init(job_system, (int32_t)std::thread::hardware_concurrency() - 1);
+
+        RenderContext context;
+        RenderContextDesc context_desc;
+        context_desc.backend = RENDER_BACKEND_NULL;
+        if (!context.init(context_desc)) {
+            JobSystem::shutdown();
+            error::shutdown();
+            return;
+        }
+        NullRenderDevice& device = static_cast<NullRenderDevice&>(context.device());
+        BenchScene scene = create_scene(context);
+
+        RenderPassDesc pass;
+        pass.colors[0].texture = scene.target;
+        pass.color_count = 1;
+        TextureBarrier to_attachment = {scene.target, RESOURCE_STATE_UNDEFINED,
+                                        RESOURCE_STATE_COLOR_ATTACHMENT};
+
+        TaggedVector<CommandList*, MEMORY_TAG_RENDER> lists;
+        for (bool parallel : {false, true}) {
+            double record_ns = 0.0;
+            double submit_ns = 0.0;
+            uint32_t validation_errors = 0;
+            for (size_t frame = 0; frame < FRAMES; frame++) {
+                context.begin_frame();
+                lists.clear();
+                CommandList* setup = context.command_list();
+                setup->barrier(to_attachment);
+                lists.push_back(setup);
+
+                auto record_start = std::chrono::steady_clock::now();
+                if (parallel) {
+                    context.record_parallel(pass, DRAWS, CHUNK_SIZE, lists,
+                                            [&](CommandList& list, size_t begin, size_t end) {
+                                                record_draws(list, scene, begin, end);
+                                            });
+                } else {
+                    CommandList* list = context.command_list();
+                    list->begin_render_pass(pass);
+                    record_draws(*list, scene, 0, DRAWS);
+                    list->end_render_pass();
+                    lists.push_back(list);
+                }
+                auto submit_start = std::chrono::steady_clock::now();
+                context.submit(lists.data(), (uint32_t)lists.size());
+                auto submit_end = std::chrono::steady_clock::now();
+                validation_errors += device.stats().validation_errors;
+                context.end_frame();
+
+                record_ns += (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 submit_start - record_start)
+                                 .count();
+                submit_ns += (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 submit_end - submit_start)
+                                 .count();
+            }
+            if (validation_errors > 0) {
+                KY_ERROR_MSG("%u benchmark commands failed validation", validation_errors);
+            }
+
+            char name[48];
+            snprintf(name, sizeof(name), "record %s", parallel ? "parallel" : "single list");
+            bench::report(name, record_ns / FRAMES * 1e-6, "ms/100k draws");
+            snprintf(name, sizeof(name), "validate %s", parallel ? "parallel" : "single list");
+            bench::report(name, submit_ns / FRAMES * 1e-6, "ms/100k draws");
+        }
+
+        destroy_scene(context, scene);
+        context.shutdown();
+        JobSystem::shutdown();
+    }
+    error::shutdown();
+}
+
+} // namespace ky
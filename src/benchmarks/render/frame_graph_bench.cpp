@@ -0,0 +1,156 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bench.h"
+#include "core/error.h"
+#include "core/jobs.h"
+#include "render_hardware/base/context.h"
+#include "render_hardware/null/null_device.h"
+#include "renderer/frame_graph.h"
+
+#include <thread>
+
+namespace ky {
+
+static constexpr uint32_t BENCH_CHAINS = 16;
+static constexpr uint32_t BENCH_CHAIN_LENGTH = 8;
+
+// Passes only clear their target, recording costs the same for any graph
+static void bench_pass(const FrameGraphPassContext& context, FrameGraphResource target) {
+    RenderPassDesc pass;
+    pass.colors[0].texture = context.texture(target);
+    pass.color_count = 1;
+    context.list().begin_render_pass(pass);
+    context.list().end_render_pass();
+}
+
+// Chains of post processing passes each reading the previous one's output, all chains feeding
+// the composite pass writing the swapchain. Every fourth chain ends in a pass nothing reads, and
+// `debug_pass` adds one more such pass to change the topology.
+static void declare_frame(FrameGraph& graph, TextureHandle swapchain, bool debug_pass) {
+    TextureDesc desc;
+    desc.width = 1920;
+    desc.height = 1080;
+    desc.format = TEXTURE_FORMAT_RGBA16_FLOAT;
+    desc.usage = TEXTURE_USAGE_COLOR_ATTACHMENT_BIT | TEXTURE_USAGE_SAMPLED_BIT;
+
+    graph.reset();
+    FrameGraphResource outputs[BENCH_CHAINS];
+    for (uint32_t chain = 0; chain < BENCH_CHAINS; chain++) {
+        FrameGraphResource previous = KY_RHI_INVALID_INDEX;
+        for (uint32_t i = 0; i < BENCH_CHAIN_LENGTH; i++) {
+            FrameGraphResource target = graph.create_texture("post", desc);
+            FrameGraph::PassBuilder pass = graph.add_pass(
+                "post", [target](const FrameGraphPassContext& context) {
+                    bench_pass(context, target);
+                });
+            pass.write(target, RESOURCE_STATE_COLOR_ATTACHMENT);
+            if (previous != KY_RHI_INVALID_INDEX) {
+                pass.read(previous, RESOURCE_STATE_SHADER_READ);
+            }
+            previous = target;
+        }
+        outputs[chain] = previous;
+    }
+    if (debug_pass) {
+        FrameGraphResource target = graph.create_texture("debug", desc);
+        graph.add_pass("debug", [target](const FrameGraphPassContext& context) {
+            bench_pass(context, target);
+        }).write(target, RESOURCE_STATE_COLOR_ATTACHMENT);
+    }
+
+    FrameGraphResource target = graph.import_texture(
+        "swapchain", swapchain, RESOURCE_STATE_UNDEFINED, RESOURCE_STATE_PRESENT);
+    FrameGraph::PassBuilder composite = graph.add_pass(
+        "composite", [target](const FrameGraphPassContext& context) {
+            bench_pass(context, target);
+        });
+    composite.write(target, RESOURCE_STATE_COLOR_ATTACHMENT);
+    for (uint32_t chain = 0; chain < BENCH_CHAINS; chain++) {
+        if (chain % 4 != 3) {
+            composite.read(outputs[chain], RESOURCE_STATE_SHADER_READ);
+        }
+    }
+}
+
+// Declares and compiles a graph of 129 passes, alternating between two topologies so every
+// compile misses the cache and then with one topology so every compile after the first hits it.
+// Then executes the graph on the null backend and reports what culling and aliasing saved.
+KY_BENCHMARK(frame_graph) {
+    constexpr size_t ITERATIONS = 2000;
+    constexpr size_t FRAMES = 100;
+
+    error::init();
+    {
+        JobSystem job_system;
+        JobSystem::init(job_system, (int32_t)std::thread::hardware_concurrency() - 1);
+
+        RenderContext context;
+        RenderContextDesc context_desc;
+        context_desc.backend = RENDER_BACKEND_NULL;
+        if (!context.init(context_desc)) {
+            JobSystem::shutdown();
+            error::shutdown();
+            return;
+        }
+        TextureDesc swapchain_desc;
+        swapchain_desc.width = 1920;
+        swapchain_desc.height = 1080;
+        swapchain_desc.usage = TEXTURE_USAGE_COLOR_ATTACHMENT_BIT;
+        TextureHandle swapchain = context.create_texture(swapchain_desc);
+
+        FrameGraph graph;
+        double compile_ns = bench::measure_ns(ITERATIONS, [&](size_t i) {
+            declare_frame(graph, swapchain, i % 2 == 1);
+            bench::do_not_optimize(graph.compile());
+        });
+        bench::report("declare + compile", compile_ns * 1e-3, "us/frame");
+        double cached_ns = bench::measure_ns(ITERATIONS, [&](size_t) {
+            declare_frame(graph, swapchain, false);
+            bench::do_not_optimize(graph.compile());
+        });
+        bench::report("declare + cached compile", cached_ns * 1e-3, "us/frame");
+
+        NullRenderDevice& device = static_cast<NullRenderDevice&>(context.device());
+        uint32_t validation_errors = 0;
+        double execute_ns = bench::measure_ns(FRAMES, [&](size_t) {
+            context.begin_frame();
+            declare_frame(graph, swapchain, false);
+            graph.execute(context);
+            validation_errors += device.stats().validation_errors;
+            context.end_frame();
+        });
+        if (validation_errors > 0) {
+            KY_ERROR_MSG("%u frame graph commands failed validation", validation_errors);
+        }
+        bench::report("declare + execute", execute_ns * 1e-3, "us/frame");
+
+        const FrameGraphStats& stats = graph.stats();
+        bench::report("passes culled", stats.culled_passes, "passes");
+        bench::report("barriers", stats.barriers, "barriers");
+        bench::report("transient textures", stats.transient_resources, "textures");
+        bench::report("physical textures", stats.physical_textures, "textures");
+        bench::report("transient memory", (double)stats.transient_bytes / (1024 * 1024), "MiB");
+        bench::report("physical memory", (double)stats.physical_bytes / (1024 * 1024), "MiB");
+
+        graph.shutdown(context);
+        context.destroy(swapchain);
+        context.shutdown();
+        JobSystem::shutdown();
+    }
+    error::shutdown();
+}
+
+} // namespace ky
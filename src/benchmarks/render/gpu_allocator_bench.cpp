@@ -0,0 +1,345 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bench.h"
+#include "core/error.h"
+#include "core/jobs.h"
+#include "render_hardware/base/context.h"
+#include "render_hardware/base/gpu_allocator.h"
+
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace ky {
+
+static constexpr uint64_t BENCH_MIN_SIZE = 256;
+static constexpr uint64_t BENCH_MAX_SIZE = 16ull * 1024 * 1024;
+
+// Resource sizes are spread evenly over orders of magnitude, small constant buffers being as
+// common as meshes and meshes as common as large textures
+struct BenchResource {
+    uint64_t size;
+    uint64_t alignment;
+    GpuAllocationKind kind;
+    bool relocatable;
+};
+
+static BenchResource bench_resource(std::mt19937& random) {
+    std::uniform_real_distribution<double> exponent(std::log2((double)BENCH_MIN_SIZE),
+                                                    std::log2((double)BENCH_MAX_SIZE));
+    BenchResource resource;
+    resource.size = (uint64_t)std::exp2(exponent(random));
+    // A third are optimally tiled textures, which stay where they are
+    resource.kind = random() % 3 == 0 ? GPU_ALLOCATION_OPTIMAL : GPU_ALLOCATION_LINEAR;
+    if (resource.kind == GPU_ALLOCATION_OPTIMAL) {
+        resource.alignment = resource.size < 64 * 1024 ? 4096 : 64 * 1024;
+        resource.relocatable = false;
+    } else {
+        resource.alignment = 256;
+        resource.relocatable = random() % 8 != 0;
+    }
+    return resource;
+}
+
+static bool bench_allocate_block(void*, uint32_t, uint64_t, GpuMemoryBlock&) {
+    return true;
+}
+
+static void bench_free_block(void*, uint32_t, const GpuMemoryBlock&) {}
+
+// Allocates and frees resources at random in a single 512 MiB range, holding about half of it.
+// Reports the cost of an allocation and a free, validating every invariant along the way.
+KY_BENCHMARK(gpu_allocator_tlsf) {
+    constexpr uint64_t RANGE = 512ull * 1024 * 1024;
+    constexpr size_t OPERATIONS = 200000;
+    constexpr size_t VALIDATE_INTERVAL = 4096;
+
+    error::init();
+    {
+        std::mt19937 random(1234);
+        std::vector<BenchResource> resources(OPERATIONS);
+        for (BenchResource& resource : resources) {
+            resource = bench_resource(random);
+        }
+        std::vector<uint32_t> live;
+        live.reserve(OPERATIONS);
+        std::vector<uint32_t> victims(OPERATIONS);
+        for (uint32_t& victim : victims) {
+            victim = random();
+        }
+
+        TlsfAllocator allocator;
+        allocator.init(RANGE, 1024);
+        uint64_t target = RANGE / 2;
+        uint32_t failed = 0;
+        uint32_t invalid = 0;
+        uint32_t allocations = 0;
+        uint32_t frees = 0;
+        double ns = bench::measure_ns(1, [&](size_t) {
+            for (size_t i = 0; i < OPERATIONS; i++) {
+                if (allocator.used_bytes() < target || live.empty()) {
+                    const BenchResource& resource = resources[i];
+                    uint32_t node;
+                    uint64_t offset;
+                    if (allocator.allocate(resource.size, resource.alignment, resource.kind, 0,
+                                           node, offset)) {
+                        live.push_back(node);
+                    } else {
+                        failed++;
+                    }
+                    allocations++;
+                } else {
+                    size_t victim = victims[i] % live.size();
+                    allocator.free(live[victim]);
+                    live[victim] = live.back();
+                    live.pop_back();
+                    frees++;
+                }
+                if (i % VALIDATE_INTERVAL == 0) {
+                    invalid += !allocator.validate();
+                }
+            }
+        });
+        if (invalid > 0) {
+            KY_ERROR_MSG("TLSF allocator broke its invariants %u times", invalid);
+        }
+        TlsfStats stats = allocator.stats();
+        bench::report("allocations + frees", (double)(allocations + frees), "operations");
+        bench::report("churn", ns / OPERATIONS, "ns/operation");
+        bench::report("failed allocations", failed, "allocations");
+        bench::report("free regions", stats.free_regions, "regions");
+        bench::report("largest free region", (double)stats.largest_free_region / (1024 * 1024),
+                      "MiB");
+        for (uint32_t node : live) {
+            allocator.free(node);
+        }
+        if (!allocator.validate() || allocator.stats().free_regions != 1) {
+            KY_ERROR_MSG("TLSF allocator didn't merge every free region");
+        }
+    }
+    error::shutdown();
+}
+
+static void report_memory(const char* name, const GpuMemoryStats& stats) {
+    char label[64];
+    snprintf(label, sizeof(label), "%s blocks", name);
+    bench::report(label, stats.blocks, "blocks");
+    snprintf(label, sizeof(label), "%s utilization", name);
+    bench::report(label, 100.0 * (double)stats.used_bytes / (double)stats.block_bytes, "%");
+    snprintf(label, sizeof(label), "%s fragmentation", name);
+    bench::report(label, 100.0 * stats.fragmentation, "%");
+}
+
+// Streams resources in and out of 64 MiB blocks until 1 GiB is live, then frees two thirds of
+// them at random the way unloading a level would. Defragments incrementally with a budget of 32
+// moves and 64 MiB per frame until nothing moves anymore, and reports how many blocks that freed.
+KY_BENCHMARK(gpu_allocator_churn) {
+    constexpr uint64_t LIVE_BYTES = 1024ull * 1024 * 1024;
+    constexpr size_t OPERATIONS = 100000;
+    constexpr uint32_t MAX_MOVES = 32;
+    constexpr uint64_t MAX_BYTES = 64ull * 1024 * 1024;
+
+    error::init();
+    {
+        GpuAllocatorDesc desc;
+        desc.granularity = 1024;
+        desc.allocate_block = bench_allocate_block;
+        desc.free_block = bench_free_block;
+        GpuAllocator allocator;
+        allocator.init(desc);
+
+        std::mt19937 random(1234);
+        std::vector<GpuAllocation> live;
+        std::vector<uint64_t> ids;
+        uint64_t live_bytes = 0;
+        uint64_t next_id = 1;
+        double allocate_ns = 0.0;
+        double free_ns = 0.0;
+        size_t allocations = 0;
+        size_t frees = 0;
+        for (size_t i = 0; i < OPERATIONS; i++) {
+            if (live_bytes < LIVE_BYTES || random() % 2 == 0) {
+                BenchResource resource = bench_resource(random);
+                GpuAllocationDesc allocation_desc;
+                allocation_desc.size = resource.size;
+                allocation_desc.alignment = resource.alignment;
+                allocation_desc.kind = resource.kind;
+                allocation_desc.user_data = resource.relocatable ? next_id : 0;
+                GpuAllocation allocation;
+                allocate_ns += bench::measure_ns(1, [&](size_t) {
+                    allocator.allocate(allocation_desc, allocation);
+                });
+                live.push_back(allocation);
+                ids.push_back(next_id++);
+                live_bytes += allocation.size;
+                allocations++;
+            } else {
+                size_t victim = random() % live.size();
+                live_bytes -= live[victim].size;
+                free_ns += bench::measure_ns(1, [&](size_t) { allocator.free(live[victim]); });
+                live[victim] = live.back();
+                live.pop_back();
+                ids[victim] = ids.back();
+                ids.pop_back();
+                frees++;
+            }
+        }
+        bench::report("allocate", allocate_ns / (double)allocations, "ns/allocation");
+        bench::report("free", free_ns / (double)frees, "ns/free");
+
+        for (size_t i = 0; i < live.size();) {
+            if (random() % 3 != 0) {
+                allocator.free(live[i]);
+                live[i] = live.back();
+                live.pop_back();
+                ids[i] = ids.back();
+                ids.pop_back();
+            } else {
+                i++;
+            }
+        }
+        report_memory("unloaded", allocator.stats());
+
+        TaggedVector<GpuDefragmentationMove, MEMORY_TAG_RENDER> moves;
+        uint32_t frames = 0;
+        uint32_t moved = 0;
+        uint64_t moved_bytes = 0;
+        double defragment_ns = bench::measure_ns(1, [&](size_t) {
+            while (allocator.defragment(MAX_MOVES, MAX_BYTES, moves) > 0) {
+                // The moved resources are found by id like a backend finds them by index
+                for (const GpuDefragmentationMove& move : moves) {
+                    for (size_t i = 0; i < ids.size(); i++) {
+                        if (ids[i] == move.user_data) {
+                            allocator.free(live[i]);
+                            live[i] = move.destination;
+                            break;
+                        }
+                    }
+                    moved_bytes += move.source.size;
+                }
+                moved += (uint32_t)moves.size();
+                frames++;
+            }
+        });
+        if (!allocator.validate()) {
+            KY_ERROR_MSG("GPU allocator broke its invariants");
+        }
+        report_memory("defragmented", allocator.stats());
+        bench::report("defragmentation frames", frames, "frames");
+        bench::report("moved", moved, "allocations");
+        bench::report("moved memory", (double)moved_bytes / (1024 * 1024), "MiB");
+        bench::report("defragmentation", defragment_ns / std::max(frames, 1u) * 1e-3,
+                      "us/frame");
+
+        for (const GpuAllocation& allocation : live) {
+            allocator.free(allocation);
+        }
+        allocator.shutdown();
+    }
+    error::shutdown();
+}
+
+// Same through the RHI on the null backend, GPU only buffers are relocated with their handles
+// kept while textures stay in place.
+KY_BENCHMARK(gpu_memory_defragment) {
+    constexpr size_t RESOURCES = 4096;
+
+    error::init();
+    {
+        JobSystem job_system;
+        JobSystem::init(job_system, (int32_t)std::thread::hardware_concurrency() - 1);
+
+        RenderContext context;
+        RenderContextDesc context_desc;
+        context_desc.backend = RENDER_BACKEND_NULL;
+        if (!context.init(context_desc)) {
+            JobSystem::shutdown();
+            error::shutdown();
+            return;
+        }
+
+        std::mt19937 random(1234);
+        std::vector<BufferHandle> buffers;
+        std::vector<TextureHandle> textures;
+        for (size_t i = 0; i < RESOURCES; i++) {
+            BenchResource resource = bench_resource(random);
+            if (resource.kind == GPU_ALLOCATION_OPTIMAL) {
+                TextureDesc desc;
+                desc.width = std::max((uint32_t)std::sqrt((double)resource.size / 4), 1u);
+                desc.height = desc.width;
+                textures.push_back(context.create_texture(desc));
+            } else {
+                BufferDesc desc;
+                desc.size = resource.size;
+                desc.usage = BUFFER_USAGE_VERTEX_BIT;
+                desc.memory = resource.relocatable ? RENDER_MEMORY_GPU : RENDER_MEMORY_UPLOAD;
+                buffers.push_back(context.create_buffer(desc));
+            }
+        }
+        // Unloading a level leaves a third of the buffers and most textures
+        for (size_t i = 0; i < buffers.size(); i++) {
+            if (random() % 3 != 0) {
+                context.destroy(buffers[i]);
+                buffers[i] = BufferHandle();
+            }
+        }
+        for (size_t i = 0; i < textures.size(); i++) {
+            if (random() % 4 == 0) {
+                context.destroy(textures[i]);
+                textures[i] = TextureHandle();
+            }
+        }
+        // Destruction is deferred until the frames in flight finished
+        for (uint32_t frame = 0; frame < KY_RHI_FRAMES_IN_FLIGHT + 1; frame++) {
+            context.begin_frame();
+            context.end_frame();
+        }
+        report_memory("unloaded", context.memory_stats());
+
+        uint32_t frames = 0;
+        uint32_t moved = 0;
+        for (;;) {
+            context.begin_frame();
+            uint32_t frame_moves = context.defragment(32, 64ull * 1024 * 1024);
+            context.end_frame();
+            if (frame_moves == 0) {
+                break;
+            }
+            moved += frame_moves;
+            frames++;
+        }
+        report_memory("defragmented", context.memory_stats());
+        bench::report("defragmentation frames", frames, "frames");
+        bench::report("moved", moved, "buffers");
+
+        for (BufferHandle buffer : buffers) {
+            if (buffer.valid()) {
+                context.destroy(buffer);
+            }
+        }
+        for (TextureHandle texture : textures) {
+            if (texture.valid()) {
+                context.destroy(texture);
+            }
+        }
+        context.shutdown();
+        JobSystem::shutdown();
+    }
+    error::shutdown();
+}
+
+} // namespace ky
@@ -0,0 +1,294 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bench.h"
+#include "core/error.h"
+#include "core/jobs.h"
+#include "render_hardware/base/context.h"
+#include "render_hardware/null/null_device.h"
+#include "renderer/render_queue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace ky {
+
+static constexpr size_t QUEUE_BENCH_ITEMS = 100000;
+static constexpr uint32_t QUEUE_BENCH_PIPELINES = 16;
+static constexpr uint32_t QUEUE_BENCH_MATERIALS = 512;
+static constexpr uint32_t QUEUE_BENCH_MESHES = 64;
+// Distinct material and mesh pairs objects are placed from, like props of a level
+static constexpr uint32_t QUEUE_BENCH_PROTOTYPES = 2000;
+static constexpr uint32_t QUEUE_BENCH_FRAMES = 20;
+
+static const uint32_t QUEUE_BENCH_SPIRV[] = {0x07230203, 0x00010000, 0, 1, 0};
+
+// Transform of an object, the last element holds its index so batches can be checked
+struct QueueBenchInstance {
+    float transform[16];
+};
+
+struct QueueBenchScene {
+    TextureHandle target;
+    BufferHandle vertices;
+    BufferHandle indices;
+    BufferHandle uniforms;
+    ShaderHandle vertex_shader;
+    ShaderHandle fragment_shader;
+    std::vector<PipelineHandle> pipelines;
+};
+
+static QueueBenchScene create_queue_scene(RenderContext& context, RenderQueue& queue) {
+    QueueBenchScene scene;
+    TextureDesc target_desc;
+    target_desc.width = 1920;
+    target_desc.height = 1080;
+    target_desc.usage = TEXTURE_USAGE_COLOR_ATTACHMENT_BIT;
+    scene.target = context.create_texture(target_desc);
+
+    BufferDesc buffer_desc;
+    buffer_desc.size = 1024 * sizeof(float) * 3;
+    buffer_desc.usage = BUFFER_USAGE_VERTEX_BIT;
+    scene.vertices = context.create_buffer(buffer_desc);
+    buffer_desc.size = QUEUE_BENCH_MESHES * 96 * sizeof(uint32_t);
+    buffer_desc.usage = BUFFER_USAGE_INDEX_BIT;
+    scene.indices = context.create_buffer(buffer_desc);
+    buffer_desc.size = QUEUE_BENCH_MATERIALS * 256;
+    buffer_desc.usage = BUFFER_USAGE_UNIFORM_BIT;
+    scene.uniforms = context.create_buffer(buffer_desc);
+
+    ShaderDesc shader_desc;
+    shader_desc.code = QUEUE_BENCH_SPIRV;
+    shader_desc.code_size = sizeof(QUEUE_BENCH_SPIRV);
+    scene.vertex_shader = context.create_shader(shader_desc);
+    shader_desc.stage = SHADER_STAGE_FRAGMENT;
+    scene.fragment_shader = context.create_shader(shader_desc);
+
+    PipelineDesc pipeline_desc;
+    pipeline_desc.vertex_shader = scene.vertex_shader;
+    pipeline_desc.fragment_shader = scene.fragment_shader;
+    pipeline_desc.vertex_bindings[0].stride = sizeof(float) * 3;
+    pipeline_desc.vertex_binding_count = 1;
+    pipeline_desc.vertex_attribute_count = 1;
+    pipeline_desc.color_formats[0] = target_desc.format;
+    pipeline_desc.color_count = 1;
+    for (uint32_t i = 0; i < QUEUE_BENCH_PIPELINES; i++) {
+        scene.pipelines.push_back(context.create_pipeline(pipeline_desc));
+    }
+
+    for (uint32_t i = 0; i < QUEUE_BENCH_MESHES; i++) {
+        RenderMesh mesh;
+        mesh.vertex_buffer = scene.vertices;
+        mesh.index_buffer = scene.indices;
+        mesh.count = 96;
+        mesh.first = i * 96;
+        queue.add_mesh(mesh);
+    }
+    for (uint32_t i = 0; i < QUEUE_BENCH_MATERIALS; i++) {
+        RenderMaterial material;
+        material.pipeline = scene.pipelines[i % QUEUE_BENCH_PIPELINES];
+        material.uniforms = scene.uniforms;
+        material.uniforms_offset = i * 256;
+        material.uniforms_size = 256;
+        queue.add_material(material);
+    }
+    return scene;
+}
+
+static void destroy_queue_scene(RenderContext& context, const QueueBenchScene& scene) {
+    for (PipelineHandle pipeline : scene.pipelines) {
+        context.destroy(pipeline);
+    }
+    context.destroy(scene.fragment_shader);
+    context.destroy(scene.vertex_shader);
+    context.destroy(scene.uniforms);
+    context.destroy(scene.indices);
+    context.destroy(scene.vertices);
+    context.destroy(scene.target);
+}
+
+// Whether every instance of every batch is an object drawing the batch's material and mesh, and
+// every object is drawn once.
+static bool check_batches(const RenderQueue& queue, const std::vector<RenderItem>& objects) {
+    std::vector<uint8_t> drawn(objects.size(), 0);
+    const QueueBenchInstance* instances = (const QueueBenchInstance*)queue.instances().data;
+    for (uint32_t i = 0; i < queue.batch_count(); i++) {
+        const RenderBatch& batch = queue.batches()[i];
+        for (uint32_t instance = batch.first_instance;
+             instance < batch.first_instance + batch.instance_count; instance++) {
+            size_t object = (size_t)instances[instance].transform[15];
+            if (object >= objects.size() || drawn[object] ||
+                objects[object].material != batch.material ||
+                objects[object].mesh != batch.mesh) {
+                return false;
+            }
+            drawn[object] = 1;
+        }
+    }
+    return std::find(drawn.begin(), drawn.end(), 0) == drawn.end();
+}
+
+// Sorts and batches 100k culled objects a frame, a tenth of them translucent, and records the
+// batches in parallel for the null backend to validate. Reports the cost of each step, radix
+// against `std::sort` of the same keys, and the draws and state changes instancing saved
+// compared to drawing the objects one by one in the order culling produced them.
+KY_BENCHMARK(render_queue) {
+    error::init();
+    {
+        JobSystem job_system;
+        JobSystem::init(job_system, (int32_t)std::thread::hardware_concurrency() - 1);
+
+        RenderContext context;
+        RenderContextDesc context_desc;
+        context_desc.backend = RENDER_BACKEND_NULL;
+        if (!context.init(context_desc)) {
+            JobSystem::shutdown();
+            error::shutdown();
+            return;
+        }
+        NullRenderDevice& device = static_cast<NullRenderDevice&>(context.device());
+        RenderQueue queue;
+        queue.init(sizeof(QueueBenchInstance));
+        QueueBenchScene scene = create_queue_scene(context, queue);
+
+        std::mt19937 random(1234);
+        std::vector<RenderItem> prototypes(QUEUE_BENCH_PROTOTYPES);
+        for (RenderItem& prototype : prototypes) {
+            prototype.material = random() % QUEUE_BENCH_MATERIALS;
+            prototype.mesh = random() % QUEUE_BENCH_MESHES;
+            prototype.sort = random() % 10 == 0 ? RENDER_SORT_TRANSLUCENT : RENDER_SORT_OPAQUE;
+        }
+        std::vector<RenderItem> objects(QUEUE_BENCH_ITEMS);
+        std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+        for (RenderItem& object : objects) {
+            object = prototypes[random() % QUEUE_BENCH_PROTOTYPES];
+            object.depth = depth(random);
+        }
+
+        RenderPassDesc pass;
+        pass.colors[0].texture = scene.target;
+        pass.color_count = 1;
+        TextureBarrier to_attachment = {scene.target, RESOURCE_STATE_UNDEFINED,
+                                        RESOURCE_STATE_COLOR_ATTACHMENT};
+
+        double add_ns = 0.0;
+        double sort_ns = 0.0;
+        double std_sort_ns = 0.0;
+        double build_ns = 0.0;
+        double record_ns = 0.0;
+        uint32_t validation_errors = 0;
+        uint32_t failed_checks = 0;
+        std::vector<std::pair<uint64_t, uint32_t>> reference(QUEUE_BENCH_ITEMS);
+        TaggedVector<CommandList*, MEMORY_TAG_RENDER> lists;
+        for (uint32_t frame = 0; frame < QUEUE_BENCH_FRAMES; frame++) {
+            context.begin_frame();
+            queue.reset(QUEUE_BENCH_ITEMS);
+            add_ns += bench::measure_ns(1, [&](size_t) {
+                JobSystem::parallel_for(QUEUE_BENCH_ITEMS, [&](size_t object) {
+                    QueueBenchInstance instance = {};
+                    instance.transform[0] = instance.transform[5] = instance.transform[10] = 1.0f;
+                    instance.transform[15] = (float)object;
+                    queue.add(objects[object], &instance);
+                });
+            });
+
+            for (size_t i = 0; i < QUEUE_BENCH_ITEMS; i++) {
+                reference[i] = {queue.keys()[i], queue.items()[i]};
+            }
+            std_sort_ns += bench::measure_ns(1, [&](size_t) {
+                std::stable_sort(reference.begin(), reference.end(),
+                                 [](const auto& a, const auto& b) { return a.first < b.first; });
+            });
+            sort_ns += bench::measure_ns(1, [&](size_t) { queue.sort(); });
+            for (size_t i = 0; i < QUEUE_BENCH_ITEMS; i++) {
+                if (queue.keys()[i] != reference[i].first ||
+                    queue.items()[i] != reference[i].second) {
+                    failed_checks++;
+                    break;
+                }
+            }
+
+            build_ns += bench::measure_ns(1, [&](size_t) { queue.build(context); });
+            if (!check_batches(queue, objects)) {
+                failed_checks++;
+            }
+
+            lists.clear();
+            CommandList* setup = context.command_list();
+            setup->barrier(to_attachment);
+            lists.push_back(setup);
+            record_ns += bench::measure_ns(1, [&](size_t) {
+                RenderQueueRange range = queue.range(0, 0);
+                context.record_parallel(pass, range.size(), 256, lists,
+                                        [&](CommandList& list, size_t begin, size_t end) {
+                                            queue.record(list, range.begin + (uint32_t)begin,
+                                                         range.begin + (uint32_t)end);
+                                        });
+            });
+            context.submit(lists.data(), (uint32_t)lists.size());
+            validation_errors += device.stats().validation_errors;
+            if (device.stats().instances != QUEUE_BENCH_ITEMS) {
+                failed_checks++;
+            }
+            context.end_frame();
+        }
+        if (validation_errors > 0) {
+            KY_ERROR_MSG("%u render queue commands failed validation", validation_errors);
+        }
+        if (failed_checks > 0) {
+            KY_ERROR_MSG("Render queue sorted or batched %u frames wrong", failed_checks);
+        }
+
+        bench::report("add", add_ns / QUEUE_BENCH_FRAMES * 1e-6, "ms/100k items");
+        bench::report("radix sort", sort_ns / QUEUE_BENCH_FRAMES * 1e-6, "ms/100k items");
+        bench::report("std::stable_sort", std_sort_ns / QUEUE_BENCH_FRAMES * 1e-6,
+                      "ms/100k items");
+        bench::report("build", build_ns / QUEUE_BENCH_FRAMES * 1e-6, "ms/100k items");
+        bench::report("record", record_ns / QUEUE_BENCH_FRAMES * 1e-6, "ms/100k items");
+
+        // Drawing the objects in culling order, every one a draw
+        uint32_t pipeline_changes = 0;
+        uint32_t material_changes = 0;
+        uint32_t mesh_changes = 0;
+        for (size_t i = 0; i < objects.size(); i++) {
+            const RenderItem* previous = i > 0 ? &objects[i - 1] : nullptr;
+            if (previous == nullptr || !(queue.material(previous->material).pipeline ==
+                                         queue.material(objects[i].material).pipeline)) {
+                pipeline_changes++;
+            }
+            material_changes += previous == nullptr || previous->material != objects[i].material;
+            mesh_changes += previous == nullptr || previous->mesh != objects[i].mesh;
+        }
+        const RenderQueueStats& stats = queue.stats();
+        bench::report("draws unsorted", (double)objects.size(), "draws");
+        bench::report("draws batched", stats.batches, "draws");
+        bench::report("pipeline changes unsorted", pipeline_changes, "binds");
+        bench::report("pipeline changes sorted", stats.pipeline_changes, "binds");
+        bench::report("material changes unsorted", material_changes, "binds");
+        bench::report("material changes sorted", stats.material_changes, "binds");
+        bench::report("mesh changes unsorted", mesh_changes, "binds");
+        bench::report("mesh changes sorted", stats.mesh_changes, "binds");
+
+        destroy_queue_scene(context, scene);
+        context.shutdown();
+        JobSystem::shutdown();
+    }
+    error::shutdown();
+}
+
+} // namespace ky
@@ -0,0 +1,207 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bench.h"
+#include "core/error.h"
+#include "render_hardware/base/context.h"
+#include "render_hardware/base/shader_cache.h"
+#include "render_hardware/null/null_device.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+namespace ky {
+
+static constexpr uint32_t BENCH_VARIANTS = 256;
+
+// Stands in for a GLSL compiler, emits a module with a uniform buffer, a combined image sampler
+// and a push constant block of a matrix and a vector. The body is padded with a no-op per source
+// character so modules grow with the source like compiled code would.
+static bool bench_compile(void*, const ShaderSource& source,
+                          TaggedVector<uint32_t, MEMORY_TAG_RENDER>& spirv, std::string&) {
+    enum : uint32_t {
+        ID_MAIN = 1,
+        ID_VOID,
+        ID_FUNCTION,
+        ID_FLOAT,
+        ID_VEC4,
+        ID_MAT4,
+        ID_UNIFORM_STRUCT,
+        ID_UNIFORM_POINTER,
+        ID_UNIFORM,
+        ID_IMAGE,
+        ID_SAMPLED_IMAGE,
+        ID_TEXTURE_POINTER,
+        ID_TEXTURE,
+        ID_PUSH_STRUCT,
+        ID_PUSH_POINTER,
+        ID_PUSH,
+        ID_LABEL,
+        ID_BOUND,
+    };
+    constexpr uint32_t texture_binding = KY_RHI_UNIFORM_BUFFER_SLOTS + KY_RHI_STORAGE_BUFFER_SLOTS;
+    uint32_t model = source.stage == SHADER_STAGE_FRAGMENT ? 4 : 0;
+    auto op = [](uint32_t word_count, uint32_t opcode) { return word_count << 16 | opcode; };
+    spirv = {
+        0x07230203, 0x00010000, 0, ID_BOUND, 0,
+        op(2, 17), 1,                               // Capability Shader
+        op(3, 14), 0, 1,                            // MemoryModel Logical GLSL450
+        op(5, 15), model, ID_MAIN, 0x6e69616d, 0,   // EntryPoint "main"
+    };
+    // A ModuleProcessed per define like compilers emitting debug info record them
+    for (uint32_t i = 0; i < source.define_count; i++) {
+        std::string process = "D" + std::string(source.defines[i].name) + "=" +
+                              std::string(source.defines[i].value);
+        uint32_t words = (uint32_t)process.size() / 4 + 1;
+        spirv.push_back(op(1 + words, 330));
+        size_t offset = spirv.size();
+        spirv.resize(offset + words, 0);
+        std::memcpy(spirv.data() + offset, process.data(), process.size());
+    }
+    spirv.insert(spirv.end(), {
+        op(3, 71), ID_UNIFORM_STRUCT, 2,            // Decorate Block
+        op(5, 72), ID_UNIFORM_STRUCT, 0, 35, 0,     // MemberDecorate Offset 0
+        op(4, 71), ID_UNIFORM, 34, 0,               // Decorate DescriptorSet 0
+        op(4, 71), ID_UNIFORM, 33, 0,               // Decorate Binding 0
+        op(4, 71), ID_TEXTURE, 34, 0,
+        op(4, 71), ID_TEXTURE, 33, texture_binding,
+        op(3, 71), ID_PUSH_STRUCT, 2,
+        op(5, 72), ID_PUSH_STRUCT, 0, 35, 0,
+        op(5, 72), ID_PUSH_STRUCT, 0, 7, 16,        // MemberDecorate MatrixStride 16
+        op(5, 72), ID_PUSH_STRUCT, 1, 35, 64,
+        op(2, 19), ID_VOID,
+        op(3, 33), ID_FUNCTION, ID_VOID,
+        op(3, 22), ID_FLOAT, 32,
+        op(4, 23), ID_VEC4, ID_FLOAT, 4,
+        op(4, 24), ID_MAT4, ID_VEC4, 4,
+        op(3, 30), ID_UNIFORM_STRUCT, ID_VEC4,
+        op(4, 32), ID_UNIFORM_POINTER, 2, ID_UNIFORM_STRUCT,
+        op(4, 59), ID_UNIFORM_POINTER, ID_UNIFORM, 2,
+        op(9, 25), ID_IMAGE, ID_FLOAT, 1, 0, 0, 0, 1, 0,
+        op(3, 27), ID_SAMPLED_IMAGE, ID_IMAGE,
+        op(4, 32), ID_TEXTURE_POINTER, 0, ID_SAMPLED_IMAGE,
+        op(4, 59), ID_TEXTURE_POINTER, ID_TEXTURE, 0,
+        op(4, 30), ID_PUSH_STRUCT, ID_MAT4, ID_VEC4,
+        op(4, 32), ID_PUSH_POINTER, 9, ID_PUSH_STRUCT,
+        op(4, 59), ID_PUSH_POINTER, ID_PUSH, 9,
+        op(5, 54), ID_VOID, ID_MAIN, 0, ID_FUNCTION, // Function main
+        op(2, 248), ID_LABEL,
+    });
+    spirv.insert(spirv.end(), source.code.size(), op(1, 0));
+    spirv.push_back(op(1, 253)); // Return
+    spirv.push_back(op(1, 56));  // FunctionEnd
+    return true;
+}
+
+static void request_variants(ShaderCache& cache, const std::string& code,
+                             const CachedShader** modules) {
+    char value[16];
+    ShaderDefine define = {"VARIANT", value};
+    ShaderSource source;
+    source.stage = SHADER_STAGE_FRAGMENT;
+    source.code = code;
+    source.path = "bench.frag";
+    source.defines = &define;
+    source.define_count = 1;
+    for (uint32_t i = 0; i < BENCH_VARIANTS; i++) {
+        define.value = std::string_view(value, snprintf(value, sizeof(value), "%u", i));
+        modules[i] = cache.get(source);
+    }
+}
+
+// Creates a pipeline per fragment variant, the null backend counts how many it found in the
+// pipeline cache loaded at init
+static uint32_t create_pipelines(const char* pipeline_cache_path, const CachedShader* vertex,
+                                 const CachedShader* const* fragments) {
+    RenderContext context;
+    RenderContextDesc context_desc;
+    context_desc.backend = RENDER_BACKEND_NULL;
+    context_desc.pipeline_cache_path = pipeline_cache_path;
+    if (!context.init(context_desc)) {
+        return 0;
+    }
+    ShaderHandle vertex_shader = context.create_shader(vertex->desc("bench.vert"));
+    for (uint32_t i = 0; i < BENCH_VARIANTS; i++) {
+        ShaderHandle fragment_shader = context.create_shader(fragments[i]->desc("bench.frag"));
+        PipelineDesc pipeline_desc;
+        pipeline_desc.vertex_shader = vertex_shader;
+        pipeline_desc.fragment_shader = fragment_shader;
+        pipeline_desc.color_count = 1;
+        context.destroy(context.create_pipeline(pipeline_desc));
+        context.destroy(fragment_shader);
+    }
+    context.destroy(vertex_shader);
+    uint32_t hits = static_cast<NullRenderDevice&>(context.device()).pipeline_cache_hits();
+    context.shutdown();
+    return hits;
+}
+
+// Requests 256 variants of a fragment shader from a cold cache which compiles them, from a new
+// cache on the same directory which loads them from disk and again from memory. The compiler
+// only emits a module so cold numbers are a lower bound, real compilers take milliseconds per
+// module. Then creates a pipeline per variant twice on the null backend with a pipeline cache
+// saved between the runs.
+KY_BENCHMARK(shader_cache) {
+    error::init();
+    {
+        std::filesystem::path directory =
+            std::filesystem::temp_directory_path() / "kryos_shader_cache_bench";
+        std::filesystem::remove_all(directory);
+        std::string shader_directory = (directory / "shaders").string();
+        std::string pipeline_cache_path = (directory / "pipelines.kypc").string();
+        std::string code(2048, ' ');
+
+        ShaderCacheDesc desc;
+        desc.directory = shader_directory.c_str();
+        desc.compile = bench_compile;
+        desc.compiler_version = "bench 1";
+
+        const CachedShader* modules[BENCH_VARIANTS] = {};
+        const char* names[] = {"shader cache cold", "shader cache disk", "shader cache memory"};
+        ShaderCache cache;
+        for (uint32_t run = 0; run < 3; run++) {
+            if (run < 2) {
+                cache.init(desc);
+            }
+            double ns = bench::measure_ns(1, [&](size_t) {
+                request_variants(cache, code, modules);
+            });
+            bench::report(names[run], ns / BENCH_VARIANTS * 1e-3, "us/module");
+        }
+        ShaderCacheStats stats = cache.stats();
+        if (stats.disk_hits != BENCH_VARIANTS || stats.memory_hits != BENCH_VARIANTS) {
+            KY_ERROR_MSG("Shader cache missed, %u disk hits and %u memory hits", stats.disk_hits,
+                         stats.memory_hits);
+        }
+
+        ShaderSource vertex_source;
+        vertex_source.code = code;
+        const CachedShader* vertex = cache.get(vertex_source);
+        if (vertex != nullptr && modules[BENCH_VARIANTS - 1] != nullptr) {
+            uint32_t cold_hits = create_pipelines(pipeline_cache_path.c_str(), vertex, modules);
+            uint32_t warm_hits = create_pipelines(pipeline_cache_path.c_str(), vertex, modules);
+            bench::report("pipeline cache cold hits", cold_hits, "pipelines");
+            bench::report("pipeline cache warm hits", warm_hits, "pipelines");
+        }
+
+        cache.shutdown();
+        std::filesystem::remove_all(directory);
+    }
+    error::shutdown();
+}
+
+} // namespace ky
@@ -0,0 +1,172 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bench.h"
+#include "core/error.h"
+#include "core/jobs.h"
+#include "render_hardware/base/context.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace ky {
+
+static constexpr size_t BENCH_DRAWS = 50000;
+static constexpr uint32_t BENCH_FRAMES = 16;
+
+// Per draw uniforms, a transform and a few material parameters
+struct BenchDrawUniforms {
+    float model[16];
+    float normal[12];
+    float color[4];
+    uint32_t draw;
+    uint32_t padding[3];
+};
+
+static void bench_uniforms(BenchDrawUniforms& uniforms, uint32_t draw, uint64_t frame) {
+    for (uint32_t i = 0; i < 16; i++) {
+        uniforms.model[i] = (float)(draw + i);
+    }
+    std::memset(uniforms.normal, 0, sizeof(uniforms.normal));
+    uniforms.color[0] = (float)frame;
+    uniforms.color[1] = uniforms.color[2] = uniforms.color[3] = 1.0f;
+    uniforms.draw = draw;
+}
+
+// Uploads the uniforms of every draw from the job system and a debug line strip of random size
+// from the frame thread, then checks no two uploads of the frame overlapped and every upload is
+// aligned. Returns ns per upload.
+static double bench_upload_frames(RenderContext& context, std::mt19937& random,
+                                  uint32_t& overlaps) {
+    std::vector<UploadAllocation> allocations(BENCH_DRAWS);
+    double upload_ns = 0.0;
+    for (uint32_t frame = 0; frame < BENCH_FRAMES; frame++) {
+        context.begin_frame();
+        uint64_t frame_number = context.frame_number();
+        // Larger alignments than the default come out of the thread's chunk as well, the first
+        // upload of the frame takes a new one
+        UploadAllocation page = context.upload(64, 4096);
+        if (!page.valid() || page.offset % 4096 != 0) {
+            overlaps++;
+        }
+        upload_ns += bench::measure_ns(1, [&](size_t) {
+            JobSystem::parallel_for(BENCH_DRAWS, [&](size_t draw) {
+                BenchDrawUniforms uniforms;
+                bench_uniforms(uniforms, (uint32_t)draw, frame_number);
+                allocations[draw] = context.upload(&uniforms, sizeof(uniforms));
+            });
+        });
+        std::vector<float> lines((random() % 64 + 1) * 1024, (float)frame_number);
+        UploadAllocation debug_lines =
+            context.upload(lines.data(), lines.size() * sizeof(float), 16);
+
+        for (size_t draw = 0; draw < BENCH_DRAWS; draw++) {
+            const BenchDrawUniforms* uniforms =
+                (const BenchDrawUniforms*)allocations[draw].data;
+            if (uniforms == nullptr || uniforms->draw != draw ||
+                uniforms->color[0] != (float)frame_number ||
+                allocations[draw].offset % KY_RHI_UPLOAD_ALIGNMENT != 0) {
+                overlaps++;
+            }
+        }
+        if (!debug_lines.valid() ||
+            std::memcmp(debug_lines.data, lines.data(), lines.size() * sizeof(float)) != 0) {
+            overlaps++;
+        }
+        context.end_frame();
+    }
+    return upload_ns / (double)(BENCH_FRAMES * BENCH_DRAWS);
+}
+
+static void report_uploads(const char* name, const UploadRingStats& stats) {
+    char label[64];
+    snprintf(label, sizeof(label), "%s high water", name);
+    bench::report(label, (double)stats.high_water / (1024 * 1024), "MiB");
+    snprintf(label, sizeof(label), "%s overflow frames", name);
+    bench::report(label, stats.overflow_frames, "frames");
+    snprintf(label, sizeof(label), "%s overflow buffers", name);
+    bench::report(label, stats.overflow_buffers, "buffers/frame");
+}
+
+// Per draw uniforms uploaded through the ring on every thread, once with a ring large enough
+// for the frame and once with one that overflows, against creating and mapping a buffer per
+// upload.
+KY_BENCHMARK(upload_ring) {
+    error::init();
+    {
+        JobSystem job_system;
+        JobSystem::init(job_system, (int32_t)std::thread::hardware_concurrency() - 1);
+        std::mt19937 random(1234);
+
+        RenderContext context;
+        RenderContextDesc context_desc;
+        context_desc.backend = RENDER_BACKEND_NULL;
+        context_desc.upload_ring_size = 32ull * 1024 * 1024;
+        if (context.init(context_desc)) {
+            uint32_t overlaps = 0;
+            double upload_ns = bench_upload_frames(context, random, overlaps);
+            bench::report("ring upload", upload_ns, "ns/upload");
+            report_uploads("ring", context.upload_stats());
+            if (overlaps > 0) {
+                KY_ERROR_MSG("%u uploads were overwritten or misaligned", overlaps);
+            }
+            if (context.upload_stats().overflow_frames > 0) {
+                KY_ERROR_MSG("Upload ring overflowed although it fits every frame");
+            }
+
+            // What every upload costs without the ring, a buffer per draw created, mapped and
+            // destroyed
+            constexpr size_t BUFFER_UPLOADS = 4096;
+            std::vector<BufferHandle> buffers(BUFFER_UPLOADS);
+            context.begin_frame();
+            double buffer_ns = bench::measure_ns(BUFFER_UPLOADS, [&](size_t draw) {
+                BenchDrawUniforms uniforms;
+                bench_uniforms(uniforms, (uint32_t)draw, context.frame_number());
+                BufferDesc desc;
+                desc.size = sizeof(uniforms);
+                desc.usage = BUFFER_USAGE_UNIFORM_BIT;
+                desc.memory = RENDER_MEMORY_UPLOAD;
+                buffers[draw] = context.create_buffer(desc);
+                std::memcpy(context.mapped_data(buffers[draw]), &uniforms, sizeof(uniforms));
+            });
+            for (BufferHandle buffer : buffers) {
+                context.destroy(buffer);
+            }
+            context.end_frame();
+            bench::report("buffer upload", buffer_ns, "ns/upload");
+            context.shutdown();
+        }
+
+        // A quarter of what a frame uploads, the rest goes to overflow buffers
+        context_desc.upload_ring_size = BENCH_DRAWS * sizeof(BenchDrawUniforms) / 4;
+        if (context.init(context_desc)) {
+            uint32_t overlaps = 0;
+            double upload_ns = bench_upload_frames(context, random, overlaps);
+            bench::report("overflowing upload", upload_ns, "ns/upload");
+            report_uploads("overflowing", context.upload_stats());
+            if (overlaps > 0) {
+                KY_ERROR_MSG("%u overflowing uploads were overwritten or misaligned", overlaps);
+            }
+            context.shutdown();
+        }
+        JobSystem::shutdown();
+    }
+    error::shutdown();
+}
+
+} // namespace ky
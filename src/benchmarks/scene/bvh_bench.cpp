@@ -0,0 +1,136 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bench.h"
+#include "core/error.h"
+#include "core/jobs.h"
+#include "core/time.h"
+#include "scene/dynamic_bvh.h"
+
+#include <entt/entity/registry.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace ky {
+
+// 100k small boxes scattered over a 2km world. Each query is timed against the linear scan over
+// every entity's bounds it replaces.
+KY_BENCHMARK(dynamic_bvh_queries) {
+    constexpr size_t ENTITIES = 100000;
+    constexpr size_t QUERIES = 1000;
+
+    error::init();
+    {
+        JobSystem job_system;
+        JobSystem::init(job_system, (int32_t)std::thread::hardware_concurrency() - 1);
+
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+        std::uniform_real_distribution<float> size(0.5f, 4.0f);
+        entt::registry registry;
+        std::vector<entt::entity> entities(ENTITIES);
+        std::vector<Aabb> bounds(ENTITIES);
+        registry.create(entities.begin(), entities.end());
+        for (Aabb& box : bounds) {
+            glm::vec3 center(position(random), position(random) * 0.05f, position(random));
+            glm::vec3 extents(size(random));
+            box = Aabb(center - extents, center + extents);
+        }
+
+        DynamicBvh bvh(registry);
+        double insert_ns =
+                bench::measure_ns(ENTITIES, [&](size_t i) { bvh.insert(entities[i], bounds[i]); });
+        double update_ns = bench::measure_ns(ENTITIES, [&](size_t i) {
+            Aabb box = bounds[i];
+            box.min.x += 0.05f;
+            box.max.x += 0.05f;
+            bvh.update(entities[i], box);
+        });
+        int64_t rebuild_start = Clock::now();
+        bvh.rebuild();
+        double rebuild_ns = (double)(Clock::now() - rebuild_start);
+
+        std::vector<Aabb> boxes(QUERIES);
+        std::vector<Ray> rays(QUERIES);
+        for (size_t i = 0; i < QUERIES; i++) {
+            glm::vec3 center(position(random), 0.0f, position(random));
+            boxes[i] = Aabb(center - glm::vec3(20.0f), center + glm::vec3(20.0f));
+            glm::vec3 direction(position(random), position(random) * 0.01f, position(random));
+            rays[i] = Ray(center, glm::normalize(direction));
+        }
+
+        size_t found = 0;
+        double aabb_ns = bench::measure_ns(QUERIES, [&](size_t i) {
+            bvh.query_aabb(boxes[i], [&](entt::entity) { found++; });
+        });
+        double aabb_linear_ns = bench::measure_ns(QUERIES / 10, [&](size_t i) {
+            for (const Aabb& box : bounds) {
+                found += box.overlaps(boxes[i]);
+            }
+        });
+
+        auto closest_hit = [](entt::entity, float t) { return t; };
+        double ray_ns = bench::measure_ns(QUERIES, [&](size_t i) {
+            bvh.raycast(rays[i], 500.0f, closest_hit);
+        });
+        double ray_linear_ns = bench::measure_ns(QUERIES / 10, [&](size_t i) {
+            glm::vec3 inverse_direction = 1.0f / rays[i].direction;
+            float closest = 500.0f;
+            for (const Aabb& box : bounds) {
+                float t = 0.0f;
+                if (rays[i].intersect(box, inverse_direction, closest, t)) {
+                    closest = t;
+                }
+            }
+            bench::do_not_optimize(closest);
+        });
+        double ray_batch_ns = bench::measure_ns(1, [&](size_t) {
+            bvh.parallel_queries(QUERIES, [&](size_t i) {
+                bvh.raycast(rays[i], 500.0f, closest_hit);
+            });
+        });
+
+        glm::mat4 projection = glm::perspective(1.0f, 16.0f / 9.0f, 0.1f, 300.0f);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(100.0f, 0.0f, 50.0f),
+                                     glm::vec3(0.0f, 1.0f, 0.0f));
+        Frustum frustum = Frustum::from_matrix(projection * view);
+        double frustum_ns = bench::measure_ns(10, [&](size_t) {
+            bvh.query_frustum(frustum, [&](entt::entity) { found++; });
+        });
+        double frustum_linear_ns = bench::measure_ns(10, [&](size_t) {
+            for (const Aabb& box : bounds) {
+                found += frustum.test(box) != FRUSTUM_OUTSIDE;
+            }
+        });
+        bench::do_not_optimize(found);
+
+        bench::report("insert", insert_ns, "ns/entity");
+        bench::report("update (small move)", update_ns, "ns/entity");
+        bench::report("rebuild", rebuild_ns * 1e-6, "ms");
+        bench::report("aabb query", aabb_ns * 1e-3, "us/query");
+        bench::report("aabb linear scan", aabb_linear_ns * 1e-3, "us/query");
+        bench::report("closest raycast", ray_ns * 1e-3, "us/query");
+        bench::report("raycast linear scan", ray_linear_ns * 1e-3, "us/query");
+        bench::report("raycast batch of 1000", ray_batch_ns * 1e-3, "us");
+        bench::report("frustum query", frustum_ns * 1e-3, "us/query");
+        bench::report("frustum linear scan", frustum_linear_ns * 1e-3, "us/query");
+        JobSystem::shutdown();
+    }
+    error::shutdown();
+}
+
+} // namespace ky
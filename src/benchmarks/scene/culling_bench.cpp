@@ -0,0 +1,117 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bench.h"
+#include "core/error.h"
+#include "core/jobs.h"
+#include "scene/culling.h"
+
+#include <cstdio>
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace ky {
+
+// Objects scattered over a 2km cube around a camera with a 1km far plane, about a tenth of them
+// end up visible. Every SIMD path is checked against the scalar one before being timed.
+KY_BENCHMARK(frustum_culling) {
+    constexpr size_t COUNTS[] = {10000, 100000, 1000000};
+    constexpr size_t OBJECTS_PER_MEASUREMENT = 20000000;
+    const float lod_thresholds[] = {0.25f, 0.1f, 0.04f, 0.01f};
+
+    error::init();
+    {
+        JobSystem job_system;
+        JobSystem::init(job_system, (int32_t)std::thread::hardware_concurrency() - 1);
+
+        glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(1.0f, 0.0f, 1.0f),
+                                     glm::vec3(0.0f, 1.0f, 0.0f));
+        CullingView culling_view =
+                CullingView::from_camera(view, projection, lod_thresholds, 4);
+
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+        std::uniform_real_distribution<float> size(0.25f, 8.0f);
+        std::vector<float> x, y, z, extent_x, extent_y, extent_z;
+        for (size_t count : COUNTS) {
+            x.resize(count);
+            y.resize(count);
+            z.resize(count);
+            extent_x.resize(count);
+            extent_y.resize(count);
+            extent_z.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                x[i] = position(random);
+                y[i] = position(random);
+                z[i] = position(random);
+                extent_x[i] = size(random);
+                extent_y[i] = size(random);
+                extent_z[i] = size(random);
+            }
+            SphereBoundsSoA spheres = {x.data(), y.data(), z.data(), extent_x.data(), count};
+            BoxBoundsSoA boxes = {x.data(),        y.data(),        z.data(),
+                                  extent_x.data(), extent_y.data(), extent_z.data(), count};
+
+            CullingResult reference_spheres;
+            CullingResult reference_boxes;
+            FrustumCuller scalar(CULLING_PATH_SCALAR);
+            scalar.cull(spheres, culling_view, reference_spheres);
+            scalar.cull(boxes, culling_view, reference_boxes);
+
+            size_t iterations = std::max(OBJECTS_PER_MEASUREMENT / count, (size_t)1);
+            for (int path = 0; path <= FrustumCuller::supported_path(); path++) {
+                FrustumCuller culler((CullingPath)path);
+                CullingResult result;
+                auto check = [&](const CullingResult& reference, const char* kind) {
+                    bool equal = result.size() == reference.size() &&
+                                 std::memcmp(result.visible(), reference.visible(),
+                                             result.size() * sizeof(uint32_t)) == 0 &&
+                                 std::memcmp(result.lods(), reference.lods(), result.size()) == 0;
+                    if (!equal) {
+                        KY_ERROR_MSG("%s %s results differ from the scalar path", kind,
+                                     FrustumCuller::path_name((CullingPath)path));
+                    }
+                };
+
+                double sphere_ns = bench::measure_ns(iterations, [&](size_t) {
+                    culler.cull(spheres, culling_view, result);
+                });
+                check(reference_spheres, "Sphere");
+                double box_ns = bench::measure_ns(iterations, [&](size_t) {
+                    culler.cull(boxes, culling_view, result);
+                });
+                check(reference_boxes, "Box");
+
+                char name[64];
+                std::snprintf(name, sizeof(name), "spheres %zuk %s", count / 1000,
+                              FrustumCuller::path_name((CullingPath)path));
+                bench::report(name, (double)count / sphere_ns * 1e3, "M objects/s");
+                std::snprintf(name, sizeof(name), "boxes %zuk %s", count / 1000,
+                              FrustumCuller::path_name((CullingPath)path));
+                bench::report(name, (double)count / box_ns * 1e3, "M objects/s");
+            }
+            bench::report("visible", (double)reference_spheres.size() * 100.0 / (double)count,
+                          "%");
+        }
+        JobSystem::shutdown();
+    }
+    error::shutdown();
+}
+
+} // namespace ky
@@ -0,0 +1,84 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bench.h"
+
+#include "core/error.h"
+#include "core/jobs.h"
+#include "scene/transform_hierarchy.h"
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace ky {
+
+// 100k entities in 1000 trees of 100 (root, 11 children with 8 children each). Compares a frame
+// where nothing moved, one where 1% of the trees moved and one recomputing everything, which is
+// what a full hierarchy walk costs every frame.
+KY_BENCHMARK(transform_hierarchy_update) {
+    constexpr size_t ROOTS = 1000;
+    constexpr size_t FRAMES = 20;
+
+    error::init();
+    {
+        JobSystem job_system;
+        JobSystem::init(job_system, (int32_t)std::thread::hardware_concurrency() - 1);
+
+        entt::registry registry;
+        TransformHierarchy hierarchy(registry);
+        std::vector<entt::entity> roots;
+        for (size_t i = 0; i < ROOTS; i++) {
+            entt::entity root = registry.create();
+            hierarchy.add(root, entt::null, glm::vec3((float)i, 0.0f, 0.0f));
+            roots.push_back(root);
+            for (size_t j = 0; j < 11; j++) {
+                entt::entity child = registry.create();
+                hierarchy.add(child, root, glm::vec3(0.0f, (float)j, 0.0f));
+                for (size_t k = 0; k < 8; k++) {
+                    hierarchy.add(registry.create(), child, glm::vec3(0.0f, 0.0f, (float)k));
+                }
+            }
+        }
+        hierarchy.update();
+
+        double static_ns = bench::measure_ns(FRAMES, [&](size_t) { hierarchy.update(); });
+
+        double partial_ns = bench::measure_ns(FRAMES, [&](size_t frame) {
+            for (size_t i = 0; i < ROOTS / 100; i++) {
+                entt::entity root = roots[(frame * 37 + i * 101) % ROOTS];
+                hierarchy.set_local_position(root, glm::vec3((float)frame, 1.0f, 0.0f));
+            }
+            hierarchy.update();
+        });
+
+        double full_ns = bench::measure_ns(FRAMES, [&](size_t frame) {
+            for (entt::entity root : roots) {
+                hierarchy.set_local_position(root, glm::vec3((float)frame, 1.0f, 0.0f));
+            }
+            hierarchy.update();
+        });
+
+        char name[48];
+        snprintf(name, sizeof(name), "%zu entities, static", hierarchy.size());
+        bench::report(name, static_ns * 1e-3, "us/frame");
+        bench::report("1% of trees moved", partial_ns * 1e-3, "us/frame");
+        bench::report("all trees moved", full_ns * 1e-3, "us/frame");
+        JobSystem::shutdown();
+    }
+    error::shutdown();
+}
+
+} // namespace ky
@@ -0,0 +1,129 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bench.h"
+#include "core/error.h"
+#include "core/jobs.h"
+#include "core/time.h"
+#include "scene/world_snapshot.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+namespace ky {
+
+struct SnapshotPosition {
+    float x, y, z;
+};
+
+struct SnapshotVelocity {
+    float x, y, z;
+};
+
+struct SnapshotRenderable {
+    float transform[12];
+    uint32_t mesh;
+    uint32_t material;
+    uint32_t flags;
+    uint32_t lod_bias;
+};
+
+// Round trips a 1M entity world. The bulk load is compared against emplacing the same mapped
+// components one at a time.
+KY_BENCHMARK(world_snapshot) {
+    constexpr size_t ENTITIES = 1000000;
+
+    error::init();
+    {
+        JobSystem job_system;
+        JobSystem::init(job_system, (int32_t)std::thread::hardware_concurrency() - 1);
+        std::string path =
+                (std::filesystem::temp_directory_path() / "kryos_world_snapshot_bench.kyws")
+                        .string();
+        entt::registry registry;
+        for (size_t i = 0; i < ENTITIES; i++) {
+            entt::entity entity = registry.create();
+            float value = (float)i;
+            registry.emplace<SnapshotPosition>(entity, SnapshotPosition{value, value, value});
+            if (i % 2 == 0) {
+                registry.emplace<SnapshotVelocity>(entity, SnapshotVelocity{1.0f, 0.0f, 0.0f});
+            }
+            if (i % 4 == 0) {
+                registry.emplace<SnapshotRenderable>(entity, SnapshotRenderable{});
+            }
+        }
+
+        int64_t start = Clock::now();
+        {
+            WorldSnapshotWriter writer(registry);
+            writer.write<SnapshotPosition>();
+            writer.write<SnapshotVelocity>();
+            writer.write<SnapshotRenderable>();
+            writer.save(path.c_str());
+        }
+        double save_ns = (double)(Clock::now() - start);
+        double size = (double)std::filesystem::file_size(path);
+
+        WorldSnapshot snapshot;
+        start = Clock::now();
+        snapshot.open(path.c_str());
+        snapshot.validate();
+        double validate_ns = (double)(Clock::now() - start);
+
+        double load_ns = bench::measure_ns(5, [&](size_t) {
+            entt::registry loaded;
+            snapshot.load<SnapshotPosition, SnapshotVelocity, SnapshotRenderable>(loaded);
+            bench::do_not_optimize(loaded.storage<SnapshotRenderable>().size());
+        });
+        double partial_ns = bench::measure_ns(5, [&](size_t) {
+            entt::registry loaded;
+            snapshot.load_components<SnapshotVelocity>(loaded);
+            bench::do_not_optimize(loaded.storage<SnapshotVelocity>().size());
+        });
+
+        // Same data emplaced an element at a time, the way stream based loaders restore it
+        double element_ns = bench::measure_ns(5, [&](size_t) {
+            entt::registry loaded;
+            snapshot.load<>(loaded);
+            auto emplace_all = [&](auto components) {
+                using Component = std::remove_const_t<std::remove_pointer_t<
+                        decltype(components.components)>>;
+                for (size_t i = 0; i < components.size; i++) {
+                    loaded.emplace<Component>(components.entities[i], components.components[i]);
+                }
+            };
+            emplace_all(snapshot.components<SnapshotPosition>());
+            emplace_all(snapshot.components<SnapshotVelocity>());
+            emplace_all(snapshot.components<SnapshotRenderable>());
+            bench::do_not_optimize(loaded.storage<SnapshotRenderable>().size());
+        });
+        snapshot.close();
+        std::remove(path.c_str());
+
+        bench::report("file size", size / (1024.0 * 1024.0), "MiB");
+        bench::report("save", save_ns * 1e-6, "ms");
+        bench::report("open and validate", size / validate_ns, "GB/s");
+        bench::report("full load", load_ns * 1e-6, "ms");
+        bench::report("full load throughput", size / load_ns, "GB/s");
+        bench::report("per element emplace", element_ns * 1e-6, "ms");
+        bench::report("partial load (1 component)", partial_ns * 1e-6, "ms");
+        JobSystem::shutdown();
+    }
+    error::shutdown();
+}
+
+} // namespace ky
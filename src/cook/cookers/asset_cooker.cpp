@@ -0,0 +1,74 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cookers/asset_cooker.h"
+
+namespace ky {
+
+static const AssetCooker _RAW_COOKER = {"raw", cook_raw, ASSET_COMPRESSION_LZ4};
+
+static const struct {
+    const char* extension;
+    AssetCooker cooker;
+} _COOKERS[] = {
+    {".obj", {"mesh", cook_obj_mesh, ASSET_COMPRESSION_LZ4}},
+    {".glsl", {"text", cook_text, ASSET_COMPRESSION_LZ4}},
+    {".vert", {"text", cook_text, ASSET_COMPRESSION_LZ4}},
+    {".frag", {"text", cook_text, ASSET_COMPRESSION_LZ4}},
+    {".comp", {"text", cook_text, ASSET_COMPRESSION_LZ4}},
+    {".json", {"text", cook_text, ASSET_COMPRESSION_LZ4}},
+    {".txt", {"text", cook_text, ASSET_COMPRESSION_LZ4}},
+    {".png", {"raw", cook_raw, ASSET_COMPRESSION_NONE}},
+    {".jpg", {"raw", cook_raw, ASSET_COMPRESSION_NONE}},
+    {".ogg", {"raw", cook_raw, ASSET_COMPRESSION_NONE}},
+    {".mp3", {"raw", cook_raw, ASSET_COMPRESSION_NONE}},
+};
+
+const AssetCooker& find_asset_cooker(std::string_view extension) {
+    for (const auto& entry : _COOKERS) {
+        if (extension == entry.extension) {
+            return entry.cooker;
+        }
+    }
+    return _RAW_COOKER;
+}
+
+bool cook_raw(const std::vector<uint8_t>& source, std::vector<uint8_t>& output) {
+    output = source;
+    return true;
+}
+
+bool cook_text(const std::vector<uint8_t>& source, std::vector<uint8_t>& output) {
+    size_t begin = 0;
+    if (source.size() >= 3 && source[0] == 0xEF && source[1] == 0xBB && source[2] == 0xBF) {
+        begin = 3;
+    }
+    output.clear();
+    output.reserve(source.size() - begin);
+    for (size_t i = begin; i < source.size(); i++) {
+        if (source[i] == '\r') {
+            // Lone carriage returns are old Mac line endings
+            output.push_back('\n');
+            if (i + 1 < source.size() && source[i + 1] == '\n') {
+                i++;
+            }
+        } else {
+            output.push_back(source[i]);
+        }
+    }
+    return true;
+}
+
+} // namespace ky
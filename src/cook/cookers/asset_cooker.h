@@ -0,0 +1,48 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_COOK__ASSET_COOKER_H
+#define KRYOS_COOK__ASSET_COOKER_H
+
+#include "assets/asset_pack.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace ky {
+
+// Converts the contents of a source file into the blob the runtime loads.
+using CookFunction = bool (*)(const std::vector<uint8_t>& source, std::vector<uint8_t>& output);
+
+struct AssetCooker {
+    const char* name;
+    CookFunction cook;
+    // Formats that are compressed already aren't worth compressing again
+    AssetCompression compression;
+};
+
+// Cooker for a lower case file extension including the dot, falls back to copying the file.
+const AssetCooker& find_asset_cooker(std::string_view extension);
+
+bool cook_raw(const std::vector<uint8_t>& source, std::vector<uint8_t>& output);
+// Strips the UTF-8 byte order mark and converts line endings to `\n`.
+bool cook_text(const std::vector<uint8_t>& source, std::vector<uint8_t>& output);
+// Wavefront OBJ to a triangulated, indexed mesh in the `assets/mesh_format.h` layout.
+bool cook_obj_mesh(const std::vector<uint8_t>& source, std::vector<uint8_t>& output);
+
+} // namespace ky
+
+#endif
@@ -0,0 +1,227 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cookers/asset_cooker.h"
+
+#include "assets/mesh_format.h"
+#include "core/error.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <string>
+#include <unordered_map>
+
+namespace ky {
+
+// Zero based attribute indices of one face corner, -1 when the corner doesn't reference one
+struct ObjCorner {
+    int32_t position;
+    int32_t uv;
+    int32_t normal;
+
+    inline bool operator==(const ObjCorner& other) const {
+        return position == other.position && uv == other.uv && normal == other.normal;
+    }
+};
+
+struct ObjCornerHash {
+    inline size_t operator()(const ObjCorner& corner) const {
+        uint64_t key = (uint64_t)(uint32_t)corner.position * 0x9E3779B97F4A7C15ull;
+        key ^= (uint64_t)(uint32_t)corner.uv * 0xC2B2AE3D27D4EB4Full + (key << 6);
+        key ^= (uint64_t)(uint32_t)corner.normal * 0x165667B19E3779F9ull + (key >> 2);
+        return (size_t)key;
+    }
+};
+
+static bool parse_floats(const char*& cursor, float* values, int count) {
+    for (int i = 0; i < count; i++) {
+        char* end;
+        values[i] = std::strtof(cursor, &end);
+        if (end == cursor) {
+            return false;
+        }
+        cursor = end;
+    }
+    return true;
+}
+
+// OBJ indices are one based, negative ones count back from the latest attribute
+static bool resolve_index(long index, size_t count, int32_t& result) {
+    if (index > 0 && (size_t)index <= count) {
+        result = (int32_t)index - 1;
+        return true;
+    }
+    if (index < 0 && (size_t)-index <= count) {
+        result = (int32_t)((long)count + index);
+        return true;
+    }
+    return false;
+}
+
+bool cook_obj_mesh(const std::vector<uint8_t>& source, std::vector<uint8_t>& output) {
+    // Lines are terminated in place so number parsing never runs into the next line
+    std::string text(source.begin(), source.end());
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> face;
+    std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> corners;
+    bool missing_normals = false;
+
+    size_t line_number = 0;
+    for (size_t begin = 0; begin < text.size();) {
+        size_t end = text.find('\n', begin);
+        if (end == std::string::npos) {
+            end = text.size();
+        } else {
+            text[end] = '\0';
+        }
+        const char* line = text.c_str() + begin;
+        begin = end + 1;
+        line_number++;
+
+        while (*line == ' ' || *line == '\t') {
+            line++;
+        }
+        const char* cursor = line;
+        bool valid = true;
+        if (std::strncmp(line, "v ", 2) == 0) {
+            cursor += 2;
+            glm::vec3& position = positions.emplace_back();
+            valid = parse_floats(cursor, &position.x, 3);
+        } else if (std::strncmp(line, "vt ", 3) == 0) {
+            cursor += 3;
+            glm::vec2& uv = uvs.emplace_back();
+            valid = parse_floats(cursor, &uv.x, 2);
+        } else if (std::strncmp(line, "vn ", 3) == 0) {
+            cursor += 3;
+            glm::vec3& normal = normals.emplace_back();
+            valid = parse_floats(cursor, &normal.x, 3);
+        } else if (std::strncmp(line, "f ", 2) == 0) {
+            cursor += 2;
+            face.clear();
+            while (valid) {
+                while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r') {
+                    cursor++;
+                }
+                if (*cursor == '\0' || *cursor == '#') {
+                    break;
+                }
+                ObjCorner corner = {-1, -1, -1};
+                char* end_of_index;
+                valid = resolve_index(std::strtol(cursor, &end_of_index, 10), positions.size(),
+                                      corner.position);
+                cursor = end_of_index;
+                if (valid && *cursor == '/') {
+                    cursor++;
+                    if (*cursor != '/') {
+                        valid = resolve_index(std::strtol(cursor, &end_of_index, 10), uvs.size(),
+                                              corner.uv);
+                        cursor = end_of_index;
+                    }
+                    if (valid && *cursor == '/') {
+                        cursor++;
+                        valid = resolve_index(std::strtol(cursor, &end_of_index, 10),
+                                              normals.size(), corner.normal);
+                        cursor = end_of_index;
+                    }
+                }
+                if (!valid) {
+                    break;
+                }
+
+                auto [it, inserted] = corners.try_emplace(corner, (uint32_t)vertices.size());
+                if (inserted) {
+                    MeshVertex vertex = {};
+                    std::memcpy(vertex.position, &positions[corner.position], sizeof(float) * 3);
+                    if (corner.uv >= 0) {
+                        std::memcpy(vertex.uv, &uvs[corner.uv], sizeof(float) * 2);
+                    }
+                    if (corner.normal >= 0) {
+                        std::memcpy(vertex.normal, &normals[corner.normal], sizeof(float) * 3);
+                    } else {
+                        missing_normals = true;
+                    }
+                    vertices.push_back(vertex);
+                }
+                face.push_back(it->second);
+            }
+            valid = valid && face.size() >= 3;
+            // Polygons are triangulated as fans
+            for (size_t i = 2; valid && i < face.size(); i++) {
+                indices.insert(indices.end(), {face[0], face[i - 1], face[i]});
+            }
+        }
+        if (!valid) {
+            KY_ERROR_MSG("Malformed OBJ line %zu", line_number);
+            return false;
+        }
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(!indices.empty(), false, "OBJ mesh has no faces");
+
+    if (missing_normals) {
+        // Corners without normals share vertices across faces, accumulating the area weighted
+        // face normals into them smooths the result
+        std::vector<glm::vec3> accumulated(vertices.size(), glm::vec3(0.0f));
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            glm::vec3 a, b, c;
+            std::memcpy(&a, vertices[indices[i]].position, sizeof(a));
+            std::memcpy(&b, vertices[indices[i + 1]].position, sizeof(b));
+            std::memcpy(&c, vertices[indices[i + 2]].position, sizeof(c));
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            for (size_t k = 0; k < 3; k++) {
+                accumulated[indices[i + k]] += normal;
+            }
+        }
+        for (const auto& [corner, index] : corners) {
+            if (corner.normal < 0) {
+                float length = glm::length(accumulated[index]);
+                glm::vec3 normal = length > 0.0f ? accumulated[index] / length : glm::vec3(0.0f);
+                std::memcpy(vertices[index].normal, &normal, sizeof(normal));
+            }
+        }
+    }
+
+    MeshHeader header = {};
+    std::memcpy(header.magic, KY_MESH_MAGIC, sizeof(header.magic));
+    header.version = KY_MESH_FORMAT_VERSION;
+    header.vertex_count = (uint32_t)vertices.size();
+    header.index_count = (uint32_t)indices.size();
+    for (int axis = 0; axis < 3; axis++) {
+        header.bounds_min[axis] = FLT_MAX;
+        header.bounds_max[axis] = -FLT_MAX;
+        for (const MeshVertex& vertex : vertices) {
+            header.bounds_min[axis] = std::min(header.bounds_min[axis], vertex.position[axis]);
+            header.bounds_max[axis] = std::max(header.bounds_max[axis], vertex.position[axis]);
+        }
+    }
+
+    size_t vertex_bytes = vertices.size() * sizeof(MeshVertex);
+    size_t index_bytes = indices.size() * sizeof(uint32_t);
+    output.resize(sizeof(header) + vertex_bytes + index_bytes);
+    std::memcpy(output.data(), &header, sizeof(header));
+    std::memcpy(output.data() + sizeof(header), vertices.data(), vertex_bytes);
+    std::memcpy(output.data() + sizeof(header) + vertex_bytes, indices.data(), index_bytes);
+    return true;
+}
+
+} // namespace ky
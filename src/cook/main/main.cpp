@@ -0,0 +1,156 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "assets/asset_pack.h"
+#include "cookers/asset_cooker.h"
+#include "core/error.h"
+#include "core/jobs.h"
+#include "core/time.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+static void print_usage() {
+    std::printf("Usage: kryos_cook <source directory> <output pack> [options]\n"
+                "\n"
+                "Cooks every file under the source directory into a pack, keyed by its path\n"
+                "relative to the directory with forward slashes.\n"
+                "\n"
+                "Options:\n"
+                "  --no-compress         Store all entries uncompressed\n"
+                "  --chunk-size <bytes>  Compression chunk size, defaults to %u\n"
+                "  --verify              Read back and check every entry after writing\n",
+                KY_ASSET_PACK_CHUNK_SIZE);
+}
+
+static bool read_file(const std::filesystem::path& path, std::vector<uint8_t>& data) {
+    FILE* file = std::fopen(path.string().c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    data.resize((size_t)std::filesystem::file_size(path));
+    bool read = std::fread(data.data(), 1, data.size(), file) == data.size();
+    std::fclose(file);
+    return read;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        print_usage();
+        return 1;
+    }
+    std::filesystem::path source_directory = argv[1];
+    const char* output_path = argv[2];
+    bool compress = true;
+    bool verify = false;
+    uint32_t chunk_size = KY_ASSET_PACK_CHUNK_SIZE;
+    for (int i = 3; i < argc; i++) {
+        if (std::strcmp(argv[i], "--no-compress") == 0) {
+            compress = false;
+        } else if (std::strcmp(argv[i], "--verify") == 0) {
+            verify = true;
+        } else if (std::strcmp(argv[i], "--chunk-size") == 0 && i + 1 < argc) {
+            chunk_size = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (!std::filesystem::is_directory(source_directory)) {
+        std::fprintf(stderr, "%s is not a directory\n", source_directory.string().c_str());
+        return 1;
+    }
+
+    int result = 0;
+    ky::error::init();
+    {
+        // Entries are compressed a chunk per job
+        ky::JobSystem job_system;
+        ky::JobSystem::init(job_system);
+        int64_t start = ky::Clock::now();
+
+        // Sorted so cooking the same sources always produces the same pack
+        std::vector<std::filesystem::path> sources;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(source_directory)) {
+            if (entry.is_regular_file()) {
+                sources.push_back(entry.path());
+            }
+        }
+        std::sort(sources.begin(), sources.end());
+
+        ky::AssetPackWriter writer;
+        bool success = writer.open(output_path, chunk_size);
+        std::vector<std::string> keys;
+        std::vector<uint8_t> source;
+        std::vector<uint8_t> cooked;
+        uint64_t source_bytes = 0;
+        uint64_t cooked_bytes = 0;
+        for (size_t i = 0; success && i < sources.size(); i++) {
+            std::string key =
+                    std::filesystem::relative(sources[i], source_directory).generic_string();
+            std::string extension = sources[i].extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(),
+                           [](char c) { return (char)std::tolower((unsigned char)c); });
+            const ky::AssetCooker& cooker = ky::find_asset_cooker(extension);
+            if (!read_file(sources[i], source)) {
+                std::fprintf(stderr, "Failed to read %s\n", sources[i].string().c_str());
+                success = false;
+            } else if (!cooker.cook(source, cooked)) {
+                std::fprintf(stderr, "Failed to cook %s as %s\n", key.c_str(), cooker.name);
+                success = false;
+            } else {
+                ky::AssetCompression compression =
+                        compress ? cooker.compression : ky::ASSET_COMPRESSION_NONE;
+                success = writer.add(key, cooked.data(), cooked.size(), compression);
+                source_bytes += source.size();
+                cooked_bytes += cooked.size();
+                keys.push_back(std::move(key));
+            }
+        }
+        success = success && writer.finish();
+
+        if (success && verify) {
+            ky::AssetPack pack;
+            success = pack.open(output_path);
+            for (size_t i = 0; success && i < keys.size(); i++) {
+                const ky::AssetPackEntry* entry = pack.find(keys[i]);
+                cooked.resize(entry != nullptr ? entry->uncompressed_size : 0);
+                success = entry != nullptr && pack.read(*entry, cooked.data(), true);
+                if (!success) {
+                    std::fprintf(stderr, "Verifying %s failed\n", keys[i].c_str());
+                }
+            }
+        }
+
+        if (success) {
+            std::printf("Cooked %zu assets in %.2fs, %.2f MiB source, %.2f MiB cooked, "
+                        "%.2f MiB packed\n",
+                        keys.size(), ky::Clock::to_seconds(ky::Clock::now() - start),
+                        (double)source_bytes / (1024.0 * 1024.0),
+                        (double)cooked_bytes / (1024.0 * 1024.0),
+                        (double)writer.stored_bytes() / (1024.0 * 1024.0));
+        }
+        result = success ? 0 : 1;
+        ky::JobSystem::shutdown();
+    }
+    ky::error::shutdown();
+    return result;
+}
@@ -13,26 +13,76 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include "assets/asset_streamer.h"
 #include "core/error.h"
 #include "core/input.h"
+#include "core/jobs.h"
+#include "core/memory.h"
+#include "core/memory_tracker.h"
+#include "core/profiler.h"
+#include "core/time.h"
 #include "core/window.h"
 
-int main() {
+#include <cstring>
+
+int main(int argc, char** argv) {
+    // Runs the loop without a display, e.g. on a dedicated server
+    ky::WindowBackend backend = ky::WINDOW_BACKEND_GLFW;
+    const char* asset_pack_path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            backend = ky::WINDOW_BACKEND_HEADLESS;
+        } else if (std::strcmp(argv[i], "--assets") == 0 && i + 1 < argc) {
+            asset_pack_path = argv[++i];
+        }
+    }
+
     ky::error::init();
     {
-        ky::WindowManager window_manager("Kryos Engine");
+        ky::WindowManager window_manager("Kryos Engine", KY_WINDOW_HANDLE_DEFAULT, backend);
 
         ky::Input input;
         ky::Input::init(input, window_manager);
 
+        // Workers take the other hardware threads, this one stays free for GLFW
+        ky::JobSystem job_system;
+        ky::JobSystem::init(job_system);
+
+        // Per frame transient allocations, released two frames later
+        ky::FrameAllocator frame_allocator;
+        ky::FrameAllocator::init(frame_allocator);
+
+        // Assets are read and decompressed on a streaming thread, the loop only checks whether
+        // handles are ready and never waits on a file read
+        ky::AssetStreamer asset_streamer;
+        if (asset_pack_path != nullptr) {
+            asset_streamer.init(asset_pack_path);
+        }
+
+        // Nothing is presented yet so vsync can't pace the loop, limit it to stop spinning
+        ky::Time time;
+        ky::Time::init(time, 144.0);
+
         // // Test windows
-        // ky::WindowHandle& child = window_manager.create_window("Test window", 500, 500);
+        // ky::WindowHandle child = window_manager.create_window("Test window", 500, 500);
         // child.create_window("Child of test window", 400, 400,
         //                     ky::WINDOW_HANDLE_WINDOWED_BIT | ky::WINDOW_HANDLE_VSYNC_BIT);
 
         while (window_manager.continue_runtime_loop()) {
+            time.begin_frame();
+            frame_allocator.begin_frame();
+            ky::memory::frame_mark();
+            while (ky::Time::fixed_timestep().consume_step()) {
+                // Fixed rate simulation...
+            }
+
             window_manager.swap_buffers();
             input.poll_events();
+
+            if (ky::Input::key_pressed(ky::KeyCode_F11) && !ky::Profiler::capturing()) {
+                ky::Profiler::begin_capture(120, "kryos_trace.json");
+            }
+            time.end_frame();
         }
     }
     ky::error::shutdown();
@@ -0,0 +1,359 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "assets/asset_pack.h"
+
+#include "core/compression.h"
+#include "core/error.h"
+#include "core/hash.h"
+#include "core/jobs.h"
+#include "core/memory.h"
+#include "core/profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace ky {
+
+static constexpr char _MAGIC[4] = {'K', 'Y', 'P', 'K'};
+
+// Chunked entries decompress their chunks in parallel from this many on
+static constexpr uint32_t _PARALLEL_CHUNK_COUNT = 4;
+
+struct AssetPackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t slot_count;
+    uint64_t toc_offset;
+    uint64_t toc_hash;
+    uint64_t file_size;
+    uint8_t padding[24];
+};
+static_assert(sizeof(AssetPackHeader) == 64, "Asset pack header layout changed");
+
+static inline uint64_t align(uint64_t offset, uint64_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+static inline uint32_t chunk_count(const AssetPackEntry& entry) {
+    return (uint32_t)((entry.uncompressed_size + entry.chunk_size - 1) / entry.chunk_size);
+}
+
+uint64_t AssetPack::hash_path(std::string_view path) {
+    uint64_t hash;
+    if (path.find('\\') == std::string_view::npos) {
+        hash = hash_bytes(path.data(), path.size());
+    } else {
+        std::string normalized(path);
+        std::replace(normalized.begin(), normalized.end(), '\\', '/');
+        hash = hash_bytes(normalized.data(), normalized.size());
+    }
+    // Zero marks empty table slots
+    return hash != 0 ? hash : 1;
+}
+
+bool AssetPack::open(const char* path) {
+    KY_PROFILE_SCOPE("AssetPack::open");
+    close();
+    if (!_file.open(path)) {
+        return false;
+    }
+
+    const AssetPackHeader* header = (const AssetPackHeader*)_file.data();
+    size_t size = _file.size();
+    bool valid = size >= sizeof(AssetPackHeader) &&
+                 std::memcmp(header->magic, _MAGIC, sizeof(_MAGIC)) == 0 &&
+                 header->version == KY_ASSET_PACK_VERSION && header->file_size == size &&
+                 header->slot_count > 0 && (header->slot_count & (header->slot_count - 1)) == 0 &&
+                 header->entry_count < header->slot_count && header->toc_offset <= size &&
+                 (size - header->toc_offset) / sizeof(AssetPackEntry) >= header->slot_count;
+    if (valid) {
+        const AssetPackEntry* slots = (const AssetPackEntry*)(_file.data() + header->toc_offset);
+        valid = hash_bytes(slots, header->slot_count * sizeof(AssetPackEntry)) == header->toc_hash;
+        for (uint32_t i = 0; valid && i < header->slot_count; i++) {
+            const AssetPackEntry& entry = slots[i];
+            valid = entry.path_hash == 0 ||
+                    (entry.offset % KY_ASSET_PACK_ALIGNMENT == 0 &&
+                     entry.offset <= header->toc_offset &&
+                     entry.size <= header->toc_offset - entry.offset &&
+                     (entry.compression == ASSET_COMPRESSION_NONE
+                              ? entry.size == entry.uncompressed_size
+                              : entry.compression == ASSET_COMPRESSION_LZ4 &&
+                                        entry.chunk_size > 0));
+        }
+    }
+    if (!valid) {
+        close();
+        KY_ERROR_MSG("%s is not a supported asset pack", path);
+        return false;
+    }
+
+    _slots = (const AssetPackEntry*)(_file.data() + header->toc_offset);
+    _slot_mask = header->slot_count - 1;
+    _entry_count = header->entry_count;
+    return true;
+}
+
+void AssetPack::close() {
+    _file.close();
+    _slots = nullptr;
+    _slot_mask = 0;
+    _entry_count = 0;
+}
+
+const AssetPackEntry* AssetPack::find(uint64_t path_hash) const {
+    if (_slots == nullptr) {
+        return nullptr;
+    }
+    // The table is at most half full, probes end at an empty slot quickly
+    for (uint32_t index = (uint32_t)path_hash & _slot_mask;; index = (index + 1) & _slot_mask) {
+        const AssetPackEntry& entry = _slots[index];
+        if (entry.path_hash == path_hash) {
+            return &entry;
+        }
+        if (entry.path_hash == 0) {
+            return nullptr;
+        }
+    }
+}
+
+const uint8_t* AssetPack::data(const AssetPackEntry& entry) const {
+    return entry.compression == ASSET_COMPRESSION_NONE ? _file.data() + entry.offset : nullptr;
+}
+
+bool AssetPack::read(const AssetPackEntry& entry, void* destination, bool verify) const {
+    KY_PROFILE_SCOPE("AssetPack::read");
+    KY_ERROR_CONDITION_MSG_RETURN(is_open(), false, "Asset pack is not open");
+    const uint8_t* stored = _file.data() + entry.offset;
+    if (entry.compression == ASSET_COMPRESSION_NONE) {
+        std::memcpy(destination, stored, entry.size);
+    } else if (!decompress(entry, stored, destination)) {
+        return false;
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(
+            !verify || hash_bytes(destination, entry.uncompressed_size) == entry.content_hash,
+            false, "Asset pack entry is corrupt");
+    return true;
+}
+
+bool AssetPack::decompress(const AssetPackEntry& entry, const uint8_t* stored,
+                           void* destination) {
+    uint32_t count = chunk_count(entry);
+    uint64_t table_size = (uint64_t)count * sizeof(uint32_t);
+    KY_ERROR_CONDITION_MSG_RETURN(entry.compression == ASSET_COMPRESSION_LZ4 &&
+                                          table_size <= entry.size,
+                                  false, "Asset pack entry is corrupt");
+
+    // Chunk offsets are needed up front to decompress chunks in parallel
+    ScratchScope scratch;
+    uint64_t* offsets = scratch.allocate<uint64_t>(count + 1);
+    offsets[0] = table_size;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t chunk;
+        std::memcpy(&chunk, stored + i * sizeof(uint32_t), sizeof(chunk));
+        offsets[i + 1] = offsets[i] + (chunk & ~KY_ASSET_PACK_CHUNK_STORED_BIT);
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(offsets[count] <= entry.size, false,
+                                  "Asset pack entry is corrupt");
+
+    auto decompress_chunk = [&](size_t i) {
+        uint32_t chunk;
+        std::memcpy(&chunk, stored + i * sizeof(uint32_t), sizeof(chunk));
+        uint64_t begin = (uint64_t)i * entry.chunk_size;
+        size_t size = (size_t)std::min<uint64_t>(entry.chunk_size,
+                                                 entry.uncompressed_size - begin);
+        uint8_t* output = (uint8_t*)destination + begin;
+        if (chunk & KY_ASSET_PACK_CHUNK_STORED_BIT) {
+            if (offsets[i + 1] - offsets[i] != size) {
+                return false;
+            }
+            std::memcpy(output, stored + offsets[i], size);
+            return true;
+        }
+        return lz4::decompress(stored + offsets[i], offsets[i + 1] - offsets[i], output, size);
+    };
+
+    bool success = true;
+    if (count >= _PARALLEL_CHUNK_COUNT) {
+        std::atomic<bool> failed = false;
+        JobSystem::parallel_for(count, [&](size_t i) {
+            if (!decompress_chunk(i)) {
+                failed.store(true, std::memory_order_relaxed);
+            }
+        });
+        success = !failed.load(std::memory_order_relaxed);
+    } else {
+        for (uint32_t i = 0; i < count && success; i++) {
+            success = decompress_chunk(i);
+        }
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(success, false, "Asset pack entry is corrupt");
+    return true;
+}
+
+AssetPackWriter::~AssetPackWriter() {
+    if (_file != nullptr) {
+        // Unfinished packs have no table of contents, don't leave them behind
+        fclose(_file);
+        std::remove(_path.c_str());
+    }
+}
+
+bool AssetPackWriter::open(const char* path, uint32_t chunk_size) {
+    KY_ERROR_CONDITION_MSG_RETURN(_file == nullptr, false, "Asset pack writer is already open");
+    KY_ERROR_CONDITION_MSG_RETURN(chunk_size > 0 && chunk_size < KY_ASSET_PACK_CHUNK_STORED_BIT,
+                                  false, "Invalid asset pack chunk size");
+    _file = fopen(path, "wb");
+    KY_ERROR_CONDITION_MSG_RETURN(_file != nullptr, false, "Failed to open asset pack file");
+    _path = path;
+    _chunk_size = chunk_size;
+    _offset = 0;
+    _entries.clear();
+    _index.clear();
+    _paths.clear();
+    // The header is written by `finish` once the table of contents is known
+    return _pad_to(sizeof(AssetPackHeader));
+}
+
+bool AssetPackWriter::add(std::string_view path, const void* data, size_t size,
+                          AssetCompression compression) {
+    KY_PROFILE_SCOPE("AssetPackWriter::add");
+    KY_ERROR_CONDITION_MSG_RETURN(_file != nullptr, false, "Asset pack writer is not open");
+    uint64_t path_hash = AssetPack::hash_path(path);
+    if (auto it = _index.find(path_hash); it != _index.end()) {
+        KY_ERROR_MSG("Asset path %.*s hashes the same as %s in the pack", KY_STR(path),
+                     _paths[it->second].c_str());
+        return false;
+    }
+
+    AssetPackEntry entry = {};
+    entry.path_hash = path_hash;
+    entry.uncompressed_size = size;
+    entry.content_hash = hash_bytes(data, size);
+    entry.compression = ASSET_COMPRESSION_NONE;
+    entry.size = size;
+    const uint8_t* stored = (const uint8_t*)data;
+
+    if (compression == ASSET_COMPRESSION_LZ4 && size > 0) {
+        entry.chunk_size = _chunk_size;
+        uint32_t count = (uint32_t)((size + _chunk_size - 1) / _chunk_size);
+        size_t bound = lz4::compress_bound(_chunk_size);
+        _chunks.resize((size_t)count * bound);
+        _chunk_sizes.resize(count);
+        JobSystem::parallel_for(count, [&](size_t i) {
+            size_t begin = i * _chunk_size;
+            size_t chunk = std::min<size_t>(_chunk_size, size - begin);
+            size_t compressed = lz4::compress((const uint8_t*)data + begin, chunk,
+                                              _chunks.data() + i * bound, bound);
+            if (compressed >= chunk) {
+                std::memcpy(_chunks.data() + i * bound, (const uint8_t*)data + begin, chunk);
+                _chunk_sizes[i] = (uint32_t)chunk | KY_ASSET_PACK_CHUNK_STORED_BIT;
+            } else {
+                _chunk_sizes[i] = (uint32_t)compressed;
+            }
+        });
+
+        // Packs the chunk table and chunks behind each other
+        uint64_t stored_size = (uint64_t)count * sizeof(uint32_t);
+        for (uint32_t size_bits : _chunk_sizes) {
+            stored_size += size_bits & ~KY_ASSET_PACK_CHUNK_STORED_BIT;
+        }
+        if (stored_size < size - size / 8) {
+            _packed.resize(stored_size);
+            std::memcpy(_packed.data(), _chunk_sizes.data(), count * sizeof(uint32_t));
+            uint64_t offset = count * sizeof(uint32_t);
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t chunk = _chunk_sizes[i] & ~KY_ASSET_PACK_CHUNK_STORED_BIT;
+                std::memcpy(_packed.data() + offset, _chunks.data() + (size_t)i * bound, chunk);
+                offset += chunk;
+            }
+            entry.compression = ASSET_COMPRESSION_LZ4;
+            entry.size = stored_size;
+            stored = _packed.data();
+        } else {
+            entry.chunk_size = 0;
+        }
+    }
+
+    entry.offset = align(_offset, KY_ASSET_PACK_ALIGNMENT);
+    if (!_pad_to(entry.offset) || !_write(stored, entry.size)) {
+        return false;
+    }
+    _index[path_hash] = (uint32_t)_entries.size();
+    _entries.push_back(entry);
+    _paths.emplace_back(path);
+    return true;
+}
+
+bool AssetPackWriter::finish() {
+    KY_PROFILE_SCOPE("AssetPackWriter::finish");
+    KY_ERROR_CONDITION_MSG_RETURN(_file != nullptr, false, "Asset pack writer is not open");
+
+    // At most half full keeps probe sequences short
+    uint32_t slot_count = 1;
+    while (slot_count < _entries.size() * 2 + 1) {
+        slot_count *= 2;
+    }
+    TaggedVector<AssetPackEntry, MEMORY_TAG_ASSETS> slots(slot_count, AssetPackEntry{});
+    for (const AssetPackEntry& entry : _entries) {
+        uint32_t index = (uint32_t)entry.path_hash & (slot_count - 1);
+        while (slots[index].path_hash != 0) {
+            index = (index + 1) & (slot_count - 1);
+        }
+        slots[index] = entry;
+    }
+
+    AssetPackHeader header = {};
+    std::memcpy(header.magic, _MAGIC, sizeof(_MAGIC));
+    header.version = KY_ASSET_PACK_VERSION;
+    header.entry_count = (uint32_t)_entries.size();
+    header.slot_count = slot_count;
+    header.toc_offset = align(_offset, alignof(AssetPackEntry));
+    header.toc_hash = hash_bytes(slots.data(), slots.size() * sizeof(AssetPackEntry));
+    header.file_size = header.toc_offset + slots.size() * sizeof(AssetPackEntry);
+
+    bool written = _pad_to(header.toc_offset) &&
+                   _write(slots.data(), slots.size() * sizeof(AssetPackEntry)) &&
+                   fseek(_file, 0, SEEK_SET) == 0 &&
+                   fwrite(&header, sizeof(header), 1, _file) == 1;
+    written = fclose(_file) == 0 && written;
+    _file = nullptr;
+    if (!written) {
+        std::remove(_path.c_str());
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(written, false, "Failed to write asset pack");
+    return true;
+}
+
+bool AssetPackWriter::_write(const void* data, size_t size) {
+    bool written = size == 0 || fwrite(data, 1, size, _file) == size;
+    KY_ERROR_CONDITION_MSG_RETURN(written, false, "Failed to write asset pack");
+    _offset += size;
+    return true;
+}
+
+bool AssetPackWriter::_pad_to(uint64_t offset) {
+    static const uint8_t padding[KY_ASSET_PACK_ALIGNMENT] = {};
+    while (_offset < offset) {
+        if (!_write(padding, (size_t)std::min<uint64_t>(offset - _offset, sizeof(padding)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace ky
@@ -0,0 +1,158 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_ASSETS__ASSET_PACK_H
+#define KRYOS_ASSETS__ASSET_PACK_H
+
+#include "core/mapped_file.h"
+#include "core/memory_tracker.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Asset pack file format, all values little endian:
+//
+// A 64 byte header holding the magic "KYPK", the format version, the entry count, the table of
+// contents location and slot count, the file size and a hash of the table. Entry data follows,
+// every entry starting on a `KY_ASSET_PACK_ALIGNMENT` boundary so uncompressed entries can be
+// used in place from a mapping of the file or read with direct I/O. The table of contents comes
+// last, an open addressing hash table with a power of two slot count indexed by path hash and
+// probed linearly, where empty slots have a path hash of 0.
+//
+// Compressed entries are split into chunks of `chunk_size` uncompressed bytes that decompress
+// independently. Their data starts with one u32 per chunk holding its compressed size, with
+// `KY_ASSET_PACK_CHUNK_STORED_BIT` set for chunks stored as is because they didn't compress.
+
+#define KY_ASSET_PACK_VERSION 1
+
+#ifndef KY_ASSET_PACK_ALIGNMENT
+#    define KY_ASSET_PACK_ALIGNMENT 4096
+#endif
+
+#ifndef KY_ASSET_PACK_CHUNK_SIZE
+#    define KY_ASSET_PACK_CHUNK_SIZE (64 * 1024)
+#endif
+
+#define KY_ASSET_PACK_CHUNK_STORED_BIT 0x80000000u
+
+namespace ky {
+
+enum AssetCompression : uint32_t {
+    ASSET_COMPRESSION_NONE,
+    ASSET_COMPRESSION_LZ4,
+};
+
+struct AssetPackEntry {
+    uint64_t path_hash;
+    uint64_t offset;
+    // Bytes stored in the pack, including the chunk table of compressed entries
+    uint64_t size;
+    uint64_t uncompressed_size;
+    // Hash of the uncompressed data
+    uint64_t content_hash;
+    AssetCompression compression;
+    uint32_t chunk_size;
+};
+
+// Read only view of a pack file. Lookups are a single probe sequence in the mapped table of
+// contents, so opening a pack costs one file open no matter how many assets it holds.
+class AssetPack {
+public:
+    // Path hash assets are looked up by. Backslashes are treated as forward slashes.
+    static uint64_t hash_path(std::string_view path);
+
+    bool open(const char* path);
+    void close();
+    inline bool is_open() const { return _file.is_open(); }
+
+    // Null when the pack doesn't contain the path.
+    const AssetPackEntry* find(uint64_t path_hash) const;
+    inline const AssetPackEntry* find(std::string_view path) const {
+        return find(hash_path(path));
+    }
+
+    // Zero copy access to an uncompressed entry, null for compressed ones.
+    const uint8_t* data(const AssetPackEntry& entry) const;
+
+    // Copies or decompresses an entry into `destination`, which holds `uncompressed_size` bytes.
+    // With `verify` the result is checked against the content hash.
+    bool read(const AssetPackEntry& entry, void* destination, bool verify = false) const;
+
+    // Decompresses the chunks of a compressed entry's stored bytes, for data read into memory by
+    // other means than the mapping.
+    static bool decompress(const AssetPackEntry& entry, const uint8_t* stored, void* destination);
+
+    // Index of an entry in [0, slot_count()), stable for as long as the pack is open, for tables
+    // of per asset state.
+    inline uint32_t index(const AssetPackEntry& entry) const {
+        return (uint32_t)(&entry - _slots);
+    }
+    inline uint32_t slot_count() const { return _slots != nullptr ? _slot_mask + 1 : 0; }
+
+    inline uint32_t size() const { return _entry_count; }
+    inline const MappedFile& file() const { return _file; }
+
+private:
+    MappedFile _file;
+    const AssetPackEntry* _slots = nullptr;
+    uint32_t _slot_mask = 0;
+    uint32_t _entry_count = 0;
+};
+
+// Writes a pack file, entries are appended to the file as they're added and the table of
+// contents is written by `finish`.
+class AssetPackWriter {
+public:
+    AssetPackWriter() = default;
+    ~AssetPackWriter();
+
+    AssetPackWriter(const AssetPackWriter&) = delete;
+    AssetPackWriter& operator=(const AssetPackWriter&) = delete;
+
+    bool open(const char* path, uint32_t chunk_size = KY_ASSET_PACK_CHUNK_SIZE);
+    // Compressed entries fall back to being stored when compression saves less than an eighth,
+    // keeping them zero copy.
+    bool add(std::string_view path, const void* data, size_t size,
+             AssetCompression compression = ASSET_COMPRESSION_LZ4);
+    bool finish();
+
+    inline uint64_t stored_bytes() const { return _offset; }
+
+private:
+    FILE* _file = nullptr;
+    std::string _path;
+    uint32_t _chunk_size = KY_ASSET_PACK_CHUNK_SIZE;
+    uint64_t _offset = 0;
+    TaggedVector<AssetPackEntry, MEMORY_TAG_ASSETS> _entries;
+    TaggedVector<std::string, MEMORY_TAG_ASSETS> _paths;
+    // Entry index by path hash, catches hash collisions while writing
+    std::unordered_map<uint64_t, uint32_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                       TaggedAllocator<std::pair<const uint64_t, uint32_t>, MEMORY_TAG_ASSETS>>
+            _index;
+    // Compression buffers reused between entries
+    TaggedVector<uint8_t, MEMORY_TAG_ASSETS> _chunks;
+    TaggedVector<uint32_t, MEMORY_TAG_ASSETS> _chunk_sizes;
+    TaggedVector<uint8_t, MEMORY_TAG_ASSETS> _packed;
+
+    bool _write(const void* data, size_t size);
+    bool _pad_to(uint64_t offset);
+};
+
+} // namespace ky
+
+#endif
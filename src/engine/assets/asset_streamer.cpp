@@ -0,0 +1,454 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "assets/asset_streamer.h"
+
+#include "core/error.h"
+#include "core/hash.h"
+#include "core/profiler.h"
+
+#include <algorithm>
+
+namespace ky {
+
+AssetHandle::AssetHandle(AssetStreamer* streamer, uint32_t index)
+    : _streamer(streamer), _index(index) {}
+
+AssetHandle::~AssetHandle() {
+    reset();
+}
+
+AssetHandle::AssetHandle(const AssetHandle& other)
+    : _streamer(other._streamer), _index(other._index) {
+    if (_streamer != nullptr) {
+        _streamer->_assets[_index].references.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+AssetHandle& AssetHandle::operator=(const AssetHandle& other) {
+    if (this != &other) {
+        AssetHandle copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+AssetHandle::AssetHandle(AssetHandle&& other) : _streamer(other._streamer), _index(other._index) {
+    other._streamer = nullptr;
+    other._index = KY_ASSET_INVALID_INDEX;
+}
+
+AssetHandle& AssetHandle::operator=(AssetHandle&& other) {
+    if (this != &other) {
+        reset();
+        std::swap(_streamer, other._streamer);
+        std::swap(_index, other._index);
+    }
+    return *this;
+}
+
+void AssetHandle::reset() {
+    if (_streamer != nullptr) {
+        _streamer->_release(_index);
+    }
+    _streamer = nullptr;
+    _index = KY_ASSET_INVALID_INDEX;
+}
+
+AssetState AssetHandle::state() const {
+    if (_streamer == nullptr) {
+        return ASSET_STATE_UNLOADED;
+    }
+    return _streamer->_assets[_index].state.load(std::memory_order_acquire);
+}
+
+const uint8_t* AssetHandle::data() const {
+    // The acquire load of the state makes the data written by the streaming thread visible
+    return state() == ASSET_STATE_READY ? _streamer->_assets[_index].data : nullptr;
+}
+
+uint64_t AssetHandle::size() const {
+    return _streamer != nullptr ? _streamer->_assets[_index].entry->uncompressed_size : 0;
+}
+
+AssetStreamer::~AssetStreamer() {
+    shutdown();
+}
+
+bool AssetStreamer::init(const char* pack_path, const AssetStreamerSettings& settings) {
+    shutdown();
+    if (!_pack.open(pack_path)) {
+        return false;
+    }
+    if (!_file.open(pack_path)) {
+        _pack.close();
+        return false;
+    }
+    _settings = settings;
+    _assets = TaggedVector<_Asset, MEMORY_TAG_ASSETS>(_pack.slot_count());
+    _io.init(settings.backend, settings.queue_depth, settings.io_thread_count);
+
+    _running = true;
+    _thread = std::thread([this]() { _stream_main(); });
+    return true;
+}
+
+void AssetStreamer::shutdown() {
+    if (_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _running = false;
+        }
+        _condition.notify_one();
+        _thread.join();
+    }
+
+    uint32_t referenced = 0;
+    for (_Asset& asset : _assets) {
+        if (asset.references.load(std::memory_order_relaxed) > 0) {
+            referenced++;
+        }
+        if (asset.data != nullptr) {
+            memory::deallocate(asset.data, asset.entry->uncompressed_size, MEMORY_TAG_ASSETS);
+        }
+        if (asset.staging != nullptr) {
+            memory::deallocate(asset.staging, asset.entry->size, MEMORY_TAG_ASSETS);
+        }
+    }
+    if (referenced > 0) {
+        KY_ERROR_MSG("%u asset handles outlived the asset streamer", referenced);
+    }
+
+    _io.shutdown();
+    _file.close();
+    _pack.close();
+    _assets.clear();
+    _requests.clear();
+    _request_sequence = 0;
+    _lru_head = KY_ASSET_INVALID_INDEX;
+    _lru_tail = KY_ASSET_INVALID_INDEX;
+    _stats = {};
+    _loading_bytes = 0;
+    _issuing = KY_ASSET_INVALID_INDEX;
+    _issue_offset = 0;
+}
+
+AssetHandle AssetStreamer::request(uint64_t path_hash, AssetPriority priority) {
+    KY_ERROR_CONDITION_MSG_RETURN(is_running(), AssetHandle(), "Asset streamer isn't running");
+    const AssetPackEntry* entry = _pack.find(path_hash);
+    if (entry == nullptr) {
+        KY_ERROR_MSG("Asset %016llx isn't in the pack", (unsigned long long)path_hash);
+        return AssetHandle();
+    }
+
+    uint32_t index = _pack.index(*entry);
+    _Asset& asset = _assets[index];
+    std::lock_guard<std::mutex> lock(_mutex);
+    // Set once, the streaming thread reads it without the lock while loading
+    if (asset.entry == nullptr) {
+        asset.entry = entry;
+    }
+    asset.references.fetch_add(1, std::memory_order_relaxed);
+    if (asset.cached) {
+        _lru_remove(index);
+    }
+
+    switch (asset.state.load(std::memory_order_relaxed)) {
+        case ASSET_STATE_UNLOADED:
+            asset.priority = priority;
+            asset.state.store(ASSET_STATE_QUEUED, std::memory_order_relaxed);
+            _stats.queued_count++;
+            _push_request(index);
+            _condition.notify_one();
+            break;
+        case ASSET_STATE_QUEUED:
+            if (priority > asset.priority) {
+                asset.priority = priority;
+                _push_request(index);
+            }
+            break;
+        case ASSET_STATE_LOADING:
+            asset.cancelled = false;
+            break;
+        default:
+            break;
+    }
+    return AssetHandle(this, index);
+}
+
+void AssetStreamer::set_memory_budget(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _settings.memory_budget = bytes;
+    _evict(0);
+}
+
+AssetStreamerStats AssetStreamer::stats() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+void AssetStreamer::_release(uint32_t index) {
+    _Asset& asset = _assets[index];
+    if (asset.references.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    // Requested again before the lock was taken. A request and release in between can also have
+    // dropped the count to 0 again and run the transition already, so each case checks the state
+    // it moves away from.
+    if (asset.references.load(std::memory_order_relaxed) != 0) {
+        return;
+    }
+
+    switch (asset.state.load(std::memory_order_relaxed)) {
+        case ASSET_STATE_QUEUED:
+            // Leaves a stale entry in the request queue, skipped when it reaches the top
+            asset.request_ticket++;
+            asset.state.store(ASSET_STATE_UNLOADED, std::memory_order_relaxed);
+            _stats.queued_count--;
+            _stats.cancelled_count++;
+            break;
+        case ASSET_STATE_LOADING:
+            asset.cancelled = true;
+            break;
+        case ASSET_STATE_READY:
+            if (!asset.cached) {
+                _lru_push(index);
+                _evict(0);
+            }
+            break;
+        case ASSET_STATE_FAILED:
+            // Lets a later request try again
+            asset.state.store(ASSET_STATE_UNLOADED, std::memory_order_relaxed);
+            break;
+        default:
+            break;
+    }
+}
+
+void AssetStreamer::_push_request(uint32_t index) {
+    _Asset& asset = _assets[index];
+    asset.request_ticket++;
+    _requests.push_back({asset.priority, index, asset.request_ticket, _request_sequence++});
+    std::push_heap(_requests.begin(), _requests.end());
+}
+
+void AssetStreamer::_lru_push(uint32_t index) {
+    _Asset& asset = _assets[index];
+    asset.lru_previous = _lru_tail;
+    asset.lru_next = KY_ASSET_INVALID_INDEX;
+    if (_lru_tail != KY_ASSET_INVALID_INDEX) {
+        _assets[_lru_tail].lru_next = index;
+    } else {
+        _lru_head = index;
+    }
+    _lru_tail = index;
+    asset.cached = true;
+    _stats.cached_bytes += asset.entry->uncompressed_size;
+}
+
+void AssetStreamer::_lru_remove(uint32_t index) {
+    _Asset& asset = _assets[index];
+    if (asset.lru_previous != KY_ASSET_INVALID_INDEX) {
+        _assets[asset.lru_previous].lru_next = asset.lru_next;
+    } else {
+        _lru_head = asset.lru_next;
+    }
+    if (asset.lru_next != KY_ASSET_INVALID_INDEX) {
+        _assets[asset.lru_next].lru_previous = asset.lru_previous;
+    } else {
+        _lru_tail = asset.lru_previous;
+    }
+    asset.lru_previous = KY_ASSET_INVALID_INDEX;
+    asset.lru_next = KY_ASSET_INVALID_INDEX;
+    asset.cached = false;
+    _stats.cached_bytes -= asset.entry->uncompressed_size;
+}
+
+void AssetStreamer::_evict(uint64_t incoming_bytes) {
+    while (_lru_head != KY_ASSET_INVALID_INDEX &&
+           _stats.resident_bytes + incoming_bytes > _settings.memory_budget) {
+        uint32_t index = _lru_head;
+        _lru_remove(index);
+        _unload(_assets[index]);
+        _stats.evicted_count++;
+    }
+}
+
+void AssetStreamer::_unload(_Asset& asset) {
+    if (asset.data != nullptr) {
+        memory::deallocate(asset.data, asset.entry->uncompressed_size, MEMORY_TAG_ASSETS);
+        asset.data = nullptr;
+    }
+    _stats.resident_bytes -= asset.entry->uncompressed_size;
+    asset.state.store(ASSET_STATE_UNLOADED, std::memory_order_relaxed);
+}
+
+void AssetStreamer::_stream_main() {
+    Profiler::set_thread_name("Asset streamer");
+    TaggedVector<AsyncReadResult, MEMORY_TAG_ASSETS> results(_io.depth());
+    TaggedVector<uint32_t, MEMORY_TAG_ASSETS> finished;
+
+    while (true) {
+        bool running;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_io.in_flight() == 0) {
+                _condition.wait(lock, [&]() { return !_running || !_requests.empty(); });
+            }
+            running = _running;
+            if (running) {
+                _issue_reads();
+            }
+        }
+        // Stopping waits for the reads in flight, their buffers are released by `shutdown`
+        if (_io.in_flight() == 0) {
+            if (!running) {
+                return;
+            }
+            continue;
+        }
+
+        KY_PROFILE_SCOPE("AssetStreamer::stream");
+        _io.submit();
+        uint32_t count = _io.collect(results.data(), (uint32_t)results.size(), 1);
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t index = (uint32_t)results[i].user_data;
+            _Asset& asset = _assets[index];
+            asset.pending_reads--;
+            asset.read_failed |= !results[i].success;
+            // Reads of the asset still being issued can all finish before its last one is queued
+            if (asset.pending_reads == 0 && index != _issuing) {
+                finished.push_back(index);
+            }
+        }
+        if (!running) {
+            continue;
+        }
+
+        // Refill the queue first so the device stays busy while this thread decompresses
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _issue_reads();
+        }
+        _io.submit();
+        for (uint32_t index : finished) {
+            _finish_load(index);
+        }
+        finished.clear();
+    }
+}
+
+bool AssetStreamer::_begin_load() {
+    while (!_requests.empty()) {
+        const _Request& request = _requests.front();
+        _Asset& asset = _assets[request.index];
+        if (request.ticket != asset.request_ticket ||
+            asset.state.load(std::memory_order_relaxed) != ASSET_STATE_QUEUED) {
+            std::pop_heap(_requests.begin(), _requests.end());
+            _requests.pop_back();
+            continue;
+        }
+        // A load always starts when nothing is loading, so assets larger than the limit still
+        // make progress
+        const AssetPackEntry& entry = *asset.entry;
+        if (_loading_bytes > 0 && _loading_bytes + entry.size > _settings.max_loading_bytes) {
+            return false;
+        }
+        uint32_t index = request.index;
+        std::pop_heap(_requests.begin(), _requests.end());
+        _requests.pop_back();
+        _stats.queued_count--;
+
+        _evict(entry.uncompressed_size);
+        _stats.resident_bytes += entry.uncompressed_size;
+        if (entry.uncompressed_size > 0) {
+            asset.data = (uint8_t*)memory::allocate(entry.uncompressed_size, MEMORY_TAG_ASSETS);
+        }
+        if (entry.size == 0) {
+            asset.state.store(ASSET_STATE_READY, std::memory_order_release);
+            _stats.loaded_count++;
+            continue;
+        }
+        if (entry.compression != ASSET_COMPRESSION_NONE) {
+            asset.staging = (uint8_t*)memory::allocate(entry.size, MEMORY_TAG_ASSETS);
+        }
+        asset.cancelled = false;
+        asset.read_failed = false;
+        asset.pending_reads = 0;
+        asset.state.store(ASSET_STATE_LOADING, std::memory_order_relaxed);
+        _stats.loading_count++;
+        _loading_bytes += entry.size;
+        _issuing = index;
+        _issue_offset = 0;
+        return true;
+    }
+    return false;
+}
+
+void AssetStreamer::_issue_reads() {
+    while (!_io.full()) {
+        if (_issuing == KY_ASSET_INVALID_INDEX && !_begin_load()) {
+            return;
+        }
+        _Asset& asset = _assets[_issuing];
+        const AssetPackEntry& entry = *asset.entry;
+        uint8_t* destination = asset.staging != nullptr ? asset.staging : asset.data;
+        uint32_t size = (uint32_t)std::min<uint64_t>(KY_ASSET_STREAMER_READ_SIZE,
+                                                     entry.size - _issue_offset);
+        _io.read({&_file, entry.offset + _issue_offset, destination + _issue_offset, size,
+                  _issuing});
+        asset.pending_reads++;
+        _issue_offset += size;
+        if (_issue_offset == entry.size) {
+            _issuing = KY_ASSET_INVALID_INDEX;
+        }
+    }
+}
+
+void AssetStreamer::_finish_load(uint32_t index) {
+    _Asset& asset = _assets[index];
+    const AssetPackEntry& entry = *asset.entry;
+    bool success = !asset.read_failed;
+    if (success && asset.staging != nullptr) {
+        success = AssetPack::decompress(entry, asset.staging, asset.data);
+    }
+    if (success && _settings.verify) {
+        success = hash_bytes(asset.data, entry.uncompressed_size) == entry.content_hash;
+    }
+    if (asset.staging != nullptr) {
+        memory::deallocate(asset.staging, entry.size, MEMORY_TAG_ASSETS);
+        asset.staging = nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _loading_bytes -= entry.size;
+    _stats.loading_count--;
+    _stats.bytes_read += entry.size;
+    if (asset.cancelled) {
+        _unload(asset);
+        _stats.cancelled_count++;
+    } else if (!success) {
+        _unload(asset);
+        asset.state.store(ASSET_STATE_FAILED, std::memory_order_relaxed);
+        _stats.failed_count++;
+        KY_ERROR_MSG("Failed to stream asset %016llx", (unsigned long long)entry.path_hash);
+    } else {
+        asset.state.store(ASSET_STATE_READY, std::memory_order_release);
+        _stats.loaded_count++;
+    }
+}
+
+} // namespace ky
@@ -0,0 +1,233 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_ASSETS__ASSET_STREAMER_H
+#define KRYOS_ASSETS__ASSET_STREAMER_H
+
+#include "assets/asset_pack.h"
+#include "core/async_io.h"
+#include "core/memory_tracker.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+// Largest single read, bigger assets are split so their reads spread over the queue and a large
+// asset doesn't hold up everything queued behind it
+#ifndef KY_ASSET_STREAMER_READ_SIZE
+#    define KY_ASSET_STREAMER_READ_SIZE (1024 * 1024)
+#endif
+
+#define KY_ASSET_INVALID_INDEX UINT32_MAX
+
+namespace ky {
+
+class AssetStreamer;
+
+enum AssetPriority : uint8_t {
+    ASSET_PRIORITY_LOW,
+    ASSET_PRIORITY_NORMAL,
+    ASSET_PRIORITY_HIGH,
+    // Needed this frame, e.g. something the camera is about to see
+    ASSET_PRIORITY_CRITICAL,
+    ASSET_PRIORITY_COUNT,
+};
+
+enum AssetState : uint32_t {
+    ASSET_STATE_UNLOADED,
+    ASSET_STATE_QUEUED,
+    ASSET_STATE_LOADING,
+    ASSET_STATE_READY,
+    ASSET_STATE_FAILED,
+};
+
+struct AssetStreamerSettings {
+    AsyncIoBackend backend = ASYNC_IO_BACKEND_IO_URING;
+    uint32_t queue_depth = KY_ASYNC_IO_QUEUE_DEPTH;
+    // Threads reading when the thread pool backend is used
+    uint32_t io_thread_count = 4;
+    // Resident bytes above which unreferenced assets are evicted, least recently used first
+    uint64_t memory_budget = 512ull * 1024 * 1024;
+    // Stored bytes being read at once, bounds the memory of loads that haven't finished
+    uint64_t max_loading_bytes = 64ull * 1024 * 1024;
+    // Checks loaded assets against their content hash
+    bool verify = false;
+};
+
+struct AssetStreamerStats {
+    // Uncompressed bytes of loaded and loading assets
+    uint64_t resident_bytes;
+    // The part of `resident_bytes` without references, evictable
+    uint64_t cached_bytes;
+    uint64_t bytes_read;
+    uint32_t queued_count;
+    uint32_t loading_count;
+    uint64_t loaded_count;
+    uint64_t evicted_count;
+    uint64_t cancelled_count;
+    uint64_t failed_count;
+};
+
+// Reference counted handle to a streamed asset. Its data can be used once `ready`, it stays
+// resident until the last handle to it is released.
+class AssetHandle {
+public:
+    AssetHandle() = default;
+    ~AssetHandle();
+
+    AssetHandle(const AssetHandle& other);
+    AssetHandle& operator=(const AssetHandle& other);
+    AssetHandle(AssetHandle&& other);
+    AssetHandle& operator=(AssetHandle&& other);
+
+    void reset();
+    inline bool valid() const { return _streamer != nullptr; }
+
+    AssetState state() const;
+    inline bool ready() const { return state() == ASSET_STATE_READY; }
+    inline bool failed() const { return state() == ASSET_STATE_FAILED; }
+
+    // Uncompressed asset data, null until ready.
+    const uint8_t* data() const;
+    uint64_t size() const;
+
+private:
+    friend class AssetStreamer;
+
+    AssetStreamer* _streamer = nullptr;
+    uint32_t _index = KY_ASSET_INVALID_INDEX;
+
+    AssetHandle(AssetStreamer* streamer, uint32_t index);
+};
+
+// Streams assets out of a pack in the background. `request` only queues work and returns right
+// away, so it's safe to call from the frame loop, a streaming thread issues the reads in
+// priority order and decompresses what they return.
+//
+// Dropping the last handle to an asset that's still queued cancels it, one that's already being
+// read is discarded once the read finished. Loaded assets without handles stay cached until the
+// memory budget needs their space. Referenced assets are never evicted, so the budget can be
+// exceeded by what's in use.
+//
+// Requests and handles can be used from any thread, all handles have to be released before the
+// streamer shuts down.
+class AssetStreamer {
+public:
+    AssetStreamer() = default;
+    ~AssetStreamer();
+
+    AssetStreamer(const AssetStreamer&) = delete;
+    AssetStreamer& operator=(const AssetStreamer&) = delete;
+
+    bool init(const char* pack_path, const AssetStreamerSettings& settings = {});
+    void shutdown();
+    inline bool is_running() const { return _thread.joinable(); }
+
+    // Invalid handle when the pack doesn't contain the asset. Requesting an asset again raises
+    // its priority if it's still queued.
+    AssetHandle request(uint64_t path_hash, AssetPriority priority = ASSET_PRIORITY_NORMAL);
+    inline AssetHandle request(std::string_view path,
+                               AssetPriority priority = ASSET_PRIORITY_NORMAL) {
+        return request(AssetPack::hash_path(path), priority);
+    }
+
+    void set_memory_budget(uint64_t bytes);
+    AssetStreamerStats stats();
+
+    inline AsyncIoBackend backend() const { return _io.backend(); }
+    inline const AssetPack& pack() const { return _pack; }
+
+private:
+    friend class AssetHandle;
+
+    struct _Asset {
+        const AssetPackEntry* entry = nullptr;
+        uint8_t* data = nullptr;
+        // Stored bytes of compressed assets while they're read
+        uint8_t* staging = nullptr;
+        std::atomic<uint32_t> references = 0;
+        std::atomic<AssetState> state = ASSET_STATE_UNLOADED;
+        AssetPriority priority = ASSET_PRIORITY_LOW;
+        // The last handle was released while loading, the result is discarded
+        bool cancelled = false;
+        // Owned by the streaming thread while loading
+        bool read_failed = false;
+        uint32_t pending_reads = 0;
+        // Identifies the current entry in the request queue, older entries are stale
+        uint32_t request_ticket = 0;
+        // Unreferenced loaded assets form a least recently used list
+        bool cached = false;
+        uint32_t lru_previous = KY_ASSET_INVALID_INDEX;
+        uint32_t lru_next = KY_ASSET_INVALID_INDEX;
+    };
+
+    struct _Request {
+        AssetPriority priority;
+        uint32_t index;
+        uint32_t ticket;
+        uint64_t sequence;
+
+        // Heap order, the highest priority and then the oldest request is the largest
+        inline bool operator<(const _Request& other) const {
+            if (priority != other.priority) {
+                return priority < other.priority;
+            }
+            return sequence > other.sequence;
+        }
+    };
+
+    AssetPack _pack;
+    AsyncFile _file;
+    AsyncIoQueue _io;
+    AssetStreamerSettings _settings;
+    TaggedVector<_Asset, MEMORY_TAG_ASSETS> _assets;
+
+    // Guards the request queue, the LRU list, the statistics and the state transitions of assets
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::thread _thread;
+    bool _running = false;
+
+    // Binary heap with the highest priority, then oldest request first
+    TaggedVector<_Request, MEMORY_TAG_ASSETS> _requests;
+    uint64_t _request_sequence = 0;
+    uint32_t _lru_head = KY_ASSET_INVALID_INDEX;
+    uint32_t _lru_tail = KY_ASSET_INVALID_INDEX;
+    AssetStreamerStats _stats = {};
+    uint64_t _loading_bytes = 0;
+
+    // Asset whose reads are partially queued, owned by the streaming thread
+    uint32_t _issuing = KY_ASSET_INVALID_INDEX;
+    uint64_t _issue_offset = 0;
+
+    void _release(uint32_t index);
+    void _push_request(uint32_t index);
+    void _lru_push(uint32_t index);
+    void _lru_remove(uint32_t index);
+    void _evict(uint64_t incoming_bytes);
+    void _unload(_Asset& asset);
+
+    void _stream_main();
+    bool _begin_load();
+    void _issue_reads();
+    void _finish_load(uint32_t index);
+};
+
+} // namespace ky
+
+#endif
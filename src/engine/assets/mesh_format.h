@@ -0,0 +1,68 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_ASSETS__MESH_FORMAT_H
+#define KRYOS_ASSETS__MESH_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Cooked mesh blob: a `MeshHeader` followed by `vertex_count` vertices and `index_count` u32
+// triangle list indices, laid out to be uploaded to vertex and index buffers as they are.
+
+#define KY_MESH_FORMAT_VERSION 1
+#define KY_MESH_MAGIC          "KYMS"
+
+namespace ky {
+
+struct MeshVertex {
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+
+struct MeshHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    float bounds_min[3];
+    float bounds_max[3];
+};
+
+// Checks a cooked blob and returns its header, null when it isn't a supported mesh.
+inline const MeshHeader* mesh_header(const void* data, size_t size) {
+    const MeshHeader* header = (const MeshHeader*)data;
+    if (size < sizeof(MeshHeader) || std::memcmp(header->magic, KY_MESH_MAGIC, 4) != 0 ||
+        header->version != KY_MESH_FORMAT_VERSION) {
+        return nullptr;
+    }
+    uint64_t expected = sizeof(MeshHeader) + (uint64_t)header->vertex_count * sizeof(MeshVertex) +
+                        (uint64_t)header->index_count * sizeof(uint32_t);
+    return expected == size ? header : nullptr;
+}
+
+inline const MeshVertex* mesh_vertices(const MeshHeader* header) {
+    return (const MeshVertex*)(header + 1);
+}
+
+inline const uint32_t* mesh_indices(const MeshHeader* header) {
+    return (const uint32_t*)(mesh_vertices(header) + header->vertex_count);
+}
+
+} // namespace ky
+
+#endif
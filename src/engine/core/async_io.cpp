@@ -0,0 +1,549 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/async_io.h"
+
+#include "core/error.h"
+#include "core/profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#ifdef KY_PLATFORM_WINDOWS
+#    define WIN32_LEAN_AND_MEAN
+#    define NOMINMAX
+#    include <windows.h>
+#else
+#    include <cerrno>
+#    include <fcntl.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+#ifdef KY_PLATFORM_LINUX
+#    include <linux/io_uring.h>
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#endif
+
+namespace ky {
+
+AsyncFile::~AsyncFile() {
+    close();
+}
+
+AsyncFile::AsyncFile(AsyncFile&& other) {
+    *this = std::move(other);
+}
+
+AsyncFile& AsyncFile::operator=(AsyncFile&& other) {
+    if (this != &other) {
+        close();
+#ifdef KY_PLATFORM_WINDOWS
+        std::swap(_handle, other._handle);
+#else
+        std::swap(_descriptor, other._descriptor);
+#endif
+        std::swap(_size, other._size);
+    }
+    return *this;
+}
+
+#ifdef KY_PLATFORM_WINDOWS
+
+bool AsyncFile::open(const char* path) {
+    close();
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    KY_ERROR_CONDITION_MSG_RETURN(handle != INVALID_HANDLE_VALUE, false, "Failed to open file");
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size)) {
+        CloseHandle(handle);
+        KY_ERROR_MSG("Failed to query the size of %s", path);
+        return false;
+    }
+    _handle = handle;
+    _size = (uint64_t)size.QuadPart;
+    return true;
+}
+
+void AsyncFile::close() {
+    if (_handle != nullptr) {
+        CloseHandle((HANDLE)_handle);
+    }
+    _handle = nullptr;
+    _size = 0;
+}
+
+bool AsyncFile::read(uint64_t offset, void* destination, size_t size) const {
+    uint8_t* output = (uint8_t*)destination;
+    while (size > 0) {
+        // The offset is taken from the overlapped structure so threads don't race on the file
+        // pointer
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD chunk = (DWORD)std::min<size_t>(size, 1u << 30);
+        DWORD read = 0;
+        if (!ReadFile((HANDLE)_handle, output, chunk, &read, &overlapped) || read == 0) {
+            return false;
+        }
+        output += read;
+        offset += read;
+        size -= read;
+    }
+    return true;
+}
+
+#else
+
+bool AsyncFile::open(const char* path) {
+    close();
+    int descriptor = ::open(path, O_RDONLY | O_CLOEXEC);
+    KY_ERROR_CONDITION_MSG_RETURN(descriptor >= 0, false, "Failed to open file");
+    struct stat status;
+    if (fstat(descriptor, &status) != 0) {
+        ::close(descriptor);
+        KY_ERROR_MSG("Failed to query the size of %s", path);
+        return false;
+    }
+    _descriptor = descriptor;
+    _size = (uint64_t)status.st_size;
+    return true;
+}
+
+void AsyncFile::close() {
+    if (_descriptor >= 0) {
+        ::close(_descriptor);
+    }
+    _descriptor = -1;
+    _size = 0;
+}
+
+bool AsyncFile::read(uint64_t offset, void* destination, size_t size) const {
+    uint8_t* output = (uint8_t*)destination;
+    while (size > 0) {
+        ssize_t read = pread(_descriptor, output, size, (off_t)offset);
+        if (read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read <= 0) {
+            return false;
+        }
+        output += read;
+        offset += (uint64_t)read;
+        size -= (size_t)read;
+    }
+    return true;
+}
+
+#endif
+
+AsyncIoQueue::~AsyncIoQueue() {
+    shutdown();
+}
+
+bool AsyncIoQueue::supported(AsyncIoBackend backend) {
+    switch (backend) {
+        case ASYNC_IO_BACKEND_THREAD_POOL:
+            return true;
+        case ASYNC_IO_BACKEND_IO_URING: {
+#ifdef KY_PLATFORM_LINUX
+            // Probed once, io_uring can be missing from the kernel or blocked by seccomp. Plain
+            // reads arrived in 5.6 together with IORING_FEAT_RW_CUR_POS, which saves a probe of
+            // the opcode itself
+            static const bool available = []() {
+                io_uring_params params = {};
+                int ring = (int)syscall(__NR_io_uring_setup, 1, &params);
+                if (ring < 0) {
+                    return false;
+                }
+                ::close(ring);
+                return (params.features & IORING_FEAT_RW_CUR_POS) != 0;
+            }();
+            return available;
+#else
+            return false;
+#endif
+        }
+        default:
+            return false;
+    }
+}
+
+const char* AsyncIoQueue::backend_name(AsyncIoBackend backend) {
+    switch (backend) {
+        case ASYNC_IO_BACKEND_THREAD_POOL:
+            return "thread pool";
+        case ASYNC_IO_BACKEND_IO_URING:
+            return "io_uring";
+        default:
+            return "unknown";
+    }
+}
+
+bool AsyncIoQueue::init(AsyncIoBackend backend, uint32_t depth, uint32_t thread_count) {
+    shutdown();
+    KY_ERROR_CONDITION_MSG_RETURN(depth > 0, false, "Async I/O queue depth must not be 0");
+
+    _slots.resize(depth);
+    for (uint32_t i = 0; i < depth; i++) {
+        _slots[i].next_free = i + 1 < depth ? i + 1 : UINT32_MAX;
+    }
+    _free_slot = 0;
+    _queued.reserve(depth);
+
+    if (supported(backend) && backend == ASYNC_IO_BACKEND_IO_URING && _uring_init(depth)) {
+        _backend = ASYNC_IO_BACKEND_IO_URING;
+        return true;
+    }
+
+    _backend = ASYNC_IO_BACKEND_THREAD_POOL;
+    _pending.resize(depth);
+    _finished.reserve(depth);
+    _pool_running = true;
+    thread_count = std::max(thread_count, 1u);
+    for (uint32_t i = 0; i < thread_count; i++) {
+        _threads.emplace_back([this]() { _pool_main(); });
+    }
+    return true;
+}
+
+void AsyncIoQueue::shutdown() {
+    AsyncReadResult results[64];
+    while (_in_flight > 0) {
+        collect(results, 64, 1);
+    }
+
+    _uring_shutdown();
+    if (!_threads.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(_pool_mutex);
+            _pool_running = false;
+        }
+        _pending_condition.notify_all();
+        for (std::thread& thread : _threads) {
+            thread.join();
+        }
+        _threads.clear();
+    }
+    _slots.clear();
+    _queued.clear();
+    _pending.clear();
+    _finished.clear();
+    _free_slot = UINT32_MAX;
+    _pending_head = 0;
+    _pending_count = 0;
+}
+
+bool AsyncIoQueue::read(const AsyncRead& read) {
+    uint32_t slot = _allocate_slot();
+    if (slot == UINT32_MAX) {
+        return false;
+    }
+    _slots[slot].read = read;
+    _slots[slot].done = 0;
+    _in_flight++;
+    if (_uring != nullptr) {
+        _uring_push(slot);
+    } else {
+        _queued.push_back(slot);
+    }
+    return true;
+}
+
+void AsyncIoQueue::submit() {
+    if (_uring != nullptr) {
+        _uring_enter(0);
+        return;
+    }
+    if (_queued.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_pool_mutex);
+        uint32_t capacity = (uint32_t)_pending.size();
+        for (uint32_t slot : _queued) {
+            _pending[(_pending_head + _pending_count) % capacity] = slot;
+            _pending_count++;
+        }
+    }
+    if (_queued.size() == 1) {
+        _pending_condition.notify_one();
+    } else {
+        _pending_condition.notify_all();
+    }
+    _queued.clear();
+}
+
+uint32_t AsyncIoQueue::collect(AsyncReadResult* results, uint32_t capacity,
+                               uint32_t min_count) {
+    submit();
+    min_count = std::min(min_count, std::min(capacity, _in_flight));
+
+    if (_uring != nullptr) {
+        uint32_t count = _uring_reap(results, capacity);
+        while (count < min_count) {
+            _uring_enter(1);
+            count += _uring_reap(results + count, capacity - count);
+        }
+        return count;
+    }
+
+    uint32_t count;
+    {
+        std::unique_lock<std::mutex> lock(_pool_mutex);
+        _finished_condition.wait(lock, [&]() { return _finished.size() >= min_count; });
+        count = std::min(capacity, (uint32_t)_finished.size());
+        size_t first = _finished.size() - count;
+        std::copy(_finished.begin() + first, _finished.end(), results);
+        _finished.resize(first);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        // Pool threads return the slot index in place of the user data, swap it back
+        uint32_t slot = (uint32_t)results[i].user_data;
+        results[i].user_data = _slots[slot].read.user_data;
+        _free(slot);
+    }
+    return count;
+}
+
+uint32_t AsyncIoQueue::_allocate_slot() {
+    uint32_t slot = _free_slot;
+    if (slot != UINT32_MAX) {
+        _free_slot = _slots[slot].next_free;
+    }
+    return slot;
+}
+
+void AsyncIoQueue::_free(uint32_t slot) {
+    _slots[slot].next_free = _free_slot;
+    _free_slot = slot;
+    _in_flight--;
+}
+
+void AsyncIoQueue::_pool_main() {
+    Profiler::set_thread_name("Async I/O");
+    std::unique_lock<std::mutex> lock(_pool_mutex);
+    while (true) {
+        _pending_condition.wait(lock, [&]() { return _pending_count > 0 || !_pool_running; });
+        if (_pending_count == 0) {
+            return;
+        }
+        uint32_t slot = _pending[_pending_head];
+        _pending_head = (_pending_head + 1) % (uint32_t)_pending.size();
+        _pending_count--;
+        lock.unlock();
+
+        // The slot isn't touched by the owning thread until its result is collected
+        const AsyncRead& read = _slots[slot].read;
+        bool success = read.file->read(read.offset, read.destination, read.size);
+
+        lock.lock();
+        _finished.push_back({slot, success});
+        _finished_condition.notify_one();
+    }
+}
+
+#ifdef KY_PLATFORM_LINUX
+
+// Ring pointers into the memory shared with the kernel. The application owns the submission
+// tail and completion head, the kernel the other two, each side publishes its index with a
+// release store and reads the other's with an acquire load.
+struct AsyncIoQueue::_Uring {
+    int ring = -1;
+    void* submission_ring = nullptr;
+    size_t submission_ring_size = 0;
+    void* completion_ring = nullptr;
+    size_t completion_ring_size = 0;
+    io_uring_sqe* entries = nullptr;
+    size_t entries_size = 0;
+
+    uint32_t* submission_tail = nullptr;
+    uint32_t submission_mask = 0;
+    uint32_t* submission_array = nullptr;
+    uint32_t* completion_head = nullptr;
+    uint32_t* completion_tail = nullptr;
+    uint32_t completion_mask = 0;
+    io_uring_cqe* completions = nullptr;
+
+    // Entries pushed that the kernel hasn't consumed yet
+    uint32_t unsubmitted = 0;
+};
+
+bool AsyncIoQueue::_uring_init(uint32_t depth) {
+    io_uring_params params = {};
+    int ring = (int)syscall(__NR_io_uring_setup, depth, &params);
+    KY_ERROR_CONDITION_MSG_RETURN(ring >= 0, false,
+                                  "Failed to create io_uring, using the thread pool");
+
+    _Uring* uring = memory::create<_Uring>(MEMORY_TAG_CORE);
+    uring->ring = ring;
+    uring->submission_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    uring->completion_ring_size =
+            params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    // Kernels with a single mapping for both rings need it sized for the larger one
+    bool single_mapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mapping) {
+        uring->submission_ring_size =
+                std::max(uring->submission_ring_size, uring->completion_ring_size);
+        uring->completion_ring_size = uring->submission_ring_size;
+    }
+    uring->entries_size = params.sq_entries * sizeof(io_uring_sqe);
+
+    void* submission_ring = mmap(nullptr, uring->submission_ring_size, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+    void* completion_ring = submission_ring;
+    if (!single_mapping && submission_ring != MAP_FAILED) {
+        completion_ring = mmap(nullptr, uring->completion_ring_size, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+    }
+    void* entries = mmap(nullptr, uring->entries_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+    uring->submission_ring = submission_ring != MAP_FAILED ? submission_ring : nullptr;
+    uring->completion_ring = completion_ring != MAP_FAILED ? completion_ring : nullptr;
+    uring->entries = entries != MAP_FAILED ? (io_uring_sqe*)entries : nullptr;
+    _uring = uring;
+    if (uring->submission_ring == nullptr || uring->completion_ring == nullptr ||
+        uring->entries == nullptr) {
+        _uring_shutdown();
+        KY_ERROR_MSG("Failed to map the io_uring rings, using the thread pool");
+        return false;
+    }
+
+    uint8_t* submission = (uint8_t*)uring->submission_ring;
+    uint8_t* completion = (uint8_t*)uring->completion_ring;
+    uring->submission_tail = (uint32_t*)(submission + params.sq_off.tail);
+    uring->submission_mask = *(uint32_t*)(submission + params.sq_off.ring_mask);
+    uring->submission_array = (uint32_t*)(submission + params.sq_off.array);
+    uring->completion_head = (uint32_t*)(completion + params.cq_off.head);
+    uring->completion_tail = (uint32_t*)(completion + params.cq_off.tail);
+    uring->completion_mask = *(uint32_t*)(completion + params.cq_off.ring_mask);
+    uring->completions = (io_uring_cqe*)(completion + params.cq_off.cqes);
+    return true;
+}
+
+void AsyncIoQueue::_uring_shutdown() {
+    if (_uring == nullptr) {
+        return;
+    }
+    if (_uring->entries != nullptr) {
+        munmap(_uring->entries, _uring->entries_size);
+    }
+    if (_uring->completion_ring != nullptr &&
+        _uring->completion_ring != _uring->submission_ring) {
+        munmap(_uring->completion_ring, _uring->completion_ring_size);
+    }
+    if (_uring->submission_ring != nullptr) {
+        munmap(_uring->submission_ring, _uring->submission_ring_size);
+    }
+    ::close(_uring->ring);
+    memory::destroy(MEMORY_TAG_CORE, _uring);
+    _uring = nullptr;
+}
+
+void AsyncIoQueue::_uring_push(uint32_t slot) {
+    // Every slot has at most one entry in the ring and the ring has at least a slot's worth of
+    // entries, so it can't overflow
+    _Uring& uring = *_uring;
+    const _Slot& data = _slots[slot];
+    uint32_t tail = *uring.submission_tail;
+    uint32_t index = tail & uring.submission_mask;
+    io_uring_sqe& entry = uring.entries[index];
+    std::memset(&entry, 0, sizeof(entry));
+    entry.opcode = IORING_OP_READ;
+    entry.fd = data.read.file->descriptor();
+    entry.off = data.read.offset + data.done;
+    entry.addr = (uint64_t)(uintptr_t)((uint8_t*)data.read.destination + data.done);
+    entry.len = data.read.size - data.done;
+    entry.user_data = slot;
+    uring.submission_array[index] = index;
+    __atomic_store_n(uring.submission_tail, tail + 1, __ATOMIC_RELEASE);
+    uring.unsubmitted++;
+}
+
+void AsyncIoQueue::_uring_enter(uint32_t min_complete) {
+    _Uring& uring = *_uring;
+    if (uring.unsubmitted == 0 && min_complete == 0) {
+        return;
+    }
+    uint32_t flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    while (true) {
+        int result = (int)syscall(__NR_io_uring_enter, uring.ring, uring.unsubmitted,
+                                  min_complete, flags, nullptr, 0);
+        if (result >= 0) {
+            uring.unsubmitted -= (uint32_t)result;
+            return;
+        }
+        // Busy means completions need reaping first, the caller comes back after doing so
+        if (errno == EAGAIN || errno == EBUSY) {
+            return;
+        }
+        KY_FATAL_CONDITION_MSG(errno == EINTR, "io_uring_enter failed");
+    }
+}
+
+uint32_t AsyncIoQueue::_uring_reap(AsyncReadResult* results, uint32_t capacity) {
+    _Uring& uring = *_uring;
+    uint32_t head = *uring.completion_head;
+    uint32_t tail = __atomic_load_n(uring.completion_tail, __ATOMIC_ACQUIRE);
+    uint32_t count = 0;
+    for (; head != tail && count < capacity; head++) {
+        const io_uring_cqe& completion = uring.completions[head & uring.completion_mask];
+        uint32_t slot = (uint32_t)completion.user_data;
+        _Slot& data = _slots[slot];
+        int32_t result = completion.res;
+        if (result == -EAGAIN || result == -EINTR) {
+            _uring_push(slot);
+            continue;
+        }
+        if (result > 0) {
+            data.done += (uint32_t)result;
+            if (data.done < data.read.size) {
+                _uring_push(slot);
+                continue;
+            }
+        }
+        results[count++] = {data.read.user_data, result >= 0 && data.done == data.read.size};
+        _free(slot);
+    }
+    __atomic_store_n(uring.completion_head, head, __ATOMIC_RELEASE);
+    // Continued reads go out right away instead of waiting for the next submit
+    if (uring.unsubmitted > 0) {
+        _uring_enter(0);
+    }
+    return count;
+}
+
+#else
+
+struct AsyncIoQueue::_Uring {};
+
+bool AsyncIoQueue::_uring_init(uint32_t) {
+    return false;
+}
+
+void AsyncIoQueue::_uring_shutdown() {}
+void AsyncIoQueue::_uring_push(uint32_t) {}
+void AsyncIoQueue::_uring_enter(uint32_t) {}
+
+uint32_t AsyncIoQueue::_uring_reap(AsyncReadResult*, uint32_t) {
+    return 0;
+}
+
+#endif
+
+} // namespace ky
@@ -0,0 +1,173 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_CORE__ASYNC_IO_H
+#define KRYOS_CORE__ASYNC_IO_H
+
+#include "core/memory_tracker.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Reads an `AsyncIoQueue` keeps in flight by default. Deep queues are what lets NVMe drives reach
+// their throughput on small reads.
+#ifndef KY_ASYNC_IO_QUEUE_DEPTH
+#    define KY_ASYNC_IO_QUEUE_DEPTH 128
+#endif
+
+namespace ky {
+
+enum AsyncIoBackend {
+    // Blocking positioned reads on a pool of threads, available everywhere
+    ASYNC_IO_BACKEND_THREAD_POOL,
+    // Linux 5.6+ submission and completion rings, one syscall submits a whole batch of reads
+    ASYNC_IO_BACKEND_IO_URING,
+    ASYNC_IO_BACKEND_COUNT,
+};
+
+// File opened for positioned reads, which don't share a file offset and can run concurrently.
+class AsyncFile {
+public:
+    AsyncFile() = default;
+    ~AsyncFile();
+
+    AsyncFile(const AsyncFile&) = delete;
+    AsyncFile& operator=(const AsyncFile&) = delete;
+    AsyncFile(AsyncFile&& other);
+    AsyncFile& operator=(AsyncFile&& other);
+
+    bool open(const char* path);
+    void close();
+#ifdef KY_PLATFORM_WINDOWS
+    inline bool is_open() const { return _handle != nullptr; }
+#else
+    inline bool is_open() const { return _descriptor >= 0; }
+    inline int descriptor() const { return _descriptor; }
+#endif
+
+    inline uint64_t size() const { return _size; }
+
+    // Blocks until `size` bytes at `offset` are read, fails on errors and reads past the end.
+    bool read(uint64_t offset, void* destination, size_t size) const;
+
+private:
+#ifdef KY_PLATFORM_WINDOWS
+    void* _handle = nullptr;
+#else
+    int _descriptor = -1;
+#endif
+    uint64_t _size = 0;
+};
+
+struct AsyncRead {
+    const AsyncFile* file;
+    uint64_t offset;
+    void* destination;
+    uint32_t size;
+    // Returned with the result to identify the read
+    uint64_t user_data;
+};
+
+struct AsyncReadResult {
+    uint64_t user_data;
+    bool success;
+};
+
+// Queue of positioned reads that complete in the background. Reads are queued with `read`, handed
+// to the backend as one batch by `submit` and their results gathered with `collect`. Short reads
+// are continued internally, a result is only reported once the whole read finished or failed.
+//
+// A queue is used from a single thread, destination buffers must stay alive until their result
+// has been collected.
+class AsyncIoQueue {
+public:
+    AsyncIoQueue() = default;
+    ~AsyncIoQueue();
+
+    AsyncIoQueue(const AsyncIoQueue&) = delete;
+    AsyncIoQueue& operator=(const AsyncIoQueue&) = delete;
+
+    static bool supported(AsyncIoBackend backend);
+    static const char* backend_name(AsyncIoBackend backend);
+
+    // Uses the thread pool when `backend` isn't supported by the platform or kernel.
+    // `thread_count` only applies to the thread pool.
+    bool init(AsyncIoBackend backend, uint32_t depth = KY_ASYNC_IO_QUEUE_DEPTH,
+              uint32_t thread_count = 4);
+    // Waits for reads in flight to finish, their results are dropped.
+    void shutdown();
+
+    inline AsyncIoBackend backend() const { return _backend; }
+    inline uint32_t depth() const { return (uint32_t)_slots.size(); }
+    // Reads queued that haven't been collected yet
+    inline uint32_t in_flight() const { return _in_flight; }
+    inline bool full() const { return _in_flight >= _slots.size(); }
+
+    // Queues a read to start with the next `submit`, false when the queue is full.
+    bool read(const AsyncRead& read);
+    void submit();
+
+    // Gathers up to `capacity` finished reads into `results` and returns how many. Blocks until
+    // at least `min_count` finished, or fewer when not that many are in flight.
+    uint32_t collect(AsyncReadResult* results, uint32_t capacity, uint32_t min_count = 0);
+
+private:
+    struct _Slot {
+        AsyncRead read;
+        // Bytes read so far, short reads continue from here
+        uint32_t done;
+        uint32_t next_free;
+    };
+    struct _Uring;
+
+    AsyncIoBackend _backend = ASYNC_IO_BACKEND_THREAD_POOL;
+    TaggedVector<_Slot, MEMORY_TAG_CORE> _slots;
+    uint32_t _free_slot = UINT32_MAX;
+    uint32_t _in_flight = 0;
+    // Slots queued since the last submit
+    TaggedVector<uint32_t, MEMORY_TAG_CORE> _queued;
+
+    _Uring* _uring = nullptr;
+
+    // Thread pool, `_pending` is a ring of slot indices waiting for a thread
+    std::vector<std::thread> _threads;
+    std::mutex _pool_mutex;
+    std::condition_variable _pending_condition;
+    std::condition_variable _finished_condition;
+    TaggedVector<uint32_t, MEMORY_TAG_CORE> _pending;
+    uint32_t _pending_head = 0;
+    uint32_t _pending_count = 0;
+    TaggedVector<AsyncReadResult, MEMORY_TAG_CORE> _finished;
+    bool _pool_running = false;
+
+    uint32_t _allocate_slot();
+    void _free(uint32_t slot);
+
+    bool _uring_init(uint32_t depth);
+    void _uring_shutdown();
+    void _uring_push(uint32_t slot);
+    void _uring_enter(uint32_t min_complete);
+    uint32_t _uring_reap(AsyncReadResult* results, uint32_t capacity);
+
+    void _pool_main();
+};
+
+} // namespace ky
+
+#endif
@@ -0,0 +1,224 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/compression.h"
+
+#include "core/bits.h"
+#include "core/error.h"
+
+#include <cstring>
+
+namespace ky {
+namespace lz4 {
+
+    static constexpr size_t _MIN_MATCH = 4;
+    // The format requires the last 5 bytes to be literals and the last match to start at least
+    // 12 bytes before the end of the block
+    static constexpr size_t _LAST_LITERALS = 5;
+    static constexpr size_t _MATCH_FIND_LIMIT = 12;
+    static constexpr size_t _MAX_OFFSET = 65535;
+    static constexpr int _HASH_BITS = 12;
+
+    static inline uint32_t read_u32(const uint8_t* data) {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    static inline uint64_t read_u64(const uint8_t* data) {
+        uint64_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    // Length of the common prefix of `a` and `b` up to `limit`, 8 bytes at a time
+    static inline size_t match_length(const uint8_t* a, const uint8_t* b, const uint8_t* limit) {
+        const uint8_t* start = b;
+        while (b + 8 <= limit) {
+            uint64_t difference = read_u64(a) ^ read_u64(b);
+            if (difference != 0) {
+                return (size_t)(b - start) + count_trailing_zeros(difference) / 8;
+            }
+            a += 8;
+            b += 8;
+        }
+        while (b < limit && *a == *b) {
+            a++;
+            b++;
+        }
+        return (size_t)(b - start);
+    }
+
+    static inline uint32_t hash(uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - _HASH_BITS);
+    }
+
+    static inline uint8_t* write_length(uint8_t* output, size_t length) {
+        for (; length >= 255; length -= 255) {
+            *output++ = 255;
+        }
+        *output++ = (uint8_t)length;
+        return output;
+    }
+
+    static uint8_t* write_sequence(uint8_t* output, const uint8_t* literals, size_t literal_count,
+                                   size_t offset, size_t length) {
+        uint8_t* token = output++;
+        *token = (uint8_t)((literal_count >= 15 ? 15 : literal_count) << 4);
+        if (literal_count >= 15) {
+            output = write_length(output, literal_count - 15);
+        }
+        if (literal_count > 0) {
+            std::memcpy(output, literals, literal_count);
+            output += literal_count;
+        }
+        if (length == 0) {
+            return output;
+        }
+
+        *output++ = (uint8_t)offset;
+        *output++ = (uint8_t)(offset >> 8);
+        length -= _MIN_MATCH;
+        *token |= (uint8_t)(length >= 15 ? 15 : length);
+        if (length >= 15) {
+            output = write_length(output, length - 15);
+        }
+        return output;
+    }
+
+    size_t compress(const void* source, size_t size, void* destination, size_t capacity) {
+        KY_ERROR_CONDITION_MSG_RETURN(capacity >= compress_bound(size), 0,
+                                      "Compression destination is below the bound");
+        const uint8_t* input = (const uint8_t*)source;
+        uint8_t* output = (uint8_t*)destination;
+        size_t anchor = 0;
+
+        if (size > _MATCH_FIND_LIMIT) {
+            // Positions plus one of the last sequence seen per hash, zero is empty
+            uint32_t table[1 << _HASH_BITS] = {};
+            size_t match_start_limit = size - _MATCH_FIND_LIMIT;
+            size_t match_end_limit = size - _LAST_LITERALS;
+            size_t position = 0;
+            while (position < match_start_limit) {
+                uint32_t sequence = read_u32(input + position);
+                uint32_t& slot = table[hash(sequence)];
+                size_t candidate = (size_t)slot - 1;
+                slot = (uint32_t)(position + 1);
+                if (candidate >= position || position - candidate > _MAX_OFFSET ||
+                    read_u32(input + candidate) != sequence) {
+                    // Skips ahead faster the longer nothing matched, incompressible data is
+                    // passed over quickly
+                    position += 1 + ((position - anchor) >> 6);
+                    continue;
+                }
+
+                while (position > anchor && candidate > 0 &&
+                       input[position - 1] == input[candidate - 1]) {
+                    position--;
+                    candidate--;
+                }
+                size_t length =
+                        _MIN_MATCH + match_length(input + candidate + _MIN_MATCH,
+                                                  input + position + _MIN_MATCH,
+                                                  input + match_end_limit);
+                output = write_sequence(output, input + anchor, position - anchor,
+                                        position - candidate, length);
+                position += length;
+                anchor = position;
+            }
+        }
+        output = write_sequence(output, input + anchor, size - anchor, 0, 0);
+        return (size_t)(output - (uint8_t*)destination);
+    }
+
+    static inline bool read_length(const uint8_t*& input, const uint8_t* end, size_t& length) {
+        uint8_t byte;
+        do {
+            if (input >= end) {
+                return false;
+            }
+            byte = *input++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    bool decompress(const void* source, size_t source_size, void* destination, size_t size) {
+        const uint8_t* input = (const uint8_t*)source;
+        const uint8_t* input_end = input + source_size;
+        uint8_t* output = (uint8_t*)destination;
+        uint8_t* output_start = output;
+        uint8_t* output_end = output + size;
+
+        while (input < input_end) {
+            uint8_t token = *input++;
+            size_t literal_count = token >> 4;
+            if (literal_count == 15 && !read_length(input, input_end, literal_count)) {
+                return false;
+            }
+            if (literal_count > (size_t)(input_end - input) ||
+                literal_count > (size_t)(output_end - output)) {
+                return false;
+            }
+            // Short runs copy a fixed 16 bytes when both buffers have room, the bytes past the
+            // run are overwritten by what follows
+            if (literal_count <= 16 && input_end - input >= 16 && output_end - output >= 16) {
+                std::memcpy(output, input, 16);
+            } else if (literal_count > 0) {
+                std::memcpy(output, input, literal_count);
+            }
+            input += literal_count;
+            output += literal_count;
+            if (input == input_end) {
+                break;
+            }
+
+            if (input_end - input < 2) {
+                return false;
+            }
+            size_t offset = (size_t)input[0] | ((size_t)input[1] << 8);
+            input += 2;
+            size_t length = token & 15;
+            if (length == 15 && !read_length(input, input_end, length)) {
+                return false;
+            }
+            length += _MIN_MATCH;
+            if (offset == 0 || offset > (size_t)(output - output_start) ||
+                length > (size_t)(output_end - output)) {
+                return false;
+            }
+            const uint8_t* match = output - offset;
+            if (offset >= 8 && (size_t)(output_end - output) >= length + 8) {
+                // Each 8 byte step only reads bytes written before it, the last step may write
+                // past the match into bytes that are overwritten next
+                for (size_t i = 0; i < length; i += 8) {
+                    std::memcpy(output + i, match + i, 8);
+                }
+                output += length;
+            } else if (offset >= length) {
+                std::memcpy(output, match, length);
+                output += length;
+            } else {
+                // Overlapping matches repeat the last `offset` bytes
+                for (size_t i = 0; i < length; i++) {
+                    *output++ = *match++;
+                }
+            }
+        }
+        return output == output_end;
+    }
+
+} // namespace lz4
+} // namespace ky
@@ -15,14 +15,80 @@
 
 #include "core/error.h"
 
+#include "core/memory_tracker.h"
+#include "core/time.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
+#include <mutex>
+#include <thread>
 
 namespace ky {
 namespace error_internal {
 
+    struct _ErrorRecord {
+        const char* function = nullptr;
+        const char* file = nullptr;
+        int line = 0;
+        ErrorCode code = ErrorCode::ERROR;
+        char msg[KY_ERROR_ASYNC_MESSAGE_MAX_SIZE] {};
+    };
+
+    // Single producer, single consumer ring buffer. The owning thread is the only producer and the
+    // drain thread the only consumer, so pushing a record never takes a lock.
+    struct _ErrorRing {
+        alignas(64) std::atomic<size_t> head = 0;
+        alignas(64) std::atomic<size_t> tail = 0;
+        std::atomic<size_t> dropped = 0;
+        std::atomic<bool> orphaned = false;
+        _ErrorRing* next = nullptr;
+        _ErrorRecord records[KY_ERROR_ASYNC_RING_CAPACITY];
+    };
+
+    struct _ThreadRing {
+        _ErrorRing* ring = nullptr;
+        size_t generation = 0;
+
+        ~_ThreadRing();
+    };
+
     static ErrorHandler* error_handler = nullptr;
+    static std::mutex handler_mutex;
+    static std::atomic<ErrorDispatchMode> dispatch_mode = ErrorDispatchMode::SYNC;
+
+    // Rings are only ever pushed to the front of the list by producers and only unlinked by the
+    // drain thread, `ring_mutex` guards both
+    static std::mutex ring_mutex;
+    static _ErrorRing* rings = nullptr;
+    static std::atomic<size_t> ring_generation = 1;
+
+    static std::thread drain_thread;
+    static std::mutex drain_mutex;
+    static std::condition_variable drain_cv;
+    static std::condition_variable flush_cv;
+    static std::atomic<bool> drain_running = false;
+    static std::atomic<bool> drain_pending = false;
+    static std::atomic<size_t> pushed_count = 0;
+    static std::atomic<size_t> dispatched_count = 0;
+
+    // Call sites which suppressed at least one message, used to report the remaining counts on
+    // shutdown. Call sites are function local statics so they are never freed
+    static std::atomic<CallSite*> suppressed_call_sites = nullptr;
+
+    static thread_local _ThreadRing thread_ring;
+    static thread_local bool thread_dispatching = false;
+
+    // Rings are freed on `error::shutdown`, only hand the ring over if it's still alive
+    _ThreadRing::~_ThreadRing() {
+        std::lock_guard<std::mutex> lock(ring_mutex);
+        if (ring != nullptr && generation == ring_generation.load(std::memory_order_relaxed)) {
+            ring->orphaned.store(true, std::memory_order_release);
+        }
+    }
 
     void console_error_handler_callback(void*, const char* function, const char* file, int line,
                                         const char* msg, ErrorCode code) {
@@ -35,20 +101,202 @@ namespace error_internal {
         fflush(out);
     }
 
-    // TODO: Global mutex is required for multi-threading
+    // Caller must hold `handler_mutex`
+    static void dispatch_locked(const char* function, const char* file, int line, ErrorCode code,
+                                const char* msg) {
+        thread_dispatching = true;
+        ErrorHandler* handler = error_handler;
+        while (handler != nullptr) {
+            handler->callback(handler->user_data, function, file, line, msg, code);
+            handler = handler->next;
+        }
+        thread_dispatching = false;
+    }
+
+    static void dispatch(const char* function, const char* file, int line, ErrorCode code,
+                         const char* msg) {
+        // Handlers reporting errors themselves already hold the lock
+        if (thread_dispatching) {
+            dispatch_locked(function, file, line, code, msg);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(handler_mutex);
+        dispatch_locked(function, file, line, code, msg);
+    }
+
+    static _ErrorRing* acquire_thread_ring() {
+        std::lock_guard<std::mutex> lock(ring_mutex);
+        size_t generation = ring_generation.load(std::memory_order_relaxed);
+        if (thread_ring.ring == nullptr || thread_ring.generation != generation) {
+            _ErrorRing* ring = memory::create<_ErrorRing>(MEMORY_TAG_ERROR);
+            ring->next = rings;
+            rings = ring;
+            thread_ring.ring = ring;
+            thread_ring.generation = generation;
+        }
+        return thread_ring.ring;
+    }
+
+    static void push_record(const char* function, const char* file, int line, ErrorCode code,
+                            const char* fmt, va_list args) {
+        _ErrorRing* ring = thread_ring.ring;
+        if (ring == nullptr ||
+            thread_ring.generation != ring_generation.load(std::memory_order_acquire)) {
+            ring = acquire_thread_ring();
+        }
+
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        if (tail - ring->head.load(std::memory_order_acquire) >= KY_ERROR_ASYNC_RING_CAPACITY) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        _ErrorRecord& record = ring->records[tail % KY_ERROR_ASYNC_RING_CAPACITY];
+        record.function = function;
+        record.file = file;
+        record.line = line;
+        record.code = code;
+        vsnprintf(record.msg, sizeof(record.msg), fmt, args);
+        ring->tail.store(tail + 1, std::memory_order_release);
+        pushed_count.fetch_add(1, std::memory_order_relaxed);
+
+        if (!drain_pending.exchange(true, std::memory_order_acq_rel)) {
+            drain_cv.notify_one();
+        }
+    }
+
+    static void drain_rings() {
+        _ErrorRing* ring = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(ring_mutex);
+            ring = rings;
+        }
+
+        for (; ring != nullptr; ring = ring->next) {
+            size_t head = ring->head.load(std::memory_order_relaxed);
+            size_t tail = ring->tail.load(std::memory_order_acquire);
+            if (head != tail) {
+                std::lock_guard<std::mutex> lock(handler_mutex);
+                for (size_t i = head; i != tail; i++) {
+                    const _ErrorRecord& record = ring->records[i % KY_ERROR_ASYNC_RING_CAPACITY];
+                    dispatch_locked(record.function, record.file, record.line, record.code,
+                                    record.msg);
+                }
+                ring->head.store(tail, std::memory_order_release);
+                dispatched_count.fetch_add(tail - head, std::memory_order_release);
+            }
+
+            size_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+            if (dropped > 0) {
+                char msg_buf[128];
+                snprintf(msg_buf, sizeof(msg_buf),
+                         "%zu messages dropped, asynchronous error ring buffer full", dropped);
+                dispatch(KY_FUNCTION_STR, __FILE__, __LINE__, ErrorCode::WARNING, msg_buf);
+            }
+        }
+
+        // Free rings of exited threads once everything they pushed has been dispatched
+        std::lock_guard<std::mutex> lock(ring_mutex);
+        _ErrorRing** link = &rings;
+        while (*link != nullptr) {
+            _ErrorRing* curr = *link;
+            if (curr->orphaned.load(std::memory_order_acquire) &&
+                curr->head.load(std::memory_order_relaxed) ==
+                    curr->tail.load(std::memory_order_acquire)) {
+                *link = curr->next;
+                memory::destroy(MEMORY_TAG_ERROR, curr);
+            } else {
+                link = &curr->next;
+            }
+        }
+    }
+
+    static void drain_thread_main() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(drain_mutex);
+                drain_cv.wait_for(lock, std::chrono::milliseconds(10), [] {
+                    return drain_pending.load(std::memory_order_acquire) ||
+                           !drain_running.load(std::memory_order_acquire);
+                });
+            }
+            drain_pending.store(false, std::memory_order_release);
+            bool running = drain_running.load(std::memory_order_acquire);
+
+            drain_rings();
+            flush_cv.notify_all();
+            if (!running) {
+                break;
+            }
+        }
+    }
+
+    bool call_site_should_report(CallSite& site, const char* function, const char* file, int line,
+                                 ErrorCode code) {
+        constexpr int64_t interval_ns = (int64_t)KY_ERROR_RATE_LIMIT_INTERVAL_MS * 1000000;
+        if constexpr (interval_ns <= 0) {
+            return true;
+        }
+
+        int64_t now = Clock::now();
+        int64_t last = site.last_report_ns.load(std::memory_order_relaxed);
+        bool within_interval = last != 0 && now - last < interval_ns;
+        if (within_interval ||
+            !site.last_report_ns.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+            site.suppressed.fetch_add(1, std::memory_order_relaxed);
+            if (!site.registered.exchange(true, std::memory_order_acq_rel)) {
+                site.function = function;
+                site.file = file;
+                site.line = line;
+                site.code = code;
+                site.next = suppressed_call_sites.load(std::memory_order_relaxed);
+                while (!suppressed_call_sites.compare_exchange_weak(
+                    site.next, &site, std::memory_order_release, std::memory_order_relaxed)) {
+                }
+            }
+            return false;
+        }
+
+        uint32_t suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+        if (suppressed > 0) {
+            print_error(function, file, line, code, "Previous message repeated %u times in %.1fs",
+                        suppressed, Clock::to_seconds(now - last));
+        }
+        return true;
+    }
+
+    static void report_suppressed_call_sites() {
+        CallSite* site = suppressed_call_sites.load(std::memory_order_acquire);
+        for (; site != nullptr; site = site->next) {
+            uint32_t suppressed = site->suppressed.exchange(0, std::memory_order_relaxed);
+            if (suppressed > 0) {
+                print_error(site->function, site->file, site->line, site->code,
+                            "Previous message repeated %u times", suppressed);
+            }
+        }
+    }
+
     void print_error(const char* function, const char* file, int line, ErrorCode code,
                      const char* fmt, ...) {
-        char msg_buf[KY_ERROR_MESSAGE_MAX_SIZE] {};
         va_list args;
         va_start(args, fmt);
-        vsprintf(msg_buf, fmt, args);
-        va_end(args);
 
-        ErrorHandler* handler = error_handler;
-        while (handler != nullptr) {
-            handler->callback(handler->user_data, function, file, line, msg_buf, code);
-            handler = handler->next;
+        bool async = dispatch_mode.load(std::memory_order_acquire) == ErrorDispatchMode::ASYNC;
+        if (async && code != ErrorCode::FATAL && !thread_dispatching) {
+            push_record(function, file, line, code, fmt, args);
+            va_end(args);
+            return;
+        }
+
+        // Fatal errors trap straight after, make sure everything reported before is visible
+        if (async && !thread_dispatching) {
+            error::flush();
         }
+        char msg_buf[KY_ERROR_MESSAGE_MAX_SIZE] {};
+        vsnprintf(msg_buf, sizeof(msg_buf), fmt, args);
+        va_end(args);
+
+        dispatch(function, file, line, code, msg_buf);
     }
 
 } // namespace error_internal
@@ -70,56 +318,113 @@ namespace error {
         }
     }
 
-    void init() {
-        error_internal::error_handler = (ErrorHandler*)std::malloc(sizeof(ErrorHandler));
-        error_internal::error_handler->next = nullptr;
-        error_internal::error_handler->user_data = nullptr;
-        error_internal::error_handler->callback = error_internal::console_error_handler_callback;
-        error_internal::error_handler->free_callback = nullptr;
+    void init(ErrorDispatchMode mode) {
+        {
+            std::lock_guard<std::mutex> lock(error_internal::handler_mutex);
+            ErrorHandler* console = (ErrorHandler*)std::malloc(sizeof(ErrorHandler));
+            console->next = nullptr;
+            console->user_data = nullptr;
+            console->callback = error_internal::console_error_handler_callback;
+            console->free_callback = nullptr;
+            error_internal::error_handler = console;
+        }
+
+        if (mode == ErrorDispatchMode::ASYNC) {
+            error_internal::drain_running.store(true, std::memory_order_release);
+            error_internal::drain_thread = std::thread(error_internal::drain_thread_main);
+        }
+        error_internal::dispatch_mode.store(mode, std::memory_order_release);
     }
 
     void shutdown() {
+        error_internal::report_suppressed_call_sites();
+
+        if (error_internal::dispatch_mode.exchange(ErrorDispatchMode::SYNC) ==
+            ErrorDispatchMode::ASYNC) {
+            error_internal::drain_running.store(false, std::memory_order_release);
+            error_internal::drain_cv.notify_one();
+            error_internal::drain_thread.join();
+
+            // Producers racing the mode switch may have queued after the final drain
+            error_internal::drain_rings();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(error_internal::ring_mutex);
+            error_internal::_ErrorRing* ring = error_internal::rings;
+            while (ring != nullptr) {
+                error_internal::_ErrorRing* next = ring->next;
+                memory::destroy(MEMORY_TAG_ERROR, ring);
+                ring = next;
+            }
+            error_internal::rings = nullptr;
+            error_internal::ring_generation++;
+        }
+
+        // Everything else is torn down by now, the handlers still have to be around to report it
+        memory::report_leaks();
+
+        std::lock_guard<std::mutex> lock(error_internal::handler_mutex);
         ErrorHandler* handler = error_internal::error_handler;
         while (handler != nullptr) {
             ErrorHandler* next = handler->next;
-            if (handler->user_data) {
+            if (handler->user_data != nullptr && handler->free_callback != nullptr) {
                 handler->free_callback(handler->user_data);
             }
             std::free(handler);
             handler = next;
         }
+        error_internal::error_handler = nullptr;
+    }
+
+    ErrorDispatchMode dispatch_mode() {
+        return error_internal::dispatch_mode.load(std::memory_order_acquire);
+    }
+
+    void flush() {
+        if (dispatch_mode() != ErrorDispatchMode::ASYNC) {
+            return;
+        }
+        size_t target = error_internal::pushed_count.load(std::memory_order_acquire);
+        error_internal::drain_pending.store(true, std::memory_order_release);
+        error_internal::drain_cv.notify_one();
+
+        std::unique_lock<std::mutex> lock(error_internal::drain_mutex);
+        while (error_internal::dispatched_count.load(std::memory_order_acquire) < target &&
+               error_internal::drain_running.load(std::memory_order_acquire)) {
+            error_internal::flush_cv.wait_for(lock, std::chrono::milliseconds(1));
+        }
     }
 
-    // TODO: Global mutex is required for multi-threading
     void add_error_handler(ErrorHandler* handler) {
-        ErrorHandler* last = error_internal::error_handler;
-        while (last->next != nullptr) {
-            last = last->next;
+        std::lock_guard<std::mutex> lock(error_internal::handler_mutex);
+        handler->next = nullptr;
+        ErrorHandler** last = &error_internal::error_handler;
+        while (*last != nullptr) {
+            last = &(*last)->next;
         }
-        last->next = handler;
+        *last = handler;
     }
 
-    // TODO: Global mutex is required for multi-threading
     void remove_error_handler(const ErrorHandler* handler) {
-        ErrorHandler* prev = nullptr;
-        ErrorHandler* curr = error_internal::error_handler;
-        while (curr->next != nullptr) {
-            if (curr == handler) {
-                break;
+        ErrorHandler* removed = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(error_internal::handler_mutex);
+            ErrorHandler** link = &error_internal::error_handler;
+            while (*link != nullptr && *link != handler) {
+                link = &(*link)->next;
             }
-            prev = curr;
-            curr = curr->next;
-        }
-        if (prev != nullptr) {
-            prev->next = curr->next;
-        }
-        if (curr->user_data != nullptr) {
-            if (curr->free_callback != nullptr) {
-                curr->free_callback(curr->user_data);
+            removed = *link;
+            if (removed != nullptr) {
+                *link = removed->next;
             }
-            std::free(curr->user_data);
         }
-        std::free(curr);
+        KY_ERROR_CONDITION_MSG(removed != nullptr, "Error handler is not registered");
+
+        if (removed->user_data != nullptr && removed->free_callback != nullptr) {
+            removed->free_callback(removed->user_data);
+        }
+        std::free(removed);
     }
 
 } // namespace error
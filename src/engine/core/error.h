@@ -16,6 +16,9 @@
 #ifndef KRYOS_CORE__ERROR_H
 #define KRYOS_CORE__ERROR_H
 
+#include <atomic>
+#include <cstdint>
+
 // Error messages:
 // WARNING: These macros work in the opposite way to assert.
 //
@@ -37,6 +40,16 @@
 
 #define KY_ERROR_MESSAGE_MAX_SIZE 4096
 
+// Maximum message size of a record queued in asynchronous mode. Longer messages are truncated.
+#ifndef KY_ERROR_ASYNC_MESSAGE_MAX_SIZE
+#    define KY_ERROR_ASYNC_MESSAGE_MAX_SIZE 512
+#endif
+
+// Number of records a single producer thread can have queued before messages start being dropped.
+#ifndef KY_ERROR_ASYNC_RING_CAPACITY
+#    define KY_ERROR_ASYNC_RING_CAPACITY 256
+#endif
+
 // FIXME: Rework error handler, structure should be similar to WindowManager. The error handler
 // data should be stored within the engine context and just have a static pointer for static access
 
@@ -49,6 +62,16 @@ enum class ErrorCode {
     SHADER,
 };
 
+// How messages are delivered to the error handlers.
+//
+// `SYNC` formats and dispatches on the calling thread. `ASYNC` pushes records into per-thread
+// lock-free ring buffers which a background thread drains and dispatches, so producers never block
+// on handler output. Fatal errors are always dispatched synchronously after flushing the queue.
+enum class ErrorDispatchMode {
+    SYNC,
+    ASYNC,
+};
+
 struct ErrorHandler {
     using Callback = void (*)(void* user_data, const char* function, const char* file, int line,
                               const char* msg, ErrorCode code);
@@ -72,132 +95,215 @@ namespace error {
     // Initializes the error handlers and sets the console handler as default. Use
     // `add_error_handler` to add additional error handlers and `remove_error_handler` to remove
     // existing ones.
-    void init();
+    void init(ErrorDispatchMode mode = ErrorDispatchMode::SYNC);
 
-    // Shuts down the error handlers by deallocating all error handlers.
+    // Shuts down the error handlers by deallocating all error handlers. Any queued asynchronous
+    // messages are dispatched and memory still held by any `MemoryTag` is reported before the
+    // handlers are freed.
     void shutdown();
 
-    // Adds an error handler to the list of error handlers.
+    ErrorDispatchMode dispatch_mode();
+
+    // Blocks until every message queued before the call has been dispatched. Does nothing in
+    // synchronous mode.
+    void flush();
+
+    // Adds an error handler to the list of error handlers. Safe to call while other threads are
+    // reporting errors.
     void add_error_handler(ErrorHandler* handler);
 
-    // Removes an error handler from the list of error handlers.
+    // Removes an error handler from the list of error handlers. Once this returns, the handler's
+    // callback is guaranteed to not be running or be called again.
     void remove_error_handler(const ErrorHandler* handler);
 
 } // namespace error
 
 namespace error_internal {
 
+    // Per call site state used to rate limit repeated messages. Must stay constant initializable
+    // so the function local statics in the error macros don't need a guard.
+    struct CallSite {
+        std::atomic<int64_t> last_report_ns = 0;
+        std::atomic<uint32_t> suppressed = 0;
+        std::atomic<bool> registered = false;
+        const char* function = nullptr;
+        const char* file = nullptr;
+        int line = 0;
+        ErrorCode code = ErrorCode::ERROR;
+        CallSite* next = nullptr;
+    };
+
+    // Returns whether the call site should report its message. Messages repeated within
+    // `KY_ERROR_RATE_LIMIT_INTERVAL_MS` are suppressed and counted, the count is reported as a
+    // summary the next time the call site is allowed to report or on `error::shutdown`.
+    bool call_site_should_report(CallSite& site, const char* function, const char* file, int line,
+                                 ErrorCode code);
+
     void print_error(const char* function, const char* file, int line, ErrorCode code,
                      const char* fmt, ...);
 
+    template <typename... _Args>
+    constexpr void stripped_report(const _Args&...) {
+    }
+
 } // namespace error_internal
 } // namespace ky
 
-#define KY_ERROR_MSG(...)                                                                  \
-    ky::error_internal::print_error(KY_FUNCTION_STR, __FILE__, __LINE__, ErrorCode::ERROR, \
-                                    __VA_ARGS__);
+// Severity stripping:
+// Messages below `KY_ERROR_MIN_LEVEL` are compiled out entirely, including their formatting
+// arguments. The checks themselves are kept, so `KY_ERROR_CONDITION` still returns early and
+// conditions with side effects are still evaluated. Fatal messages can never be stripped.
+
+#define KY_ERROR_LEVEL_WARNING 0
+#define KY_ERROR_LEVEL_ERROR   1
+#define KY_ERROR_LEVEL_FATAL   2
+
+#ifndef KY_ERROR_MIN_LEVEL
+#    define KY_ERROR_MIN_LEVEL KY_ERROR_LEVEL_WARNING
+#endif
+
+// Minimum time between two reports from the same call site. Set to 0 to disable rate limiting.
+#ifndef KY_ERROR_RATE_LIMIT_INTERVAL_MS
+#    define KY_ERROR_RATE_LIMIT_INTERVAL_MS 1000
+#endif
+
+#define _KY_ERROR_REPORT_RATE_LIMITED(_code, ...)                                       \
+    do {                                                                                \
+        static ky::error_internal::CallSite _ky_call_site;                              \
+        if (ky::error_internal::call_site_should_report(_ky_call_site, KY_FUNCTION_STR, \
+                                                        __FILE__, __LINE__, _code)) {   \
+            ky::error_internal::print_error(KY_FUNCTION_STR, __FILE__, __LINE__, _code, \
+                                            __VA_ARGS__);                               \
+        }                                                                               \
+    } while (0)
+
+// Arguments are never evaluated, only referenced to avoid unused variable warnings
+#define _KY_ERROR_REPORT_STRIPPED(...)                        \
+    do {                                                      \
+        if (false) {                                          \
+            ky::error_internal::stripped_report(__VA_ARGS__); \
+        }                                                     \
+    } while (0)
+
+#if KY_ERROR_MIN_LEVEL <= KY_ERROR_LEVEL_WARNING
+#    define _KY_REPORT_WARNING(...) \
+        _KY_ERROR_REPORT_RATE_LIMITED(ky::ErrorCode::WARNING, __VA_ARGS__)
+#else
+#    define _KY_REPORT_WARNING(...) _KY_ERROR_REPORT_STRIPPED(__VA_ARGS__)
+#endif
+
+#if KY_ERROR_MIN_LEVEL <= KY_ERROR_LEVEL_ERROR
+#    define _KY_REPORT_ERROR(...) _KY_ERROR_REPORT_RATE_LIMITED(ky::ErrorCode::ERROR, __VA_ARGS__)
+#else
+#    define _KY_REPORT_ERROR(...) _KY_ERROR_REPORT_STRIPPED(__VA_ARGS__)
+#endif
+
+#define _KY_REPORT_FATAL(...)                                                                  \
+    ky::error_internal::print_error(KY_FUNCTION_STR, __FILE__, __LINE__, ky::ErrorCode::FATAL, \
+                                    __VA_ARGS__)
+
+#define KY_WARNING_MSG(...) _KY_REPORT_WARNING(__VA_ARGS__)
+
+#define KY_ERROR_MSG(...) _KY_REPORT_ERROR(__VA_ARGS__)
 
 // Ensures an integer index `_index` is less than `_size`. Otherwise, invalid index and the
 // function returns.
-#define KY_ERROR_FAIL_INDEX(_index, _size)                                                     \
-    if ((_index) >= (_size)) {                                                                 \
-        ky::error_internal::print_error(KY_FUNCTION_STR, __FILE__, __LINE__, ErrorCode::ERROR, \
-                                        "Index %zu out of bounds %zu", (_index), (_size));     \
-        return;                                                                                \
-    } else                                                                                     \
+#define KY_ERROR_FAIL_INDEX(_index, _size)                                  \
+    if ((_index) >= (_size)) {                                              \
+        _KY_REPORT_ERROR("Index %zu out of bounds %zu", (_index), (_size)); \
+        return;                                                             \
+    } else                                                                  \
+        ((void)0)
+
+// Ensures an integer index `_index` is less than `_size`. Otherwise, invalid index and the
+// function returns `_returning`.
+#define KY_ERROR_FAIL_INDEX_RETURN(_index, _size, _returning)               \
+    if ((_index) >= (_size)) {                                              \
+        _KY_REPORT_ERROR("Index %zu out of bounds %zu", (_index), (_size)); \
+        return (_returning);                                                \
+    } else                                                                  \
         ((void)0)
 
 // Ensures an integer index `_index` is less than `_size`. Otherwise, invalid index and the
 // function returns while providing a custom error message.
-#define KY_ERROR_FAIL_INDEX_MSG(_index, _size, _msg)                                           \
-    if ((_index) >= (_size)) {                                                                 \
-        ky::error_internal::print_error(KY_FUNCTION_STR, __FILE__, __LINE__, ErrorCode::ERROR, \
-                                        "Index %zu out of bounds %zu: %s", (_index), (_size),  \
-                                        (_msg));                                               \
-        return;                                                                                \
-    } else                                                                                     \
+#define KY_ERROR_FAIL_INDEX_MSG(_index, _size, _msg)                                    \
+    if ((_index) >= (_size)) {                                                          \
+        _KY_REPORT_ERROR("Index %zu out of bounds %zu: %s", (_index), (_size), (_msg)); \
+        return;                                                                         \
+    } else                                                                              \
         ((void)0)
 
 // Ensures an integer index `_index` is less than `_size`. Otherwise, invalid index and the program
 // crashes.
-#define KY_FATAL_FAIL_INDEX(_index, _size)                                                     \
-    if ((_index) >= (_size)) {                                                                 \
-        ky::error_internal::print_error(KY_FUNCTION_STR, __FILE__, __LINE__, ErrorCode::FATAL, \
-                                        "Index %zu out of bounds %zu", (_index), (_size));     \
-        _KY_GENERATE_TRAP();                                                                   \
-    } else                                                                                     \
+#define KY_FATAL_FAIL_INDEX(_index, _size)                                  \
+    if ((_index) >= (_size)) {                                              \
+        _KY_REPORT_FATAL("Index %zu out of bounds %zu", (_index), (_size)); \
+        _KY_GENERATE_TRAP();                                                \
+    } else                                                                  \
         ((void)0)
 
 // Ensures an integer index `_index` is less than `_size`. Otherwise, invalid index and the program
 // crashes while providing a custom error message.
-#define KY_FATAL_FAIL_INDEX_MSG(_index, _size, _msg)                                           \
-    if ((_index) >= (_size)) {                                                                 \
-        ky::error_internal::print_error(KY_FUNCTION_STR, __FILE__, __LINE__, ErrorCode::FATAL, \
-                                        "Index %zu out of bounds %zu: %s", (_index), (_size),  \
-                                        (_msg));                                               \
-        _KY_GENERATE_TRAP();                                                                   \
-    } else                                                                                     \
+#define KY_FATAL_FAIL_INDEX_MSG(_index, _size, _msg)                                    \
+    if ((_index) >= (_size)) {                                                          \
+        _KY_REPORT_FATAL("Index %zu out of bounds %zu: %s", (_index), (_size), (_msg)); \
+        _KY_GENERATE_TRAP();                                                            \
+    } else                                                                              \
         ((void)0)
 
 // Ensures a condition `_condition` is true. Otherwise, invalid condition and the function returns.
-#define KY_ERROR_CONDITION_RETURN(_condition, _returning)                                      \
-    if (!(_condition)) {                                                                       \
-        ky::error_internal::print_error(KY_FUNCTION_STR, __FILE__, __LINE__, ErrorCode::ERROR, \
-                                        "Condition %s is false", #_condition);                 \
-        return (_returning);                                                                   \
-    } else                                                                                     \
+#define KY_ERROR_CONDITION_RETURN(_condition, _returning)       \
+    if (!(_condition)) {                                        \
+        _KY_REPORT_ERROR("Condition %s is false", #_condition); \
+        return (_returning);                                    \
+    } else                                                      \
         ((void)0)
 
-#define KY_ERROR_CONDITION(_condition)                                                         \
-    if (!(_condition)) {                                                                       \
-        ky::error_internal::print_error(KY_FUNCTION_STR, __FILE__, __LINE__, ErrorCode::ERROR, \
-                                        "Condition %s is false", #_condition);                 \
-        return;                                                                                \
-    } else                                                                                     \
+#define KY_ERROR_CONDITION(_condition)                          \
+    if (!(_condition)) {                                        \
+        _KY_REPORT_ERROR("Condition %s is false", #_condition); \
+        return;                                                 \
+    } else                                                      \
         ((void)0)
 
 // Ensures a condition `_condition` is true. Otherwise, invalid condition and the function returns
 // while providing a custom error message.
-#define KY_ERROR_CONDITION_MSG_RETURN(_condition, _returning, _msg)                            \
-    if (!(_condition)) {                                                                       \
-        ky::error_internal::print_error(KY_FUNCTION_STR, __FILE__, __LINE__, ErrorCode::ERROR, \
-                                        "Condition %s is false: %s", #_condition, _msg);       \
-        return (_returning);                                                                   \
-    } else                                                                                     \
+#define KY_ERROR_CONDITION_MSG_RETURN(_condition, _returning, _msg)       \
+    if (!(_condition)) {                                                  \
+        _KY_REPORT_ERROR("Condition %s is false: %s", #_condition, _msg); \
+        return (_returning);                                              \
+    } else                                                                \
         ((void)0)
 
 // Ensures a condition `_condition` is true. Otherwise, invalid condition and the function returns
 // while providing a custom error message.
-#define KY_ERROR_CONDITION_MSG(_condition, _msg)                                               \
-    if (!(_condition)) {                                                                       \
-        ky::error_internal::print_error(KY_FUNCTION_STR, __FILE__, __LINE__, ErrorCode::ERROR, \
-                                        "Condition %s is false: %s", #_condition, _msg);       \
-        return;                                                                                \
-    } else                                                                                     \
+#define KY_ERROR_CONDITION_MSG(_condition, _msg)                          \
+    if (!(_condition)) {                                                  \
+        _KY_REPORT_ERROR("Condition %s is false: %s", #_condition, _msg); \
+        return;                                                           \
+    } else                                                                \
         ((void)0)
 
 // Ensures a condition `_condition` is true. Otherwise, invalid condition and the program crashes.
-#define KY_FATAL_CONDITION(_condition)                                                         \
-    if (!(_condition)) {                                                                       \
-        ky::error_internal::print_error(KY_FUNCTION_STR, __FILE__, __LINE__, ErrorCode::FATAL, \
-                                        "Condition %s is false", #_condition);                 \
-        _KY_GENERATE_TRAP();                                                                   \
-    } else                                                                                     \
+#define KY_FATAL_CONDITION(_condition)                          \
+    if (!(_condition)) {                                        \
+        _KY_REPORT_FATAL("Condition %s is false", #_condition); \
+        _KY_GENERATE_TRAP();                                    \
+    } else                                                      \
         ((void)0)
 
 // Ensures a condition `_condition` is true. Otherwise, invalid condition and the program crashes
 // while providing a custom error message.
-#define KY_FATAL_CONDITION_MSG(_condition, _msg)                                               \
-    if (!(_condition)) {                                                                       \
-        ky::error_internal::print_error(KY_FUNCTION_STR, __FILE__, __LINE__, ErrorCode::FATAL, \
-                                        "Condition %s is false: %s", #_condition, _msg);       \
-        _KY_GENERATE_TRAP();                                                                   \
-    } else                                                                                     \
+#define KY_FATAL_CONDITION_MSG(_condition, _msg)                          \
+    if (!(_condition)) {                                                  \
+        _KY_REPORT_FATAL("Condition %s is false: %s", #_condition, _msg); \
+        _KY_GENERATE_TRAP();                                              \
+    } else                                                                \
         ((void)0)
 
 // Crashes the program with a custom error message.
-#define KY_FATAL_CRASH_PROGRAM(_msg)                                                              \
-    ky::error_internal::print_error(KY_FUNCTION_STR, __FILE__, __LINE__, ErrorCode::FATAL, _msg); \
+#define KY_FATAL_CRASH_PROGRAM(_msg) \
+    _KY_REPORT_FATAL("%s", _msg);    \
     _KY_GENERATE_TRAP();
 
 #endif
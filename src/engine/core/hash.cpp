@@ -0,0 +1,100 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/hash.h"
+
+#include <cstring>
+
+namespace ky {
+
+static constexpr uint64_t _PRIME_1 = 0x9E3779B185EBCA87ull;
+static constexpr uint64_t _PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr uint64_t _PRIME_3 = 0x165667B19E3779F9ull;
+static constexpr uint64_t _PRIME_4 = 0x85EBCA77C2B2AE63ull;
+static constexpr uint64_t _PRIME_5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t rotate_left(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Little endian reads, the hash is defined on little endian words
+static inline uint64_t read_u64(const uint8_t* data) {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline uint32_t read_u32(const uint8_t* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline uint64_t round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * _PRIME_2;
+    return rotate_left(accumulator, 31) * _PRIME_1;
+}
+
+static inline uint64_t merge_round(uint64_t hash, uint64_t accumulator) {
+    hash ^= round(0, accumulator);
+    return hash * _PRIME_1 + _PRIME_4;
+}
+
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    const uint8_t* end = bytes + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        uint64_t lanes[4] = {seed + _PRIME_1 + _PRIME_2, seed + _PRIME_2, seed, seed - _PRIME_1};
+        for (const uint8_t* stripes_end = end - 31; bytes < stripes_end; bytes += 32) {
+            lanes[0] = round(lanes[0], read_u64(bytes));
+            lanes[1] = round(lanes[1], read_u64(bytes + 8));
+            lanes[2] = round(lanes[2], read_u64(bytes + 16));
+            lanes[3] = round(lanes[3], read_u64(bytes + 24));
+        }
+        hash = rotate_left(lanes[0], 1) + rotate_left(lanes[1], 7) + rotate_left(lanes[2], 12) +
+               rotate_left(lanes[3], 18);
+        for (uint64_t lane : lanes) {
+            hash = merge_round(hash, lane);
+        }
+    } else {
+        hash = seed + _PRIME_5;
+    }
+    hash += (uint64_t)size;
+
+    for (; bytes + 8 <= end; bytes += 8) {
+        hash ^= round(0, read_u64(bytes));
+        hash = rotate_left(hash, 27) * _PRIME_1 + _PRIME_4;
+    }
+    if (bytes + 4 <= end) {
+        hash ^= (uint64_t)read_u32(bytes) * _PRIME_1;
+        hash = rotate_left(hash, 23) * _PRIME_2 + _PRIME_3;
+        bytes += 4;
+    }
+    for (; bytes < end; bytes++) {
+        hash ^= (uint64_t)*bytes * _PRIME_5;
+        hash = rotate_left(hash, 11) * _PRIME_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= _PRIME_2;
+    hash ^= hash >> 29;
+    hash *= _PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+} // namespace ky
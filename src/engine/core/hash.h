@@ -0,0 +1,30 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_CORE__HASH_H
+#define KRYOS_CORE__HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ky {
+
+// 64 bit non-cryptographic hash of a byte range, computes XXH64 so values match other tools. It
+// runs at several GB/s, fast enough to validate or key content without slowing down its loading.
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0);
+
+} // namespace ky
+
+#endif
@@ -16,6 +16,9 @@
 #include "core/input.h"
 
 #include "core/error.h"
+#include "core/input_recording.h"
+#include "core/profiler.h"
+#include "core/time.h"
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
@@ -23,140 +26,438 @@
 namespace ky {
 
 Input* Input::_instance = nullptr;
+const Input::_WindowState Input::_EMPTY_STATE = {};
 
-#define KY_REG_ONCE_IMPL(func, input_type, code, pressed)              \
-    bool result = func(code);                                          \
-    if (result) {                                                      \
-        result = _instance->_register_once(input_type, code, pressed); \
-    }                                                                  \
-    return result
+Input::Input() {
+}
 
-#define KY_REG_ONCE_WITH_HANDLE_IMPL(func, handle, input_type, code, pressed) \
-    bool result = func(handle, code);                                         \
-    if (result) {                                                             \
-        result = _instance->_register_once(input_type, code, pressed);        \
-    }                                                                         \
-    return result
+Input::~Input() {
+    if (_instance == this) {
+        _instance = nullptr;
+    }
+}
 
 void Input::init(Input& instance, WindowManager& window_manager) {
     _instance = &instance;
     _instance->_window_manager = &window_manager;
-    for (_Registered& reg : _instance->_reg_once_buffer) {
-        reg.type = INPUT_TYPE_UNKNOWN;
+    _instance->_window_states.clear();
+    _instance->_window_states_by_id.clear();
+    _instance->_main_state = nullptr;
+    _instance->_events.reserve(256);
+    window_manager.each_window([](const WindowHandle& handle) { attach_window(handle); });
+
+    for (size_t i = 0; i < _instance->_gamepads.size(); i++) {
+        _instance->_gamepads[i] = _GamepadState {};
+    }
+    if (window_manager.backend() == WINDOW_BACKEND_GLFW) {
+        for (size_t i = 0; i < _instance->_gamepads.size(); i++) {
+            _instance->_gamepads[i].connected = glfwJoystickIsGamepad((int)i);
+        }
+        glfwSetJoystickCallback(_joystick_callback);
+    }
+}
+
+void Input::attach_window(const WindowHandle& handle) {
+    if (_instance == nullptr || !handle.valid()) {
+        return;
+    }
+    _WindowState& state = _instance->_window_states[handle.index()];
+    state.window_id = (uint32_t)_instance->_window_states_by_id.size();
+    _instance->_window_states_by_id.push_back(&state);
+    if (handle == _instance->_window_manager->main()) {
+        _instance->_main_state = &state;
+    }
+    // Headless windows only receive input from playback
+    GLFWwindow* glfw_handle = handle.glfw_handle();
+    if (glfw_handle == nullptr) {
+        return;
+    }
+    glfwSetKeyCallback(glfw_handle, _key_callback);
+    glfwSetMouseButtonCallback(glfw_handle, _mouse_button_callback);
+    glfwSetCursorPosCallback(glfw_handle, _cursor_position_callback);
+    glfwSetScrollCallback(glfw_handle, _scroll_callback);
+}
+
+void Input::detach_window(const WindowHandle& handle) {
+    if (_instance == nullptr) {
+        return;
+    }
+    auto it = _instance->_window_states.find(handle.index());
+    if (it == _instance->_window_states.end()) {
+        return;
+    }
+    if (_instance->_main_state == &it->second) {
+        _instance->_main_state = nullptr;
+    }
+    // Ids aren't reused so recorded events keep pointing at the same window
+    _instance->_window_states_by_id[it->second.window_id] = nullptr;
+    _instance->_window_states.erase(it);
+    GLFWwindow* glfw_handle = handle.glfw_handle();
+    if (glfw_handle == nullptr) {
+        return;
     }
+    glfwSetKeyCallback(glfw_handle, nullptr);
+    glfwSetMouseButtonCallback(glfw_handle, nullptr);
+    glfwSetCursorPosCallback(glfw_handle, nullptr);
+    glfwSetScrollCallback(glfw_handle, nullptr);
 }
 
 bool Input::key_pressed(KeyCode code) {
-    KY_REG_ONCE_IMPL(key_press, INPYT_TYPE_KEYBOARD, code, true);
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)code, (size_t)KeyCode_Last + 1, false);
+    return _main_window_state().keys_pressed[code];
 }
 
 bool Input::key_released(KeyCode code) {
-    KY_REG_ONCE_IMPL(key_release, INPYT_TYPE_KEYBOARD, code, false);
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)code, (size_t)KeyCode_Last + 1, false);
+    return _main_window_state().keys_released[code];
 }
 
 bool Input::key_pressed(const WindowHandle& handle, KeyCode code) {
-    KY_REG_ONCE_WITH_HANDLE_IMPL(key_press, handle, INPYT_TYPE_KEYBOARD, code, true);
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)code, (size_t)KeyCode_Last + 1, false);
+    return _window_state(handle).keys_pressed[code];
 }
 
 bool Input::key_released(const WindowHandle& handle, KeyCode code) {
-    KY_REG_ONCE_WITH_HANDLE_IMPL(key_release, handle, INPYT_TYPE_KEYBOARD, code, false);
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)code, (size_t)KeyCode_Last + 1, false);
+    return _window_state(handle).keys_released[code];
 }
 
 bool Input::key_press(KeyCode code) {
-    return glfwGetKey(_instance->_window_manager->main().glfw_handle, code) == GLFW_PRESS;
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)code, (size_t)KeyCode_Last + 1, false);
+    return _main_window_state().keys_down[code];
 }
 
 bool Input::key_release(KeyCode code) {
-    return glfwGetKey(_instance->_window_manager->main().glfw_handle, code) == GLFW_RELEASE;
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)code, (size_t)KeyCode_Last + 1, false);
+    return !_main_window_state().keys_down[code];
 }
 
 bool Input::key_press(const WindowHandle& handle, KeyCode code) {
-    return glfwGetKey(handle.glfw_handle, code) == GLFW_PRESS;
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)code, (size_t)KeyCode_Last + 1, false);
+    return _window_state(handle).keys_down[code];
 }
 
 bool Input::key_release(const WindowHandle& handle, KeyCode code) {
-    return glfwGetKey(handle.glfw_handle, code) == GLFW_RELEASE;
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)code, (size_t)KeyCode_Last + 1, false);
+    return !_window_state(handle).keys_down[code];
 }
 
 bool Input::mouse_pressed(MouseButton button) {
-    KY_REG_ONCE_IMPL(mouse_press, INPUT_TYPE_MOUSE, button, true);
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)button, (size_t)MouseButton_Last + 1, false);
+    return _main_window_state().mouse_pressed[button];
 }
 
 bool Input::mouse_released(MouseButton button) {
-    KY_REG_ONCE_IMPL(mouse_release, INPUT_TYPE_MOUSE, button, false);
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)button, (size_t)MouseButton_Last + 1, false);
+    return _main_window_state().mouse_released[button];
 }
 
 bool Input::mouse_pressed(const WindowHandle& handle, MouseButton button) {
-    KY_REG_ONCE_WITH_HANDLE_IMPL(mouse_press, handle, INPUT_TYPE_MOUSE, button, true);
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)button, (size_t)MouseButton_Last + 1, false);
+    return _window_state(handle).mouse_pressed[button];
 }
 
 bool Input::mouse_released(const WindowHandle& handle, MouseButton button) {
-    KY_REG_ONCE_WITH_HANDLE_IMPL(mouse_release, handle, INPUT_TYPE_MOUSE, button, false);
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)button, (size_t)MouseButton_Last + 1, false);
+    return _window_state(handle).mouse_released[button];
 }
 
 bool Input::mouse_press(MouseButton button) {
-    return glfwGetMouseButton(_instance->_window_manager->main().glfw_handle, button) ==
-           GLFW_PRESS;
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)button, (size_t)MouseButton_Last + 1, false);
+    return _main_window_state().mouse_down[button];
 }
 
 bool Input::mouse_release(MouseButton button) {
-    return glfwGetMouseButton(_instance->_window_manager->main().glfw_handle, button) ==
-           GLFW_RELEASE;
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)button, (size_t)MouseButton_Last + 1, false);
+    return !_main_window_state().mouse_down[button];
 }
 
 bool Input::mouse_press(const WindowHandle& handle, MouseButton button) {
-    return glfwGetMouseButton(handle.glfw_handle, button) == GLFW_PRESS;
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)button, (size_t)MouseButton_Last + 1, false);
+    return _window_state(handle).mouse_down[button];
 }
 
 bool Input::mouse_release(const WindowHandle& handle, MouseButton button) {
-    return glfwGetMouseButton(handle.glfw_handle, button) == GLFW_RELEASE;
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)button, (size_t)MouseButton_Last + 1, false);
+    return !_window_state(handle).mouse_down[button];
+}
+
+glm::dvec2 Input::cursor_position() {
+    return _main_window_state().cursor;
+}
+
+glm::dvec2 Input::cursor_position(const WindowHandle& handle) {
+    return _window_state(handle).cursor;
+}
+
+glm::dvec2 Input::scroll_delta() {
+    return _main_window_state().scroll;
+}
+
+glm::dvec2 Input::scroll_delta(const WindowHandle& handle) {
+    return _window_state(handle).scroll;
+}
+
+bool Input::gamepad_connected(GamepadJoystick gamepad) {
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)gamepad, _instance->_gamepads.size(), false);
+    return _instance->_gamepads[gamepad].connected;
+}
+
+bool Input::gamepad_button_pressed(GamepadJoystick gamepad, GamepadButton button) {
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)gamepad, _instance->_gamepads.size(), false);
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)button, (size_t)GamepadButton_Last + 1, false);
+    const _GamepadState& state = _instance->_gamepads[gamepad];
+    return state.buttons_down[button] && !state.buttons_previous[button];
+}
+
+bool Input::gamepad_button_released(GamepadJoystick gamepad, GamepadButton button) {
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)gamepad, _instance->_gamepads.size(), false);
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)button, (size_t)GamepadButton_Last + 1, false);
+    const _GamepadState& state = _instance->_gamepads[gamepad];
+    return !state.buttons_down[button] && state.buttons_previous[button];
+}
+
+bool Input::gamepad_button_press(GamepadJoystick gamepad, GamepadButton button) {
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)gamepad, _instance->_gamepads.size(), false);
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)button, (size_t)GamepadButton_Last + 1, false);
+    return _instance->_gamepads[gamepad].buttons_down[button];
+}
+
+float Input::gamepad_axis(GamepadJoystick gamepad, GamepadAxis axis) {
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)gamepad, _instance->_gamepads.size(), 0.0f);
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)axis, (size_t)GamepadAxis_Last + 1, 0.0f);
+    return _instance->_gamepads[gamepad].axes[axis];
+}
+
+const std::vector<InputEvent>& Input::events() {
+    return _instance->_events;
+}
+
+bool Input::start_recording(const char* path) {
+    KY_ERROR_CONDITION_MSG_RETURN(!playing_back(), false, "Cannot record during playback");
+    if (_instance->_recorder == nullptr) {
+        _instance->_recorder = std::make_unique<InputRecorder>();
+    }
+    return _instance->_recorder->open(path);
+}
+
+void Input::stop_recording() {
+    if (_instance->_recorder != nullptr) {
+        _instance->_recorder->close();
+    }
+}
+
+bool Input::recording() {
+    return _instance->_recorder != nullptr && _instance->_recorder->is_open();
+}
+
+bool Input::start_playback(const char* path) {
+    KY_ERROR_CONDITION_MSG_RETURN(!recording(), false, "Cannot play back while recording");
+    if (_instance->_playback == nullptr) {
+        _instance->_playback = std::make_unique<InputPlayback>();
+    }
+    if (!_instance->_playback->open(path)) {
+        return false;
+    }
+
+    // Start from a clean slate so the live state doesn't leak into the replay
+    _instance->_events.clear();
+    _instance->_consumed_events = 0;
+    for (auto& [window, state] : _instance->_window_states) {
+        uint32_t window_id = state.window_id;
+        state = _WindowState {};
+        state.window_id = window_id;
+    }
+    return true;
+}
+
+void Input::stop_playback() {
+    if (_instance->_playback != nullptr) {
+        _instance->_playback->close();
+    }
+}
+
+bool Input::playing_back() {
+    return _instance->_playback != nullptr && _instance->_playback->is_open();
 }
 
 void Input::poll_events() {
-    glfwPollEvents();
+    KY_PROFILE_SCOPE("Input::poll_events");
 
-    size_t reg_counted = 0;
-    for (_Registered& reg : _instance->_reg_once_buffer) {
-        if (reg_counted == _instance->_reg_count) {
-            break;
-        } else if (reg.type == INPUT_TYPE_UNKNOWN) {
-            continue;
-        }
-        reg_counted++;
+    // Edges only live for the frame they happened in
+    for (auto& [window, state] : _window_states) {
+        state.keys_pressed.reset();
+        state.keys_released.reset();
+        state.mouse_pressed.reset();
+        state.mouse_released.reset();
+        state.scroll = glm::dvec2(0.0);
+    }
+
+    // Events delivered outside of `glfwPollEvents` belong to this frame, re-apply them so their
+    // edges aren't lost with the previous frame's
+    _events.erase(_events.begin(), _events.begin() + _consumed_events);
+    for (const InputEvent& event : _events) {
+        _apply_event(event);
+    }
+    if (_window_manager->backend() == WINDOW_BACKEND_GLFW) {
+        glfwPollEvents();
+    }
+    _poll_gamepads();
 
-        if (!reg.remove_next_frame) {
-            reg.remove_next_frame = true;
+    if (playing_back()) {
+        if (_playback->read_frame(_events)) {
+            for (const InputEvent& event : _events) {
+                _apply_event(event);
+            }
         } else {
-            reg.type = INPUT_TYPE_UNKNOWN;
-            _instance->_reg_count--;
+            _playback->close();
         }
     }
+    if (recording()) {
+        _recorder->write_frame(_events);
+    }
+    _consumed_events = _events.size();
 }
 
-bool Input::_register_once(InputType type, int code, bool pressed) {
-    int free_index = -1;
-    for (size_t i = 0; i < _reg_once_buffer.size(); i++) {
-        if (_reg_once_buffer[i].type == INPUT_TYPE_UNKNOWN) {
-            free_index = i;
+void Input::_poll_gamepads() {
+    for (_GamepadState& state : _instance->_gamepads) {
+        state.buttons_previous = state.buttons_down;
+    }
+    // Gamepads aren't part of recordings, keep them neutral so playback stays deterministic
+    if (playing_back()) {
+        for (_GamepadState& state : _instance->_gamepads) {
+            state.buttons_down.reset();
+            state.axes.fill(0.0f);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < _instance->_gamepads.size(); i++) {
+        _GamepadState& state = _instance->_gamepads[i];
+        if (!state.connected) {
             continue;
         }
-        bool found = _reg_once_buffer[i].type == type && _reg_once_buffer[i].code == code &&
-                     _reg_once_buffer[i].pressed == pressed;
-        if (found) {
-            _reg_once_buffer[i].remove_next_frame = false;
-            return false;
+        GLFWgamepadstate glfw_state;
+        if (!glfwGetGamepadState((int)i, &glfw_state)) {
+            state = _GamepadState {};
+            continue;
+        }
+        for (int button = 0; button <= GamepadButton_Last; button++) {
+            state.buttons_down.set(button, glfw_state.buttons[button] == GLFW_PRESS);
+        }
+        for (int axis = 0; axis <= GamepadAxis_Last; axis++) {
+            state.axes[axis] = glfw_state.axes[axis];
         }
+        state.axes[GamepadAxis_LeftTrigger] = (state.axes[GamepadAxis_LeftTrigger] + 1.0f) * 0.5f;
+        state.axes[GamepadAxis_RightTrigger] =
+            (state.axes[GamepadAxis_RightTrigger] + 1.0f) * 0.5f;
     }
-    KY_ERROR_CONDITION_MSG_RETURN(free_index != -1, false, "Input register once buffer full");
+}
 
-    _reg_once_buffer[free_index] = _Registered {
-        .type = type,
-        .code = code,
-        .remove_next_frame = false,
-        .pressed = pressed,
-    };
-    _reg_count++;
-    return true;
+const Input::_WindowState& Input::_main_window_state() {
+    return _instance->_main_state != nullptr ? *_instance->_main_state : _EMPTY_STATE;
+}
+
+const Input::_WindowState& Input::_window_state(const WindowHandle& handle) {
+    if (!handle.valid()) {
+        return _EMPTY_STATE;
+    }
+    auto it = _instance->_window_states.find(handle.index());
+    return it != _instance->_window_states.end() ? it->second : _EMPTY_STATE;
+}
+
+void Input::_push_event(GLFWwindow* window, InputEvent event) {
+    // Live input is ignored while a recording drives the state
+    if (playing_back()) {
+        return;
+    }
+    WindowHandle handle = _instance->_window_manager->find(window);
+    auto it = _instance->_window_states.find(handle.index());
+    if (!handle.valid() || it == _instance->_window_states.end()) {
+        return;
+    }
+    event.timestamp = Clock::now();
+    event.window_id = it->second.window_id;
+    _instance->_events.push_back(event);
+    _apply_event(event);
+}
+
+void Input::_apply_event(const InputEvent& event) {
+    if (event.window_id >= _instance->_window_states_by_id.size() ||
+        _instance->_window_states_by_id[event.window_id] == nullptr) {
+        return;
+    }
+    _WindowState& state = *_instance->_window_states_by_id[event.window_id];
+    bool press = event.action == INPUT_ACTION_PRESS;
+
+    switch (event.type) {
+        case INPUT_EVENT_KEY:
+            if (event.code >= 0 && event.code <= KeyCode_Last) {
+                state.keys_down.set(event.code, press);
+                (press ? state.keys_pressed : state.keys_released).set(event.code);
+            }
+            break;
+        case INPUT_EVENT_MOUSE_BUTTON:
+            if (event.code >= 0 && event.code <= MouseButton_Last) {
+                state.mouse_down.set(event.code, press);
+                (press ? state.mouse_pressed : state.mouse_released).set(event.code);
+            }
+            break;
+        case INPUT_EVENT_CURSOR:
+            state.cursor = glm::dvec2(event.x, event.y);
+            break;
+        case INPUT_EVENT_SCROLL:
+            state.scroll += glm::dvec2(event.x, event.y);
+            break;
+    }
+}
+
+void Input::_key_callback(GLFWwindow* window, int key, int, int action, int) {
+    // Repeats don't change any state
+    if (action == GLFW_REPEAT || key < 0 || key > KeyCode_Last) {
+        return;
+    }
+    InputEvent event;
+    event.type = INPUT_EVENT_KEY;
+    event.action = action == GLFW_PRESS ? INPUT_ACTION_PRESS : INPUT_ACTION_RELEASE;
+    event.code = key;
+    _push_event(window, event);
+}
+
+void Input::_mouse_button_callback(GLFWwindow* window, int button, int action, int) {
+    if (button < 0 || button > MouseButton_Last) {
+        return;
+    }
+    InputEvent event;
+    event.type = INPUT_EVENT_MOUSE_BUTTON;
+    event.action = action == GLFW_PRESS ? INPUT_ACTION_PRESS : INPUT_ACTION_RELEASE;
+    event.code = button;
+    _push_event(window, event);
+}
+
+void Input::_cursor_position_callback(GLFWwindow* window, double x, double y) {
+    InputEvent event;
+    event.type = INPUT_EVENT_CURSOR;
+    event.x = x;
+    event.y = y;
+    _push_event(window, event);
+}
+
+void Input::_scroll_callback(GLFWwindow* window, double x, double y) {
+    InputEvent event;
+    event.type = INPUT_EVENT_SCROLL;
+    event.x = x;
+    event.y = y;
+    _push_event(window, event);
+}
+
+void Input::_joystick_callback(int joystick, int event) {
+    if (_instance == nullptr || joystick < 0 || joystick > GamepadJoystick_LAST) {
+        return;
+    }
+    _GamepadState& state = _instance->_gamepads[joystick];
+    state = _GamepadState {};
+    state.connected = event == GLFW_CONNECTED && glfwJoystickIsGamepad(joystick);
 }
 
 } // namespace ky
@@ -1,4 +1,4 @@
-// This file iGLFW_INCLUDE_NONEs part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
 // Copyright (c) 2024 Oniup (https://github.com/Oniup)
 //
 // Licensed under the Apache License, Version 2.0 (the "License");
@@ -17,9 +17,15 @@
 #define KRYOS_CORE__INPUT_H
 
 #include "core/input_keycodes.h"
+#include "core/memory_tracker.h"
 #include "core/window.h"
 
 #include <array>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 namespace ky {
 
@@ -36,19 +42,66 @@ enum MouseMode {
     MOUSE_MODE_CAPTURED,
 };
 
+enum InputEventType : uint8_t {
+    INPUT_EVENT_KEY,
+    INPUT_EVENT_MOUSE_BUTTON,
+    INPUT_EVENT_CURSOR,
+    INPUT_EVENT_SCROLL,
+};
+
+enum InputAction : uint8_t {
+    INPUT_ACTION_RELEASE,
+    INPUT_ACTION_PRESS,
+};
+
+// Single input event of a window. Windows are identified by the order they were attached to
+// `Input` in, so ids stay the same across runs creating the same windows.
+struct InputEvent {
+    int64_t timestamp = 0;
+    uint32_t window_id = 0;
+    InputEventType type = INPUT_EVENT_KEY;
+    InputAction action = INPUT_ACTION_RELEASE;
+    int32_t code = 0;
+    double x = 0.0;
+    double y = 0.0;
+};
+
+class InputRecorder;
+class InputPlayback;
+
+// Keyboard and mouse state is recorded from GLFW callbacks while `poll_events` runs, queries only
+// read the recorded state. `*_pressed`/`*_released` are true during the frame in which the
+// button went down/up, `*_press`/`*_release` report whether it's currently held.
 class Input {
-    struct _Registered {
-        InputType type = INPUT_TYPE_UNKNOWN;
-        int code = -1;
-        bool remove_next_frame = false;
-        bool pressed = false;
+    struct _WindowState {
+        std::bitset<KeyCode_Last + 1> keys_down;
+        std::bitset<KeyCode_Last + 1> keys_pressed;
+        std::bitset<KeyCode_Last + 1> keys_released;
+        std::bitset<MouseButton_Last + 1> mouse_down;
+        std::bitset<MouseButton_Last + 1> mouse_pressed;
+        std::bitset<MouseButton_Last + 1> mouse_released;
+        glm::dvec2 cursor = glm::dvec2(0.0);
+        glm::dvec2 scroll = glm::dvec2(0.0);
+        uint32_t window_id = 0;
+    };
+
+    struct _GamepadState {
+        bool connected = false;
+        std::bitset<GamepadButton_Last + 1> buttons_down;
+        std::bitset<GamepadButton_Last + 1> buttons_previous;
+        std::array<float, GamepadAxis_Last + 1> axes = {};
     };
 
 public:
-    static constexpr size_t REG_ONCE_BUFFER_SIZE = 16;
+    Input();
+    ~Input();
 
     static void init(Input& instance, WindowManager& window_manager);
 
+    // Starts recording input of `handle`. Called by `WindowManager` for every window it creates.
+    static void attach_window(const WindowHandle& handle);
+    static void detach_window(const WindowHandle& handle);
+
     static bool key_pressed(KeyCode code);
     static bool key_released(KeyCode code);
     static bool key_pressed(const WindowHandle& handle, KeyCode code);
@@ -69,16 +122,65 @@ public:
     static bool mouse_press(const WindowHandle& handle, MouseButton button);
     static bool mouse_release(const WindowHandle& handle, MouseButton button);
 
+    static glm::dvec2 cursor_position();
+    static glm::dvec2 cursor_position(const WindowHandle& handle);
+    // Scroll offset accumulated during the current frame.
+    static glm::dvec2 scroll_delta();
+    static glm::dvec2 scroll_delta(const WindowHandle& handle);
+
+    // Gamepad state is fetched once per frame in `poll_events` for connected gamepads only.
+    // Triggers are remapped to the [0, 1] range, sticks are left in [-1, 1].
+    static bool gamepad_connected(GamepadJoystick gamepad);
+    static bool gamepad_button_pressed(GamepadJoystick gamepad, GamepadButton button);
+    static bool gamepad_button_released(GamepadJoystick gamepad, GamepadButton button);
+    static bool gamepad_button_press(GamepadJoystick gamepad, GamepadButton button);
+    static float gamepad_axis(GamepadJoystick gamepad, GamepadAxis axis);
+
+    // Events received by the last `poll_events` call, in the order they happened.
+    static const std::vector<InputEvent>& events();
+
+    // Writes every frame of events to `path` until `stop_recording` is called.
+    static bool start_recording(const char* path);
+    static void stop_recording();
+    static bool recording();
+
+    // Replays a recording made by `start_recording`. While playing back, input from GLFW is
+    // ignored and every `poll_events` call applies exactly one recorded frame, so a session
+    // replays identically regardless of frame rate. Playback stops at the end of the recording.
+    static bool start_playback(const char* path);
+    static void stop_playback();
+    static bool playing_back();
+
     void poll_events();
 
 private:
     WindowManager* _window_manager = nullptr;
-    size_t _reg_count = 0;
-    std::array<_Registered, REG_ONCE_BUFFER_SIZE> _reg_once_buffer;
+    std::unordered_map<uint32_t, _WindowState, std::hash<uint32_t>, std::equal_to<uint32_t>,
+                       TaggedAllocator<std::pair<const uint32_t, _WindowState>, MEMORY_TAG_INPUT>>
+            _window_states;
+    TaggedVector<_WindowState*, MEMORY_TAG_INPUT> _window_states_by_id;
+    _WindowState* _main_state = nullptr;
+    std::vector<InputEvent> _events;
+    size_t _consumed_events = 0;
+    std::array<_GamepadState, GamepadJoystick_LAST + 1> _gamepads;
+    std::unique_ptr<InputRecorder> _recorder;
+    std::unique_ptr<InputPlayback> _playback;
 
     static Input* _instance;
+    static const _WindowState _EMPTY_STATE;
+
+    static void _poll_gamepads();
+    static const _WindowState& _main_window_state();
+    static const _WindowState& _window_state(const WindowHandle& handle);
+
+    static void _push_event(GLFWwindow* window, InputEvent event);
+    static void _apply_event(const InputEvent& event);
 
-    bool _register_once(InputType type, int code, bool pressed);
+    static void _key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+    static void _mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+    static void _cursor_position_callback(GLFWwindow* window, double x, double y);
+    static void _scroll_callback(GLFWwindow* window, double x, double y);
+    static void _joystick_callback(int joystick, int event);
 };
 
 } // namespace ky
@@ -0,0 +1,182 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/input_actions.h"
+
+#include "core/error.h"
+#include "core/profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ky {
+
+InputActionId InputActionMap::add_action(const std::string_view& name, float press_threshold) {
+    KY_ERROR_CONDITION_MSG_RETURN(find_action(name) == KY_INPUT_ACTION_INVALID,
+                                  KY_INPUT_ACTION_INVALID, "Input action already exists");
+    _names.emplace_back(name);
+    _press_thresholds.push_back(press_threshold);
+    _bindings.emplace_back();
+    _states.emplace_back();
+    return (InputActionId)(_names.size() - 1);
+}
+
+InputActionId InputActionMap::find_action(const std::string_view& name) const {
+    for (size_t i = 0; i < _names.size(); i++) {
+        if (_names[i] == name) {
+            return (InputActionId)i;
+        }
+    }
+    return KY_INPUT_ACTION_INVALID;
+}
+
+void InputActionMap::bind(InputActionId action, const InputBinding& binding) {
+    KY_ERROR_FAIL_INDEX((size_t)action, _bindings.size());
+    _bindings[action].push_back(binding);
+    _dirty = true;
+}
+
+void InputActionMap::bind_key(InputActionId action, KeyCode code, float scale) {
+    bind(action, InputBinding {INPUT_BINDING_KEY, code, scale, 0.0f, -1});
+}
+
+void InputActionMap::bind_mouse_button(InputActionId action, MouseButton button, float scale) {
+    bind(action, InputBinding {INPUT_BINDING_MOUSE_BUTTON, button, scale, 0.0f, -1});
+}
+
+void InputActionMap::bind_gamepad_button(InputActionId action, GamepadButton button,
+                                         float scale) {
+    bind(action, InputBinding {INPUT_BINDING_GAMEPAD_BUTTON, button, scale, 0.0f, -1});
+}
+
+void InputActionMap::bind_gamepad_axis(InputActionId action, GamepadAxis axis, float scale,
+                                       float dead_zone) {
+    bind(action, InputBinding {INPUT_BINDING_GAMEPAD_AXIS, axis, scale, dead_zone, -1});
+}
+
+void InputActionMap::clear_bindings(InputActionId action) {
+    KY_ERROR_FAIL_INDEX((size_t)action, _bindings.size());
+    _bindings[action].clear();
+    _dirty = true;
+}
+
+void InputActionMap::compile() {
+    _compiled.clear();
+    for (size_t action = 0; action < _bindings.size(); action++) {
+        for (const InputBinding& binding : _bindings[action]) {
+            _compiled.push_back(_CompiledBinding {
+                (InputActionId)action,
+                binding.source,
+                binding.code,
+                binding.scale,
+                binding.dead_zone,
+                binding.gamepad,
+            });
+        }
+    }
+
+    // Grouping by source keeps the same state being read back to back during `update`
+    std::stable_sort(_compiled.begin(), _compiled.end(),
+                     [](const _CompiledBinding& a, const _CompiledBinding& b) {
+                         return a.source < b.source || (a.source == b.source && a.code < b.code);
+                     });
+    _dirty = false;
+}
+
+void InputActionMap::update() {
+    KY_PROFILE_SCOPE("InputActionMap::update");
+    if (_dirty) {
+        compile();
+    }
+
+    for (InputActionState& state : _states) {
+        state.value = 0.0f;
+    }
+    for (const _CompiledBinding& binding : _compiled) {
+        _states[binding.action].value += _sample(binding) * binding.scale;
+    }
+
+    for (size_t i = 0; i < _states.size(); i++) {
+        InputActionState& state = _states[i];
+        bool was_down = state.down;
+        state.value = std::clamp(state.value, -1.0f, 1.0f);
+        state.down = std::fabs(state.value) >= _press_thresholds[i];
+        state.pressed = state.down && !was_down;
+        state.released = !state.down && was_down;
+    }
+}
+
+const InputActionState& InputActionMap::state(InputActionId action) const {
+    static const InputActionState idle;
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)action, _states.size(), idle);
+    return _states[action];
+}
+
+float InputActionMap::value(InputActionId action) const {
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)action, _states.size(), 0.0f);
+    return _states[action].value;
+}
+
+bool InputActionMap::down(InputActionId action) const {
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)action, _states.size(), false);
+    return _states[action].down;
+}
+
+bool InputActionMap::pressed(InputActionId action) const {
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)action, _states.size(), false);
+    return _states[action].pressed;
+}
+
+bool InputActionMap::released(InputActionId action) const {
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)action, _states.size(), false);
+    return _states[action].released;
+}
+
+float InputActionMap::_sample(const _CompiledBinding& binding) {
+    switch (binding.source) {
+        case INPUT_BINDING_KEY:
+            return Input::key_press((KeyCode)binding.code) ? 1.0f : 0.0f;
+        case INPUT_BINDING_MOUSE_BUTTON:
+            return Input::mouse_press((MouseButton)binding.code) ? 1.0f : 0.0f;
+        case INPUT_BINDING_GAMEPAD_BUTTON:
+        case INPUT_BINDING_GAMEPAD_AXIS:
+            if (binding.gamepad >= 0) {
+                return _sample_gamepad(binding, binding.gamepad);
+            } else {
+                // Strongest input across all connected gamepads wins
+                float result = 0.0f;
+                for (int32_t gamepad = 0; gamepad <= GamepadJoystick_LAST; gamepad++) {
+                    if (Input::gamepad_connected((GamepadJoystick)gamepad)) {
+                        float value = _sample_gamepad(binding, gamepad);
+                        result = std::fabs(value) > std::fabs(result) ? value : result;
+                    }
+                }
+                return result;
+            }
+    }
+    return 0.0f;
+}
+
+float InputActionMap::_sample_gamepad(const _CompiledBinding& binding, int32_t gamepad) {
+    if (binding.source == INPUT_BINDING_GAMEPAD_BUTTON) {
+        return Input::gamepad_button_press((GamepadJoystick)gamepad, (GamepadButton)binding.code)
+                   ? 1.0f
+                   : 0.0f;
+    }
+    float value = Input::gamepad_axis((GamepadJoystick)gamepad, (GamepadAxis)binding.code);
+    return std::fabs(value) < binding.dead_zone ? 0.0f : value;
+}
+
+} // namespace ky
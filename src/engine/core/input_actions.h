@@ -0,0 +1,115 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_CORE__INPUT_ACTIONS_H
+#define KRYOS_CORE__INPUT_ACTIONS_H
+
+#include "core/input.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define KY_INPUT_ACTION_INVALID UINT32_MAX
+
+namespace ky {
+
+using InputActionId = uint32_t;
+
+enum InputBindingSource : uint8_t {
+    INPUT_BINDING_KEY,
+    INPUT_BINDING_MOUSE_BUTTON,
+    INPUT_BINDING_GAMEPAD_BUTTON,
+    INPUT_BINDING_GAMEPAD_AXIS,
+};
+
+// Single physical input bound to an action. The sampled value, 0 or 1 for buttons and the axis
+// position for axes, is multiplied by `scale` before being added to the action's value. Axes
+// within `dead_zone` of rest read as 0.
+struct InputBinding {
+    InputBindingSource source = INPUT_BINDING_KEY;
+    int32_t code = 0;
+    float scale = 1.0f;
+    float dead_zone = 0.15f;
+    // Gamepad to read from, -1 reads every connected gamepad.
+    int32_t gamepad = -1;
+};
+
+struct InputActionState {
+    float value = 0.0f;
+    bool down = false;
+    bool pressed = false;
+    bool released = false;
+};
+
+// Maps named actions to any number of keyboard, mouse and gamepad bindings. Bindings are compiled
+// into a flat table sorted by source, `update` evaluates the table once per frame and stores the
+// result of every action so gameplay code only does a single indexed read per action.
+//
+// An action's value is the sum of all its bindings clamped to [-1, 1], e.g. binding A with a scale
+// of -1 and D with a scale of 1 to the same action makes a horizontal movement axis. The action is
+// down while the magnitude of its value is at least `press_threshold`.
+class InputActionMap {
+public:
+    InputActionId add_action(const std::string_view& name, float press_threshold = 0.5f);
+    InputActionId find_action(const std::string_view& name) const;
+    inline size_t action_count() const { return _names.size(); }
+
+    void bind(InputActionId action, const InputBinding& binding);
+    void bind_key(InputActionId action, KeyCode code, float scale = 1.0f);
+    void bind_mouse_button(InputActionId action, MouseButton button, float scale = 1.0f);
+    void bind_gamepad_button(InputActionId action, GamepadButton button, float scale = 1.0f);
+    void bind_gamepad_axis(InputActionId action, GamepadAxis axis, float scale = 1.0f,
+                           float dead_zone = 0.15f);
+    void clear_bindings(InputActionId action);
+
+    // Rebuilds the flat binding table, called automatically by `update` after bindings changed.
+    void compile();
+
+    // Evaluates every action, must be called once per frame after `Input::poll_events`.
+    void update();
+
+    // Invalid actions, e.g. `KY_INPUT_ACTION_INVALID`, are reported and read as idle.
+    const InputActionState& state(InputActionId action) const;
+    float value(InputActionId action) const;
+    bool down(InputActionId action) const;
+    bool pressed(InputActionId action) const;
+    bool released(InputActionId action) const;
+
+private:
+    struct _CompiledBinding {
+        InputActionId action;
+        InputBindingSource source;
+        int32_t code;
+        float scale;
+        float dead_zone;
+        int32_t gamepad;
+    };
+
+    std::vector<std::string> _names;
+    std::vector<float> _press_thresholds;
+    std::vector<std::vector<InputBinding>> _bindings;
+    std::vector<_CompiledBinding> _compiled;
+    std::vector<InputActionState> _states;
+    bool _dirty = false;
+
+    static float _sample(const _CompiledBinding& binding);
+    static float _sample_gamepad(const _CompiledBinding& binding, int32_t gamepad);
+};
+
+} // namespace ky
+
+#endif
@@ -0,0 +1,289 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/input_recording.h"
+
+#include "core/error.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace ky {
+
+static constexpr char _MAGIC[4] = {'K', 'Y', 'I', 'R'};
+static constexpr size_t _FLUSH_SIZE = 64 * 1024;
+static constexpr double _FIXED_SCALE = 16.0;
+
+enum _RecordType : uint8_t {
+    _RECORD_FRAME = 0,
+    _RECORD_KEY = 1,
+    _RECORD_MOUSE_BUTTON = 2,
+    _RECORD_CURSOR = 3,
+    _RECORD_SCROLL = 4,
+};
+
+static constexpr uint8_t _RECORD_TYPE_MASK = 0x07;
+static constexpr uint8_t _RECORD_PRESS_BIT = 1 << 3;
+static constexpr uint8_t _RECORD_WINDOW_BIT = 1 << 4;
+
+static int64_t to_fixed(double value) {
+    return (int64_t)std::llround(value * _FIXED_SCALE);
+}
+
+InputRecorder::~InputRecorder() {
+    close();
+}
+
+bool InputRecorder::open(const char* path) {
+    close();
+    _file = fopen(path, "wb");
+    KY_ERROR_CONDITION_MSG_RETURN(_file != nullptr, false, "Failed to open input recording file");
+
+    _buffer.reserve(_FLUSH_SIZE * 2);
+    _buffer.resize(sizeof(_MAGIC));
+    std::memcpy(_buffer.data(), _MAGIC, sizeof(_MAGIC));
+    _buffer.push_back(KY_INPUT_RECORDING_VERSION);
+    _pending_frames = 0;
+    _last_time = 0;
+    _last_cursor_x = 0;
+    _last_cursor_y = 0;
+    _has_origin = false;
+    return true;
+}
+
+void InputRecorder::close() {
+    if (_file == nullptr) {
+        return;
+    }
+    _write_pending_frames();
+    _flush();
+    fclose(_file);
+    _file = nullptr;
+}
+
+void InputRecorder::write_frame(const std::vector<InputEvent>& events) {
+    if (_file == nullptr) {
+        return;
+    }
+    if (events.empty()) {
+        _pending_frames++;
+        return;
+    }
+
+    _write_pending_frames();
+    for (const InputEvent& event : events) {
+        if (!_has_origin) {
+            _origin = event.timestamp;
+            _has_origin = true;
+        }
+        // Timestamps are stored in microseconds since the first recorded event
+        int64_t time = std::max<int64_t>((event.timestamp - _origin) / 1000, _last_time);
+
+        uint8_t tag = 0;
+        switch (event.type) {
+            case INPUT_EVENT_KEY:
+                tag = _RECORD_KEY;
+                break;
+            case INPUT_EVENT_MOUSE_BUTTON:
+                tag = _RECORD_MOUSE_BUTTON;
+                break;
+            case INPUT_EVENT_CURSOR:
+                tag = _RECORD_CURSOR;
+                break;
+            case INPUT_EVENT_SCROLL:
+                tag = _RECORD_SCROLL;
+                break;
+        }
+        if (event.action == INPUT_ACTION_PRESS) {
+            tag |= _RECORD_PRESS_BIT;
+        }
+        if (event.window_id != 0) {
+            tag |= _RECORD_WINDOW_BIT;
+        }
+
+        _buffer.push_back(tag);
+        if (event.window_id != 0) {
+            _write_varint(event.window_id);
+        }
+        _write_varint((uint64_t)(time - _last_time));
+        _last_time = time;
+
+        if (event.type == INPUT_EVENT_KEY || event.type == INPUT_EVENT_MOUSE_BUTTON) {
+            _write_varint((uint64_t)event.code);
+        } else if (event.type == INPUT_EVENT_CURSOR) {
+            int64_t x = to_fixed(event.x);
+            int64_t y = to_fixed(event.y);
+            _write_signed_varint(x - _last_cursor_x);
+            _write_signed_varint(y - _last_cursor_y);
+            _last_cursor_x = x;
+            _last_cursor_y = y;
+        } else {
+            _write_signed_varint(to_fixed(event.x));
+            _write_signed_varint(to_fixed(event.y));
+        }
+    }
+
+    // The end of this frame is written together with any empty frames following it
+    _pending_frames = 1;
+    if (_buffer.size() >= _FLUSH_SIZE) {
+        _flush();
+    }
+}
+
+void InputRecorder::_write_varint(uint64_t value) {
+    while (value >= 0x80) {
+        _buffer.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    _buffer.push_back((uint8_t)value);
+}
+
+void InputRecorder::_write_signed_varint(int64_t value) {
+    _write_varint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void InputRecorder::_write_pending_frames() {
+    if (_pending_frames == 0) {
+        return;
+    }
+    _buffer.push_back(_RECORD_FRAME);
+    _write_varint(_pending_frames);
+    _pending_frames = 0;
+}
+
+void InputRecorder::_flush() {
+    if (!_buffer.empty()) {
+        size_t written = fwrite(_buffer.data(), 1, _buffer.size(), _file);
+        KY_ERROR_CONDITION_MSG(written == _buffer.size(), "Failed to write input recording");
+        _buffer.clear();
+    }
+}
+
+bool InputPlayback::open(const char* path) {
+    close();
+    FILE* file = fopen(path, "rb");
+    KY_ERROR_CONDITION_MSG_RETURN(file != nullptr, false, "Failed to open input recording file");
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size > 0) {
+        _data.resize((size_t)size);
+        _data.resize(fread(_data.data(), 1, _data.size(), file));
+    }
+    fclose(file);
+
+    bool valid = _data.size() > sizeof(_MAGIC) &&
+                 std::memcmp(_data.data(), _MAGIC, sizeof(_MAGIC)) == 0 &&
+                 _data[sizeof(_MAGIC)] == KY_INPUT_RECORDING_VERSION;
+    if (!valid) {
+        close();
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(valid, false, "Not a supported input recording file");
+
+    _position = sizeof(_MAGIC) + 1;
+    return true;
+}
+
+void InputPlayback::close() {
+    _data.clear();
+    _data.shrink_to_fit();
+    _position = 0;
+    _pending_frames = 0;
+    _time = 0;
+    _cursor_x = 0;
+    _cursor_y = 0;
+}
+
+bool InputPlayback::read_frame(std::vector<InputEvent>& events) {
+    events.clear();
+    if (_pending_frames > 0) {
+        _pending_frames--;
+        return true;
+    }
+
+    while (_position < _data.size()) {
+        uint8_t tag = _data[_position++];
+        uint8_t type = tag & _RECORD_TYPE_MASK;
+        if (type == _RECORD_FRAME) {
+            uint64_t frames = 0;
+            KY_ERROR_CONDITION_MSG_RETURN(_read_varint(frames) && frames > 0, false,
+                                          "Corrupt input recording");
+            _pending_frames = frames - 1;
+            return true;
+        }
+
+        InputEvent event;
+        uint64_t window_id = 0;
+        uint64_t time_delta = 0;
+        bool valid = (tag & _RECORD_WINDOW_BIT) == 0 || _read_varint(window_id);
+        valid = valid && _read_varint(time_delta);
+        _time += (int64_t)time_delta;
+        event.timestamp = _time * 1000;
+        event.window_id = (uint32_t)window_id;
+        event.action = (tag & _RECORD_PRESS_BIT) != 0 ? INPUT_ACTION_PRESS : INPUT_ACTION_RELEASE;
+
+        if (type == _RECORD_KEY || type == _RECORD_MOUSE_BUTTON) {
+            uint64_t code = 0;
+            valid = valid && _read_varint(code);
+            event.type = type == _RECORD_KEY ? INPUT_EVENT_KEY : INPUT_EVENT_MOUSE_BUTTON;
+            event.code = (int32_t)code;
+        } else if (type == _RECORD_CURSOR || type == _RECORD_SCROLL) {
+            int64_t x = 0;
+            int64_t y = 0;
+            valid = valid && _read_signed_varint(x) && _read_signed_varint(y);
+            if (type == _RECORD_CURSOR) {
+                _cursor_x += x;
+                _cursor_y += y;
+                x = _cursor_x;
+                y = _cursor_y;
+            }
+            event.type = type == _RECORD_CURSOR ? INPUT_EVENT_CURSOR : INPUT_EVENT_SCROLL;
+            event.x = (double)x / _FIXED_SCALE;
+            event.y = (double)y / _FIXED_SCALE;
+        } else {
+            valid = false;
+        }
+        KY_ERROR_CONDITION_MSG_RETURN(valid, false, "Corrupt input recording");
+        events.push_back(event);
+    }
+
+    // Recordings always end with a frame record, events without one are incomplete
+    return false;
+}
+
+bool InputPlayback::_read_varint(uint64_t& value) {
+    value = 0;
+    for (uint32_t shift = 0; shift < 64 && _position < _data.size(); shift += 7) {
+        uint8_t byte = _data[_position++];
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool InputPlayback::_read_signed_varint(int64_t& value) {
+    uint64_t encoded = 0;
+    if (!_read_varint(encoded)) {
+        return false;
+    }
+    value = (int64_t)(encoded >> 1) ^ -(int64_t)(encoded & 1);
+    return true;
+}
+
+} // namespace ky
@@ -0,0 +1,100 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_CORE__INPUT_RECORDING_H
+#define KRYOS_CORE__INPUT_RECORDING_H
+
+#include "core/input.h"
+
+#include <cstdio>
+#include <vector>
+
+// Input recording file format:
+//
+// A 4 byte magic "KYIR" and a version byte, followed by a stream of records. Each record starts
+// with a tag byte, the low 3 bits hold the record type, bit 3 the press/release action and bit 4
+// whether a varint window id follows (omitted for window 0). All integers are LEB128 varints,
+// signed values are zigzag encoded.
+//
+// * Frame:        varint number of frames ended. Runs of frames without events share one record.
+// * Key/Mouse:    varint microseconds since the previous event, varint key/button code.
+// * Cursor:       varint microseconds since the previous event, signed x/y deltas from the
+//                 previous cursor event in 1/16th pixels.
+// * Scroll:       varint microseconds since the previous event, signed x/y offsets in 1/16ths.
+//
+// Cursor and scroll values are therefore replayed with 1/16th precision, which keeps multi-hour
+// recordings to a few bytes per event.
+
+#define KY_INPUT_RECORDING_VERSION 1
+
+namespace ky {
+
+class InputRecorder {
+public:
+    InputRecorder() = default;
+    ~InputRecorder();
+
+    InputRecorder(const InputRecorder&) = delete;
+    InputRecorder& operator=(const InputRecorder&) = delete;
+
+    bool open(const char* path);
+    void close();
+    inline bool is_open() const { return _file != nullptr; }
+
+    // Appends a frame, `events` can be empty.
+    void write_frame(const std::vector<InputEvent>& events);
+
+private:
+    FILE* _file = nullptr;
+    std::vector<uint8_t> _buffer;
+    uint64_t _pending_frames = 0;
+    int64_t _origin = 0;
+    int64_t _last_time = 0;
+    int64_t _last_cursor_x = 0;
+    int64_t _last_cursor_y = 0;
+    bool _has_origin = false;
+
+    void _write_varint(uint64_t value);
+    void _write_signed_varint(int64_t value);
+    void _write_pending_frames();
+    void _flush();
+};
+
+class InputPlayback {
+public:
+    // Loads the entire recording into memory, decoding frames afterwards never allocates as long
+    // as the events vector passed to `read_frame` has enough capacity.
+    bool open(const char* path);
+    void close();
+    inline bool is_open() const { return !_data.empty(); }
+
+    // Decodes the next recorded frame into `events`. Returns false once the recording has ended.
+    bool read_frame(std::vector<InputEvent>& events);
+
+private:
+    std::vector<uint8_t> _data;
+    size_t _position = 0;
+    uint64_t _pending_frames = 0;
+    int64_t _time = 0;
+    int64_t _cursor_x = 0;
+    int64_t _cursor_y = 0;
+
+    bool _read_varint(uint64_t& value);
+    bool _read_signed_varint(int64_t& value);
+};
+
+} // namespace ky
+
+#endif
@@ -0,0 +1,246 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/jobs.h"
+
+#include "core/error.h"
+#include "core/profiler.h"
+
+namespace ky {
+
+static_assert((KY_JOB_POOL_CAPACITY & (KY_JOB_POOL_CAPACITY - 1)) == 0,
+              "KY_JOB_POOL_CAPACITY must be a power of two");
+
+// Index into `JobSystem::_threads` of the calling thread, invalid for threads that aren't part of
+// the job system
+static thread_local uint32_t current_thread_index = KY_JOB_INVALID_THREAD;
+
+JobSystem* JobSystem::_instance = nullptr;
+
+JobSystem::~JobSystem() {
+    if (_instance == this) {
+        shutdown();
+    }
+}
+
+void JobSystem::init(JobSystem& instance, int32_t worker_count) {
+    KY_FATAL_CONDITION_MSG(_instance == nullptr, "JobSystem is already initialized");
+    if (worker_count < 0) {
+        uint32_t hardware_threads = std::thread::hardware_concurrency();
+        worker_count = hardware_threads > 1 ? (int32_t)hardware_threads - 1 : 1;
+    }
+
+    _instance = &instance;
+    instance._running = true;
+    instance._queued_jobs = 0;
+    for (uint32_t i = 0; i < (uint32_t)worker_count + 1; i++) {
+        instance._threads.push_back(memory::create<_ThreadData>(MEMORY_TAG_CORE));
+        instance._threads.back()->steal_seed = i * 2654435761u + 1;
+    }
+    current_thread_index = 0;
+    for (uint32_t i = 1; i < (uint32_t)worker_count + 1; i++) {
+        instance._workers.emplace_back(_worker_main, i);
+    }
+}
+
+void JobSystem::shutdown() {
+    if (_instance == nullptr) {
+        return;
+    }
+    JobSystem& instance = *_instance;
+    {
+        std::lock_guard<std::mutex> lock(instance._sleep_mutex);
+        instance._running = false;
+    }
+    instance._sleep_condition.notify_all();
+    for (std::thread& worker : instance._workers) {
+        worker.join();
+    }
+    instance._workers.clear();
+    for (_ThreadData* thread : instance._threads) {
+        memory::destroy(MEMORY_TAG_CORE, thread);
+    }
+    instance._threads.clear();
+    current_thread_index = KY_JOB_INVALID_THREAD;
+    _instance = nullptr;
+}
+
+uint32_t JobSystem::worker_count() {
+    return _instance != nullptr ? (uint32_t)_instance->_workers.size() : 0;
+}
+
+uint32_t JobSystem::thread_index() {
+    return current_thread_index;
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    KY_PROFILE_SCOPE("JobSystem::wait");
+    while (!counter.done()) {
+        if (!_execute_one()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool JobSystem::_JobDeque::push(Job* job) {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed);
+    int64_t top = _top.load(std::memory_order_acquire);
+    if (bottom - top >= KY_JOB_POOL_CAPACITY) {
+        return false;
+    }
+    _jobs[bottom & (KY_JOB_POOL_CAPACITY - 1)].store(job, std::memory_order_relaxed);
+    _bottom.store(bottom + 1, std::memory_order_release);
+    return true;
+}
+
+Job* JobSystem::_JobDeque::pop() {
+    // Reserve the bottom job before looking at top, a thief can only take it if it read bottom
+    // before the reservation
+    int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(bottom, std::memory_order_seq_cst);
+    int64_t top = _top.load(std::memory_order_seq_cst);
+    if (top > bottom) {
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = _jobs[bottom & (KY_JOB_POOL_CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        // Last job, race the thieves for it
+        if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job* JobSystem::_JobDeque::steal() {
+    int64_t top = _top.load(std::memory_order_seq_cst);
+    int64_t bottom = _bottom.load(std::memory_order_seq_cst);
+    if (top >= bottom) {
+        return nullptr;
+    }
+    Job* job = _jobs[top & (KY_JOB_POOL_CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return job;
+}
+
+Job* JobSystem::_allocate_job() {
+    KY_FATAL_CONDITION_MSG(_instance != nullptr && current_thread_index != KY_JOB_INVALID_THREAD,
+                           "Jobs can only be submitted by the thread that initialized the "
+                           "JobSystem or from inside jobs");
+    _ThreadData& thread = *_instance->_threads[current_thread_index];
+
+    // Jobs finish roughly in order so the next slot is almost always free, the scan only skips
+    // long running or long queued jobs
+    for (uint32_t i = 0; i < KY_JOB_POOL_CAPACITY; i++) {
+        Job* job = &thread.pool[thread.pool_next];
+        thread.pool_next = (thread.pool_next + 1) & (KY_JOB_POOL_CAPACITY - 1);
+        if (!job->active.load(std::memory_order_acquire)) {
+            job->active.store(true, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void JobSystem::_submit(Job* job, JobCounter& counter) {
+    job->counter = &counter;
+    counter.value.fetch_add(1, std::memory_order_relaxed);
+
+    JobSystem& instance = *_instance;
+    if (!instance._threads[current_thread_index]->deque.push(job)) {
+        // Deque is full, running it now is better than dropping it
+        _execute(job);
+        return;
+    }
+    instance._queued_jobs.fetch_add(1, std::memory_order_seq_cst);
+    if (instance._sleeping_workers.load(std::memory_order_seq_cst) > 0) {
+        // Taking the lock orders this with a worker that's about to wait
+        { std::lock_guard<std::mutex> lock(instance._sleep_mutex); }
+        instance._sleep_condition.notify_one();
+    }
+}
+
+bool JobSystem::_execute_one() {
+    KY_FATAL_CONDITION_MSG(_instance != nullptr && current_thread_index != KY_JOB_INVALID_THREAD,
+                           "Only threads of the JobSystem can execute jobs");
+    JobSystem& instance = *_instance;
+    _ThreadData& thread = *instance._threads[current_thread_index];
+
+    Job* job = thread.deque.pop();
+    if (job == nullptr) {
+        // Start stealing at a random victim so thieves don't all contend on the same deque
+        uint32_t thread_count = (uint32_t)instance._threads.size();
+        thread.steal_seed ^= thread.steal_seed << 13;
+        thread.steal_seed ^= thread.steal_seed >> 17;
+        thread.steal_seed ^= thread.steal_seed << 5;
+        uint32_t start = thread.steal_seed % thread_count;
+        for (uint32_t i = 0; i < thread_count && job == nullptr; i++) {
+            uint32_t victim = (start + i) % thread_count;
+            if (victim != current_thread_index) {
+                job = instance._threads[victim]->deque.steal();
+            }
+        }
+    }
+    if (job == nullptr) {
+        return false;
+    }
+    instance._queued_jobs.fetch_sub(1, std::memory_order_relaxed);
+    _execute(job);
+    return true;
+}
+
+void JobSystem::_execute(Job* job) {
+    JobCounter* counter = job->counter;
+    job->function(*job);
+    job->active.store(false, std::memory_order_release);
+    counter->value.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::_worker_main(uint32_t index) {
+    current_thread_index = index;
+    Profiler::set_thread_name("Job worker");
+    JobSystem& instance = *_instance;
+
+    uint32_t idle_spins = 0;
+    while (instance._running.load(std::memory_order_relaxed)) {
+        if (_execute_one()) {
+            idle_spins = 0;
+            continue;
+        }
+        // Spin briefly as jobs tend to arrive in bursts, then sleep until more are queued
+        if (++idle_spins < 64) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(instance._sleep_mutex);
+        instance._sleeping_workers.fetch_add(1, std::memory_order_seq_cst);
+        instance._sleep_condition.wait(lock, [&instance]() {
+            return instance._queued_jobs.load(std::memory_order_seq_cst) > 0 ||
+                   !instance._running.load(std::memory_order_relaxed);
+        });
+        instance._sleeping_workers.fetch_sub(1, std::memory_order_seq_cst);
+        idle_spins = 0;
+    }
+    current_thread_index = KY_JOB_INVALID_THREAD;
+}
+
+} // namespace ky
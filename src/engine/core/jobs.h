@@ -0,0 +1,214 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_CORE__JOBS_H
+#define KRYOS_CORE__JOBS_H
+
+#include "core/macros.h"
+#include "core/memory_tracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bytes available inline in a job for its function's captures. Capture pointers to larger data.
+#ifndef KY_JOB_DATA_SIZE
+#    define KY_JOB_DATA_SIZE 48
+#endif
+
+// Jobs a single thread can have queued or running. Once a thread's pool is exhausted the jobs it
+// submits run inline instead.
+#ifndef KY_JOB_POOL_CAPACITY
+#    define KY_JOB_POOL_CAPACITY 4096
+#endif
+
+#define KY_JOB_INVALID_THREAD UINT32_MAX
+
+namespace ky {
+
+struct Job;
+struct JobCounter;
+
+using JobFunction = void (*)(Job& job);
+
+struct Job {
+    JobFunction function = nullptr;
+    JobCounter* counter = nullptr;
+    // Set from submission until the job finished, the slot can't be reused in between
+    std::atomic<bool> active = false;
+    alignas(std::max_align_t) unsigned char data[KY_JOB_DATA_SIZE];
+};
+
+// Counts unfinished jobs. Every job submitted with a counter increments it and decrements it once
+// it finished, wait on it with `JobSystem::wait` to depend on all of them.
+struct JobCounter {
+    std::atomic<uint32_t> value = 0;
+
+    inline bool done() const { return value.load(std::memory_order_acquire) == 0; }
+};
+
+// Work-stealing job system. Each worker owns a deque it pushes and pops jobs at the bottom of,
+// idle workers steal from the top of the others. The thread calling `init` also gets a deque but
+// isn't a worker, it stays free for GLFW which has to be driven from the main thread, and only
+// executes jobs while waiting on them.
+//
+// Jobs can be submitted from the main thread and from inside other jobs. Waiting never blocks a
+// thread outright, it executes pending jobs until the counter reaches zero.
+class JobSystem {
+public:
+    JobSystem() = default;
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Starts `worker_count` workers, -1 starts one for every hardware thread besides the calling
+    // thread's. With 0 workers jobs only run on the calling thread while it waits.
+    static void init(JobSystem& instance, int32_t worker_count = -1);
+    static void shutdown();
+
+    static uint32_t worker_count();
+    // Index of the calling thread in [0, thread_count), 0 is the thread that called `init`.
+    // `KY_JOB_INVALID_THREAD` for threads that aren't part of the job system.
+    static uint32_t thread_index();
+    // Threads executing jobs, the workers and the thread that called `init`.
+    static inline uint32_t thread_count() { return worker_count() + 1; }
+
+    // Submits `function` to run on any thread. Its captures are copied into the job so they must
+    // be trivially copyable and fit in `KY_JOB_DATA_SIZE` bytes.
+    template <typename _Function>
+    static void run(JobCounter& counter, _Function&& function);
+
+    // Executes pending jobs on the calling thread until `counter` reaches zero.
+    static void wait(JobCounter& counter);
+
+    // Calls `body(index)` for every index in [0, count) spread over all threads and waits for it
+    // to finish. The range is split into a few chunks per thread, but never smaller than
+    // `min_chunk_size` indices so cheap bodies aren't dominated by scheduling. Runs serially when
+    // the job system isn't initialized or the calling thread isn't part of it.
+    template <typename _Body>
+    static void parallel_for(size_t count, _Body&& body, size_t min_chunk_size = 1);
+
+private:
+    // Chase-Lev deque. Only the owning thread calls `push` and `pop`, any thread can `steal`.
+    class _JobDeque {
+    public:
+        bool push(Job* job);
+        Job* pop();
+        Job* steal();
+
+    private:
+        alignas(KY_CACHE_LINE_SIZE) std::atomic<int64_t> _top = 0;
+        alignas(KY_CACHE_LINE_SIZE) std::atomic<int64_t> _bottom = 0;
+        TaggedVector<std::atomic<Job*>, MEMORY_TAG_CORE> _jobs =
+            TaggedVector<std::atomic<Job*>, MEMORY_TAG_CORE>(KY_JOB_POOL_CAPACITY);
+    };
+
+    struct alignas(KY_CACHE_LINE_SIZE) _ThreadData {
+        _JobDeque deque;
+        TaggedVector<Job, MEMORY_TAG_CORE> pool =
+            TaggedVector<Job, MEMORY_TAG_CORE>(KY_JOB_POOL_CAPACITY);
+        uint32_t pool_next = 0;
+        uint32_t steal_seed = 0;
+    };
+
+    std::vector<_ThreadData*> _threads;
+    std::vector<std::thread> _workers;
+    std::atomic<bool> _running = false;
+
+    // Sleeping workers wake up when jobs are queued, the counters are sequentially consistent so
+    // a submit either sees a sleeper or the sleeper sees the queued job.
+    std::mutex _sleep_mutex;
+    std::condition_variable _sleep_condition;
+    std::atomic<int32_t> _queued_jobs = 0;
+    std::atomic<uint32_t> _sleeping_workers = 0;
+
+    static JobSystem* _instance;
+
+    static Job* _allocate_job();
+    static void _submit(Job* job, JobCounter& counter);
+    static bool _execute_one();
+    static void _execute(Job* job);
+    static void _worker_main(uint32_t thread_index);
+};
+
+template <typename _Function>
+void JobSystem::run(JobCounter& counter, _Function&& function) {
+    using Function = std::decay_t<_Function>;
+    static_assert(sizeof(Function) <= KY_JOB_DATA_SIZE,
+                  "Job captures are too large, capture a pointer to them instead");
+    static_assert(alignof(Function) <= alignof(std::max_align_t), "Job captures are over aligned");
+    static_assert(std::is_trivially_copyable_v<Function>,
+                  "Job captures must be trivially copyable");
+
+    Job* job = _allocate_job();
+    if (job == nullptr) {
+        function();
+        return;
+    }
+    job->function = [](Job& job) { (*std::launder((Function*)job.data))(); };
+    new (job->data) Function(std::forward<_Function>(function));
+    _submit(job, counter);
+}
+
+template <typename _Body>
+void JobSystem::parallel_for(size_t count, _Body&& body, size_t min_chunk_size) {
+    if (count == 0) {
+        return;
+    }
+    if (worker_count() == 0 || thread_index() == KY_JOB_INVALID_THREAD) {
+        for (size_t i = 0; i < count; i++) {
+            body(i);
+        }
+        return;
+    }
+    size_t chunk_size = (count + thread_count() * 4 - 1) / (thread_count() * 4);
+    chunk_size = std::max(chunk_size, std::max(min_chunk_size, (size_t)1));
+    if (chunk_size >= count) {
+        for (size_t i = 0; i < count; i++) {
+            body(i);
+        }
+        return;
+    }
+
+    // Chunks reference the body on this stack frame, safe as this waits for all of them
+    auto* body_ptr = &body;
+    JobCounter counter;
+    for (size_t begin = chunk_size; begin < count; begin += chunk_size) {
+        size_t end = std::min(begin + chunk_size, count);
+        run(counter, [body_ptr, begin, end]() {
+            for (size_t i = begin; i < end; i++) {
+                (*body_ptr)(i);
+            }
+        });
+    }
+    // The first chunk runs here instead of waiting idle for a thief
+    for (size_t i = 0; i < chunk_size; i++) {
+        body(i);
+    }
+    wait(counter);
+}
+
+} // namespace ky
+
+#endif
@@ -52,6 +52,24 @@
 #    define KY_FORCE_INLINE inline
 #endif
 
+// Assumed size of a cache line, used to keep data written by different threads apart.
+#define KY_CACHE_LINE_SIZE 64
+
 #define KY_STR(non_null_term_str) (int) non_null_term_str.size(), non_null_term_str.data()
 
+#define _KY_CONCAT_IMPL(a, b) a##b
+#define KY_CONCAT(a, b)       _KY_CONCAT_IMPL(a, b)
+
+// Profiler zones (`KY_PROFILE_SCOPE`) are compiled in unless this is set to 0. Shipping builds
+// should disable it so zones compile down to nothing.
+#ifndef KY_PROFILER_ENABLED
+#    define KY_PROFILER_ENABLED 1
+#endif
+
+// Allocations made through `memory::allocate` and the engine allocators are counted per
+// `MemoryTag` unless this is set to 0, in which case the counters compile down to nothing.
+#ifndef KY_MEMORY_TRACKING_ENABLED
+#    define KY_MEMORY_TRACKING_ENABLED 1
+#endif
+
 #endif
@@ -0,0 +1,129 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/mapped_file.h"
+
+#include "core/error.h"
+
+#include <utility>
+
+#ifdef KY_PLATFORM_WINDOWS
+#    define WIN32_LEAN_AND_MEAN
+#    define NOMINMAX
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace ky {
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) {
+    if (this != &other) {
+        close();
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+#ifdef KY_PLATFORM_WINDOWS
+        std::swap(_file, other._file);
+        std::swap(_mapping, other._mapping);
+#endif
+    }
+    return *this;
+}
+
+#ifdef KY_PLATFORM_WINDOWS
+
+bool MappedFile::open(const char* path) {
+    close();
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    KY_ERROR_CONDITION_MSG_RETURN(file != INVALID_HANDLE_VALUE, false, "Failed to open file");
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        KY_ERROR_MSG("Failed to map %s, the file is empty", path);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* data = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (data == nullptr) {
+        if (mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        KY_ERROR_MSG("Failed to map %s", path);
+        return false;
+    }
+    _file = file;
+    _mapping = mapping;
+    _data = (const uint8_t*)data;
+    _size = (size_t)size.QuadPart;
+    return true;
+}
+
+void MappedFile::close() {
+    if (_data != nullptr) {
+        UnmapViewOfFile(_data);
+        CloseHandle((HANDLE)_mapping);
+        CloseHandle((HANDLE)_file);
+    }
+    _data = nullptr;
+    _size = 0;
+    _file = nullptr;
+    _mapping = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const char* path) {
+    close();
+    int file = ::open(path, O_RDONLY);
+    KY_ERROR_CONDITION_MSG_RETURN(file >= 0, false, "Failed to open file");
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0) {
+        ::close(file);
+        KY_ERROR_MSG("Failed to map %s, the file is empty", path);
+        return false;
+    }
+    // The mapping keeps its own reference to the file
+    void* data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    KY_ERROR_CONDITION_MSG_RETURN(data != MAP_FAILED, false, "Failed to map file");
+    _data = (const uint8_t*)data;
+    _size = (size_t)status.st_size;
+    return true;
+}
+
+void MappedFile::close() {
+    if (_data != nullptr) {
+        munmap((void*)_data, _size);
+    }
+    _data = nullptr;
+    _size = 0;
+}
+
+#endif
+
+} // namespace ky
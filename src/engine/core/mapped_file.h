@@ -0,0 +1,55 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_CORE__MAPPED_FILE_H
+#define KRYOS_CORE__MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ky {
+
+// Read only memory mapping of an entire file. Pages are read from disk on first access and shared
+// with the OS page cache, so data can be used in place without copying it into the heap.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other);
+    MappedFile& operator=(MappedFile&& other);
+
+    // Fails on missing and empty files.
+    bool open(const char* path);
+    void close();
+    inline bool is_open() const { return _data != nullptr; }
+
+    inline const uint8_t* data() const { return _data; }
+    inline size_t size() const { return _size; }
+
+private:
+    const uint8_t* _data = nullptr;
+    size_t _size = 0;
+#ifdef KY_PLATFORM_WINDOWS
+    void* _file = nullptr;
+    void* _mapping = nullptr;
+#endif
+};
+
+} // namespace ky
+
+#endif
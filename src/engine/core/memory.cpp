@@ -0,0 +1,291 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/memory.h"
+
+#include "core/error.h"
+
+#include <algorithm>
+
+namespace ky {
+
+LinearArena::LinearArena(size_t capacity, MemoryTag tag)
+        : _initial_capacity(capacity), _tag(tag) {
+    _push_block(capacity);
+}
+
+LinearArena::~LinearArena() {
+    _free_blocks(nullptr);
+}
+
+LinearArena::LinearArena(LinearArena&& arena) noexcept
+        : _current(arena._current), _offset(arena._offset),
+          _used_in_previous_blocks(arena._used_in_previous_blocks),
+          _initial_capacity(arena._initial_capacity), _high_water(arena._high_water),
+          _tag(arena._tag) {
+    arena._current = nullptr;
+    arena._offset = 0;
+    arena._used_in_previous_blocks = 0;
+}
+
+LinearArena& LinearArena::operator=(LinearArena&& arena) noexcept {
+    if (this != &arena) {
+        _free_blocks(nullptr);
+        _current = arena._current;
+        _offset = arena._offset;
+        _used_in_previous_blocks = arena._used_in_previous_blocks;
+        _initial_capacity = arena._initial_capacity;
+        _high_water = arena._high_water;
+        _tag = arena._tag;
+        arena._current = nullptr;
+        arena._offset = 0;
+        arena._used_in_previous_blocks = 0;
+    }
+    return *this;
+}
+
+void* LinearArena::allocate(size_t size, size_t alignment) {
+    KY_ERROR_CONDITION_MSG_RETURN((alignment & (alignment - 1)) == 0, nullptr,
+                                  "Alignment must be a power of two");
+    if (_current != nullptr) {
+        uintptr_t data = (uintptr_t)(_current + 1);
+        size_t offset = align_up(data + _offset, alignment) - data;
+        if (offset + size <= _current->capacity) {
+            _offset = offset + size;
+            _high_water = std::max(_high_water, used());
+            return (void*)(data + offset);
+        }
+    }
+
+    _push_block(size + alignment);
+    uintptr_t data = (uintptr_t)(_current + 1);
+    size_t offset = align_up(data, alignment) - data;
+    _offset = offset + size;
+    _high_water = std::max(_high_water, used());
+    return (void*)(data + offset);
+}
+
+void LinearArena::rewind(size_t marker) {
+    KY_ERROR_CONDITION_MSG(marker <= used(), "Can't rewind an arena forward");
+    if (marker == 0) {
+        reset();
+        return;
+    }
+    while (_current->previous != nullptr && _current->used_before >= marker) {
+        _Block* previous = _current->previous;
+        memory::deallocate(_current, sizeof(_Block) + _current->capacity, _tag);
+        _current = previous;
+    }
+    _used_in_previous_blocks = _current->used_before;
+    _offset = marker - _used_in_previous_blocks;
+}
+
+void LinearArena::reset() {
+    bool overflowed = _current != nullptr &&
+                      (_current->previous != nullptr || _high_water > _current->capacity);
+    if (overflowed) {
+        // Overflowed, replace all blocks with one that fits everything at once
+        size_t capacity = std::max(_high_water, _initial_capacity);
+        _free_blocks(nullptr);
+        _push_block(capacity);
+    }
+    _offset = 0;
+    _used_in_previous_blocks = 0;
+}
+
+size_t LinearArena::capacity() const {
+    size_t capacity = 0;
+    for (_Block* block = _current; block != nullptr; block = block->previous) {
+        capacity += block->capacity;
+    }
+    return capacity;
+}
+
+void LinearArena::_push_block(size_t min_size) {
+    size_t capacity = _initial_capacity;
+    if (_current != nullptr) {
+        capacity = _current->capacity * 2;
+    }
+    capacity = align_up(std::max(capacity, min_size), alignof(std::max_align_t));
+
+    _Block* block = (_Block*)memory::allocate(sizeof(_Block) + capacity, _tag);
+    block->previous = _current;
+    block->capacity = capacity;
+    block->used_before = _current != nullptr ? _used_in_previous_blocks + _offset : 0;
+    _used_in_previous_blocks = block->used_before;
+    _current = block;
+    _offset = 0;
+}
+
+void LinearArena::_free_blocks(_Block* until) {
+    while (_current != nullptr && _current != until) {
+        _Block* previous = _current->previous;
+        memory::deallocate(_current, sizeof(_Block) + _current->capacity, _tag);
+        _current = previous;
+    }
+}
+
+static LinearArena& scratch_arena() {
+    static thread_local LinearArena arena(KY_SCRATCH_ARENA_CAPACITY, MEMORY_TAG_THREAD);
+    return arena;
+}
+
+ScratchScope::ScratchScope() : _arena(&scratch_arena()), _marker(_arena->mark()) {}
+
+ScratchScope::~ScratchScope() {
+    _arena->rewind(_marker);
+}
+
+FrameAllocator* FrameAllocator::_instance = nullptr;
+
+FrameAllocator::~FrameAllocator() {
+    for (_Buffer& buffer : _buffers) {
+        for (const _Overflow& overflow : buffer.overflow) {
+            memory::deallocate(overflow.block, overflow.size, MEMORY_TAG_CORE);
+        }
+        memory::deallocate(buffer.data, buffer.capacity, MEMORY_TAG_CORE);
+    }
+    if (_instance == this) {
+        _instance = nullptr;
+    }
+}
+
+void FrameAllocator::init(FrameAllocator& instance, size_t capacity) {
+    KY_FATAL_CONDITION_MSG(_instance == nullptr, "FrameAllocator is already initialized");
+    _instance = &instance;
+    capacity = align_up(capacity, alignof(std::max_align_t));
+    for (_Buffer& buffer : instance._buffers) {
+        buffer.data = (unsigned char*)memory::allocate(capacity, MEMORY_TAG_CORE);
+        buffer.capacity = capacity;
+        buffer.offset = 0;
+    }
+    instance._current = 0;
+}
+
+void* FrameAllocator::allocate(size_t size, size_t alignment) {
+    KY_FATAL_CONDITION_MSG(_instance != nullptr, "FrameAllocator isn't initialized");
+    KY_ERROR_CONDITION_MSG_RETURN((alignment & (alignment - 1)) == 0, nullptr,
+                                  "Alignment must be a power of two");
+    _Buffer& buffer = _instance->_buffers[_instance->_current];
+
+    // Reserve enough for the worst case padding so the bump is a single atomic add. The buffer's
+    // base is aligned to max_align_t, larger alignments are padded for within the reservation.
+    size_t reserved = align_up(size, alignof(std::max_align_t));
+    if (alignment > alignof(std::max_align_t)) {
+        reserved += alignment;
+    }
+    size_t offset = buffer.offset.fetch_add(reserved, std::memory_order_relaxed);
+    if (offset + reserved <= buffer.capacity) {
+        uintptr_t data = (uintptr_t)buffer.data + offset;
+        return (void*)align_up(data, alignment);
+    }
+
+    // Out of space this frame, the buffer grows to the size reached by `offset` next time it's
+    // reset
+    void* block = memory::allocate(reserved + alignment, MEMORY_TAG_CORE);
+    std::lock_guard<std::mutex> lock(_instance->_overflow_mutex);
+    buffer.overflow.push_back(_Overflow {block, reserved + alignment});
+    return (void*)align_up((uintptr_t)block, alignment);
+}
+
+size_t FrameAllocator::used() {
+    if (_instance == nullptr) {
+        return 0;
+    }
+    return _instance->_buffers[_instance->_current].offset.load(std::memory_order_relaxed);
+}
+
+size_t FrameAllocator::high_water() {
+    if (_instance == nullptr) {
+        return 0;
+    }
+    return std::max(_instance->_high_water, used());
+}
+
+size_t FrameAllocator::overflow_count() {
+    if (_instance == nullptr) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(_instance->_overflow_mutex);
+    return _instance->_buffers[_instance->_current].overflow.size();
+}
+
+void FrameAllocator::begin_frame() {
+    _high_water = std::max(_high_water, _buffers[_current].offset.load(std::memory_order_relaxed));
+    _current ^= 1;
+    _reset(_buffers[_current]);
+}
+
+void FrameAllocator::_reset(_Buffer& buffer) {
+    for (const _Overflow& overflow : buffer.overflow) {
+        memory::deallocate(overflow.block, overflow.size, MEMORY_TAG_CORE);
+    }
+    buffer.overflow.clear();
+
+    if (_high_water > buffer.capacity) {
+        // Leave some headroom so a slowly growing workload doesn't reallocate every other frame
+        size_t capacity = align_up(_high_water + _high_water / 2, alignof(std::max_align_t));
+        memory::deallocate(buffer.data, buffer.capacity, MEMORY_TAG_CORE);
+        buffer.data = (unsigned char*)memory::allocate(capacity, MEMORY_TAG_CORE);
+        buffer.capacity = capacity;
+    }
+    buffer.offset.store(0, std::memory_order_relaxed);
+}
+
+FixedPool::FixedPool(size_t block_size, size_t alignment, size_t blocks_per_chunk, MemoryTag tag)
+        : _alignment(std::max(alignment, alignof(_FreeBlock))),
+          _blocks_per_chunk(std::max<size_t>(blocks_per_chunk, 1)), _tag(tag) {
+    _block_size = align_up(std::max(block_size, sizeof(_FreeBlock)), _alignment);
+}
+
+FixedPool::~FixedPool() {
+    for (void* chunk : _chunks) {
+        memory::deallocate(chunk, _block_size * _blocks_per_chunk, _tag, _alignment);
+    }
+}
+
+void* FixedPool::allocate() {
+    if (_free == nullptr) {
+        _push_chunk();
+    }
+    _FreeBlock* block = _free;
+    _free = block->next;
+    _allocated_count++;
+    return block;
+}
+
+void FixedPool::deallocate(void* block) {
+    if (block == nullptr) {
+        return;
+    }
+    _FreeBlock* free_block = (_FreeBlock*)block;
+    free_block->next = _free;
+    _free = free_block;
+    _allocated_count--;
+}
+
+void FixedPool::_push_chunk() {
+    unsigned char* chunk =
+            (unsigned char*)memory::allocate(_block_size * _blocks_per_chunk, _tag, _alignment);
+    _chunks.push_back(chunk);
+    // Link back to front so blocks are handed out in address order
+    for (size_t i = _blocks_per_chunk; i > 0; i--) {
+        _FreeBlock* block = (_FreeBlock*)(chunk + (i - 1) * _block_size);
+        block->next = _free;
+        _free = block;
+    }
+}
+
+} // namespace ky
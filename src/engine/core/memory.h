@@ -0,0 +1,361 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_CORE__MEMORY_H
+#define KRYOS_CORE__MEMORY_H
+
+#include "core/memory_tracker.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bytes reserved for each of the frame allocator's two buffers. Frames needing more fall back to
+// the heap and the buffers grow to fit at the start of the next frame.
+#ifndef KY_FRAME_ALLOCATOR_DEFAULT_CAPACITY
+#    define KY_FRAME_ALLOCATOR_DEFAULT_CAPACITY (4 * 1024 * 1024)
+#endif
+
+// Initial size of every thread's scratch arena.
+#ifndef KY_SCRATCH_ARENA_CAPACITY
+#    define KY_SCRATCH_ARENA_CAPACITY (1024 * 1024)
+#endif
+
+namespace ky {
+
+inline constexpr size_t align_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Bump allocator. Memory is only given back all at once with `reset`, or up to a marker with
+// `rewind`, and destructors of objects living in the arena never run.
+//
+// When the current block runs out another one is chained on. `reset` merges all blocks into one
+// large enough for everything allocated since the previous reset, so an arena that's reset
+// regularly stops touching the heap after warming up.
+class LinearArena {
+public:
+    LinearArena() = default;
+    explicit LinearArena(size_t capacity, MemoryTag tag = MEMORY_TAG_CORE);
+    ~LinearArena();
+
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+    LinearArena(LinearArena&& arena) noexcept;
+    LinearArena& operator=(LinearArena&& arena) noexcept;
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    // Uninitialized storage for `count` objects of `_Type`.
+    template <typename _Type>
+    inline _Type* allocate(size_t count = 1) {
+        return (_Type*)allocate(sizeof(_Type) * count, alignof(_Type));
+    }
+
+    template <typename _Type, typename... _Args>
+    inline _Type* create(_Args&&... args) {
+        return new (allocate(sizeof(_Type), alignof(_Type))) _Type(std::forward<_Args>(args)...);
+    }
+
+    // Markers are the arena's `used` size, rewinding to 0 is the same as a reset
+    inline size_t mark() const { return used(); }
+    void rewind(size_t marker);
+    void reset();
+
+    // Bytes allocated since the last reset, including alignment padding.
+    inline size_t used() const { return _used_in_previous_blocks + _offset; }
+    inline size_t high_water() const { return _high_water; }
+    size_t capacity() const;
+
+private:
+    // Header at the start of every block, the block's memory follows
+    struct _Block {
+        _Block* previous;
+        size_t capacity;
+        size_t used_before;
+    };
+
+    _Block* _current = nullptr;
+    size_t _offset = 0;
+    size_t _used_in_previous_blocks = 0;
+    size_t _initial_capacity = 64 * 1024;
+    size_t _high_water = 0;
+    MemoryTag _tag = MEMORY_TAG_CORE;
+
+    void _push_block(size_t min_size);
+    void _free_blocks(_Block* until);
+};
+
+// Scope on the calling thread's scratch arena, everything allocated through it is released when
+// the scope ends. Scopes nest, use them for temporary data within a function.
+class ScratchScope {
+public:
+    ScratchScope();
+    ~ScratchScope();
+
+    ScratchScope(const ScratchScope&) = delete;
+    ScratchScope& operator=(const ScratchScope&) = delete;
+
+    inline LinearArena& arena() { return *_arena; }
+
+    inline void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        return _arena->allocate(size, alignment);
+    }
+
+    template <typename _Type>
+    inline _Type* allocate(size_t count = 1) {
+        return _arena->allocate<_Type>(count);
+    }
+
+private:
+    LinearArena* _arena;
+    size_t _marker;
+};
+
+// Double buffered per frame bump allocator. `begin_frame` is called at the top of every runtime
+// loop iteration, memory allocated during a frame stays valid until the end of the next one, so it
+// can be handed from the simulation to whatever consumes it a frame later. Allocation is lock free
+// and can be done from any thread.
+class FrameAllocator {
+public:
+    FrameAllocator() = default;
+    ~FrameAllocator();
+
+    FrameAllocator(const FrameAllocator&) = delete;
+    FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+    static void init(FrameAllocator& instance,
+                     size_t capacity = KY_FRAME_ALLOCATOR_DEFAULT_CAPACITY);
+
+    static void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    template <typename _Type>
+    static inline _Type* allocate(size_t count = 1) {
+        return (_Type*)allocate(sizeof(_Type) * count, alignof(_Type));
+    }
+
+    // Bytes allocated in the current frame and the most any frame used.
+    static size_t used();
+    static size_t high_water();
+    // Number of allocations that didn't fit the current frame's buffer and went to the heap.
+    static size_t overflow_count();
+
+    void begin_frame();
+
+private:
+    struct _Overflow {
+        void* block;
+        size_t size;
+    };
+
+    struct _Buffer {
+        unsigned char* data = nullptr;
+        size_t capacity = 0;
+        std::atomic<size_t> offset = 0;
+        std::vector<_Overflow> overflow;
+    };
+
+    _Buffer _buffers[2];
+    uint32_t _current = 0;
+    size_t _high_water = 0;
+    std::mutex _overflow_mutex;
+
+    static FrameAllocator* _instance;
+
+    void _reset(_Buffer& buffer);
+};
+
+// Fixed size blocks carved out of larger chunks. Freed blocks go on an intrusive free list and
+// are handed out again first, so allocation and deallocation are a couple of pointer writes.
+// Not thread safe.
+class FixedPool {
+public:
+    FixedPool(size_t block_size, size_t alignment = alignof(std::max_align_t),
+              size_t blocks_per_chunk = 256, MemoryTag tag = MEMORY_TAG_CORE);
+    ~FixedPool();
+
+    FixedPool(const FixedPool&) = delete;
+    FixedPool& operator=(const FixedPool&) = delete;
+
+    void* allocate();
+    void deallocate(void* block);
+
+    inline size_t block_size() const { return _block_size; }
+    inline size_t alignment() const { return _alignment; }
+    inline MemoryTag tag() const { return _tag; }
+    inline size_t allocated_count() const { return _allocated_count; }
+    inline size_t chunk_count() const { return _chunks.size(); }
+
+private:
+    struct _FreeBlock {
+        _FreeBlock* next;
+    };
+
+    std::vector<void*> _chunks;
+    _FreeBlock* _free = nullptr;
+    size_t _block_size;
+    size_t _alignment;
+    size_t _blocks_per_chunk;
+    size_t _allocated_count = 0;
+    MemoryTag _tag;
+
+    void _push_chunk();
+};
+
+// Typed `FixedPool` constructing and destroying its objects.
+template <typename _Type>
+class Pool {
+public:
+    explicit Pool(size_t objects_per_chunk = 256, MemoryTag tag = MEMORY_TAG_CORE)
+            : _pool(sizeof(_Type), alignof(_Type), objects_per_chunk, tag) {}
+
+    template <typename... _Args>
+    inline _Type* create(_Args&&... args) {
+        return new (_pool.allocate()) _Type(std::forward<_Args>(args)...);
+    }
+
+    inline void destroy(_Type* object) {
+        object->~_Type();
+        _pool.deallocate(object);
+    }
+
+    inline size_t size() const { return _pool.allocated_count(); }
+
+private:
+    FixedPool _pool;
+};
+
+// Allocates from a `LinearArena`. Deallocation does nothing, the memory is reclaimed when the
+// arena is reset, so containers using it shouldn't outlive the arena's current contents.
+template <typename _Type>
+class ArenaStlAllocator {
+public:
+    using value_type = _Type;
+
+    ArenaStlAllocator(LinearArena& arena) : _arena(&arena) {}
+
+    template <typename _Other>
+    ArenaStlAllocator(const ArenaStlAllocator<_Other>& other) : _arena(other._arena) {}
+
+    inline _Type* allocate(size_t count) { return _arena->allocate<_Type>(count); }
+    inline void deallocate(_Type*, size_t) {}
+
+    template <typename _Other>
+    inline bool operator==(const ArenaStlAllocator<_Other>& other) const {
+        return _arena == other._arena;
+    }
+
+    template <typename _Other>
+    inline bool operator!=(const ArenaStlAllocator<_Other>& other) const {
+        return _arena != other._arena;
+    }
+
+private:
+    template <typename _Other>
+    friend class ArenaStlAllocator;
+
+    LinearArena* _arena;
+};
+
+// Allocates from the `FrameAllocator`, containers using it are only valid until the end of the
+// next frame.
+template <typename _Type>
+class FrameStlAllocator {
+public:
+    using value_type = _Type;
+
+    FrameStlAllocator() = default;
+
+    template <typename _Other>
+    FrameStlAllocator(const FrameStlAllocator<_Other>&) {}
+
+    inline _Type* allocate(size_t count) { return FrameAllocator::allocate<_Type>(count); }
+    inline void deallocate(_Type*, size_t) {}
+
+    template <typename _Other>
+    inline bool operator==(const FrameStlAllocator<_Other>&) const {
+        return true;
+    }
+
+    template <typename _Other>
+    inline bool operator!=(const FrameStlAllocator<_Other>&) const {
+        return false;
+    }
+};
+
+// Allocates single objects from a `FixedPool`, for node based containers such as `std::list` and
+// `std::map`. Allocations that don't fit the pool's blocks, e.g. hash table buckets, go to the
+// heap charged to the pool's tag.
+template <typename _Type>
+class PoolStlAllocator {
+public:
+    using value_type = _Type;
+
+    PoolStlAllocator(FixedPool& pool) : _pool(&pool) {}
+
+    template <typename _Other>
+    PoolStlAllocator(const PoolStlAllocator<_Other>& other) : _pool(other._pool) {}
+
+    inline _Type* allocate(size_t count) {
+        if (_fits_pool(count)) {
+            return (_Type*)_pool->allocate();
+        }
+        return (_Type*)memory::allocate(sizeof(_Type) * count, _pool->tag(), alignof(_Type));
+    }
+
+    inline void deallocate(_Type* pointer, size_t count) {
+        if (_fits_pool(count)) {
+            _pool->deallocate(pointer);
+        } else {
+            memory::deallocate(pointer, sizeof(_Type) * count, _pool->tag(), alignof(_Type));
+        }
+    }
+
+    template <typename _Other>
+    inline bool operator==(const PoolStlAllocator<_Other>& other) const {
+        return _pool == other._pool;
+    }
+
+    template <typename _Other>
+    inline bool operator!=(const PoolStlAllocator<_Other>& other) const {
+        return _pool != other._pool;
+    }
+
+private:
+    template <typename _Other>
+    friend class PoolStlAllocator;
+
+    FixedPool* _pool;
+
+    inline bool _fits_pool(size_t count) const {
+        return count == 1 && sizeof(_Type) <= _pool->block_size() &&
+               alignof(_Type) <= _pool->alignment();
+    }
+};
+
+template <typename _Type>
+using FrameVector = std::vector<_Type, FrameStlAllocator<_Type>>;
+
+template <typename _Type>
+using ArenaVector = std::vector<_Type, ArenaStlAllocator<_Type>>;
+
+} // namespace ky
+
+#endif
@@ -0,0 +1,169 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/memory_tracker.h"
+
+#include "core/error.h"
+
+#include <cstdio>
+
+namespace ky {
+namespace memory_internal {
+
+    TagCounters counters[MEMORY_TAG_COUNT];
+
+    // Only touched by the thread calling `frame_mark`
+    static MemoryFrameStats frame_begin[MEMORY_TAG_COUNT];
+    static MemoryFrameStats last_frame[MEMORY_TAG_COUNT];
+    static std::atomic<uint32_t> frame_budgets[MEMORY_TAG_COUNT] = {
+            UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX,
+            UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX,
+    };
+
+    static MemoryFrameStats totals(MemoryTag tag) {
+        MemoryFrameStats stats;
+        stats.allocations = counters[tag].allocations.load(std::memory_order_relaxed);
+        stats.deallocations = counters[tag].deallocations.load(std::memory_order_relaxed);
+        stats.allocated_bytes = counters[tag].allocated_bytes.load(std::memory_order_relaxed);
+        stats.deallocated_bytes = counters[tag].deallocated_bytes.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+} // namespace memory_internal
+
+namespace memory {
+
+    static_assert(MEMORY_TAG_COUNT == 8, "Update `frame_budgets` and `tag_to_cstring`");
+
+    const char* tag_to_cstring(MemoryTag tag) {
+        switch (tag) {
+            case MEMORY_TAG_CORE:
+                return "core";
+            case MEMORY_TAG_WINDOW:
+                return "window";
+            case MEMORY_TAG_INPUT:
+                return "input";
+            case MEMORY_TAG_ERROR:
+                return "error";
+            case MEMORY_TAG_ECS:
+                return "ecs";
+            case MEMORY_TAG_RENDER:
+                return "render";
+            case MEMORY_TAG_ASSETS:
+                return "assets";
+            case MEMORY_TAG_THREAD:
+                return "thread";
+            default:
+                return "undefined";
+        }
+    }
+
+    void* allocate(size_t size, MemoryTag tag, size_t alignment) {
+        void* memory = nullptr;
+        if (alignment > alignof(std::max_align_t)) {
+            memory = ::operator new(size, std::align_val_t(alignment), std::nothrow);
+        } else {
+            memory = ::operator new(size, std::nothrow);
+        }
+        KY_FATAL_CONDITION_MSG(memory != nullptr, "Out of memory");
+        track_allocation(tag, size);
+        return memory;
+    }
+
+    void deallocate(void* pointer, size_t size, MemoryTag tag, size_t alignment) {
+        if (pointer == nullptr) {
+            return;
+        }
+        track_deallocation(tag, size);
+        if (alignment > alignof(std::max_align_t)) {
+            ::operator delete(pointer, std::align_val_t(alignment));
+        } else {
+            ::operator delete(pointer);
+        }
+    }
+
+    MemoryTagStats tag_stats(MemoryTag tag) {
+        KY_ERROR_FAIL_INDEX_RETURN(tag, MEMORY_TAG_COUNT, MemoryTagStats());
+        MemoryFrameStats totals = memory_internal::totals(tag);
+        MemoryTagStats stats;
+        stats.live_bytes = (int64_t)(totals.allocated_bytes - totals.deallocated_bytes);
+        stats.peak_bytes =
+                memory_internal::counters[tag].peak_bytes.load(std::memory_order_relaxed);
+        stats.live_allocations = (int64_t)(totals.allocations - totals.deallocations);
+        stats.total_allocations = totals.allocations;
+        return stats;
+    }
+
+    MemoryFrameStats frame_stats(MemoryTag tag) {
+        KY_ERROR_FAIL_INDEX_RETURN(tag, MEMORY_TAG_COUNT, MemoryFrameStats());
+        return memory_internal::last_frame[tag];
+    }
+
+    void set_frame_allocation_budget(MemoryTag tag, uint32_t allocations) {
+        KY_ERROR_FAIL_INDEX(tag, MEMORY_TAG_COUNT);
+        memory_internal::frame_budgets[tag].store(allocations, std::memory_order_relaxed);
+    }
+
+    void frame_mark() {
+        // Every tag over its budget goes into one message so the warning's rate limit doesn't
+        // hide any of them
+        char over_budget[256] = {};
+        size_t length = 0;
+        for (uint32_t i = 0; i < MEMORY_TAG_COUNT; i++) {
+            MemoryFrameStats totals = memory_internal::totals((MemoryTag)i);
+            MemoryFrameStats& begin = memory_internal::frame_begin[i];
+            MemoryFrameStats& frame = memory_internal::last_frame[i];
+            frame.allocations = totals.allocations - begin.allocations;
+            frame.deallocations = totals.deallocations - begin.deallocations;
+            frame.allocated_bytes = totals.allocated_bytes - begin.allocated_bytes;
+            frame.deallocated_bytes = totals.deallocated_bytes - begin.deallocated_bytes;
+            begin = totals;
+
+            uint32_t budget = memory_internal::frame_budgets[i].load(std::memory_order_relaxed);
+            if (frame.allocations > budget && length < sizeof(over_budget)) {
+                length += snprintf(over_budget + length, sizeof(over_budget) - length,
+                                   " %s: %llu/%u", tag_to_cstring((MemoryTag)i),
+                                   (unsigned long long)frame.allocations, budget);
+            }
+        }
+        if (length > 0) {
+            KY_WARNING_MSG("Frame allocation budget exceeded (allocations/budget):%s",
+                           over_budget);
+        }
+    }
+
+    uint32_t report_leaks() {
+        uint32_t leaking_tags = 0;
+#if KY_MEMORY_TRACKING_ENABLED
+        for (uint32_t i = 0; i < MEMORY_TAG_COUNT; i++) {
+            if (i == MEMORY_TAG_THREAD) {
+                continue;
+            }
+            MemoryTagStats stats = tag_stats((MemoryTag)i);
+            if (stats.live_allocations != 0 || stats.live_bytes != 0) {
+                error_internal::print_error(
+                        KY_FUNCTION_STR, __FILE__, __LINE__, ErrorCode::WARNING,
+                        "Memory tag '%s' leaked %lld bytes in %lld allocations",
+                        tag_to_cstring((MemoryTag)i), (long long)stats.live_bytes,
+                        (long long)stats.live_allocations);
+                leaking_tags++;
+            }
+        }
+#endif
+        return leaking_tags;
+    }
+
+} // namespace memory
+} // namespace ky
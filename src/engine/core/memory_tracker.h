@@ -0,0 +1,199 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_CORE__MEMORY_TRACKER_H
+#define KRYOS_CORE__MEMORY_TRACKER_H
+
+#include "core/macros.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace ky {
+
+// Subsystem an allocation is charged to.
+enum MemoryTag : uint8_t {
+    MEMORY_TAG_CORE,
+    MEMORY_TAG_WINDOW,
+    MEMORY_TAG_INPUT,
+    MEMORY_TAG_ERROR,
+    MEMORY_TAG_ECS,
+    MEMORY_TAG_RENDER,
+    MEMORY_TAG_ASSETS,
+    // Owned by threads, such as scratch arenas and profiler event buffers. The main thread
+    // outlives `error::shutdown` so these are left out of the leak report.
+    MEMORY_TAG_THREAD,
+    MEMORY_TAG_COUNT,
+};
+
+struct MemoryTagStats {
+    int64_t live_bytes = 0;
+    int64_t peak_bytes = 0;
+    int64_t live_allocations = 0;
+    uint64_t total_allocations = 0;
+};
+
+// Allocations and deallocations made during a single frame.
+struct MemoryFrameStats {
+    uint64_t allocations = 0;
+    uint64_t deallocations = 0;
+    uint64_t allocated_bytes = 0;
+    uint64_t deallocated_bytes = 0;
+};
+
+namespace memory {
+
+    const char* tag_to_cstring(MemoryTag tag);
+
+    // Heap allocation charged to `tag`, running out of memory is fatal. Deallocation takes the
+    // same size, tag and alignment, the way STL allocators do, so no header is stored in front of
+    // the memory.
+    void* allocate(size_t size, MemoryTag tag, size_t alignment = alignof(std::max_align_t));
+    void deallocate(void* pointer, size_t size, MemoryTag tag,
+                    size_t alignment = alignof(std::max_align_t));
+
+    template <typename _Type, typename... _Args>
+    _Type* create(MemoryTag tag, _Args&&... args);
+    template <typename _Type>
+    void destroy(MemoryTag tag, _Type* object);
+
+    // Charges memory allocated elsewhere, such as by a third party library, to `tag`.
+    inline void track_allocation(MemoryTag tag, size_t size);
+    inline void track_deallocation(MemoryTag tag, size_t size);
+
+    MemoryTagStats tag_stats(MemoryTag tag);
+    // Counts of the last frame completed by `frame_mark`.
+    MemoryFrameStats frame_stats(MemoryTag tag);
+
+    // Number of allocations a frame may make for `tag` before `frame_mark` warns about it, 0
+    // enforces allocation free frames. Budgets are unlimited by default.
+    void set_frame_allocation_budget(MemoryTag tag, uint32_t allocations);
+
+    // Closes the current frame's counters, must be called once per runtime loop iteration.
+    void frame_mark();
+
+    // Warns about every tag still holding memory and returns how many there are. Called by
+    // `error::shutdown`, by which point the engine should have released everything it allocated.
+    uint32_t report_leaks();
+
+} // namespace memory
+
+namespace memory_internal {
+
+    // Cumulative counters, live and per frame values are the differences between them. Each tag
+    // gets its own cache line so subsystems allocating on different threads don't contend.
+    struct alignas(KY_CACHE_LINE_SIZE) TagCounters {
+        std::atomic<uint64_t> allocations = 0;
+        std::atomic<uint64_t> deallocations = 0;
+        std::atomic<uint64_t> allocated_bytes = 0;
+        std::atomic<uint64_t> deallocated_bytes = 0;
+        std::atomic<int64_t> peak_bytes = 0;
+    };
+
+    extern TagCounters counters[MEMORY_TAG_COUNT];
+
+} // namespace memory_internal
+
+namespace memory {
+
+    inline void track_allocation(MemoryTag tag, size_t size) {
+#if KY_MEMORY_TRACKING_ENABLED
+        memory_internal::TagCounters& counters = memory_internal::counters[tag];
+        counters.allocations.fetch_add(1, std::memory_order_relaxed);
+        uint64_t allocated = counters.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+        int64_t live = (int64_t)(allocated + size -
+                                 counters.deallocated_bytes.load(std::memory_order_relaxed));
+        int64_t peak = counters.peak_bytes.load(std::memory_order_relaxed);
+        while (live > peak &&
+               !counters.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+        }
+#else
+        (void)tag;
+        (void)size;
+#endif
+    }
+
+    inline void track_deallocation(MemoryTag tag, size_t size) {
+#if KY_MEMORY_TRACKING_ENABLED
+        memory_internal::TagCounters& counters = memory_internal::counters[tag];
+        counters.deallocations.fetch_add(1, std::memory_order_relaxed);
+        counters.deallocated_bytes.fetch_add(size, std::memory_order_relaxed);
+#else
+        (void)tag;
+        (void)size;
+#endif
+    }
+
+    template <typename _Type, typename... _Args>
+    _Type* create(MemoryTag tag, _Args&&... args) {
+        void* memory = allocate(sizeof(_Type), tag, alignof(_Type));
+        return new (memory) _Type(std::forward<_Args>(args)...);
+    }
+
+    template <typename _Type>
+    void destroy(MemoryTag tag, _Type* object) {
+        if (object != nullptr) {
+            object->~_Type();
+            deallocate(object, sizeof(_Type), tag, alignof(_Type));
+        }
+    }
+
+} // namespace memory
+
+// STL allocator charging its allocations to `_Tag`.
+template <typename _Type, MemoryTag _Tag>
+class TaggedAllocator {
+public:
+    using value_type = _Type;
+
+    template <typename _Other>
+    struct rebind {
+        using other = TaggedAllocator<_Other, _Tag>;
+    };
+
+    TaggedAllocator() = default;
+
+    template <typename _Other>
+    TaggedAllocator(const TaggedAllocator<_Other, _Tag>&) {}
+
+    inline _Type* allocate(size_t count) {
+        return (_Type*)memory::allocate(sizeof(_Type) * count, _Tag, alignof(_Type));
+    }
+
+    inline void deallocate(_Type* pointer, size_t count) {
+        memory::deallocate(pointer, sizeof(_Type) * count, _Tag, alignof(_Type));
+    }
+
+    template <typename _Other>
+    inline bool operator==(const TaggedAllocator<_Other, _Tag>&) const {
+        return true;
+    }
+
+    template <typename _Other>
+    inline bool operator!=(const TaggedAllocator<_Other, _Tag>&) const {
+        return false;
+    }
+};
+
+template <typename _Type, MemoryTag _Tag>
+using TaggedVector = std::vector<_Type, TaggedAllocator<_Type, _Tag>>;
+
+} // namespace ky
+
+#endif
@@ -0,0 +1,273 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/profiler.h"
+
+#include "core/memory_tracker.h"
+#include "core/time.h"
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ky {
+namespace profiler_internal {
+
+    std::atomic<bool> recording = false;
+
+    struct _Event {
+        const char* name;
+        int64_t start;
+        int64_t end;
+        uint32_t thread_id;
+    };
+
+    // Written only by the owning thread. Buffers are never freed, once their thread exits they
+    // are handed to the next thread which records a zone, so they're charged to
+    // `MEMORY_TAG_THREAD`
+    struct _ThreadBuffer {
+        std::atomic<bool> in_use = false;
+        std::atomic<size_t> generation = 0;
+        std::atomic<size_t> count = 0;
+        std::atomic<size_t> dropped = 0;
+        std::atomic<const char*> thread_name = nullptr;
+        uint32_t thread_id = 0;
+        _ThreadBuffer* next = nullptr;
+        _Event events[KY_PROFILER_THREAD_EVENT_CAPACITY];
+    };
+
+    struct _ThreadState {
+        _ThreadBuffer* buffer = nullptr;
+        uint32_t thread_id = 0;
+        const char* thread_name = nullptr;
+
+        ~_ThreadState() {
+            if (buffer != nullptr) {
+                buffer->in_use.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    static std::mutex buffer_mutex;
+    static _ThreadBuffer* buffers = nullptr;
+    static std::atomic<uint32_t> next_thread_id = 1;
+
+    // A new generation is started for each capture, buffers holding an older generation are
+    // lazily reset by their owning thread
+    static std::atomic<size_t> capture_generation = 0;
+    static std::atomic<uint32_t> pending_frame_count = 0;
+    static uint32_t frames_remaining = 0;
+    static int64_t capture_start = 0;
+    static std::vector<int64_t> frame_marks;
+    static std::mutex output_mutex;
+    static std::string output_path;
+
+    static thread_local _ThreadState thread_state;
+
+    static uint32_t current_thread_id() {
+        if (thread_state.thread_id == 0) {
+            thread_state.thread_id = next_thread_id.fetch_add(1, std::memory_order_relaxed);
+        }
+        return thread_state.thread_id;
+    }
+
+    static _ThreadBuffer* acquire_thread_buffer() {
+        std::lock_guard<std::mutex> lock(buffer_mutex);
+        _ThreadBuffer* buffer = buffers;
+        for (; buffer != nullptr; buffer = buffer->next) {
+            bool expected = false;
+            if (buffer->in_use.compare_exchange_strong(expected, true,
+                                                       std::memory_order_acquire)) {
+                break;
+            }
+        }
+
+        if (buffer == nullptr) {
+            buffer = memory::create<_ThreadBuffer>(MEMORY_TAG_THREAD);
+            buffer->in_use.store(true, std::memory_order_relaxed);
+            buffer->next = buffers;
+            buffers = buffer;
+        }
+        buffer->thread_id = current_thread_id();
+        buffer->thread_name.store(thread_state.thread_name, std::memory_order_relaxed);
+        thread_state.buffer = buffer;
+        return buffer;
+    }
+
+    int64_t begin_zone() {
+        return Clock::now();
+    }
+
+    void end_zone(const char* name, int64_t start) {
+        int64_t end = Clock::now();
+        _ThreadBuffer* buffer = thread_state.buffer;
+        if (buffer == nullptr) {
+            buffer = acquire_thread_buffer();
+        }
+
+        size_t generation = capture_generation.load(std::memory_order_acquire);
+        size_t count = buffer->count.load(std::memory_order_relaxed);
+        if (buffer->generation.load(std::memory_order_relaxed) != generation) {
+            count = 0;
+            buffer->count.store(0, std::memory_order_relaxed);
+            buffer->dropped.store(0, std::memory_order_relaxed);
+            buffer->generation.store(generation, std::memory_order_release);
+        }
+
+        if (count >= KY_PROFILER_THREAD_EVENT_CAPACITY) {
+            buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        buffer->events[count] = _Event {name, start, end, buffer->thread_id};
+        buffer->count.store(count + 1, std::memory_order_release);
+    }
+
+    static void write_json_string(FILE* out, const char* str) {
+        fputc('"', out);
+        for (; *str != '\0'; str++) {
+            if (*str == '"' || *str == '\\') {
+                fputc('\\', out);
+            }
+            fputc(*str, out);
+        }
+        fputc('"', out);
+    }
+
+} // namespace profiler_internal
+
+void Profiler::begin_capture(uint32_t frame_count, const char* output_path) {
+    KY_ERROR_CONDITION_MSG(frame_count > 0, "Capture requires at least one frame");
+    KY_ERROR_CONDITION_MSG(!capturing(), "A profiler capture is already running");
+    {
+        std::lock_guard<std::mutex> lock(profiler_internal::output_mutex);
+        profiler_internal::output_path = output_path != nullptr ? output_path : "";
+    }
+    profiler_internal::pending_frame_count.store(frame_count, std::memory_order_release);
+}
+
+void Profiler::end_capture() {
+    if (!profiler_internal::recording.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+    profiler_internal::frames_remaining = 0;
+
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(profiler_internal::output_mutex);
+        path = profiler_internal::output_path;
+    }
+    if (!path.empty()) {
+        write_chrome_trace(path.c_str());
+    }
+}
+
+bool Profiler::capturing() {
+    return profiler_internal::recording.load(std::memory_order_acquire) ||
+           profiler_internal::pending_frame_count.load(std::memory_order_acquire) > 0;
+}
+
+void Profiler::frame_mark() {
+    int64_t now = Clock::now();
+    uint32_t pending = profiler_internal::pending_frame_count.exchange(0);
+    if (pending > 0) {
+        profiler_internal::capture_generation.fetch_add(1, std::memory_order_acq_rel);
+        profiler_internal::frames_remaining = pending;
+        profiler_internal::capture_start = now;
+        profiler_internal::frame_marks.clear();
+        profiler_internal::frame_marks.push_back(now);
+        profiler_internal::recording.store(true, std::memory_order_release);
+        return;
+    }
+
+    if (!profiler_internal::recording.load(std::memory_order_relaxed)) {
+        return;
+    }
+    profiler_internal::frame_marks.push_back(now);
+    if (--profiler_internal::frames_remaining == 0) {
+        end_capture();
+    }
+}
+
+void Profiler::set_thread_name(const char* name) {
+    profiler_internal::thread_state.thread_name = name;
+    if (profiler_internal::thread_state.buffer != nullptr) {
+        profiler_internal::thread_state.buffer->thread_name.store(name,
+                                                                 std::memory_order_relaxed);
+    }
+}
+
+bool Profiler::write_chrome_trace(const char* path) {
+    FILE* out = fopen(path, "w");
+    KY_ERROR_CONDITION_MSG_RETURN(out != nullptr, false, "Failed to open profiler trace file");
+
+    int64_t origin = profiler_internal::capture_start;
+    size_t generation = profiler_internal::capture_generation.load(std::memory_order_acquire);
+    size_t dropped = 0;
+    bool first = true;
+
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out);
+    for (size_t i = 0; i < profiler_internal::frame_marks.size(); i++) {
+        fprintf(out,
+                "%s\n{\"name\":\"Frame %zu\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":0,"
+                "\"tid\":0}",
+                first ? "" : ",", i,
+                Clock::to_microseconds(profiler_internal::frame_marks[i] - origin));
+        first = false;
+    }
+
+    profiler_internal::_ThreadBuffer* buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(profiler_internal::buffer_mutex);
+        buffer = profiler_internal::buffers;
+    }
+    for (; buffer != nullptr; buffer = buffer->next) {
+        if (buffer->generation.load(std::memory_order_acquire) != generation) {
+            continue;
+        }
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+
+        const char* thread_name = buffer->thread_name.load(std::memory_order_relaxed);
+        if (thread_name != nullptr) {
+            fprintf(out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,"
+                         "\"args\":{\"name\":",
+                    first ? "" : ",", buffer->thread_id);
+            profiler_internal::write_json_string(out, thread_name);
+            fputs("}}", out);
+            first = false;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            const profiler_internal::_Event& event = buffer->events[i];
+            fprintf(out, "%s\n{\"name\":", first ? "" : ",");
+            profiler_internal::write_json_string(out, event.name);
+            fprintf(out, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u}",
+                    Clock::to_microseconds(event.start - origin),
+                    Clock::to_microseconds(event.end - event.start), event.thread_id);
+            first = false;
+        }
+    }
+    fputs("\n]}\n", out);
+    fclose(out);
+
+    if (dropped > 0) {
+        KY_WARNING_MSG("%zu profiler zones dropped, increase KY_PROFILER_THREAD_EVENT_CAPACITY",
+                       dropped);
+    }
+    return true;
+}
+
+} // namespace ky
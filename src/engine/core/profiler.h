@@ -0,0 +1,98 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_CORE__PROFILER_H
+#define KRYOS_CORE__PROFILER_H
+
+#include "core/error.h"
+#include "core/macros.h"
+
+#include <atomic>
+#include <cstdint>
+
+// Maximum number of zones a single thread can record during one capture. Zones past the limit are
+// dropped and reported when the trace is written.
+#ifndef KY_PROFILER_THREAD_EVENT_CAPACITY
+#    define KY_PROFILER_THREAD_EVENT_CAPACITY (1 << 16)
+#endif
+
+namespace ky {
+
+// Frame based CPU profiler. Zones are recorded into per-thread buffers only while a capture is
+// running, so instrumented code costs a single relaxed atomic load otherwise. Completed captures
+// are written as Chrome trace event JSON which can be opened in `chrome://tracing` or Perfetto.
+class Profiler {
+public:
+    // Starts capturing on the next frame mark and stops after `frame_count` frames. When
+    // `output_path` is not null, the trace is written to it once the capture completes.
+    static void begin_capture(uint32_t frame_count, const char* output_path = nullptr);
+    static void end_capture();
+    static bool capturing();
+
+    // Marks the start of a new frame, must be called once per runtime loop iteration.
+    static void frame_mark();
+
+    // Names the calling thread in exported traces. `name` must outlive the profiler.
+    static void set_thread_name(const char* name);
+
+    // Writes the zones recorded by the last capture as Chrome trace JSON.
+    static bool write_chrome_trace(const char* path);
+};
+
+namespace profiler_internal {
+
+    extern std::atomic<bool> recording;
+
+    int64_t begin_zone();
+    void end_zone(const char* name, int64_t start);
+
+    class ScopedZone {
+    public:
+        KY_FORCE_INLINE explicit ScopedZone(const char* name) {
+            if (recording.load(std::memory_order_relaxed)) {
+                _name = name;
+                _start = begin_zone();
+            }
+        }
+
+        KY_FORCE_INLINE ~ScopedZone() {
+            if (_name != nullptr) {
+                end_zone(_name, _start);
+            }
+        }
+
+        ScopedZone(const ScopedZone&) = delete;
+        ScopedZone& operator=(const ScopedZone&) = delete;
+
+    private:
+        const char* _name = nullptr;
+        int64_t _start = 0;
+    };
+
+} // namespace profiler_internal
+} // namespace ky
+
+#if KY_PROFILER_ENABLED
+// Records the enclosing scope as a zone named `_name`. The name must be a string with static
+// storage duration as only the pointer is stored.
+#    define KY_PROFILE_SCOPE(_name) \
+        ky::profiler_internal::ScopedZone KY_CONCAT(_ky_profile_zone_, __LINE__)(_name)
+#    define KY_PROFILE_FUNCTION() KY_PROFILE_SCOPE(KY_FUNCTION_STR)
+#else
+#    define KY_PROFILE_SCOPE(_name) ((void)0)
+#    define KY_PROFILE_FUNCTION()   ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,196 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/time.h"
+
+#include "core/error.h"
+#include "core/profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+namespace ky {
+
+Time* Time::_instance = nullptr;
+
+int64_t Clock::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void Clock::sleep_until(int64_t target) {
+    // Running mean and deviation of how long a 1ms OS sleep actually takes on this thread. Only
+    // sleep while the remaining time is larger than the pessimistic estimate
+    static thread_local double sleep_mean = 2e6;
+    static thread_local double sleep_m2 = 0.0;
+    static thread_local double sleep_estimate = 2e6;
+    static thread_local int64_t sleep_count = 1;
+
+    int64_t now = Clock::now();
+    while ((double)(target - now) > sleep_estimate) {
+        int64_t start = now;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        now = Clock::now();
+
+        // Cap the sample count so the estimate keeps adapting to scheduler changes. Once capped
+        // the sum of squared deviations decays at the rate new samples are weighted with, so it
+        // stays `(count - 1)` times the variance instead of growing with every sleep
+        if (sleep_count < 1000) {
+            sleep_count++;
+        } else {
+            sleep_m2 *= (double)(sleep_count - 1) / (double)sleep_count;
+        }
+        double observed = (double)(now - start);
+        double delta = observed - sleep_mean;
+        sleep_mean += delta / (double)sleep_count;
+        sleep_m2 += delta * (observed - sleep_mean);
+        sleep_estimate = sleep_mean + std::sqrt(sleep_m2 / (double)(sleep_count - 1));
+    }
+
+    while (Clock::now() < target) {
+        std::this_thread::yield();
+    }
+}
+
+void FrameHistory::push(int64_t frame_time) {
+    _samples[_head] = frame_time;
+    _head = (_head + 1) % CAPACITY;
+    _count = std::min(_count + 1, CAPACITY);
+}
+
+void FrameHistory::clear() {
+    _head = 0;
+    _count = 0;
+}
+
+FrameStats FrameHistory::stats() const {
+    FrameStats stats;
+    if (_count == 0) {
+        return stats;
+    }
+
+    // Samples are contiguous from the start until the window has wrapped around once
+    std::array<int64_t, CAPACITY> sorted;
+    std::copy(_samples.begin(), _samples.begin() + _count, sorted.begin());
+    std::sort(sorted.begin(), sorted.begin() + _count);
+
+    int64_t total = 0;
+    for (size_t i = 0; i < _count; i++) {
+        total += sorted[i];
+    }
+    stats.min = sorted[0];
+    stats.max = sorted[_count - 1];
+    stats.average = total / (int64_t)_count;
+    stats.p99 = sorted[std::min(_count - 1, (size_t)std::ceil((double)_count * 0.99) - 1)];
+    stats.sample_count = _count;
+    return stats;
+}
+
+FixedTimestep::FixedTimestep(int64_t step, uint32_t max_steps_per_frame)
+        : _step(step), _max_steps_per_frame(max_steps_per_frame) {
+    KY_ERROR_CONDITION_MSG(step > 0, "Fixed timestep must be greater than zero");
+}
+
+void FixedTimestep::set_step(int64_t step) {
+    KY_ERROR_CONDITION_MSG(step > 0, "Fixed timestep must be greater than zero");
+    _step = step;
+    _accumulator = std::min(_accumulator, _step * (int64_t)_max_steps_per_frame);
+}
+
+void FixedTimestep::accumulate(int64_t frame_time) {
+    _accumulator += frame_time;
+    int64_t max_accumulated = _step * (int64_t)_max_steps_per_frame;
+    if (_accumulator > max_accumulated) {
+        _dropped_time += _accumulator - max_accumulated;
+        _accumulator = max_accumulated;
+    }
+}
+
+bool FixedTimestep::consume_step() {
+    if (_accumulator < _step) {
+        return false;
+    }
+    _accumulator -= _step;
+    _total_steps++;
+    return true;
+}
+
+void Time::init(Time& instance, double frame_limit) {
+    _instance = &instance;
+    _instance->_start = Clock::now();
+    _instance->_frame_start = _instance->_start;
+    set_frame_limit(frame_limit);
+}
+
+int64_t Time::delta() {
+    return _instance->_delta;
+}
+
+double Time::delta_seconds() {
+    return Clock::to_seconds(_instance->_delta);
+}
+
+int64_t Time::elapsed() {
+    return Clock::now() - _instance->_start;
+}
+
+uint64_t Time::frame_count() {
+    return _instance->_frame_count;
+}
+
+const FrameHistory& Time::history() {
+    return _instance->_history;
+}
+
+FrameStats Time::frame_stats() {
+    return _instance->_history.stats();
+}
+
+FixedTimestep& Time::fixed_timestep() {
+    return _instance->_fixed;
+}
+
+void Time::set_frame_limit(double frame_limit) {
+    KY_ERROR_CONDITION_MSG(frame_limit >= 0.0, "Frame limit cannot be negative");
+    _instance->_frame_limit_period =
+        frame_limit > 0.0 ? Clock::from_seconds(1.0 / frame_limit) : 0;
+}
+
+void Time::begin_frame() {
+    Profiler::frame_mark();
+
+    int64_t now = Clock::now();
+    _delta = now - _frame_start;
+    _frame_start = now;
+
+    // First frame has nothing to measure against
+    if (_frame_count > 0) {
+        _history.push(_delta);
+        _fixed.accumulate(_delta);
+    }
+    _frame_count++;
+}
+
+void Time::end_frame() {
+    if (_frame_limit_period > 0) {
+        KY_PROFILE_SCOPE("Time::end_frame (frame limiter)");
+        Clock::sleep_until(_frame_start + _frame_limit_period);
+    }
+}
+
+} // namespace ky
@@ -0,0 +1,143 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_CORE__TIME_H
+#define KRYOS_CORE__TIME_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace ky {
+
+// Monotonic high resolution clock. Time points and durations are in nanoseconds from an
+// unspecified epoch, only differences between them are meaningful.
+class Clock {
+public:
+    static int64_t now();
+
+    static constexpr double to_seconds(int64_t ns) { return (double)ns * 1e-9; }
+    static constexpr double to_milliseconds(int64_t ns) { return (double)ns * 1e-6; }
+    static constexpr double to_microseconds(int64_t ns) { return (double)ns * 1e-3; }
+    static constexpr int64_t from_seconds(double seconds) { return (int64_t)(seconds * 1e9); }
+
+    // Precisely waits until `target`. The OS sleep is used for as much of the wait as its measured
+    // accuracy allows and the remainder is spun, so the calling thread wakes up on time without
+    // burning a core for the entire wait.
+    static void sleep_until(int64_t target);
+};
+
+struct FrameStats {
+    int64_t min = 0;
+    int64_t max = 0;
+    int64_t average = 0;
+    int64_t p99 = 0;
+    size_t sample_count = 0;
+};
+
+// Rolling window of the most recent frame times.
+class FrameHistory {
+public:
+    static constexpr size_t CAPACITY = 256;
+
+    void push(int64_t frame_time);
+    void clear();
+
+    inline size_t size() const { return _count; }
+    inline int64_t latest() const {
+        return _count > 0 ? _samples[(_head + CAPACITY - 1) % CAPACITY] : 0;
+    }
+
+    // Computes min/max/average/99th percentile over the samples currently in the window.
+    FrameStats stats() const;
+
+private:
+    std::array<int64_t, CAPACITY> _samples = {};
+    size_t _head = 0;
+    size_t _count = 0;
+};
+
+// Fixed timestep accumulator. Frame time is accumulated and consumed in steps of a fixed size, the
+// remaining fraction is exposed as `alpha` to interpolate rendered state between the previous and
+// current simulation step.
+//
+// To avoid the spiral of death, where a slow simulation step causes more steps to be queued on
+// the next frame, the accumulator is clamped to `max_steps_per_frame` steps and the excess time
+// is dropped.
+class FixedTimestep {
+public:
+    FixedTimestep(int64_t step = Clock::from_seconds(1.0 / 60.0),
+                  uint32_t max_steps_per_frame = 8);
+
+    void set_step(int64_t step);
+    inline int64_t step() const { return _step; }
+    inline double step_seconds() const { return Clock::to_seconds(_step); }
+
+    void accumulate(int64_t frame_time);
+
+    // Consumes a single step from the accumulator. Use as `while (fixed.consume_step()) { ... }`.
+    bool consume_step();
+
+    inline double alpha() const { return (double)_accumulator / (double)_step; }
+    inline uint64_t total_steps() const { return _total_steps; }
+    inline int64_t dropped_time() const { return _dropped_time; }
+
+private:
+    int64_t _step;
+    int64_t _accumulator = 0;
+    int64_t _dropped_time = 0;
+    uint32_t _max_steps_per_frame;
+    uint64_t _total_steps = 0;
+};
+
+// Frame clock driving the runtime loop. Call `begin_frame` at the top of every loop iteration and
+// `end_frame` at the bottom. When a frame limit is set, `end_frame` waits for the remainder of
+// the frame. This should be used when vsync isn't pacing the loop.
+class Time {
+public:
+    static void init(Time& instance, double frame_limit = 0.0);
+
+    // Time between the start of the previous and current frame.
+    static int64_t delta();
+    static double delta_seconds();
+    // Time since `init`.
+    static int64_t elapsed();
+    static uint64_t frame_count();
+
+    static const FrameHistory& history();
+    static FrameStats frame_stats();
+    static FixedTimestep& fixed_timestep();
+
+    // Caps the frame rate to `frame_limit` frames per second, 0 disables the limiter.
+    static void set_frame_limit(double frame_limit);
+
+    void begin_frame();
+    void end_frame();
+
+private:
+    int64_t _start = 0;
+    int64_t _frame_start = 0;
+    int64_t _delta = 0;
+    int64_t _frame_limit_period = 0;
+    uint64_t _frame_count = 0;
+    FrameHistory _history;
+    FixedTimestep _fixed;
+
+    static Time* _instance;
+};
+
+} // namespace ky
+
+#endif
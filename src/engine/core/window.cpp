@@ -16,7 +16,9 @@
 #include "core/window.h"
 
 #include "core/error.h"
+#include "core/input.h"
 #include "core/macros.h"
+#include "core/profiler.h"
 
 #include <string>
 
@@ -25,165 +27,333 @@
 
 namespace ky {
 
-void WindowHandle::init(const std::string_view& title, int width, int height, WindowHandle* parent,
-                        int opts) {
-    KY_FATAL_CONDITION_MSG(title[title.size()] == '\0', "Title string must be null terminated");
-    KY_FATAL_CONDITION_MSG(
-        !(opts & WINDOW_HANDLE_FULLSCREEN_BIT && opts & WINDOW_HANDLE_WINDOWED_BIT),
-        "Cannot set fullscreen and windowed mode at the same time");
+WindowManager* WindowManager::_instance = nullptr;
 
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    // glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    // glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
-    // glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    glfwWindowHint(GLFW_RESIZABLE, (opts & WINDOW_HANDLE_RESIZEABLE_BIT) != 0);
-    glfwWindowHint(GLFW_DECORATED, (opts & ~WINDOW_HANDLE_BORDERLESS_BIT) != 0);
-    glfwWindowHint(GLFW_TRANSPARENT_FRAMEBUFFER,
-                   (opts & WINDOW_HANDLE_TRANSPARENT_BUFFER_BIT) != 0);
-
-    // #ifdef __APPLE__
-    //     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    // #endif
-
-    // GLFWwindow* share = nullptr;
-    // if (parent != nullptr) {
-    //     share = parent->glfw_handle;
-    //     this->parent = parent;
-    // }
-    //
-    // GLFWmonitor* monitor = glfwGetPrimaryMonitor();
-    // if (width == 0 || height == 0) {
-    //     const GLFWvidmode* mode = glfwGetVideoMode(monitor);
-    //     width = mode->width / 2;
-    //     height = mode->height / 2;
-    // }
-    //
-    // if (opts & ~WINDOW_HANDLE_FULLSCREEN_BIT) {
-    //     monitor = nullptr;
-    // }
-    //
-    // glfw_handle = glfwCreateWindow(width, height, title.data(), monitor, share);
-    // KY_FATAL_CONDITION_MSG(glfw_handle != nullptr, "Failed to create GLFW window");
-
-    // if (opts & WINDOW_HANDLE_VSYNC_BIT) {
-    //     glfwSwapInterval(0);
-    // } else {
-    //     glfwSwapInterval(1);
-    // }
-
-    glfw_handle = glfwCreateWindow(800, 600, "Vulkan window", nullptr, nullptr);
-    options = opts;
-}
-
-void WindowHandle::shutdown(bool remove_child_ref_from_parent) {
-    KY_ERROR_CONDITION_MSG(glfw_handle != nullptr, "WindowHandle is not valid");
-
-    for (WindowHandle& child : children) {
-        child.shutdown(false);
-    }
-    std::string window_title(title());
-    glfwDestroyWindow(glfw_handle);
-
-    if (remove_child_ref_from_parent && parent != nullptr) {
-        size_t i = 0;
-        for (; i < parent->children.size(); i++) {
-            if (parent->children[i] == *this) {
-                break;
-            }
-        }
-        if (i < parent->children.size()) {
-            parent->children.erase(parent->children.begin() + i);
-        } else {
-            KY_ERROR_MSG("Could not find '%.*s' window in parent window", KY_STR(window_title));
-        }
+bool WindowHandle::valid() const {
+    return _manager != nullptr && _manager->_slot(*this) != nullptr;
+}
+
+WindowBackend WindowHandle::backend() const {
+    KY_ERROR_CONDITION_MSG_RETURN(_manager != nullptr, WINDOW_BACKEND_GLFW,
+                                  "WindowHandle is not valid");
+    return _manager->backend();
+}
+
+GLFWwindow* WindowHandle::glfw_handle() const {
+    return valid() ? _manager->_slot(*this)->glfw_handle : nullptr;
+}
+
+int WindowHandle::options() const {
+    KY_ERROR_CONDITION_MSG_RETURN(valid(), WINDOW_HANDLE_NONE_BIT, "WindowHandle is not valid");
+    return _manager->_slot(*this)->options;
+}
+
+WindowHandle WindowHandle::parent() const {
+    KY_ERROR_CONDITION_MSG_RETURN(valid(), WindowHandle(), "WindowHandle is not valid");
+    uint32_t parent = _manager->_slot(*this)->parent;
+    if (parent == KY_WINDOW_INVALID_INDEX) {
+        return WindowHandle();
     }
-    glfw_handle = nullptr;
-    options = WINDOW_HANDLE_NONE_BIT;
-    parent = nullptr;
-    children.clear();
+    return WindowHandle(_manager, parent, _manager->_slots[parent].generation);
+}
+
+WindowHandle WindowHandle::create_window(const std::string_view& title, int width, int height,
+                                         int opts) const {
+    KY_ERROR_CONDITION_MSG_RETURN(valid(), WindowHandle(), "WindowHandle is not valid");
+    return _manager->_create_window(title, width, height, _index, opts);
 }
 
-WindowHandle& WindowHandle::create_window(const std::string_view& title, int width, int height,
-                                          int opts) {
-    WindowHandle child;
-    child.init(title, width, height, this, opts);
-    children.push_back(std::move(child));
-    return children.back();
+void WindowHandle::destroy() const {
+    KY_ERROR_CONDITION_MSG(valid(), "WindowHandle is not valid");
+    _manager->_destroy_window(_index);
 }
 
 bool WindowHandle::closing() const {
-    return glfwWindowShouldClose(glfw_handle);
+    KY_ERROR_CONDITION_MSG_RETURN(valid(), true, "WindowHandle is not valid");
+    return _manager->_slot(*this)->should_close;
+}
+
+void WindowHandle::close(bool close) const {
+    KY_ERROR_CONDITION_MSG(valid(), "WindowHandle is not valid");
+    WindowManager::_WindowSlot* slot = _manager->_slot(*this);
+    slot->should_close = close;
+    if (slot->glfw_handle != nullptr) {
+        glfwSetWindowShouldClose(slot->glfw_handle, close);
+    }
 }
 
 const std::string_view WindowHandle::title() const {
-    return std::string_view(glfwGetWindowTitle(glfw_handle));
+    KY_ERROR_CONDITION_MSG_RETURN(valid(), std::string_view(), "WindowHandle is not valid");
+    return *_manager->_slot(*this)->title;
 }
 
 glm::ivec2 WindowHandle::framebuffer_size() const {
-    glm::ivec2 buffer_size;
-    glfwGetFramebufferSize(glfw_handle, &buffer_size.x, &buffer_size.y);
-    return buffer_size;
+    KY_ERROR_CONDITION_MSG_RETURN(valid(), glm::ivec2(0), "WindowHandle is not valid");
+    return _manager->_slot(*this)->framebuffer_size;
 }
 
 glm::ivec2 WindowHandle::size() const {
-    glm::ivec2 win_size;
-    glfwGetWindowSize(glfw_handle, &win_size.x, &win_size.y);
-    return win_size;
+    KY_ERROR_CONDITION_MSG_RETURN(valid(), glm::ivec2(0), "WindowHandle is not valid");
+    return _manager->_slot(*this)->size;
 }
 
 glm::ivec2 WindowHandle::position() const {
-    glm::ivec2 win_pos;
-    glfwGetWindowPos(glfw_handle, &win_pos.x, &win_pos.y);
-    return win_pos;
+    KY_ERROR_CONDITION_MSG_RETURN(valid(), glm::ivec2(0), "WindowHandle is not valid");
+    return _manager->_slot(*this)->position;
 }
 
-void WindowHandle::close(bool close) {
-    glfwSetWindowShouldClose(glfw_handle, close);
+bool WindowHandle::resized() const {
+    KY_ERROR_CONDITION_MSG_RETURN(valid(), false, "WindowHandle is not valid");
+    return _manager->_slot(*this)->resized;
 }
 
-WindowManager::WindowManager(const std::string_view& title, int opts)
-        : WindowManager(title, 0, 0, opts) {
+WindowManager::WindowManager(const std::string_view& title, int opts, WindowBackend backend)
+        : WindowManager(title, 0, 0, opts, backend) {
 }
 
-WindowManager::WindowManager(const std::string_view& title, int width, int height, int opts) {
-    KY_FATAL_CONDITION_MSG(glfwInit(), "Failed to initialize GLFW");
-    glfwSetErrorCallback(_window_handle_error_callback);
-
-    _main.init(title, width, height, nullptr, opts);
+WindowManager::WindowManager(const std::string_view& title, int width, int height, int opts,
+                             WindowBackend backend)
+        : _backend(backend) {
+    if (_backend == WINDOW_BACKEND_GLFW) {
+        KY_FATAL_CONDITION_MSG(_instance == nullptr, "Only one GLFW WindowManager can exist");
+        KY_FATAL_CONDITION_MSG(glfwInit(), "Failed to initialize GLFW");
+        glfwSetErrorCallback(_window_handle_error_callback);
+        _instance = this;
+    }
+    _main = _create_window(title, width, height, KY_WINDOW_INVALID_INDEX, opts);
 }
 
 WindowManager::~WindowManager() {
-    glfwTerminate();
+    if (_main.valid()) {
+        _destroy_window(_main.index());
+    }
+    if (_backend == WINDOW_BACKEND_GLFW) {
+        glfwTerminate();
+        _instance = nullptr;
+    }
+}
+
+WindowHandle WindowManager::find(const GLFWwindow* glfw_handle) const {
+    if (glfw_handle == nullptr) {
+        return WindowHandle();
+    }
+    // The user pointer holds the slot index offset by one so null means not ours
+    uintptr_t slot = (uintptr_t)glfwGetWindowUserPointer((GLFWwindow*)glfw_handle);
+    if (slot == 0 || slot > _slots.size() || _slots[slot - 1].glfw_handle != glfw_handle) {
+        return WindowHandle();
+    }
+    return WindowHandle((WindowManager*)this, (uint32_t)(slot - 1), _slots[slot - 1].generation);
 }
 
 bool WindowManager::continue_runtime_loop() {
-    _remove_closed_windows(_main);
+    KY_PROFILE_SCOPE("WindowManager::continue_runtime_loop");
+    _remove_closed_windows();
+
+    // Coalesce every resize that happened since the last frame into a single flag
+    for (_WindowSlot& slot : _slots) {
+        slot.resized = slot.resize_pending;
+        slot.resize_pending = false;
+    }
     return _main.valid() && !_main.closing();
 }
 
 void WindowManager::swap_buffers() {
-    _swap_buffers(_main);
+    KY_PROFILE_SCOPE("WindowManager::swap_buffers");
+    for (_WindowSlot& slot : _slots) {
+        if (!slot.alive) {
+            continue;
+        }
+        // Swap buffer logic...
+    }
 }
 
-void WindowManager::_window_handle_error_callback(int error, const char* description) {
-    KY_ERROR_MSG("GLFW Error %d: %s", error, description);
+WindowManager::_WindowSlot* WindowManager::_slot(const WindowHandle& handle) {
+    if (handle._manager != this || handle._index >= _slots.size()) {
+        return nullptr;
+    }
+    _WindowSlot& slot = _slots[handle._index];
+    return slot.alive && slot.generation == handle._generation ? &slot : nullptr;
+}
+
+const WindowManager::_WindowSlot* WindowManager::_slot(const WindowHandle& handle) const {
+    return const_cast<WindowManager*>(this)->_slot(handle);
 }
 
-void WindowManager::_remove_closed_windows(WindowHandle& handle) {
-    if (handle.closing()) {
-        handle.shutdown();
+WindowHandle WindowManager::_create_window(const std::string_view& title, int width, int height,
+                                           uint32_t parent, int opts) {
+    KY_FATAL_CONDITION_MSG(title[title.size()] == '\0', "Title string must be null terminated");
+    KY_FATAL_CONDITION_MSG(
+        !(opts & WINDOW_HANDLE_FULLSCREEN_BIT && opts & WINDOW_HANDLE_WINDOWED_BIT),
+        "Cannot set fullscreen and windowed mode at the same time");
+
+    if (width == 0 || height == 0) {
+        width = 800;
+        height = 600;
+    }
+
+    GLFWwindow* glfw_handle = nullptr;
+    if (_backend == WINDOW_BACKEND_GLFW) {
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        // glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        // glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+        // glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+        glfwWindowHint(GLFW_RESIZABLE, (opts & WINDOW_HANDLE_RESIZEABLE_BIT) != 0);
+        glfwWindowHint(GLFW_DECORATED, (opts & ~WINDOW_HANDLE_BORDERLESS_BIT) != 0);
+        glfwWindowHint(GLFW_TRANSPARENT_FRAMEBUFFER,
+                       (opts & WINDOW_HANDLE_TRANSPARENT_BUFFER_BIT) != 0);
+
+        // #ifdef __APPLE__
+        //     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        // #endif
+
+        // GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+        // if (opts & ~WINDOW_HANDLE_FULLSCREEN_BIT) {
+        //     monitor = nullptr;
+        // }
+
+        // if (opts & WINDOW_HANDLE_VSYNC_BIT) {
+        //     glfwSwapInterval(0);
+        // } else {
+        //     glfwSwapInterval(1);
+        // }
+
+        glfw_handle = glfwCreateWindow(width, height, title.data(), nullptr, nullptr);
+        KY_FATAL_CONDITION_MSG(glfw_handle != nullptr, "Failed to create GLFW window");
+    }
+
+    uint32_t index;
+    if (!_free_slots.empty()) {
+        index = _free_slots.back();
+        _free_slots.pop_back();
     } else {
-        for (WindowHandle& child : handle.children) {
-            _remove_closed_windows(child);
+        index = (uint32_t)_slots.size();
+        _slots.emplace_back();
+    }
+    _WindowSlot& slot = _slots[index];
+    slot.glfw_handle = glfw_handle;
+    slot.options = opts;
+    slot.alive = true;
+    slot.should_close = false;
+    slot.resize_pending = false;
+    slot.resized = false;
+    slot.parent = parent;
+    slot.first_child = KY_WINDOW_INVALID_INDEX;
+    slot.previous_sibling = KY_WINDOW_INVALID_INDEX;
+    slot.next_sibling = KY_WINDOW_INVALID_INDEX;
+    slot.title = std::make_unique<std::string>(title);
+    slot.size = glm::ivec2(width, height);
+    slot.framebuffer_size = slot.size;
+    slot.position = glm::ivec2(0);
+
+    if (parent != KY_WINDOW_INVALID_INDEX) {
+        _WindowSlot& parent_slot = _slots[parent];
+        if (parent_slot.first_child != KY_WINDOW_INVALID_INDEX) {
+            _slots[parent_slot.first_child].previous_sibling = index;
+        }
+        slot.next_sibling = parent_slot.first_child;
+        parent_slot.first_child = index;
+    }
+
+    if (glfw_handle != nullptr) {
+        glfwGetWindowSize(glfw_handle, &slot.size.x, &slot.size.y);
+        glfwGetFramebufferSize(glfw_handle, &slot.framebuffer_size.x, &slot.framebuffer_size.y);
+        glfwGetWindowPos(glfw_handle, &slot.position.x, &slot.position.y);
+
+        glfwSetWindowUserPointer(glfw_handle, (void*)(uintptr_t)(index + 1));
+        glfwSetWindowCloseCallback(glfw_handle, _window_close_callback);
+        glfwSetWindowSizeCallback(glfw_handle, _window_size_callback);
+        glfwSetFramebufferSizeCallback(glfw_handle, _framebuffer_size_callback);
+        glfwSetWindowPosCallback(glfw_handle, _window_position_callback);
+    }
+    _window_count++;
+
+    WindowHandle handle(this, index, slot.generation);
+    Input::attach_window(handle);
+    return handle;
+}
+
+void WindowManager::_destroy_window(uint32_t index) {
+    // Collect the subtree depth first, children are destroyed before their parents
+    _destroy_stack.clear();
+    _destroy_stack.push_back(index);
+    for (size_t i = 0; i < _destroy_stack.size(); i++) {
+        uint32_t child = _slots[_destroy_stack[i]].first_child;
+        for (; child != KY_WINDOW_INVALID_INDEX; child = _slots[child].next_sibling) {
+            _destroy_stack.push_back(child);
+        }
+    }
+
+    _WindowSlot& root = _slots[index];
+    if (root.previous_sibling != KY_WINDOW_INVALID_INDEX) {
+        _slots[root.previous_sibling].next_sibling = root.next_sibling;
+    } else if (root.parent != KY_WINDOW_INVALID_INDEX) {
+        _slots[root.parent].first_child = root.next_sibling;
+    }
+    if (root.next_sibling != KY_WINDOW_INVALID_INDEX) {
+        _slots[root.next_sibling].previous_sibling = root.previous_sibling;
+    }
+
+    for (size_t i = _destroy_stack.size(); i-- > 0;) {
+        uint32_t destroyed = _destroy_stack[i];
+        _WindowSlot& slot = _slots[destroyed];
+        Input::detach_window(WindowHandle(this, destroyed, slot.generation));
+        if (slot.glfw_handle != nullptr) {
+            glfwDestroyWindow(slot.glfw_handle);
         }
+        slot.glfw_handle = nullptr;
+        slot.alive = false;
+        slot.generation++;
+        slot.title.reset();
+        _free_slots.push_back(destroyed);
+        _window_count--;
+    }
+}
+
+void WindowManager::_remove_closed_windows() {
+    KY_PROFILE_SCOPE("WindowManager::_remove_closed_windows");
+    for (uint32_t i = 0; i < (uint32_t)_slots.size(); i++) {
+        if (_slots[i].alive && _slots[i].should_close) {
+            _destroy_window(i);
+        }
+    }
+}
+
+WindowManager::_WindowSlot* WindowManager::_slot_from_glfw(GLFWwindow* glfw_handle) {
+    if (_instance == nullptr) {
+        return nullptr;
+    }
+    uintptr_t slot = (uintptr_t)glfwGetWindowUserPointer(glfw_handle);
+    return slot != 0 && slot <= _instance->_slots.size() ? &_instance->_slots[slot - 1] : nullptr;
+}
+
+void WindowManager::_window_handle_error_callback(int error, const char* description) {
+    KY_ERROR_MSG("GLFW Error %d: %s", error, description);
+}
+
+void WindowManager::_window_close_callback(GLFWwindow* glfw_handle) {
+    if (_WindowSlot* slot = _slot_from_glfw(glfw_handle)) {
+        slot->should_close = true;
+    }
+}
+
+void WindowManager::_window_size_callback(GLFWwindow* glfw_handle, int width, int height) {
+    if (_WindowSlot* slot = _slot_from_glfw(glfw_handle)) {
+        slot->size = glm::ivec2(width, height);
+        slot->resize_pending = true;
+    }
+}
+
+void WindowManager::_framebuffer_size_callback(GLFWwindow* glfw_handle, int width, int height) {
+    if (_WindowSlot* slot = _slot_from_glfw(glfw_handle)) {
+        slot->framebuffer_size = glm::ivec2(width, height);
+        slot->resize_pending = true;
     }
 }
 
-void WindowManager::_swap_buffers(WindowHandle& handle) {
-    // Swap buffer logic...
-    for (WindowHandle& child : handle.children) {
-        _swap_buffers(child);
+void WindowManager::_window_position_callback(GLFWwindow* glfw_handle, int x, int y) {
+    if (_WindowSlot* slot = _slot_from_glfw(glfw_handle)) {
+        slot->position = glm::ivec2(x, y);
     }
 }
 
@@ -16,7 +16,12 @@
 #ifndef KRYOS_CORE__WINDOW_H
 #define KRYOS_CORE__WINDOW_H
 
+#include "core/memory_tracker.h"
+
+#include <cstdint>
 #include <glm/glm.hpp>
+#include <memory>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -27,7 +32,7 @@ struct GLFWwindow;
 
 #define KY_WINDOW_HANDLE_DEFAULT KY_WINDOW_HANDLE_DEFAULT_OPTIONS | ky::WINDOW_HANDLE_WINDOWED_BIT
 
-// FIXME: Sometimes segfaults when testing with toggle input reg stuff
+#define KY_WINDOW_INVALID_INDEX UINT32_MAX
 
 namespace ky {
 
@@ -41,68 +46,161 @@ enum WindowHandleFlags {
     WINDOW_HANDLE_TRANSPARENT_BUFFER_BIT = 1 << 5,
 };
 
-struct WindowHandle {
-    GLFWwindow* glfw_handle = nullptr;
-    int options = WINDOW_HANDLE_NONE_BIT;
-    WindowHandle* parent = nullptr;
-    std::vector<WindowHandle> children = {};
+enum WindowBackend {
+    WINDOW_BACKEND_GLFW,
+    // Windows only exist in memory, nothing connects to a display and GLFW is never initialized.
+    // Closing is driven through `WindowHandle::close`. Meant for dedicated servers and benchmarks.
+    WINDOW_BACKEND_HEADLESS,
+};
+
+class WindowManager;
 
-    void init(const std::string_view& title, int width, int height, WindowHandle* parent,
-              int opts = KY_WINDOW_HANDLE_DEFAULT);
+// Reference to a window owned by `WindowManager`. Handles are cheap to copy and never dangle, once
+// the window is destroyed `valid` returns false even if its slot was reused by a newer window.
+//
+// Properties are answered from a cache kept up to date by GLFW callbacks, so querying them doesn't
+// go through GLFW.
+class WindowHandle {
+public:
+    WindowHandle() = default;
 
-    void shutdown(bool remove_child_ref_from_parent = true);
+    inline uint32_t index() const { return _index; }
+    inline uint32_t generation() const { return _generation; }
 
     inline bool operator==(const WindowHandle& window) const {
-        return glfw_handle == window.glfw_handle;
+        return _manager == window._manager && _index == window._index &&
+               _generation == window._generation;
     }
 
-    inline bool operator!=(const WindowHandle& window) const {
-        return glfw_handle != window.glfw_handle;
-    }
+    inline bool operator!=(const WindowHandle& window) const { return !(*this == window); }
+
+    bool valid() const;
+    WindowBackend backend() const;
+    GLFWwindow* glfw_handle() const;
+    int options() const;
+    WindowHandle parent() const;
 
-    WindowHandle& create_window(const std::string_view& title, int width, int height,
-                                int opts = KY_WINDOW_HANDLE_DEFAULT);
+    WindowHandle create_window(const std::string_view& title, int width, int height,
+                               int opts = KY_WINDOW_HANDLE_DEFAULT) const;
+
+    // Destroys the window and all of its children immediately, prefer `close` while iterating
+    // windows.
+    void destroy() const;
 
     bool closing() const;
-    inline bool valid() const { return glfw_handle != nullptr; }
+    void close(bool close = true) const;
 
     const std::string_view title() const;
     glm::ivec2 framebuffer_size() const;
     glm::ivec2 size() const;
     glm::ivec2 position() const;
 
-    void close(bool close = true);
+    // Whether the window or framebuffer size changed since the previous frame, however many resize
+    // events arrived in between.
+    bool resized() const;
+
+private:
+    friend class WindowManager;
+
+    WindowManager* _manager = nullptr;
+    uint32_t _index = KY_WINDOW_INVALID_INDEX;
+    uint32_t _generation = 0;
+
+    WindowHandle(WindowManager* manager, uint32_t index, uint32_t generation)
+            : _manager(manager), _index(index), _generation(generation) {}
 };
 
 class WindowManager {
 public:
-    WindowManager(const std::string_view& title, int opts = KY_WINDOW_HANDLE_DEFAULT);
+    WindowManager(const std::string_view& title, int opts = KY_WINDOW_HANDLE_DEFAULT,
+                  WindowBackend backend = WINDOW_BACKEND_GLFW);
     WindowManager(const std::string_view& title, int width, int height,
-                  int opts = KY_WINDOW_HANDLE_DEFAULT);
+                  int opts = KY_WINDOW_HANDLE_DEFAULT,
+                  WindowBackend backend = WINDOW_BACKEND_GLFW);
     ~WindowManager();
 
-    inline WindowHandle& main() { return _main; }
-    inline const WindowHandle& main() const { return _main; }
+    WindowManager(const WindowManager&) = delete;
+    WindowManager& operator=(const WindowManager&) = delete;
 
-    inline WindowHandle& create_window(const std::string_view& title,
-                                       int opts = KY_WINDOW_HANDLE_DEFAULT) {
+    inline WindowHandle main() const { return _main; }
+    inline WindowBackend backend() const { return _backend; }
+    inline size_t window_count() const { return _window_count; }
+
+    inline WindowHandle create_window(const std::string_view& title,
+                                      int opts = KY_WINDOW_HANDLE_DEFAULT) {
         return create_window(title, 0, 0, opts);
     }
 
-    inline WindowHandle& create_window(const std::string_view& title, int width, int height,
-                                       int opts = KY_WINDOW_HANDLE_DEFAULT) {
+    inline WindowHandle create_window(const std::string_view& title, int width, int height,
+                                      int opts = KY_WINDOW_HANDLE_DEFAULT) {
         return _main.create_window(title, width, height, opts);
     }
 
+    // Window owning `glfw_handle`, invalid if it isn't one of this manager's windows.
+    WindowHandle find(const GLFWwindow* glfw_handle) const;
+
+    // Calls `function` with the handle of every open window in slot order.
+    template <typename _Function>
+    void each_window(_Function&& function) {
+        for (uint32_t i = 0; i < (uint32_t)_slots.size(); i++) {
+            if (_slots[i].alive) {
+                function(WindowHandle(this, i, _slots[i].generation));
+            }
+        }
+    }
+
     bool continue_runtime_loop();
     void swap_buffers();
 
 private:
+    friend class WindowHandle;
+
+    // Windows live in a flat array of slots, the tree is stored as indices into it so handles
+    // stay stable when windows are created or destroyed. The generation is bumped each time a
+    // slot is freed to invalidate the handles pointing at it.
+    struct _WindowSlot {
+        GLFWwindow* glfw_handle = nullptr;
+        int options = WINDOW_HANDLE_NONE_BIT;
+        uint32_t generation = 0;
+        bool alive = false;
+        bool should_close = false;
+        bool resize_pending = false;
+        bool resized = false;
+
+        uint32_t parent = KY_WINDOW_INVALID_INDEX;
+        uint32_t first_child = KY_WINDOW_INVALID_INDEX;
+        uint32_t next_sibling = KY_WINDOW_INVALID_INDEX;
+        uint32_t previous_sibling = KY_WINDOW_INVALID_INDEX;
+
+        std::unique_ptr<std::string> title;
+        glm::ivec2 size = glm::ivec2(0);
+        glm::ivec2 framebuffer_size = glm::ivec2(0);
+        glm::ivec2 position = glm::ivec2(0);
+    };
+
+    TaggedVector<_WindowSlot, MEMORY_TAG_WINDOW> _slots;
+    TaggedVector<uint32_t, MEMORY_TAG_WINDOW> _free_slots;
+    TaggedVector<uint32_t, MEMORY_TAG_WINDOW> _destroy_stack;
     WindowHandle _main;
+    WindowBackend _backend = WINDOW_BACKEND_GLFW;
+    size_t _window_count = 0;
+
+    static WindowManager* _instance;
+
+    _WindowSlot* _slot(const WindowHandle& handle);
+    const _WindowSlot* _slot(const WindowHandle& handle) const;
+
+    WindowHandle _create_window(const std::string_view& title, int width, int height,
+                                uint32_t parent, int opts);
+    void _destroy_window(uint32_t index);
+    void _remove_closed_windows();
 
+    static _WindowSlot* _slot_from_glfw(GLFWwindow* glfw_handle);
     static void _window_handle_error_callback(int error, const char* description);
-    static void _remove_closed_windows(WindowHandle& handle);
-    static void _swap_buffers(WindowHandle& handle);
+    static void _window_close_callback(GLFWwindow* glfw_handle);
+    static void _window_size_callback(GLFWwindow* glfw_handle, int width, int height);
+    static void _framebuffer_size_callback(GLFWwindow* glfw_handle, int width, int height);
+    static void _window_position_callback(GLFWwindow* glfw_handle, int x, int y);
 };
 
 } // namespace ky
@@ -0,0 +1,170 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "render_hardware/base/command_list.h"
+#include "core/memory_tracker.h"
+
+#include <algorithm>
+
+namespace ky {
+
+const char* command_type_to_cstring(CommandType type) {
+    switch (type) {
+        case COMMAND_BEGIN_RENDER_PASS:
+            return "begin_render_pass";
+        case COMMAND_END_RENDER_PASS:
+            return "end_render_pass";
+        case COMMAND_BIND_PIPELINE:
+            return "bind_pipeline";
+        case COMMAND_BIND_VERTEX_BUFFER:
+            return "bind_vertex_buffer";
+        case COMMAND_BIND_INDEX_BUFFER:
+            return "bind_index_buffer";
+        case COMMAND_BIND_UNIFORM_BUFFER:
+            return "bind_uniform_buffer";
+        case COMMAND_BIND_STORAGE_BUFFER:
+            return "bind_storage_buffer";
+        case COMMAND_BIND_TEXTURE:
+            return "bind_texture";
+        case COMMAND_PUSH_CONSTANTS:
+            return "push_constants";
+        case COMMAND_SET_VIEWPORT:
+            return "set_viewport";
+        case COMMAND_SET_SCISSOR:
+            return "set_scissor";
+        case COMMAND_DRAW:
+            return "draw";
+        case COMMAND_DRAW_INDEXED:
+            return "draw_indexed";
+        case COMMAND_DISPATCH:
+            return "dispatch";
+        case COMMAND_COPY_BUFFER:
+            return "copy_buffer";
+        case COMMAND_COPY_BUFFER_TO_TEXTURE:
+            return "copy_buffer_to_texture";
+        case COMMAND_BARRIER:
+            return "barrier";
+        case COMMAND_BEGIN_MARKER:
+            return "begin_marker";
+        case COMMAND_END_MARKER:
+            return "end_marker";
+        default:
+            return "unknown";
+    }
+}
+
+CommandList::~CommandList() {
+    if (_data != nullptr) {
+        memory::deallocate(_data, _capacity, MEMORY_TAG_RENDER, KY_COMMAND_ALIGNMENT);
+    }
+}
+
+void CommandList::begin_render_pass(const RenderPassDesc& pass) {
+    _push<CommandBeginRenderPass>(COMMAND_BEGIN_RENDER_PASS)->pass = pass;
+}
+
+void CommandList::end_render_pass() {
+    _push<uint8_t>(COMMAND_END_RENDER_PASS);
+}
+
+void CommandList::set_viewport(float x, float y, float width, float height, float min_depth,
+                               float max_depth) {
+    *_push<CommandSetViewport>(COMMAND_SET_VIEWPORT) = {x, y, width, height, min_depth,
+                                                        max_depth};
+}
+
+void CommandList::set_scissor(int32_t x, int32_t y, uint32_t width, uint32_t height) {
+    *_push<CommandSetScissor>(COMMAND_SET_SCISSOR) = {x, y, width, height};
+}
+
+void CommandList::dispatch(uint32_t group_count_x, uint32_t group_count_y,
+                           uint32_t group_count_z) {
+    *_push<CommandDispatch>(COMMAND_DISPATCH) = {group_count_x, group_count_y, group_count_z};
+}
+
+void CommandList::copy_buffer(BufferHandle source, uint64_t source_offset,
+                              BufferHandle destination, uint64_t destination_offset,
+                              uint64_t size) {
+    *_push<CommandCopyBuffer>(COMMAND_COPY_BUFFER) = {source, destination, source_offset,
+                                                      destination_offset, size};
+}
+
+void CommandList::copy_buffer_to_texture(BufferHandle source, uint64_t source_offset,
+                                         TextureHandle destination, uint32_t mip_level,
+                                         uint32_t array_layer) {
+    *_push<CommandCopyBufferToTexture>(COMMAND_COPY_BUFFER_TO_TEXTURE) = {
+        source, destination, source_offset, mip_level, array_layer};
+}
+
+void CommandList::barrier(const BufferBarrier* buffers, uint32_t buffer_count,
+                          const TextureBarrier* textures, uint32_t texture_count) {
+    if (buffer_count + texture_count == 0) {
+        return;
+    }
+    size_t buffer_size = sizeof(BufferBarrier) * buffer_count;
+    size_t texture_size = sizeof(TextureBarrier) * texture_count;
+    CommandBarrier* command =
+        _push<CommandBarrier>(COMMAND_BARRIER, buffer_size + texture_size);
+    command->buffer_count = buffer_count;
+    command->texture_count = texture_count;
+    uint8_t* trailing = (uint8_t*)(command + 1);
+    if (buffer_count > 0) {
+        std::memcpy(trailing, buffers, buffer_size);
+    }
+    if (texture_count > 0) {
+        std::memcpy(trailing + buffer_size, textures, texture_size);
+    }
+}
+
+void CommandList::begin_marker(std::string_view name) {
+    CommandBeginMarker* command = _push<CommandBeginMarker>(COMMAND_BEGIN_MARKER, name.size());
+    command->length = (uint32_t)name.size();
+    std::memcpy(command + 1, name.data(), name.size());
+}
+
+void CommandList::end_marker() {
+    _push<uint8_t>(COMMAND_END_MARKER);
+}
+
+void CommandList::append(const CommandList& other) {
+    if (other._size == 0) {
+        return;
+    }
+    if (_size + other._size > _capacity) {
+        _grow(_size + other._size);
+    }
+    std::memcpy(_data + _size, other._data, other._size);
+    _size += other._size;
+    _command_count += other._command_count;
+}
+
+void CommandList::reset() {
+    _size = 0;
+    _command_count = 0;
+}
+
+void CommandList::_grow(size_t min_capacity) {
+    size_t capacity = std::max(_capacity * 2, (size_t)KY_COMMAND_LIST_INITIAL_CAPACITY);
+    capacity = std::max(capacity, min_capacity);
+    uint8_t* data = (uint8_t*)memory::allocate(capacity, MEMORY_TAG_RENDER, KY_COMMAND_ALIGNMENT);
+    if (_data != nullptr) {
+        std::memcpy(data, _data, _size);
+        memory::deallocate(_data, _capacity, MEMORY_TAG_RENDER, KY_COMMAND_ALIGNMENT);
+    }
+    _data = data;
+    _capacity = capacity;
+}
+
+} // namespace ky
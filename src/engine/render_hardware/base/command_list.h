@@ -0,0 +1,333 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_RENDER_HARDWARE_BASE__COMMAND_LIST_H
+#define KRYOS_RENDER_HARDWARE_BASE__COMMAND_LIST_H
+
+#include "core/memory.h"
+#include "render_hardware/base/resources.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Initial bytes of a command list's stream, it grows as needed and keeps its capacity when reset
+#ifndef KY_COMMAND_LIST_INITIAL_CAPACITY
+#    define KY_COMMAND_LIST_INITIAL_CAPACITY (16 * 1024)
+#endif
+
+#define KY_COMMAND_ALIGNMENT 8
+
+namespace ky {
+
+enum CommandType : uint32_t {
+    COMMAND_BEGIN_RENDER_PASS,
+    COMMAND_END_RENDER_PASS,
+    COMMAND_BIND_PIPELINE,
+    COMMAND_BIND_VERTEX_BUFFER,
+    COMMAND_BIND_INDEX_BUFFER,
+    COMMAND_BIND_UNIFORM_BUFFER,
+    COMMAND_BIND_STORAGE_BUFFER,
+    COMMAND_BIND_TEXTURE,
+    COMMAND_PUSH_CONSTANTS,
+    COMMAND_SET_VIEWPORT,
+    COMMAND_SET_SCISSOR,
+    COMMAND_DRAW,
+    COMMAND_DRAW_INDEXED,
+    COMMAND_DISPATCH,
+    COMMAND_COPY_BUFFER,
+    COMMAND_COPY_BUFFER_TO_TEXTURE,
+    COMMAND_BARRIER,
+    COMMAND_BEGIN_MARKER,
+    COMMAND_END_MARKER,
+    COMMAND_COUNT,
+};
+
+const char* command_type_to_cstring(CommandType type);
+
+// Every command starts with a header followed by its `Command*` struct and any trailing data,
+// padded to `KY_COMMAND_ALIGNMENT`. `size` covers all of it so the next command is `size` bytes
+// further.
+struct CommandHeader {
+    CommandType type;
+    uint32_t size;
+};
+
+struct CommandBeginRenderPass {
+    RenderPassDesc pass;
+};
+
+struct CommandBindPipeline {
+    PipelineHandle pipeline;
+};
+
+struct CommandBindVertexBuffer {
+    uint32_t slot;
+    BufferHandle buffer;
+    uint64_t offset;
+};
+
+struct CommandBindIndexBuffer {
+    BufferHandle buffer;
+    IndexType type;
+    uint64_t offset;
+};
+
+// Uniform and storage buffer bindings
+struct CommandBindBuffer {
+    uint32_t slot;
+    BufferHandle buffer;
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct CommandBindTexture {
+    uint32_t slot;
+    TextureHandle texture;
+    SamplerHandle sampler;
+};
+
+// Followed by `size` bytes of constants
+struct CommandPushConstants {
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct CommandSetViewport {
+    float x;
+    float y;
+    float width;
+    float height;
+    float min_depth;
+    float max_depth;
+};
+
+struct CommandSetScissor {
+    int32_t x;
+    int32_t y;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct CommandDraw {
+    uint32_t vertex_count;
+    uint32_t instance_count;
+    uint32_t first_vertex;
+    uint32_t first_instance;
+};
+
+struct CommandDrawIndexed {
+    uint32_t index_count;
+    uint32_t instance_count;
+    uint32_t first_index;
+    int32_t vertex_offset;
+    uint32_t first_instance;
+};
+
+struct CommandDispatch {
+    uint32_t group_count_x;
+    uint32_t group_count_y;
+    uint32_t group_count_z;
+};
+
+struct CommandCopyBuffer {
+    BufferHandle source;
+    BufferHandle destination;
+    uint64_t source_offset;
+    uint64_t destination_offset;
+    uint64_t size;
+};
+
+// Copies tightly packed texels into a whole mip level of one array layer
+struct CommandCopyBufferToTexture {
+    BufferHandle source;
+    TextureHandle destination;
+    uint64_t source_offset;
+    uint32_t mip_level;
+    uint32_t array_layer;
+};
+
+// Followed by `buffer_count` buffer barriers and then `texture_count` texture barriers
+struct CommandBarrier {
+    uint32_t buffer_count;
+    uint32_t texture_count;
+};
+
+// Followed by `length` characters, not null terminated
+struct CommandBeginMarker {
+    uint32_t length;
+};
+
+template <typename _Command>
+inline const _Command& command_data(const CommandHeader& header) {
+    return *(const _Command*)(&header + 1);
+}
+
+// Data trailing a command's struct.
+template <typename _Command, typename _Type = uint8_t>
+inline const _Type* command_trailing_data(const CommandHeader& header) {
+    return (const _Type*)(&command_data<_Command>(header) + 1);
+}
+
+// Backend independent stream of recorded commands. Recording only appends to memory owned by the
+// list, so lists can be recorded on any number of threads at once as long as each list is
+// recorded by one thread at a time. Backends translate or validate the stream when the list is
+// submitted.
+class CommandList {
+public:
+    CommandList() = default;
+    ~CommandList();
+
+    CommandList(const CommandList&) = delete;
+    CommandList& operator=(const CommandList&) = delete;
+
+    void begin_render_pass(const RenderPassDesc& pass);
+    void end_render_pass();
+
+    void bind_pipeline(PipelineHandle pipeline);
+    void bind_vertex_buffer(uint32_t slot, BufferHandle buffer, uint64_t offset = 0);
+    void bind_index_buffer(BufferHandle buffer, IndexType type, uint64_t offset = 0);
+    void bind_uniform_buffer(uint32_t slot, BufferHandle buffer, uint64_t offset, uint64_t size);
+    void bind_storage_buffer(uint32_t slot, BufferHandle buffer, uint64_t offset, uint64_t size);
+    void bind_texture(uint32_t slot, TextureHandle texture, SamplerHandle sampler);
+    void push_constants(const void* data, uint32_t size, uint32_t offset = 0);
+
+    void set_viewport(float x, float y, float width, float height, float min_depth = 0.0f,
+                      float max_depth = 1.0f);
+    void set_scissor(int32_t x, int32_t y, uint32_t width, uint32_t height);
+
+    void draw(uint32_t vertex_count, uint32_t instance_count = 1, uint32_t first_vertex = 0,
+              uint32_t first_instance = 0);
+    void draw_indexed(uint32_t index_count, uint32_t instance_count = 1, uint32_t first_index = 0,
+                      int32_t vertex_offset = 0, uint32_t first_instance = 0);
+    void dispatch(uint32_t group_count_x, uint32_t group_count_y = 1,
+                  uint32_t group_count_z = 1);
+
+    void copy_buffer(BufferHandle source, uint64_t source_offset, BufferHandle destination,
+                     uint64_t destination_offset, uint64_t size);
+    void copy_buffer_to_texture(BufferHandle source, uint64_t source_offset,
+                                TextureHandle destination, uint32_t mip_level = 0,
+                                uint32_t array_layer = 0);
+
+    void barrier(const BufferBarrier* buffers, uint32_t buffer_count,
+                 const TextureBarrier* textures, uint32_t texture_count);
+    inline void barrier(const TextureBarrier& texture) { barrier(nullptr, 0, &texture, 1); }
+    inline void barrier(const BufferBarrier& buffer) { barrier(&buffer, 1, nullptr, 0); }
+
+    // Debug regions shown by GPU debuggers and checked for balance by validation.
+    void begin_marker(std::string_view name);
+    void end_marker();
+
+    // Appends the commands recorded in `other`.
+    void append(const CommandList& other);
+    // Clears the recorded commands, keeping the memory for the next recording.
+    void reset();
+
+    inline const uint8_t* data() const { return _data; }
+    inline size_t size() const { return _size; }
+    inline uint32_t command_count() const { return _command_count; }
+    inline bool empty() const { return _command_count == 0; }
+
+    // Calls `function(const CommandHeader&)` for every command in recording order.
+    template <typename _Function>
+    void for_each(_Function&& function) const;
+
+private:
+    uint8_t* _data = nullptr;
+    size_t _size = 0;
+    size_t _capacity = 0;
+    uint32_t _command_count = 0;
+
+    template <typename _Command>
+    _Command* _push(CommandType type, size_t trailing_size = 0);
+    void _grow(size_t min_capacity);
+};
+
+template <typename _Command>
+inline _Command* CommandList::_push(CommandType type, size_t trailing_size) {
+    size_t size = sizeof(CommandHeader) + sizeof(_Command) + trailing_size;
+    size = align_up(size, KY_COMMAND_ALIGNMENT);
+    if (_size + size > _capacity) {
+        _grow(_size + size);
+    }
+    CommandHeader* header = (CommandHeader*)(_data + _size);
+    header->type = type;
+    header->size = (uint32_t)size;
+    _size += size;
+    _command_count++;
+    return (_Command*)(header + 1);
+}
+
+template <typename _Function>
+void CommandList::for_each(_Function&& function) const {
+    for (size_t offset = 0; offset < _size;) {
+        const CommandHeader& header = *(const CommandHeader*)(_data + offset);
+        function(header);
+        offset += header.size;
+    }
+}
+
+inline void CommandList::bind_pipeline(PipelineHandle pipeline) {
+    _push<CommandBindPipeline>(COMMAND_BIND_PIPELINE)->pipeline = pipeline;
+}
+
+inline void CommandList::bind_vertex_buffer(uint32_t slot, BufferHandle buffer, uint64_t offset) {
+    *_push<CommandBindVertexBuffer>(COMMAND_BIND_VERTEX_BUFFER) = {slot, buffer, offset};
+}
+
+inline void CommandList::bind_index_buffer(BufferHandle buffer, IndexType type,
+                                           uint64_t offset) {
+    *_push<CommandBindIndexBuffer>(COMMAND_BIND_INDEX_BUFFER) = {buffer, type, offset};
+}
+
+inline void CommandList::bind_uniform_buffer(uint32_t slot, BufferHandle buffer, uint64_t offset,
+                                             uint64_t size) {
+    *_push<CommandBindBuffer>(COMMAND_BIND_UNIFORM_BUFFER) = {slot, buffer, offset, size};
+}
+
+inline void CommandList::bind_storage_buffer(uint32_t slot, BufferHandle buffer, uint64_t offset,
+                                             uint64_t size) {
+    *_push<CommandBindBuffer>(COMMAND_BIND_STORAGE_BUFFER) = {slot, buffer, offset, size};
+}
+
+inline void CommandList::bind_texture(uint32_t slot, TextureHandle texture,
+                                      SamplerHandle sampler) {
+    *_push<CommandBindTexture>(COMMAND_BIND_TEXTURE) = {slot, texture, sampler};
+}
+
+inline void CommandList::push_constants(const void* data, uint32_t size, uint32_t offset) {
+    CommandPushConstants* command = _push<CommandPushConstants>(COMMAND_PUSH_CONSTANTS, size);
+    command->offset = offset;
+    command->size = size;
+    std::memcpy(command + 1, data, size);
+}
+
+inline void CommandList::draw(uint32_t vertex_count, uint32_t instance_count,
+                              uint32_t first_vertex, uint32_t first_instance) {
+    *_push<CommandDraw>(COMMAND_DRAW) = {vertex_count, instance_count, first_vertex,
+                                         first_instance};
+}
+
+inline void CommandList::draw_indexed(uint32_t index_count, uint32_t instance_count,
+                                      uint32_t first_index, int32_t vertex_offset,
+                                      uint32_t first_instance) {
+    *_push<CommandDrawIndexed>(COMMAND_DRAW_INDEXED) = {index_count, instance_count, first_index,
+                                                        vertex_offset, first_instance};
+}
+
+} // namespace ky
+
+#endif
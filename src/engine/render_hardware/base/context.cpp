@@ -0,0 +1,497 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "render_hardware/base/context.h"
+#include "core/error.h"
+#include "core/profiler.h"
+#include "render_hardware/base/shader_cache.h"
+#include "render_hardware/null/null_device.h"
+#if KY_RHI_VULKAN_ENABLED
+#    include "render_hardware/vulkan/vulkan_device.h"
+#endif
+
+#include <cstring>
+
+namespace ky {
+
+RenderContext::~RenderContext() {
+    shutdown();
+}
+
+bool RenderContext::init(const RenderContextDesc& desc) {
+    shutdown();
+    _init_pool(_buffers, KY_RHI_MAX_BUFFERS);
+    _init_pool(_textures, KY_RHI_MAX_TEXTURES);
+    _init_pool(_samplers, KY_RHI_MAX_SAMPLERS);
+    _init_pool(_shaders, KY_RHI_MAX_SHADERS);
+    _init_pool(_pipelines, KY_RHI_MAX_PIPELINES);
+
+    _backend = desc.backend;
+    switch (_backend) {
+        case RENDER_BACKEND_NULL:
+            _device = memory::create<NullRenderDevice>(MEMORY_TAG_RENDER);
+            break;
+        case RENDER_BACKEND_VULKAN:
+#if KY_RHI_VULKAN_ENABLED
+            _device = memory::create<VulkanRenderDevice>(MEMORY_TAG_RENDER);
+            break;
+#else
+            KY_ERROR_MSG("The Vulkan backend isn't compiled in, see KY_ENABLE_VULKAN_BACKEND");
+            return false;
+#endif
+        default:
+            KY_ERROR_MSG("Unknown render backend %u", (uint32_t)_backend);
+            return false;
+    }
+    if (!_device->init(*this, desc)) {
+        _destroy_device();
+        return false;
+    }
+
+    _pipeline_cache_path.clear();
+    if (desc.pipeline_cache_path != nullptr) {
+        _pipeline_cache_path = desc.pipeline_cache_path;
+        TaggedVector<uint8_t, MEMORY_TAG_RENDER> data;
+        if (read_pipeline_cache_file(desc.pipeline_cache_path, _backend,
+                                     _device->pipeline_cache_id(), data) &&
+            !_device->load_pipeline_cache(data.data(), data.size())) {
+            KY_WARNING_MSG("Discarding pipeline cache %s rejected by the backend",
+                           desc.pipeline_cache_path);
+        }
+    }
+
+    TextureDesc swapchain;
+    if (_device->swapchain_desc(swapchain)) {
+        _swapchain = _allocate<TextureHandle>(_textures, swapchain);
+        _device->set_swapchain_texture(_swapchain.index);
+    }
+    if (!_upload_ring.init(*this, desc.upload_ring_size)) {
+        shutdown();
+        return false;
+    }
+    return true;
+}
+
+void RenderContext::shutdown() {
+    if (_device == nullptr) {
+        return;
+    }
+    _device->wait_idle();
+    if (!_pipeline_cache_path.empty()) {
+        save_pipeline_cache();
+    }
+    _upload_ring.shutdown();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (_Frame& frame : _frames) {
+        _release_frame(frame);
+        for (CommandList* list : frame.command_lists) {
+            memory::destroy(MEMORY_TAG_RENDER, list);
+        }
+        frame.command_lists.clear();
+    }
+
+    // The swapchain texture belongs to the device
+    if (_swapchain.valid()) {
+        _release(_textures, _swapchain.index);
+        _swapchain = TextureHandle();
+    }
+    uint32_t leaked = 0;
+    auto destroy_alive = [&](auto& pool, _ResourceType type) {
+        for (uint32_t i = 0; i < pool.used; i++) {
+            if (pool.alive[i]) {
+                _destroy_now(type, i);
+                leaked++;
+            }
+        }
+    };
+    destroy_alive(_buffers, _RESOURCE_BUFFER);
+    destroy_alive(_textures, _RESOURCE_TEXTURE);
+    destroy_alive(_samplers, _RESOURCE_SAMPLER);
+    destroy_alive(_shaders, _RESOURCE_SHADER);
+    destroy_alive(_pipelines, _RESOURCE_PIPELINE);
+    if (leaked > 0) {
+        KY_WARNING_MSG("%u render resources were still alive at shutdown", leaked);
+    }
+
+    _destroy_device();
+    _frame_number = 0;
+}
+
+template <typename _Desc>
+void RenderContext::_init_pool(_Pool<_Desc>& pool, uint32_t capacity) {
+    pool.descs.assign(capacity, _Desc());
+    pool.generations.assign(capacity, 0);
+    pool.alive.assign(capacity, 0);
+    pool.free.clear();
+    pool.free.reserve(capacity);
+    pool.used = 0;
+}
+
+template <typename _Handle, typename _Desc>
+_Handle RenderContext::_allocate(_Pool<_Desc>& pool, const _Desc& desc) {
+    uint32_t index;
+    if (!pool.free.empty()) {
+        index = pool.free.back();
+        pool.free.pop_back();
+    } else if (pool.used < pool.descs.size()) {
+        index = pool.used++;
+    } else {
+        return _Handle();
+    }
+    pool.descs[index] = desc;
+    pool.descs[index].name = nullptr;
+    pool.alive[index] = 1;
+
+    _Handle handle;
+    handle.index = index;
+    handle.generation = pool.generations[index];
+    return handle;
+}
+
+template <typename _Handle, typename _Desc>
+bool RenderContext::_alive(const _Pool<_Desc>& pool, _Handle handle) {
+    return _usable(pool, handle) && pool.alive[handle.index];
+}
+
+template <typename _Handle, typename _Desc>
+bool RenderContext::_usable(const _Pool<_Desc>& pool, _Handle handle) {
+    return handle.index < pool.used && pool.generations[handle.index] == handle.generation;
+}
+
+template <typename _Desc>
+void RenderContext::_release(_Pool<_Desc>& pool, uint32_t index) {
+    pool.alive[index] = 0;
+    pool.generations[index]++;
+    pool.free.push_back(index);
+}
+
+template <typename _Handle, typename _Desc>
+void RenderContext::_destroy(_Pool<_Desc>& pool, _ResourceType type, _Handle handle) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    KY_ERROR_CONDITION_MSG(_alive(pool, handle), "Destroying a resource that isn't alive");
+    pool.alive[handle.index] = 0;
+    _frames[frame_slot()].pending_destroys.push_back({type, handle.index});
+}
+
+void RenderContext::_release_frame(_Frame& frame) {
+    for (const _PendingDestroy& pending : frame.pending_destroys) {
+        _destroy_now(pending.type, pending.index);
+    }
+    frame.pending_destroys.clear();
+    frame.command_lists_used = 0;
+}
+
+void RenderContext::_destroy_now(_ResourceType type, uint32_t index) {
+    switch (type) {
+        case _RESOURCE_BUFFER:
+            _device->destroy_buffer(index);
+            _release(_buffers, index);
+            break;
+        case _RESOURCE_TEXTURE:
+            _device->destroy_texture(index);
+            _release(_textures, index);
+            break;
+        case _RESOURCE_SAMPLER:
+            _device->destroy_sampler(index);
+            _release(_samplers, index);
+            break;
+        case _RESOURCE_SHADER:
+            _device->destroy_shader(index);
+            _release(_shaders, index);
+            break;
+        case _RESOURCE_PIPELINE:
+            _device->destroy_pipeline(index);
+            _release(_pipelines, index);
+            break;
+    }
+}
+
+void RenderContext::_destroy_device() {
+    _device->shutdown();
+    switch (_backend) {
+        case RENDER_BACKEND_NULL:
+            memory::destroy(MEMORY_TAG_RENDER, static_cast<NullRenderDevice*>(_device));
+            break;
+#if KY_RHI_VULKAN_ENABLED
+        case RENDER_BACKEND_VULKAN:
+            memory::destroy(MEMORY_TAG_RENDER, static_cast<VulkanRenderDevice*>(_device));
+            break;
+#endif
+        default:
+            break;
+    }
+    _device = nullptr;
+}
+
+BufferHandle RenderContext::create_buffer(const BufferDesc& desc, const void* data) {
+    KY_ERROR_CONDITION_MSG_RETURN(desc.size > 0, BufferHandle(), "Buffers can't be empty");
+    BufferHandle buffer;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        buffer = _allocate<BufferHandle>(_buffers, desc);
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(buffer.valid(), buffer,
+                                  "Out of buffers, see KY_RHI_MAX_BUFFERS");
+
+    // Backends create resources of different slots concurrently, so slow creation doesn't hold
+    // up other threads
+    if (!_device->create_buffer(buffer.index, desc, data)) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _release(_buffers, buffer.index);
+        return BufferHandle();
+    }
+    return buffer;
+}
+
+TextureHandle RenderContext::create_texture(const TextureDesc& desc, const void* data) {
+    KY_ERROR_CONDITION_MSG_RETURN(desc.format != TEXTURE_FORMAT_UNDEFINED, TextureHandle(),
+                                  "Textures need a format");
+    KY_ERROR_CONDITION_MSG_RETURN(desc.width > 0 && desc.height > 0 && desc.depth > 0 &&
+                                      desc.mip_levels > 0 && desc.array_layers > 0,
+                                  TextureHandle(), "Textures can't be empty");
+    TextureHandle texture;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        texture = _allocate<TextureHandle>(_textures, desc);
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(texture.valid(), texture,
+                                  "Out of textures, see KY_RHI_MAX_TEXTURES");
+    if (!_device->create_texture(texture.index, desc, data)) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _release(_textures, texture.index);
+        return TextureHandle();
+    }
+    return texture;
+}
+
+SamplerHandle RenderContext::create_sampler(const SamplerDesc& desc) {
+    SamplerHandle sampler;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        sampler = _allocate<SamplerHandle>(_samplers, desc);
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(sampler.valid(), sampler,
+                                  "Out of samplers, see KY_RHI_MAX_SAMPLERS");
+    if (!_device->create_sampler(sampler.index, desc)) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _release(_samplers, sampler.index);
+        return SamplerHandle();
+    }
+    return sampler;
+}
+
+ShaderHandle RenderContext::create_shader(const ShaderDesc& desc) {
+    KY_ERROR_CONDITION_MSG_RETURN(desc.code != nullptr && desc.code_size > 0, ShaderHandle(),
+                                  "Shaders need SPIR-V code");
+    ShaderHandle shader;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        shader = _allocate<ShaderHandle>(_shaders, desc);
+        if (shader.valid()) {
+            // The code is only borrowed during creation
+            _shaders.descs[shader.index].code = nullptr;
+            _shaders.descs[shader.index].entry_point = nullptr;
+        }
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(shader.valid(), shader,
+                                  "Out of shaders, see KY_RHI_MAX_SHADERS");
+    if (!_device->create_shader(shader.index, desc)) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _release(_shaders, shader.index);
+        return ShaderHandle();
+    }
+    return shader;
+}
+
+PipelineHandle RenderContext::create_pipeline(const PipelineDesc& desc) {
+    bool compute = desc.compute_shader.valid();
+    KY_ERROR_CONDITION_MSG_RETURN(compute || desc.vertex_shader.valid(), PipelineHandle(),
+                                  "Pipelines need a vertex or compute shader");
+    KY_ERROR_CONDITION_MSG_RETURN(desc.color_count <= KY_RHI_MAX_COLOR_ATTACHMENTS &&
+                                      desc.vertex_binding_count <= KY_RHI_MAX_VERTEX_BUFFERS &&
+                                      desc.vertex_attribute_count <=
+                                          KY_RHI_MAX_VERTEX_ATTRIBUTES,
+                                  PipelineHandle(), "Pipeline exceeds the RHI limits");
+    KY_ERROR_CONDITION_MSG_RETURN(
+        alive(compute ? desc.compute_shader : desc.vertex_shader) &&
+            (!desc.fragment_shader.valid() || alive(desc.fragment_shader)),
+        PipelineHandle(), "Pipeline shaders have to be alive");
+    PipelineHandle pipeline;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        pipeline = _allocate<PipelineHandle>(_pipelines, desc);
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(pipeline.valid(), pipeline,
+                                  "Out of pipelines, see KY_RHI_MAX_PIPELINES");
+    if (!_device->create_pipeline(pipeline.index, desc)) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _release(_pipelines, pipeline.index);
+        return PipelineHandle();
+    }
+    return pipeline;
+}
+
+void RenderContext::destroy(BufferHandle buffer) {
+    _destroy(_buffers, _RESOURCE_BUFFER, buffer);
+}
+
+void RenderContext::destroy(TextureHandle texture) {
+    KY_ERROR_CONDITION_MSG(texture != _swapchain, "The swapchain texture can't be destroyed");
+    _destroy(_textures, _RESOURCE_TEXTURE, texture);
+}
+
+void RenderContext::destroy(SamplerHandle sampler) {
+    _destroy(_samplers, _RESOURCE_SAMPLER, sampler);
+}
+
+void RenderContext::destroy(ShaderHandle shader) {
+    _destroy(_shaders, _RESOURCE_SHADER, shader);
+}
+
+void RenderContext::destroy(PipelineHandle pipeline) {
+    _destroy(_pipelines, _RESOURCE_PIPELINE, pipeline);
+}
+
+// Generations and the used count change under the lock when other threads create or release
+// resources, so checks take it too
+bool RenderContext::alive(BufferHandle buffer) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _alive(_buffers, buffer);
+}
+
+bool RenderContext::alive(TextureHandle texture) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _alive(_textures, texture);
+}
+
+bool RenderContext::alive(SamplerHandle sampler) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _alive(_samplers, sampler);
+}
+
+bool RenderContext::alive(ShaderHandle shader) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _alive(_shaders, shader);
+}
+
+bool RenderContext::alive(PipelineHandle pipeline) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _alive(_pipelines, pipeline);
+}
+
+bool RenderContext::usable(BufferHandle buffer) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _usable(_buffers, buffer);
+}
+
+bool RenderContext::usable(TextureHandle texture) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _usable(_textures, texture);
+}
+
+bool RenderContext::usable(SamplerHandle sampler) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _usable(_samplers, sampler);
+}
+
+bool RenderContext::usable(PipelineHandle pipeline) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _usable(_pipelines, pipeline);
+}
+
+uint8_t* RenderContext::mapped_data(BufferHandle buffer) {
+    KY_ERROR_CONDITION_MSG_RETURN(alive(buffer), nullptr, "Buffer isn't alive");
+    return _device->mapped_data(buffer.index);
+}
+
+bool RenderContext::save_pipeline_cache() {
+    KY_ERROR_CONDITION_MSG_RETURN(!_pipeline_cache_path.empty(), false,
+                                  "The context was initialized without a pipeline cache path");
+    TaggedVector<uint8_t, MEMORY_TAG_RENDER> data;
+    if (!_device->save_pipeline_cache(data)) {
+        return false;
+    }
+    return write_pipeline_cache_file(_pipeline_cache_path.c_str(), _backend,
+                                     _device->pipeline_cache_id(), data.data(), data.size());
+}
+
+UploadAllocation RenderContext::upload(const void* data, uint64_t size, uint64_t alignment) {
+    UploadAllocation allocation = _upload_ring.allocate(size, alignment);
+    if (allocation.valid()) {
+        std::memcpy(allocation.data, data, size);
+    }
+    return allocation;
+}
+
+GpuMemoryStats RenderContext::memory_stats() const {
+    return _device->memory_stats();
+}
+
+uint32_t RenderContext::defragment(uint32_t max_moves, uint64_t max_bytes) {
+    KY_PROFILE_SCOPE("RenderContext::defragment");
+    return _device->defragment(max_moves, max_bytes);
+}
+
+bool RenderContext::begin_frame() {
+    KY_PROFILE_SCOPE("RenderContext::begin_frame");
+    _frame_number++;
+    uint32_t slot = frame_slot();
+    _device->wait_frame(slot);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _release_frame(_frames[slot]);
+    }
+    _upload_ring.begin_frame(_frame_number, slot);
+    if (!_device->begin_frame(_frame_number, slot)) {
+        return false;
+    }
+    // The swapchain is recreated when the window is resized
+    if (_swapchain.valid()) {
+        _device->swapchain_desc(_textures.descs[_swapchain.index]);
+    }
+    return true;
+}
+
+CommandList* RenderContext::command_list() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _Frame& frame = _frames[frame_slot()];
+    if (frame.command_lists_used == frame.command_lists.size()) {
+        frame.command_lists.push_back(memory::create<CommandList>(MEMORY_TAG_RENDER));
+    }
+    CommandList* list = frame.command_lists[frame.command_lists_used++];
+    list->reset();
+    return list;
+}
+
+void RenderContext::submit(CommandList* const* lists, uint32_t count) {
+    KY_PROFILE_SCOPE("RenderContext::submit");
+    _device->submit(lists, count);
+}
+
+void RenderContext::end_frame() {
+    KY_PROFILE_SCOPE("RenderContext::end_frame");
+    _device->end_frame();
+}
+
+void RenderContext::wait_idle() {
+    _device->wait_idle();
+}
+
+uint64_t RenderContext::completed_frame() const {
+    return _device->completed_frame();
+}
+
+} // namespace ky
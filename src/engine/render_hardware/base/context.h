@@ -0,0 +1,278 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_RENDER_HARDWARE_BASE__CONTEXT_H
+#define KRYOS_RENDER_HARDWARE_BASE__CONTEXT_H
+
+#include "core/jobs.h"
+#include "core/memory_tracker.h"
+#include "core/window.h"
+#include "render_hardware/base/command_list.h"
+#include "render_hardware/base/device.h"
+#include "render_hardware/base/resources.h"
+#include "render_hardware/base/shader.h"
+#include "render_hardware/base/upload_ring.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace ky {
+
+struct RenderContextDesc {
+    // Null until the Vulkan backend is verified on a GPU, see `KY_RHI_VULKAN_ENABLED`
+    RenderBackend backend = RENDER_BACKEND_NULL;
+    // Window presented to, without one the context only renders offscreen
+    WindowHandle window;
+    bool vsync = true;
+    // Enables the Vulkan validation layers, the null backend always validates
+    bool validation = false;
+    const char* application_name = "Kryos Engine";
+    // File the backend's pipeline cache is loaded from by `init` and saved to by `shutdown`, so
+    // pipelines created in earlier runs build faster. Null disables persisting it.
+    const char* pipeline_cache_path = nullptr;
+    // Bytes of transient upload memory per frame in flight, size it to the high water mark of
+    // `RenderContext::upload_stats`
+    uint64_t upload_ring_size = KY_RHI_UPLOAD_RING_SIZE;
+};
+
+// Owns the GPU resources of a backend and paces frames. Resources are referred to by generational
+// handles and can be created and destroyed from any thread, destruction is deferred until the
+// frames that could still use the resource finished on the GPU.
+//
+// Each frame command lists are taken with `command_list` and recorded in parallel, then handed to
+// `submit` from the frame thread in the order they execute in:
+//
+//     context.begin_frame();
+//     CommandList* list = context.command_list();
+//     list->begin_render_pass(pass);
+//     ...
+//     context.submit(list);
+//     context.end_frame();
+class RenderContext {
+public:
+    RenderContext() = default;
+    ~RenderContext();
+
+    RenderContext(const RenderContext&) = delete;
+    RenderContext& operator=(const RenderContext&) = delete;
+
+    bool init(const RenderContextDesc& desc);
+    void shutdown();
+    inline bool is_initialized() const { return _device != nullptr; }
+    inline RenderBackend backend() const { return _backend; }
+    inline RenderDevice& device() { return *_device; }
+
+    // Invalid handles on failure. The initial `data` of textures holds every mip of every layer
+    // tightly packed, textures created with data start out in `RESOURCE_STATE_SHADER_READ`, all
+    // other resources in `RESOURCE_STATE_UNDEFINED`.
+    BufferHandle create_buffer(const BufferDesc& desc, const void* data = nullptr);
+    TextureHandle create_texture(const TextureDesc& desc, const void* data = nullptr);
+    SamplerHandle create_sampler(const SamplerDesc& desc);
+    ShaderHandle create_shader(const ShaderDesc& desc);
+    PipelineHandle create_pipeline(const PipelineDesc& desc);
+
+    void destroy(BufferHandle buffer);
+    void destroy(TextureHandle texture);
+    void destroy(SamplerHandle sampler);
+    void destroy(ShaderHandle shader);
+    void destroy(PipelineHandle pipeline);
+
+    // Safe to call from any thread, resources created or destroyed concurrently are seen either
+    // before or after the change.
+    bool alive(BufferHandle buffer) const;
+    bool alive(TextureHandle texture) const;
+    bool alive(SamplerHandle sampler) const;
+    bool alive(ShaderHandle shader) const;
+    bool alive(PipelineHandle pipeline) const;
+
+    // Whether commands may still reference the resource, it's alive or was destroyed but isn't
+    // released yet. Used by backends to validate submitted commands.
+    bool usable(BufferHandle buffer) const;
+    bool usable(TextureHandle texture) const;
+    bool usable(SamplerHandle sampler) const;
+    bool usable(PipelineHandle pipeline) const;
+
+    // Descriptions resources were created with, the handles have to be alive. Debug names aren't
+    // kept. Not locked, the storage is allocated up front and a slot is only written while its
+    // resource is created, before the handle is returned. The swapchain texture's description
+    // is the exception, `begin_frame` updates it when the window was resized.
+    inline const BufferDesc& desc(BufferHandle buffer) const {
+        return _buffers.descs[buffer.index];
+    }
+    inline const TextureDesc& desc(TextureHandle texture) const {
+        return _textures.descs[texture.index];
+    }
+    inline const PipelineDesc& desc(PipelineHandle pipeline) const {
+        return _pipelines.descs[pipeline.index];
+    }
+
+    // Persistent mapping of an upload or readback buffer, null for GPU only buffers.
+    uint8_t* mapped_data(BufferHandle buffer);
+
+    // Memory for data the GPU reads during the current frame only, e.g. per draw uniforms or
+    // generated vertices, valid until this frame's slot is reused. Safe to call from any thread
+    // while the frame is recorded, and cheapest on job system threads.
+    inline UploadAllocation upload(uint64_t size, uint64_t alignment = KY_RHI_UPLOAD_ALIGNMENT) {
+        return _upload_ring.allocate(size, alignment);
+    }
+    UploadAllocation upload(const void* data, uint64_t size,
+                            uint64_t alignment = KY_RHI_UPLOAD_ALIGNMENT);
+    inline UploadRingStats upload_stats() const { return _upload_ring.stats(); }
+
+    // Writes the pipeline cache to `RenderContextDesc::pipeline_cache_path` before shutdown,
+    // e.g. once loading finished so a crash later on doesn't lose it.
+    bool save_pipeline_cache();
+
+    // Usage and fragmentation of the GPU memory blocks resources are sub-allocated from.
+    GpuMemoryStats memory_stats() const;
+    // Incremental defragmentation, moves up to `max_moves` resources totalling at most
+    // `max_bytes` out of sparsely used memory blocks so they can be freed. Resources keep their
+    // handles. Call right after `begin_frame`, before any list of the frame is submitted. Returns
+    // how many resources moved.
+    uint32_t defragment(uint32_t max_moves, uint64_t max_bytes);
+
+    // Waits until the GPU finished the frame that last used this frame's slot, then releases the
+    // resources and command lists of that frame. False when nothing can be rendered, the frame
+    // then has to be skipped without calling `end_frame`.
+    bool begin_frame();
+    // Empty command list valid until this frame's slot is reused, safe to call from any thread.
+    CommandList* command_list();
+    // Hands lists to the GPU in array order. Only the thread driving the frame submits.
+    void submit(CommandList* const* lists, uint32_t count);
+    inline void submit(CommandList* list) { submit(&list, 1); }
+    void end_frame();
+    void wait_idle();
+
+    // Frame being recorded, counting from 1 after the first `begin_frame`.
+    inline uint64_t frame_number() const { return _frame_number; }
+    inline uint32_t frame_slot() const {
+        return (uint32_t)(_frame_number % KY_RHI_FRAMES_IN_FLIGHT);
+    }
+    // Latest frame the GPU finished.
+    uint64_t completed_frame() const;
+
+    // Texture standing for the swapchain image acquired by `begin_frame`, invalid without a
+    // window. Render into it and transition it to `RESOURCE_STATE_PRESENT` before `end_frame`.
+    inline TextureHandle swapchain_texture() const { return _swapchain; }
+
+    // Records a render pass over `count` items on the job system, split into chunks of
+    // `chunk_size` items that each get their own command list. `body(CommandList& list, size_t
+    // begin, size_t end)` records the draws of a chunk in between the pass being begun and ended,
+    // with no state bound yet. The lists are appended to `lists` in chunk order and have to be
+    // submitted together.
+    template <typename _Body>
+    void record_parallel(const RenderPassDesc& pass, size_t count, size_t chunk_size,
+                         TaggedVector<CommandList*, MEMORY_TAG_RENDER>& lists, _Body&& body);
+
+private:
+    enum _ResourceType {
+        _RESOURCE_BUFFER,
+        _RESOURCE_TEXTURE,
+        _RESOURCE_SAMPLER,
+        _RESOURCE_SHADER,
+        _RESOURCE_PIPELINE,
+    };
+
+    // Slots of one resource type, indices are handed out from the free list first. Storage is
+    // allocated up front so backends can read it while other threads create resources.
+    template <typename _Desc>
+    struct _Pool {
+        TaggedVector<_Desc, MEMORY_TAG_RENDER> descs;
+        TaggedVector<uint32_t, MEMORY_TAG_RENDER> generations;
+        TaggedVector<uint8_t, MEMORY_TAG_RENDER> alive;
+        TaggedVector<uint32_t, MEMORY_TAG_RENDER> free;
+        uint32_t used = 0;
+    };
+
+    struct _PendingDestroy {
+        _ResourceType type;
+        uint32_t index;
+    };
+
+    struct _Frame {
+        TaggedVector<CommandList*, MEMORY_TAG_RENDER> command_lists;
+        uint32_t command_lists_used = 0;
+        TaggedVector<_PendingDestroy, MEMORY_TAG_RENDER> pending_destroys;
+    };
+
+    RenderDevice* _device = nullptr;
+    RenderBackend _backend = RENDER_BACKEND_NULL;
+
+    // Guards the pools and the frames' pending destroys and command lists
+    mutable std::mutex _mutex;
+    _Pool<BufferDesc> _buffers;
+    _Pool<TextureDesc> _textures;
+    _Pool<SamplerDesc> _samplers;
+    _Pool<ShaderDesc> _shaders;
+    _Pool<PipelineDesc> _pipelines;
+    _Frame _frames[KY_RHI_FRAMES_IN_FLIGHT];
+
+    uint64_t _frame_number = 0;
+    TextureHandle _swapchain;
+    std::string _pipeline_cache_path;
+    UploadRing _upload_ring;
+
+    template <typename _Desc>
+    static void _init_pool(_Pool<_Desc>& pool, uint32_t capacity);
+    template <typename _Handle, typename _Desc>
+    static _Handle _allocate(_Pool<_Desc>& pool, const _Desc& desc);
+    template <typename _Handle, typename _Desc>
+    static bool _alive(const _Pool<_Desc>& pool, _Handle handle);
+    template <typename _Handle, typename _Desc>
+    static bool _usable(const _Pool<_Desc>& pool, _Handle handle);
+    template <typename _Desc>
+    static void _release(_Pool<_Desc>& pool, uint32_t index);
+
+    template <typename _Handle, typename _Desc>
+    void _destroy(_Pool<_Desc>& pool, _ResourceType type, _Handle handle);
+    void _release_frame(_Frame& frame);
+    void _destroy_now(_ResourceType type, uint32_t index);
+    void _destroy_device();
+};
+
+template <typename _Body>
+void RenderContext::record_parallel(const RenderPassDesc& pass, size_t count, size_t chunk_size,
+                                    TaggedVector<CommandList*, MEMORY_TAG_RENDER>& lists,
+                                    _Body&& body) {
+    chunk_size = std::max(chunk_size, (size_t)1);
+    size_t chunk_count = std::max((count + chunk_size - 1) / chunk_size, (size_t)1);
+    size_t first = lists.size();
+    for (size_t i = 0; i < chunk_count; i++) {
+        lists.push_back(command_list());
+    }
+
+    // Every chunk records the same pass, suspended at the end of its list and resumed by the next
+    // one's, so the backend sees a single pass
+    CommandList** chunk_lists = lists.data() + first;
+    JobSystem::parallel_for(chunk_count, [&](size_t chunk) {
+        RenderPassDesc chunk_pass = pass;
+        if (chunk > 0) {
+            chunk_pass.flags |= RENDER_PASS_RESUME_BIT;
+        }
+        if (chunk + 1 < chunk_count) {
+            chunk_pass.flags |= RENDER_PASS_SUSPEND_BIT;
+        }
+        CommandList& list = *chunk_lists[chunk];
+        list.begin_render_pass(chunk_pass);
+        body(list, chunk * chunk_size, std::min(count, (chunk + 1) * chunk_size));
+        list.end_render_pass();
+    });
+}
+
+} // namespace ky
+
+#endif
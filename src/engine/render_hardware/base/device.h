@@ -0,0 +1,102 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_RENDER_HARDWARE_BASE__DEVICE_H
+#define KRYOS_RENDER_HARDWARE_BASE__DEVICE_H
+
+#include "core/memory_tracker.h"
+#include "render_hardware/base/command_list.h"
+#include "render_hardware/base/gpu_allocator.h"
+#include "render_hardware/base/resources.h"
+#include "render_hardware/base/shader.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Frames the CPU records ahead of the GPU. Resources destroyed and command lists used in a frame
+// are only released once the GPU finished it.
+#ifndef KY_RHI_FRAMES_IN_FLIGHT
+#    define KY_RHI_FRAMES_IN_FLIGHT 2
+#endif
+
+namespace ky {
+
+class RenderContext;
+struct RenderContextDesc;
+
+// Implemented by each backend. `RenderContext` owns handle allocation, deferred destruction and
+// frame pacing, so backends only deal with the slot indices of live resources and can keep their
+// objects in arrays of `KY_RHI_MAX_*` entries indexed by them.
+//
+// Resources can be created on several threads at once, each with its own index, and destroyed
+// while others are created. `submit` and the frame functions are only called from the thread
+// driving the frame.
+class RenderDevice {
+public:
+    virtual ~RenderDevice() = default;
+
+    virtual bool init(RenderContext& context, const RenderContextDesc& desc) = 0;
+    virtual void shutdown() = 0;
+
+    // `data` is the initial contents of the buffer or of every subresource of the texture, tightly
+    // packed mip after mip for each layer, and may be null.
+    virtual bool create_buffer(uint32_t index, const BufferDesc& desc, const void* data) = 0;
+    virtual bool create_texture(uint32_t index, const TextureDesc& desc, const void* data) = 0;
+    virtual bool create_sampler(uint32_t index, const SamplerDesc& desc) = 0;
+    virtual bool create_shader(uint32_t index, const ShaderDesc& desc) = 0;
+    virtual bool create_pipeline(uint32_t index, const PipelineDesc& desc) = 0;
+    virtual void destroy_buffer(uint32_t index) = 0;
+    virtual void destroy_texture(uint32_t index) = 0;
+    virtual void destroy_sampler(uint32_t index) = 0;
+    virtual void destroy_shader(uint32_t index) = 0;
+    virtual void destroy_pipeline(uint32_t index) = 0;
+
+    // Persistent mapping of upload and readback buffers, null for GPU only buffers.
+    virtual uint8_t* mapped_data(uint32_t buffer) = 0;
+
+    // Blocks until the GPU finished the last frame recorded in `slot`.
+    virtual void wait_frame(uint32_t slot) = 0;
+    // False when nothing can be rendered this frame, e.g. while the window is minimized.
+    virtual bool begin_frame(uint64_t frame_number, uint32_t slot) = 0;
+    virtual void submit(CommandList* const* lists, uint32_t count) = 0;
+    virtual void end_frame() = 0;
+    virtual void wait_idle() = 0;
+    // Latest frame number the GPU finished.
+    virtual uint64_t completed_frame() = 0;
+
+    // Description of the swapchain images, false when the device doesn't present. The context
+    // registers a texture standing for the current image with `set_swapchain_texture`.
+    virtual bool swapchain_desc(TextureDesc& desc) = 0;
+    virtual void set_swapchain_texture(uint32_t index) = 0;
+
+    // Pipeline cache blobs persisted between runs. `pipeline_cache_id` identifies what a blob is
+    // valid for, e.g. the GPU and driver version, blobs saved under another id are discarded
+    // without reaching the backend. `load_pipeline_cache` is only called before any pipeline is
+    // created and may still reject the blob.
+    virtual uint64_t pipeline_cache_id() = 0;
+    virtual bool load_pipeline_cache(const void* data, size_t size) = 0;
+    virtual bool save_pipeline_cache(TaggedVector<uint8_t, MEMORY_TAG_RENDER>& data) = 0;
+
+    // Usage of the memory blocks resources are sub-allocated from.
+    virtual GpuMemoryStats memory_stats() = 0;
+    // Moves up to `max_moves` resources totalling at most `max_bytes` out of sparsely used memory
+    // blocks so they can be freed, returns how many moved. Only called after `begin_frame`
+    // before the frame's first `submit`.
+    virtual uint32_t defragment(uint32_t max_moves, uint64_t max_bytes) = 0;
+};
+
+} // namespace ky
+
+#endif
@@ -0,0 +1,638 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "render_hardware/base/gpu_allocator.h"
+
+#include "core/bits.h"
+#include "core/error.h"
+#include "core/memory.h"
+#include "core/profiler.h"
+
+#include <algorithm>
+
+namespace ky {
+
+static inline bool is_power_of_two(uint64_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+void TlsfAllocator::init(uint64_t size, uint64_t granularity) {
+    KY_ERROR_CONDITION_MSG(is_power_of_two(granularity), "Granularity must be a power of two");
+    _size = size & ~(uint64_t)(KY_GPU_ALLOCATOR_MIN_ALIGNMENT - 1);
+    _granularity = granularity;
+    _used = 0;
+    _allocation_count = 0;
+    _free_count = 0;
+    _nodes.clear();
+    _unused_nodes.clear();
+    _fl_bitmap = 0;
+    std::fill(std::begin(_sl_bitmaps), std::end(_sl_bitmaps), 0);
+    std::fill(&_heads[0][0], &_heads[0][0] + _FL_COUNT * _SL_COUNT, KY_GPU_ALLOCATOR_INVALID);
+
+    _first = _new_node();
+    _nodes[_first].size = _size;
+    if (_size > 0) {
+        _insert_free(_first);
+    }
+}
+
+// Sizes below 32 get a class each, larger ones a class per 1/32 of their power of two
+void TlsfAllocator::_mapping(uint64_t size, uint32_t& fl, uint32_t& sl) {
+    if (size < _SL_COUNT) {
+        fl = 0;
+        sl = (uint32_t)size;
+    } else {
+        uint32_t msb = most_significant_bit(size);
+        fl = msb - _SL_LOG2 + 1;
+        sl = (uint32_t)(size >> (msb - _SL_LOG2)) ^ _SL_COUNT;
+    }
+}
+
+uint32_t TlsfAllocator::_new_node() {
+    if (!_unused_nodes.empty()) {
+        uint32_t node = _unused_nodes.back();
+        _unused_nodes.pop_back();
+        _nodes[node] = _Node();
+        return node;
+    }
+    _nodes.emplace_back();
+    return (uint32_t)_nodes.size() - 1;
+}
+
+void TlsfAllocator::_insert_free(uint32_t node) {
+    uint32_t fl, sl;
+    _mapping(_nodes[node].size, fl, sl);
+    uint32_t head = _heads[fl][sl];
+    _nodes[node].prev_free = KY_GPU_ALLOCATOR_INVALID;
+    _nodes[node].next_free = head;
+    if (head != KY_GPU_ALLOCATOR_INVALID) {
+        _nodes[head].prev_free = node;
+    }
+    _heads[fl][sl] = node;
+    _sl_bitmaps[fl] |= 1u << sl;
+    _fl_bitmap |= 1ull << fl;
+    _free_count++;
+}
+
+void TlsfAllocator::_remove_free(uint32_t node) {
+    uint32_t fl, sl;
+    _mapping(_nodes[node].size, fl, sl);
+    _Node& entry = _nodes[node];
+    if (entry.prev_free != KY_GPU_ALLOCATOR_INVALID) {
+        _nodes[entry.prev_free].next_free = entry.next_free;
+    } else {
+        _heads[fl][sl] = entry.next_free;
+    }
+    if (entry.next_free != KY_GPU_ALLOCATOR_INVALID) {
+        _nodes[entry.next_free].prev_free = entry.prev_free;
+    }
+    if (_heads[fl][sl] == KY_GPU_ALLOCATOR_INVALID) {
+        _sl_bitmaps[fl] &= ~(1u << sl);
+        if (_sl_bitmaps[fl] == 0) {
+            _fl_bitmap &= ~(1ull << fl);
+        }
+    }
+    entry.prev_free = KY_GPU_ALLOCATOR_INVALID;
+    entry.next_free = KY_GPU_ALLOCATOR_INVALID;
+    _free_count--;
+}
+
+// Used regions sharing a granularity page all have the same kind. The neighbours of a free region
+// are used, so only they can share its first and last page with an allocation placed in it.
+bool TlsfAllocator::_fits(uint32_t node, uint64_t size, uint64_t alignment,
+                          GpuAllocationKind kind, uint64_t& offset) const {
+    const _Node& free_node = _nodes[node];
+    uint64_t start = align_up(free_node.offset, alignment);
+    if (_granularity > 1 && free_node.prev_physical != KY_GPU_ALLOCATOR_INVALID) {
+        const _Node& prev = _nodes[free_node.prev_physical];
+        uint64_t prev_page = (prev.offset + prev.size - 1) / _granularity;
+        if (prev.kind != kind && prev_page == start / _granularity) {
+            start = align_up(start, _granularity);
+        }
+    }
+    uint64_t end = start + size;
+    if (end > free_node.offset + free_node.size) {
+        return false;
+    }
+    if (_granularity > 1 && free_node.next_physical != KY_GPU_ALLOCATOR_INVALID) {
+        const _Node& next = _nodes[free_node.next_physical];
+        if (next.kind != kind && (end - 1) / _granularity == next.offset / _granularity) {
+            return false;
+        }
+    }
+    offset = start;
+    return true;
+}
+
+bool TlsfAllocator::allocate(uint64_t size, uint64_t alignment, GpuAllocationKind kind,
+                             uint64_t user_data, uint32_t& node, uint64_t& offset) {
+    KY_ERROR_CONDITION_MSG_RETURN(is_power_of_two(alignment), false,
+                                  "Alignment must be a power of two");
+    size = align_up(std::max<uint64_t>(size, 1), KY_GPU_ALLOCATOR_MIN_ALIGNMENT);
+    alignment = std::max<uint64_t>(alignment, KY_GPU_ALLOCATOR_MIN_ALIGNMENT);
+    // Free regions start at multiples of the minimum alignment
+    uint64_t search = size + alignment - KY_GPU_ALLOCATOR_MIN_ALIGNMENT;
+    if (search > _size) {
+        return false;
+    }
+
+    // Starts at the class above the request whose regions all fit it, falling back to the
+    // request's own class which may hold regions just large enough
+    uint32_t fl, sl;
+    uint64_t rounded = search;
+    if (search >= _SL_COUNT) {
+        rounded += (1ull << (most_significant_bit(search) - _SL_LOG2)) - 1;
+    }
+    _mapping(rounded, fl, sl);
+    uint32_t found = KY_GPU_ALLOCATOR_INVALID;
+    while (found == KY_GPU_ALLOCATOR_INVALID && fl < _FL_COUNT) {
+        uint32_t sl_map = sl < _SL_COUNT ? _sl_bitmaps[fl] & (~0u << sl) : 0;
+        if (sl_map == 0) {
+            uint64_t fl_map = fl + 1 < 64 ? _fl_bitmap & (~0ull << (fl + 1)) : 0;
+            if (fl_map == 0) {
+                break;
+            }
+            fl = count_trailing_zeros(fl_map);
+            sl_map = _sl_bitmaps[fl];
+        }
+        sl = count_trailing_zeros(sl_map);
+        for (uint32_t candidate = _heads[fl][sl]; candidate != KY_GPU_ALLOCATOR_INVALID;
+             candidate = _nodes[candidate].next_free) {
+            if (_fits(candidate, size, alignment, kind, offset)) {
+                found = candidate;
+                break;
+            }
+        }
+        sl++;
+    }
+    if (found == KY_GPU_ALLOCATOR_INVALID) {
+        _mapping(search, fl, sl);
+        for (uint32_t candidate = _heads[fl][sl]; candidate != KY_GPU_ALLOCATOR_INVALID;
+             candidate = _nodes[candidate].next_free) {
+            if (_fits(candidate, size, alignment, kind, offset)) {
+                found = candidate;
+                break;
+            }
+        }
+    }
+    if (found == KY_GPU_ALLOCATOR_INVALID) {
+        return false;
+    }
+
+    _remove_free(found);
+    if (offset > _nodes[found].offset) {
+        uint32_t front = _new_node();
+        _Node& region = _nodes[found];
+        _nodes[front].offset = region.offset;
+        _nodes[front].size = offset - region.offset;
+        _nodes[front].prev_physical = region.prev_physical;
+        _nodes[front].next_physical = found;
+        if (region.prev_physical != KY_GPU_ALLOCATOR_INVALID) {
+            _nodes[region.prev_physical].next_physical = front;
+        } else {
+            _first = front;
+        }
+        region.prev_physical = front;
+        region.offset = offset;
+        region.size -= _nodes[front].size;
+        _insert_free(front);
+    }
+    if (_nodes[found].size > size) {
+        uint32_t back = _new_node();
+        _Node& region = _nodes[found];
+        _nodes[back].offset = offset + size;
+        _nodes[back].size = region.size - size;
+        _nodes[back].prev_physical = found;
+        _nodes[back].next_physical = region.next_physical;
+        if (region.next_physical != KY_GPU_ALLOCATOR_INVALID) {
+            _nodes[region.next_physical].prev_physical = back;
+        }
+        region.next_physical = back;
+        region.size = size;
+        _insert_free(back);
+    }
+
+    _Node& region = _nodes[found];
+    region.used = true;
+    region.kind = kind;
+    region.user_data = user_data;
+    region.alignment_log2 = (uint8_t)most_significant_bit(alignment);
+    _used += size;
+    _allocation_count++;
+    node = found;
+    return true;
+}
+
+void TlsfAllocator::free(uint32_t node) {
+    KY_ERROR_FAIL_INDEX(node, _nodes.size());
+    KY_ERROR_CONDITION_MSG(_nodes[node].used, "Allocation was already freed");
+    _Node& region = _nodes[node];
+    region.used = false;
+    region.user_data = 0;
+    _used -= region.size;
+    _allocation_count--;
+
+    uint32_t next = region.next_physical;
+    if (next != KY_GPU_ALLOCATOR_INVALID && !_nodes[next].used) {
+        _remove_free(next);
+        region.size += _nodes[next].size;
+        region.next_physical = _nodes[next].next_physical;
+        if (region.next_physical != KY_GPU_ALLOCATOR_INVALID) {
+            _nodes[region.next_physical].prev_physical = node;
+        }
+        _unused_nodes.push_back(next);
+    }
+    uint32_t prev = region.prev_physical;
+    if (prev != KY_GPU_ALLOCATOR_INVALID && !_nodes[prev].used) {
+        _remove_free(prev);
+        _nodes[prev].size += region.size;
+        _nodes[prev].next_physical = region.next_physical;
+        if (region.next_physical != KY_GPU_ALLOCATOR_INVALID) {
+            _nodes[region.next_physical].prev_physical = prev;
+        }
+        _unused_nodes.push_back(node);
+        node = prev;
+    }
+    _insert_free(node);
+}
+
+TlsfStats TlsfAllocator::stats() const {
+    TlsfStats stats;
+    stats.used_bytes = _used;
+    stats.allocations = _allocation_count;
+    stats.free_regions = _free_count;
+    if (_fl_bitmap != 0) {
+        uint32_t fl = most_significant_bit(_fl_bitmap);
+        uint32_t sl = most_significant_bit(_sl_bitmaps[fl]);
+        for (uint32_t node = _heads[fl][sl]; node != KY_GPU_ALLOCATOR_INVALID;
+             node = _nodes[node].next_free) {
+            stats.largest_free_region = std::max(stats.largest_free_region, _nodes[node].size);
+        }
+    }
+    return stats;
+}
+
+bool TlsfAllocator::validate() const {
+    uint64_t expected_offset = 0;
+    uint64_t used = 0;
+    uint32_t allocations = 0;
+    uint32_t free_regions = 0;
+    uint32_t prev = KY_GPU_ALLOCATOR_INVALID;
+    uint32_t prev_used = KY_GPU_ALLOCATOR_INVALID;
+    for (uint32_t node = _first; node != KY_GPU_ALLOCATOR_INVALID;
+         node = _nodes[node].next_physical) {
+        const _Node& region = _nodes[node];
+        KY_ERROR_CONDITION_MSG_RETURN(region.offset == expected_offset, false,
+                                      "Regions aren't contiguous");
+        KY_ERROR_CONDITION_MSG_RETURN(region.prev_physical == prev, false,
+                                      "Physical links are inconsistent");
+        KY_ERROR_CONDITION_MSG_RETURN(region.size > 0, false, "Region is empty");
+        if (region.used) {
+            KY_ERROR_CONDITION_MSG_RETURN(region.offset % (1ull << region.alignment_log2) == 0,
+                                          false, "Allocation is misaligned");
+            if (prev_used != KY_GPU_ALLOCATOR_INVALID) {
+                const _Node& other = _nodes[prev_used];
+                bool shared = (other.offset + other.size - 1) / _granularity ==
+                              region.offset / _granularity;
+                KY_ERROR_CONDITION_MSG_RETURN(!shared || other.kind == region.kind, false,
+                                              "Allocations of different kinds share a page");
+            }
+            used += region.size;
+            allocations++;
+            prev_used = node;
+        } else {
+            KY_ERROR_CONDITION_MSG_RETURN(
+                    prev == KY_GPU_ALLOCATOR_INVALID || _nodes[prev].used, false,
+                    "Neighbouring free regions weren't merged");
+            free_regions++;
+        }
+        expected_offset += region.size;
+        prev = node;
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(expected_offset == _size, false,
+                                  "Regions don't cover the range");
+    KY_ERROR_CONDITION_MSG_RETURN(used == _used && allocations == _allocation_count, false,
+                                  "Allocation counters are inconsistent");
+    KY_ERROR_CONDITION_MSG_RETURN(free_regions == _free_count, false,
+                                  "Free region counter is inconsistent");
+
+    uint32_t listed = 0;
+    for (uint32_t fl = 0; fl < _FL_COUNT; fl++) {
+        KY_ERROR_CONDITION_MSG_RETURN(((_fl_bitmap >> fl) & 1) == (_sl_bitmaps[fl] != 0), false,
+                                      "First level bitmap is inconsistent");
+        for (uint32_t sl = 0; sl < _SL_COUNT; sl++) {
+            bool listed_class = _heads[fl][sl] != KY_GPU_ALLOCATOR_INVALID;
+            KY_ERROR_CONDITION_MSG_RETURN(((_sl_bitmaps[fl] >> sl) & 1) == listed_class, false,
+                                          "Second level bitmap is inconsistent");
+            for (uint32_t node = _heads[fl][sl]; node != KY_GPU_ALLOCATOR_INVALID;
+                 node = _nodes[node].next_free) {
+                uint32_t node_fl, node_sl;
+                _mapping(_nodes[node].size, node_fl, node_sl);
+                KY_ERROR_CONDITION_MSG_RETURN(!_nodes[node].used, false, "Used region is listed");
+                KY_ERROR_CONDITION_MSG_RETURN(node_fl == fl && node_sl == sl, false,
+                                              "Free region is listed in the wrong class");
+                listed++;
+            }
+        }
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(listed == _free_count, false, "Free region isn't listed");
+    return true;
+}
+
+GpuAllocator::~GpuAllocator() {
+    shutdown();
+}
+
+bool GpuAllocator::init(const GpuAllocatorDesc& desc) {
+    KY_ERROR_CONDITION_MSG_RETURN(desc.allocate_block != nullptr && desc.free_block != nullptr,
+                                  false, "Block callbacks are required");
+    KY_ERROR_CONDITION_MSG_RETURN(is_power_of_two(desc.granularity), false,
+                                  "Granularity must be a power of two");
+    KY_ERROR_CONDITION_MSG_RETURN(desc.block_size >= KY_GPU_ALLOCATOR_MIN_ALIGNMENT * 2, false,
+                                  "Block size is too small");
+    shutdown();
+    std::lock_guard<std::mutex> lock(_mutex);
+    _desc = desc;
+    return true;
+}
+
+void GpuAllocator::shutdown() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint32_t leaked = 0;
+    for (uint32_t i = 0; i < _blocks.size(); i++) {
+        if (_blocks[i].memory_type == KY_GPU_ALLOCATOR_INVALID) {
+            continue;
+        }
+        if (_blocks[i].dedicated) {
+            leaked++;
+        } else {
+            leaked += _blocks[i].allocator->allocation_count();
+        }
+        _free_block(i);
+    }
+    if (leaked > 0) {
+        KY_WARNING_MSG("%u GPU allocations weren't freed before shutdown", leaked);
+    }
+    _blocks.clear();
+    _unused_blocks.clear();
+}
+
+uint32_t GpuAllocator::_add_block(uint32_t memory_type, uint64_t size, bool dedicated,
+                                  bool relocatable) {
+    GpuMemoryBlock memory;
+    if (!_desc.allocate_block(_desc.user_data, memory_type, size, memory)) {
+        return KY_GPU_ALLOCATOR_INVALID;
+    }
+    uint32_t block;
+    if (!_unused_blocks.empty()) {
+        block = _unused_blocks.back();
+        _unused_blocks.pop_back();
+    } else {
+        block = (uint32_t)_blocks.size();
+        _blocks.emplace_back();
+    }
+    _Block& entry = _blocks[block];
+    entry.memory = memory;
+    entry.size = size;
+    entry.memory_type = memory_type;
+    entry.dedicated = dedicated;
+    entry.relocatable = relocatable;
+    if (!dedicated) {
+        entry.allocator = memory::create<TlsfAllocator>(MEMORY_TAG_RENDER);
+        entry.allocator->init(size, _desc.granularity);
+    }
+    return block;
+}
+
+void GpuAllocator::_free_block(uint32_t block) {
+    _Block& entry = _blocks[block];
+    _desc.free_block(_desc.user_data, entry.memory_type, entry.memory);
+    memory::destroy(MEMORY_TAG_RENDER, entry.allocator);
+    entry = _Block();
+    _unused_blocks.push_back(block);
+}
+
+bool GpuAllocator::allocate(const GpuAllocationDesc& desc, GpuAllocation& allocation) {
+    KY_PROFILE_SCOPE("GpuAllocator::allocate");
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)desc.memory_type, (size_t)_desc.memory_type_count, false);
+    KY_ERROR_CONDITION_RETURN(desc.size > 0, false);
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint64_t size = align_up(desc.size, KY_GPU_ALLOCATOR_MIN_ALIGNMENT);
+
+    // Memory is allocated aligned for any resource, so a dedicated block needs no padding
+    if (size > _desc.block_size / 2) {
+        uint32_t block = _add_block(desc.memory_type, size, true, false);
+        if (block == KY_GPU_ALLOCATOR_INVALID) {
+            return false;
+        }
+        allocation = GpuAllocation();
+        allocation.memory_type = desc.memory_type;
+        allocation.block = block;
+        allocation.size = size;
+        return true;
+    }
+
+    allocation = GpuAllocation();
+    allocation.memory_type = desc.memory_type;
+    allocation.size = size;
+    bool relocatable = desc.user_data != 0;
+    for (uint32_t i = 0; i < _blocks.size(); i++) {
+        _Block& entry = _blocks[i];
+        if (entry.memory_type == desc.memory_type && entry.allocator != nullptr &&
+            entry.relocatable == relocatable &&
+            entry.allocator->allocate(size, desc.alignment, desc.kind, desc.user_data,
+                                      allocation.node, allocation.offset)) {
+            allocation.block = i;
+            return true;
+        }
+    }
+
+    uint32_t block = _add_block(desc.memory_type, _desc.block_size, false, relocatable);
+    if (block == KY_GPU_ALLOCATOR_INVALID) {
+        return false;
+    }
+    if (!_blocks[block].allocator->allocate(size, desc.alignment, desc.kind, desc.user_data,
+                                            allocation.node, allocation.offset)) {
+        KY_ERROR_MSG("Allocation of %llu bytes aligned to %llu doesn't fit a new block",
+                     (unsigned long long)size, (unsigned long long)desc.alignment);
+        _free_block(block);
+        return false;
+    }
+    allocation.block = block;
+    return true;
+}
+
+void GpuAllocator::free(const GpuAllocation& allocation) {
+    if (!allocation.valid()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    KY_ERROR_FAIL_INDEX((size_t)allocation.block, _blocks.size());
+    _Block& entry = _blocks[allocation.block];
+    KY_ERROR_CONDITION_MSG(entry.memory_type == allocation.memory_type,
+                           "Allocation's block was already freed");
+    if (entry.dedicated) {
+        _free_block(allocation.block);
+        return;
+    }
+    entry.allocator->free(allocation.node);
+    if (!entry.allocator->empty()) {
+        return;
+    }
+    for (uint32_t i = 0; i < _blocks.size(); i++) {
+        if (i != allocation.block && _blocks[i].memory_type == allocation.memory_type &&
+            _blocks[i].allocator != nullptr && _blocks[i].relocatable == entry.relocatable) {
+            _free_block(allocation.block);
+            return;
+        }
+    }
+}
+
+GpuMemoryBlock GpuAllocator::block(const GpuAllocation& allocation) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)allocation.block, _blocks.size(), GpuMemoryBlock());
+    return _blocks[allocation.block].memory;
+}
+
+uint8_t* GpuAllocator::mapped(const GpuAllocation& allocation) const {
+    GpuMemoryBlock memory = block(allocation);
+    return memory.mapped != nullptr ? memory.mapped + allocation.offset : nullptr;
+}
+
+void GpuAllocator::_add_stats(const _Block& block, GpuMemoryStats& stats, uint64_t& free_bytes,
+                              uint64_t& largest_free_bytes) const {
+    stats.block_bytes += block.size;
+    if (block.dedicated) {
+        stats.dedicated_blocks++;
+        stats.used_bytes += block.size;
+        stats.allocations++;
+        return;
+    }
+    TlsfStats tlsf = block.allocator->stats();
+    stats.blocks++;
+    stats.used_bytes += tlsf.used_bytes;
+    stats.allocations += tlsf.allocations;
+    stats.free_regions += tlsf.free_regions;
+    stats.largest_free_region = std::max(stats.largest_free_region, tlsf.largest_free_region);
+    free_bytes += block.size - tlsf.used_bytes;
+    largest_free_bytes += tlsf.largest_free_region;
+}
+
+void GpuAllocator::_finish_stats(GpuMemoryStats& stats, uint64_t free_bytes,
+                                 uint64_t largest_free_bytes) {
+    if (free_bytes > 0) {
+        stats.fragmentation = 1.0f - (float)((double)largest_free_bytes / (double)free_bytes);
+    }
+}
+
+GpuMemoryStats GpuAllocator::stats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    GpuMemoryStats stats;
+    uint64_t free_bytes = 0;
+    uint64_t largest_free_bytes = 0;
+    for (const _Block& block : _blocks) {
+        if (block.memory_type != KY_GPU_ALLOCATOR_INVALID) {
+            _add_stats(block, stats, free_bytes, largest_free_bytes);
+        }
+    }
+    _finish_stats(stats, free_bytes, largest_free_bytes);
+    return stats;
+}
+
+GpuMemoryStats GpuAllocator::stats(uint32_t memory_type) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    GpuMemoryStats stats;
+    uint64_t free_bytes = 0;
+    uint64_t largest_free_bytes = 0;
+    for (const _Block& block : _blocks) {
+        if (block.memory_type == memory_type) {
+            _add_stats(block, stats, free_bytes, largest_free_bytes);
+        }
+    }
+    _finish_stats(stats, free_bytes, largest_free_bytes);
+    return stats;
+}
+
+uint32_t GpuAllocator::defragment(uint32_t max_moves, uint64_t max_bytes,
+                                  TaggedVector<GpuDefragmentationMove, MEMORY_TAG_RENDER>& moves) {
+    KY_PROFILE_SCOPE("GpuAllocator::defragment");
+    std::lock_guard<std::mutex> lock(_mutex);
+    moves.clear();
+    uint64_t moved_bytes = 0;
+    TaggedVector<uint32_t, MEMORY_TAG_RENDER> candidates;
+    TaggedVector<uint8_t, MEMORY_TAG_RENDER> received(_blocks.size(), 0);
+
+    for (uint32_t type = 0; type < _desc.memory_type_count && moves.size() < max_moves; type++) {
+        candidates.clear();
+        for (uint32_t i = 0; i < _blocks.size(); i++) {
+            if (_blocks[i].memory_type == type && _blocks[i].relocatable) {
+                candidates.push_back(i);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+            return _blocks[a].allocator->used_bytes() < _blocks[b].allocator->used_bytes();
+        });
+
+        // Emptiest blocks first, each allocation into the fullest block with room
+        for (size_t source = 0; source + 1 < candidates.size(); source++) {
+            uint32_t source_block = candidates[source];
+            const TlsfAllocator& source_allocator = *_blocks[source_block].allocator;
+            if (received[source_block] || source_allocator.empty()) {
+                continue;
+            }
+            source_allocator.for_each([&](uint32_t node, uint64_t offset, uint64_t size) {
+                if (moves.size() >= max_moves || moved_bytes + size > max_bytes) {
+                    return;
+                }
+                uint64_t user_data = source_allocator.user_data(node);
+                GpuDefragmentationMove move;
+                move.user_data = user_data;
+                move.source.memory_type = type;
+                move.source.block = source_block;
+                move.source.node = node;
+                move.source.offset = offset;
+                move.source.size = size;
+                move.destination = move.source;
+                for (size_t destination = candidates.size() - 1; destination > source;
+                     destination--) {
+                    uint32_t destination_block = candidates[destination];
+                    if (_blocks[destination_block].allocator->allocate(
+                                size, source_allocator.alignment(node),
+                                source_allocator.kind(node), user_data, move.destination.node,
+                                move.destination.offset)) {
+                        move.destination.block = destination_block;
+                        received[destination_block] = 1;
+                        moves.push_back(move);
+                        moved_bytes += size;
+                        return;
+                    }
+                }
+            });
+        }
+    }
+    return (uint32_t)moves.size();
+}
+
+bool GpuAllocator::validate() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const _Block& block : _blocks) {
+        if (block.allocator != nullptr && !block.allocator->validate()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace ky
@@ -0,0 +1,264 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_RENDER_HARDWARE_BASE__GPU_ALLOCATOR_H
+#define KRYOS_RENDER_HARDWARE_BASE__GPU_ALLOCATOR_H
+
+#include "core/memory_tracker.h"
+
+#include <cstdint>
+#include <mutex>
+
+// Size of the memory blocks allocations are placed in. Allocations larger than half a block get
+// a dedicated block of their own.
+#ifndef KY_GPU_ALLOCATOR_BLOCK_SIZE
+#    define KY_GPU_ALLOCATOR_BLOCK_SIZE (64ull * 1024 * 1024)
+#endif
+
+// Smallest alignment and size granule of sub-allocations
+#define KY_GPU_ALLOCATOR_MIN_ALIGNMENT 16
+
+#define KY_GPU_ALLOCATOR_INVALID UINT32_MAX
+
+namespace ky {
+
+// Resources of different kinds can't share a page of the buffer-image granularity, e.g. Vulkan's
+// `bufferImageGranularity`. Buffers and linear images are linear, optimally tiled images aren't.
+enum GpuAllocationKind : uint8_t {
+    GPU_ALLOCATION_LINEAR,
+    GPU_ALLOCATION_OPTIMAL,
+};
+
+struct TlsfStats {
+    uint64_t used_bytes = 0;
+    uint32_t allocations = 0;
+    uint32_t free_regions = 0;
+    uint64_t largest_free_region = 0;
+};
+
+// Two level segregated fit allocator over a range of offsets, e.g. one block of device memory.
+// Free regions are kept in lists by size class, a first level per power of two split into 32
+// second level classes, found through bitmaps so allocating and freeing take constant time.
+// Requests are served from a class whose regions all fit them, so no list is searched unless the
+// buffer-image granularity rejects a region. Neighbouring free regions are merged when freed.
+//
+// Never touches the memory it manages.
+class TlsfAllocator {
+public:
+    TlsfAllocator() = default;
+
+    void init(uint64_t size, uint64_t granularity = 1);
+
+    // Offset aligned to `alignment`, a power of two, or false when no free region fits. Returns
+    // the allocation's node through `node`, which frees it and identifies it to `for_each`.
+    bool allocate(uint64_t size, uint64_t alignment, GpuAllocationKind kind, uint64_t user_data,
+                  uint32_t& node, uint64_t& offset);
+    void free(uint32_t node);
+
+    inline uint64_t size() const { return _size; }
+    inline uint64_t used_bytes() const { return _used; }
+    inline uint32_t allocation_count() const { return _allocation_count; }
+    inline bool empty() const { return _allocation_count == 0; }
+    inline uint64_t offset(uint32_t node) const { return _nodes[node].offset; }
+    inline uint64_t allocation_size(uint32_t node) const { return _nodes[node].size; }
+    inline uint64_t alignment(uint32_t node) const { return 1ull << _nodes[node].alignment_log2; }
+    inline GpuAllocationKind kind(uint32_t node) const { return _nodes[node].kind; }
+    inline uint64_t user_data(uint32_t node) const { return _nodes[node].user_data; }
+    TlsfStats stats() const;
+
+    // Calls `function(uint32_t node, uint64_t offset, uint64_t size)` for every allocation in
+    // order of offset.
+    template <typename _Function>
+    void for_each(_Function&& function) const;
+
+    // Checks every internal invariant, for fuzzing. False and an error when one is broken.
+    bool validate() const;
+
+private:
+    static constexpr uint32_t _SL_LOG2 = 5;
+    static constexpr uint32_t _SL_COUNT = 1 << _SL_LOG2;
+    static constexpr uint32_t _FL_COUNT = 64 - _SL_LOG2 + 1;
+
+    struct _Node {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint64_t user_data = 0;
+        uint32_t prev_physical = KY_GPU_ALLOCATOR_INVALID;
+        uint32_t next_physical = KY_GPU_ALLOCATOR_INVALID;
+        uint32_t prev_free = KY_GPU_ALLOCATOR_INVALID;
+        uint32_t next_free = KY_GPU_ALLOCATOR_INVALID;
+        bool used = false;
+        GpuAllocationKind kind = GPU_ALLOCATION_LINEAR;
+        uint8_t alignment_log2 = 0;
+    };
+
+    uint64_t _size = 0;
+    uint64_t _granularity = 1;
+    uint64_t _used = 0;
+    uint32_t _allocation_count = 0;
+    uint32_t _free_count = 0;
+
+    TaggedVector<_Node, MEMORY_TAG_RENDER> _nodes;
+    TaggedVector<uint32_t, MEMORY_TAG_RENDER> _unused_nodes;
+    uint32_t _first = KY_GPU_ALLOCATOR_INVALID;
+    uint64_t _fl_bitmap = 0;
+    uint32_t _sl_bitmaps[_FL_COUNT] = {};
+    uint32_t _heads[_FL_COUNT][_SL_COUNT];
+
+    static void _mapping(uint64_t size, uint32_t& fl, uint32_t& sl);
+    uint32_t _new_node();
+    void _insert_free(uint32_t node);
+    void _remove_free(uint32_t node);
+    bool _fits(uint32_t node, uint64_t size, uint64_t alignment, GpuAllocationKind kind,
+               uint64_t& offset) const;
+};
+
+template <typename _Function>
+void TlsfAllocator::for_each(_Function&& function) const {
+    for (uint32_t node = _first; node != KY_GPU_ALLOCATOR_INVALID;
+         node = _nodes[node].next_physical) {
+        if (_nodes[node].used) {
+            function(node, _nodes[node].offset, _nodes[node].size);
+        }
+    }
+}
+
+// Memory block of the backend, e.g. a `VkDeviceMemory` and where it's mapped when host visible.
+struct GpuMemoryBlock {
+    uint64_t handle = 0;
+    uint8_t* mapped = nullptr;
+};
+
+using GpuAllocateBlockFunction = bool (*)(void* user_data, uint32_t memory_type, uint64_t size,
+                                          GpuMemoryBlock& block);
+using GpuFreeBlockFunction = void (*)(void* user_data, uint32_t memory_type,
+                                      const GpuMemoryBlock& block);
+
+struct GpuAllocatorDesc {
+    uint32_t memory_type_count = 1;
+    uint64_t block_size = KY_GPU_ALLOCATOR_BLOCK_SIZE;
+    // Page size resources of different kinds can't share, a power of two
+    uint64_t granularity = 1;
+    GpuAllocateBlockFunction allocate_block = nullptr;
+    GpuFreeBlockFunction free_block = nullptr;
+    void* user_data = nullptr;
+};
+
+struct GpuAllocationDesc {
+    uint64_t size = 0;
+    uint64_t alignment = 1;
+    uint32_t memory_type = 0;
+    GpuAllocationKind kind = GPU_ALLOCATION_LINEAR;
+    // Identifies the resource to defragmentation moves, 0 for allocations it mustn't move. Only
+    // resources the backend can copy and rebind are relocatable, e.g. buffers that aren't mapped.
+    uint64_t user_data = 0;
+};
+
+struct GpuAllocation {
+    uint32_t memory_type = KY_GPU_ALLOCATOR_INVALID;
+    uint32_t block = KY_GPU_ALLOCATOR_INVALID;
+    // Node in the block's allocator, invalid for dedicated blocks
+    uint32_t node = KY_GPU_ALLOCATOR_INVALID;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+
+    inline bool valid() const { return block != KY_GPU_ALLOCATOR_INVALID; }
+};
+
+struct GpuMemoryStats {
+    uint32_t blocks = 0;
+    uint32_t dedicated_blocks = 0;
+    uint64_t block_bytes = 0;
+    uint64_t used_bytes = 0;
+    uint32_t allocations = 0;
+    uint32_t free_regions = 0;
+    uint64_t largest_free_region = 0;
+    // 0 while the free memory of each block is one region, approaching 1 as it splits into many
+    // small ones
+    float fragmentation = 0.0f;
+};
+
+// Allocation to move, the destination is already allocated. The backend copies the resource
+// identified by `user_data` over, rebinds it and frees `source` once the GPU stopped using it.
+struct GpuDefragmentationMove {
+    GpuAllocation source;
+    GpuAllocation destination;
+    uint64_t user_data = 0;
+};
+
+// Sub-allocates resources from large blocks of backend memory, one TLSF allocator per block and
+// blocks per memory type. Relocatable and fixed allocations are kept in separate blocks, so a
+// single texture can't keep a block of buffers from being emptied by defragmentation. Blocks are
+// allocated through the backend's callbacks when the existing ones are full and freed once empty,
+// except the last of each type and kind which is kept to avoid allocating a new one on the next
+// request. Safe to use from any thread.
+class GpuAllocator {
+public:
+    GpuAllocator() = default;
+    ~GpuAllocator();
+
+    GpuAllocator(const GpuAllocator&) = delete;
+    GpuAllocator& operator=(const GpuAllocator&) = delete;
+
+    bool init(const GpuAllocatorDesc& desc);
+    // Frees every block, allocations still alive are reported.
+    void shutdown();
+
+    bool allocate(const GpuAllocationDesc& desc, GpuAllocation& allocation);
+    void free(const GpuAllocation& allocation);
+
+    GpuMemoryBlock block(const GpuAllocation& allocation) const;
+    // Host address of the allocation, null unless its block is mapped.
+    uint8_t* mapped(const GpuAllocation& allocation) const;
+
+    GpuMemoryStats stats() const;
+    GpuMemoryStats stats(uint32_t memory_type) const;
+
+    // Plans up to `max_moves` moves totalling at most `max_bytes`, taking relocatable allocations
+    // out of the emptiest blocks into fuller ones so the emptiest blocks can be freed. Called once
+    // per frame with a small budget it defragments incrementally. Blocks receiving moves aren't
+    // emptied in the same call, so no allocation moves twice before its copy ran.
+    uint32_t defragment(uint32_t max_moves, uint64_t max_bytes,
+                        TaggedVector<GpuDefragmentationMove, MEMORY_TAG_RENDER>& moves);
+
+    bool validate() const;
+
+private:
+    struct _Block {
+        // Null for dedicated blocks and unused entries
+        TlsfAllocator* allocator = nullptr;
+        GpuMemoryBlock memory;
+        uint64_t size = 0;
+        uint32_t memory_type = KY_GPU_ALLOCATOR_INVALID;
+        bool dedicated = false;
+        bool relocatable = false;
+    };
+
+    GpuAllocatorDesc _desc;
+    mutable std::mutex _mutex;
+    TaggedVector<_Block, MEMORY_TAG_RENDER> _blocks;
+    TaggedVector<uint32_t, MEMORY_TAG_RENDER> _unused_blocks;
+
+    uint32_t _add_block(uint32_t memory_type, uint64_t size, bool dedicated, bool relocatable);
+    void _free_block(uint32_t block);
+    void _add_stats(const _Block& block, GpuMemoryStats& stats, uint64_t& free_bytes,
+                    uint64_t& largest_free_bytes) const;
+    static void _finish_stats(GpuMemoryStats& stats, uint64_t free_bytes,
+                              uint64_t largest_free_bytes);
+};
+
+} // namespace ky
+
+#endif
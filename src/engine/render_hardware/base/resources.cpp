@@ -0,0 +1,175 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "render_hardware/base/resources.h"
+
+#include <algorithm>
+
+namespace ky {
+
+uint32_t texture_format_size(TextureFormat format) {
+    switch (format) {
+        case TEXTURE_FORMAT_R8_UNORM:
+            return 1;
+        case TEXTURE_FORMAT_RG8_UNORM:
+        case TEXTURE_FORMAT_R16_FLOAT:
+        case TEXTURE_FORMAT_D16_UNORM:
+            return 2;
+        case TEXTURE_FORMAT_RGBA8_UNORM:
+        case TEXTURE_FORMAT_RGBA8_SRGB:
+        case TEXTURE_FORMAT_BGRA8_UNORM:
+        case TEXTURE_FORMAT_BGRA8_SRGB:
+        case TEXTURE_FORMAT_RG16_FLOAT:
+        case TEXTURE_FORMAT_R32_FLOAT:
+        case TEXTURE_FORMAT_R32_UINT:
+        case TEXTURE_FORMAT_RGB10A2_UNORM:
+        case TEXTURE_FORMAT_RG11B10_FLOAT:
+        case TEXTURE_FORMAT_D32_FLOAT:
+        case TEXTURE_FORMAT_D24_UNORM_S8_UINT:
+            return 4;
+        case TEXTURE_FORMAT_RGBA16_FLOAT:
+        case TEXTURE_FORMAT_RG32_FLOAT:
+        case TEXTURE_FORMAT_D32_FLOAT_S8_UINT:
+            return 8;
+        case TEXTURE_FORMAT_RGBA32_FLOAT:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+bool texture_format_has_depth(TextureFormat format) {
+    return format == TEXTURE_FORMAT_D16_UNORM || format == TEXTURE_FORMAT_D32_FLOAT ||
+           texture_format_has_stencil(format);
+}
+
+bool texture_format_has_stencil(TextureFormat format) {
+    return format == TEXTURE_FORMAT_D24_UNORM_S8_UINT ||
+           format == TEXTURE_FORMAT_D32_FLOAT_S8_UINT;
+}
+
+uint32_t vertex_format_size(VertexFormat format) {
+    switch (format) {
+        case VERTEX_FORMAT_FLOAT:
+        case VERTEX_FORMAT_UINT:
+        case VERTEX_FORMAT_UBYTE4_UNORM:
+        case VERTEX_FORMAT_HALF2:
+            return 4;
+        case VERTEX_FORMAT_FLOAT2:
+        case VERTEX_FORMAT_UINT2:
+        case VERTEX_FORMAT_HALF4:
+            return 8;
+        case VERTEX_FORMAT_FLOAT3:
+            return 12;
+        case VERTEX_FORMAT_FLOAT4:
+        case VERTEX_FORMAT_UINT4:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+uint64_t texture_size(const TextureDesc& desc) {
+    uint64_t bytes = 0;
+    for (uint32_t mip = 0; mip < desc.mip_levels; mip++) {
+        uint64_t width = std::max(desc.width >> mip, 1u);
+        uint64_t height = std::max(desc.height >> mip, 1u);
+        uint64_t depth = std::max(desc.depth >> mip, 1u);
+        bytes += width * height * depth;
+    }
+    return bytes * desc.array_layers * desc.samples * texture_format_size(desc.format);
+}
+
+const char* texture_format_to_cstring(TextureFormat format) {
+    switch (format) {
+        case TEXTURE_FORMAT_UNDEFINED:
+            return "UNDEFINED";
+        case TEXTURE_FORMAT_R8_UNORM:
+            return "R8_UNORM";
+        case TEXTURE_FORMAT_RG8_UNORM:
+            return "RG8_UNORM";
+        case TEXTURE_FORMAT_RGBA8_UNORM:
+            return "RGBA8_UNORM";
+        case TEXTURE_FORMAT_RGBA8_SRGB:
+            return "RGBA8_SRGB";
+        case TEXTURE_FORMAT_BGRA8_UNORM:
+            return "BGRA8_UNORM";
+        case TEXTURE_FORMAT_BGRA8_SRGB:
+            return "BGRA8_SRGB";
+        case TEXTURE_FORMAT_R16_FLOAT:
+            return "R16_FLOAT";
+        case TEXTURE_FORMAT_RG16_FLOAT:
+            return "RG16_FLOAT";
+        case TEXTURE_FORMAT_RGBA16_FLOAT:
+            return "RGBA16_FLOAT";
+        case TEXTURE_FORMAT_R32_FLOAT:
+            return "R32_FLOAT";
+        case TEXTURE_FORMAT_RG32_FLOAT:
+            return "RG32_FLOAT";
+        case TEXTURE_FORMAT_RGBA32_FLOAT:
+            return "RGBA32_FLOAT";
+        case TEXTURE_FORMAT_R32_UINT:
+            return "R32_UINT";
+        case TEXTURE_FORMAT_RGB10A2_UNORM:
+            return "RGB10A2_UNORM";
+        case TEXTURE_FORMAT_RG11B10_FLOAT:
+            return "RG11B10_FLOAT";
+        case TEXTURE_FORMAT_D16_UNORM:
+            return "D16_UNORM";
+        case TEXTURE_FORMAT_D32_FLOAT:
+            return "D32_FLOAT";
+        case TEXTURE_FORMAT_D24_UNORM_S8_UINT:
+            return "D24_UNORM_S8_UINT";
+        case TEXTURE_FORMAT_D32_FLOAT_S8_UINT:
+            return "D32_FLOAT_S8_UINT";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+const char* resource_state_to_cstring(ResourceState state) {
+    switch (state) {
+        case RESOURCE_STATE_UNDEFINED:
+            return "UNDEFINED";
+        case RESOURCE_STATE_VERTEX_BUFFER:
+            return "VERTEX_BUFFER";
+        case RESOURCE_STATE_INDEX_BUFFER:
+            return "INDEX_BUFFER";
+        case RESOURCE_STATE_UNIFORM_BUFFER:
+            return "UNIFORM_BUFFER";
+        case RESOURCE_STATE_INDIRECT_ARGUMENT:
+            return "INDIRECT_ARGUMENT";
+        case RESOURCE_STATE_SHADER_READ:
+            return "SHADER_READ";
+        case RESOURCE_STATE_SHADER_WRITE:
+            return "SHADER_WRITE";
+        case RESOURCE_STATE_COLOR_ATTACHMENT:
+            return "COLOR_ATTACHMENT";
+        case RESOURCE_STATE_DEPTH_STENCIL_WRITE:
+            return "DEPTH_STENCIL_WRITE";
+        case RESOURCE_STATE_DEPTH_STENCIL_READ:
+            return "DEPTH_STENCIL_READ";
+        case RESOURCE_STATE_TRANSFER_SRC:
+            return "TRANSFER_SRC";
+        case RESOURCE_STATE_TRANSFER_DST:
+            return "TRANSFER_DST";
+        case RESOURCE_STATE_PRESENT:
+            return "PRESENT";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+} // namespace ky
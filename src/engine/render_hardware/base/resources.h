@@ -0,0 +1,385 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_RENDER_HARDWARE_BASE__RESOURCES_H
+#define KRYOS_RENDER_HARDWARE_BASE__RESOURCES_H
+
+#include <cstdint>
+
+// Resources of each type a context can hold at once. Storage for them is allocated up front so
+// backends can index it from any thread while resources are created.
+#ifndef KY_RHI_MAX_BUFFERS
+#    define KY_RHI_MAX_BUFFERS 16384
+#endif
+#ifndef KY_RHI_MAX_TEXTURES
+#    define KY_RHI_MAX_TEXTURES 8192
+#endif
+#ifndef KY_RHI_MAX_SAMPLERS
+#    define KY_RHI_MAX_SAMPLERS 256
+#endif
+#ifndef KY_RHI_MAX_SHADERS
+#    define KY_RHI_MAX_SHADERS 1024
+#endif
+#ifndef KY_RHI_MAX_PIPELINES
+#    define KY_RHI_MAX_PIPELINES 2048
+#endif
+
+// The Vulkan backend is only compiled in when this is set to 1, see the KY_ENABLE_VULKAN_BACKEND
+// CMake option. It hasn't been built against the Vulkan SDK or run under the validation layers
+// yet.
+#ifndef KY_RHI_VULKAN_ENABLED
+#    define KY_RHI_VULKAN_ENABLED 0
+#endif
+
+#define KY_RHI_MAX_COLOR_ATTACHMENTS 8
+#define KY_RHI_MAX_VERTEX_BUFFERS    8
+#define KY_RHI_MAX_VERTEX_ATTRIBUTES 16
+
+// Every pipeline shares one binding layout, set 0 holds the uniform buffers first, then the
+// storage buffers and then the textures, e.g. texture slot 2 is `binding = 10`
+#define KY_RHI_UNIFORM_BUFFER_SLOTS 4
+#define KY_RHI_STORAGE_BUFFER_SLOTS 4
+#define KY_RHI_TEXTURE_SLOTS        8
+#define KY_RHI_PUSH_CONSTANT_SIZE   128
+
+#define KY_RHI_INVALID_INDEX UINT32_MAX
+
+namespace ky {
+
+// Generational reference to a resource owned by a `RenderContext`. `valid` only tells it apart
+// from a default constructed handle, `RenderContext::alive` whether the resource still exists.
+template <typename _Tag>
+struct RenderHandle {
+    uint32_t index = KY_RHI_INVALID_INDEX;
+    uint32_t generation = 0;
+
+    inline bool valid() const { return index != KY_RHI_INVALID_INDEX; }
+    inline bool operator==(const RenderHandle& other) const {
+        return index == other.index && generation == other.generation;
+    }
+    inline bool operator!=(const RenderHandle& other) const { return !(*this == other); }
+};
+
+using BufferHandle = RenderHandle<struct BufferTag>;
+using TextureHandle = RenderHandle<struct TextureTag>;
+using SamplerHandle = RenderHandle<struct SamplerTag>;
+using ShaderHandle = RenderHandle<struct ShaderTag>;
+using PipelineHandle = RenderHandle<struct PipelineTag>;
+
+enum RenderBackend {
+    // Validates and records submitted commands in memory, nothing reaches a GPU. Meant for tests,
+    // benchmarks and headless servers.
+    RENDER_BACKEND_NULL,
+    // Requires `KY_RHI_VULKAN_ENABLED`
+    RENDER_BACKEND_VULKAN,
+    RENDER_BACKEND_COUNT,
+};
+
+enum TextureFormat : uint32_t {
+    TEXTURE_FORMAT_UNDEFINED,
+    TEXTURE_FORMAT_R8_UNORM,
+    TEXTURE_FORMAT_RG8_UNORM,
+    TEXTURE_FORMAT_RGBA8_UNORM,
+    TEXTURE_FORMAT_RGBA8_SRGB,
+    TEXTURE_FORMAT_BGRA8_UNORM,
+    TEXTURE_FORMAT_BGRA8_SRGB,
+    TEXTURE_FORMAT_R16_FLOAT,
+    TEXTURE_FORMAT_RG16_FLOAT,
+    TEXTURE_FORMAT_RGBA16_FLOAT,
+    TEXTURE_FORMAT_R32_FLOAT,
+    TEXTURE_FORMAT_RG32_FLOAT,
+    TEXTURE_FORMAT_RGBA32_FLOAT,
+    TEXTURE_FORMAT_R32_UINT,
+    TEXTURE_FORMAT_RGB10A2_UNORM,
+    TEXTURE_FORMAT_RG11B10_FLOAT,
+    TEXTURE_FORMAT_D16_UNORM,
+    TEXTURE_FORMAT_D32_FLOAT,
+    TEXTURE_FORMAT_D24_UNORM_S8_UINT,
+    TEXTURE_FORMAT_D32_FLOAT_S8_UINT,
+    TEXTURE_FORMAT_COUNT,
+};
+
+enum VertexFormat : uint32_t {
+    VERTEX_FORMAT_FLOAT,
+    VERTEX_FORMAT_FLOAT2,
+    VERTEX_FORMAT_FLOAT3,
+    VERTEX_FORMAT_FLOAT4,
+    VERTEX_FORMAT_UINT,
+    VERTEX_FORMAT_UINT2,
+    VERTEX_FORMAT_UINT4,
+    VERTEX_FORMAT_UBYTE4_UNORM,
+    VERTEX_FORMAT_HALF2,
+    VERTEX_FORMAT_HALF4,
+    VERTEX_FORMAT_COUNT,
+};
+
+enum IndexType : uint32_t {
+    INDEX_TYPE_UINT16,
+    INDEX_TYPE_UINT32,
+};
+
+enum BufferUsageFlags {
+    BUFFER_USAGE_VERTEX_BIT = 1 << 0,
+    BUFFER_USAGE_INDEX_BIT = 1 << 1,
+    BUFFER_USAGE_UNIFORM_BIT = 1 << 2,
+    BUFFER_USAGE_STORAGE_BIT = 1 << 3,
+    BUFFER_USAGE_INDIRECT_BIT = 1 << 4,
+    BUFFER_USAGE_TRANSFER_SRC_BIT = 1 << 5,
+    BUFFER_USAGE_TRANSFER_DST_BIT = 1 << 6,
+};
+
+enum TextureUsageFlags {
+    TEXTURE_USAGE_SAMPLED_BIT = 1 << 0,
+    TEXTURE_USAGE_STORAGE_BIT = 1 << 1,
+    TEXTURE_USAGE_COLOR_ATTACHMENT_BIT = 1 << 2,
+    TEXTURE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT = 1 << 3,
+    TEXTURE_USAGE_TRANSFER_SRC_BIT = 1 << 4,
+    TEXTURE_USAGE_TRANSFER_DST_BIT = 1 << 5,
+};
+
+enum RenderMemory {
+    // Device local, filled through copies or an initial upload
+    RENDER_MEMORY_GPU,
+    // Host visible and persistently mapped, written by the CPU and read by the GPU
+    RENDER_MEMORY_UPLOAD,
+    // Host visible and cached, written by the GPU and read back by the CPU
+    RENDER_MEMORY_READBACK,
+};
+
+// How a resource is accessed next, transitions between states are recorded as barriers.
+enum ResourceState : uint32_t {
+    // Contents are discarded by a transition from this state
+    RESOURCE_STATE_UNDEFINED,
+    RESOURCE_STATE_VERTEX_BUFFER,
+    RESOURCE_STATE_INDEX_BUFFER,
+    RESOURCE_STATE_UNIFORM_BUFFER,
+    RESOURCE_STATE_INDIRECT_ARGUMENT,
+    RESOURCE_STATE_SHADER_READ,
+    RESOURCE_STATE_SHADER_WRITE,
+    RESOURCE_STATE_COLOR_ATTACHMENT,
+    RESOURCE_STATE_DEPTH_STENCIL_WRITE,
+    RESOURCE_STATE_DEPTH_STENCIL_READ,
+    RESOURCE_STATE_TRANSFER_SRC,
+    RESOURCE_STATE_TRANSFER_DST,
+    RESOURCE_STATE_PRESENT,
+    RESOURCE_STATE_COUNT,
+};
+
+enum TextureType : uint32_t {
+    TEXTURE_TYPE_2D,
+    TEXTURE_TYPE_3D,
+    TEXTURE_TYPE_CUBE,
+};
+
+enum SamplerFilter : uint32_t {
+    SAMPLER_FILTER_NEAREST,
+    SAMPLER_FILTER_LINEAR,
+};
+
+enum SamplerAddressMode : uint32_t {
+    SAMPLER_ADDRESS_MODE_REPEAT,
+    SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT,
+    SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+};
+
+enum PrimitiveTopology : uint32_t {
+    PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+    PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+    PRIMITIVE_TOPOLOGY_LINE_LIST,
+    PRIMITIVE_TOPOLOGY_LINE_STRIP,
+    PRIMITIVE_TOPOLOGY_POINT_LIST,
+};
+
+enum CullMode : uint32_t {
+    CULL_MODE_NONE,
+    CULL_MODE_FRONT,
+    CULL_MODE_BACK,
+};
+
+enum CompareOp : uint32_t {
+    COMPARE_OP_NEVER,
+    COMPARE_OP_LESS,
+    COMPARE_OP_EQUAL,
+    COMPARE_OP_LESS_OR_EQUAL,
+    COMPARE_OP_GREATER,
+    COMPARE_OP_NOT_EQUAL,
+    COMPARE_OP_GREATER_OR_EQUAL,
+    COMPARE_OP_ALWAYS,
+};
+
+enum BlendMode : uint32_t {
+    BLEND_MODE_NONE,
+    BLEND_MODE_ALPHA,
+    BLEND_MODE_PREMULTIPLIED_ALPHA,
+    BLEND_MODE_ADDITIVE,
+};
+
+enum LoadOp : uint32_t {
+    LOAD_OP_LOAD,
+    LOAD_OP_CLEAR,
+    LOAD_OP_DONT_CARE,
+};
+
+enum StoreOp : uint32_t {
+    STORE_OP_STORE,
+    STORE_OP_DONT_CARE,
+};
+
+enum ShaderStage : uint32_t {
+    SHADER_STAGE_VERTEX,
+    SHADER_STAGE_FRAGMENT,
+    SHADER_STAGE_COMPUTE,
+    SHADER_STAGE_COUNT,
+};
+
+// Bytes per texel, 0 for `TEXTURE_FORMAT_UNDEFINED`.
+uint32_t texture_format_size(TextureFormat format);
+bool texture_format_has_depth(TextureFormat format);
+bool texture_format_has_stencil(TextureFormat format);
+uint32_t vertex_format_size(VertexFormat format);
+
+// Names used by validation messages and debug markers.
+const char* texture_format_to_cstring(TextureFormat format);
+const char* resource_state_to_cstring(ResourceState state);
+
+// Debug names aren't kept, backends pass them to debug tools while creating the resource.
+struct BufferDesc {
+    uint64_t size = 0;
+    uint32_t usage = 0;
+    RenderMemory memory = RENDER_MEMORY_GPU;
+    const char* name = nullptr;
+};
+
+struct TextureDesc {
+    TextureType type = TEXTURE_TYPE_2D;
+    TextureFormat format = TEXTURE_FORMAT_RGBA8_UNORM;
+    uint32_t width = 1;
+    uint32_t height = 1;
+    uint32_t depth = 1;
+    uint32_t mip_levels = 1;
+    // Layers of array textures, 6 per cube
+    uint32_t array_layers = 1;
+    uint32_t samples = 1;
+    uint32_t usage = TEXTURE_USAGE_SAMPLED_BIT;
+    const char* name = nullptr;
+};
+
+// Bytes of every mip of every layer and sample, tightly packed.
+uint64_t texture_size(const TextureDesc& desc);
+
+struct SamplerDesc {
+    SamplerFilter min_filter = SAMPLER_FILTER_LINEAR;
+    SamplerFilter mag_filter = SAMPLER_FILTER_LINEAR;
+    SamplerFilter mip_filter = SAMPLER_FILTER_LINEAR;
+    SamplerAddressMode address_u = SAMPLER_ADDRESS_MODE_REPEAT;
+    SamplerAddressMode address_v = SAMPLER_ADDRESS_MODE_REPEAT;
+    SamplerAddressMode address_w = SAMPLER_ADDRESS_MODE_REPEAT;
+    // Values above 1 enable anisotropic filtering
+    float max_anisotropy = 1.0f;
+    float min_lod = 0.0f;
+    float max_lod = 1000.0f;
+    const char* name = nullptr;
+};
+
+struct VertexBinding {
+    uint32_t stride = 0;
+    bool per_instance = false;
+};
+
+struct VertexAttribute {
+    uint32_t location = 0;
+    uint32_t binding = 0;
+    VertexFormat format = VERTEX_FORMAT_FLOAT3;
+    uint32_t offset = 0;
+};
+
+// Graphics pipelines set the vertex and fragment shader, compute pipelines only the compute
+// shader. The attachment formats have to match the render passes the pipeline is used in.
+struct PipelineDesc {
+    ShaderHandle vertex_shader;
+    ShaderHandle fragment_shader;
+    ShaderHandle compute_shader;
+
+    VertexBinding vertex_bindings[KY_RHI_MAX_VERTEX_BUFFERS] = {};
+    uint32_t vertex_binding_count = 0;
+    VertexAttribute vertex_attributes[KY_RHI_MAX_VERTEX_ATTRIBUTES] = {};
+    uint32_t vertex_attribute_count = 0;
+
+    PrimitiveTopology topology = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    CullMode cull_mode = CULL_MODE_BACK;
+    // Front faces wind counter clockwise unless this is set
+    bool front_clockwise = false;
+    bool wireframe = false;
+
+    bool depth_test = false;
+    bool depth_write = false;
+    CompareOp depth_compare = COMPARE_OP_LESS_OR_EQUAL;
+
+    TextureFormat color_formats[KY_RHI_MAX_COLOR_ATTACHMENTS] = {};
+    BlendMode blend_modes[KY_RHI_MAX_COLOR_ATTACHMENTS] = {};
+    uint32_t color_count = 0;
+    TextureFormat depth_format = TEXTURE_FORMAT_UNDEFINED;
+    uint32_t samples = 1;
+    const char* name = nullptr;
+};
+
+struct ColorAttachment {
+    TextureHandle texture;
+    LoadOp load_op = LOAD_OP_CLEAR;
+    StoreOp store_op = STORE_OP_STORE;
+    float clear_color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+};
+
+struct DepthAttachment {
+    TextureHandle texture;
+    LoadOp load_op = LOAD_OP_CLEAR;
+    StoreOp store_op = STORE_OP_DONT_CARE;
+    float clear_depth = 1.0f;
+    uint32_t clear_stencil = 0;
+};
+
+// A render pass recorded over several command lists is begun and ended in each of them. All but
+// the first list set `RENDER_PASS_RESUME_BIT` and all but the last `RENDER_PASS_SUSPEND_BIT`, the
+// lists then have to be submitted together and in order.
+enum RenderPassFlags {
+    RENDER_PASS_SUSPEND_BIT = 1 << 0,
+    RENDER_PASS_RESUME_BIT = 1 << 1,
+};
+
+struct RenderPassDesc {
+    ColorAttachment colors[KY_RHI_MAX_COLOR_ATTACHMENTS] = {};
+    uint32_t color_count = 0;
+    DepthAttachment depth;
+    // Rendered area, the size of the first attachment when 0
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t flags = 0;
+};
+
+struct BufferBarrier {
+    BufferHandle buffer;
+    ResourceState before;
+    ResourceState after;
+};
+
+struct TextureBarrier {
+    TextureHandle texture;
+    ResourceState before;
+    ResourceState after;
+};
+
+} // namespace ky
+
+#endif
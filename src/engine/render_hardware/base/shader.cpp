@@ -0,0 +1,424 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "render_hardware/base/shader.h"
+
+#include "core/error.h"
+#include "core/memory_tracker.h"
+
+#include <algorithm>
+
+namespace ky {
+
+// SPIR-V values used by reflection, see the SPIR-V specification
+static constexpr uint32_t _SPIRV_MAGIC = 0x07230203;
+static constexpr uint32_t _SPIRV_HEADER_WORDS = 5;
+// Ids above this are treated as malformed rather than allocating for them
+static constexpr uint32_t _SPIRV_MAX_BOUND = 1 << 22;
+// Nesting of arrays and structs followed while sizing push constants
+static constexpr uint32_t _SPIRV_MAX_TYPE_DEPTH = 16;
+
+static constexpr uint32_t _OP_ENTRY_POINT = 15;
+static constexpr uint32_t _OP_EXECUTION_MODE = 16;
+static constexpr uint32_t _OP_TYPE_INT = 21;
+static constexpr uint32_t _OP_TYPE_FLOAT = 22;
+static constexpr uint32_t _OP_TYPE_VECTOR = 23;
+static constexpr uint32_t _OP_TYPE_MATRIX = 24;
+static constexpr uint32_t _OP_TYPE_IMAGE = 25;
+static constexpr uint32_t _OP_TYPE_SAMPLER = 26;
+static constexpr uint32_t _OP_TYPE_SAMPLED_IMAGE = 27;
+static constexpr uint32_t _OP_TYPE_ARRAY = 28;
+static constexpr uint32_t _OP_TYPE_RUNTIME_ARRAY = 29;
+static constexpr uint32_t _OP_TYPE_STRUCT = 30;
+static constexpr uint32_t _OP_TYPE_POINTER = 32;
+static constexpr uint32_t _OP_CONSTANT = 43;
+static constexpr uint32_t _OP_VARIABLE = 59;
+static constexpr uint32_t _OP_DECORATE = 71;
+static constexpr uint32_t _OP_MEMBER_DECORATE = 72;
+
+static constexpr uint32_t _DECORATION_BUFFER_BLOCK = 3;
+static constexpr uint32_t _DECORATION_ARRAY_STRIDE = 6;
+static constexpr uint32_t _DECORATION_MATRIX_STRIDE = 7;
+static constexpr uint32_t _DECORATION_BINDING = 33;
+static constexpr uint32_t _DECORATION_DESCRIPTOR_SET = 34;
+static constexpr uint32_t _DECORATION_OFFSET = 35;
+
+static constexpr uint32_t _STORAGE_UNIFORM_CONSTANT = 0;
+static constexpr uint32_t _STORAGE_UNIFORM = 2;
+static constexpr uint32_t _STORAGE_PUSH_CONSTANT = 9;
+static constexpr uint32_t _STORAGE_STORAGE_BUFFER = 12;
+
+static constexpr uint32_t _EXECUTION_MODEL_VERTEX = 0;
+static constexpr uint32_t _EXECUTION_MODEL_FRAGMENT = 4;
+static constexpr uint32_t _EXECUTION_MODEL_GL_COMPUTE = 5;
+static constexpr uint32_t _EXECUTION_MODE_LOCAL_SIZE = 17;
+
+struct SpirvId {
+    // Defining instruction, 0 for ids that aren't types, constants or variables
+    uint32_t opcode;
+    uint32_t offset;
+    uint32_t set;
+    uint32_t binding;
+    uint32_t array_stride;
+    uint8_t buffer_block;
+};
+
+struct SpirvMember {
+    uint32_t structure;
+    uint32_t member;
+    uint32_t offset;
+    uint32_t matrix_stride;
+};
+
+struct SpirvModule {
+    const uint32_t* words;
+    uint32_t word_count;
+    TaggedVector<SpirvId, MEMORY_TAG_RENDER> ids;
+    TaggedVector<SpirvMember, MEMORY_TAG_RENDER> members;
+
+    // Word `index` of the instruction defining `id`, 0 when out of the instruction's range
+    inline uint32_t operand(uint32_t id, uint32_t index) const {
+        uint32_t offset = ids[id].offset;
+        return index < (words[offset] >> 16) ? words[offset + index] : 0;
+    }
+    inline uint32_t opcode(uint32_t id) const { return id < ids.size() ? ids[id].opcode : 0; }
+
+    SpirvMember* member(uint32_t structure, uint32_t index) {
+        for (SpirvMember& member : members) {
+            if (member.structure == structure && member.member == index) {
+                return &member;
+            }
+        }
+        members.push_back({structure, index, UINT32_MAX, 0});
+        return &members.back();
+    }
+};
+
+static bool constant_value(const SpirvModule& module, uint32_t id, uint32_t& value) {
+    if (module.opcode(id) != _OP_CONSTANT) {
+        return false;
+    }
+    value = module.operand(id, 3);
+    return true;
+}
+
+static bool type_size(SpirvModule& module, uint32_t type, uint32_t depth, uint32_t& size) {
+    if (depth > _SPIRV_MAX_TYPE_DEPTH) {
+        return false;
+    }
+    uint32_t element_size;
+    uint32_t length;
+    switch (module.opcode(type)) {
+        case _OP_TYPE_INT:
+        case _OP_TYPE_FLOAT:
+            size = module.operand(type, 2) / 8;
+            return size > 0;
+        case _OP_TYPE_VECTOR:
+        case _OP_TYPE_MATRIX:
+            if (!type_size(module, module.operand(type, 2), depth + 1, element_size)) {
+                return false;
+            }
+            size = element_size * module.operand(type, 3);
+            return true;
+        case _OP_TYPE_ARRAY:
+            if (!type_size(module, module.operand(type, 2), depth + 1, element_size) ||
+                !constant_value(module, module.operand(type, 3), length)) {
+                return false;
+            }
+            if (module.ids[type].array_stride != 0) {
+                element_size = module.ids[type].array_stride;
+            }
+            size = element_size * length;
+            return true;
+        case _OP_TYPE_STRUCT: {
+            size = 0;
+            uint32_t member_count = (module.words[module.ids[type].offset] >> 16) - 2;
+            for (uint32_t i = 0; i < member_count; i++) {
+                uint32_t member_type = module.operand(type, 2 + i);
+                if (!type_size(module, member_type, depth + 1, element_size)) {
+                    return false;
+                }
+                const SpirvMember* member = module.member(type, i);
+                if (member->offset == UINT32_MAX) {
+                    return false;
+                }
+                // Matrix columns can be padded, e.g. the columns of a std140 mat3
+                if (member->matrix_stride != 0 && module.opcode(member_type) == _OP_TYPE_MATRIX) {
+                    element_size = member->matrix_stride * module.operand(member_type, 3);
+                }
+                size = std::max(size, member->offset + element_size);
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+static bool result_id(uint32_t opcode, const uint32_t* instruction, uint32_t word_count,
+                      uint32_t& id) {
+    switch (opcode) {
+        case _OP_TYPE_INT:
+        case _OP_TYPE_FLOAT:
+        case _OP_TYPE_VECTOR:
+        case _OP_TYPE_MATRIX:
+        case _OP_TYPE_IMAGE:
+        case _OP_TYPE_SAMPLER:
+        case _OP_TYPE_SAMPLED_IMAGE:
+        case _OP_TYPE_ARRAY:
+        case _OP_TYPE_RUNTIME_ARRAY:
+        case _OP_TYPE_STRUCT:
+        case _OP_TYPE_POINTER:
+            id = word_count > 1 ? instruction[1] : 0;
+            return word_count > 1;
+        case _OP_CONSTANT:
+        case _OP_VARIABLE:
+            id = word_count > 2 ? instruction[2] : 0;
+            return word_count > 2;
+        default:
+            return false;
+    }
+}
+
+// Binding type of a resource variable after arrays were stripped from its type
+static bool binding_type(const SpirvModule& module, uint32_t storage, uint32_t type,
+                         ShaderBindingType& binding_type) {
+    uint32_t opcode = module.opcode(type);
+    switch (storage) {
+        case _STORAGE_UNIFORM:
+            if (opcode != _OP_TYPE_STRUCT) {
+                return false;
+            }
+            // Storage buffers of SPIR-V before 1.3 are uniform blocks decorated as buffer blocks
+            binding_type = module.ids[type].buffer_block ? SHADER_BINDING_STORAGE_BUFFER
+                                                         : SHADER_BINDING_UNIFORM_BUFFER;
+            return true;
+        case _STORAGE_STORAGE_BUFFER:
+            binding_type = SHADER_BINDING_STORAGE_BUFFER;
+            return opcode == _OP_TYPE_STRUCT;
+        case _STORAGE_UNIFORM_CONSTANT:
+            if (opcode == _OP_TYPE_SAMPLED_IMAGE) {
+                binding_type = SHADER_BINDING_COMBINED_IMAGE_SAMPLER;
+            } else if (opcode == _OP_TYPE_SAMPLER) {
+                binding_type = SHADER_BINDING_SAMPLER;
+            } else if (opcode == _OP_TYPE_IMAGE) {
+                // Images are sampled with 1 and used as storage images with 2
+                binding_type = module.operand(type, 7) == 2 ? SHADER_BINDING_STORAGE_IMAGE
+                                                            : SHADER_BINDING_SAMPLED_IMAGE;
+            } else {
+                return false;
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+const char* shader_stage_to_cstring(ShaderStage stage) {
+    switch (stage) {
+        case SHADER_STAGE_VERTEX:
+            return "vertex";
+        case SHADER_STAGE_FRAGMENT:
+            return "fragment";
+        case SHADER_STAGE_COMPUTE:
+            return "compute";
+        default:
+            return "unknown";
+    }
+}
+
+const char* shader_binding_type_to_cstring(ShaderBindingType type) {
+    switch (type) {
+        case SHADER_BINDING_UNIFORM_BUFFER:
+            return "uniform buffer";
+        case SHADER_BINDING_STORAGE_BUFFER:
+            return "storage buffer";
+        case SHADER_BINDING_COMBINED_IMAGE_SAMPLER:
+            return "combined image sampler";
+        case SHADER_BINDING_SAMPLED_IMAGE:
+            return "sampled image";
+        case SHADER_BINDING_SAMPLER:
+            return "sampler";
+        case SHADER_BINDING_STORAGE_IMAGE:
+            return "storage image";
+        default:
+            return "unknown";
+    }
+}
+
+bool reflect_spirv(const uint32_t* code, size_t code_size, ShaderReflection& reflection) {
+    reflection = {};
+    KY_ERROR_CONDITION_MSG_RETURN(code != nullptr && code_size % 4 == 0 &&
+                                      code_size / 4 > _SPIRV_HEADER_WORDS &&
+                                      code_size / 4 < UINT32_MAX && code[0] == _SPIRV_MAGIC &&
+                                      code[3] <= _SPIRV_MAX_BOUND,
+                                  false, "Shader code isn't SPIR-V");
+
+    SpirvModule module;
+    module.words = code;
+    module.word_count = (uint32_t)(code_size / 4);
+    uint32_t bound = code[3];
+    module.ids.assign(bound, SpirvId {0, 0, UINT32_MAX, UINT32_MAX, 0, 0});
+
+    bool entry_found = false;
+    uint32_t entry_point = 0;
+    for (uint32_t offset = _SPIRV_HEADER_WORDS; offset < module.word_count;) {
+        const uint32_t* instruction = code + offset;
+        uint32_t word_count = instruction[0] >> 16;
+        uint32_t opcode = instruction[0] & 0xffff;
+        KY_ERROR_CONDITION_MSG_RETURN(word_count > 0 && word_count <= module.word_count - offset,
+                                      false, "Malformed SPIR-V instruction");
+
+        uint32_t id;
+        if (result_id(opcode, instruction, word_count, id)) {
+            KY_ERROR_CONDITION_MSG_RETURN(id < bound, false, "SPIR-V id out of bounds");
+            module.ids[id].opcode = opcode;
+            module.ids[id].offset = offset;
+        } else if (opcode == _OP_ENTRY_POINT && word_count > 2 && !entry_found) {
+            // Modules with several entry points are reflected as the first one
+            entry_found = true;
+            entry_point = instruction[2];
+            switch (instruction[1]) {
+                case _EXECUTION_MODEL_VERTEX:
+                    reflection.stage = SHADER_STAGE_VERTEX;
+                    break;
+                case _EXECUTION_MODEL_FRAGMENT:
+                    reflection.stage = SHADER_STAGE_FRAGMENT;
+                    break;
+                case _EXECUTION_MODEL_GL_COMPUTE:
+                    reflection.stage = SHADER_STAGE_COMPUTE;
+                    break;
+                default:
+                    KY_ERROR_MSG("Unsupported SPIR-V execution model %u", instruction[1]);
+                    return false;
+            }
+        } else if (opcode == _OP_EXECUTION_MODE && word_count >= 6 &&
+                   instruction[1] == entry_point &&
+                   instruction[2] == _EXECUTION_MODE_LOCAL_SIZE) {
+            reflection.local_size[0] = instruction[3];
+            reflection.local_size[1] = instruction[4];
+            reflection.local_size[2] = instruction[5];
+        } else if (opcode == _OP_DECORATE && word_count >= 3 && instruction[1] < bound) {
+            SpirvId& target = module.ids[instruction[1]];
+            uint32_t value = word_count > 3 ? instruction[3] : 0;
+            switch (instruction[2]) {
+                case _DECORATION_BUFFER_BLOCK:
+                    target.buffer_block = 1;
+                    break;
+                case _DECORATION_ARRAY_STRIDE:
+                    target.array_stride = value;
+                    break;
+                case _DECORATION_BINDING:
+                    target.binding = value;
+                    break;
+                case _DECORATION_DESCRIPTOR_SET:
+                    target.set = value;
+                    break;
+            }
+        } else if (opcode == _OP_MEMBER_DECORATE && word_count >= 5) {
+            if (instruction[3] == _DECORATION_OFFSET) {
+                module.member(instruction[1], instruction[2])->offset = instruction[4];
+            } else if (instruction[3] == _DECORATION_MATRIX_STRIDE) {
+                module.member(instruction[1], instruction[2])->matrix_stride = instruction[4];
+            }
+        }
+        offset += word_count;
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(entry_found, false, "SPIR-V module has no entry point");
+
+    for (uint32_t id = 0; id < bound; id++) {
+        if (module.ids[id].opcode != _OP_VARIABLE) {
+            continue;
+        }
+        uint32_t storage = module.operand(id, 3);
+        uint32_t pointer = module.operand(id, 1);
+        KY_ERROR_CONDITION_MSG_RETURN(module.opcode(pointer) == _OP_TYPE_POINTER, false,
+                                      "SPIR-V variable isn't a pointer");
+        uint32_t type = module.operand(pointer, 3);
+
+        if (storage == _STORAGE_PUSH_CONSTANT) {
+            uint32_t size;
+            KY_ERROR_CONDITION_MSG_RETURN(type_size(module, type, 0, size), false,
+                                          "Failed to size SPIR-V push constants");
+            reflection.push_constant_size = std::max(reflection.push_constant_size, size);
+            continue;
+        }
+        if (storage != _STORAGE_UNIFORM && storage != _STORAGE_STORAGE_BUFFER &&
+            storage != _STORAGE_UNIFORM_CONSTANT) {
+            continue;
+        }
+
+        ShaderBinding binding = {};
+        binding.set = module.ids[id].set;
+        binding.binding = module.ids[id].binding;
+        binding.count = 1;
+        for (uint32_t depth = 0; depth < _SPIRV_MAX_TYPE_DEPTH; depth++) {
+            uint32_t length;
+            if (module.opcode(type) == _OP_TYPE_ARRAY &&
+                constant_value(module, module.operand(type, 3), length)) {
+                binding.count *= length;
+            } else if (module.opcode(type) == _OP_TYPE_RUNTIME_ARRAY) {
+                binding.count = 0;
+            } else {
+                break;
+            }
+            type = module.operand(type, 2);
+        }
+        KY_ERROR_CONDITION_MSG_RETURN(binding_type(module, storage, type, binding.type), false,
+                                      "Unsupported SPIR-V resource type");
+        KY_ERROR_CONDITION_MSG_RETURN(binding.set != UINT32_MAX && binding.binding != UINT32_MAX,
+                                      false, "SPIR-V resource without a descriptor binding");
+        KY_ERROR_CONDITION_MSG_RETURN(reflection.binding_count < KY_SHADER_MAX_BINDINGS, false,
+                                      "Too many shader bindings, see KY_SHADER_MAX_BINDINGS");
+        reflection.bindings[reflection.binding_count++] = binding;
+    }
+
+    std::sort(reflection.bindings, reflection.bindings + reflection.binding_count,
+              [](const ShaderBinding& a, const ShaderBinding& b) {
+                  return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+              });
+    return true;
+}
+
+bool shader_reflection_fits_layout(const ShaderReflection& reflection) {
+    constexpr uint32_t storage_first = KY_RHI_UNIFORM_BUFFER_SLOTS;
+    constexpr uint32_t texture_first = storage_first + KY_RHI_STORAGE_BUFFER_SLOTS;
+    constexpr uint32_t binding_end = texture_first + KY_RHI_TEXTURE_SLOTS;
+    for (uint32_t i = 0; i < reflection.binding_count; i++) {
+        const ShaderBinding& binding = reflection.bindings[i];
+        ShaderBindingType expected = binding.binding < storage_first
+                                         ? SHADER_BINDING_UNIFORM_BUFFER
+                                         : (binding.binding < texture_first
+                                                ? SHADER_BINDING_STORAGE_BUFFER
+                                                : SHADER_BINDING_COMBINED_IMAGE_SAMPLER);
+        if (binding.set != 0 || binding.binding >= binding_end || binding.count != 1 ||
+            binding.type != expected) {
+            KY_ERROR_MSG("%s shader binding (set = %u, binding = %u) of type %s doesn't fit the "
+                         "shared layout",
+                         shader_stage_to_cstring(reflection.stage), binding.set, binding.binding,
+                         shader_binding_type_to_cstring(binding.type));
+            return false;
+        }
+    }
+    if (reflection.push_constant_size > KY_RHI_PUSH_CONSTANT_SIZE) {
+        KY_ERROR_MSG("%s shader uses %u bytes of push constants, more than "
+                     "KY_RHI_PUSH_CONSTANT_SIZE",
+                     shader_stage_to_cstring(reflection.stage), reflection.push_constant_size);
+        return false;
+    }
+    return true;
+}
+
+} // namespace ky
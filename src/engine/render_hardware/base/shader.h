@@ -0,0 +1,84 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_RENDER_HARDWARE_BASE__SHADER_H
+#define KRYOS_RENDER_HARDWARE_BASE__SHADER_H
+
+#include "render_hardware/base/resources.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Resource bindings recorded per shader by reflection
+#ifndef KY_SHADER_MAX_BINDINGS
+#    define KY_SHADER_MAX_BINDINGS 32
+#endif
+
+namespace ky {
+
+enum ShaderBindingType : uint32_t {
+    SHADER_BINDING_UNIFORM_BUFFER,
+    SHADER_BINDING_STORAGE_BUFFER,
+    SHADER_BINDING_COMBINED_IMAGE_SAMPLER,
+    SHADER_BINDING_SAMPLED_IMAGE,
+    SHADER_BINDING_SAMPLER,
+    SHADER_BINDING_STORAGE_IMAGE,
+};
+
+struct ShaderBinding {
+    uint32_t set;
+    uint32_t binding;
+    ShaderBindingType type;
+    // Array size, 0 for runtime sized arrays
+    uint32_t count;
+};
+
+// Interface of a SPIR-V module. Plain data so it can be stored next to cached code as is.
+struct ShaderReflection {
+    ShaderStage stage;
+    uint32_t binding_count;
+    ShaderBinding bindings[KY_SHADER_MAX_BINDINGS];
+    // Bytes from 0 to the end of the last push constant member
+    uint32_t push_constant_size;
+    // Workgroup size of compute shaders
+    uint32_t local_size[3];
+};
+
+const char* shader_stage_to_cstring(ShaderStage stage);
+const char* shader_binding_type_to_cstring(ShaderBindingType type);
+
+// Reads the stage, descriptor bindings, push constant size and workgroup size of the entry point
+// of a SPIR-V module. Fails on malformed modules and ones with more than `KY_SHADER_MAX_BINDINGS`
+// bindings.
+bool reflect_spirv(const uint32_t* code, size_t code_size, ShaderReflection& reflection);
+
+// Whether the bindings and push constants fit the layout every pipeline shares, see
+// `KY_RHI_UNIFORM_BUFFER_SLOTS`. The first mismatch is reported as an error.
+bool shader_reflection_fits_layout(const ShaderReflection& reflection);
+
+// Compiled SPIR-V for one stage. Resources are bound through the shared layout of set 0, see
+// `KY_RHI_UNIFORM_BUFFER_SLOTS`.
+struct ShaderDesc {
+    ShaderStage stage = SHADER_STAGE_VERTEX;
+    const uint32_t* code = nullptr;
+    // Size of `code` in bytes
+    size_t code_size = 0;
+    const char* entry_point = "main";
+    const char* name = nullptr;
+};
+
+} // namespace ky
+
+#endif
@@ -0,0 +1,326 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "render_hardware/base/shader_cache.h"
+
+#include "core/error.h"
+#include "core/hash.h"
+#include "core/memory.h"
+#include "core/profiler.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <type_traits>
+
+namespace ky {
+
+static constexpr char _SHADER_MAGIC[4] = {'K', 'Y', 'S', 'H'};
+static constexpr char _PIPELINE_MAGIC[4] = {'K', 'Y', 'P', 'C'};
+
+struct ShaderCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint64_t content_hash;
+    uint32_t code_size;
+    uint32_t reflection_size;
+};
+static_assert(sizeof(ShaderCacheHeader) == 32, "Shader cache header layout changed");
+static_assert(std::is_trivially_copyable_v<ShaderReflection>,
+              "Shader reflection is stored in cache files as is");
+
+struct PipelineCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t backend;
+    uint32_t padding;
+    uint64_t device_id;
+    uint64_t data_size;
+    uint64_t data_hash;
+};
+static_assert(sizeof(PipelineCacheHeader) == 40, "Pipeline cache header layout changed");
+
+// Writes next to `path` and renames over it, readers never see a partially written file
+static bool write_file_atomic(const std::string& path, const void* const* parts,
+                              const size_t* sizes, uint32_t count) {
+    static std::atomic<uint32_t> temporary_counter {0};
+    uint32_t suffix = temporary_counter.fetch_add(1, std::memory_order_relaxed);
+    std::string temporary = path + ".tmp" + std::to_string(suffix);
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool written = true;
+    for (uint32_t i = 0; written && i < count; i++) {
+        written = sizes[i] == 0 || fwrite(parts[i], 1, sizes[i], file) == sizes[i];
+    }
+    written = fclose(file) == 0 && written;
+
+    std::error_code error;
+    if (written) {
+        std::filesystem::rename(temporary, path, error);
+    }
+    if (!written || error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+ShaderCache::~ShaderCache() {
+    shutdown();
+}
+
+bool ShaderCache::init(const ShaderCacheDesc& desc) {
+    shutdown();
+    KY_ERROR_CONDITION_MSG_RETURN(desc.compile != nullptr, false,
+                                  "Shader caches need a compile function");
+    _compile = desc.compile;
+    _user_data = desc.user_data;
+    _validate_layout = desc.validate_layout;
+    _compiler_hash = hash_bytes(desc.compiler_version.data(), desc.compiler_version.size(),
+                                KY_SHADER_CACHE_VERSION);
+
+    _directory.clear();
+    if (desc.directory != nullptr) {
+        std::error_code error;
+        std::filesystem::create_directories(desc.directory, error);
+        KY_ERROR_CONDITION_MSG_RETURN(!error, false, "Failed to create shader cache directory");
+        _directory = desc.directory;
+    }
+    return true;
+}
+
+void ShaderCache::shutdown() {
+    clear_memory();
+    _compile = nullptr;
+    _user_data = nullptr;
+    _stats = ShaderCacheStats();
+}
+
+uint64_t ShaderCache::key(const ShaderSource& source) const {
+    // Strings are hashed with their size, so moving characters between neighbouring strings
+    // changes the key
+    uint64_t hash = _compiler_hash;
+    auto add = [&](const void* data, size_t size) { hash = hash_bytes(data, size, hash); };
+    auto add_string = [&](std::string_view string) {
+        uint64_t size = string.size();
+        add(&size, sizeof(size));
+        add(string.data(), string.size());
+    };
+
+    uint32_t stage = source.stage;
+    add(&stage, sizeof(stage));
+    add(&source.dependency_hash, sizeof(source.dependency_hash));
+    add_string(source.entry_point);
+    for (uint32_t i = 0; i < source.define_count; i++) {
+        add_string(source.defines[i].name);
+        add_string(source.defines[i].value);
+    }
+    add_string(source.code);
+    return hash;
+}
+
+const CachedShader* ShaderCache::get(const ShaderSource& source) {
+    KY_PROFILE_SCOPE("ShaderCache::get");
+    KY_ERROR_CONDITION_MSG_RETURN(_compile != nullptr, nullptr, "Shader cache isn't initialized");
+    uint64_t key = this->key(source);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto found = _shaders.find(key);
+        if (found != _shaders.end()) {
+            _stats.memory_hits++;
+            return found->second;
+        }
+    }
+
+    CachedShader* shader = memory::create<CachedShader>(MEMORY_TAG_RENDER);
+    shader->key = key;
+    shader->entry_point = source.entry_point;
+    bool invalid = false;
+    bool loaded = !_directory.empty() && _load(*shader, invalid);
+    if (!loaded) {
+        KY_PROFILE_SCOPE("ShaderCache::compile");
+        std::string log;
+        bool compiled = _compile(_user_data, source, shader->code, log) &&
+                        reflect_spirv(shader->code.data(), shader->code.size() * sizeof(uint32_t),
+                                      shader->reflection);
+        if (compiled && shader->reflection.stage != source.stage) {
+            log = "SPIR-V entry point has another stage than the source";
+            compiled = false;
+        }
+        if (compiled && _validate_layout) {
+            compiled = shader_reflection_fits_layout(shader->reflection);
+        }
+        if (!compiled) {
+            KY_ERROR_MSG("Failed to compile %s shader %.*s: %s",
+                         shader_stage_to_cstring(source.stage), (int)source.path.size(),
+                         source.path.data(), log.c_str());
+            memory::destroy(MEMORY_TAG_RENDER, shader);
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats.compile_failures++;
+            return nullptr;
+        }
+        if (!log.empty()) {
+            KY_WARNING_MSG("%.*s: %s", (int)source.path.size(), source.path.data(), log.c_str());
+        }
+        if (!_directory.empty() && !_save(*shader)) {
+            KY_WARNING_MSG("Failed to write %s", file_path(key).c_str());
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats.invalid_files += invalid ? 1 : 0;
+    if (loaded) {
+        _stats.disk_hits++;
+    } else {
+        _stats.compiles++;
+    }
+    auto [found, inserted] = _shaders.emplace(key, shader);
+    if (!inserted) {
+        // Another thread finished the same module first
+        memory::destroy(MEMORY_TAG_RENDER, shader);
+    }
+    return found->second;
+}
+
+void ShaderCache::clear_memory() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto& [key, shader] : _shaders) {
+        memory::destroy(MEMORY_TAG_RENDER, shader);
+    }
+    _shaders.clear();
+}
+
+ShaderCacheStats ShaderCache::stats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+std::string ShaderCache::file_path(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.kyshader", (unsigned long long)key);
+    return _directory + name;
+}
+
+bool ShaderCache::_load(CachedShader& shader, bool& invalid) const {
+    KY_PROFILE_SCOPE("ShaderCache::load");
+    std::string path = file_path(shader.key);
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    ShaderCacheHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                 std::memcmp(header.magic, _SHADER_MAGIC, sizeof(_SHADER_MAGIC)) == 0 &&
+                 header.version == KY_SHADER_CACHE_VERSION && header.key == shader.key &&
+                 header.reflection_size == sizeof(ShaderReflection) && header.code_size > 0 &&
+                 header.code_size % sizeof(uint32_t) == 0;
+    if (valid) {
+        shader.code.resize(header.code_size / sizeof(uint32_t));
+        valid = fread(&shader.reflection, sizeof(ShaderReflection), 1, file) == 1 &&
+                fread(shader.code.data(), 1, header.code_size, file) == header.code_size &&
+                fgetc(file) == EOF;
+    }
+    fclose(file);
+    if (valid) {
+        uint64_t hash = hash_bytes(&shader.reflection, sizeof(ShaderReflection));
+        valid = hash_bytes(shader.code.data(), header.code_size, hash) == header.content_hash &&
+                shader.reflection.binding_count <= KY_SHADER_MAX_BINDINGS;
+    }
+    if (!valid) {
+        KY_WARNING_MSG("Discarding invalid shader cache file %s", path.c_str());
+        shader.code.clear();
+        shader.reflection = {};
+        invalid = true;
+    }
+    return valid;
+}
+
+bool ShaderCache::_save(const CachedShader& shader) const {
+    ShaderCacheHeader header = {};
+    std::memcpy(header.magic, _SHADER_MAGIC, sizeof(_SHADER_MAGIC));
+    header.version = KY_SHADER_CACHE_VERSION;
+    header.key = shader.key;
+    header.code_size = (uint32_t)(shader.code.size() * sizeof(uint32_t));
+    header.reflection_size = sizeof(ShaderReflection);
+    header.content_hash = hash_bytes(shader.code.data(), header.code_size,
+                                     hash_bytes(&shader.reflection, sizeof(ShaderReflection)));
+
+    const void* parts[] = {&header, &shader.reflection, shader.code.data()};
+    size_t sizes[] = {sizeof(header), sizeof(ShaderReflection), header.code_size};
+    return write_file_atomic(file_path(shader.key), parts, sizes, 3);
+}
+
+bool read_pipeline_cache_file(const char* path, RenderBackend backend, uint64_t device_id,
+                              TaggedVector<uint8_t, MEMORY_TAG_RENDER>& data) {
+    KY_PROFILE_SCOPE("read_pipeline_cache_file");
+    data.clear();
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    PipelineCacheHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                 std::memcmp(header.magic, _PIPELINE_MAGIC, sizeof(_PIPELINE_MAGIC)) == 0 &&
+                 header.version == KY_PIPELINE_CACHE_VERSION;
+    bool compatible = valid && header.backend == (uint32_t)backend &&
+                      header.device_id == device_id;
+    if (compatible) {
+        // Sized from the file rather than trusting the header before the hash is checked
+        long start = ftell(file);
+        valid = fseek(file, 0, SEEK_END) == 0 && ftell(file) - start == (long)header.data_size &&
+                fseek(file, start, SEEK_SET) == 0;
+        if (valid) {
+            data.resize(header.data_size);
+            valid = fread(data.data(), 1, data.size(), file) == data.size() &&
+                    hash_bytes(data.data(), data.size()) == header.data_hash;
+        }
+    }
+    fclose(file);
+
+    if (!valid) {
+        KY_WARNING_MSG("Discarding invalid pipeline cache %s", path);
+    } else if (!compatible) {
+        KY_WARNING_MSG("Discarding pipeline cache %s saved for another device or driver", path);
+    }
+    if (!valid || !compatible) {
+        data.clear();
+        return false;
+    }
+    return true;
+}
+
+bool write_pipeline_cache_file(const char* path, RenderBackend backend, uint64_t device_id,
+                               const void* data, size_t size) {
+    KY_PROFILE_SCOPE("write_pipeline_cache_file");
+    PipelineCacheHeader header = {};
+    std::memcpy(header.magic, _PIPELINE_MAGIC, sizeof(_PIPELINE_MAGIC));
+    header.version = KY_PIPELINE_CACHE_VERSION;
+    header.backend = backend;
+    header.device_id = device_id;
+    header.data_size = size;
+    header.data_hash = hash_bytes(data, size);
+
+    const void* parts[] = {&header, data};
+    size_t sizes[] = {sizeof(header), size};
+    KY_ERROR_CONDITION_MSG_RETURN(write_file_atomic(path, parts, sizes, 2), false,
+                                  "Failed to write pipeline cache");
+    return true;
+}
+
+} // namespace ky
@@ -0,0 +1,167 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_RENDER_HARDWARE_BASE__SHADER_CACHE_H
+#define KRYOS_RENDER_HARDWARE_BASE__SHADER_CACHE_H
+
+#include "core/memory_tracker.h"
+#include "render_hardware/base/resources.h"
+#include "render_hardware/base/shader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Shader cache file format, all values little endian:
+//
+// One file per module named after its key in hex with the `.kyshader` extension. A 32 byte
+// header holds the magic "KYSH", the format version, the key, a hash of everything after the
+// header, the code size and the size of `ShaderReflection`. The reflection follows as is, then
+// the SPIR-V code.
+//
+// Pipeline cache files hold a 40 byte header with the magic "KYPC", the format version, the
+// backend, the backend's pipeline cache id, the blob size and a hash of the blob, followed by the
+// blob.
+
+#define KY_SHADER_CACHE_VERSION   1
+#define KY_PIPELINE_CACHE_VERSION 1
+
+namespace ky {
+
+struct ShaderDefine {
+    std::string_view name;
+    std::string_view value;
+};
+
+// Everything a compiled module depends on, all of it is part of the cache key.
+struct ShaderSource {
+    ShaderStage stage = SHADER_STAGE_VERTEX;
+    std::string_view code;
+    // Used by compiler messages and to resolve includes, not part of the key
+    std::string_view path;
+    const ShaderDefine* defines = nullptr;
+    uint32_t define_count = 0;
+    std::string_view entry_point = "main";
+    // Hash of the files `code` includes, so editing them invalidates the module
+    uint64_t dependency_hash = 0;
+};
+
+// Compiles a source to SPIR-V into `spirv`, writing compiler messages to `log`. Called from the
+// threads requesting modules, possibly several at once.
+using ShaderCompileFunction = bool (*)(void* user_data, const ShaderSource& source,
+                                       TaggedVector<uint32_t, MEMORY_TAG_RENDER>& spirv,
+                                       std::string& log);
+
+struct ShaderCacheDesc {
+    // Directory modules are stored in, created when missing. Without one modules are only
+    // cached in memory.
+    const char* directory = nullptr;
+    ShaderCompileFunction compile = nullptr;
+    void* user_data = nullptr;
+    // Identifies the compiler and its options, changing it invalidates every cached module
+    std::string_view compiler_version;
+    // Rejects modules whose bindings don't fit the layout every pipeline shares
+    bool validate_layout = true;
+};
+
+struct CachedShader {
+    uint64_t key = 0;
+    TaggedVector<uint32_t, MEMORY_TAG_RENDER> code;
+    ShaderReflection reflection = {};
+    std::string entry_point;
+
+    // Description for `RenderContext::create_shader`, valid while the module is cached.
+    inline ShaderDesc desc(const char* name = nullptr) const {
+        ShaderDesc desc;
+        desc.stage = reflection.stage;
+        desc.code = code.data();
+        desc.code_size = code.size() * sizeof(uint32_t);
+        desc.entry_point = entry_point.c_str();
+        desc.name = name;
+        return desc;
+    }
+};
+
+struct ShaderCacheStats {
+    uint32_t memory_hits = 0;
+    uint32_t disk_hits = 0;
+    uint32_t compiles = 0;
+    uint32_t compile_failures = 0;
+    // Files that failed validation and were replaced by recompiling
+    uint32_t invalid_files = 0;
+};
+
+// Compiled SPIR-V and its reflection keyed by a content hash of the source, defines, entry point
+// and compiler version. Modules are looked up in memory, then on disk and are only compiled when
+// neither has them, so a warm start loads every module without running the compiler. Files that
+// don't match their key or hash are treated as missing and rewritten. Nothing touches a GPU.
+//
+// Modules can be requested from several threads at once. Two threads missing the same key both
+// compile it and the first result is kept.
+class ShaderCache {
+public:
+    ShaderCache() = default;
+    ~ShaderCache();
+
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+
+    bool init(const ShaderCacheDesc& desc);
+    void shutdown();
+
+    uint64_t key(const ShaderSource& source) const;
+
+    // Null when compilation or reflection fails. Modules stay valid until `clear_memory` or
+    // shutdown.
+    const CachedShader* get(const ShaderSource& source);
+
+    // Drops the modules held in memory, the next requests load them from disk.
+    void clear_memory();
+
+    ShaderCacheStats stats() const;
+    std::string file_path(uint64_t key) const;
+
+private:
+    std::string _directory;
+    ShaderCompileFunction _compile = nullptr;
+    void* _user_data = nullptr;
+    uint64_t _compiler_hash = 0;
+    bool _validate_layout = true;
+
+    mutable std::mutex _mutex;
+    std::unordered_map<uint64_t, CachedShader*, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                       TaggedAllocator<std::pair<const uint64_t, CachedShader*>,
+                                       MEMORY_TAG_RENDER>>
+            _shaders;
+    ShaderCacheStats _stats;
+
+    bool _load(CachedShader& shader, bool& invalid) const;
+    bool _save(const CachedShader& shader) const;
+};
+
+// Reads a pipeline cache blob saved for `backend` and `device_id`. Missing files fail quietly,
+// files saved for another device or failing validation fail with a warning.
+bool read_pipeline_cache_file(const char* path, RenderBackend backend, uint64_t device_id,
+                              TaggedVector<uint8_t, MEMORY_TAG_RENDER>& data);
+// Replaces the file atomically, a crash while saving leaves the previous file intact.
+bool write_pipeline_cache_file(const char* path, RenderBackend backend, uint64_t device_id,
+                               const void* data, size_t size);
+
+} // namespace ky
+
+#endif
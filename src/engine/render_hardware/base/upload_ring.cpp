@@ -0,0 +1,220 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "render_hardware/base/upload_ring.h"
+
+#include "core/error.h"
+#include "core/jobs.h"
+#include "core/memory.h"
+#include "core/profiler.h"
+#include "render_hardware/base/context.h"
+
+#include <algorithm>
+
+namespace ky {
+
+static constexpr uint32_t _USAGE = BUFFER_USAGE_VERTEX_BIT | BUFFER_USAGE_INDEX_BIT |
+                                   BUFFER_USAGE_UNIFORM_BIT | BUFFER_USAGE_STORAGE_BIT |
+                                   BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+static inline bool is_power_of_two(uint64_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+UploadRing::~UploadRing() {
+    shutdown();
+}
+
+bool UploadRing::init(RenderContext& context, uint64_t size) {
+    shutdown();
+    KY_ERROR_CONDITION_MSG_RETURN(size > 0, false, "Upload ring size can't be 0");
+
+    _capacity = align_up(size, KY_RHI_UPLOAD_ALIGNMENT);
+    BufferDesc desc;
+    desc.size = _capacity * KY_RHI_FRAMES_IN_FLIGHT;
+    desc.usage = _USAGE;
+    desc.memory = RENDER_MEMORY_UPLOAD;
+    desc.name = "Upload ring";
+    _buffer = context.create_buffer(desc);
+    KY_ERROR_CONDITION_MSG_RETURN(_buffer.valid(), false, "Failed to create the upload ring");
+    _data = context.mapped_data(_buffer);
+    if (_data == nullptr) {
+        KY_ERROR_MSG("Upload ring buffer isn't mapped");
+        context.destroy(_buffer);
+        _buffer = BufferHandle();
+        return false;
+    }
+
+    _context = &context;
+    _chunks.assign(JobSystem::thread_count(), _Chunk());
+    _frame_number = 0;
+    _slot = 0;
+    _overflow_warned = false;
+    _stats = UploadRingStats();
+    _stats.capacity = _capacity;
+    return true;
+}
+
+void UploadRing::shutdown() {
+    if (_context == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (_Partition& partition : _partitions) {
+        _release_overflows(partition);
+        partition.head.store(0, std::memory_order_relaxed);
+    }
+    _context->destroy(_buffer);
+    _buffer = BufferHandle();
+    _data = nullptr;
+    _chunks.clear();
+    _context = nullptr;
+}
+
+void UploadRing::begin_frame(uint64_t frame_number, uint32_t slot) {
+    KY_PROFILE_SCOPE("UploadRing::begin_frame");
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // The previous frame finished recording, its usage is final
+    if (_frame_number != 0) {
+        const _Partition& previous = _partitions[_slot];
+        uint64_t used = std::min(previous.head.load(std::memory_order_relaxed), _capacity);
+        _stats.used_bytes = used + previous.overflow_bytes;
+        _stats.high_water = std::max(_stats.high_water, _stats.used_bytes);
+        _stats.overflow_bytes = previous.overflow_bytes;
+        _stats.overflow_buffers = (uint32_t)previous.overflows.size();
+        if (!previous.overflows.empty()) {
+            _stats.overflow_frames++;
+        }
+    }
+
+    // The fence of the frame that last wrote the slot's partition signalled
+    _Partition& partition = _partitions[slot];
+    _release_overflows(partition);
+    partition.head.store(0, std::memory_order_relaxed);
+    _frame_number = frame_number;
+    _slot = slot;
+}
+
+UploadAllocation UploadRing::allocate(uint64_t size, uint64_t alignment) {
+    KY_ERROR_CONDITION_MSG_RETURN(is_power_of_two(alignment), UploadAllocation(),
+                                  "Upload alignment has to be a power of two");
+    KY_ERROR_CONDITION_MSG_RETURN(_context != nullptr, UploadAllocation(),
+                                  "Upload ring isn't initialized");
+    size = std::max<uint64_t>(size, 1);
+
+    uint64_t offset = 0;
+    uint32_t thread = JobSystem::thread_index();
+    constexpr uint64_t SMALL = KY_RHI_UPLOAD_RING_CHUNK_SIZE / 4;
+    if (thread < _chunks.size() && size <= SMALL && alignment <= SMALL) {
+        _Chunk& chunk = _chunks[thread];
+        offset = align_up(chunk.offset, alignment);
+        if (chunk.frame_number != _frame_number || offset + size > chunk.end) {
+            // The rest of the old chunk is wasted, at most a quarter of it
+            if (!_take(KY_RHI_UPLOAD_RING_CHUNK_SIZE, KY_RHI_UPLOAD_ALIGNMENT, offset)) {
+                chunk.frame_number = 0;
+                return _allocate_overflow(size, alignment);
+            }
+            chunk.end = offset + KY_RHI_UPLOAD_RING_CHUNK_SIZE;
+            chunk.frame_number = _frame_number;
+            // Chunks start at the default alignment only
+            offset = align_up(offset, alignment);
+        }
+        if (offset + size <= chunk.end) {
+            chunk.offset = offset + size;
+            return {_buffer, offset, _data + offset};
+        }
+    }
+
+    if (!_take(size, alignment, offset)) {
+        return _allocate_overflow(size, alignment);
+    }
+    return {_buffer, offset, _data + offset};
+}
+
+UploadRingStats UploadRing::stats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+bool UploadRing::_take(uint64_t size, uint64_t alignment, uint64_t& offset) {
+    // The head stays a multiple of the default alignment, only larger alignments need padding
+    uint64_t padded = align_up(size, KY_RHI_UPLOAD_ALIGNMENT);
+    if (alignment > KY_RHI_UPLOAD_ALIGNMENT) {
+        padded += alignment - KY_RHI_UPLOAD_ALIGNMENT;
+    }
+    uint64_t head = _partitions[_slot].head.fetch_add(padded, std::memory_order_relaxed);
+    if (head + padded > _capacity) {
+        return false;
+    }
+    offset = align_up(_slot * _capacity + head, alignment);
+    return true;
+}
+
+UploadAllocation UploadRing::_allocate_overflow(uint64_t size, uint64_t alignment) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _Partition& partition = _partitions[_slot];
+    if (!_overflow_warned) {
+        // Only once, later overflows are counted by the stats
+        KY_WARNING_MSG("Upload ring of %llu bytes overflowed in frame %llu, consider raising "
+                       "RenderContextDesc::upload_ring_size",
+                       (unsigned long long)_capacity, (unsigned long long)_frame_number);
+        _overflow_warned = true;
+    }
+
+    if (!partition.overflows.empty()) {
+        _Overflow& overflow = partition.overflows.back();
+        uint64_t offset = align_up(overflow.used, alignment);
+        if (offset + size <= overflow.size) {
+            partition.overflow_bytes += offset + size - overflow.used;
+            overflow.used = offset + size;
+            return {overflow.buffer, offset, overflow.data + offset};
+        }
+    }
+
+    // Buffers are created as large as a quarter of the ring so a frame running over it by a bit
+    // doesn't create one per upload
+    BufferDesc desc;
+    desc.size = std::max(align_up(size, KY_RHI_UPLOAD_ALIGNMENT), _capacity / 4);
+    desc.usage = _USAGE;
+    desc.memory = RENDER_MEMORY_UPLOAD;
+    desc.name = "Upload ring overflow";
+    _Overflow overflow;
+    overflow.buffer = _context->create_buffer(desc);
+    KY_ERROR_CONDITION_MSG_RETURN(overflow.buffer.valid(), UploadAllocation(),
+                                  "Failed to create an upload overflow buffer");
+    overflow.data = _context->mapped_data(overflow.buffer);
+    if (overflow.data == nullptr) {
+        KY_ERROR_MSG("Upload overflow buffer isn't mapped");
+        _context->destroy(overflow.buffer);
+        return UploadAllocation();
+    }
+    overflow.size = desc.size;
+    overflow.used = size;
+    partition.overflows.push_back(overflow);
+    partition.overflow_bytes += size;
+    return {overflow.buffer, 0, overflow.data};
+}
+
+void UploadRing::_release_overflows(_Partition& partition) {
+    // Destruction is deferred by the context, the buffers may still be read by frames in flight
+    for (const _Overflow& overflow : partition.overflows) {
+        _context->destroy(overflow.buffer);
+    }
+    partition.overflows.clear();
+    partition.overflow_bytes = 0;
+}
+
+} // namespace ky
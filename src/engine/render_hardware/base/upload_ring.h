@@ -0,0 +1,145 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_RENDER_HARDWARE_BASE__UPLOAD_RING_H
+#define KRYOS_RENDER_HARDWARE_BASE__UPLOAD_RING_H
+
+#include "core/macros.h"
+#include "core/memory_tracker.h"
+#include "render_hardware/base/device.h"
+#include "render_hardware/base/resources.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+// Bytes of transient upload memory per frame in flight, see `RenderContextDesc`
+#ifndef KY_RHI_UPLOAD_RING_SIZE
+#    define KY_RHI_UPLOAD_RING_SIZE (8ull * 1024 * 1024)
+#endif
+
+// Bytes a thread takes from the ring at once, requests larger than a quarter of it bypass the
+// thread's chunk
+#ifndef KY_RHI_UPLOAD_RING_CHUNK_SIZE
+#    define KY_RHI_UPLOAD_RING_CHUNK_SIZE (64ull * 1024)
+#endif
+
+// Default alignment of uploads, satisfies the uniform buffer offset alignment of every GPU
+#define KY_RHI_UPLOAD_ALIGNMENT 256
+
+namespace ky {
+
+class RenderContext;
+
+// Memory for data the GPU reads during the current frame only. Write it through `data` and bind
+// `buffer` at `offset`, it stays valid until the frame's slot is reused.
+struct UploadAllocation {
+    BufferHandle buffer;
+    uint64_t offset = 0;
+    uint8_t* data = nullptr;
+
+    inline bool valid() const { return data != nullptr; }
+};
+
+struct UploadRingStats {
+    // Bytes of the ring per frame in flight
+    uint64_t capacity = 0;
+    // Bytes the last finished frame uploaded, including padding and overflow
+    uint64_t used_bytes = 0;
+    // Most bytes any frame uploaded since init, the ring size that would have avoided every
+    // overflow
+    uint64_t high_water = 0;
+    // Overflow buffers the last finished frame created and the bytes it placed in them
+    uint64_t overflow_bytes = 0;
+    uint32_t overflow_buffers = 0;
+    // Frames since init that didn't fit in the ring
+    uint32_t overflow_frames = 0;
+};
+
+// Persistently mapped upload buffer split into one partition per frame in flight, so uploading
+// per frame data like uniforms or generated vertices is a pointer bump and a copy instead of
+// creating and mapping a buffer. A partition is reused once the fence of the frame that last
+// wrote it signalled.
+//
+// Job system threads bump their own chunk of the partition and only touch a shared atomic to
+// take a new chunk, other threads and large requests take from the shared head directly. Frames
+// that run out of ring space fall back to upload buffers created for the frame, reported by the
+// stats so the ring can be sized to the high water mark.
+class UploadRing {
+public:
+    UploadRing() = default;
+    ~UploadRing();
+
+    UploadRing(const UploadRing&) = delete;
+    UploadRing& operator=(const UploadRing&) = delete;
+
+    // Sized for the threads of the job system, so it has to be initialized first.
+    bool init(RenderContext& context, uint64_t size);
+    void shutdown();
+    inline bool is_initialized() const { return _context != nullptr; }
+
+    // Called by the context once the slot's fence signalled, before anything is recorded.
+    void begin_frame(uint64_t frame_number, uint32_t slot);
+
+    // `alignment` is a power of two. Invalid only when creating an overflow buffer failed.
+    UploadAllocation allocate(uint64_t size, uint64_t alignment = KY_RHI_UPLOAD_ALIGNMENT);
+
+    UploadRingStats stats() const;
+
+private:
+    struct alignas(KY_CACHE_LINE_SIZE) _Chunk {
+        uint64_t offset = 0;
+        uint64_t end = 0;
+        uint64_t frame_number = 0;
+    };
+
+    struct _Overflow {
+        BufferHandle buffer;
+        uint8_t* data = nullptr;
+        uint64_t size = 0;
+        uint64_t used = 0;
+    };
+
+    struct _Partition {
+        // Relative to the partition, may run past its capacity once it overflowed
+        alignas(KY_CACHE_LINE_SIZE) std::atomic<uint64_t> head = 0;
+        TaggedVector<_Overflow, MEMORY_TAG_RENDER> overflows;
+        uint64_t overflow_bytes = 0;
+    };
+
+    RenderContext* _context = nullptr;
+    BufferHandle _buffer;
+    uint8_t* _data = nullptr;
+    uint64_t _capacity = 0;
+
+    uint64_t _frame_number = 0;
+    uint32_t _slot = 0;
+    _Partition _partitions[KY_RHI_FRAMES_IN_FLIGHT];
+    // One per job system thread, only touched by its thread
+    TaggedVector<_Chunk, MEMORY_TAG_RENDER> _chunks;
+
+    // Guards the overflow buffers and the stats
+    mutable std::mutex _mutex;
+    bool _overflow_warned = false;
+    UploadRingStats _stats;
+
+    bool _take(uint64_t size, uint64_t alignment, uint64_t& offset);
+    UploadAllocation _allocate_overflow(uint64_t size, uint64_t alignment);
+    void _release_overflows(_Partition& partition);
+};
+
+} // namespace ky
+
+#endif
@@ -0,0 +1,671 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "render_hardware/null/null_device.h"
+#include "core/error.h"
+#include "core/hash.h"
+#include "core/profiler.h"
+#include "render_hardware/base/context.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ky {
+
+// Placement of a typical desktop GPU, optimally tiled images are 64 KiB aligned unless small
+static constexpr uint64_t _GRANULARITY = 1024;
+static constexpr uint64_t _BUFFER_ALIGNMENT = 256;
+static constexpr uint64_t _SMALL_TEXTURE_ALIGNMENT = 4096;
+static constexpr uint64_t _TEXTURE_ALIGNMENT = 64 * 1024;
+
+// Blocks are only simulated, nothing is allocated for them
+static bool allocate_block(void*, uint32_t, uint64_t, GpuMemoryBlock&) {
+    return true;
+}
+
+static void free_block(void*, uint32_t, const GpuMemoryBlock&) {}
+
+static bool same_attachments(const RenderPassDesc& a, const RenderPassDesc& b) {
+    if (a.color_count != b.color_count || a.depth.texture != b.depth.texture) {
+        return false;
+    }
+    for (uint32_t i = 0; i < a.color_count; i++) {
+        if (a.colors[i].texture != b.colors[i].texture) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Hashes the fields of a pipeline rather than its bytes, padding and names aren't part of it
+static uint64_t pipeline_key(const PipelineDesc& desc, const uint64_t* shader_hashes) {
+    uint64_t fields[8 + KY_RHI_MAX_VERTEX_BUFFERS * 2 + KY_RHI_MAX_VERTEX_ATTRIBUTES * 4 +
+                    KY_RHI_MAX_COLOR_ATTACHMENTS * 2];
+    uint32_t count = 0;
+    for (ShaderHandle shader : {desc.vertex_shader, desc.fragment_shader, desc.compute_shader}) {
+        fields[count++] = shader.valid() ? shader_hashes[shader.index] : 0;
+    }
+    fields[count++] = ((uint64_t)desc.vertex_binding_count << 32) | desc.vertex_attribute_count;
+    fields[count++] = ((uint64_t)desc.topology << 32) | desc.cull_mode;
+    fields[count++] = (uint64_t)desc.front_clockwise | (uint64_t)desc.wireframe << 1 |
+                      (uint64_t)desc.depth_test << 2 | (uint64_t)desc.depth_write << 3 |
+                      (uint64_t)desc.depth_compare << 8;
+    fields[count++] = ((uint64_t)desc.color_count << 32) | desc.depth_format;
+    fields[count++] = desc.samples;
+    for (uint32_t i = 0; i < desc.vertex_binding_count; i++) {
+        fields[count++] = desc.vertex_bindings[i].stride;
+        fields[count++] = desc.vertex_bindings[i].per_instance;
+    }
+    for (uint32_t i = 0; i < desc.vertex_attribute_count; i++) {
+        const VertexAttribute& attribute = desc.vertex_attributes[i];
+        fields[count++] = attribute.location;
+        fields[count++] = attribute.binding;
+        fields[count++] = attribute.format;
+        fields[count++] = attribute.offset;
+    }
+    for (uint32_t i = 0; i < desc.color_count; i++) {
+        fields[count++] = desc.color_formats[i];
+        fields[count++] = desc.blend_modes[i];
+    }
+    return hash_bytes(fields, count * sizeof(uint64_t));
+}
+
+bool NullRenderDevice::init(RenderContext& context, const RenderContextDesc& desc) {
+    (void)desc;
+    _context = &context;
+    _buffers.assign(KY_RHI_MAX_BUFFERS, _Buffer());
+    _texture_states.assign(KY_RHI_MAX_TEXTURES, RESOURCE_STATE_UNDEFINED);
+    _texture_allocations.assign(KY_RHI_MAX_TEXTURES, GpuAllocation());
+    _shader_hashes.assign(KY_RHI_MAX_SHADERS, 0);
+    _pipeline_cache.clear();
+    _pipeline_cache_hits = 0;
+    _pipeline_cache_misses = 0;
+
+    // A memory type per `RenderMemory`
+    GpuAllocatorDesc allocator_desc;
+    allocator_desc.memory_type_count = RENDER_MEMORY_READBACK + 1;
+    allocator_desc.granularity = _GRANULARITY;
+    allocator_desc.allocate_block = allocate_block;
+    allocator_desc.free_block = free_block;
+    return _allocator.init(allocator_desc);
+}
+
+void NullRenderDevice::shutdown() {
+    for (uint32_t i = 0; i < _buffers.size(); i++) {
+        destroy_buffer(i);
+    }
+    for (uint32_t i = 0; i < _texture_allocations.size(); i++) {
+        destroy_texture(i);
+    }
+    _allocator.shutdown();
+    _buffers.clear();
+    _texture_states.clear();
+    _texture_allocations.clear();
+    _shader_hashes.clear();
+    _pipeline_cache.clear();
+    _context = nullptr;
+}
+
+bool NullRenderDevice::create_buffer(uint32_t index, const BufferDesc& desc, const void* data) {
+    // GPU only buffers are relocatable like on Vulkan
+    GpuAllocationDesc allocation_desc;
+    allocation_desc.size = desc.size;
+    allocation_desc.alignment = _BUFFER_ALIGNMENT;
+    allocation_desc.memory_type = desc.memory;
+    allocation_desc.user_data = desc.memory == RENDER_MEMORY_GPU ? (uint64_t)index + 1 : 0;
+    _Buffer& buffer = _buffers[index];
+    if (!_allocator.allocate(allocation_desc, buffer.allocation)) {
+        return false;
+    }
+    buffer.data = (uint8_t*)memory::allocate(desc.size, MEMORY_TAG_RENDER);
+    buffer.size = desc.size;
+    buffer.state = RESOURCE_STATE_UNDEFINED;
+    if (data != nullptr) {
+        std::memcpy(buffer.data, data, desc.size);
+    } else {
+        std::memset(buffer.data, 0, desc.size);
+    }
+    return true;
+}
+
+bool NullRenderDevice::create_texture(uint32_t index, const TextureDesc& desc, const void* data) {
+    GpuAllocationDesc allocation_desc;
+    allocation_desc.size = std::max<uint64_t>(texture_size(desc), 1);
+    allocation_desc.alignment = allocation_desc.size < _TEXTURE_ALIGNMENT
+                                        ? _SMALL_TEXTURE_ALIGNMENT
+                                        : _TEXTURE_ALIGNMENT;
+    allocation_desc.kind = GPU_ALLOCATION_OPTIMAL;
+    if (!_allocator.allocate(allocation_desc, _texture_allocations[index])) {
+        return false;
+    }
+    _texture_states[index] = data != nullptr ? RESOURCE_STATE_SHADER_READ
+                                             : RESOURCE_STATE_UNDEFINED;
+    return true;
+}
+
+bool NullRenderDevice::create_sampler(uint32_t index, const SamplerDesc& desc) {
+    (void)index;
+    (void)desc;
+    return true;
+}
+
+bool NullRenderDevice::create_shader(uint32_t index, const ShaderDesc& desc) {
+    // SPIR-V modules start with the magic number
+    KY_ERROR_CONDITION_MSG_RETURN(
+        desc.code_size >= 4 && desc.code_size % 4 == 0 && desc.code[0] == 0x07230203, false,
+        "Shader code isn't SPIR-V");
+    _shader_hashes[index] = hash_bytes(desc.code, desc.code_size, desc.stage);
+    return true;
+}
+
+bool NullRenderDevice::create_pipeline(uint32_t index, const PipelineDesc& desc) {
+    (void)index;
+    for (uint32_t i = 0; i < desc.vertex_attribute_count; i++) {
+        KY_ERROR_CONDITION_MSG_RETURN(desc.vertex_attributes[i].binding <
+                                          desc.vertex_binding_count,
+                                      false, "Vertex attribute reads an undeclared binding");
+    }
+
+    uint64_t key = pipeline_key(desc, _shader_hashes.data());
+    std::lock_guard<std::mutex> lock(_pipeline_cache_mutex);
+    auto position = std::lower_bound(_pipeline_cache.begin(), _pipeline_cache.end(), key);
+    if (position != _pipeline_cache.end() && *position == key) {
+        _pipeline_cache_hits++;
+    } else {
+        _pipeline_cache_misses++;
+        _pipeline_cache.insert(position, key);
+    }
+    return true;
+}
+
+void NullRenderDevice::destroy_buffer(uint32_t index) {
+    _Buffer& buffer = _buffers[index];
+    if (buffer.data != nullptr) {
+        memory::deallocate(buffer.data, buffer.size, MEMORY_TAG_RENDER);
+    }
+    _allocator.free(buffer.allocation);
+    buffer = _Buffer();
+}
+
+void NullRenderDevice::destroy_texture(uint32_t index) {
+    _texture_states[index] = RESOURCE_STATE_UNDEFINED;
+    _allocator.free(_texture_allocations[index]);
+    _texture_allocations[index] = GpuAllocation();
+}
+
+void NullRenderDevice::destroy_sampler(uint32_t index) {
+    (void)index;
+}
+
+void NullRenderDevice::destroy_shader(uint32_t index) {
+    (void)index;
+}
+
+void NullRenderDevice::destroy_pipeline(uint32_t index) {
+    (void)index;
+}
+
+uint8_t* NullRenderDevice::mapped_data(uint32_t buffer) {
+    const BufferDesc& desc = _context->desc(BufferHandle{buffer, 0});
+    return desc.memory == RENDER_MEMORY_GPU ? nullptr : _buffers[buffer].data;
+}
+
+void NullRenderDevice::wait_frame(uint32_t slot) {
+    (void)slot;
+}
+
+bool NullRenderDevice::begin_frame(uint64_t frame_number, uint32_t slot) {
+    (void)slot;
+    _frame_number = frame_number;
+    _submitted_lists = 0;
+    _stats = NullRenderStats();
+    _captured.reset();
+    return true;
+}
+
+void NullRenderDevice::submit(CommandList* const* lists, uint32_t count) {
+    KY_PROFILE_SCOPE("NullRenderDevice::submit");
+    for (uint32_t i = 0; i < count; i++) {
+        _validate(*lists[i]);
+        if (_capture) {
+            _captured.append(*lists[i]);
+        }
+    }
+    _stats.command_lists += count;
+}
+
+void NullRenderDevice::end_frame() {
+    if (_pass_suspended) {
+        _stats.validation_errors++;
+        KY_ERROR_MSG("Frame %llu ended with a suspended render pass",
+                     (unsigned long long)_frame_number);
+        _pass_suspended = false;
+    }
+    if (_marker_depth > 0) {
+        _stats.validation_errors++;
+        KY_ERROR_MSG("Frame %llu ended with %u debug markers open",
+                     (unsigned long long)_frame_number, _marker_depth);
+        _marker_depth = 0;
+    }
+    _completed_frame = _frame_number;
+}
+
+void NullRenderDevice::wait_idle() {}
+
+uint64_t NullRenderDevice::completed_frame() {
+    return _completed_frame;
+}
+
+GpuMemoryStats NullRenderDevice::memory_stats() {
+    return _allocator.stats();
+}
+
+// Contents live in host copies that don't move, frames finish by the time the next one begins so
+// the old placements are freed right away
+uint32_t NullRenderDevice::defragment(uint32_t max_moves, uint64_t max_bytes) {
+    KY_PROFILE_SCOPE("NullRenderDevice::defragment");
+    if (_stats.command_lists > 0) {
+        _stats.validation_errors++;
+        KY_ERROR_MSG("Frame %llu defragmented after submitting command lists",
+                     (unsigned long long)_frame_number);
+        return 0;
+    }
+    uint32_t moved = _allocator.defragment(max_moves, max_bytes, _moves);
+    for (const GpuDefragmentationMove& move : _moves) {
+        _Buffer& buffer = _buffers[(uint32_t)move.user_data - 1];
+        _allocator.free(buffer.allocation);
+        buffer.allocation = move.destination;
+    }
+    return moved;
+}
+
+bool NullRenderDevice::swapchain_desc(TextureDesc& desc) {
+    (void)desc;
+    return false;
+}
+
+void NullRenderDevice::set_swapchain_texture(uint32_t index) {
+    (void)index;
+}
+
+uint64_t NullRenderDevice::pipeline_cache_id() {
+    // Keys only depend on pipeline descriptions and shader code, every run is compatible
+    return 1;
+}
+
+bool NullRenderDevice::load_pipeline_cache(const void* data, size_t size) {
+    KY_ERROR_CONDITION_MSG_RETURN(size % sizeof(uint64_t) == 0, false,
+                                  "Null pipeline cache isn't an array of keys");
+    const uint64_t* keys = (const uint64_t*)data;
+    size_t count = size / sizeof(uint64_t);
+    KY_ERROR_CONDITION_MSG_RETURN(std::is_sorted(keys, keys + count), false,
+                                  "Null pipeline cache keys aren't sorted");
+    std::lock_guard<std::mutex> lock(_pipeline_cache_mutex);
+    _pipeline_cache.assign(keys, keys + count);
+    return true;
+}
+
+bool NullRenderDevice::save_pipeline_cache(TaggedVector<uint8_t, MEMORY_TAG_RENDER>& data) {
+    std::lock_guard<std::mutex> lock(_pipeline_cache_mutex);
+    const uint8_t* bytes = (const uint8_t*)_pipeline_cache.data();
+    data.assign(bytes, bytes + _pipeline_cache.size() * sizeof(uint64_t));
+    return true;
+}
+
+void NullRenderDevice::_error(const _Validation& validation, const char* message) {
+    _stats.validation_errors++;
+    KY_ERROR_MSG("Invalid %s, command %u of list %u in frame %llu: %s",
+                 command_type_to_cstring(validation.command->type), validation.command_index,
+                 validation.list, (unsigned long long)_frame_number, message);
+}
+
+void NullRenderDevice::_validate(const CommandList& list) {
+    _Validation validation;
+    validation.list = _submitted_lists++;
+    list.for_each([&](const CommandHeader& command) {
+        validation.command = &command;
+        _stats.commands++;
+        if (_pass_suspended && command.type != COMMAND_BEGIN_RENDER_PASS) {
+            _error(validation, "suspended render pass has to be resumed first");
+            _pass_suspended = false;
+        }
+
+        switch (command.type) {
+            case COMMAND_BEGIN_RENDER_PASS:
+                _begin_render_pass(validation, command_data<CommandBeginRenderPass>(command).pass);
+                break;
+            case COMMAND_END_RENDER_PASS:
+                if (!validation.in_pass) {
+                    _error(validation, "no render pass to end");
+                    break;
+                }
+                validation.in_pass = false;
+                validation.pipeline_checked = false;
+                if (validation.pass.flags & RENDER_PASS_SUSPEND_BIT) {
+                    _pass_suspended = true;
+                    _suspended_pass = validation.pass;
+                }
+                break;
+            case COMMAND_BIND_PIPELINE: {
+                PipelineHandle pipeline = command_data<CommandBindPipeline>(command).pipeline;
+                if (!_context->usable(pipeline)) {
+                    _error(validation, "pipeline isn't alive");
+                    validation.pipeline = PipelineHandle();
+                    break;
+                }
+                validation.pipeline = pipeline;
+                validation.pipeline_checked = false;
+            } break;
+            case COMMAND_BIND_VERTEX_BUFFER: {
+                const CommandBindVertexBuffer& bind =
+                    command_data<CommandBindVertexBuffer>(command);
+                if (bind.slot >= KY_RHI_MAX_VERTEX_BUFFERS) {
+                    _error(validation, "vertex buffer slot out of range");
+                } else if (_check_buffer_range(validation, bind.buffer, bind.offset, 0)) {
+                    validation.vertex_buffers_bound |= 1u << bind.slot;
+                }
+            } break;
+            case COMMAND_BIND_INDEX_BUFFER: {
+                const CommandBindIndexBuffer& bind = command_data<CommandBindIndexBuffer>(command);
+                if (_check_buffer_range(validation, bind.buffer, bind.offset, 0)) {
+                    validation.index_buffer = bind.buffer;
+                    validation.index_type = bind.type;
+                    validation.index_offset = bind.offset;
+                }
+            } break;
+            case COMMAND_BIND_UNIFORM_BUFFER:
+            case COMMAND_BIND_STORAGE_BUFFER: {
+                const CommandBindBuffer& bind = command_data<CommandBindBuffer>(command);
+                uint32_t slots = command.type == COMMAND_BIND_UNIFORM_BUFFER
+                                     ? KY_RHI_UNIFORM_BUFFER_SLOTS
+                                     : KY_RHI_STORAGE_BUFFER_SLOTS;
+                if (bind.slot >= slots) {
+                    _error(validation, "buffer slot out of range");
+                } else {
+                    _check_buffer_range(validation, bind.buffer, bind.offset, bind.size);
+                }
+            } break;
+            case COMMAND_BIND_TEXTURE: {
+                const CommandBindTexture& bind = command_data<CommandBindTexture>(command);
+                if (bind.slot >= KY_RHI_TEXTURE_SLOTS) {
+                    _error(validation, "texture slot out of range");
+                } else if (!_context->usable(bind.texture) || !_context->usable(bind.sampler)) {
+                    _error(validation, "texture or sampler isn't alive");
+                } else {
+                    ResourceState state = _texture_states[bind.texture.index];
+                    if (state != RESOURCE_STATE_SHADER_READ &&
+                        state != RESOURCE_STATE_DEPTH_STENCIL_READ) {
+                        _error(validation, "sampled texture isn't in a shader readable state");
+                    }
+                }
+            } break;
+            case COMMAND_PUSH_CONSTANTS: {
+                const CommandPushConstants& push = command_data<CommandPushConstants>(command);
+                if (push.offset + push.size > KY_RHI_PUSH_CONSTANT_SIZE) {
+                    _error(validation, "push constants exceed KY_RHI_PUSH_CONSTANT_SIZE");
+                }
+            } break;
+            case COMMAND_SET_VIEWPORT:
+            case COMMAND_SET_SCISSOR:
+                break;
+            case COMMAND_DRAW: {
+                const CommandDraw& draw = command_data<CommandDraw>(command);
+                _check_pipeline(validation, false);
+                _stats.draws++;
+                _stats.instances += draw.instance_count;
+            } break;
+            case COMMAND_DRAW_INDEXED: {
+                const CommandDrawIndexed& draw = command_data<CommandDrawIndexed>(command);
+                _check_pipeline(validation, false);
+                if (!validation.index_buffer.valid()) {
+                    _error(validation, "no index buffer bound");
+                } else {
+                    uint64_t stride = validation.index_type == INDEX_TYPE_UINT16 ? 2 : 4;
+                    _check_buffer_range(validation, validation.index_buffer,
+                                        validation.index_offset + draw.first_index * stride,
+                                        draw.index_count * stride);
+                }
+                _stats.draws++;
+                _stats.instances += draw.instance_count;
+            } break;
+            case COMMAND_DISPATCH:
+                if (validation.in_pass) {
+                    _error(validation, "dispatches can't be inside a render pass");
+                }
+                _check_pipeline(validation, true);
+                _stats.dispatches++;
+                break;
+            case COMMAND_COPY_BUFFER: {
+                const CommandCopyBuffer& copy = command_data<CommandCopyBuffer>(command);
+                _stats.copies++;
+                if (validation.in_pass) {
+                    _error(validation, "copies can't be inside a render pass");
+                } else if (_check_buffer_range(validation, copy.source, copy.source_offset,
+                                               copy.size) &&
+                           _check_buffer_range(validation, copy.destination,
+                                               copy.destination_offset, copy.size)) {
+                    std::memmove(_buffers[copy.destination.index].data + copy.destination_offset,
+                                 _buffers[copy.source.index].data + copy.source_offset,
+                                 copy.size);
+                }
+            } break;
+            case COMMAND_COPY_BUFFER_TO_TEXTURE: {
+                const CommandCopyBufferToTexture& copy =
+                    command_data<CommandCopyBufferToTexture>(command);
+                _stats.copies++;
+                if (validation.in_pass) {
+                    _error(validation, "copies can't be inside a render pass");
+                    break;
+                }
+                if (!_context->usable(copy.destination)) {
+                    _error(validation, "texture isn't alive");
+                    break;
+                }
+                const TextureDesc& texture = _context->desc(copy.destination);
+                if (copy.mip_level >= texture.mip_levels ||
+                    copy.array_layer >= texture.array_layers) {
+                    _error(validation, "mip level or array layer out of range");
+                    break;
+                }
+                uint64_t width = std::max(texture.width >> copy.mip_level, 1u);
+                uint64_t height = std::max(texture.height >> copy.mip_level, 1u);
+                uint64_t depth = std::max(texture.depth >> copy.mip_level, 1u);
+                _check_buffer_range(validation, copy.source, copy.source_offset,
+                                    width * height * depth *
+                                        texture_format_size(texture.format));
+                if (_texture_states[copy.destination.index] != RESOURCE_STATE_TRANSFER_DST) {
+                    _error(validation, "destination texture isn't in RESOURCE_STATE_TRANSFER_DST");
+                }
+            } break;
+            case COMMAND_BARRIER:
+                if (validation.in_pass) {
+                    _error(validation, "barriers can't be inside a render pass");
+                }
+                _barrier(validation, command_data<CommandBarrier>(command));
+                break;
+            case COMMAND_BEGIN_MARKER:
+                _marker_depth++;
+                break;
+            case COMMAND_END_MARKER:
+                if (_marker_depth == 0) {
+                    _error(validation, "no debug marker to end");
+                } else {
+                    _marker_depth--;
+                }
+                break;
+            default:
+                _error(validation, "unknown command");
+                break;
+        }
+        validation.command_index++;
+    });
+
+    if (validation.in_pass) {
+        _error(validation, "command list ended inside a render pass");
+    }
+}
+
+void NullRenderDevice::_begin_render_pass(_Validation& validation, const RenderPassDesc& pass) {
+    if (validation.in_pass) {
+        _error(validation, "render passes can't be nested");
+    }
+    if (pass.flags & RENDER_PASS_RESUME_BIT) {
+        if (!_pass_suspended) {
+            _error(validation, "resumed render pass wasn't suspended");
+        } else if (!same_attachments(pass, _suspended_pass)) {
+            _error(validation, "resumed render pass has different attachments");
+        }
+    } else {
+        _stats.render_passes++;
+    }
+    _pass_suspended = false;
+    validation.in_pass = true;
+    validation.pass = pass;
+    validation.pipeline_checked = false;
+
+    if (pass.color_count > KY_RHI_MAX_COLOR_ATTACHMENTS) {
+        _error(validation, "too many color attachments");
+        validation.pass.color_count = 0;
+        return;
+    }
+    if (pass.color_count == 0 && !pass.depth.texture.valid()) {
+        _error(validation, "render pass has no attachments");
+    }
+    for (uint32_t i = 0; i < pass.color_count; i++) {
+        _check_attachment(validation, pass.colors[i].texture, RESOURCE_STATE_COLOR_ATTACHMENT);
+    }
+    if (pass.depth.texture.valid()) {
+        _check_attachment(validation, pass.depth.texture, RESOURCE_STATE_DEPTH_STENCIL_WRITE);
+    }
+}
+
+void NullRenderDevice::_check_attachment(_Validation& validation, TextureHandle texture,
+                                         ResourceState state) {
+    if (!_context->usable(texture)) {
+        _error(validation, "attachment isn't alive");
+        return;
+    }
+    ResourceState current = _texture_states[texture.index];
+    bool read_only_depth = state == RESOURCE_STATE_DEPTH_STENCIL_WRITE &&
+                           current == RESOURCE_STATE_DEPTH_STENCIL_READ;
+    if (current != state && !read_only_depth) {
+        _error(validation, state == RESOURCE_STATE_COLOR_ATTACHMENT
+                               ? "color attachment isn't in RESOURCE_STATE_COLOR_ATTACHMENT"
+                               : "depth attachment isn't in a depth stencil state");
+    }
+}
+
+void NullRenderDevice::_check_pipeline(_Validation& validation, bool compute) {
+    if (validation.pipeline_checked) {
+        return;
+    }
+    if (!compute && !validation.in_pass) {
+        _error(validation, "draws have to be inside a render pass");
+        return;
+    }
+    if (!validation.pipeline.valid()) {
+        _error(validation, "no pipeline bound");
+        return;
+    }
+
+    // Checked once per pipeline and pass, the draws in between share the result
+    validation.pipeline_checked = true;
+    const PipelineDesc& pipeline = _context->desc(validation.pipeline);
+    if (pipeline.compute_shader.valid() != compute) {
+        _error(validation, compute ? "bound pipeline isn't a compute pipeline"
+                                   : "bound pipeline is a compute pipeline");
+        return;
+    }
+    if (compute) {
+        return;
+    }
+
+    uint32_t required_bindings = (1u << pipeline.vertex_binding_count) - 1;
+    if ((validation.vertex_buffers_bound & required_bindings) != required_bindings) {
+        _error(validation, "pipeline reads vertex buffers that aren't bound");
+        validation.pipeline_checked = false;
+    }
+
+    const RenderPassDesc& pass = validation.pass;
+    if (pipeline.color_count != pass.color_count) {
+        _error(validation, "pipeline and render pass color attachment counts differ");
+        return;
+    }
+    for (uint32_t i = 0; i < pass.color_count; i++) {
+        if (_context->usable(pass.colors[i].texture) &&
+            _context->desc(pass.colors[i].texture).format != pipeline.color_formats[i]) {
+            _error(validation, "pipeline and render pass color formats differ");
+        }
+    }
+    TextureFormat depth_format = TEXTURE_FORMAT_UNDEFINED;
+    if (pass.depth.texture.valid() && _context->usable(pass.depth.texture)) {
+        depth_format = _context->desc(pass.depth.texture).format;
+    }
+    if (depth_format != pipeline.depth_format) {
+        _error(validation, "pipeline and render pass depth formats differ");
+    }
+}
+
+void NullRenderDevice::_barrier(_Validation& validation, const CommandBarrier& barrier) {
+    const BufferBarrier* buffers = command_trailing_data<CommandBarrier, BufferBarrier>(
+        *validation.command);
+    const TextureBarrier* textures = (const TextureBarrier*)(buffers + barrier.buffer_count);
+    _stats.barriers += barrier.buffer_count + barrier.texture_count;
+
+    // Transitions from RESOURCE_STATE_UNDEFINED discard the contents and are always valid
+    for (uint32_t i = 0; i < barrier.buffer_count; i++) {
+        if (!_context->usable(buffers[i].buffer)) {
+            _error(validation, "barrier buffer isn't alive");
+            continue;
+        }
+        ResourceState& state = _buffers[buffers[i].buffer.index].state;
+        if (buffers[i].before != RESOURCE_STATE_UNDEFINED && buffers[i].before != state) {
+            KY_ERROR_MSG("Buffer %u is in %s, not %s", buffers[i].buffer.index,
+                         resource_state_to_cstring(state),
+                         resource_state_to_cstring(buffers[i].before));
+            _error(validation, "buffer barrier starts from the wrong state");
+        }
+        state = buffers[i].after;
+    }
+    for (uint32_t i = 0; i < barrier.texture_count; i++) {
+        if (!_context->usable(textures[i].texture)) {
+            _error(validation, "barrier texture isn't alive");
+            continue;
+        }
+        ResourceState& state = _texture_states[textures[i].texture.index];
+        if (textures[i].before != RESOURCE_STATE_UNDEFINED && textures[i].before != state) {
+            KY_ERROR_MSG("Texture %u is in %s, not %s", textures[i].texture.index,
+                         resource_state_to_cstring(state),
+                         resource_state_to_cstring(textures[i].before));
+            _error(validation, "texture barrier starts from the wrong state");
+        }
+        state = textures[i].after;
+    }
+}
+
+bool NullRenderDevice::_check_buffer_range(_Validation& validation, BufferHandle buffer,
+                                           uint64_t offset, uint64_t size) {
+    if (!_context->usable(buffer)) {
+        _error(validation, "buffer isn't alive");
+        return false;
+    }
+    if (offset + size > _buffers[buffer.index].size) {
+        _error(validation, "range exceeds the buffer");
+        return false;
+    }
+    return true;
+}
+
+} // namespace ky
@@ -0,0 +1,164 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_RENDER_HARDWARE_NULL__NULL_DEVICE_H
+#define KRYOS_RENDER_HARDWARE_NULL__NULL_DEVICE_H
+
+#include "core/memory_tracker.h"
+#include "render_hardware/base/command_list.h"
+#include "render_hardware/base/device.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace ky {
+
+// Counters of the frame being recorded, reset by `begin_frame`.
+struct NullRenderStats {
+    uint32_t command_lists = 0;
+    uint64_t commands = 0;
+    uint32_t render_passes = 0;
+    uint64_t draws = 0;
+    uint64_t instances = 0;
+    uint32_t dispatches = 0;
+    uint32_t copies = 0;
+    uint32_t barriers = 0;
+    uint32_t validation_errors = 0;
+};
+
+// Backend without a GPU. Submitted command lists are validated against the rules the Vulkan
+// backend relies on, buffer copies are executed on host copies of every buffer and nothing is
+// drawn. Validation covers handle lifetimes, render pass nesting and suspension across lists,
+// pipeline and attachment compatibility, bound state, buffer ranges, marker balance and the
+// resource states declared by barriers. Violations are reported as errors and counted.
+//
+// Resources are placed in simulated memory blocks with the alignments and granularity of a
+// typical desktop GPU, so memory stats and defragmentation behave as they would on Vulkan.
+class NullRenderDevice final : public RenderDevice {
+public:
+    bool init(RenderContext& context, const RenderContextDesc& desc) override;
+    void shutdown() override;
+
+    bool create_buffer(uint32_t index, const BufferDesc& desc, const void* data) override;
+    bool create_texture(uint32_t index, const TextureDesc& desc, const void* data) override;
+    bool create_sampler(uint32_t index, const SamplerDesc& desc) override;
+    bool create_shader(uint32_t index, const ShaderDesc& desc) override;
+    bool create_pipeline(uint32_t index, const PipelineDesc& desc) override;
+    void destroy_buffer(uint32_t index) override;
+    void destroy_texture(uint32_t index) override;
+    void destroy_sampler(uint32_t index) override;
+    void destroy_shader(uint32_t index) override;
+    void destroy_pipeline(uint32_t index) override;
+
+    uint8_t* mapped_data(uint32_t buffer) override;
+
+    void wait_frame(uint32_t slot) override;
+    bool begin_frame(uint64_t frame_number, uint32_t slot) override;
+    void submit(CommandList* const* lists, uint32_t count) override;
+    void end_frame() override;
+    void wait_idle() override;
+    uint64_t completed_frame() override;
+
+    bool swapchain_desc(TextureDesc& desc) override;
+    void set_swapchain_texture(uint32_t index) override;
+
+    uint64_t pipeline_cache_id() override;
+    bool load_pipeline_cache(const void* data, size_t size) override;
+    bool save_pipeline_cache(TaggedVector<uint8_t, MEMORY_TAG_RENDER>& data) override;
+
+    GpuMemoryStats memory_stats() override;
+    uint32_t defragment(uint32_t max_moves, uint64_t max_bytes) override;
+
+    inline const NullRenderStats& stats() const { return _stats; }
+
+    // Contents of any buffer, including GPU only ones.
+    inline uint8_t* buffer_data(uint32_t buffer) { return _buffers[buffer].data; }
+    inline ResourceState buffer_state(uint32_t buffer) const { return _buffers[buffer].state; }
+    inline ResourceState texture_state(uint32_t texture) const { return _texture_states[texture]; }
+
+    // Keeps a copy of every command submitted this frame, off by default since copying the
+    // streams costs as much as validating them.
+    inline void set_capture(bool capture) { _capture = capture; }
+    inline const CommandList& captured_commands() const { return _captured; }
+
+    // Pipelines created since init that were already in the pipeline cache, loaded or filled by
+    // earlier pipelines, and ones that weren't.
+    inline uint32_t pipeline_cache_hits() const { return _pipeline_cache_hits; }
+    inline uint32_t pipeline_cache_misses() const { return _pipeline_cache_misses; }
+
+private:
+    struct _Buffer {
+        uint8_t* data = nullptr;
+        uint64_t size = 0;
+        ResourceState state = RESOURCE_STATE_UNDEFINED;
+        GpuAllocation allocation;
+    };
+
+    // Walks one list, passes suspended at its end carry over into the next one
+    struct _Validation {
+        const CommandHeader* command = nullptr;
+        uint32_t list = 0;
+        uint32_t command_index = 0;
+
+        bool in_pass = false;
+        RenderPassDesc pass;
+        PipelineHandle pipeline;
+        bool pipeline_checked = false;
+        uint32_t vertex_buffers_bound = 0;
+        BufferHandle index_buffer;
+        IndexType index_type = INDEX_TYPE_UINT32;
+        uint64_t index_offset = 0;
+    };
+
+    RenderContext* _context = nullptr;
+    TaggedVector<_Buffer, MEMORY_TAG_RENDER> _buffers;
+    TaggedVector<ResourceState, MEMORY_TAG_RENDER> _texture_states;
+    TaggedVector<GpuAllocation, MEMORY_TAG_RENDER> _texture_allocations;
+    GpuAllocator _allocator;
+    TaggedVector<GpuDefragmentationMove, MEMORY_TAG_RENDER> _moves;
+
+    uint64_t _frame_number = 0;
+    uint64_t _completed_frame = 0;
+    uint32_t _submitted_lists = 0;
+    bool _pass_suspended = false;
+    RenderPassDesc _suspended_pass;
+    uint32_t _marker_depth = 0;
+
+    bool _capture = false;
+    CommandList _captured;
+    NullRenderStats _stats;
+
+    // The pipeline cache blob is the sorted keys of every pipeline created, keyed by the code of
+    // their shaders rather than the handles so they match between runs
+    TaggedVector<uint64_t, MEMORY_TAG_RENDER> _shader_hashes;
+    std::mutex _pipeline_cache_mutex;
+    TaggedVector<uint64_t, MEMORY_TAG_RENDER> _pipeline_cache;
+    uint32_t _pipeline_cache_hits = 0;
+    uint32_t _pipeline_cache_misses = 0;
+
+    void _validate(const CommandList& list);
+    void _error(const _Validation& validation, const char* message);
+    void _begin_render_pass(_Validation& validation, const RenderPassDesc& pass);
+    void _check_pipeline(_Validation& validation, bool compute);
+    void _check_attachment(_Validation& validation, TextureHandle texture, ResourceState state);
+    void _barrier(_Validation& validation, const CommandBarrier& barrier);
+    bool _check_buffer_range(_Validation& validation, BufferHandle buffer, uint64_t offset,
+                             uint64_t size);
+};
+
+} // namespace ky
+
+#endif
@@ -0,0 +1,2034 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "render_hardware/vulkan/vulkan_device.h"
+#include "core/error.h"
+#include "core/hash.h"
+#include "core/jobs.h"
+#include "core/memory.h"
+#include "core/profiler.h"
+#include "render_hardware/base/context.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+namespace ky {
+
+// Stages, accesses and image layout a resource is used with in each `ResourceState`
+struct VulkanStateInfo {
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2 access;
+    VkImageLayout layout;
+};
+
+static const VkPipelineStageFlags2 all_shader_stages = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+                                                       VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT |
+                                                       VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+static const VkPipelineStageFlags2 fragment_test_stages =
+    VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+
+static const VulkanStateInfo state_infos[RESOURCE_STATE_COUNT] = {
+    // RESOURCE_STATE_UNDEFINED
+    {VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED},
+    // RESOURCE_STATE_VERTEX_BUFFER
+    {VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT,
+     VK_IMAGE_LAYOUT_UNDEFINED},
+    // RESOURCE_STATE_INDEX_BUFFER
+    {VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED},
+    // RESOURCE_STATE_UNIFORM_BUFFER
+    {all_shader_stages, VK_ACCESS_2_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED},
+    // RESOURCE_STATE_INDIRECT_ARGUMENT
+    {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+     VK_IMAGE_LAYOUT_UNDEFINED},
+    // RESOURCE_STATE_SHADER_READ
+    {all_shader_stages, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+    // RESOURCE_STATE_SHADER_WRITE
+    {all_shader_stages, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT,
+     VK_IMAGE_LAYOUT_GENERAL},
+    // RESOURCE_STATE_COLOR_ATTACHMENT
+    {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+     VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+     VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+    // RESOURCE_STATE_DEPTH_STENCIL_WRITE
+    {fragment_test_stages,
+     VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+         VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+     VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL},
+    // RESOURCE_STATE_DEPTH_STENCIL_READ
+    {fragment_test_stages | all_shader_stages,
+     VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT,
+     VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL},
+    // RESOURCE_STATE_TRANSFER_SRC
+    {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL},
+    // RESOURCE_STATE_TRANSFER_DST
+    {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL},
+    // RESOURCE_STATE_PRESENT
+    {VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR},
+};
+
+static const VkFormat texture_formats[TEXTURE_FORMAT_COUNT] = {
+    VK_FORMAT_UNDEFINED,
+    VK_FORMAT_R8_UNORM,
+    VK_FORMAT_R8G8_UNORM,
+    VK_FORMAT_R8G8B8A8_UNORM,
+    VK_FORMAT_R8G8B8A8_SRGB,
+    VK_FORMAT_B8G8R8A8_UNORM,
+    VK_FORMAT_B8G8R8A8_SRGB,
+    VK_FORMAT_R16_SFLOAT,
+    VK_FORMAT_R16G16_SFLOAT,
+    VK_FORMAT_R16G16B16A16_SFLOAT,
+    VK_FORMAT_R32_SFLOAT,
+    VK_FORMAT_R32G32_SFLOAT,
+    VK_FORMAT_R32G32B32A32_SFLOAT,
+    VK_FORMAT_R32_UINT,
+    VK_FORMAT_A2B10G10R10_UNORM_PACK32,
+    VK_FORMAT_B10G11R11_UFLOAT_PACK32,
+    VK_FORMAT_D16_UNORM,
+    VK_FORMAT_D32_SFLOAT,
+    VK_FORMAT_D24_UNORM_S8_UINT,
+    VK_FORMAT_D32_SFLOAT_S8_UINT,
+};
+
+static const VkFormat vertex_formats[VERTEX_FORMAT_COUNT] = {
+    VK_FORMAT_R32_SFLOAT,
+    VK_FORMAT_R32G32_SFLOAT,
+    VK_FORMAT_R32G32B32_SFLOAT,
+    VK_FORMAT_R32G32B32A32_SFLOAT,
+    VK_FORMAT_R32_UINT,
+    VK_FORMAT_R32G32_UINT,
+    VK_FORMAT_R32G32B32A32_UINT,
+    VK_FORMAT_R8G8B8A8_UNORM,
+    VK_FORMAT_R16G16_SFLOAT,
+    VK_FORMAT_R16G16B16A16_SFLOAT,
+};
+
+static const VkShaderStageFlagBits shader_stages[SHADER_STAGE_COUNT] = {
+    VK_SHADER_STAGE_VERTEX_BIT,
+    VK_SHADER_STAGE_FRAGMENT_BIT,
+    VK_SHADER_STAGE_COMPUTE_BIT,
+};
+
+static const VkPrimitiveTopology topologies[] = {
+    VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+    VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+    VK_PRIMITIVE_TOPOLOGY_LINE_LIST,
+    VK_PRIMITIVE_TOPOLOGY_LINE_STRIP,
+    VK_PRIMITIVE_TOPOLOGY_POINT_LIST,
+};
+
+static const VkCullModeFlags cull_modes[] = {
+    VK_CULL_MODE_NONE,
+    VK_CULL_MODE_FRONT_BIT,
+    VK_CULL_MODE_BACK_BIT,
+};
+
+static const VkCompareOp compare_ops[] = {
+    VK_COMPARE_OP_NEVER,
+    VK_COMPARE_OP_LESS,
+    VK_COMPARE_OP_EQUAL,
+    VK_COMPARE_OP_LESS_OR_EQUAL,
+    VK_COMPARE_OP_GREATER,
+    VK_COMPARE_OP_NOT_EQUAL,
+    VK_COMPARE_OP_GREATER_OR_EQUAL,
+    VK_COMPARE_OP_ALWAYS,
+};
+
+static const VkAttachmentLoadOp load_ops[] = {
+    VK_ATTACHMENT_LOAD_OP_LOAD,
+    VK_ATTACHMENT_LOAD_OP_CLEAR,
+    VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+};
+
+static const VkAttachmentStoreOp store_ops[] = {
+    VK_ATTACHMENT_STORE_OP_STORE,
+    VK_ATTACHMENT_STORE_OP_DONT_CARE,
+};
+
+static const VkSamplerAddressMode address_modes[] = {
+    VK_SAMPLER_ADDRESS_MODE_REPEAT,
+    VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT,
+    VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+};
+
+static bool vk_check(VkResult result, const char* call) {
+    if (result != VK_SUCCESS) {
+        KY_ERROR_MSG("%s failed with VkResult %d", call, (int)result);
+        return false;
+    }
+    return true;
+}
+
+static TextureFormat texture_format_from_vulkan(VkFormat format) {
+    for (uint32_t i = 0; i < TEXTURE_FORMAT_COUNT; i++) {
+        if (texture_formats[i] == format) {
+            return (TextureFormat)i;
+        }
+    }
+    return TEXTURE_FORMAT_UNDEFINED;
+}
+
+static VkPipelineColorBlendAttachmentState blend_state(BlendMode mode) {
+    VkPipelineColorBlendAttachmentState state = {};
+    state.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                           VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    if (mode == BLEND_MODE_NONE) {
+        return state;
+    }
+    state.blendEnable = VK_TRUE;
+    state.colorBlendOp = VK_BLEND_OP_ADD;
+    state.alphaBlendOp = VK_BLEND_OP_ADD;
+    state.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    switch (mode) {
+        case BLEND_MODE_ALPHA:
+            state.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            break;
+        case BLEND_MODE_PREMULTIPLIED_ALPHA:
+            state.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            break;
+        default:
+            state.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            break;
+    }
+    return state;
+}
+
+static VKAPI_ATTR VkBool32 VKAPI_CALL
+debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+               VkDebugUtilsMessageTypeFlagsEXT types,
+               const VkDebugUtilsMessengerCallbackDataEXT* data, void* user_data) {
+    (void)types;
+    (void)user_data;
+    if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+        KY_ERROR_MSG("Vulkan: %s", data->pMessage);
+    } else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+        KY_WARNING_MSG("Vulkan: %s", data->pMessage);
+    }
+    return VK_FALSE;
+}
+
+bool VulkanRenderDevice::init(RenderContext& context, const RenderContextDesc& desc) {
+    _context = &context;
+    _vsync = desc.vsync;
+    if (desc.window.valid() && desc.window.glfw_handle() != nullptr) {
+        _window = desc.window;
+    }
+    _buffers.assign(KY_RHI_MAX_BUFFERS, _Buffer());
+    _textures.assign(KY_RHI_MAX_TEXTURES, _Texture());
+    _samplers.assign(KY_RHI_MAX_SAMPLERS, VK_NULL_HANDLE);
+    _shaders.assign(KY_RHI_MAX_SHADERS, _Shader());
+    _pipelines.assign(KY_RHI_MAX_PIPELINES, _Pipeline());
+
+    if (!_create_instance(desc)) {
+        return false;
+    }
+    if (_window.valid() && !vk_check(glfwCreateWindowSurface(_instance, _window.glfw_handle(),
+                                                             nullptr, &_surface),
+                                     "glfwCreateWindowSurface")) {
+        return false;
+    }
+    return _select_physical_device() && _create_device() && _create_allocator() &&
+           _create_layouts() && _create_frames() &&
+           (_surface == VK_NULL_HANDLE || _create_swapchain());
+}
+
+void VulkanRenderDevice::shutdown() {
+    if (_device != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(_device);
+        _destroy_swapchain();
+        for (_Frame& frame : _frames) {
+            _release_retired(frame);
+        }
+        for (uint32_t i = 0; i < _buffers.size(); i++) {
+            destroy_buffer(i);
+        }
+        for (uint32_t i = 0; i < _textures.size(); i++) {
+            if (i != _swapchain_texture) {
+                destroy_texture(i);
+            }
+        }
+        for (uint32_t i = 0; i < _samplers.size(); i++) {
+            destroy_sampler(i);
+        }
+        for (uint32_t i = 0; i < _shaders.size(); i++) {
+            destroy_shader(i);
+        }
+        for (uint32_t i = 0; i < _pipelines.size(); i++) {
+            destroy_pipeline(i);
+        }
+
+        for (_Frame& frame : _frames) {
+            for (_ThreadPools& pools : frame.threads) {
+                vkDestroyCommandPool(_device, pools.command_pool, nullptr);
+                for (VkDescriptorPool pool : pools.descriptor_pools) {
+                    vkDestroyDescriptorPool(_device, pool, nullptr);
+                }
+            }
+            vkDestroyFence(_device, frame.fence, nullptr);
+            vkDestroySemaphore(_device, frame.acquired, nullptr);
+            frame = _Frame();
+        }
+        vkDestroyCommandPool(_device, _upload_pool, nullptr);
+        _allocator.shutdown();
+        vkDestroyPipelineCache(_device, _pipeline_cache, nullptr);
+        vkDestroyPipelineLayout(_device, _pipeline_layout, nullptr);
+        vkDestroyDescriptorSetLayout(_device, _set_layout, nullptr);
+        vkDestroyDevice(_device, nullptr);
+        _device = VK_NULL_HANDLE;
+    }
+    if (_instance != VK_NULL_HANDLE) {
+        if (_surface != VK_NULL_HANDLE) {
+            vkDestroySurfaceKHR(_instance, _surface, nullptr);
+            _surface = VK_NULL_HANDLE;
+        }
+        if (_messenger != VK_NULL_HANDLE) {
+            auto destroy_messenger = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(
+                _instance, "vkDestroyDebugUtilsMessengerEXT");
+            destroy_messenger(_instance, _messenger, nullptr);
+            _messenger = VK_NULL_HANDLE;
+        }
+        vkDestroyInstance(_instance, nullptr);
+        _instance = VK_NULL_HANDLE;
+    }
+    _buffers.clear();
+    _textures.clear();
+    _samplers.clear();
+    _shaders.clear();
+    _pipelines.clear();
+    _context = nullptr;
+}
+
+bool VulkanRenderDevice::_create_instance(const RenderContextDesc& desc) {
+    ScratchScope scratch;
+    uint32_t available_count = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &available_count, nullptr);
+    VkExtensionProperties* available = scratch.allocate<VkExtensionProperties>(available_count);
+    vkEnumerateInstanceExtensionProperties(nullptr, &available_count, available);
+    bool debug_utils = false;
+    for (uint32_t i = 0; i < available_count; i++) {
+        if (std::strcmp(available[i].extensionName, VK_EXT_DEBUG_UTILS_EXTENSION_NAME) == 0) {
+            debug_utils = true;
+        }
+    }
+
+    uint32_t window_extension_count = 0;
+    const char** window_extensions = nullptr;
+    if (_window.valid()) {
+        window_extensions = glfwGetRequiredInstanceExtensions(&window_extension_count);
+        KY_ERROR_CONDITION_MSG_RETURN(window_extensions != nullptr, false,
+                                      "Vulkan can't present to windows on this system");
+    }
+    const char** extensions = scratch.allocate<const char*>(window_extension_count + 1);
+    uint32_t extension_count = 0;
+    for (uint32_t i = 0; i < window_extension_count; i++) {
+        extensions[extension_count++] = window_extensions[i];
+    }
+    if (debug_utils) {
+        extensions[extension_count++] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
+    }
+
+    const char* validation_layer = "VK_LAYER_KHRONOS_validation";
+    bool validation = false;
+    if (desc.validation) {
+        uint32_t layer_count = 0;
+        vkEnumerateInstanceLayerProperties(&layer_count, nullptr);
+        VkLayerProperties* layers = scratch.allocate<VkLayerProperties>(layer_count);
+        vkEnumerateInstanceLayerProperties(&layer_count, layers);
+        for (uint32_t i = 0; i < layer_count; i++) {
+            if (std::strcmp(layers[i].layerName, validation_layer) == 0) {
+                validation = true;
+            }
+        }
+        if (!validation) {
+            KY_WARNING_MSG("Vulkan validation layers requested but not installed");
+        }
+    }
+
+    VkApplicationInfo application = {};
+
+    application.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    application.pApplicationName = desc.application_name;
+    application.pEngineName = "Kryos Engine";
+    application.apiVersion = VK_API_VERSION_1_3;
+
+    VkInstanceCreateInfo info = {};
+
+    info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    info.pApplicationInfo = &application;
+    info.enabledExtensionCount = extension_count;
+    info.ppEnabledExtensionNames = extensions;
+    info.enabledLayerCount = validation ? 1 : 0;
+    info.ppEnabledLayerNames = &validation_layer;
+    if (!vk_check(vkCreateInstance(&info, nullptr, &_instance), "vkCreateInstance")) {
+        return false;
+    }
+
+    if (debug_utils) {
+        _cmd_begin_label = (PFN_vkCmdBeginDebugUtilsLabelEXT)vkGetInstanceProcAddr(
+            _instance, "vkCmdBeginDebugUtilsLabelEXT");
+        _cmd_end_label = (PFN_vkCmdEndDebugUtilsLabelEXT)vkGetInstanceProcAddr(
+            _instance, "vkCmdEndDebugUtilsLabelEXT");
+        _set_object_name = (PFN_vkSetDebugUtilsObjectNameEXT)vkGetInstanceProcAddr(
+            _instance, "vkSetDebugUtilsObjectNameEXT");
+    }
+    if (debug_utils && validation) {
+        VkDebugUtilsMessengerCreateInfoEXT messenger = {};
+        messenger.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+        messenger.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
+                                    VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+        messenger.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
+                                VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+                                VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+        messenger.pfnUserCallback = debug_callback;
+        auto create_messenger = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(
+            _instance, "vkCreateDebugUtilsMessengerEXT");
+        vk_check(create_messenger(_instance, &messenger, nullptr, &_messenger),
+                 "vkCreateDebugUtilsMessengerEXT");
+    }
+    return true;
+}
+
+bool VulkanRenderDevice::_select_physical_device() {
+    ScratchScope scratch;
+    uint32_t device_count = 0;
+    vkEnumeratePhysicalDevices(_instance, &device_count, nullptr);
+    VkPhysicalDevice* devices = scratch.allocate<VkPhysicalDevice>(device_count);
+    vkEnumeratePhysicalDevices(_instance, &device_count, devices);
+
+    // Discrete GPUs are preferred over integrated ones, which are preferred over the rest
+    int32_t best_score = -1;
+    for (uint32_t i = 0; i < device_count; i++) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(devices[i], &properties);
+        if (properties.apiVersion < VK_API_VERSION_1_3) {
+            continue;
+        }
+
+        uint32_t family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(devices[i], &family_count, nullptr);
+        VkQueueFamilyProperties* families =
+            scratch.allocate<VkQueueFamilyProperties>(family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(devices[i], &family_count, families);
+        uint32_t family = UINT32_MAX;
+        for (uint32_t j = 0; j < family_count && family == UINT32_MAX; j++) {
+            VkQueueFlags required = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+            VkBool32 present = VK_TRUE;
+            if (_surface != VK_NULL_HANDLE) {
+                vkGetPhysicalDeviceSurfaceSupportKHR(devices[i], j, _surface, &present);
+            }
+            if ((families[j].queueFlags & required) == required && present) {
+                family = j;
+            }
+        }
+        if (family == UINT32_MAX) {
+            continue;
+        }
+
+        int32_t score = 0;
+        if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
+            score = 2;
+        } else if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU) {
+            score = 1;
+        }
+        if (score > best_score) {
+            best_score = score;
+            _physical_device = devices[i];
+            _properties = properties;
+            _queue_family = family;
+        }
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(_physical_device != VK_NULL_HANDLE, false,
+                                  "No GPU supports Vulkan 1.3");
+    vkGetPhysicalDeviceMemoryProperties(_physical_device, &_memory_properties);
+    return true;
+}
+
+bool VulkanRenderDevice::_create_device() {
+    VkPhysicalDeviceFeatures supported;
+    vkGetPhysicalDeviceFeatures(_physical_device, &supported);
+    _features = {};
+    _features.samplerAnisotropy = supported.samplerAnisotropy;
+    _features.fillModeNonSolid = supported.fillModeNonSolid;
+
+    VkPhysicalDeviceVulkan13Features features_13 = {};
+
+    features_13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    features_13.dynamicRendering = VK_TRUE;
+    features_13.synchronization2 = VK_TRUE;
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &features_13;
+    features.features = _features;
+
+    float priority = 1.0f;
+    VkDeviceQueueCreateInfo queue = {};
+    queue.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queue.queueFamilyIndex = _queue_family;
+    queue.queueCount = 1;
+    queue.pQueuePriorities = &priority;
+
+    const char* swapchain_extension = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+    VkDeviceCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    info.pNext = &features;
+    info.queueCreateInfoCount = 1;
+    info.pQueueCreateInfos = &queue;
+    info.enabledExtensionCount = _surface != VK_NULL_HANDLE ? 1 : 0;
+    info.ppEnabledExtensionNames = &swapchain_extension;
+    if (!vk_check(vkCreateDevice(_physical_device, &info, nullptr, &_device), "vkCreateDevice")) {
+        return false;
+    }
+    vkGetDeviceQueue(_device, _queue_family, 0, &_queue);
+    return true;
+}
+
+bool VulkanRenderDevice::_create_layouts() {
+    constexpr uint32_t binding_count =
+        KY_RHI_UNIFORM_BUFFER_SLOTS + KY_RHI_STORAGE_BUFFER_SLOTS + KY_RHI_TEXTURE_SLOTS;
+    VkDescriptorSetLayoutBinding bindings[binding_count] = {};
+    for (uint32_t i = 0; i < binding_count; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+        if (i < KY_RHI_UNIFORM_BUFFER_SLOTS) {
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        } else if (i < KY_RHI_UNIFORM_BUFFER_SLOTS + KY_RHI_STORAGE_BUFFER_SLOTS) {
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        } else {
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        }
+    }
+    VkDescriptorSetLayoutCreateInfo set_info = {};
+    set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_info.bindingCount = binding_count;
+    set_info.pBindings = bindings;
+    if (!vk_check(vkCreateDescriptorSetLayout(_device, &set_info, nullptr, &_set_layout),
+                  "vkCreateDescriptorSetLayout")) {
+        return false;
+    }
+
+    VkPushConstantRange push_constants = {VK_SHADER_STAGE_ALL, 0, KY_RHI_PUSH_CONSTANT_SIZE};
+    VkPipelineLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &_set_layout;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constants;
+    if (!vk_check(vkCreatePipelineLayout(_device, &layout_info, nullptr, &_pipeline_layout),
+                  "vkCreatePipelineLayout")) {
+        return false;
+    }
+
+    // Starts out empty, the context loads the blob of the previous run before any pipeline is
+    // created
+    VkPipelineCacheCreateInfo cache_info = {};
+    cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    return vk_check(vkCreatePipelineCache(_device, &cache_info, nullptr, &_pipeline_cache),
+                    "vkCreatePipelineCache");
+}
+
+bool VulkanRenderDevice::_create_frames() {
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_info.queueFamilyIndex = _queue_family;
+    if (!vk_check(vkCreateCommandPool(_device, &pool_info, nullptr, &_upload_pool),
+                  "vkCreateCommandPool")) {
+        return false;
+    }
+
+    VkFenceCreateInfo fence_info = {};
+
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkSemaphoreCreateInfo semaphore_info = {};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    for (_Frame& frame : _frames) {
+        if (!vk_check(vkCreateFence(_device, &fence_info, nullptr, &frame.fence),
+                      "vkCreateFence") ||
+            !vk_check(vkCreateSemaphore(_device, &semaphore_info, nullptr, &frame.acquired),
+                      "vkCreateSemaphore")) {
+            return false;
+        }
+        // Every thread of the job system may translate command lists
+        frame.threads.resize(JobSystem::thread_count());
+        for (_ThreadPools& pools : frame.threads) {
+            if (!vk_check(vkCreateCommandPool(_device, &pool_info, nullptr, &pools.command_pool),
+                          "vkCreateCommandPool")) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool VulkanRenderDevice::_create_swapchain() {
+    VkSurfaceCapabilitiesKHR capabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(_physical_device, _surface, &capabilities);
+    VkExtent2D extent = capabilities.currentExtent;
+    if (extent.width == UINT32_MAX) {
+        glm::ivec2 size = _window.framebuffer_size();
+        extent.width = std::clamp((uint32_t)size.x, capabilities.minImageExtent.width,
+                                  capabilities.maxImageExtent.width);
+        extent.height = std::clamp((uint32_t)size.y, capabilities.minImageExtent.height,
+                                   capabilities.maxImageExtent.height);
+    }
+    // Minimized windows have no swapchain until they're restored
+    if (extent.width == 0 || extent.height == 0) {
+        _swapchain_outdated = true;
+        return true;
+    }
+
+    ScratchScope scratch;
+    uint32_t format_count = 0;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(_physical_device, _surface, &format_count, nullptr);
+    VkSurfaceFormatKHR* formats = scratch.allocate<VkSurfaceFormatKHR>(format_count);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(_physical_device, _surface, &format_count, formats);
+    VkSurfaceFormatKHR format = {VK_FORMAT_UNDEFINED, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+    for (uint32_t i = 0; i < format_count; i++) {
+        bool srgb = formats[i].format == VK_FORMAT_B8G8R8A8_SRGB ||
+                    formats[i].format == VK_FORMAT_R8G8B8A8_SRGB;
+        if (srgb && formats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+            format = formats[i];
+            break;
+        }
+        if (format.format == VK_FORMAT_UNDEFINED &&
+            texture_format_from_vulkan(formats[i].format) != TEXTURE_FORMAT_UNDEFINED) {
+            format = formats[i];
+        }
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(format.format != VK_FORMAT_UNDEFINED, false,
+                                  "Window surface has no supported format");
+
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    if (!_vsync) {
+        uint32_t mode_count = 0;
+        vkGetPhysicalDeviceSurfacePresentModesKHR(_physical_device, _surface, &mode_count,
+                                                  nullptr);
+        VkPresentModeKHR* modes = scratch.allocate<VkPresentModeKHR>(mode_count);
+        vkGetPhysicalDeviceSurfacePresentModesKHR(_physical_device, _surface, &mode_count, modes);
+        for (uint32_t i = 0; i < mode_count; i++) {
+            if (modes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
+                present_mode = modes[i];
+                break;
+            }
+            if (modes[i] == VK_PRESENT_MODE_IMMEDIATE_KHR) {
+                present_mode = modes[i];
+            }
+        }
+    }
+
+    uint32_t image_count = capabilities.minImageCount + 1;
+    if (capabilities.maxImageCount > 0) {
+        image_count = std::min(image_count, capabilities.maxImageCount);
+    }
+    image_count = std::min(image_count, (uint32_t)KY_VULKAN_MAX_SWAPCHAIN_IMAGES);
+
+    VkSwapchainCreateInfoKHR info = {};
+
+    info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    info.surface = _surface;
+    info.minImageCount = image_count;
+    info.imageFormat = format.format;
+    info.imageColorSpace = format.colorSpace;
+    info.imageExtent = extent;
+    info.imageArrayLayers = 1;
+    info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.preTransform = capabilities.currentTransform;
+    info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    info.presentMode = present_mode;
+    info.clipped = VK_TRUE;
+    if (!vk_check(vkCreateSwapchainKHR(_device, &info, nullptr, &_swapchain),
+                  "vkCreateSwapchainKHR")) {
+        return false;
+    }
+    _swapchain_format = format.format;
+    _swapchain_extent = extent;
+    _swapchain_outdated = false;
+
+    _swapchain_image_count = KY_VULKAN_MAX_SWAPCHAIN_IMAGES;
+    vkGetSwapchainImagesKHR(_device, _swapchain, &_swapchain_image_count, _swapchain_images);
+    VkSemaphoreCreateInfo semaphore_info = {};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    for (uint32_t i = 0; i < _swapchain_image_count; i++) {
+        VkImageViewCreateInfo view_info = {};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = _swapchain_images[i];
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = _swapchain_format;
+        view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        if (!vk_check(vkCreateImageView(_device, &view_info, nullptr, &_swapchain_views[i]),
+                      "vkCreateImageView") ||
+            !vk_check(vkCreateSemaphore(_device, &semaphore_info, nullptr, &_rendered[i]),
+                      "vkCreateSemaphore")) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void VulkanRenderDevice::_destroy_swapchain() {
+    for (uint32_t i = 0; i < _swapchain_image_count; i++) {
+        vkDestroyImageView(_device, _swapchain_views[i], nullptr);
+        vkDestroySemaphore(_device, _rendered[i], nullptr);
+        _swapchain_views[i] = VK_NULL_HANDLE;
+        _rendered[i] = VK_NULL_HANDLE;
+    }
+    _swapchain_image_count = 0;
+    if (_swapchain != VK_NULL_HANDLE) {
+        vkDestroySwapchainKHR(_device, _swapchain, nullptr);
+        _swapchain = VK_NULL_HANDLE;
+    }
+}
+
+int32_t VulkanRenderDevice::_memory_type(uint32_t type_bits,
+                                         VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < _memory_properties.memoryTypeCount; i++) {
+        if ((type_bits & (1u << i)) &&
+            (_memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
+
+// Blocks of host visible memory types are mapped for their whole lifetime
+bool VulkanRenderDevice::_allocate_block(void* user_data, uint32_t memory_type, uint64_t size,
+                                         GpuMemoryBlock& block) {
+    VulkanRenderDevice& device = *(VulkanRenderDevice*)user_data;
+    VkMemoryAllocateInfo info = {};
+
+    info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    info.allocationSize = size;
+    info.memoryTypeIndex = memory_type;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (!vk_check(vkAllocateMemory(device._device, &info, nullptr, &memory),
+                  "vkAllocateMemory")) {
+        return false;
+    }
+    VkMemoryPropertyFlags flags = device._memory_properties.memoryTypes[memory_type].propertyFlags;
+    if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+        !vk_check(vkMapMemory(device._device, memory, 0, VK_WHOLE_SIZE, 0,
+                              (void**)&block.mapped),
+                  "vkMapMemory")) {
+        vkFreeMemory(device._device, memory, nullptr);
+        return false;
+    }
+    block.handle = (uint64_t)memory;
+    return true;
+}
+
+void VulkanRenderDevice::_free_block(void* user_data, uint32_t, const GpuMemoryBlock& block) {
+    VulkanRenderDevice& device = *(VulkanRenderDevice*)user_data;
+    VkDeviceMemory memory = (VkDeviceMemory)block.handle;
+    if (block.mapped != nullptr) {
+        vkUnmapMemory(device._device, memory);
+    }
+    vkFreeMemory(device._device, memory, nullptr);
+}
+
+bool VulkanRenderDevice::_create_allocator() {
+    // Buffers and optimally tiled images closer than this alias each other's pages
+    uint64_t granularity = 1;
+    while (granularity < _properties.limits.bufferImageGranularity) {
+        granularity <<= 1;
+    }
+    GpuAllocatorDesc desc;
+    desc.memory_type_count = _memory_properties.memoryTypeCount;
+    desc.granularity = granularity;
+    desc.allocate_block = _allocate_block;
+    desc.free_block = _free_block;
+    desc.user_data = this;
+    return _allocator.init(desc);
+}
+
+bool VulkanRenderDevice::_allocate_memory(const VkMemoryRequirements& requirements,
+                                          VkMemoryPropertyFlags properties,
+                                          VkMemoryPropertyFlags fallback,
+                                          const GpuAllocationDesc& desc,
+                                          GpuAllocation& allocation) {
+    int32_t type = _memory_type(requirements.memoryTypeBits, properties);
+    if (type < 0) {
+        type = _memory_type(requirements.memoryTypeBits, fallback);
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(type >= 0, false, "No suitable GPU memory type");
+
+    GpuAllocationDesc allocation_desc = desc;
+    allocation_desc.size = requirements.size;
+    allocation_desc.alignment = requirements.alignment;
+    allocation_desc.memory_type = (uint32_t)type;
+    return _allocator.allocate(allocation_desc, allocation);
+}
+
+void VulkanRenderDevice::_set_name(VkObjectType type, uint64_t object, const char* name) {
+    if (_set_object_name == nullptr || name == nullptr) {
+        return;
+    }
+    VkDebugUtilsObjectNameInfoEXT info = {};
+    info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+    info.objectType = type;
+    info.objectHandle = object;
+    info.pObjectName = name;
+    _set_object_name(_device, &info);
+}
+
+bool VulkanRenderDevice::create_buffer(uint32_t index, const BufferDesc& desc,
+                                       const void* data) {
+    VkBufferCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = desc.size;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if (desc.usage & BUFFER_USAGE_VERTEX_BIT) {
+        info.usage |= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    }
+    if (desc.usage & BUFFER_USAGE_INDEX_BIT) {
+        info.usage |= VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    }
+    if (desc.usage & BUFFER_USAGE_UNIFORM_BIT) {
+        info.usage |= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    }
+    if (desc.usage & BUFFER_USAGE_STORAGE_BIT) {
+        info.usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    }
+    if (desc.usage & BUFFER_USAGE_INDIRECT_BIT) {
+        info.usage |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    }
+
+    _Buffer& buffer = _buffers[index];
+    buffer.info = info;
+    if (!vk_check(vkCreateBuffer(_device, &info, nullptr, &buffer.buffer), "vkCreateBuffer")) {
+        return false;
+    }
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(_device, buffer.buffer, &requirements);
+    VkMemoryPropertyFlags host_visible =
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    // Mapped buffers stay where they are, GPU only ones can be copied elsewhere
+    GpuAllocationDesc allocation_desc;
+    bool allocated = false;
+    switch (desc.memory) {
+        case RENDER_MEMORY_UPLOAD:
+            // Prefers memory the GPU reads fast when the CPU can write it directly
+            allocated = _allocate_memory(requirements,
+                                         host_visible | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                         host_visible, allocation_desc, buffer.allocation);
+            break;
+        case RENDER_MEMORY_READBACK:
+            allocated = _allocate_memory(requirements,
+                                         host_visible | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                                         host_visible, allocation_desc, buffer.allocation);
+            break;
+        default:
+            allocation_desc.user_data = (uint64_t)index + 1;
+            allocated = _allocate_memory(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+                                         allocation_desc, buffer.allocation);
+            break;
+    }
+    if (!allocated ||
+        !vk_check(vkBindBufferMemory(_device, buffer.buffer,
+                                     (VkDeviceMemory)_allocator.block(buffer.allocation).handle,
+                                     buffer.allocation.offset),
+                  "vkBindBufferMemory")) {
+        destroy_buffer(index);
+        return false;
+    }
+    if (desc.memory != RENDER_MEMORY_GPU) {
+        buffer.mapped = _allocator.mapped(buffer.allocation);
+    }
+    _set_name(VK_OBJECT_TYPE_BUFFER, (uint64_t)buffer.buffer, desc.name);
+
+    if (data != nullptr) {
+        if (buffer.mapped != nullptr) {
+            std::memcpy(buffer.mapped, data, desc.size);
+        } else if (!_upload(buffer.buffer, data, desc.size)) {
+            destroy_buffer(index);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool VulkanRenderDevice::create_texture(uint32_t index, const TextureDesc& desc,
+                                        const void* data) {
+    VkImageCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    info.imageType = desc.type == TEXTURE_TYPE_3D ? VK_IMAGE_TYPE_3D : VK_IMAGE_TYPE_2D;
+    info.format = texture_formats[desc.format];
+    info.extent = {desc.width, desc.height, desc.depth};
+    info.mipLevels = desc.mip_levels;
+    info.arrayLayers = desc.array_layers;
+    info.samples = (VkSampleCountFlagBits)desc.samples;
+    info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (desc.type == TEXTURE_TYPE_CUBE) {
+        info.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+    }
+    if (desc.usage & TEXTURE_USAGE_SAMPLED_BIT) {
+        info.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+    }
+    if (desc.usage & TEXTURE_USAGE_STORAGE_BIT) {
+        info.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    }
+    if (desc.usage & TEXTURE_USAGE_COLOR_ATTACHMENT_BIT) {
+        info.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    }
+    if (desc.usage & TEXTURE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+        info.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    }
+    if (desc.usage & TEXTURE_USAGE_TRANSFER_SRC_BIT) {
+        info.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+    if ((desc.usage & TEXTURE_USAGE_TRANSFER_DST_BIT) || data != nullptr) {
+        info.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
+
+    _Texture& texture = _textures[index];
+    if (texture_format_has_depth(desc.format)) {
+        texture.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        if (texture_format_has_stencil(desc.format)) {
+            texture.aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+    } else {
+        texture.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+    if (!vk_check(vkCreateImage(_device, &info, nullptr, &texture.image), "vkCreateImage")) {
+        return false;
+    }
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(_device, texture.image, &requirements);
+    GpuAllocationDesc allocation_desc;
+    allocation_desc.kind = GPU_ALLOCATION_OPTIMAL;
+    if (!_allocate_memory(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, allocation_desc,
+                          texture.allocation) ||
+        !vk_check(vkBindImageMemory(_device, texture.image,
+                                    (VkDeviceMemory)_allocator.block(texture.allocation).handle,
+                                    texture.allocation.offset),
+                  "vkBindImageMemory")) {
+        destroy_texture(index);
+        return false;
+    }
+
+    VkImageViewCreateInfo view_info = {};
+
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = texture.image;
+    view_info.format = info.format;
+    switch (desc.type) {
+        case TEXTURE_TYPE_3D:
+            view_info.viewType = VK_IMAGE_VIEW_TYPE_3D;
+            break;
+        case TEXTURE_TYPE_CUBE:
+            view_info.viewType =
+                desc.array_layers > 6 ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE;
+            break;
+        default:
+            view_info.viewType =
+                desc.array_layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+            break;
+    }
+    // Sampling reads depth only, the stencil aspect is written through attachments
+    VkImageAspectFlags view_aspect =
+        texture.aspect & VK_IMAGE_ASPECT_DEPTH_BIT ? (VkImageAspectFlags)VK_IMAGE_ASPECT_DEPTH_BIT
+                                                   : texture.aspect;
+    view_info.subresourceRange = {view_aspect, 0, desc.mip_levels, 0, desc.array_layers};
+    if (!vk_check(vkCreateImageView(_device, &view_info, nullptr, &texture.view),
+                  "vkCreateImageView")) {
+        destroy_texture(index);
+        return false;
+    }
+    _set_name(VK_OBJECT_TYPE_IMAGE, (uint64_t)texture.image, desc.name);
+
+    if (data != nullptr && !_upload(texture, desc, data)) {
+        destroy_texture(index);
+        return false;
+    }
+    return true;
+}
+
+bool VulkanRenderDevice::create_sampler(uint32_t index, const SamplerDesc& desc) {
+    VkSamplerCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    info.minFilter = desc.min_filter == SAMPLER_FILTER_NEAREST ? VK_FILTER_NEAREST
+                                                               : VK_FILTER_LINEAR;
+    info.magFilter = desc.mag_filter == SAMPLER_FILTER_NEAREST ? VK_FILTER_NEAREST
+                                                               : VK_FILTER_LINEAR;
+    info.mipmapMode = desc.mip_filter == SAMPLER_FILTER_NEAREST
+                          ? VK_SAMPLER_MIPMAP_MODE_NEAREST
+                          : VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    info.addressModeU = address_modes[desc.address_u];
+    info.addressModeV = address_modes[desc.address_v];
+    info.addressModeW = address_modes[desc.address_w];
+    info.anisotropyEnable = _features.samplerAnisotropy && desc.max_anisotropy > 1.0f;
+    info.maxAnisotropy =
+        std::min(desc.max_anisotropy, _properties.limits.maxSamplerAnisotropy);
+    info.minLod = desc.min_lod;
+    info.maxLod = desc.max_lod;
+    if (!vk_check(vkCreateSampler(_device, &info, nullptr, &_samplers[index]),
+                  "vkCreateSampler")) {
+        return false;
+    }
+    _set_name(VK_OBJECT_TYPE_SAMPLER, (uint64_t)_samplers[index], desc.name);
+    return true;
+}
+
+bool VulkanRenderDevice::create_shader(uint32_t index, const ShaderDesc& desc) {
+    VkShaderModuleCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    info.codeSize = desc.code_size;
+    info.pCode = desc.code;
+    _Shader& shader = _shaders[index];
+    if (!vk_check(vkCreateShaderModule(_device, &info, nullptr, &shader.module),
+                  "vkCreateShaderModule")) {
+        return false;
+    }
+    shader.stage = shader_stages[desc.stage];
+    const char* entry_point = desc.entry_point != nullptr ? desc.entry_point : "main";
+    std::strncpy(shader.entry_point, entry_point, sizeof(shader.entry_point) - 1);
+    _set_name(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)shader.module, desc.name);
+    return true;
+}
+
+bool VulkanRenderDevice::create_pipeline(uint32_t index, const PipelineDesc& desc) {
+    _Pipeline& pipeline = _pipelines[index];
+    if (desc.compute_shader.valid()) {
+        const _Shader& shader = _shaders[desc.compute_shader.index];
+        VkComputePipelineCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        info.stage = {};
+        info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        info.stage.module = shader.module;
+        info.stage.pName = shader.entry_point;
+        info.layout = _pipeline_layout;
+        pipeline.bind_point = VK_PIPELINE_BIND_POINT_COMPUTE;
+        if (!vk_check(vkCreateComputePipelines(_device, _pipeline_cache, 1, &info, nullptr,
+                                               &pipeline.pipeline),
+                      "vkCreateComputePipelines")) {
+            return false;
+        }
+        _set_name(VK_OBJECT_TYPE_PIPELINE, (uint64_t)pipeline.pipeline, desc.name);
+        return true;
+    }
+
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    uint32_t stage_count = 0;
+    for (ShaderHandle handle : {desc.vertex_shader, desc.fragment_shader}) {
+        if (!handle.valid()) {
+            continue;
+        }
+        const _Shader& shader = _shaders[handle.index];
+        VkPipelineShaderStageCreateInfo& stage = stages[stage_count++];
+        stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stage.stage = shader.stage;
+        stage.module = shader.module;
+        stage.pName = shader.entry_point;
+    }
+
+    VkVertexInputBindingDescription bindings[KY_RHI_MAX_VERTEX_BUFFERS];
+    for (uint32_t i = 0; i < desc.vertex_binding_count; i++) {
+        bindings[i].binding = i;
+        bindings[i].stride = desc.vertex_bindings[i].stride;
+        bindings[i].inputRate = desc.vertex_bindings[i].per_instance
+                                    ? VK_VERTEX_INPUT_RATE_INSTANCE
+                                    : VK_VERTEX_INPUT_RATE_VERTEX;
+    }
+    VkVertexInputAttributeDescription attributes[KY_RHI_MAX_VERTEX_ATTRIBUTES];
+    for (uint32_t i = 0; i < desc.vertex_attribute_count; i++) {
+        const VertexAttribute& attribute = desc.vertex_attributes[i];
+        attributes[i] = {attribute.location, attribute.binding, vertex_formats[attribute.format],
+                         attribute.offset};
+    }
+    VkPipelineVertexInputStateCreateInfo vertex_input = {};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input.vertexBindingDescriptionCount = desc.vertex_binding_count;
+    vertex_input.pVertexBindingDescriptions = bindings;
+    vertex_input.vertexAttributeDescriptionCount = desc.vertex_attribute_count;
+    vertex_input.pVertexAttributeDescriptions = attributes;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = topologies[desc.topology];
+
+    // Viewport and scissor are dynamic, render passes set them to the rendered area
+    VkPipelineViewportStateCreateInfo viewport = {};
+    viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+    VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic = {};
+    dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic.dynamicStateCount = 2;
+    dynamic.pDynamicStates = dynamic_states;
+
+    VkPipelineRasterizationStateCreateInfo rasterization = {};
+
+    rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterization.polygonMode = desc.wireframe && _features.fillModeNonSolid
+                                    ? VK_POLYGON_MODE_LINE
+                                    : VK_POLYGON_MODE_FILL;
+    rasterization.cullMode = cull_modes[desc.cull_mode];
+    rasterization.frontFace =
+        desc.front_clockwise ? VK_FRONT_FACE_CLOCKWISE : VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterization.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample = {};
+
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = (VkSampleCountFlagBits)desc.samples;
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+
+    depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil.depthTestEnable = desc.depth_test;
+    depth_stencil.depthWriteEnable = desc.depth_write;
+    depth_stencil.depthCompareOp = compare_ops[desc.depth_compare];
+
+    VkPipelineColorBlendAttachmentState blends[KY_RHI_MAX_COLOR_ATTACHMENTS];
+    VkFormat color_formats[KY_RHI_MAX_COLOR_ATTACHMENTS];
+    for (uint32_t i = 0; i < desc.color_count; i++) {
+        blends[i] = blend_state(desc.blend_modes[i]);
+        color_formats[i] = texture_formats[desc.color_formats[i]];
+    }
+    VkPipelineColorBlendStateCreateInfo blend = {};
+    blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    blend.attachmentCount = desc.color_count;
+    blend.pAttachments = blends;
+
+    VkPipelineRenderingCreateInfo rendering = {};
+
+    rendering.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    rendering.colorAttachmentCount = desc.color_count;
+    rendering.pColorAttachmentFormats = color_formats;
+    if (texture_format_has_depth(desc.depth_format)) {
+        rendering.depthAttachmentFormat = texture_formats[desc.depth_format];
+    }
+    if (texture_format_has_stencil(desc.depth_format)) {
+        rendering.stencilAttachmentFormat = texture_formats[desc.depth_format];
+    }
+
+    VkGraphicsPipelineCreateInfo info = {};
+
+    info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    info.pNext = &rendering;
+    info.stageCount = stage_count;
+    info.pStages = stages;
+    info.pVertexInputState = &vertex_input;
+    info.pInputAssemblyState = &input_assembly;
+    info.pViewportState = &viewport;
+    info.pRasterizationState = &rasterization;
+    info.pMultisampleState = &multisample;
+    info.pDepthStencilState = &depth_stencil;
+    info.pColorBlendState = &blend;
+    info.pDynamicState = &dynamic;
+    info.layout = _pipeline_layout;
+    pipeline.bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    if (!vk_check(vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &info, nullptr,
+                                            &pipeline.pipeline),
+                  "vkCreateGraphicsPipelines")) {
+        return false;
+    }
+    _set_name(VK_OBJECT_TYPE_PIPELINE, (uint64_t)pipeline.pipeline, desc.name);
+    return true;
+}
+
+void VulkanRenderDevice::destroy_buffer(uint32_t index) {
+    _Buffer& buffer = _buffers[index];
+    vkDestroyBuffer(_device, buffer.buffer, nullptr);
+    _allocator.free(buffer.allocation);
+    buffer = _Buffer();
+}
+
+void VulkanRenderDevice::destroy_texture(uint32_t index) {
+    _Texture& texture = _textures[index];
+    vkDestroyImageView(_device, texture.view, nullptr);
+    vkDestroyImage(_device, texture.image, nullptr);
+    _allocator.free(texture.allocation);
+    texture = _Texture();
+}
+
+void VulkanRenderDevice::destroy_sampler(uint32_t index) {
+    vkDestroySampler(_device, _samplers[index], nullptr);
+    _samplers[index] = VK_NULL_HANDLE;
+}
+
+void VulkanRenderDevice::destroy_shader(uint32_t index) {
+    vkDestroyShaderModule(_device, _shaders[index].module, nullptr);
+    _shaders[index] = _Shader();
+}
+
+void VulkanRenderDevice::destroy_pipeline(uint32_t index) {
+    vkDestroyPipeline(_device, _pipelines[index].pipeline, nullptr);
+    _pipelines[index] = _Pipeline();
+}
+
+uint8_t* VulkanRenderDevice::mapped_data(uint32_t buffer) {
+    return _buffers[buffer].mapped;
+}
+
+VkCommandBuffer VulkanRenderDevice::_begin_upload() {
+    VkCommandBufferAllocateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    info.commandPool = _upload_pool;
+    info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    info.commandBufferCount = 1;
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    if (!vk_check(vkAllocateCommandBuffers(_device, &info, &command_buffer),
+                  "vkAllocateCommandBuffers")) {
+        return VK_NULL_HANDLE;
+    }
+    VkCommandBufferBeginInfo begin = {};
+    begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(command_buffer, &begin);
+    return command_buffer;
+}
+
+// Blocks until the upload finished, initial data isn't on a hot path
+bool VulkanRenderDevice::_end_upload(VkCommandBuffer command_buffer) {
+    vkEndCommandBuffer(command_buffer);
+    VkFenceCreateInfo fence_info = {};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkFence fence = VK_NULL_HANDLE;
+    bool success = vk_check(vkCreateFence(_device, &fence_info, nullptr, &fence), "vkCreateFence");
+    if (success) {
+        VkCommandBufferSubmitInfo buffer_info = {};
+        buffer_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+        buffer_info.commandBuffer = command_buffer;
+        VkSubmitInfo2 submit = {};
+        submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+        submit.commandBufferInfoCount = 1;
+        submit.pCommandBufferInfos = &buffer_info;
+        success = vk_check(vkQueueSubmit2(_queue, 1, &submit, fence), "vkQueueSubmit2") &&
+                  vk_check(vkWaitForFences(_device, 1, &fence, VK_TRUE, UINT64_MAX),
+                           "vkWaitForFences");
+        vkDestroyFence(_device, fence, nullptr);
+    }
+    vkFreeCommandBuffers(_device, _upload_pool, 1, &command_buffer);
+    return success;
+}
+
+bool VulkanRenderDevice::_create_staging(uint64_t size, const void* data, _Buffer& staging) {
+    VkBufferCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = size;
+    info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (!vk_check(vkCreateBuffer(_device, &info, nullptr, &staging.buffer), "vkCreateBuffer")) {
+        return false;
+    }
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(_device, staging.buffer, &requirements);
+    VkMemoryPropertyFlags host_visible =
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    if (!_allocate_memory(requirements, host_visible, host_visible, GpuAllocationDesc(),
+                          staging.allocation) ||
+        !vk_check(vkBindBufferMemory(_device, staging.buffer,
+                                     (VkDeviceMemory)_allocator.block(staging.allocation).handle,
+                                     staging.allocation.offset),
+                  "vkBindBufferMemory")) {
+        _destroy_staging(staging);
+        return false;
+    }
+    staging.mapped = _allocator.mapped(staging.allocation);
+    std::memcpy(staging.mapped, data, size);
+    return true;
+}
+
+void VulkanRenderDevice::_destroy_staging(_Buffer& staging) {
+    vkDestroyBuffer(_device, staging.buffer, nullptr);
+    _allocator.free(staging.allocation);
+    staging = _Buffer();
+}
+
+bool VulkanRenderDevice::_upload(VkBuffer destination, const void* data, uint64_t size) {
+    _Buffer staging;
+    if (!_create_staging(size, data, staging)) {
+        return false;
+    }
+    bool success = false;
+    {
+        std::lock_guard<std::mutex> lock(_queue_mutex);
+        VkCommandBuffer command_buffer = _begin_upload();
+        if (command_buffer != VK_NULL_HANDLE) {
+            VkBufferCopy region = {0, 0, size};
+            vkCmdCopyBuffer(command_buffer, staging.buffer, destination, 1, &region);
+            success = _end_upload(command_buffer);
+        }
+    }
+    _destroy_staging(staging);
+    return success;
+}
+
+bool VulkanRenderDevice::_upload(const _Texture& texture, const TextureDesc& desc,
+                                 const void* data) {
+    // Depth stencil textures are copied into their depth aspect only
+    VkImageAspectFlags copy_aspect = texture.aspect & VK_IMAGE_ASPECT_DEPTH_BIT
+                                         ? (VkImageAspectFlags)VK_IMAGE_ASPECT_DEPTH_BIT
+                                         : texture.aspect;
+    uint32_t texel_size = texture_format_size(desc.format);
+    ScratchScope scratch;
+    VkBufferImageCopy* regions =
+        scratch.allocate<VkBufferImageCopy>(desc.mip_levels * desc.array_layers);
+    uint64_t size = 0;
+    uint32_t region_count = 0;
+    for (uint32_t layer = 0; layer < desc.array_layers; layer++) {
+        for (uint32_t mip = 0; mip < desc.mip_levels; mip++) {
+            VkBufferImageCopy& region = regions[region_count++];
+            region = {};
+            region.bufferOffset = size;
+            region.imageSubresource = {copy_aspect, mip, layer, 1};
+            region.imageExtent = {std::max(desc.width >> mip, 1u),
+                                  std::max(desc.height >> mip, 1u),
+                                  std::max(desc.depth >> mip, 1u)};
+            size += (uint64_t)region.imageExtent.width * region.imageExtent.height *
+                    region.imageExtent.depth * texel_size;
+        }
+    }
+
+    _Buffer staging;
+    if (!_create_staging(size, data, staging)) {
+        return false;
+    }
+    bool success = false;
+    {
+        std::lock_guard<std::mutex> lock(_queue_mutex);
+        VkCommandBuffer command_buffer = _begin_upload();
+        if (command_buffer != VK_NULL_HANDLE) {
+            // Ends in the state `RenderContext::create_texture` documents for initial data
+            VkImageMemoryBarrier2 barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = texture.image;
+            barrier.subresourceRange = {texture.aspect, 0, desc.mip_levels, 0,
+                                        desc.array_layers};
+            barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+            barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            VkDependencyInfo dependency = {};
+            dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            dependency.imageMemoryBarrierCount = 1;
+            dependency.pImageMemoryBarriers = &barrier;
+            vkCmdPipelineBarrier2(command_buffer, &dependency);
+
+            vkCmdCopyBufferToImage(command_buffer, staging.buffer, texture.image,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, region_count, regions);
+
+            const VulkanStateInfo& read = state_infos[RESOURCE_STATE_SHADER_READ];
+            barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+            barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+            barrier.dstStageMask = read.stages;
+            barrier.dstAccessMask = read.access;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = read.layout;
+            vkCmdPipelineBarrier2(command_buffer, &dependency);
+            success = _end_upload(command_buffer);
+        }
+    }
+    _destroy_staging(staging);
+    return success;
+}
+
+void VulkanRenderDevice::wait_frame(uint32_t slot) {
+    _Frame& frame = _frames[slot];
+    if (!frame.submitted) {
+        return;
+    }
+    KY_PROFILE_SCOPE("VulkanRenderDevice::wait_frame");
+    vk_check(vkWaitForFences(_device, 1, &frame.fence, VK_TRUE, UINT64_MAX), "vkWaitForFences");
+    frame.submitted = false;
+    _completed_frame = std::max(_completed_frame, frame.frame_number);
+    _release_retired(frame);
+}
+
+void VulkanRenderDevice::_release_retired(_Frame& frame) {
+    for (const _Retired& retired : frame.retired) {
+        vkDestroyBuffer(_device, retired.buffer, nullptr);
+        _allocator.free(retired.allocation);
+    }
+    frame.retired.clear();
+}
+
+bool VulkanRenderDevice::begin_frame(uint64_t frame_number, uint32_t slot) {
+    _frame_slot = slot;
+    _Frame& frame = _frames[slot];
+    frame.frame_number = frame_number;
+    frame.command_buffers.clear();
+    for (_ThreadPools& pools : frame.threads) {
+        vkResetCommandPool(_device, pools.command_pool, 0);
+        pools.command_buffers_used = 0;
+        for (uint32_t i = 0; i < pools.descriptor_pools_used; i++) {
+            vkResetDescriptorPool(_device, pools.descriptor_pools[i], 0);
+        }
+        pools.descriptor_pools_used = 0;
+    }
+
+    _image_acquired = false;
+    if (_surface == VK_NULL_HANDLE) {
+        return true;
+    }
+    if (_swapchain_outdated || _window.resized()) {
+        wait_idle();
+        _destroy_swapchain();
+        if (!_create_swapchain()) {
+            return false;
+        }
+    }
+    if (_swapchain == VK_NULL_HANDLE) {
+        return false;
+    }
+
+    VkResult result = vkAcquireNextImageKHR(_device, _swapchain, UINT64_MAX, frame.acquired,
+                                            VK_NULL_HANDLE, &_image_index);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        _swapchain_outdated = true;
+        return false;
+    }
+    if (result == VK_SUBOPTIMAL_KHR) {
+        _swapchain_outdated = true;
+    } else if (!vk_check(result, "vkAcquireNextImageKHR")) {
+        return false;
+    }
+    _image_acquired = true;
+    _Texture& texture = _textures[_swapchain_texture];
+    texture.image = _swapchain_images[_image_index];
+    texture.view = _swapchain_views[_image_index];
+    texture.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    return true;
+}
+
+VkCommandBuffer VulkanRenderDevice::_begin_command_buffer(_ThreadPools& pools) {
+    if (pools.command_buffers_used == pools.command_buffers.size()) {
+        VkCommandBufferAllocateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        info.commandPool = pools.command_pool;
+        info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        info.commandBufferCount = 1;
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        vk_check(vkAllocateCommandBuffers(_device, &info, &command_buffer),
+                 "vkAllocateCommandBuffers");
+        pools.command_buffers.push_back(command_buffer);
+    }
+    VkCommandBuffer command_buffer = pools.command_buffers[pools.command_buffers_used++];
+
+    VkCommandBufferBeginInfo begin = {};
+
+    begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(command_buffer, &begin);
+    return command_buffer;
+}
+
+void VulkanRenderDevice::submit(CommandList* const* lists, uint32_t count) {
+    KY_PROFILE_SCOPE("VulkanRenderDevice::submit");
+    _Frame& frame = _frames[_frame_slot];
+    size_t first = frame.command_buffers.size();
+    frame.command_buffers.resize(first + count);
+    VkCommandBuffer* command_buffers = frame.command_buffers.data() + first;
+
+    JobSystem::parallel_for(count, [&](size_t i) {
+        // Runs serially when called from outside the job system
+        uint32_t thread = JobSystem::thread_index();
+        if (thread == KY_JOB_INVALID_THREAD) {
+            thread = 0;
+        }
+        KY_FATAL_CONDITION_MSG(thread < frame.threads.size(),
+                               "The render context has to be created after the job system");
+        _ThreadPools& pools = frame.threads[thread];
+        VkCommandBuffer command_buffer = _begin_command_buffer(pools);
+        _translate(*lists[i], command_buffer, pools);
+        vkEndCommandBuffer(command_buffer);
+        command_buffers[i] = command_buffer;
+    });
+}
+
+void VulkanRenderDevice::end_frame() {
+    KY_PROFILE_SCOPE("VulkanRenderDevice::end_frame");
+    _Frame& frame = _frames[_frame_slot];
+    ScratchScope scratch;
+    uint32_t buffer_count = (uint32_t)frame.command_buffers.size();
+    VkCommandBufferSubmitInfo* buffer_infos =
+        scratch.allocate<VkCommandBufferSubmitInfo>(buffer_count);
+    for (uint32_t i = 0; i < buffer_count; i++) {
+        buffer_infos[i] = {};
+        buffer_infos[i].sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+        buffer_infos[i].commandBuffer = frame.command_buffers[i];
+    }
+
+    VkSemaphoreSubmitInfo wait = {};
+
+    wait.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    wait.semaphore = frame.acquired;
+    wait.stageMask =
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    VkSemaphoreSubmitInfo signal = {};
+    signal.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    signal.semaphore = _rendered[_image_index];
+    signal.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+    VkSubmitInfo2 submit = {};
+
+    submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    submit.commandBufferInfoCount = buffer_count;
+    submit.pCommandBufferInfos = buffer_infos;
+    if (_image_acquired) {
+        submit.waitSemaphoreInfoCount = 1;
+        submit.pWaitSemaphoreInfos = &wait;
+        submit.signalSemaphoreInfoCount = 1;
+        submit.pSignalSemaphoreInfos = &signal;
+    }
+
+    std::lock_guard<std::mutex> lock(_queue_mutex);
+    vkResetFences(_device, 1, &frame.fence);
+    if (!vk_check(vkQueueSubmit2(_queue, 1, &submit, frame.fence), "vkQueueSubmit2")) {
+        return;
+    }
+    frame.submitted = true;
+
+    if (_image_acquired) {
+        VkPresentInfoKHR present = {};
+        present.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        present.waitSemaphoreCount = 1;
+        present.pWaitSemaphores = &_rendered[_image_index];
+        present.swapchainCount = 1;
+        present.pSwapchains = &_swapchain;
+        present.pImageIndices = &_image_index;
+        VkResult result = vkQueuePresentKHR(_queue, &present);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+            _swapchain_outdated = true;
+        } else {
+            vk_check(result, "vkQueuePresentKHR");
+        }
+        _image_acquired = false;
+    }
+}
+
+void VulkanRenderDevice::wait_idle() {
+    std::lock_guard<std::mutex> lock(_queue_mutex);
+    vkDeviceWaitIdle(_device);
+    for (_Frame& frame : _frames) {
+        if (frame.submitted) {
+            frame.submitted = false;
+            _completed_frame = std::max(_completed_frame, frame.frame_number);
+            _release_retired(frame);
+        }
+    }
+}
+
+GpuMemoryStats VulkanRenderDevice::memory_stats() {
+    return _allocator.stats();
+}
+
+// Moved buffers are copied by a command buffer submitted ahead of the frame's lists, which are
+// translated after this and bind the new buffers. Frames still in flight keep using the old ones,
+// retired until this frame's slot is waited on.
+uint32_t VulkanRenderDevice::defragment(uint32_t max_moves, uint64_t max_bytes) {
+    KY_PROFILE_SCOPE("VulkanRenderDevice::defragment");
+    _Frame& frame = _frames[_frame_slot];
+    KY_ERROR_CONDITION_MSG_RETURN(frame.command_buffers.empty(), 0,
+                                  "Defragmentation has to run before the frame's first submit");
+    if (_allocator.defragment(max_moves, max_bytes, _moves) == 0) {
+        return 0;
+    }
+
+    VkCommandBuffer command_buffer = _begin_command_buffer(frame.threads[0]);
+    // Earlier frames may still write the buffers being copied
+    VkMemoryBarrier2 barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    VkDependencyInfo dependency = {};
+    dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency.memoryBarrierCount = 1;
+    dependency.pMemoryBarriers = &barrier;
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+
+    uint32_t moved = 0;
+    for (const GpuDefragmentationMove& move : _moves) {
+        _Buffer& buffer = _buffers[(uint32_t)move.user_data - 1];
+        VkBuffer destination = VK_NULL_HANDLE;
+        if (!vk_check(vkCreateBuffer(_device, &buffer.info, nullptr, &destination),
+                      "vkCreateBuffer") ||
+            !vk_check(vkBindBufferMemory(
+                              _device, destination,
+                              (VkDeviceMemory)_allocator.block(move.destination).handle,
+                              move.destination.offset),
+                      "vkBindBufferMemory")) {
+            vkDestroyBuffer(_device, destination, nullptr);
+            _allocator.free(move.destination);
+            continue;
+        }
+        VkBufferCopy region = {0, 0, buffer.info.size};
+        vkCmdCopyBuffer(command_buffer, buffer.buffer, destination, 1, &region);
+        frame.retired.push_back({buffer.buffer, buffer.allocation});
+        buffer.buffer = destination;
+        buffer.allocation = move.destination;
+        moved++;
+    }
+
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+    vkEndCommandBuffer(command_buffer);
+    frame.command_buffers.push_back(command_buffer);
+    return moved;
+}
+
+uint64_t VulkanRenderDevice::completed_frame() {
+    for (_Frame& frame : _frames) {
+        if (frame.submitted && vkGetFenceStatus(_device, frame.fence) == VK_SUCCESS) {
+            _completed_frame = std::max(_completed_frame, frame.frame_number);
+        }
+    }
+    return _completed_frame;
+}
+
+bool VulkanRenderDevice::swapchain_desc(TextureDesc& desc) {
+    if (_surface == VK_NULL_HANDLE) {
+        return false;
+    }
+    desc = TextureDesc();
+    desc.format = texture_format_from_vulkan(_swapchain_format);
+    desc.width = _swapchain_extent.width;
+    desc.height = _swapchain_extent.height;
+    desc.usage = TEXTURE_USAGE_COLOR_ATTACHMENT_BIT | TEXTURE_USAGE_TRANSFER_DST_BIT;
+    return true;
+}
+
+void VulkanRenderDevice::set_swapchain_texture(uint32_t index) {
+    _swapchain_texture = index;
+}
+
+uint64_t VulkanRenderDevice::pipeline_cache_id() {
+    // Drivers reject blobs of other devices, checking the driver version too also catches blobs
+    // an updated driver would silently ignore
+    uint32_t ids[3] = {_properties.vendorID, _properties.deviceID, _properties.driverVersion};
+    return hash_bytes(_properties.pipelineCacheUUID, VK_UUID_SIZE, hash_bytes(ids, sizeof(ids)));
+}
+
+bool VulkanRenderDevice::load_pipeline_cache(const void* data, size_t size) {
+    VkPipelineCacheHeaderVersionOne header;
+    KY_ERROR_CONDITION_MSG_RETURN(size >= sizeof(header), false, "Pipeline cache is truncated");
+    std::memcpy(&header, data, sizeof(header));
+    bool compatible = header.headerSize >= sizeof(header) && header.headerSize <= size &&
+                      header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+                      header.vendorID == _properties.vendorID &&
+                      header.deviceID == _properties.deviceID &&
+                      std::memcmp(header.pipelineCacheUUID, _properties.pipelineCacheUUID,
+                                  VK_UUID_SIZE) == 0;
+    if (!compatible) {
+        return false;
+    }
+
+    VkPipelineCacheCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    info.initialDataSize = size;
+    info.pInitialData = data;
+    VkPipelineCache cache;
+    if (!vk_check(vkCreatePipelineCache(_device, &info, nullptr, &cache),
+                  "vkCreatePipelineCache")) {
+        return false;
+    }
+    vkDestroyPipelineCache(_device, _pipeline_cache, nullptr);
+    _pipeline_cache = cache;
+    return true;
+}
+
+bool VulkanRenderDevice::save_pipeline_cache(TaggedVector<uint8_t, MEMORY_TAG_RENDER>& data) {
+    size_t size = 0;
+    if (!vk_check(vkGetPipelineCacheData(_device, _pipeline_cache, &size, nullptr),
+                  "vkGetPipelineCacheData")) {
+        return false;
+    }
+    data.resize(size);
+    if (!vk_check(vkGetPipelineCacheData(_device, _pipeline_cache, &size, data.data()),
+                  "vkGetPipelineCacheData")) {
+        return false;
+    }
+    data.resize(size);
+    return true;
+}
+
+void VulkanRenderDevice::_translate(const CommandList& list, VkCommandBuffer command_buffer,
+                                    _ThreadPools& pools) {
+    _BindingState bindings;
+    list.for_each([&](const CommandHeader& command) {
+        switch (command.type) {
+            case COMMAND_BEGIN_RENDER_PASS:
+                _begin_rendering(command_buffer,
+                                 command_data<CommandBeginRenderPass>(command).pass);
+                break;
+            case COMMAND_END_RENDER_PASS:
+                vkCmdEndRendering(command_buffer);
+                break;
+            case COMMAND_BIND_PIPELINE: {
+                const _Pipeline& pipeline =
+                    _pipelines[command_data<CommandBindPipeline>(command).pipeline.index];
+                vkCmdBindPipeline(command_buffer, pipeline.bind_point, pipeline.pipeline);
+                if (bindings.bind_point != pipeline.bind_point) {
+                    bindings.bind_point = pipeline.bind_point;
+                    bindings.dirty = true;
+                }
+            } break;
+            case COMMAND_BIND_VERTEX_BUFFER: {
+                const CommandBindVertexBuffer& bind =
+                    command_data<CommandBindVertexBuffer>(command);
+                VkDeviceSize offset = bind.offset;
+                vkCmdBindVertexBuffers(command_buffer, bind.slot, 1,
+                                       &_buffers[bind.buffer.index].buffer, &offset);
+            } break;
+            case COMMAND_BIND_INDEX_BUFFER: {
+                const CommandBindIndexBuffer& bind = command_data<CommandBindIndexBuffer>(command);
+                vkCmdBindIndexBuffer(command_buffer, _buffers[bind.buffer.index].buffer,
+                                     bind.offset,
+                                     bind.type == INDEX_TYPE_UINT16 ? VK_INDEX_TYPE_UINT16
+                                                                    : VK_INDEX_TYPE_UINT32);
+            } break;
+            case COMMAND_BIND_UNIFORM_BUFFER:
+            case COMMAND_BIND_STORAGE_BUFFER: {
+                const CommandBindBuffer& bind = command_data<CommandBindBuffer>(command);
+                VkDescriptorBufferInfo* infos = command.type == COMMAND_BIND_UNIFORM_BUFFER
+                                                    ? bindings.uniform_buffers
+                                                    : bindings.storage_buffers;
+                infos[bind.slot] = {_buffers[bind.buffer.index].buffer, bind.offset,
+                                    bind.size > 0 ? bind.size : VK_WHOLE_SIZE};
+                bindings.dirty = true;
+            } break;
+            case COMMAND_BIND_TEXTURE: {
+                const CommandBindTexture& bind = command_data<CommandBindTexture>(command);
+                const _Texture& texture = _textures[bind.texture.index];
+                bindings.textures[bind.slot] = {
+                    _samplers[bind.sampler.index], texture.view,
+                    texture.aspect & VK_IMAGE_ASPECT_DEPTH_BIT
+                        ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                        : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+                bindings.dirty = true;
+            } break;
+            case COMMAND_PUSH_CONSTANTS: {
+                const CommandPushConstants& push = command_data<CommandPushConstants>(command);
+                vkCmdPushConstants(command_buffer, _pipeline_layout, VK_SHADER_STAGE_ALL,
+                                   push.offset, push.size,
+                                   command_trailing_data<CommandPushConstants>(command));
+            } break;
+            case COMMAND_SET_VIEWPORT: {
+                const CommandSetViewport& set = command_data<CommandSetViewport>(command);
+                VkViewport viewport = {set.x,     set.y,         set.width,
+                                       set.height, set.min_depth, set.max_depth};
+                vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+            } break;
+            case COMMAND_SET_SCISSOR: {
+                const CommandSetScissor& set = command_data<CommandSetScissor>(command);
+                VkRect2D scissor = {{set.x, set.y}, {set.width, set.height}};
+                vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+            } break;
+            case COMMAND_DRAW: {
+                const CommandDraw& draw = command_data<CommandDraw>(command);
+                _flush_bindings(command_buffer, bindings, pools);
+                vkCmdDraw(command_buffer, draw.vertex_count, draw.instance_count,
+                          draw.first_vertex, draw.first_instance);
+            } break;
+            case COMMAND_DRAW_INDEXED: {
+                const CommandDrawIndexed& draw = command_data<CommandDrawIndexed>(command);
+                _flush_bindings(command_buffer, bindings, pools);
+                vkCmdDrawIndexed(command_buffer, draw.index_count, draw.instance_count,
+                                 draw.first_index, draw.vertex_offset, draw.first_instance);
+            } break;
+            case COMMAND_DISPATCH: {
+                const CommandDispatch& dispatch = command_data<CommandDispatch>(command);
+                _flush_bindings(command_buffer, bindings, pools);
+                vkCmdDispatch(command_buffer, dispatch.group_count_x, dispatch.group_count_y,
+                              dispatch.group_count_z);
+            } break;
+            case COMMAND_COPY_BUFFER: {
+                const CommandCopyBuffer& copy = command_data<CommandCopyBuffer>(command);
+                VkBufferCopy region = {copy.source_offset, copy.destination_offset, copy.size};
+                vkCmdCopyBuffer(command_buffer, _buffers[copy.source.index].buffer,
+                                _buffers[copy.destination.index].buffer, 1, &region);
+            } break;
+            case COMMAND_COPY_BUFFER_TO_TEXTURE: {
+                const CommandCopyBufferToTexture& copy =
+                    command_data<CommandCopyBufferToTexture>(command);
+                const TextureDesc& desc = _context->desc(copy.destination);
+                const _Texture& texture = _textures[copy.destination.index];
+                VkBufferImageCopy region = {};
+                region.bufferOffset = copy.source_offset;
+                region.imageSubresource = {texture.aspect & VK_IMAGE_ASPECT_DEPTH_BIT
+                                               ? (VkImageAspectFlags)VK_IMAGE_ASPECT_DEPTH_BIT
+                                               : texture.aspect,
+                                           copy.mip_level, copy.array_layer, 1};
+                region.imageExtent = {std::max(desc.width >> copy.mip_level, 1u),
+                                      std::max(desc.height >> copy.mip_level, 1u),
+                                      std::max(desc.depth >> copy.mip_level, 1u)};
+                vkCmdCopyBufferToImage(command_buffer, _buffers[copy.source.index].buffer,
+                                       texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                                       &region);
+            } break;
+            case COMMAND_BARRIER:
+                _barrier(command_buffer, command);
+                break;
+            case COMMAND_BEGIN_MARKER:
+                if (_cmd_begin_label != nullptr) {
+                    const CommandBeginMarker& marker = command_data<CommandBeginMarker>(command);
+                    char name[128];
+                    uint32_t length = std::min(marker.length, (uint32_t)sizeof(name) - 1);
+                    std::memcpy(name, command_trailing_data<CommandBeginMarker>(command), length);
+                    name[length] = '\0';
+                    VkDebugUtilsLabelEXT label = {};
+                    label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+                    label.pLabelName = name;
+                    _cmd_begin_label(command_buffer, &label);
+                }
+                break;
+            case COMMAND_END_MARKER:
+                if (_cmd_end_label != nullptr) {
+                    _cmd_end_label(command_buffer);
+                }
+                break;
+            default:
+                break;
+        }
+    });
+}
+
+void VulkanRenderDevice::_begin_rendering(VkCommandBuffer command_buffer,
+                                          const RenderPassDesc& pass) {
+    VkRenderingAttachmentInfo colors[KY_RHI_MAX_COLOR_ATTACHMENTS];
+    for (uint32_t i = 0; i < pass.color_count; i++) {
+        const ColorAttachment& attachment = pass.colors[i];
+        colors[i] = {};
+        colors[i].sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        colors[i].imageView = _textures[attachment.texture.index].view;
+        colors[i].imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colors[i].loadOp = load_ops[attachment.load_op];
+        colors[i].storeOp = store_ops[attachment.store_op];
+        std::memcpy(colors[i].clearValue.color.float32, attachment.clear_color,
+                    sizeof(attachment.clear_color));
+    }
+    VkRenderingAttachmentInfo depth = {};
+    depth.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    TextureFormat depth_format = TEXTURE_FORMAT_UNDEFINED;
+    if (pass.depth.texture.valid()) {
+        depth_format = _context->desc(pass.depth.texture).format;
+        depth.imageView = _textures[pass.depth.texture.index].view;
+        depth.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depth.loadOp = load_ops[pass.depth.load_op];
+        depth.storeOp = store_ops[pass.depth.store_op];
+        depth.clearValue.depthStencil = {pass.depth.clear_depth, pass.depth.clear_stencil};
+    }
+
+    uint32_t width = pass.width;
+    uint32_t height = pass.height;
+    if (width == 0 || height == 0) {
+        const TextureDesc& desc = _context->desc(pass.color_count > 0 ? pass.colors[0].texture
+                                                                      : pass.depth.texture);
+        width = desc.width;
+        height = desc.height;
+    }
+
+    VkRenderingInfo info = {};
+
+    info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    if (pass.flags & RENDER_PASS_SUSPEND_BIT) {
+        info.flags |= VK_RENDERING_SUSPENDING_BIT;
+    }
+    if (pass.flags & RENDER_PASS_RESUME_BIT) {
+        info.flags |= VK_RENDERING_RESUMING_BIT;
+    }
+    info.renderArea = {{0, 0}, {width, height}};
+    info.layerCount = 1;
+    info.colorAttachmentCount = pass.color_count;
+    info.pColorAttachments = colors;
+    if (texture_format_has_depth(depth_format)) {
+        info.pDepthAttachment = &depth;
+    }
+    if (texture_format_has_stencil(depth_format)) {
+        info.pStencilAttachment = &depth;
+    }
+    vkCmdBeginRendering(command_buffer, &info);
+
+    VkViewport viewport = {0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f};
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    vkCmdSetScissor(command_buffer, 0, 1, &info.renderArea);
+}
+
+void VulkanRenderDevice::_barrier(VkCommandBuffer command_buffer, const CommandHeader& command) {
+    const CommandBarrier& barrier = command_data<CommandBarrier>(command);
+    const BufferBarrier* buffers = command_trailing_data<CommandBarrier, BufferBarrier>(command);
+    const TextureBarrier* textures = (const TextureBarrier*)(buffers + barrier.buffer_count);
+
+    ScratchScope scratch;
+    VkBufferMemoryBarrier2* buffer_barriers =
+        scratch.allocate<VkBufferMemoryBarrier2>(barrier.buffer_count);
+    for (uint32_t i = 0; i < barrier.buffer_count; i++) {
+        const VulkanStateInfo& before = state_infos[buffers[i].before];
+        const VulkanStateInfo& after = state_infos[buffers[i].after];
+        VkBufferMemoryBarrier2& vk_barrier = buffer_barriers[i];
+        vk_barrier = {};
+        vk_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+        vk_barrier.srcStageMask = before.stages;
+        vk_barrier.srcAccessMask = before.access;
+        vk_barrier.dstStageMask = after.stages;
+        vk_barrier.dstAccessMask = after.access;
+        vk_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        vk_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        vk_barrier.buffer = _buffers[buffers[i].buffer.index].buffer;
+        vk_barrier.size = VK_WHOLE_SIZE;
+    }
+    VkImageMemoryBarrier2* image_barriers =
+        scratch.allocate<VkImageMemoryBarrier2>(barrier.texture_count);
+    for (uint32_t i = 0; i < barrier.texture_count; i++) {
+        const VulkanStateInfo& before = state_infos[textures[i].before];
+        const VulkanStateInfo& after = state_infos[textures[i].after];
+        const _Texture& texture = _textures[textures[i].texture.index];
+        VkImageMemoryBarrier2& vk_barrier = image_barriers[i];
+        vk_barrier = {};
+        vk_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        vk_barrier.srcStageMask = before.stages;
+        vk_barrier.srcAccessMask = before.access;
+        vk_barrier.dstStageMask = after.stages;
+        vk_barrier.dstAccessMask = after.access;
+        vk_barrier.oldLayout = before.layout;
+        vk_barrier.newLayout = after.layout;
+        vk_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        vk_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        vk_barrier.image = texture.image;
+        vk_barrier.subresourceRange = {texture.aspect, 0, VK_REMAINING_MIP_LEVELS, 0,
+                                       VK_REMAINING_ARRAY_LAYERS};
+    }
+
+    VkDependencyInfo dependency = {};
+
+    dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency.bufferMemoryBarrierCount = barrier.buffer_count;
+    dependency.pBufferMemoryBarriers = buffer_barriers;
+    dependency.imageMemoryBarrierCount = barrier.texture_count;
+    dependency.pImageMemoryBarriers = image_barriers;
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+}
+
+// Bindings are written into a fresh descriptor set whenever they changed since the last draw,
+// sets come from pools reset with the frame so nothing is freed individually
+void VulkanRenderDevice::_flush_bindings(VkCommandBuffer command_buffer, _BindingState& state,
+                                         _ThreadPools& pools) {
+    if (!state.dirty) {
+        return;
+    }
+    state.dirty = false;
+
+    constexpr uint32_t max_writes =
+        KY_RHI_UNIFORM_BUFFER_SLOTS + KY_RHI_STORAGE_BUFFER_SLOTS + KY_RHI_TEXTURE_SLOTS;
+    VkWriteDescriptorSet writes[max_writes];
+    uint32_t write_count = 0;
+    auto write = [&](uint32_t binding, VkDescriptorType type) -> VkWriteDescriptorSet& {
+        VkWriteDescriptorSet& write = writes[write_count++];
+        write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstBinding = binding;
+        write.descriptorCount = 1;
+        write.descriptorType = type;
+        return write;
+    };
+    for (uint32_t i = 0; i < KY_RHI_UNIFORM_BUFFER_SLOTS; i++) {
+        if (state.uniform_buffers[i].buffer != VK_NULL_HANDLE) {
+            write(i, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER).pBufferInfo = &state.uniform_buffers[i];
+        }
+    }
+    for (uint32_t i = 0; i < KY_RHI_STORAGE_BUFFER_SLOTS; i++) {
+        if (state.storage_buffers[i].buffer != VK_NULL_HANDLE) {
+            write(KY_RHI_UNIFORM_BUFFER_SLOTS + i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                .pBufferInfo = &state.storage_buffers[i];
+        }
+    }
+    for (uint32_t i = 0; i < KY_RHI_TEXTURE_SLOTS; i++) {
+        if (state.textures[i].imageView != VK_NULL_HANDLE) {
+            write(KY_RHI_UNIFORM_BUFFER_SLOTS + KY_RHI_STORAGE_BUFFER_SLOTS + i,
+                  VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
+                .pImageInfo = &state.textures[i];
+        }
+    }
+    if (write_count == 0) {
+        return;
+    }
+
+    VkDescriptorSet set = _allocate_set(pools);
+    if (set == VK_NULL_HANDLE) {
+        return;
+    }
+    for (uint32_t i = 0; i < write_count; i++) {
+        writes[i].dstSet = set;
+    }
+    vkUpdateDescriptorSets(_device, write_count, writes, 0, nullptr);
+    vkCmdBindDescriptorSets(command_buffer, state.bind_point, _pipeline_layout, 0, 1, &set, 0,
+                            nullptr);
+}
+
+VkDescriptorSet VulkanRenderDevice::_allocate_set(_ThreadPools& pools) {
+    VkDescriptorSetAllocateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    info.descriptorSetCount = 1;
+    info.pSetLayouts = &_set_layout;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    if (pools.descriptor_pools_used > 0) {
+        info.descriptorPool = pools.descriptor_pools[pools.descriptor_pools_used - 1];
+        if (vkAllocateDescriptorSets(_device, &info, &set) == VK_SUCCESS) {
+            return set;
+        }
+    }
+
+    // The current pool ran out, take the next one or create it
+    if (pools.descriptor_pools_used == pools.descriptor_pools.size()) {
+        VkDescriptorPoolSize sizes[] = {
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+             KY_VULKAN_DESCRIPTOR_POOL_SETS * KY_RHI_UNIFORM_BUFFER_SLOTS},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+             KY_VULKAN_DESCRIPTOR_POOL_SETS * KY_RHI_STORAGE_BUFFER_SLOTS},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+             KY_VULKAN_DESCRIPTOR_POOL_SETS * KY_RHI_TEXTURE_SLOTS},
+        };
+        VkDescriptorPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.maxSets = KY_VULKAN_DESCRIPTOR_POOL_SETS;
+        pool_info.poolSizeCount = 3;
+        pool_info.pPoolSizes = sizes;
+        VkDescriptorPool pool = VK_NULL_HANDLE;
+        if (!vk_check(vkCreateDescriptorPool(_device, &pool_info, nullptr, &pool),
+                      "vkCreateDescriptorPool")) {
+            return VK_NULL_HANDLE;
+        }
+        pools.descriptor_pools.push_back(pool);
+    }
+    info.descriptorPool = pools.descriptor_pools[pools.descriptor_pools_used++];
+    vk_check(vkAllocateDescriptorSets(_device, &info, &set), "vkAllocateDescriptorSets");
+    return set;
+}
+
+} // namespace ky
@@ -0,0 +1,233 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_RENDER_HARDWARE_VULKAN__VULKAN_DEVICE_H
+#define KRYOS_RENDER_HARDWARE_VULKAN__VULKAN_DEVICE_H
+
+#include "core/memory_tracker.h"
+#include "core/window.h"
+#include "render_hardware/base/device.h"
+#include "render_hardware/base/gpu_allocator.h"
+
+#include <cstdint>
+#include <mutex>
+#include <vulkan/vulkan.h>
+
+// Descriptor sets per pool, threads take another pool once theirs runs out within a frame
+#ifndef KY_VULKAN_DESCRIPTOR_POOL_SETS
+#    define KY_VULKAN_DESCRIPTOR_POOL_SETS 1024
+#endif
+
+#define KY_VULKAN_MAX_SWAPCHAIN_IMAGES 8
+
+namespace ky {
+
+// Vulkan 1.3 backend built on dynamic rendering and synchronization2. Resources are sub-allocated
+// from large device memory blocks by a `GpuAllocator`, host visible blocks stay mapped.
+//
+// Submitted command lists are translated into one primary command buffer each on the job
+// system, recorded from per thread command and descriptor pools of the frame's slot. The command
+// buffers of a frame go to the queue in a single submission at `end_frame`, which lets render
+// passes suspended in one list resume in the next.
+class VulkanRenderDevice final : public RenderDevice {
+public:
+    bool init(RenderContext& context, const RenderContextDesc& desc) override;
+    void shutdown() override;
+
+    bool create_buffer(uint32_t index, const BufferDesc& desc, const void* data) override;
+    bool create_texture(uint32_t index, const TextureDesc& desc, const void* data) override;
+    bool create_sampler(uint32_t index, const SamplerDesc& desc) override;
+    bool create_shader(uint32_t index, const ShaderDesc& desc) override;
+    bool create_pipeline(uint32_t index, const PipelineDesc& desc) override;
+    void destroy_buffer(uint32_t index) override;
+    void destroy_texture(uint32_t index) override;
+    void destroy_sampler(uint32_t index) override;
+    void destroy_shader(uint32_t index) override;
+    void destroy_pipeline(uint32_t index) override;
+
+    uint8_t* mapped_data(uint32_t buffer) override;
+
+    void wait_frame(uint32_t slot) override;
+    bool begin_frame(uint64_t frame_number, uint32_t slot) override;
+    void submit(CommandList* const* lists, uint32_t count) override;
+    void end_frame() override;
+    void wait_idle() override;
+    uint64_t completed_frame() override;
+
+    bool swapchain_desc(TextureDesc& desc) override;
+    void set_swapchain_texture(uint32_t index) override;
+
+    uint64_t pipeline_cache_id() override;
+    bool load_pipeline_cache(const void* data, size_t size) override;
+    bool save_pipeline_cache(TaggedVector<uint8_t, MEMORY_TAG_RENDER>& data) override;
+
+    GpuMemoryStats memory_stats() override;
+    uint32_t defragment(uint32_t max_moves, uint64_t max_bytes) override;
+
+    inline VkInstance instance() const { return _instance; }
+    inline VkPhysicalDevice physical_device() const { return _physical_device; }
+    inline VkDevice device() const { return _device; }
+
+private:
+    struct _Buffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        GpuAllocation allocation;
+        uint8_t* mapped = nullptr;
+        // Kept to recreate the buffer when defragmentation moves it
+        VkBufferCreateInfo info = {};
+    };
+
+    struct _Texture {
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        GpuAllocation allocation;
+        VkImageAspectFlags aspect = 0;
+    };
+
+    // Buffer moved by defragmentation, released once the frames that could use it finished
+    struct _Retired {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        GpuAllocation allocation;
+    };
+
+    struct _Shader {
+        VkShaderModule module = VK_NULL_HANDLE;
+        VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+        char entry_point[64] = {};
+    };
+
+    struct _Pipeline {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkPipelineBindPoint bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    };
+
+    // Pools of one recording thread in one frame slot, reset when the slot is reused
+    struct _ThreadPools {
+        VkCommandPool command_pool = VK_NULL_HANDLE;
+        TaggedVector<VkCommandBuffer, MEMORY_TAG_RENDER> command_buffers;
+        uint32_t command_buffers_used = 0;
+        TaggedVector<VkDescriptorPool, MEMORY_TAG_RENDER> descriptor_pools;
+        uint32_t descriptor_pools_used = 0;
+    };
+
+    struct _Frame {
+        VkFence fence = VK_NULL_HANDLE;
+        VkSemaphore acquired = VK_NULL_HANDLE;
+        uint64_t frame_number = 0;
+        bool submitted = false;
+        TaggedVector<_ThreadPools, MEMORY_TAG_RENDER> threads;
+        // Command buffers of the submitted lists in submission order
+        TaggedVector<VkCommandBuffer, MEMORY_TAG_RENDER> command_buffers;
+        TaggedVector<_Retired, MEMORY_TAG_RENDER> retired;
+    };
+
+    // Bindings of set 0 while translating a list
+    struct _BindingState {
+        VkDescriptorBufferInfo uniform_buffers[KY_RHI_UNIFORM_BUFFER_SLOTS] = {};
+        VkDescriptorBufferInfo storage_buffers[KY_RHI_STORAGE_BUFFER_SLOTS] = {};
+        VkDescriptorImageInfo textures[KY_RHI_TEXTURE_SLOTS] = {};
+        VkPipelineBindPoint bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        bool dirty = false;
+    };
+
+    RenderContext* _context = nullptr;
+    VkInstance _instance = VK_NULL_HANDLE;
+    VkDebugUtilsMessengerEXT _messenger = VK_NULL_HANDLE;
+    VkPhysicalDevice _physical_device = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties _properties = {};
+    VkPhysicalDeviceMemoryProperties _memory_properties = {};
+    // Optional features that were enabled
+    VkPhysicalDeviceFeatures _features = {};
+    VkDevice _device = VK_NULL_HANDLE;
+    VkQueue _queue = VK_NULL_HANDLE;
+    uint32_t _queue_family = 0;
+
+    PFN_vkCmdBeginDebugUtilsLabelEXT _cmd_begin_label = nullptr;
+    PFN_vkCmdEndDebugUtilsLabelEXT _cmd_end_label = nullptr;
+    PFN_vkSetDebugUtilsObjectNameEXT _set_object_name = nullptr;
+
+    VkDescriptorSetLayout _set_layout = VK_NULL_HANDLE;
+    VkPipelineLayout _pipeline_layout = VK_NULL_HANDLE;
+    VkPipelineCache _pipeline_cache = VK_NULL_HANDLE;
+    GpuAllocator _allocator;
+    TaggedVector<GpuDefragmentationMove, MEMORY_TAG_RENDER> _moves;
+
+    TaggedVector<_Buffer, MEMORY_TAG_RENDER> _buffers;
+    TaggedVector<_Texture, MEMORY_TAG_RENDER> _textures;
+    TaggedVector<VkSampler, MEMORY_TAG_RENDER> _samplers;
+    TaggedVector<_Shader, MEMORY_TAG_RENDER> _shaders;
+    TaggedVector<_Pipeline, MEMORY_TAG_RENDER> _pipelines;
+
+    // Guards the queue and the pool of the one-off command buffers uploading initial data
+    std::mutex _queue_mutex;
+    VkCommandPool _upload_pool = VK_NULL_HANDLE;
+
+    _Frame _frames[KY_RHI_FRAMES_IN_FLIGHT];
+    uint32_t _frame_slot = 0;
+    uint64_t _completed_frame = 0;
+
+    WindowHandle _window;
+    bool _vsync = true;
+    VkSurfaceKHR _surface = VK_NULL_HANDLE;
+    VkSwapchainKHR _swapchain = VK_NULL_HANDLE;
+    VkFormat _swapchain_format = VK_FORMAT_UNDEFINED;
+    VkExtent2D _swapchain_extent = {};
+    uint32_t _swapchain_image_count = 0;
+    VkImage _swapchain_images[KY_VULKAN_MAX_SWAPCHAIN_IMAGES] = {};
+    VkImageView _swapchain_views[KY_VULKAN_MAX_SWAPCHAIN_IMAGES] = {};
+    // Signaled by the frame rendering into each image, waited on by its presentation
+    VkSemaphore _rendered[KY_VULKAN_MAX_SWAPCHAIN_IMAGES] = {};
+    uint32_t _swapchain_texture = KY_RHI_INVALID_INDEX;
+    uint32_t _image_index = 0;
+    bool _image_acquired = false;
+    bool _swapchain_outdated = false;
+
+    bool _create_instance(const RenderContextDesc& desc);
+    bool _select_physical_device();
+    bool _create_device();
+    bool _create_layouts();
+    bool _create_frames();
+    bool _create_swapchain();
+    void _destroy_swapchain();
+
+    int32_t _memory_type(uint32_t type_bits, VkMemoryPropertyFlags properties) const;
+    static bool _allocate_block(void* user_data, uint32_t memory_type, uint64_t size,
+                                GpuMemoryBlock& block);
+    static void _free_block(void* user_data, uint32_t memory_type, const GpuMemoryBlock& block);
+    bool _create_allocator();
+    bool _allocate_memory(const VkMemoryRequirements& requirements,
+                          VkMemoryPropertyFlags properties, VkMemoryPropertyFlags fallback,
+                          const GpuAllocationDesc& desc, GpuAllocation& allocation);
+    void _release_retired(_Frame& frame);
+    void _set_name(VkObjectType type, uint64_t object, const char* name);
+    bool _create_staging(uint64_t size, const void* data, _Buffer& staging);
+    void _destroy_staging(_Buffer& staging);
+    bool _upload(VkBuffer destination, const void* data, uint64_t size);
+    bool _upload(const _Texture& texture, const TextureDesc& desc, const void* data);
+    VkCommandBuffer _begin_upload();
+    bool _end_upload(VkCommandBuffer command_buffer);
+
+    VkCommandBuffer _begin_command_buffer(_ThreadPools& pools);
+    void _translate(const CommandList& list, VkCommandBuffer command_buffer, _ThreadPools& pools);
+    void _begin_rendering(VkCommandBuffer command_buffer, const RenderPassDesc& pass);
+    void _barrier(VkCommandBuffer command_buffer, const CommandHeader& command);
+    void _flush_bindings(VkCommandBuffer command_buffer, _BindingState& state,
+                         _ThreadPools& pools);
+    VkDescriptorSet _allocate_set(_ThreadPools& pools);
+};
+
+} // namespace ky
+
+#endif
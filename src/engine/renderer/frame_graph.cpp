@@ -0,0 +1,721 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "renderer/frame_graph.h"
+
+#include "core/error.h"
+#include "core/hash.h"
+#include "core/jobs.h"
+#include "core/profiler.h"
+#include "render_hardware/base/context.h"
+
+#include <algorithm>
+
+namespace ky {
+
+// States a pass writes in, a later pass using the resource has to wait on the write even when it
+// uses the same state
+static bool is_write_state(ResourceState state) {
+    switch (state) {
+        case RESOURCE_STATE_SHADER_WRITE:
+        case RESOURCE_STATE_COLOR_ATTACHMENT:
+        case RESOURCE_STATE_DEPTH_STENCIL_WRITE:
+        case RESOURCE_STATE_TRANSFER_DST:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Whether textures can share a physical texture, which is created with the union of their usage
+static bool textures_alias(const TextureDesc& a, const TextureDesc& b) {
+    return a.type == b.type && a.format == b.format && a.width == b.width &&
+           a.height == b.height && a.depth == b.depth && a.mip_levels == b.mip_levels &&
+           a.array_layers == b.array_layers && a.samples == b.samples;
+}
+
+static bool same_texture_desc(const TextureDesc& a, const TextureDesc& b) {
+    return textures_alias(a, b) && a.usage == b.usage;
+}
+
+static bool same_buffer_desc(const BufferDesc& a, const BufferDesc& b) {
+    return a.size == b.size && a.usage == b.usage && a.memory == b.memory;
+}
+
+TextureHandle FrameGraphPassContext::texture(FrameGraphResource resource) const {
+    for (const FrameGraph::_Access& access : _graph->_passes[_pass].accesses) {
+        if (access.resource == resource) {
+            const FrameGraph::_Resource& declared = _graph->_resources[resource];
+            KY_ERROR_CONDITION_MSG_RETURN(declared.type == FrameGraph::_RESOURCE_TEXTURE,
+                                          TextureHandle(), "Frame graph resource isn't a texture");
+            return declared.texture;
+        }
+    }
+    KY_ERROR_MSG("Pass %s didn't declare resource %u", _graph->_passes[_pass].name, resource);
+    return TextureHandle();
+}
+
+BufferHandle FrameGraphPassContext::buffer(FrameGraphResource resource) const {
+    for (const FrameGraph::_Access& access : _graph->_passes[_pass].accesses) {
+        if (access.resource == resource) {
+            const FrameGraph::_Resource& declared = _graph->_resources[resource];
+            KY_ERROR_CONDITION_MSG_RETURN(declared.type == FrameGraph::_RESOURCE_BUFFER,
+                                          BufferHandle(), "Frame graph resource isn't a buffer");
+            return declared.buffer;
+        }
+    }
+    KY_ERROR_MSG("Pass %s didn't declare resource %u", _graph->_passes[_pass].name, resource);
+    return BufferHandle();
+}
+
+FrameGraph::PassBuilder& FrameGraph::PassBuilder::read(FrameGraphResource resource,
+                                                        ResourceState state) {
+    _graph->_declare(_pass, resource, state, true, false);
+    return *this;
+}
+
+FrameGraph::PassBuilder& FrameGraph::PassBuilder::write(FrameGraphResource resource,
+                                                         ResourceState state) {
+    _graph->_declare(_pass, resource, state, false, true);
+    return *this;
+}
+
+FrameGraph::PassBuilder& FrameGraph::PassBuilder::read_write(FrameGraphResource resource,
+                                                              ResourceState state) {
+    _graph->_declare(_pass, resource, state, true, true);
+    return *this;
+}
+
+FrameGraph::PassBuilder& FrameGraph::PassBuilder::side_effects() {
+    _graph->_passes[_pass].side_effects = true;
+    return *this;
+}
+
+void FrameGraph::reset() {
+    for (uint32_t i = 0; i < _pass_count; i++) {
+        // Releases what the functions captured now rather than when the entry is reused
+        _passes[i].function = nullptr;
+    }
+    _pass_count = 0;
+    _resource_count = 0;
+}
+
+FrameGraphResource FrameGraph::create_texture(const char* name, const TextureDesc& desc) {
+    FrameGraphResource resource = _add_resource(name, _RESOURCE_TEXTURE);
+    _resources[resource].texture_desc = desc;
+    return resource;
+}
+
+FrameGraphResource FrameGraph::create_buffer(const char* name, const BufferDesc& desc) {
+    FrameGraphResource resource = _add_resource(name, _RESOURCE_BUFFER);
+    _resources[resource].buffer_desc = desc;
+    return resource;
+}
+
+FrameGraphResource FrameGraph::import_texture(const char* name, TextureHandle texture,
+                                              ResourceState initial_state,
+                                              ResourceState final_state) {
+    FrameGraphResource resource = _add_resource(name, _RESOURCE_TEXTURE);
+    _Resource& imported = _resources[resource];
+    imported.imported = true;
+    imported.texture = texture;
+    imported.initial_state = initial_state;
+    imported.final_state = final_state;
+    return resource;
+}
+
+FrameGraphResource FrameGraph::import_buffer(const char* name, BufferHandle buffer,
+                                             ResourceState initial_state,
+                                             ResourceState final_state) {
+    FrameGraphResource resource = _add_resource(name, _RESOURCE_BUFFER);
+    _Resource& imported = _resources[resource];
+    imported.imported = true;
+    imported.buffer = buffer;
+    imported.initial_state = initial_state;
+    imported.final_state = final_state;
+    return resource;
+}
+
+FrameGraph::PassBuilder FrameGraph::add_pass(const char* name, FrameGraphPassFunction function) {
+    FrameGraphPass pass = _pass_count++;
+    if (pass == _passes.size()) {
+        _passes.emplace_back();
+    }
+    _Pass& added = _passes[pass];
+    added.name = name;
+    added.function = std::move(function);
+    added.accesses.clear();
+    added.side_effects = false;
+    return PassBuilder(this, pass);
+}
+
+bool FrameGraph::compile() {
+    KY_PROFILE_SCOPE("FrameGraph::compile");
+    uint64_t hash = _hash();
+    if (_compiled && hash == _compiled_hash) {
+        _stats.cached_compiles++;
+        return _compile_succeeded;
+    }
+    _compiled = true;
+    _compiled_hash = hash;
+
+    uint32_t compiles = _stats.compiles + 1;
+    uint32_t cached_compiles = _stats.cached_compiles;
+    _stats = FrameGraphStats();
+    _stats.compiles = compiles;
+    _stats.cached_compiles = cached_compiles;
+    _stats.passes = _pass_count;
+
+    _compiled_passes.assign(_pass_count, _CompiledPass());
+    _compiled_resources.assign(_resource_count, _CompiledResource());
+    _barriers.clear();
+    _final_barrier_begin = 0;
+    _compile_succeeded = _validate();
+    if (!_compile_succeeded) {
+        for (_CompiledPass& pass : _compiled_passes) {
+            pass.culled = true;
+        }
+        _stats.culled_passes = _pass_count;
+        return false;
+    }
+
+    _cull();
+    _assign_physical();
+    _derive_barriers();
+    _stats.barriers = (uint32_t)_barriers.size();
+    return true;
+}
+
+bool FrameGraph::execute(RenderContext& context) {
+    KY_PROFILE_SCOPE("FrameGraph::execute");
+    if (!compile() || !_create_physical(context)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < _resource_count; i++) {
+        _Resource& resource = _resources[i];
+        uint32_t physical = _compiled_resources[i].physical;
+        if (resource.imported) {
+            continue;
+        } else if (resource.type == _RESOURCE_TEXTURE) {
+            resource.texture = physical != KY_RHI_INVALID_INDEX
+                                       ? _physical_textures[physical].texture
+                                       : TextureHandle();
+        } else {
+            resource.buffer = physical != KY_RHI_INVALID_INDEX
+                                      ? _physical_buffers[physical].buffer
+                                      : BufferHandle();
+        }
+    }
+
+    _live_passes.clear();
+    for (FrameGraphPass pass = 0; pass < _pass_count; pass++) {
+        if (!_compiled_passes[pass].culled) {
+            _live_passes.push_back(pass);
+        }
+    }
+    JobSystem::parallel_for(_live_passes.size(),
+                            [&](size_t index) { _record(context, _live_passes[index]); });
+
+    _submit_lists.clear();
+    for (FrameGraphPass pass : _live_passes) {
+        _submit_lists.push_back(_passes[pass].list);
+        _submit_lists.insert(_submit_lists.end(), _passes[pass].lists.begin(),
+                             _passes[pass].lists.end());
+    }
+    uint32_t final_count = final_barrier_count();
+    if (final_count > 0) {
+        _final_buffer_barriers.clear();
+        _final_texture_barriers.clear();
+        for (uint32_t i = 0; i < final_count; i++) {
+            const FrameGraphBarrier& barrier = _barriers[_final_barrier_begin + i];
+            const _Resource& resource = _resources[barrier.resource];
+            if (resource.type == _RESOURCE_TEXTURE) {
+                _final_texture_barriers.push_back(
+                    {resource.texture, barrier.before, barrier.after});
+            } else {
+                _final_buffer_barriers.push_back({resource.buffer, barrier.before, barrier.after});
+            }
+        }
+        CommandList* list = context.command_list();
+        list->barrier(_final_buffer_barriers.data(), (uint32_t)_final_buffer_barriers.size(),
+                      _final_texture_barriers.data(), (uint32_t)_final_texture_barriers.size());
+        _submit_lists.push_back(list);
+    }
+    context.submit(_submit_lists.data(), (uint32_t)_submit_lists.size());
+
+    for (uint32_t i = 0; i < _physical_texture_count; i++) {
+        _physical_textures[i].state = _physical_textures[i].final_state;
+    }
+    for (uint32_t i = 0; i < _physical_buffer_count; i++) {
+        _physical_buffers[i].state = _physical_buffers[i].final_state;
+    }
+    return true;
+}
+
+void FrameGraph::shutdown(RenderContext& context) {
+    for (_PhysicalTexture& physical : _physical_textures) {
+        if (physical.texture.valid()) {
+            context.destroy(physical.texture);
+        }
+    }
+    for (_PhysicalBuffer& physical : _physical_buffers) {
+        if (physical.buffer.valid()) {
+            context.destroy(physical.buffer);
+        }
+    }
+    reset();
+    _physical_textures.clear();
+    _physical_buffers.clear();
+    _physical_texture_count = 0;
+    _physical_buffer_count = 0;
+    _compiled = false;
+}
+
+bool FrameGraph::pass_culled(FrameGraphPass pass) const {
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)pass, _compiled_passes.size(), true);
+    return _compiled_passes[pass].culled;
+}
+
+uint32_t FrameGraph::pass_barrier_count(FrameGraphPass pass) const {
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)pass, _compiled_passes.size(), 0);
+    return _compiled_passes[pass].barrier_count;
+}
+
+const FrameGraphBarrier* FrameGraph::pass_barriers(FrameGraphPass pass) const {
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)pass, _compiled_passes.size(), nullptr);
+    return _barriers.data() + _compiled_passes[pass].barrier_begin;
+}
+
+uint32_t FrameGraph::final_barrier_count() const {
+    return (uint32_t)_barriers.size() - _final_barrier_begin;
+}
+
+const FrameGraphBarrier* FrameGraph::final_barriers() const {
+    return _barriers.data() + _final_barrier_begin;
+}
+
+FrameGraphLifetime FrameGraph::lifetime(FrameGraphResource resource) const {
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)resource, _compiled_resources.size(),
+                               FrameGraphLifetime());
+    return _compiled_resources[resource].lifetime;
+}
+
+uint32_t FrameGraph::physical_resource(FrameGraphResource resource) const {
+    KY_ERROR_FAIL_INDEX_RETURN((size_t)resource, _compiled_resources.size(),
+                               KY_RHI_INVALID_INDEX);
+    return _compiled_resources[resource].physical;
+}
+
+FrameGraphResource FrameGraph::_add_resource(const char* name, _ResourceType type) {
+    FrameGraphResource resource = _resource_count++;
+    if (resource == _resources.size()) {
+        _resources.emplace_back();
+    }
+    _resources[resource] = _Resource();
+    _resources[resource].name = name;
+    _resources[resource].type = type;
+    return resource;
+}
+
+void FrameGraph::_declare(FrameGraphPass pass, FrameGraphResource resource, ResourceState state,
+                          bool read, bool write) {
+    KY_ERROR_CONDITION_MSG(resource < _resource_count, "Unknown frame graph resource");
+    TaggedVector<_Access, MEMORY_TAG_RENDER>& accesses = _passes[pass].accesses;
+    for (_Access& access : accesses) {
+        if (access.resource == resource && access.state == state) {
+            access.read |= read;
+            access.write |= write;
+            return;
+        }
+    }
+    // Another state for a resource already declared is reported by `compile`
+    accesses.push_back({resource, state, read, write});
+}
+
+uint64_t FrameGraph::_hash() const {
+    // Everything compiling depends on, names and imported handles can change freely as long as
+    // they stay valid, an invalid import fails the compile
+    uint64_t hash = hash_bytes(&_resource_count, sizeof(_resource_count), _pass_count);
+    for (uint32_t i = 0; i < _resource_count; i++) {
+        const _Resource& resource = _resources[i];
+        const TextureDesc& texture = resource.texture_desc;
+        const BufferDesc& buffer = resource.buffer_desc;
+        bool imported_valid = resource.imported && (resource.type == _RESOURCE_TEXTURE
+                                                         ? resource.texture.valid()
+                                                         : resource.buffer.valid());
+        uint64_t fields[] = {
+            resource.type,          resource.imported,      imported_valid,
+            resource.initial_state, resource.final_state,   texture.type,
+            texture.format,         texture.width,          texture.height,
+            texture.depth,          texture.mip_levels,     texture.array_layers,
+            texture.samples,        texture.usage,          buffer.size,
+            buffer.usage,           (uint64_t)buffer.memory,
+        };
+        hash = hash_bytes(fields, sizeof(fields), hash);
+    }
+    for (uint32_t i = 0; i < _pass_count; i++) {
+        const _Pass& pass = _passes[i];
+        uint64_t header[] = {pass.side_effects, pass.accesses.size()};
+        hash = hash_bytes(header, sizeof(header), hash);
+        for (const _Access& access : pass.accesses) {
+            uint64_t fields[] = {access.resource, access.state, access.read, access.write};
+            hash = hash_bytes(fields, sizeof(fields), hash);
+        }
+    }
+    return hash;
+}
+
+bool FrameGraph::_validate() const {
+    bool valid = true;
+    for (uint32_t i = 0; i < _resource_count; i++) {
+        const _Resource& resource = _resources[i];
+        if (resource.imported && !(resource.type == _RESOURCE_TEXTURE ? resource.texture.valid()
+                                                                      : resource.buffer.valid())) {
+            KY_ERROR_MSG("Frame graph resource %s was imported without a handle", resource.name);
+            valid = false;
+        }
+    }
+    for (uint32_t i = 0; i < _pass_count; i++) {
+        const _Pass& pass = _passes[i];
+        for (size_t a = 0; a < pass.accesses.size(); a++) {
+            const _Access& access = pass.accesses[a];
+            const char* resource = _resources[access.resource].name;
+            if (access.state == RESOURCE_STATE_UNDEFINED ||
+                access.state == RESOURCE_STATE_PRESENT) {
+                KY_ERROR_MSG("Pass %s can't use %s in state %s", pass.name, resource,
+                             resource_state_to_cstring(access.state));
+                valid = false;
+            } else if (access.write && !is_write_state(access.state)) {
+                KY_ERROR_MSG("Pass %s writes %s in the read only state %s", pass.name, resource,
+                             resource_state_to_cstring(access.state));
+                valid = false;
+            }
+            for (size_t b = a + 1; b < pass.accesses.size(); b++) {
+                if (pass.accesses[b].resource == access.resource) {
+                    KY_ERROR_MSG("Pass %s uses %s in both %s and %s", pass.name, resource,
+                                 resource_state_to_cstring(access.state),
+                                 resource_state_to_cstring(pass.accesses[b].state));
+                    valid = false;
+                }
+            }
+        }
+    }
+    return valid;
+}
+
+void FrameGraph::_cull() {
+    // Walks back from the end of the frame, where only imported resources are still read. A pass
+    // is live when it writes something a later live pass reads, everything it reads is then
+    // needed up to it. Overwriting a resource ends the need for earlier writes to it.
+    _needed.assign(_resource_count, 0);
+    for (uint32_t i = 0; i < _resource_count; i++) {
+        _needed[i] = _resources[i].imported;
+    }
+    for (uint32_t i = _pass_count; i-- > 0;) {
+        const _Pass& pass = _passes[i];
+        bool live = pass.side_effects;
+        for (const _Access& access : pass.accesses) {
+            live = live || (access.write && _needed[access.resource]);
+        }
+        _compiled_passes[i].culled = !live;
+        if (!live) {
+            _stats.culled_passes++;
+            continue;
+        }
+        for (const _Access& access : pass.accesses) {
+            if (access.write && !access.read) {
+                _needed[access.resource] = 0;
+            }
+        }
+        for (const _Access& access : pass.accesses) {
+            if (access.read) {
+                _needed[access.resource] = 1;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < _pass_count; i++) {
+        if (_compiled_passes[i].culled) {
+            continue;
+        }
+        for (const _Access& access : _passes[i].accesses) {
+            FrameGraphLifetime& lifetime = _compiled_resources[access.resource].lifetime;
+            if (lifetime.first_pass == KY_RHI_INVALID_INDEX) {
+                lifetime.first_pass = i;
+            }
+            lifetime.last_pass = i;
+        }
+    }
+}
+
+void FrameGraph::_assign_physical() {
+    _order.clear();
+    for (uint32_t i = 0; i < _resource_count; i++) {
+        if (!_resources[i].imported &&
+            _compiled_resources[i].lifetime.first_pass != KY_RHI_INVALID_INDEX) {
+            _order.push_back(i);
+        }
+    }
+    std::stable_sort(_order.begin(), _order.end(), [&](uint32_t a, uint32_t b) {
+        return _compiled_resources[a].lifetime.first_pass <
+               _compiled_resources[b].lifetime.first_pass;
+    });
+    _stats.transient_resources = (uint32_t)_order.size();
+
+    // Greedy interval assignment in order of first use, a physical resource is free once the last
+    // pass of the resource it holds came before the first pass of the next one
+    TaggedVector<TextureDesc, MEMORY_TAG_RENDER> textures;
+    TaggedVector<BufferDesc, MEMORY_TAG_RENDER> buffers;
+    TaggedVector<FrameGraphResource, MEMORY_TAG_RENDER> texture_owners;
+    TaggedVector<FrameGraphResource, MEMORY_TAG_RENDER> buffer_owners;
+    TaggedVector<FrameGraphPass, MEMORY_TAG_RENDER> texture_last_pass;
+    TaggedVector<FrameGraphPass, MEMORY_TAG_RENDER> buffer_last_pass;
+    for (FrameGraphResource index : _order) {
+        const _Resource& resource = _resources[index];
+        _CompiledResource& compiled = _compiled_resources[index];
+        uint32_t physical = KY_RHI_INVALID_INDEX;
+        if (resource.type == _RESOURCE_TEXTURE) {
+            const TextureDesc& desc = resource.texture_desc;
+            _stats.transient_bytes += texture_size(desc);
+            for (uint32_t i = 0; i < textures.size(); i++) {
+                if (texture_last_pass[i] < compiled.lifetime.first_pass &&
+                    textures_alias(textures[i], desc)) {
+                    physical = i;
+                    break;
+                }
+            }
+            if (physical == KY_RHI_INVALID_INDEX) {
+                physical = (uint32_t)textures.size();
+                textures.push_back(desc);
+                textures.back().name = nullptr;
+                texture_owners.push_back(index);
+                texture_last_pass.push_back(0);
+            }
+            textures[physical].usage |= desc.usage;
+            texture_last_pass[physical] = compiled.lifetime.last_pass;
+        } else {
+            // Best fit, the smallest free buffer large enough or else the largest one, grown
+            const BufferDesc& desc = resource.buffer_desc;
+            _stats.transient_bytes += desc.size;
+            for (uint32_t i = 0; i < buffers.size(); i++) {
+                if (buffer_last_pass[i] >= compiled.lifetime.first_pass ||
+                    buffers[i].memory != desc.memory) {
+                    continue;
+                }
+                if (physical == KY_RHI_INVALID_INDEX) {
+                    physical = i;
+                    continue;
+                }
+                uint64_t size = buffers[i].size;
+                uint64_t best = buffers[physical].size;
+                bool fits = size >= desc.size;
+                bool best_fits = best >= desc.size;
+                bool better = fits ? !best_fits || size < best : !best_fits && size > best;
+                if (better) {
+                    physical = i;
+                }
+            }
+            if (physical == KY_RHI_INVALID_INDEX) {
+                physical = (uint32_t)buffers.size();
+                buffers.push_back(desc);
+                buffers.back().name = nullptr;
+                buffer_owners.push_back(index);
+                buffer_last_pass.push_back(0);
+            }
+            buffers[physical].usage |= desc.usage;
+            buffers[physical].size = std::max(buffers[physical].size, desc.size);
+            buffer_last_pass[physical] = compiled.lifetime.last_pass;
+        }
+        compiled.physical = physical;
+    }
+
+    // Physical resources whose description didn't change are kept by `execute`
+    _physical_texture_count = (uint32_t)textures.size();
+    if (_physical_textures.size() < textures.size()) {
+        _physical_textures.resize(textures.size());
+    }
+    for (uint32_t i = 0; i < _physical_texture_count; i++) {
+        _PhysicalTexture& physical = _physical_textures[i];
+        physical.changed = physical.changed || !same_texture_desc(physical.desc, textures[i]);
+        physical.desc = textures[i];
+        physical.owner = texture_owners[i];
+        _stats.physical_bytes += texture_size(textures[i]);
+    }
+    _physical_buffer_count = (uint32_t)buffers.size();
+    if (_physical_buffers.size() < buffers.size()) {
+        _physical_buffers.resize(buffers.size());
+    }
+    for (uint32_t i = 0; i < _physical_buffer_count; i++) {
+        _PhysicalBuffer& physical = _physical_buffers[i];
+        physical.changed = physical.changed || !same_buffer_desc(physical.desc, buffers[i]);
+        physical.desc = buffers[i];
+        physical.owner = buffer_owners[i];
+        _stats.physical_bytes += buffers[i].size;
+    }
+    _stats.physical_textures = _physical_texture_count;
+    _stats.physical_buffers = _physical_buffer_count;
+}
+
+void FrameGraph::_derive_barriers() {
+    // States of the imported resources followed by those of the physical textures and buffers,
+    // which start the frame undefined
+    uint32_t texture_first = _resource_count;
+    uint32_t buffer_first = texture_first + _physical_texture_count;
+    _states.assign(buffer_first + _physical_buffer_count, RESOURCE_STATE_UNDEFINED);
+    auto state_index = [&](FrameGraphResource resource) {
+        const _Resource& declared = _resources[resource];
+        uint32_t physical = _compiled_resources[resource].physical;
+        if (declared.imported) {
+            return resource;
+        }
+        return (declared.type == _RESOURCE_TEXTURE ? texture_first : buffer_first) + physical;
+    };
+    for (uint32_t i = 0; i < _resource_count; i++) {
+        _states[i] = _resources[i].initial_state;
+    }
+
+    for (uint32_t i = 0; i < _pass_count; i++) {
+        _CompiledPass& compiled = _compiled_passes[i];
+        compiled.barrier_begin = (uint32_t)_barriers.size();
+        if (compiled.culled) {
+            continue;
+        }
+        for (const _Access& access : _passes[i].accesses) {
+            const _Resource& resource = _resources[access.resource];
+            FrameGraphLifetime lifetime = _compiled_resources[access.resource].lifetime;
+            ResourceState& state = _states[state_index(access.resource)];
+            if (!resource.imported && lifetime.first_pass == i) {
+                if (!access.write) {
+                    KY_WARNING_MSG("Pass %s reads %s before any pass writes it", _passes[i].name,
+                                   resource.name);
+                }
+                // Undefined at the start of the frame, otherwise the memory still holds the
+                // resource aliased before whose last use has to finish first
+                _barriers.push_back({access.resource, state, access.state});
+                state = access.state;
+            } else if (state != access.state || is_write_state(state)) {
+                _barriers.push_back({access.resource, state, access.state});
+                state = access.state;
+            }
+        }
+        compiled.barrier_count = (uint32_t)_barriers.size() - compiled.barrier_begin;
+    }
+
+    _final_barrier_begin = (uint32_t)_barriers.size();
+    for (uint32_t i = 0; i < _resource_count; i++) {
+        const _Resource& resource = _resources[i];
+        if (resource.imported && resource.final_state != RESOURCE_STATE_UNDEFINED &&
+            _states[i] != resource.final_state) {
+            _barriers.push_back({i, _states[i], resource.final_state});
+        }
+    }
+    for (uint32_t i = 0; i < _physical_texture_count; i++) {
+        _physical_textures[i].final_state = _states[texture_first + i];
+    }
+    for (uint32_t i = 0; i < _physical_buffer_count; i++) {
+        _physical_buffers[i].final_state = _states[buffer_first + i];
+    }
+}
+
+bool FrameGraph::_create_physical(RenderContext& context) {
+    for (uint32_t i = 0; i < _physical_textures.size(); i++) {
+        _PhysicalTexture& physical = _physical_textures[i];
+        bool used = i < _physical_texture_count;
+        if (used && !physical.changed && context.alive(physical.texture)) {
+            continue;
+        }
+        if (physical.texture.valid()) {
+            context.destroy(physical.texture);
+            physical.texture = TextureHandle();
+        }
+        if (used) {
+            TextureDesc desc = physical.desc;
+            desc.name = _resources[physical.owner].name;
+            physical.texture = context.create_texture(desc);
+            physical.state = RESOURCE_STATE_UNDEFINED;
+            physical.changed = false;
+            KY_ERROR_CONDITION_MSG_RETURN(physical.texture.valid(), false,
+                                          "Failed to create frame graph texture");
+        }
+    }
+    _physical_textures.resize(_physical_texture_count);
+
+    for (uint32_t i = 0; i < _physical_buffers.size(); i++) {
+        _PhysicalBuffer& physical = _physical_buffers[i];
+        bool used = i < _physical_buffer_count;
+        if (used && !physical.changed && context.alive(physical.buffer)) {
+            continue;
+        }
+        if (physical.buffer.valid()) {
+            context.destroy(physical.buffer);
+            physical.buffer = BufferHandle();
+        }
+        if (used) {
+            BufferDesc desc = physical.desc;
+            desc.name = _resources[physical.owner].name;
+            physical.buffer = context.create_buffer(desc);
+            physical.state = RESOURCE_STATE_UNDEFINED;
+            physical.changed = false;
+            KY_ERROR_CONDITION_MSG_RETURN(physical.buffer.valid(), false,
+                                          "Failed to create frame graph buffer");
+        }
+    }
+    _physical_buffers.resize(_physical_buffer_count);
+    return true;
+}
+
+void FrameGraph::_record(RenderContext& context, FrameGraphPass index) {
+    KY_PROFILE_SCOPE("FrameGraph::record");
+    _Pass& pass = _passes[index];
+    const _CompiledPass& compiled = _compiled_passes[index];
+    pass.buffer_barriers.clear();
+    pass.texture_barriers.clear();
+    for (uint32_t i = 0; i < compiled.barrier_count; i++) {
+        const FrameGraphBarrier& barrier = _barriers[compiled.barrier_begin + i];
+        const _Resource& resource = _resources[barrier.resource];
+        uint32_t physical = _compiled_resources[barrier.resource].physical;
+        ResourceState before = barrier.before;
+        if (resource.type == _RESOURCE_TEXTURE) {
+            if (!resource.imported && before == RESOURCE_STATE_UNDEFINED) {
+                // Waits on the previous frame's last use of the memory
+                before = _physical_textures[physical].state;
+            }
+            pass.texture_barriers.push_back({resource.texture, before, barrier.after});
+        } else {
+            if (!resource.imported && before == RESOURCE_STATE_UNDEFINED) {
+                before = _physical_buffers[physical].state;
+            }
+            pass.buffer_barriers.push_back({resource.buffer, before, barrier.after});
+        }
+    }
+
+    pass.list = context.command_list();
+    pass.lists.clear();
+    if (compiled.barrier_count > 0) {
+        pass.list->barrier(pass.buffer_barriers.data(), (uint32_t)pass.buffer_barriers.size(),
+                           pass.texture_barriers.data(), (uint32_t)pass.texture_barriers.size());
+    }
+    if (pass.function) {
+        FrameGraphPassContext pass_context;
+        pass_context._graph = this;
+        pass_context._pass = index;
+        pass_context._list = pass.list;
+        pass_context._lists = &pass.lists;
+        pass_context._render_context = &context;
+        pass.function(pass_context);
+    }
+}
+
+} // namespace ky
@@ -0,0 +1,306 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_RENDERER__FRAME_GRAPH_H
+#define KRYOS_RENDERER__FRAME_GRAPH_H
+
+#include "core/memory_tracker.h"
+#include "render_hardware/base/command_list.h"
+#include "render_hardware/base/resources.h"
+
+#include <cstdint>
+#include <functional>
+
+namespace ky {
+
+class RenderContext;
+class FrameGraph;
+
+using FrameGraphPass = uint32_t;
+using FrameGraphResource = uint32_t;
+
+// Transition a pass needs before it runs. The first barrier of a transient resource discards its
+// contents, it starts out `RESOURCE_STATE_UNDEFINED` or in the last state of the resource aliased
+// before it. Executing replaces undefined with the state the previous frame left the physical
+// resource in, so the GPU finished with the memory before it's reused.
+struct FrameGraphBarrier {
+    FrameGraphResource resource;
+    ResourceState before;
+    ResourceState after;
+};
+
+// Live passes a resource is used between, `KY_RHI_INVALID_INDEX` when no live pass uses it.
+struct FrameGraphLifetime {
+    FrameGraphPass first_pass = KY_RHI_INVALID_INDEX;
+    FrameGraphPass last_pass = KY_RHI_INVALID_INDEX;
+};
+
+struct FrameGraphStats {
+    uint32_t passes = 0;
+    uint32_t culled_passes = 0;
+    uint32_t transient_resources = 0;
+    uint32_t physical_textures = 0;
+    uint32_t physical_buffers = 0;
+    uint32_t barriers = 0;
+    // Estimated memory of the transient resources used, and of the physical ones backing them
+    uint64_t transient_bytes = 0;
+    uint64_t physical_bytes = 0;
+    uint32_t compiles = 0;
+    // Compiles skipped because the graph matched the last one compiled
+    uint32_t cached_compiles = 0;
+};
+
+// Passed to passes while they record.
+class FrameGraphPassContext {
+public:
+    // List of the pass, its barriers are already recorded
+    inline CommandList& list() const { return *_list; }
+    // Lists submitted right after `list`, e.g. for `RenderContext::record_parallel`
+    inline TaggedVector<CommandList*, MEMORY_TAG_RENDER>& lists() const { return *_lists; }
+    inline RenderContext& render_context() const { return *_render_context; }
+
+    // Handles of the resources the pass declared, invalid for any other resource.
+    TextureHandle texture(FrameGraphResource resource) const;
+    BufferHandle buffer(FrameGraphResource resource) const;
+
+private:
+    friend class FrameGraph;
+
+    const FrameGraph* _graph = nullptr;
+    FrameGraphPass _pass = 0;
+    CommandList* _list = nullptr;
+    TaggedVector<CommandList*, MEMORY_TAG_RENDER>* _lists = nullptr;
+    RenderContext* _render_context = nullptr;
+};
+
+using FrameGraphPassFunction = std::function<void(const FrameGraphPassContext& context)>;
+
+// Passes of a frame and the resources they read and write, declared anew every frame. Passes run
+// in the order they were added. Compiling the graph culls the passes whose writes nothing reads,
+// works out when each resource is used and derives the barriers each pass needs, batched into one
+// barrier command before the pass.
+//
+// Transient resources are created by the graph. Those whose lifetimes don't overlap share one
+// physical resource when their descriptions only differ in usage or, for buffers, size. Imported
+// resources are owned elsewhere, e.g. the swapchain texture, and always count as read after the
+// frame so the passes writing them are kept.
+//
+// Compiling is skipped when the frame declared the same passes, resources and accesses as the one
+// last compiled, the previous result is reused as is. Compilation doesn't need a render context,
+// the decisions it made can be inspected before executing.
+//
+//     graph.reset();
+//     FrameGraphResource color = graph.create_texture("color", color_desc);
+//     FrameGraphResource swapchain = graph.import_texture("swapchain", texture,
+//                                                         RESOURCE_STATE_UNDEFINED,
+//                                                         RESOURCE_STATE_PRESENT);
+//     graph.add_pass("scene", [=](const FrameGraphPassContext& context) { ... })
+//         .write(color, RESOURCE_STATE_COLOR_ATTACHMENT);
+//     graph.add_pass("tonemap", [=](const FrameGraphPassContext& context) { ... })
+//         .read(color, RESOURCE_STATE_SHADER_READ)
+//         .write(swapchain, RESOURCE_STATE_COLOR_ATTACHMENT);
+//     graph.execute(context);
+class FrameGraph {
+public:
+    class PassBuilder {
+    public:
+        // `write` overwrites what the pass touches. Passes preserving earlier contents, e.g. by
+        // loading an attachment or writing part of a buffer, declare `read_write`.
+        PassBuilder& read(FrameGraphResource resource, ResourceState state);
+        PassBuilder& write(FrameGraphResource resource, ResourceState state);
+        PassBuilder& read_write(FrameGraphResource resource, ResourceState state);
+
+        // Never culls the pass, for passes with effects the graph can't see, e.g. readbacks.
+        PassBuilder& side_effects();
+
+        inline FrameGraphPass pass() const { return _pass; }
+
+    private:
+        friend class FrameGraph;
+
+        FrameGraph* _graph;
+        FrameGraphPass _pass;
+
+        PassBuilder(FrameGraph* graph, FrameGraphPass pass) : _graph(graph), _pass(pass) {}
+    };
+
+    FrameGraph() = default;
+
+    FrameGraph(const FrameGraph&) = delete;
+    FrameGraph& operator=(const FrameGraph&) = delete;
+
+    // Starts declaring the next frame. Memory, the physical resources and the last compiled graph
+    // are kept.
+    void reset();
+
+    // Names have to stay valid until the graph is reset.
+    FrameGraphResource create_texture(const char* name, const TextureDesc& desc);
+    FrameGraphResource create_buffer(const char* name, const BufferDesc& desc);
+    // `final_state` is transitioned to after the last pass, `RESOURCE_STATE_UNDEFINED` leaves the
+    // resource in the state the last pass used it in.
+    FrameGraphResource import_texture(const char* name, TextureHandle texture,
+                                      ResourceState initial_state,
+                                      ResourceState final_state = RESOURCE_STATE_UNDEFINED);
+    FrameGraphResource import_buffer(const char* name, BufferHandle buffer,
+                                     ResourceState initial_state,
+                                     ResourceState final_state = RESOURCE_STATE_UNDEFINED);
+
+    PassBuilder add_pass(const char* name, FrameGraphPassFunction function);
+
+    // False when the graph is invalid, e.g. a pass uses a resource in two states.
+    bool compile();
+    // Compiles, creates the physical resources that changed and records the live passes on the
+    // job system, one command list each, then submits them in order. Call between
+    // `RenderContext::begin_frame` and `end_frame`.
+    bool execute(RenderContext& context);
+    // Destroys the physical resources, the context has to be the one `execute` used.
+    void shutdown(RenderContext& context);
+
+    inline uint32_t pass_count() const { return _pass_count; }
+    inline uint32_t resource_count() const { return _resource_count; }
+    inline const char* pass_name(FrameGraphPass pass) const { return _passes[pass].name; }
+    inline const char* resource_name(FrameGraphResource resource) const {
+        return _resources[resource].name;
+    }
+
+    // Decisions of the last compile.
+    bool pass_culled(FrameGraphPass pass) const;
+    uint32_t pass_barrier_count(FrameGraphPass pass) const;
+    const FrameGraphBarrier* pass_barriers(FrameGraphPass pass) const;
+    // Transitions of imported resources to their final state after the last pass
+    uint32_t final_barrier_count() const;
+    const FrameGraphBarrier* final_barriers() const;
+    FrameGraphLifetime lifetime(FrameGraphResource resource) const;
+    // Physical texture or buffer backing a transient resource, the transient resources sharing
+    // one alias each other. `KY_RHI_INVALID_INDEX` for imported and unused resources.
+    uint32_t physical_resource(FrameGraphResource resource) const;
+    inline const FrameGraphStats& stats() const { return _stats; }
+
+private:
+    friend class FrameGraphPassContext;
+
+    enum _ResourceType : uint32_t {
+        _RESOURCE_TEXTURE,
+        _RESOURCE_BUFFER,
+    };
+
+    struct _Access {
+        FrameGraphResource resource;
+        ResourceState state;
+        bool read;
+        bool write;
+    };
+
+    struct _Resource {
+        const char* name = nullptr;
+        _ResourceType type = _RESOURCE_TEXTURE;
+        bool imported = false;
+        TextureDesc texture_desc;
+        BufferDesc buffer_desc;
+        ResourceState initial_state = RESOURCE_STATE_UNDEFINED;
+        ResourceState final_state = RESOURCE_STATE_UNDEFINED;
+        // Imported handles, or the physical resource's while executing
+        TextureHandle texture;
+        BufferHandle buffer;
+    };
+
+    // Entries are reused across frames so their vectors keep their capacity
+    struct _Pass {
+        const char* name = nullptr;
+        FrameGraphPassFunction function;
+        TaggedVector<_Access, MEMORY_TAG_RENDER> accesses;
+        bool side_effects = false;
+
+        TaggedVector<BufferBarrier, MEMORY_TAG_RENDER> buffer_barriers;
+        TaggedVector<TextureBarrier, MEMORY_TAG_RENDER> texture_barriers;
+        CommandList* list = nullptr;
+        TaggedVector<CommandList*, MEMORY_TAG_RENDER> lists;
+    };
+
+    struct _CompiledPass {
+        bool culled = false;
+        uint32_t barrier_begin = 0;
+        uint32_t barrier_count = 0;
+    };
+
+    struct _CompiledResource {
+        FrameGraphLifetime lifetime;
+        uint32_t physical = KY_RHI_INVALID_INDEX;
+    };
+
+    // Created by `execute` from the description the last compile settled on
+    struct _PhysicalTexture {
+        TextureDesc desc;
+        TextureHandle texture;
+        // First resource backed by it, names the resource when created
+        FrameGraphResource owner = 0;
+        // State the frame leaves it in, as compiled and as last executed
+        ResourceState final_state = RESOURCE_STATE_UNDEFINED;
+        ResourceState state = RESOURCE_STATE_UNDEFINED;
+        bool changed = true;
+    };
+
+    struct _PhysicalBuffer {
+        BufferDesc desc;
+        BufferHandle buffer;
+        // First resource backed by it, names the resource when created
+        FrameGraphResource owner = 0;
+        ResourceState final_state = RESOURCE_STATE_UNDEFINED;
+        ResourceState state = RESOURCE_STATE_UNDEFINED;
+        bool changed = true;
+    };
+
+    TaggedVector<_Pass, MEMORY_TAG_RENDER> _passes;
+    TaggedVector<_Resource, MEMORY_TAG_RENDER> _resources;
+    uint32_t _pass_count = 0;
+    uint32_t _resource_count = 0;
+
+    uint64_t _compiled_hash = 0;
+    bool _compiled = false;
+    bool _compile_succeeded = false;
+    TaggedVector<_CompiledPass, MEMORY_TAG_RENDER> _compiled_passes;
+    TaggedVector<_CompiledResource, MEMORY_TAG_RENDER> _compiled_resources;
+    TaggedVector<FrameGraphBarrier, MEMORY_TAG_RENDER> _barriers;
+    uint32_t _final_barrier_begin = 0;
+    TaggedVector<_PhysicalTexture, MEMORY_TAG_RENDER> _physical_textures;
+    TaggedVector<_PhysicalBuffer, MEMORY_TAG_RENDER> _physical_buffers;
+    uint32_t _physical_texture_count = 0;
+    uint32_t _physical_buffer_count = 0;
+    FrameGraphStats _stats;
+
+    // Scratch of `compile` and `execute`
+    TaggedVector<uint32_t, MEMORY_TAG_RENDER> _order;
+    TaggedVector<uint8_t, MEMORY_TAG_RENDER> _needed;
+    TaggedVector<ResourceState, MEMORY_TAG_RENDER> _states;
+    TaggedVector<FrameGraphPass, MEMORY_TAG_RENDER> _live_passes;
+    TaggedVector<CommandList*, MEMORY_TAG_RENDER> _submit_lists;
+    TaggedVector<BufferBarrier, MEMORY_TAG_RENDER> _final_buffer_barriers;
+    TaggedVector<TextureBarrier, MEMORY_TAG_RENDER> _final_texture_barriers;
+
+    FrameGraphResource _add_resource(const char* name, _ResourceType type);
+    void _declare(FrameGraphPass pass, FrameGraphResource resource, ResourceState state,
+                  bool read, bool write);
+    uint64_t _hash() const;
+    bool _validate() const;
+    void _cull();
+    void _assign_physical();
+    void _derive_barriers();
+    bool _create_physical(RenderContext& context);
+    void _record(RenderContext& context, FrameGraphPass pass);
+};
+
+} // namespace ky
+
+#endif
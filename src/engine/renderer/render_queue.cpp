@@ -0,0 +1,348 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "renderer/render_queue.h"
+
+#include "core/error.h"
+#include "core/jobs.h"
+#include "core/profiler.h"
+#include "render_hardware/base/context.h"
+
+#include <cstring>
+
+namespace ky {
+
+// Fields shared by both sort modes
+static constexpr uint32_t _LAYER_SHIFT = 60;
+static constexpr uint32_t _PASS_SHIFT = 55;
+static constexpr uint32_t _MODE_SHIFT = 54;
+
+static constexpr uint32_t _OPAQUE_PIPELINE_SHIFT = 42;
+static constexpr uint32_t _OPAQUE_MATERIAL_SHIFT = 28;
+static constexpr uint32_t _OPAQUE_MESH_SHIFT = 14;
+static constexpr uint32_t _OPAQUE_DEPTH_BITS = 14;
+
+static constexpr uint32_t _TRANSLUCENT_DEPTH_SHIFT = 26;
+static constexpr uint32_t _TRANSLUCENT_DEPTH_BITS = 28;
+static constexpr uint32_t _TRANSLUCENT_PIPELINE_SHIFT = 14;
+
+static constexpr uint32_t _RADIX_BITS = 8;
+static constexpr uint32_t _RADIX_SIZE = 1 << _RADIX_BITS;
+
+static_assert(KY_RENDER_QUEUE_MAX_LAYERS == 1 << (64 - _LAYER_SHIFT));
+static_assert(KY_RENDER_QUEUE_MAX_PASSES == 1 << (_LAYER_SHIFT - _PASS_SHIFT));
+static_assert(KY_RHI_MAX_PIPELINES <= 1 << (_MODE_SHIFT - _OPAQUE_PIPELINE_SHIFT),
+              "Pipeline indices don't fit in sort keys");
+static_assert(KY_RENDER_QUEUE_MAX_MATERIALS == 1 << _TRANSLUCENT_PIPELINE_SHIFT);
+static_assert(KY_RENDER_QUEUE_MAX_MESHES == 1 << (_OPAQUE_MATERIAL_SHIFT - _OPAQUE_MESH_SHIFT));
+
+static inline uint64_t quantize_depth(float depth, uint32_t bits) {
+    double clamped = depth > 0.0f ? std::min((double)depth, 1.0) : 0.0;
+    return (uint64_t)(clamped * (double)((1ull << bits) - 1) + 0.5);
+}
+
+// Stable least significant digit first radix sort of keys and the items they belong to, digits
+// all keys share are skipped. Chunks of the arrays are counted and scattered in parallel, the
+// offset of each chunk's digits is the prefix sum over digits and then chunks in order, so the
+// order of equal digits is kept across chunks. Sorted arrays end up in `keys` and `items`.
+static void radix_sort(TaggedVector<uint64_t, MEMORY_TAG_RENDER>& keys,
+                       TaggedVector<uint32_t, MEMORY_TAG_RENDER>& items,
+                       TaggedVector<uint64_t, MEMORY_TAG_RENDER>& temp_keys,
+                       TaggedVector<uint32_t, MEMORY_TAG_RENDER>& temp_items,
+                       TaggedVector<uint32_t, MEMORY_TAG_RENDER>& histograms, size_t count) {
+    size_t chunk_count =
+        (count + KY_RENDER_QUEUE_SORT_CHUNK_SIZE - 1) / KY_RENDER_QUEUE_SORT_CHUNK_SIZE;
+    histograms.resize(chunk_count * _RADIX_SIZE);
+    temp_keys.resize(keys.size());
+    temp_items.resize(items.size());
+    auto chunk_end = [count](size_t chunk) {
+        return std::min((chunk + 1) * KY_RENDER_QUEUE_SORT_CHUNK_SIZE, count);
+    };
+
+    // Bits set in some keys but not in all of them
+    TaggedVector<uint64_t, MEMORY_TAG_RENDER> bits(chunk_count * 2);
+    JobSystem::parallel_for(
+        chunk_count,
+        [&](size_t chunk) {
+            uint64_t any = 0;
+            uint64_t all = ~0ull;
+            for (size_t i = chunk * KY_RENDER_QUEUE_SORT_CHUNK_SIZE; i < chunk_end(chunk); i++) {
+                any |= keys[i];
+                all &= keys[i];
+            }
+            bits[chunk * 2] = any;
+            bits[chunk * 2 + 1] = all;
+        },
+        1);
+    uint64_t any = 0;
+    uint64_t all = ~0ull;
+    for (size_t chunk = 0; chunk < chunk_count; chunk++) {
+        any |= bits[chunk * 2];
+        all &= bits[chunk * 2 + 1];
+    }
+    uint64_t varying = any & ~all;
+
+    for (uint32_t shift = 0; shift < 64; shift += _RADIX_BITS) {
+        if (((varying >> shift) & (_RADIX_SIZE - 1)) == 0) {
+            continue;
+        }
+        JobSystem::parallel_for(
+            chunk_count,
+            [&](size_t chunk) {
+                uint32_t* histogram = histograms.data() + chunk * _RADIX_SIZE;
+                std::memset(histogram, 0, _RADIX_SIZE * sizeof(uint32_t));
+                for (size_t i = chunk * KY_RENDER_QUEUE_SORT_CHUNK_SIZE; i < chunk_end(chunk);
+                     i++) {
+                    histogram[(keys[i] >> shift) & (_RADIX_SIZE - 1)]++;
+                }
+            },
+            1);
+
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < _RADIX_SIZE; digit++) {
+            for (size_t chunk = 0; chunk < chunk_count; chunk++) {
+                uint32_t& entry = histograms[chunk * _RADIX_SIZE + digit];
+                uint32_t digit_count = entry;
+                entry = offset;
+                offset += digit_count;
+            }
+        }
+
+        JobSystem::parallel_for(
+            chunk_count,
+            [&](size_t chunk) {
+                uint32_t* offsets = histograms.data() + chunk * _RADIX_SIZE;
+                for (size_t i = chunk * KY_RENDER_QUEUE_SORT_CHUNK_SIZE; i < chunk_end(chunk);
+                     i++) {
+                    uint32_t destination = offsets[(keys[i] >> shift) & (_RADIX_SIZE - 1)]++;
+                    temp_keys[destination] = keys[i];
+                    temp_items[destination] = items[i];
+                }
+            },
+            1);
+        keys.swap(temp_keys);
+        items.swap(temp_items);
+    }
+}
+
+bool RenderQueue::init(uint32_t instance_size) {
+    KY_ERROR_CONDITION_MSG_RETURN(instance_size > 0 && instance_size % 4 == 0, false,
+                                  "Instance data size has to be a non zero multiple of 4");
+    _instance_size = instance_size;
+    _meshes.clear();
+    _materials.clear();
+    reset(0);
+    return true;
+}
+
+uint32_t RenderQueue::add_mesh(const RenderMesh& mesh) {
+    KY_ERROR_CONDITION_MSG_RETURN(_meshes.size() < KY_RENDER_QUEUE_MAX_MESHES,
+                                  KY_RHI_INVALID_INDEX, "Render queue mesh limit reached");
+    _meshes.push_back(mesh);
+    return (uint32_t)_meshes.size() - 1;
+}
+
+uint32_t RenderQueue::add_material(const RenderMaterial& material) {
+    KY_ERROR_CONDITION_MSG_RETURN(_materials.size() < KY_RENDER_QUEUE_MAX_MATERIALS,
+                                  KY_RHI_INVALID_INDEX, "Render queue material limit reached");
+    KY_ERROR_CONDITION_MSG_RETURN(material.texture_count <= KY_RHI_TEXTURE_SLOTS,
+                                  KY_RHI_INVALID_INDEX, "Material has too many textures");
+    _materials.push_back(material);
+    return (uint32_t)_materials.size() - 1;
+}
+
+uint64_t RenderQueue::sort_key(const RenderItem& item, PipelineHandle pipeline) {
+    uint64_t key = (uint64_t)item.layer << _LAYER_SHIFT | (uint64_t)item.pass << _PASS_SHIFT |
+                   (uint64_t)item.sort << _MODE_SHIFT;
+    if (item.sort == RENDER_SORT_OPAQUE) {
+        return key | (uint64_t)pipeline.index << _OPAQUE_PIPELINE_SHIFT |
+               (uint64_t)item.material << _OPAQUE_MATERIAL_SHIFT |
+               (uint64_t)item.mesh << _OPAQUE_MESH_SHIFT |
+               quantize_depth(item.depth, _OPAQUE_DEPTH_BITS);
+    }
+    uint64_t far_first = ((1ull << _TRANSLUCENT_DEPTH_BITS) - 1) -
+                         quantize_depth(item.depth, _TRANSLUCENT_DEPTH_BITS);
+    return key | far_first << _TRANSLUCENT_DEPTH_SHIFT |
+           (uint64_t)pipeline.index << _TRANSLUCENT_PIPELINE_SHIFT | item.material;
+}
+
+void RenderQueue::reset(uint32_t capacity) {
+    _capacity = capacity;
+    _count.store(0, std::memory_order_relaxed);
+    _dropped.store(0, std::memory_order_relaxed);
+    _added.resize(capacity);
+    _instance_data.resize((size_t)capacity * _instance_size);
+    _keys.resize(capacity);
+    _items.resize(capacity);
+    _batches.clear();
+    _upload = UploadAllocation();
+    _stats = RenderQueueStats();
+}
+
+bool RenderQueue::add(const RenderItem& item, const void* instance_data) {
+    if (item.material >= _materials.size() || item.mesh >= _meshes.size() ||
+        item.layer >= KY_RENDER_QUEUE_MAX_LAYERS || item.pass >= KY_RENDER_QUEUE_MAX_PASSES) {
+        KY_ERROR_MSG("Render item with material %u, mesh %u, layer %u and pass %u is invalid",
+                     item.material, item.mesh, (uint32_t)item.layer, (uint32_t)item.pass);
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    uint32_t index = _count.fetch_add(1, std::memory_order_relaxed);
+    if (index >= _capacity) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    _added[index] = item;
+    _keys[index] = sort_key(item, _materials[item.material].pipeline);
+    _items[index] = index;
+    std::memcpy(_instance_data.data() + (size_t)index * _instance_size, instance_data,
+                _instance_size);
+    return true;
+}
+
+void RenderQueue::sort() {
+    KY_PROFILE_SCOPE("RenderQueue::sort");
+    uint32_t count = size();
+    _keys.resize(count);
+    _items.resize(count);
+    radix_sort(_keys, _items, _sort_keys, _sort_items, _histograms, count);
+}
+
+bool RenderQueue::build(RenderContext& context) {
+    KY_PROFILE_SCOPE("RenderQueue::build");
+    uint32_t count = (uint32_t)_keys.size();
+    _batches.clear();
+    _stats = RenderQueueStats();
+    _stats.items = count;
+    _stats.dropped_items = _dropped.load(std::memory_order_relaxed);
+    if (count == 0) {
+        _upload = UploadAllocation();
+        return true;
+    }
+
+    _upload = context.upload((uint64_t)count * _instance_size);
+    KY_ERROR_CONDITION_MSG_RETURN(_upload.valid(), false,
+                                  "Failed to upload the render queue's instance data");
+    size_t chunk_count =
+        (count + KY_RENDER_QUEUE_SORT_CHUNK_SIZE - 1) / KY_RENDER_QUEUE_SORT_CHUNK_SIZE;
+    JobSystem::parallel_for(
+        chunk_count,
+        [&](size_t chunk) {
+            size_t end = std::min((chunk + 1) * KY_RENDER_QUEUE_SORT_CHUNK_SIZE, (size_t)count);
+            for (size_t i = chunk * KY_RENDER_QUEUE_SORT_CHUNK_SIZE; i < end; i++) {
+                std::memcpy(_upload.data + i * _instance_size,
+                            _instance_data.data() + (size_t)_items[i] * _instance_size,
+                            _instance_size);
+            }
+        },
+        1);
+
+    PipelineHandle pipeline;
+    for (uint32_t i = 0; i < count; i++) {
+        const RenderItem& item = _added[_items[i]];
+        if (!_batches.empty()) {
+            RenderBatch& last = _batches.back();
+            if (last.material == item.material && last.mesh == item.mesh &&
+                last.key >> _MODE_SHIFT == _keys[i] >> _MODE_SHIFT) {
+                last.instance_count++;
+                continue;
+            }
+        }
+
+        const RenderMaterial& material = _materials[item.material];
+        if (_batches.empty() || !(material.pipeline == pipeline)) {
+            pipeline = material.pipeline;
+            _stats.pipeline_changes++;
+        }
+        if (_batches.empty() || _batches.back().material != item.material) {
+            _stats.material_changes++;
+        }
+        if (_batches.empty() || _batches.back().mesh != item.mesh) {
+            _stats.mesh_changes++;
+        }
+        RenderBatch batch;
+        batch.key = _keys[i];
+        batch.material = item.material;
+        batch.mesh = item.mesh;
+        batch.first_instance = i;
+        batch.instance_count = 1;
+        _batches.push_back(batch);
+    }
+    _stats.batches = (uint32_t)_batches.size();
+    return true;
+}
+
+RenderQueueRange RenderQueue::range(uint32_t layer, uint32_t pass) const {
+    uint64_t group = (uint64_t)layer << (_LAYER_SHIFT - _PASS_SHIFT) | pass;
+    const RenderBatch* begin = _batches.data();
+    const RenderBatch* end = begin + _batches.size();
+    const RenderBatch* first = std::partition_point(
+        begin, end, [&](const RenderBatch& batch) { return batch.key >> _PASS_SHIFT < group; });
+    const RenderBatch* last = std::partition_point(
+        first, end, [&](const RenderBatch& batch) { return batch.key >> _PASS_SHIFT == group; });
+    return {(uint32_t)(first - begin), (uint32_t)(last - begin)};
+}
+
+void RenderQueue::record(CommandList& list, uint32_t begin, uint32_t end) const {
+    KY_ERROR_CONDITION_MSG(begin <= end && end <= _batches.size(),
+                           "Render queue batch range is out of bounds");
+    if (begin == end) {
+        return;
+    }
+    list.bind_storage_buffer(KY_RENDER_QUEUE_INSTANCE_SLOT, _upload.buffer, _upload.offset,
+                             (uint64_t)_keys.size() * _instance_size);
+
+    PipelineHandle pipeline;
+    uint32_t material_index = KY_RHI_INVALID_INDEX;
+    uint32_t mesh_index = KY_RHI_INVALID_INDEX;
+    for (uint32_t i = begin; i < end; i++) {
+        const RenderBatch& batch = _batches[i];
+        if (batch.material != material_index) {
+            const RenderMaterial& material = _materials[batch.material];
+            if (!(material.pipeline == pipeline)) {
+                list.bind_pipeline(material.pipeline);
+                pipeline = material.pipeline;
+            }
+            if (material.uniforms.valid()) {
+                list.bind_uniform_buffer(KY_RENDER_QUEUE_MATERIAL_SLOT, material.uniforms,
+                                         material.uniforms_offset, material.uniforms_size);
+            }
+            for (uint32_t slot = 0; slot < material.texture_count; slot++) {
+                list.bind_texture(slot, material.textures[slot], material.samplers[slot]);
+            }
+            material_index = batch.material;
+        }
+
+        const RenderMesh& mesh = _meshes[batch.mesh];
+        if (batch.mesh != mesh_index) {
+            if (mesh.vertex_buffer.valid()) {
+                list.bind_vertex_buffer(0, mesh.vertex_buffer, mesh.vertex_buffer_offset);
+            }
+            if (mesh.index_buffer.valid()) {
+                list.bind_index_buffer(mesh.index_buffer, mesh.index_type,
+                                       mesh.index_buffer_offset);
+            }
+            mesh_index = batch.mesh;
+        }
+        if (mesh.index_buffer.valid()) {
+            list.draw_indexed(mesh.count, batch.instance_count, mesh.first, mesh.vertex_offset,
+                              batch.first_instance);
+        } else {
+            list.draw(mesh.count, batch.instance_count, mesh.first, batch.first_instance);
+        }
+    }
+}
+
+} // namespace ky
@@ -0,0 +1,214 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_RENDERER__RENDER_QUEUE_H
+#define KRYOS_RENDERER__RENDER_QUEUE_H
+
+#include "core/memory_tracker.h"
+#include "render_hardware/base/command_list.h"
+#include "render_hardware/base/resources.h"
+#include "render_hardware/base/upload_ring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+// Items sorted by one job of the radix sort, queues with fewer are sorted on the calling thread.
+#ifndef KY_RENDER_QUEUE_SORT_CHUNK_SIZE
+#    define KY_RENDER_QUEUE_SORT_CHUNK_SIZE 16384
+#endif
+
+// Storage buffer slot the instance data of a queue is bound to, instanced shaders index it with
+// the instance index, which includes the first instance of the draw.
+#ifndef KY_RENDER_QUEUE_INSTANCE_SLOT
+#    define KY_RENDER_QUEUE_INSTANCE_SLOT 0
+#endif
+
+// Uniform buffer slot of the material uniforms, the slots below are left for per view data.
+#ifndef KY_RENDER_QUEUE_MATERIAL_SLOT
+#    define KY_RENDER_QUEUE_MATERIAL_SLOT 1
+#endif
+
+#define KY_RENDER_QUEUE_MAX_LAYERS    16
+#define KY_RENDER_QUEUE_MAX_PASSES    32
+#define KY_RENDER_QUEUE_MAX_MATERIALS 16384
+#define KY_RENDER_QUEUE_MAX_MESHES    16384
+
+namespace ky {
+
+class RenderContext;
+
+// Geometry drawn by items, with an index buffer `count` and `first` are indices, otherwise
+// vertices.
+struct RenderMesh {
+    BufferHandle vertex_buffer;
+    uint64_t vertex_buffer_offset = 0;
+    BufferHandle index_buffer;
+    uint64_t index_buffer_offset = 0;
+    IndexType index_type = INDEX_TYPE_UINT32;
+    uint32_t count = 0;
+    uint32_t first = 0;
+    int32_t vertex_offset = 0;
+};
+
+// Pipeline and resources bound for items, textures to slots from 0 up.
+struct RenderMaterial {
+    PipelineHandle pipeline;
+    // Bound to `KY_RENDER_QUEUE_MATERIAL_SLOT` when valid
+    BufferHandle uniforms;
+    uint64_t uniforms_offset = 0;
+    uint64_t uniforms_size = 0;
+    TextureHandle textures[KY_RHI_TEXTURE_SLOTS];
+    SamplerHandle samplers[KY_RHI_TEXTURE_SLOTS];
+    uint32_t texture_count = 0;
+};
+
+enum RenderSortMode : uint8_t {
+    // Sorted by state to minimize changes, then front to back
+    RENDER_SORT_OPAQUE,
+    // Sorted back to front, for blending. Drawn after the opaque items of their pass.
+    RENDER_SORT_TRANSLUCENT,
+};
+
+// Something to draw, e.g. a visible object of a cull with the LOD's mesh.
+struct RenderItem {
+    uint32_t material = 0;
+    uint32_t mesh = 0;
+    // Distance along the view direction over the far plane distance, clamped to [0, 1]
+    float depth = 0.0f;
+    // Layers are recorded separately, e.g. the world and the UI. Passes are the geometry passes
+    // of a layer, e.g. shadows, depth prepass and shading.
+    uint8_t layer = 0;
+    uint8_t pass = 0;
+    RenderSortMode sort = RENDER_SORT_OPAQUE;
+};
+
+// Consecutive sorted items drawing the same mesh with the same material, one instanced draw.
+struct RenderBatch {
+    uint64_t key = 0;
+    uint32_t material = 0;
+    uint32_t mesh = 0;
+    uint32_t first_instance = 0;
+    uint32_t instance_count = 0;
+};
+
+struct RenderQueueRange {
+    uint32_t begin = 0;
+    uint32_t end = 0;
+
+    inline uint32_t size() const { return end - begin; }
+};
+
+// Counts of the last build. State changes are counted as if every batch was recorded into one
+// list.
+struct RenderQueueStats {
+    uint32_t items = 0;
+    uint32_t batches = 0;
+    uint32_t pipeline_changes = 0;
+    uint32_t material_changes = 0;
+    uint32_t mesh_changes = 0;
+    uint32_t dropped_items = 0;
+};
+
+// Stage between culling and command recording. Items are added from any thread with a 64 bit sort
+// key and their per instance data, sorted by key with a parallel radix sort and merged into
+// instanced draws where consecutive items share their material and mesh. The instance data is
+// packed in sorted order into the frame's upload memory, so each batch reads a contiguous range
+// of it.
+//
+// From most to least significant, keys hold the layer, the pass and the sort mode, then the
+// pipeline, material, mesh and quantized depth of opaque items, or the inverted depth, pipeline
+// and material of translucent ones. Materials and meshes are registered up front, items refer to
+// them by index.
+//
+//     queue.reset(visible_count);
+//     JobSystem::parallel_for(visible_count, [&](size_t i) { queue.add(item, &transform); });
+//     queue.sort();
+//     queue.build(context);
+//     RenderQueueRange range = queue.range(layer, pass);
+//     context.record_parallel(pass_desc, range.size(), 256, lists,
+//                             [&](CommandList& list, size_t begin, size_t end) {
+//                                 queue.record(list, range.begin + begin, range.begin + end);
+//                             });
+class RenderQueue {
+public:
+    RenderQueue() = default;
+
+    RenderQueue(const RenderQueue&) = delete;
+    RenderQueue& operator=(const RenderQueue&) = delete;
+
+    // Bytes of per instance data every item has, a multiple of 4.
+    bool init(uint32_t instance_size);
+
+    // Index items refer to the mesh or material by, `KY_RHI_INVALID_INDEX` once full. Not safe
+    // while items are added.
+    uint32_t add_mesh(const RenderMesh& mesh);
+    uint32_t add_material(const RenderMaterial& material);
+    inline RenderMesh& mesh(uint32_t mesh) { return _meshes[mesh]; }
+    inline RenderMaterial& material(uint32_t material) { return _materials[material]; }
+
+    // Key the queue sorts an item by, `pipeline` is the pipeline of its material.
+    static uint64_t sort_key(const RenderItem& item, PipelineHandle pipeline);
+
+    // Empties the queue for a frame of at most `capacity` items.
+    void reset(uint32_t capacity);
+    // Copies `instance_data` of the queue's instance size. Safe to call from any thread, false
+    // when the item is invalid or the queue is full.
+    bool add(const RenderItem& item, const void* instance_data);
+
+    void sort();
+    // Merges the sorted items into batches and uploads their instance data for this frame.
+    bool build(RenderContext& context);
+
+    // Batches of a layer's pass, opaque ones first.
+    RenderQueueRange range(uint32_t layer, uint32_t pass) const;
+    // Records the batches in [begin, end) inside a render pass, nothing needs to be bound before.
+    void record(CommandList& list, uint32_t begin, uint32_t end) const;
+
+    inline uint32_t size() const { return std::min(_count.load(), _capacity); }
+    inline uint32_t instance_size() const { return _instance_size; }
+    // Keys in ascending order after `sort` and the index of the item each belongs to.
+    inline const uint64_t* keys() const { return _keys.data(); }
+    inline const uint32_t* items() const { return _items.data(); }
+    inline const RenderBatch* batches() const { return _batches.data(); }
+    inline uint32_t batch_count() const { return (uint32_t)_batches.size(); }
+    // Instance data of the batches, valid until the frame's slot is reused.
+    inline const UploadAllocation& instances() const { return _upload; }
+    inline const RenderQueueStats& stats() const { return _stats; }
+
+private:
+    uint32_t _instance_size = 0;
+    TaggedVector<RenderMesh, MEMORY_TAG_RENDER> _meshes;
+    TaggedVector<RenderMaterial, MEMORY_TAG_RENDER> _materials;
+
+    uint32_t _capacity = 0;
+    std::atomic<uint32_t> _count = 0;
+    std::atomic<uint32_t> _dropped = 0;
+    TaggedVector<RenderItem, MEMORY_TAG_RENDER> _added;
+    TaggedVector<uint8_t, MEMORY_TAG_RENDER> _instance_data;
+    TaggedVector<uint64_t, MEMORY_TAG_RENDER> _keys;
+    TaggedVector<uint32_t, MEMORY_TAG_RENDER> _items;
+    TaggedVector<uint64_t, MEMORY_TAG_RENDER> _sort_keys;
+    TaggedVector<uint32_t, MEMORY_TAG_RENDER> _sort_items;
+    TaggedVector<uint32_t, MEMORY_TAG_RENDER> _histograms;
+
+    TaggedVector<RenderBatch, MEMORY_TAG_RENDER> _batches;
+    UploadAllocation _upload;
+    RenderQueueStats _stats;
+};
+
+} // namespace ky
+
+#endif
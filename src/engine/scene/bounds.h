@@ -0,0 +1,164 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_SCENE__BOUNDS_H
+#define KRYOS_SCENE__BOUNDS_H
+
+#include <cfloat>
+#include <glm/glm.hpp>
+
+namespace ky {
+
+// Axis aligned bounding box. Default constructed boxes are empty, merging anything into them
+// yields the other box.
+struct Aabb {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    Aabb() = default;
+    Aabb(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
+
+    inline glm::vec3 center() const { return (min + max) * 0.5f; }
+    inline glm::vec3 extents() const { return (max - min) * 0.5f; }
+
+    inline float surface_area() const {
+        glm::vec3 size = max - min;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    inline bool contains(const Aabb& other) const {
+        return glm::all(glm::lessThanEqual(min, other.min)) &&
+               glm::all(glm::greaterThanEqual(max, other.max));
+    }
+
+    inline bool overlaps(const Aabb& other) const {
+        return glm::all(glm::lessThanEqual(min, other.max)) &&
+               glm::all(glm::greaterThanEqual(max, other.min));
+    }
+
+    // Squared distance from `point` to the box, 0 inside it.
+    inline float distance_squared(const glm::vec3& point) const {
+        glm::vec3 outside = glm::max(glm::max(min - point, point - max), glm::vec3(0.0f));
+        return glm::dot(outside, outside);
+    }
+
+    inline Aabb expanded(float margin) const {
+        return Aabb(min - glm::vec3(margin), max + glm::vec3(margin));
+    }
+
+    static inline Aabb merge(const Aabb& a, const Aabb& b) {
+        return Aabb(glm::min(a.min, b.min), glm::max(a.max, b.max));
+    }
+};
+
+struct Ray {
+    glm::vec3 origin = glm::vec3(0.0f);
+    glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+
+    Ray() = default;
+    Ray(const glm::vec3& origin, const glm::vec3& direction)
+            : origin(origin), direction(direction) {}
+
+    // Slab test against `box` with `inverse_direction = 1 / direction`. Returns the entry
+    // distance in `t`, 0 when the ray starts inside, if it's within [0, max_t].
+    inline bool intersect(const Aabb& box, const glm::vec3& inverse_direction, float max_t,
+                          float& t) const {
+        glm::vec3 t0 = (box.min - origin) * inverse_direction;
+        glm::vec3 t1 = (box.max - origin) * inverse_direction;
+        glm::vec3 t_enter = glm::min(t0, t1);
+        glm::vec3 t_exit = glm::max(t0, t1);
+        float enter = glm::max(glm::max(t_enter.x, t_enter.y), glm::max(t_enter.z, 0.0f));
+        float exit = glm::min(glm::min(t_exit.x, t_exit.y), glm::min(t_exit.z, max_t));
+        t = enter;
+        return enter <= exit;
+    }
+};
+
+enum FrustumTest {
+    FRUSTUM_OUTSIDE,
+    FRUSTUM_INTERSECTS,
+    FRUSTUM_INSIDE,
+};
+
+// View frustum as six normalized planes facing inwards, `dot(xyz, point) + w >= 0` inside.
+struct Frustum {
+    enum Plane {
+        PLANE_LEFT,
+        PLANE_RIGHT,
+        PLANE_BOTTOM,
+        PLANE_TOP,
+        PLANE_NEAR,
+        PLANE_FAR,
+        PLANE_COUNT,
+    };
+
+    glm::vec4 planes[PLANE_COUNT];
+
+    // Extracts the planes of a projection or view projection matrix, following glm's clip space
+    // depth convention.
+    static inline Frustum from_matrix(const glm::mat4& matrix) {
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++) {
+            rows[i] = glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+        }
+
+        Frustum frustum;
+        frustum.planes[PLANE_LEFT] = rows[3] + rows[0];
+        frustum.planes[PLANE_RIGHT] = rows[3] - rows[0];
+        frustum.planes[PLANE_BOTTOM] = rows[3] + rows[1];
+        frustum.planes[PLANE_TOP] = rows[3] - rows[1];
+#ifdef GLM_FORCE_DEPTH_ZERO_TO_ONE
+        frustum.planes[PLANE_NEAR] = rows[2];
+#else
+        frustum.planes[PLANE_NEAR] = rows[3] + rows[2];
+#endif
+        frustum.planes[PLANE_FAR] = rows[3] - rows[2];
+        for (glm::vec4& plane : frustum.planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+
+    inline FrustumTest test(const Aabb& box) const {
+        glm::vec3 center = box.center();
+        glm::vec3 extents = box.extents();
+        FrustumTest result = FRUSTUM_INSIDE;
+        for (const glm::vec4& plane : planes) {
+            glm::vec3 normal = glm::vec3(plane);
+            float distance = glm::dot(normal, center) + plane.w;
+            float radius = glm::dot(glm::abs(normal), extents);
+            if (distance < -radius) {
+                return FRUSTUM_OUTSIDE;
+            }
+            if (distance < radius) {
+                result = FRUSTUM_INTERSECTS;
+            }
+        }
+        return result;
+    }
+
+    inline bool test_sphere(const glm::vec3& center, float radius) const {
+        for (const glm::vec4& plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+} // namespace ky
+
+#endif
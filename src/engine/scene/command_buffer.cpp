@@ -0,0 +1,71 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "scene/command_buffer.h"
+
+namespace ky {
+
+CommandBuffer::~CommandBuffer() {
+    _clear();
+}
+
+DeferredEntity CommandBuffer::create() {
+    DeferredEntity entity = {_created_count++};
+    _commands.push_back(_Record {entt::null, entity.index, nullptr, nullptr, nullptr});
+    return entity;
+}
+
+void CommandBuffer::destroy(entt::entity entity) {
+    _commands.push_back(_Record {
+        entity,
+        _NOT_DEFERRED,
+        [](entt::registry& registry, entt::entity entity, void*) { registry.destroy(entity); },
+        nullptr,
+        nullptr,
+    });
+}
+
+void CommandBuffer::apply(entt::registry& registry) {
+    _created.assign(_created_count, entt::null);
+    for (_Record& record : _commands) {
+        entt::entity entity = record.entity;
+        if (record.deferred != _NOT_DEFERRED) {
+            entt::entity& created = _created[record.deferred];
+            if (record.function == nullptr) {
+                created = registry.create();
+                continue;
+            }
+            entity = created;
+        }
+
+        if (registry.valid(entity)) {
+            record.function(registry, entity, record.payload);
+        }
+    }
+    _clear();
+}
+
+void CommandBuffer::_clear() {
+    for (_Record& record : _commands) {
+        if (record.destroy != nullptr) {
+            record.destroy(record.payload);
+        }
+    }
+    _commands.clear();
+    _created_count = 0;
+    _payloads.reset();
+}
+
+} // namespace ky
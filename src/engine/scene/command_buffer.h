@@ -0,0 +1,150 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_SCENE__COMMAND_BUFFER_H
+#define KRYOS_SCENE__COMMAND_BUFFER_H
+
+#include "core/memory.h"
+
+#include <cstdint>
+#include <entt/entity/registry.hpp>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ky {
+
+// Entity created through a `CommandBuffer`, it only becomes a real entity once the buffer is
+// applied. Components can be added to it in the same buffer.
+struct DeferredEntity {
+    uint32_t index = 0;
+};
+
+// Records structural changes to a registry, creating and destroying entities and adding or
+// removing components, so they can be made from systems running in parallel and applied later
+// at a sync point. Commands are applied in the order they were recorded, those targeting entities
+// destroyed in the meantime are skipped.
+//
+// Component values are kept in an arena that's reset on apply, so once the buffer has warmed up
+// recording a command is a couple of pointer bumps.
+class CommandBuffer {
+public:
+    CommandBuffer() = default;
+    ~CommandBuffer();
+
+    CommandBuffer(CommandBuffer&&) = default;
+    CommandBuffer& operator=(CommandBuffer&&) = default;
+
+    DeferredEntity create();
+    void destroy(entt::entity entity);
+
+    template <typename _Type, typename... _Args>
+    void emplace(entt::entity entity, _Args&&... args);
+    template <typename _Type, typename... _Args>
+    void emplace(DeferredEntity entity, _Args&&... args);
+    template <typename _Type>
+    void remove(entt::entity entity);
+
+    // Applies the recorded commands to `registry` and clears the buffer.
+    void apply(entt::registry& registry);
+
+    inline bool empty() const { return _commands.empty(); }
+    inline size_t size() const { return _commands.size(); }
+
+private:
+    static constexpr uint32_t _NOT_DEFERRED = UINT32_MAX;
+
+    using _CommandFunction = void (*)(entt::registry& registry, entt::entity entity,
+                                      void* payload);
+    using _DestroyFunction = void (*)(void* payload);
+
+    // Targets either `entity` or, when `deferred` is set, the entity created by the create
+    // command with that index. Create commands have no function. `payload` points into
+    // `_payloads` and is destroyed with `destroy` if it isn't trivially destructible.
+    struct _Record {
+        entt::entity entity;
+        uint32_t deferred;
+        _CommandFunction function;
+        void* payload;
+        _DestroyFunction destroy;
+    };
+
+    TaggedVector<_Record, MEMORY_TAG_ECS> _commands;
+    TaggedVector<entt::entity, MEMORY_TAG_ECS> _created;
+    uint32_t _created_count = 0;
+    LinearArena _payloads {16 * 1024, MEMORY_TAG_ECS};
+
+    void _clear();
+
+    template <typename _Type, typename... _Args>
+    void _emplace(entt::entity entity, uint32_t deferred, _Args&&... args);
+};
+
+template <typename _Type, typename... _Args>
+void CommandBuffer::emplace(entt::entity entity, _Args&&... args) {
+    _emplace<_Type>(entity, _NOT_DEFERRED, std::forward<_Args>(args)...);
+}
+
+template <typename _Type, typename... _Args>
+void CommandBuffer::emplace(DeferredEntity entity, _Args&&... args) {
+    _emplace<_Type>(entt::entity(entt::null), entity.index, std::forward<_Args>(args)...);
+}
+
+template <typename _Type>
+void CommandBuffer::remove(entt::entity entity) {
+    _commands.push_back(_Record {
+        entity,
+        _NOT_DEFERRED,
+        [](entt::registry& registry, entt::entity entity, void*) {
+            registry.remove<_Type>(entity);
+        },
+        nullptr,
+        nullptr,
+    });
+}
+
+template <typename _Type, typename... _Args>
+void CommandBuffer::_emplace(entt::entity entity, uint32_t deferred, _Args&&... args) {
+    if constexpr (std::is_empty_v<_Type>) {
+        _commands.push_back(_Record {
+            entity,
+            deferred,
+            [](entt::registry& registry, entt::entity entity, void*) {
+                registry.emplace_or_replace<_Type>(entity);
+            },
+            nullptr,
+            nullptr,
+        });
+    } else {
+        _DestroyFunction destroy = nullptr;
+        if constexpr (!std::is_trivially_destructible_v<_Type>) {
+            destroy = [](void* payload) { ((_Type*)payload)->~_Type(); };
+        }
+        _commands.push_back(_Record {
+            entity,
+            deferred,
+            [](entt::registry& registry, entt::entity entity, void* payload) {
+                registry.emplace_or_replace<_Type>(entity, std::move(*(_Type*)payload));
+            },
+            _payloads.create<_Type>(_Type {std::forward<_Args>(args)...}),
+            destroy,
+        });
+    }
+}
+
+} // namespace ky
+
+#endif
@@ -0,0 +1,508 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "scene/culling.h"
+
+#include "core/error.h"
+#include "core/jobs.h"
+#include "core/profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/matrix.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#    define KY_CULLING_X86 1
+#    include <immintrin.h>
+#    ifdef _MSC_VER
+#        include <intrin.h>
+#    endif
+#else
+#    define KY_CULLING_X86 0
+#endif
+
+// GCC and Clang only emit AVX2 instructions in functions targeting it, MSVC emits any intrinsic
+#if KY_CULLING_X86 && (defined(__GNUC__) || defined(__clang__))
+#    define KY_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#    define KY_TARGET_AVX2
+#endif
+
+namespace ky {
+
+// Entries past the end of each chunk's output, SIMD kernels store whole vectors of indices and
+// only advance by the lanes that were visible
+static constexpr size_t CULLING_OUTPUT_SLACK = 8;
+
+struct CullingBounds {
+    const float* center[3];
+    // Sphere radius in the first entry, or the box half extents
+    const float* size[3];
+};
+
+// Culling view broadcast friendly, LOD comparisons are done on squared sizes to avoid the square
+// root of the distance
+struct CullingKernelView {
+    float plane_x[Frustum::PLANE_COUNT];
+    float plane_y[Frustum::PLANE_COUNT];
+    float plane_z[Frustum::PLANE_COUNT];
+    float plane_w[Frustum::PLANE_COUNT];
+    float position[3];
+    float size_scale;
+    float lod_thresholds[KY_CULLING_MAX_LODS - 1];
+    uint32_t lod_threshold_count;
+};
+
+using CullingKernel = size_t (*)(const CullingBounds& bounds, const CullingKernelView& view,
+                                 size_t begin, size_t end, uint32_t* visible, uint8_t* lods);
+
+static CullingKernelView make_kernel_view(const CullingView& view) {
+    CullingKernelView result;
+    for (int i = 0; i < Frustum::PLANE_COUNT; i++) {
+        result.plane_x[i] = view.frustum.planes[i].x;
+        result.plane_y[i] = view.frustum.planes[i].y;
+        result.plane_z[i] = view.frustum.planes[i].z;
+        result.plane_w[i] = view.frustum.planes[i].w;
+    }
+    result.position[0] = view.position.x;
+    result.position[1] = view.position.y;
+    result.position[2] = view.position.z;
+    result.size_scale = view.projection_scale * view.projection_scale;
+    result.lod_threshold_count = std::min(view.lod_threshold_count, KY_CULLING_MAX_LODS - 1u);
+    for (uint32_t i = 0; i < result.lod_threshold_count; i++) {
+        result.lod_thresholds[i] = view.lod_thresholds[i] * view.lod_thresholds[i];
+    }
+    return result;
+}
+
+// The SIMD kernels evaluate the same expressions in the same order, so all paths produce
+// identical results
+template <bool _Boxes>
+static size_t cull_scalar(const CullingBounds& bounds, const CullingKernelView& view, size_t begin,
+                          size_t end, uint32_t* visible, uint8_t* lods) {
+    size_t count = 0;
+    for (size_t i = begin; i < end; i++) {
+        float x = bounds.center[0][i];
+        float y = bounds.center[1][i];
+        float z = bounds.center[2][i];
+        float radius_squared;
+        bool inside = true;
+        if constexpr (_Boxes) {
+            float extent_x = bounds.size[0][i];
+            float extent_y = bounds.size[1][i];
+            float extent_z = bounds.size[2][i];
+            for (int p = 0; p < Frustum::PLANE_COUNT && inside; p++) {
+                float distance = view.plane_x[p] * x + view.plane_y[p] * y +
+                                 view.plane_z[p] * z + view.plane_w[p];
+                float extent = std::abs(view.plane_x[p]) * extent_x +
+                               std::abs(view.plane_y[p]) * extent_y +
+                               std::abs(view.plane_z[p]) * extent_z;
+                inside = distance + extent >= 0.0f;
+            }
+            radius_squared = extent_x * extent_x + extent_y * extent_y + extent_z * extent_z;
+        } else {
+            float radius = bounds.size[0][i];
+            for (int p = 0; p < Frustum::PLANE_COUNT && inside; p++) {
+                float distance = view.plane_x[p] * x + view.plane_y[p] * y +
+                                 view.plane_z[p] * z + view.plane_w[p];
+                inside = distance + radius >= 0.0f;
+            }
+            radius_squared = radius * radius;
+        }
+        if (!inside) {
+            continue;
+        }
+
+        float dx = x - view.position[0];
+        float dy = y - view.position[1];
+        float dz = z - view.position[2];
+        float distance_squared = dx * dx + dy * dy + dz * dz;
+        float size = radius_squared * view.size_scale;
+        uint8_t lod = 0;
+        for (uint32_t t = 0; t < view.lod_threshold_count; t++) {
+            lod += size < view.lod_thresholds[t] * distance_squared;
+        }
+        visible[count] = (uint32_t)i;
+        lods[count] = lod;
+        count++;
+    }
+    return count;
+}
+
+#if KY_CULLING_X86
+
+template <bool _Boxes>
+static size_t cull_sse2(const CullingBounds& bounds, const CullingKernelView& view, size_t begin,
+                        size_t end, uint32_t* visible, uint8_t* lods) {
+    __m128 plane_x[Frustum::PLANE_COUNT];
+    __m128 plane_y[Frustum::PLANE_COUNT];
+    __m128 plane_z[Frustum::PLANE_COUNT];
+    __m128 plane_w[Frustum::PLANE_COUNT];
+    for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+        plane_x[p] = _mm_set1_ps(view.plane_x[p]);
+        plane_y[p] = _mm_set1_ps(view.plane_y[p]);
+        plane_z[p] = _mm_set1_ps(view.plane_z[p]);
+        plane_w[p] = _mm_set1_ps(view.plane_w[p]);
+    }
+    __m128 position_x = _mm_set1_ps(view.position[0]);
+    __m128 position_y = _mm_set1_ps(view.position[1]);
+    __m128 position_z = _mm_set1_ps(view.position[2]);
+    __m128 size_scale = _mm_set1_ps(view.size_scale);
+    __m128 zero = _mm_setzero_ps();
+    __m128 sign_mask = _mm_set1_ps(-0.0f);
+    alignas(16) int32_t lane_lods[4];
+
+    size_t count = 0;
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 x = _mm_loadu_ps(bounds.center[0] + i);
+        __m128 y = _mm_loadu_ps(bounds.center[1] + i);
+        __m128 z = _mm_loadu_ps(bounds.center[2] + i);
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+        __m128 radius_squared;
+        if constexpr (_Boxes) {
+            __m128 extent_x = _mm_loadu_ps(bounds.size[0] + i);
+            __m128 extent_y = _mm_loadu_ps(bounds.size[1] + i);
+            __m128 extent_z = _mm_loadu_ps(bounds.size[2] + i);
+            for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+                __m128 distance = _mm_mul_ps(plane_x[p], x);
+                distance = _mm_add_ps(distance, _mm_mul_ps(plane_y[p], y));
+                distance = _mm_add_ps(distance, _mm_mul_ps(plane_z[p], z));
+                distance = _mm_add_ps(distance, plane_w[p]);
+                __m128 extent = _mm_add_ps(
+                        _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, plane_x[p]), extent_x),
+                                   _mm_mul_ps(_mm_andnot_ps(sign_mask, plane_y[p]), extent_y)),
+                        _mm_mul_ps(_mm_andnot_ps(sign_mask, plane_z[p]), extent_z));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, extent), zero));
+            }
+            radius_squared = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(extent_x, extent_x), _mm_mul_ps(extent_y, extent_y)),
+                    _mm_mul_ps(extent_z, extent_z));
+        } else {
+            __m128 radius = _mm_loadu_ps(bounds.size[0] + i);
+            for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+                __m128 distance = _mm_mul_ps(plane_x[p], x);
+                distance = _mm_add_ps(distance, _mm_mul_ps(plane_y[p], y));
+                distance = _mm_add_ps(distance, _mm_mul_ps(plane_z[p], z));
+                distance = _mm_add_ps(distance, plane_w[p]);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+            }
+            radius_squared = _mm_mul_ps(radius, radius);
+        }
+        int mask = _mm_movemask_ps(inside);
+        if (mask == 0) {
+            continue;
+        }
+
+        __m128 dx = _mm_sub_ps(x, position_x);
+        __m128 dy = _mm_sub_ps(y, position_y);
+        __m128 dz = _mm_sub_ps(z, position_z);
+        __m128 distance_squared = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        __m128 size = _mm_mul_ps(radius_squared, size_scale);
+        // Comparisons are all ones when true, subtracting them counts the thresholds passed
+        __m128i lod = _mm_setzero_si128();
+        for (uint32_t t = 0; t < view.lod_threshold_count; t++) {
+            __m128 threshold = _mm_mul_ps(_mm_set1_ps(view.lod_thresholds[t]), distance_squared);
+            lod = _mm_sub_epi32(lod, _mm_castps_si128(_mm_cmplt_ps(size, threshold)));
+        }
+        _mm_store_si128((__m128i*)lane_lods, lod);
+        for (int lane = 0; lane < 4; lane++) {
+            if (mask & (1 << lane)) {
+                visible[count] = (uint32_t)(i + lane);
+                lods[count] = (uint8_t)lane_lods[lane];
+                count++;
+            }
+        }
+    }
+    return count + cull_scalar<_Boxes>(bounds, view, i, end, visible + count, lods + count);
+}
+
+// Lane indices of the set bits of every 8 bit mask packed to the front, and their count
+struct CullingCompactionTable {
+    int32_t lanes[256][8];
+    uint8_t counts[256];
+
+    constexpr CullingCompactionTable() : lanes(), counts() {
+        for (int mask = 0; mask < 256; mask++) {
+            int count = 0;
+            for (int lane = 0; lane < 8; lane++) {
+                if (mask & (1 << lane)) {
+                    lanes[mask][count++] = lane;
+                }
+            }
+            counts[mask] = (uint8_t)count;
+        }
+    }
+};
+
+static constexpr CullingCompactionTable culling_compaction_table;
+
+template <bool _Boxes>
+KY_TARGET_AVX2 static size_t cull_avx2(const CullingBounds& bounds,
+                                       const CullingKernelView& view, size_t begin, size_t end,
+                                       uint32_t* visible, uint8_t* lods) {
+    __m256 plane_x[Frustum::PLANE_COUNT];
+    __m256 plane_y[Frustum::PLANE_COUNT];
+    __m256 plane_z[Frustum::PLANE_COUNT];
+    __m256 plane_w[Frustum::PLANE_COUNT];
+    for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+        plane_x[p] = _mm256_set1_ps(view.plane_x[p]);
+        plane_y[p] = _mm256_set1_ps(view.plane_y[p]);
+        plane_z[p] = _mm256_set1_ps(view.plane_z[p]);
+        plane_w[p] = _mm256_set1_ps(view.plane_w[p]);
+    }
+    __m256 position_x = _mm256_set1_ps(view.position[0]);
+    __m256 position_y = _mm256_set1_ps(view.position[1]);
+    __m256 position_z = _mm256_set1_ps(view.position[2]);
+    __m256 size_scale = _mm256_set1_ps(view.size_scale);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    __m256i lane_offsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    size_t count = 0;
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 x = _mm256_loadu_ps(bounds.center[0] + i);
+        __m256 y = _mm256_loadu_ps(bounds.center[1] + i);
+        __m256 z = _mm256_loadu_ps(bounds.center[2] + i);
+        __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+        __m256 radius_squared;
+        if constexpr (_Boxes) {
+            __m256 extent_x = _mm256_loadu_ps(bounds.size[0] + i);
+            __m256 extent_y = _mm256_loadu_ps(bounds.size[1] + i);
+            __m256 extent_z = _mm256_loadu_ps(bounds.size[2] + i);
+            for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+                __m256 distance = _mm256_mul_ps(plane_x[p], x);
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(plane_y[p], y));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(plane_z[p], z));
+                distance = _mm256_add_ps(distance, plane_w[p]);
+                __m256 extent = _mm256_add_ps(
+                        _mm256_add_ps(
+                                _mm256_mul_ps(_mm256_andnot_ps(sign_mask, plane_x[p]), extent_x),
+                                _mm256_mul_ps(_mm256_andnot_ps(sign_mask, plane_y[p]), extent_y)),
+                        _mm256_mul_ps(_mm256_andnot_ps(sign_mask, plane_z[p]), extent_z));
+                inside = _mm256_and_ps(
+                        inside, _mm256_cmp_ps(_mm256_add_ps(distance, extent), zero, _CMP_GE_OQ));
+            }
+            radius_squared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(extent_x, extent_x),
+                                                         _mm256_mul_ps(extent_y, extent_y)),
+                                           _mm256_mul_ps(extent_z, extent_z));
+        } else {
+            __m256 radius = _mm256_loadu_ps(bounds.size[0] + i);
+            for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+                __m256 distance = _mm256_mul_ps(plane_x[p], x);
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(plane_y[p], y));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(plane_z[p], z));
+                distance = _mm256_add_ps(distance, plane_w[p]);
+                inside = _mm256_and_ps(
+                        inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+            }
+            radius_squared = _mm256_mul_ps(radius, radius);
+        }
+        int mask = _mm256_movemask_ps(inside);
+        if (mask == 0) {
+            continue;
+        }
+
+        __m256 dx = _mm256_sub_ps(x, position_x);
+        __m256 dy = _mm256_sub_ps(y, position_y);
+        __m256 dz = _mm256_sub_ps(z, position_z);
+        __m256 distance_squared = _mm256_mul_ps(dx, dx);
+        distance_squared = _mm256_add_ps(distance_squared, _mm256_mul_ps(dy, dy));
+        distance_squared = _mm256_add_ps(distance_squared, _mm256_mul_ps(dz, dz));
+        __m256 size = _mm256_mul_ps(radius_squared, size_scale);
+        __m256i lod = _mm256_setzero_si256();
+        for (uint32_t t = 0; t < view.lod_threshold_count; t++) {
+            __m256 threshold =
+                    _mm256_mul_ps(_mm256_set1_ps(view.lod_thresholds[t]), distance_squared);
+            lod = _mm256_sub_epi32(
+                    lod, _mm256_castps_si256(_mm256_cmp_ps(size, threshold, _CMP_LT_OQ)));
+        }
+
+        // Packs the visible lanes to the front and stores all 8, the next store overwrites the
+        // lanes past the visible ones
+        __m256i lanes = _mm256_loadu_si256((const __m256i*)culling_compaction_table.lanes[mask]);
+        __m256i indices = _mm256_add_epi32(_mm256_set1_epi32((int32_t)i), lane_offsets);
+        _mm256_storeu_si256((__m256i*)(visible + count),
+                            _mm256_permutevar8x32_epi32(indices, lanes));
+        lod = _mm256_permutevar8x32_epi32(lod, lanes);
+        __m128i lod_words = _mm_packus_epi32(_mm256_castsi256_si128(lod),
+                                             _mm256_extracti128_si256(lod, 1));
+        _mm_storel_epi64((__m128i*)(lods + count), _mm_packus_epi16(lod_words, lod_words));
+        count += culling_compaction_table.counts[mask];
+    }
+    return count + cull_scalar<_Boxes>(bounds, view, i, end, visible + count, lods + count);
+}
+
+static CullingPath detect_culling_path() {
+#    ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuid(info, 1);
+        bool avx = (info[2] & (1 << 28)) != 0;
+        // The OS has to save the YMM registers on context switches as well
+        bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+        __cpuidex(info, 7, 0);
+        if (avx && os_saves_ymm && (info[1] & (1 << 5)) != 0) {
+            return CULLING_PATH_AVX2;
+        }
+    }
+#    else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return CULLING_PATH_AVX2;
+    }
+#    endif
+    // Part of the x86-64 baseline
+    return CULLING_PATH_SSE2;
+}
+
+static constexpr CullingKernel culling_kernels[CULLING_PATH_COUNT][2] = {
+    {cull_scalar<false>, cull_scalar<true>},
+    {cull_sse2<false>, cull_sse2<true>},
+    {cull_avx2<false>, cull_avx2<true>},
+};
+
+#else
+
+static CullingPath detect_culling_path() {
+    return CULLING_PATH_SCALAR;
+}
+
+static constexpr CullingKernel culling_kernels[CULLING_PATH_COUNT][2] = {
+    {cull_scalar<false>, cull_scalar<true>},
+    {cull_scalar<false>, cull_scalar<true>},
+    {cull_scalar<false>, cull_scalar<true>},
+};
+
+#endif
+
+// Runs the kernel over chunks of the objects in parallel, each chunk writing its visible list
+// to its own part of the output, then moves the parts together. Returns the visible count.
+static size_t cull_chunks(CullingKernel kernel, const CullingBounds& bounds, size_t count,
+                          const CullingView& view,
+                          TaggedVector<uint32_t, MEMORY_TAG_RENDER>& visible,
+                          TaggedVector<uint8_t, MEMORY_TAG_RENDER>& lods,
+                          TaggedVector<size_t, MEMORY_TAG_RENDER>& chunk_sizes) {
+    CullingKernelView kernel_view = make_kernel_view(view);
+    size_t chunk_count = 1;
+    if (JobSystem::worker_count() > 0) {
+        chunk_count = std::max((count + KY_CULLING_CHUNK_SIZE - 1) / KY_CULLING_CHUNK_SIZE,
+                               (size_t)1);
+    }
+    size_t capacity = count + chunk_count * CULLING_OUTPUT_SLACK;
+    if (visible.size() < capacity) {
+        visible.resize(capacity);
+        lods.resize(capacity);
+    }
+    if (chunk_count == 1) {
+        return kernel(bounds, kernel_view, 0, count, visible.data(), lods.data());
+    }
+
+    if (chunk_sizes.size() < chunk_count) {
+        chunk_sizes.resize(chunk_count);
+    }
+    JobSystem::parallel_for(chunk_count, [&](size_t chunk) {
+        size_t begin = chunk * KY_CULLING_CHUNK_SIZE;
+        size_t end = std::min(begin + KY_CULLING_CHUNK_SIZE, count);
+        size_t output = begin + chunk * CULLING_OUTPUT_SLACK;
+        chunk_sizes[chunk] = kernel(bounds, kernel_view, begin, end, visible.data() + output,
+                                    lods.data() + output);
+    });
+    size_t size = chunk_sizes[0];
+    for (size_t chunk = 1; chunk < chunk_count; chunk++) {
+        size_t output = chunk * (KY_CULLING_CHUNK_SIZE + CULLING_OUTPUT_SLACK);
+        std::memmove(visible.data() + size, visible.data() + output,
+                     chunk_sizes[chunk] * sizeof(uint32_t));
+        std::memmove(lods.data() + size, lods.data() + output, chunk_sizes[chunk]);
+        size += chunk_sizes[chunk];
+    }
+    return size;
+}
+
+CullingView CullingView::from_camera(const glm::mat4& view, const glm::mat4& projection,
+                                     const float* lod_thresholds, uint32_t lod_threshold_count) {
+    CullingView result;
+    result.frustum = Frustum::from_matrix(projection * view);
+    result.position = glm::vec3(glm::inverse(view)[3]);
+    result.projection_scale = projection[1][1];
+    if (lod_threshold_count > KY_CULLING_MAX_LODS - 1) {
+        KY_WARNING_MSG("%u LOD thresholds given, only %u are used", lod_threshold_count,
+                       KY_CULLING_MAX_LODS - 1);
+        lod_threshold_count = KY_CULLING_MAX_LODS - 1;
+    }
+    for (uint32_t i = 0; i < lod_threshold_count; i++) {
+        result.lod_thresholds[i] = lod_thresholds[i];
+    }
+    result.lod_threshold_count = lod_threshold_count;
+    return result;
+}
+
+CullingPath FrustumCuller::supported_path() {
+    static const CullingPath path = detect_culling_path();
+    return path;
+}
+
+const char* FrustumCuller::path_name(CullingPath path) {
+    switch (path) {
+        case CULLING_PATH_SCALAR:
+            return "scalar";
+        case CULLING_PATH_SSE2:
+            return "sse2";
+        case CULLING_PATH_AVX2:
+            return "avx2";
+        default:
+            return "unknown";
+    }
+}
+
+FrustumCuller::FrustumCuller(CullingPath path) : _path(path) {
+    if (_path >= CULLING_PATH_COUNT || _path > supported_path()) {
+        KY_WARNING_MSG("Culling path %s isn't supported by this CPU, using %s instead",
+                       path_name(path), path_name(supported_path()));
+        _path = supported_path();
+    }
+}
+
+void FrustumCuller::cull(const SphereBoundsSoA& spheres, const CullingView& view,
+                         CullingResult& result) const {
+    KY_PROFILE_SCOPE("FrustumCuller::cull");
+    result._size = 0;
+    KY_ERROR_CONDITION_MSG(spheres.count <= UINT32_MAX, "Culled indices are 32 bit");
+    CullingBounds bounds = {
+        {spheres.center_x, spheres.center_y, spheres.center_z},
+        {spheres.radius, nullptr, nullptr},
+    };
+    result._size = cull_chunks(culling_kernels[_path][0], bounds, spheres.count, view,
+                               result._visible, result._lods, result._chunk_sizes);
+}
+
+void FrustumCuller::cull(const BoxBoundsSoA& boxes, const CullingView& view,
+                         CullingResult& result) const {
+    KY_PROFILE_SCOPE("FrustumCuller::cull");
+    result._size = 0;
+    KY_ERROR_CONDITION_MSG(boxes.count <= UINT32_MAX, "Culled indices are 32 bit");
+    CullingBounds bounds = {
+        {boxes.center_x, boxes.center_y, boxes.center_z},
+        {boxes.extent_x, boxes.extent_y, boxes.extent_z},
+    };
+    result._size = cull_chunks(culling_kernels[_path][1], bounds, boxes.count, view,
+                               result._visible, result._lods, result._chunk_sizes);
+}
+
+} // namespace ky
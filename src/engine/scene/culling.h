@@ -0,0 +1,124 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_SCENE__CULLING_H
+#define KRYOS_SCENE__CULLING_H
+
+#include "core/memory_tracker.h"
+#include "scene/bounds.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+
+// Maximum number of LOD levels a view can select between.
+#ifndef KY_CULLING_MAX_LODS
+#    define KY_CULLING_MAX_LODS 8
+#endif
+
+// Objects culled by one job when the work is spread over the job system.
+#ifndef KY_CULLING_CHUNK_SIZE
+#    define KY_CULLING_CHUNK_SIZE 16384
+#endif
+
+namespace ky {
+
+enum CullingPath {
+    CULLING_PATH_SCALAR,
+    CULLING_PATH_SSE2,
+    CULLING_PATH_AVX2,
+    CULLING_PATH_COUNT,
+};
+
+// Bounding spheres stored as separate arrays, result indices refer to positions in them.
+struct SphereBoundsSoA {
+    const float* center_x = nullptr;
+    const float* center_y = nullptr;
+    const float* center_z = nullptr;
+    const float* radius = nullptr;
+    size_t count = 0;
+};
+
+// Axis aligned boxes stored as separate center and half extent arrays.
+struct BoxBoundsSoA {
+    const float* center_x = nullptr;
+    const float* center_y = nullptr;
+    const float* center_z = nullptr;
+    const float* extent_x = nullptr;
+    const float* extent_y = nullptr;
+    const float* extent_z = nullptr;
+    size_t count = 0;
+};
+
+// Camera state the culler tests against. The LOD of a visible object is the number of
+// thresholds its projected size falls below, where the projected size is the bounding radius
+// over its distance as a fraction of the viewport height.
+struct CullingView {
+    Frustum frustum;
+    glm::vec3 position = glm::vec3(0.0f);
+    // `projection[1][1]` of a perspective projection, scales radius over distance to the
+    // fraction of the viewport height it covers.
+    float projection_scale = 1.0f;
+    // Descending projected sizes each LOD hands over to the next one at.
+    float lod_thresholds[KY_CULLING_MAX_LODS - 1] = {};
+    uint32_t lod_threshold_count = 0;
+
+    static CullingView from_camera(const glm::mat4& view, const glm::mat4& projection,
+                                   const float* lod_thresholds = nullptr,
+                                   uint32_t lod_threshold_count = 0);
+};
+
+// Compacted output of a cull, the indices of visible objects in ascending order and the LOD
+// selected for each of them. Buffers are kept between culls so reusing a result doesn't
+// allocate once it has grown to the object count.
+class CullingResult {
+public:
+    inline const uint32_t* visible() const { return _visible.data(); }
+    inline const uint8_t* lods() const { return _lods.data(); }
+    inline size_t size() const { return _size; }
+
+private:
+    friend class FrustumCuller;
+
+    TaggedVector<uint32_t, MEMORY_TAG_RENDER> _visible;
+    TaggedVector<uint8_t, MEMORY_TAG_RENDER> _lods;
+    TaggedVector<size_t, MEMORY_TAG_RENDER> _chunk_sizes;
+    size_t _size = 0;
+};
+
+// Tests batches of bounds against the six frustum planes 4 (SSE2) or 8 (AVX2) objects at a time
+// and selects a LOD for the survivors in the same pass. The widest path the CPU supports is
+// detected at runtime, counts above `KY_CULLING_CHUNK_SIZE` are split over the job system.
+class FrustumCuller {
+public:
+    static CullingPath supported_path();
+    static const char* path_name(CullingPath path);
+
+    // Paths the CPU doesn't support fall back to the widest one it does.
+    explicit FrustumCuller(CullingPath path = supported_path());
+
+    void cull(const SphereBoundsSoA& spheres, const CullingView& view,
+              CullingResult& result) const;
+    void cull(const BoxBoundsSoA& boxes, const CullingView& view, CullingResult& result) const;
+
+    inline CullingPath path() const { return _path; }
+
+private:
+    CullingPath _path;
+};
+
+} // namespace ky
+
+#endif
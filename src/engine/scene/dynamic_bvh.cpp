@@ -0,0 +1,458 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "scene/dynamic_bvh.h"
+
+#include "core/profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ky {
+
+// Splits evaluated per axis by the binned SAH build
+static constexpr uint32_t BVH_BIN_COUNT = 16;
+
+// Build depth after which nodes are split at the median, bounding the tree height for
+// pathological distributions where SAH keeps splitting off single leaves
+static constexpr uint32_t BVH_SAH_MAX_DEPTH = 48;
+
+DynamicBvh::DynamicBvh(entt::registry& registry, float fat_margin)
+    : _registry(&registry), _fat_margin(fat_margin) {
+    _registry->on_destroy<entt::entity>().connect<&DynamicBvh::_on_destroy>(*this);
+}
+
+DynamicBvh::~DynamicBvh() {
+    _registry->on_destroy<entt::entity>().disconnect<&DynamicBvh::_on_destroy>(*this);
+}
+
+void DynamicBvh::insert(entt::entity entity, const Aabb& bounds) {
+    KY_ERROR_CONDITION_MSG(entity != entt::null, "Entity is null");
+    KY_ERROR_CONDITION_MSG(!contains(entity), "Entity is already in the BVH");
+    // Leaves and their parents add up to fewer than twice the peak entity count, which keeps
+    // `_allocate_node` below its limit
+    KY_ERROR_CONDITION_MSG(_size < _INSIDE_BIT / 2, "BVH is full");
+
+    uint32_t index = entt::to_entity(entity);
+    if (index >= _leaves.size()) {
+        _leaves.resize(index + 1, _INVALID_NODE);
+    }
+    uint32_t leaf = _allocate_node();
+    _Node& node = _nodes[leaf];
+    node.bounds = bounds.expanded(_fat_margin);
+    node.entity_bounds = bounds;
+    node.entity = entity;
+    _leaves[index] = leaf;
+    _insert_leaf(leaf);
+    _size++;
+}
+
+void DynamicBvh::remove(entt::entity entity) {
+    uint32_t leaf = _leaf(entity);
+    KY_ERROR_CONDITION_MSG(leaf != _INVALID_NODE, "Entity is not in the BVH");
+    _remove_leaf(leaf);
+    _free_node(leaf);
+    _leaves[entt::to_entity(entity)] = _INVALID_NODE;
+    _size--;
+}
+
+bool DynamicBvh::update(entt::entity entity, const Aabb& bounds) {
+    uint32_t leaf = _leaf(entity);
+    KY_ERROR_CONDITION_MSG_RETURN(leaf != _INVALID_NODE, false, "Entity is not in the BVH");
+    _Node& node = _nodes[leaf];
+    node.entity_bounds = bounds;
+    if (node.bounds.contains(bounds)) {
+        return false;
+    }
+
+    _remove_leaf(leaf);
+    _nodes[leaf].bounds = bounds.expanded(_fat_margin);
+    _insert_leaf(leaf);
+    return true;
+}
+
+bool DynamicBvh::contains(entt::entity entity) const {
+    return _leaf(entity) != _INVALID_NODE;
+}
+
+const Aabb& DynamicBvh::bounds(entt::entity entity) const {
+    static const Aabb empty;
+    uint32_t leaf = _leaf(entity);
+    KY_ERROR_CONDITION_MSG_RETURN(leaf != _INVALID_NODE, empty, "Entity is not in the BVH");
+    return _nodes[leaf].entity_bounds;
+}
+
+void DynamicBvh::rebuild() {
+    KY_PROFILE_SCOPE("DynamicBvh::rebuild");
+    if (_size < 2) {
+        return;
+    }
+
+    // Keep the leaves where they are so `_leaves` stays valid, everything else is rebuilt
+    TaggedVector<uint32_t, MEMORY_TAG_ECS> leaves;
+    leaves.reserve(_size);
+    _free_list = _INVALID_NODE;
+    for (uint32_t i = 0; i < (uint32_t)_nodes.size(); i++) {
+        if (_nodes[i].leaf() && _nodes[i].entity != entt::null) {
+            leaves.push_back(i);
+        } else {
+            _free_node(i);
+        }
+    }
+    _root = _build(leaves.data(), (uint32_t)leaves.size(), 0);
+    _nodes[_root].parent = _INVALID_NODE;
+}
+
+void DynamicBvh::clear() {
+    _nodes.clear();
+    _leaves.clear();
+    _root = _INVALID_NODE;
+    _free_list = _INVALID_NODE;
+    _size = 0;
+}
+
+entt::entity DynamicBvh::nearest(const glm::vec3& point, float max_distance,
+                                 float* distance) const {
+    if (_root == _INVALID_NODE) {
+        return entt::null;
+    }
+
+    struct Entry {
+        uint32_t node;
+        float distance_squared;
+    };
+    Entry stack[KY_BVH_STACK_SIZE];
+    uint32_t stack_size = 0;
+    float best_squared = max_distance < std::sqrt(FLT_MAX) ? max_distance * max_distance : FLT_MAX;
+    entt::entity best = entt::null;
+    stack[stack_size++] = Entry {_root, _nodes[_root].bounds.distance_squared(point)};
+    while (stack_size > 0) {
+        Entry entry = stack[--stack_size];
+        if (entry.distance_squared > best_squared) {
+            continue;
+        }
+        const _Node& node = _nodes[entry.node];
+        if (node.leaf()) {
+            float distance_squared = node.entity_bounds.distance_squared(point);
+            if (distance_squared <= best_squared) {
+                best_squared = distance_squared;
+                best = node.entity;
+            }
+            continue;
+        }
+
+        // Closer child on top so it can tighten the bound before the other one is looked at
+        Entry children[2];
+        for (uint32_t i = 0; i < 2; i++) {
+            children[i] = Entry {
+                node.children[i],
+                _nodes[node.children[i]].bounds.distance_squared(point),
+            };
+        }
+        if (children[0].distance_squared < children[1].distance_squared) {
+            std::swap(children[0], children[1]);
+        }
+        KY_ERROR_CONDITION_MSG_RETURN(stack_size + 2 <= KY_BVH_STACK_SIZE, best,
+                                      "BVH stack overflow");
+        stack[stack_size++] = children[0];
+        stack[stack_size++] = children[1];
+    }
+
+    if (distance != nullptr && best != entt::null) {
+        *distance = std::sqrt(best_squared);
+    }
+    return best;
+}
+
+float DynamicBvh::area_ratio() const {
+    if (_root == _INVALID_NODE) {
+        return 0.0f;
+    }
+    float area = 0.0f;
+    for (const _Node& node : _nodes) {
+        if (!node.leaf()) {
+            area += node.bounds.surface_area();
+        }
+    }
+    float root_area = _nodes[_root].bounds.surface_area();
+    return root_area > 0.0f ? area / root_area : 0.0f;
+}
+
+uint32_t DynamicBvh::_leaf(entt::entity entity) const {
+    if (entity == entt::null) {
+        return _INVALID_NODE;
+    }
+    uint32_t index = entt::to_entity(entity);
+    if (index >= _leaves.size() || _leaves[index] == _INVALID_NODE ||
+        _nodes[_leaves[index]].entity != entity) {
+        return _INVALID_NODE;
+    }
+    return _leaves[index];
+}
+
+uint32_t DynamicBvh::_allocate_node() {
+    if (_free_list == _INVALID_NODE) {
+        // Frustum queries tag node indices with `_INSIDE_BIT`
+        KY_ERROR_CONDITION_MSG_RETURN(_nodes.size() < _INSIDE_BIT, _INVALID_NODE,
+                                      "BVH node indices exhausted");
+        _nodes.emplace_back();
+        return (uint32_t)_nodes.size() - 1;
+    }
+    uint32_t node = _free_list;
+    _free_list = _nodes[node].parent;
+    _nodes[node] = _Node();
+    return node;
+}
+
+void DynamicBvh::_free_node(uint32_t node) {
+    _nodes[node] = _Node();
+    _nodes[node].parent = _free_list;
+    _free_list = node;
+}
+
+void DynamicBvh::_insert_leaf(uint32_t leaf) {
+    if (_root == _INVALID_NODE) {
+        _root = leaf;
+        _nodes[leaf].parent = _INVALID_NODE;
+        return;
+    }
+
+    // Walk down to the sibling that grows the tree's surface area the least. Every node on the
+    // way grows to include the leaf, which is the inherited cost of going further down.
+    Aabb bounds = _nodes[leaf].bounds;
+    uint32_t index = _root;
+    while (!_nodes[index].leaf()) {
+        const _Node& node = _nodes[index];
+        float area = node.bounds.surface_area();
+        float combined_area = Aabb::merge(node.bounds, bounds).surface_area();
+        float cost = 2.0f * combined_area;
+        float inherited_cost = 2.0f * (combined_area - area);
+
+        float child_costs[2];
+        for (uint32_t i = 0; i < 2; i++) {
+            const _Node& child = _nodes[node.children[i]];
+            // A leaf becomes a new node, an internal node only grows
+            float cost = Aabb::merge(child.bounds, bounds).surface_area();
+            if (!child.leaf()) {
+                cost -= child.bounds.surface_area();
+            }
+            child_costs[i] = inherited_cost + cost;
+        }
+        if (cost < child_costs[0] && cost < child_costs[1]) {
+            break;
+        }
+        index = child_costs[0] < child_costs[1] ? node.children[0] : node.children[1];
+    }
+
+    uint32_t sibling = index;
+    uint32_t old_parent = _nodes[sibling].parent;
+    uint32_t new_parent = _allocate_node();
+    _Node& parent = _nodes[new_parent];
+    parent.parent = old_parent;
+    parent.bounds = Aabb::merge(bounds, _nodes[sibling].bounds);
+    parent.height = _nodes[sibling].height + 1;
+    parent.children[0] = sibling;
+    parent.children[1] = leaf;
+    _nodes[sibling].parent = new_parent;
+    _nodes[leaf].parent = new_parent;
+
+    if (old_parent == _INVALID_NODE) {
+        _root = new_parent;
+    } else {
+        _Node& grandparent = _nodes[old_parent];
+        grandparent.children[grandparent.children[0] == sibling ? 0 : 1] = new_parent;
+    }
+    _refit_upwards(_nodes[leaf].parent);
+}
+
+void DynamicBvh::_remove_leaf(uint32_t leaf) {
+    if (leaf == _root) {
+        _root = _INVALID_NODE;
+        return;
+    }
+
+    uint32_t parent = _nodes[leaf].parent;
+    uint32_t grandparent = _nodes[parent].parent;
+    uint32_t sibling = _nodes[parent].children[_nodes[parent].children[0] == leaf ? 1 : 0];
+    _free_node(parent);
+    _nodes[leaf].parent = _INVALID_NODE;
+
+    if (grandparent == _INVALID_NODE) {
+        _root = sibling;
+        _nodes[sibling].parent = _INVALID_NODE;
+        return;
+    }
+    _Node& node = _nodes[grandparent];
+    node.children[node.children[0] == parent ? 0 : 1] = sibling;
+    _nodes[sibling].parent = grandparent;
+    _refit_upwards(grandparent);
+}
+
+void DynamicBvh::_refit_upwards(uint32_t index) {
+    while (index != _INVALID_NODE) {
+        index = _balance(index);
+        _Node& node = _nodes[index];
+        const _Node& left = _nodes[node.children[0]];
+        const _Node& right = _nodes[node.children[1]];
+        node.height = 1 + std::max(left.height, right.height);
+        node.bounds = Aabb::merge(left.bounds, right.bounds);
+        index = node.parent;
+    }
+}
+
+// Rotates the taller child of `a` up if the children's heights differ by more than one, returns
+// the node now at `a`'s position
+uint32_t DynamicBvh::_balance(uint32_t a) {
+    _Node& node_a = _nodes[a];
+    if (node_a.leaf() || node_a.height < 2) {
+        return a;
+    }
+    uint32_t b = node_a.children[0];
+    uint32_t c = node_a.children[1];
+    _Node& node_b = _nodes[b];
+    _Node& node_c = _nodes[c];
+    int32_t balance = (int32_t)node_c.height - (int32_t)node_b.height;
+    if (balance >= -1 && balance <= 1) {
+        return a;
+    }
+
+    // `up` takes `a`'s place, `a` keeps `other` and takes one of `up`'s children
+    uint32_t up = balance > 1 ? c : b;
+    _Node& node_up = _nodes[up];
+    uint32_t a_slot = balance > 1 ? 1 : 0;
+    uint32_t f = node_up.children[0];
+    uint32_t g = node_up.children[1];
+    _Node& node_f = _nodes[f];
+    _Node& node_g = _nodes[g];
+
+    node_up.children[0] = a;
+    node_up.parent = node_a.parent;
+    node_a.parent = up;
+    if (node_up.parent == _INVALID_NODE) {
+        _root = up;
+    } else {
+        _Node& parent = _nodes[node_up.parent];
+        parent.children[parent.children[0] == a ? 0 : 1] = up;
+    }
+
+    // The taller grandchild stays with `up`, the shorter one moves to `a`
+    uint32_t keep = node_f.height > node_g.height ? f : g;
+    uint32_t move = keep == f ? g : f;
+    node_up.children[1] = keep;
+    node_a.children[a_slot] = move;
+    _nodes[move].parent = a;
+
+    const _Node& node_other = _nodes[node_a.children[1 - a_slot]];
+    node_a.bounds = Aabb::merge(node_other.bounds, _nodes[move].bounds);
+    node_a.height = 1 + std::max(node_other.height, _nodes[move].height);
+    node_up.bounds = Aabb::merge(node_a.bounds, _nodes[keep].bounds);
+    node_up.height = 1 + std::max(node_a.height, _nodes[keep].height);
+    return up;
+}
+
+uint32_t DynamicBvh::_build(uint32_t* leaves, uint32_t count, uint32_t depth) {
+    if (count == 1) {
+        return leaves[0];
+    }
+
+    Aabb centroid_bounds;
+    for (uint32_t i = 0; i < count; i++) {
+        glm::vec3 center = _nodes[leaves[i]].bounds.center();
+        centroid_bounds = Aabb::merge(centroid_bounds, Aabb(center, center));
+    }
+    glm::vec3 extent = centroid_bounds.max - centroid_bounds.min;
+    uint32_t axis = 0;
+    if (extent.y > extent[axis]) {
+        axis = 1;
+    }
+    if (extent.z > extent[axis]) {
+        axis = 2;
+    }
+
+    uint32_t split = 0;
+    if (extent[axis] > 0.0f && depth < BVH_SAH_MAX_DEPTH) {
+        float bin_scale = (float)BVH_BIN_COUNT / extent[axis];
+        auto bin_of = [&](uint32_t leaf) {
+            float offset = _nodes[leaf].bounds.center()[axis] - centroid_bounds.min[axis];
+            return std::min((uint32_t)(offset * bin_scale), BVH_BIN_COUNT - 1);
+        };
+
+        Aabb bin_bounds[BVH_BIN_COUNT];
+        uint32_t bin_counts[BVH_BIN_COUNT] = {};
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t bin = bin_of(leaves[i]);
+            bin_bounds[bin] = Aabb::merge(bin_bounds[bin], _nodes[leaves[i]].bounds);
+            bin_counts[bin]++;
+        }
+
+        // Cost of splitting after each bin is the area times the leaf count of both sides
+        float right_costs[BVH_BIN_COUNT] = {};
+        Aabb right;
+        uint32_t right_count = 0;
+        for (uint32_t i = BVH_BIN_COUNT - 1; i > 0; i--) {
+            right = Aabb::merge(right, bin_bounds[i]);
+            right_count += bin_counts[i];
+            right_costs[i] = right_count > 0 ? right.surface_area() * right_count : 0.0f;
+        }
+        Aabb left;
+        uint32_t left_count = 0;
+        float best_cost = FLT_MAX;
+        uint32_t best_bin = 0;
+        for (uint32_t i = 0; i + 1 < BVH_BIN_COUNT; i++) {
+            left = Aabb::merge(left, bin_bounds[i]);
+            left_count += bin_counts[i];
+            if (left_count == 0 || left_count == count) {
+                continue;
+            }
+            float cost = left.surface_area() * left_count + right_costs[i + 1];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_bin = i;
+            }
+        }
+        if (best_cost < FLT_MAX) {
+            uint32_t* middle = std::partition(leaves, leaves + count, [&](uint32_t leaf) {
+                return bin_of(leaf) <= best_bin;
+            });
+            split = (uint32_t)(middle - leaves);
+        }
+    }
+    if (split == 0 || split == count) {
+        split = count / 2;
+        std::nth_element(leaves, leaves + split, leaves + count, [&](uint32_t a, uint32_t b) {
+            return _nodes[a].bounds.center()[axis] < _nodes[b].bounds.center()[axis];
+        });
+    }
+
+    uint32_t index = _allocate_node();
+    uint32_t left_child = _build(leaves, split, depth + 1);
+    uint32_t right_child = _build(leaves + split, count - split, depth + 1);
+    _Node& node = _nodes[index];
+    node.children[0] = left_child;
+    node.children[1] = right_child;
+    node.bounds = Aabb::merge(_nodes[left_child].bounds, _nodes[right_child].bounds);
+    node.height = 1 + std::max(_nodes[left_child].height, _nodes[right_child].height);
+    _nodes[left_child].parent = index;
+    _nodes[right_child].parent = index;
+    return index;
+}
+
+void DynamicBvh::_on_destroy(entt::registry&, entt::entity entity) {
+    if (contains(entity)) {
+        remove(entity);
+    }
+}
+
+} // namespace ky
@@ -0,0 +1,250 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_SCENE__DYNAMIC_BVH_H
+#define KRYOS_SCENE__DYNAMIC_BVH_H
+
+#include "core/error.h"
+#include "core/jobs.h"
+#include "core/memory_tracker.h"
+#include "scene/bounds.h"
+
+#include <cfloat>
+#include <cstdint>
+#include <entt/entity/registry.hpp>
+#include <utility>
+
+// Distance the bounds stored in the tree are grown by on every side, bounds moving less than
+// that don't change the tree.
+#ifndef KY_BVH_FAT_MARGIN
+#    define KY_BVH_FAT_MARGIN 0.1f
+#endif
+
+// Traversal stack size of the queries, has to exceed the tree height. Insertion keeps the tree
+// balanced and `rebuild` limits its depth, so heights stay far below this.
+#ifndef KY_BVH_STACK_SIZE
+#    define KY_BVH_STACK_SIZE 256
+#endif
+
+namespace ky {
+
+// Dynamic AABB tree over entity bounds. Leaves store bounds grown by a margin so entities moving
+// a little don't touch the tree. Inserting picks the sibling with the lowest surface area cost
+// and rotates nodes on the way up to keep the tree balanced. `rebuild` replaces the whole tree
+// with a binned SAH build, to undo the quality lost by incremental updates over time.
+//
+// Entities destroyed in the registry are removed automatically. Queries are const and can run
+// concurrently from any number of threads, `parallel_queries` spreads a batch of them over the
+// job system. Modifications are not thread safe.
+class DynamicBvh {
+public:
+    explicit DynamicBvh(entt::registry& registry, float fat_margin = KY_BVH_FAT_MARGIN);
+    ~DynamicBvh();
+
+    DynamicBvh(const DynamicBvh&) = delete;
+    DynamicBvh& operator=(const DynamicBvh&) = delete;
+
+    void insert(entt::entity entity, const Aabb& bounds);
+    void remove(entt::entity entity);
+    // Sets new bounds for `entity`. The tree only changes when they leave the fat bounds the
+    // entity was inserted with, returns whether it did.
+    bool update(entt::entity entity, const Aabb& bounds);
+    bool contains(entt::entity entity) const;
+    const Aabb& bounds(entt::entity entity) const;
+
+    void rebuild();
+    void clear();
+
+    // Calls `function(entity)` for every entity whose bounds overlap `bounds`.
+    template <typename _Function>
+    void query_aabb(const Aabb& bounds, _Function&& function) const;
+
+    // Calls `function(entity)` for every entity whose bounds are at least partially inside
+    // `frustum`. Subtrees entirely inside are reported without testing their nodes.
+    template <typename _Function>
+    void query_frustum(const Frustum& frustum, _Function&& function) const;
+
+    // Calls `function(entity, t)` for every entity whose bounds the ray enters at distance `t`
+    // within `max_distance`. The function returns the new maximum distance, `t` to only look for
+    // closer hits, `max_distance` to find all of them.
+    template <typename _Function>
+    void raycast(const Ray& ray, float max_distance, _Function&& function) const;
+
+    // Entity with the bounds closest to `point` within `max_distance`, null when there's none.
+    entt::entity nearest(const glm::vec3& point, float max_distance = FLT_MAX,
+                         float* distance = nullptr) const;
+
+    // Calls `query(index)` for every index in [0, count) spread over the job system, for running
+    // a batch of queries such as one ray per index.
+    template <typename _Query>
+    void parallel_queries(size_t count, _Query&& query, size_t min_chunk_size = 16) const;
+
+    inline size_t size() const { return _size; }
+    inline uint32_t height() const { return _root != _INVALID_NODE ? _nodes[_root].height : 0; }
+    // Summed surface area of the internal nodes relative to the root's, lower is better. Grows as
+    // incremental updates degrade the tree, a good measure of when to `rebuild`.
+    float area_ratio() const;
+
+private:
+    static constexpr uint32_t _INVALID_NODE = UINT32_MAX;
+    static constexpr uint32_t _INSIDE_BIT = 0x80000000u;
+
+    // Leaves have no children and store the entity's exact bounds next to the fat ones. Free
+    // nodes are linked through `parent`.
+    struct _Node {
+        Aabb bounds;
+        Aabb entity_bounds;
+        uint32_t parent = _INVALID_NODE;
+        uint32_t children[2] = {_INVALID_NODE, _INVALID_NODE};
+        uint32_t height = 0;
+        entt::entity entity = entt::null;
+
+        inline bool leaf() const { return children[0] == _INVALID_NODE; }
+    };
+
+    entt::registry* _registry;
+    float _fat_margin;
+    TaggedVector<_Node, MEMORY_TAG_ECS> _nodes;
+    // Leaf of each entity, indexed by entity index
+    TaggedVector<uint32_t, MEMORY_TAG_ECS> _leaves;
+    uint32_t _root = _INVALID_NODE;
+    uint32_t _free_list = _INVALID_NODE;
+    size_t _size = 0;
+
+    uint32_t _leaf(entt::entity entity) const;
+    uint32_t _allocate_node();
+    void _free_node(uint32_t node);
+    void _insert_leaf(uint32_t leaf);
+    void _remove_leaf(uint32_t leaf);
+    void _refit_upwards(uint32_t node);
+    uint32_t _balance(uint32_t node);
+    uint32_t _build(uint32_t* leaves, uint32_t count, uint32_t depth);
+
+    void _on_destroy(entt::registry& registry, entt::entity entity);
+};
+
+template <typename _Function>
+void DynamicBvh::query_aabb(const Aabb& bounds, _Function&& function) const {
+    if (_root == _INVALID_NODE) {
+        return;
+    }
+    uint32_t stack[KY_BVH_STACK_SIZE];
+    uint32_t stack_size = 0;
+    stack[stack_size++] = _root;
+    while (stack_size > 0) {
+        const _Node& node = _nodes[stack[--stack_size]];
+        if (!node.bounds.overlaps(bounds)) {
+            continue;
+        }
+        if (node.leaf()) {
+            if (node.entity_bounds.overlaps(bounds)) {
+                function(node.entity);
+            }
+            continue;
+        }
+        KY_ERROR_CONDITION_MSG(stack_size + 2 <= KY_BVH_STACK_SIZE, "BVH stack overflow");
+        stack[stack_size++] = node.children[0];
+        stack[stack_size++] = node.children[1];
+    }
+}
+
+template <typename _Function>
+void DynamicBvh::query_frustum(const Frustum& frustum, _Function&& function) const {
+    if (_root == _INVALID_NODE) {
+        return;
+    }
+    // Nodes known to be inside carry `_INSIDE_BIT` and skip the plane tests
+    uint32_t stack[KY_BVH_STACK_SIZE];
+    uint32_t stack_size = 0;
+    stack[stack_size++] = _root;
+    while (stack_size > 0) {
+        uint32_t entry = stack[--stack_size];
+        const _Node& node = _nodes[entry & ~_INSIDE_BIT];
+        uint32_t inside = entry & _INSIDE_BIT;
+        if (!inside) {
+            FrustumTest test = frustum.test(node.leaf() ? node.entity_bounds : node.bounds);
+            if (test == FRUSTUM_OUTSIDE) {
+                continue;
+            }
+            inside = test == FRUSTUM_INSIDE ? _INSIDE_BIT : 0;
+        }
+        if (node.leaf()) {
+            function(node.entity);
+            continue;
+        }
+        KY_ERROR_CONDITION_MSG(stack_size + 2 <= KY_BVH_STACK_SIZE, "BVH stack overflow");
+        stack[stack_size++] = node.children[0] | inside;
+        stack[stack_size++] = node.children[1] | inside;
+    }
+}
+
+template <typename _Function>
+void DynamicBvh::raycast(const Ray& ray, float max_distance, _Function&& function) const {
+    glm::vec3 inverse_direction = 1.0f / ray.direction;
+    float root_t = 0.0f;
+    if (_root == _INVALID_NODE ||
+        !ray.intersect(_nodes[_root].bounds, inverse_direction, max_distance, root_t)) {
+        return;
+    }
+
+    // Entries hold the distance their bounds were entered at, the closer child is visited first
+    // so hits shrinking `max_distance` can cut off the other one
+    struct Entry {
+        uint32_t node;
+        float t;
+    };
+    Entry stack[KY_BVH_STACK_SIZE];
+    uint32_t stack_size = 0;
+    stack[stack_size++] = Entry {_root, root_t};
+    while (stack_size > 0) {
+        Entry entry = stack[--stack_size];
+        if (entry.t > max_distance) {
+            continue;
+        }
+        const _Node& node = _nodes[entry.node];
+        if (node.leaf()) {
+            float t = 0.0f;
+            if (ray.intersect(node.entity_bounds, inverse_direction, max_distance, t)) {
+                max_distance = glm::min(max_distance, (float)function(node.entity, t));
+            }
+            continue;
+        }
+
+        Entry hits[2];
+        uint32_t hit_count = 0;
+        for (uint32_t child : node.children) {
+            float t = 0.0f;
+            if (ray.intersect(_nodes[child].bounds, inverse_direction, max_distance, t)) {
+                hits[hit_count++] = Entry {child, t};
+            }
+        }
+        KY_ERROR_CONDITION_MSG(stack_size + 2 <= KY_BVH_STACK_SIZE, "BVH stack overflow");
+        if (hit_count == 2 && hits[0].t < hits[1].t) {
+            std::swap(hits[0], hits[1]);
+        }
+        for (uint32_t i = 0; i < hit_count; i++) {
+            stack[stack_size++] = hits[i];
+        }
+    }
+}
+
+template <typename _Query>
+void DynamicBvh::parallel_queries(size_t count, _Query&& query, size_t min_chunk_size) const {
+    JobSystem::parallel_for(count, query, min_chunk_size);
+}
+
+} // namespace ky
+
+#endif
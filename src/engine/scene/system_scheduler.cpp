@@ -0,0 +1,166 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "scene/system_scheduler.h"
+
+#include "core/error.h"
+#include "core/profiler.h"
+
+#include <algorithm>
+
+namespace ky {
+
+CommandBuffer& SystemContext::commands() const {
+    uint32_t thread = JobSystem::thread_index();
+    return _scheduler->_command_buffers[thread != KY_JOB_INVALID_THREAD ? thread : 0];
+}
+
+SystemScheduler::SystemScheduler(entt::registry& registry) : _registry(&registry) {
+}
+
+SystemScheduler::SystemBuilder SystemScheduler::add_system(const std::string_view& name,
+                                                           SystemFunction function) {
+    _System& system = _systems.emplace_back();
+    system.name = name;
+    system.function = std::move(function);
+    system.stage = (uint32_t)_stage_begin.size() - 1;
+    _dirty = true;
+    return SystemBuilder(this, (SystemId)(_systems.size() - 1));
+}
+
+void SystemScheduler::add_sync_point() {
+    if (_stage_begin.back() != _systems.size()) {
+        _stage_begin.push_back((SystemId)_systems.size());
+    }
+}
+
+void SystemScheduler::run() {
+    KY_PROFILE_SCOPE("SystemScheduler::run");
+    if (_dirty) {
+        _compile();
+    }
+    size_t thread_count = std::max(JobSystem::thread_count(), (uint32_t)1);
+    if (_command_buffers.size() < thread_count) {
+        _command_buffers.resize(thread_count);
+    }
+
+    for (size_t stage = 0; stage < _stage_begin.size(); stage++) {
+        size_t end = stage + 1 < _stage_begin.size() ? _stage_begin[stage + 1] : _systems.size();
+        _run_stage(_stage_begin[stage], end);
+        _apply_commands();
+    }
+}
+
+const std::vector<SystemId>& SystemScheduler::successors(SystemId system) {
+    if (_dirty) {
+        _compile();
+    }
+    return _systems[system].successors;
+}
+
+void SystemScheduler::_compile() {
+    for (_System& system : _systems) {
+        system.successors.clear();
+        system.predecessor_count = 0;
+    }
+
+    // Only systems within the same stage need edges, sync points order stages already
+    for (SystemId later = 0; later < _systems.size(); later++) {
+        for (SystemId earlier = _stage_begin[_systems[later].stage]; earlier < later; earlier++) {
+            if (_conflicts(_systems[earlier], _systems[later])) {
+                _systems[earlier].successors.push_back(later);
+                _systems[later].predecessor_count++;
+            }
+        }
+    }
+    _remaining = TaggedVector<std::atomic<uint32_t>, MEMORY_TAG_ECS>(_systems.size());
+    _dirty = false;
+}
+
+void SystemScheduler::_run_stage(size_t begin, size_t end) {
+    KY_PROFILE_SCOPE("SystemScheduler::_run_stage");
+    SystemContext context;
+    context._scheduler = this;
+    context._registry = _registry;
+
+    // Adding order is a valid topological order
+    if (JobSystem::worker_count() == 0) {
+        for (size_t i = begin; i < end; i++) {
+            _systems[i].function(context);
+        }
+        return;
+    }
+
+    for (size_t i = begin; i < end; i++) {
+        _remaining[i].store(_systems[i].predecessor_count, std::memory_order_relaxed);
+    }
+    JobCounter counter;
+    for (size_t i = begin; i < end; i++) {
+        if (_systems[i].predecessor_count == 0) {
+            _submit((SystemId)i, counter);
+        }
+    }
+    JobSystem::wait(counter);
+}
+
+void SystemScheduler::_apply_commands() {
+    KY_PROFILE_SCOPE("SystemScheduler::_apply_commands");
+    for (CommandBuffer& commands : _command_buffers) {
+        commands.apply(*_registry);
+    }
+}
+
+void SystemScheduler::_submit(SystemId system, JobCounter& counter) {
+    SystemScheduler* scheduler = this;
+    JobCounter* counter_ptr = &counter;
+    JobSystem::run(counter, [scheduler, system, counter_ptr]() {
+        SystemContext context;
+        context._scheduler = scheduler;
+        context._registry = scheduler->_registry;
+        scheduler->_systems[system].function(context);
+
+        // Successors are submitted before this job finishes so the counter can't reach zero early
+        for (SystemId successor : scheduler->_systems[system].successors) {
+            if (scheduler->_remaining[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                scheduler->_submit(successor, *counter_ptr);
+            }
+        }
+    });
+}
+
+bool SystemScheduler::_conflicts(const _System& a, const _System& b) {
+    if (a.exclusive || b.exclusive) {
+        return true;
+    }
+    auto intersects = [](const std::vector<entt::id_type>& lhs,
+                         const std::vector<entt::id_type>& rhs) {
+        for (entt::id_type type : lhs) {
+            if (std::find(rhs.begin(), rhs.end(), type) != rhs.end()) {
+                return true;
+            }
+        }
+        return false;
+    };
+    return intersects(a.writes, b.writes) || intersects(a.writes, b.reads) ||
+           intersects(b.writes, a.reads);
+}
+
+SystemScheduler::SystemBuilder& SystemScheduler::SystemBuilder::exclusive() {
+    _scheduler->_systems[_id].exclusive = true;
+    _scheduler->_dirty = true;
+    return *this;
+}
+
+} // namespace ky
@@ -0,0 +1,184 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_SCENE__SYSTEM_SCHEDULER_H
+#define KRYOS_SCENE__SYSTEM_SCHEDULER_H
+
+#include "core/jobs.h"
+#include "scene/command_buffer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <entt/core/type_info.hpp>
+#include <entt/entity/registry.hpp>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace ky {
+
+using SystemId = uint32_t;
+
+class SystemScheduler;
+
+// Passed to systems while they run.
+class SystemContext {
+public:
+    inline entt::registry& registry() const { return *_registry; }
+
+    // Command buffer of the calling thread. Systems running in parallel must record structural
+    // changes here instead of making them directly, they are applied at the next sync point.
+    CommandBuffer& commands() const;
+
+    // Calls `function(entity, components...)` for every entity with all of `_Components`, split
+    // into chunks of at least `min_chunk_size` entities running on all threads. Only components
+    // the system declared may be accessed, written ones from the chunk's entities only.
+    template <typename... _Components, typename _Function>
+    void parallel_each(_Function&& function, size_t min_chunk_size = 1024) const;
+
+private:
+    friend class SystemScheduler;
+
+    SystemScheduler* _scheduler = nullptr;
+    entt::registry* _registry = nullptr;
+};
+
+using SystemFunction = std::function<void(const SystemContext& context)>;
+
+// Runs systems over an `entt::registry` in parallel. Each system declares the component types it
+// reads and writes, two systems conflict when one writes a type the other reads or writes.
+// Conflicting systems run in the order they were added, all others are free to run concurrently
+// on the job system.
+//
+// Structural changes are deferred through `SystemContext::commands` and applied at sync points,
+// between the systems added before and after `add_sync_point` and after the last system.
+class SystemScheduler {
+public:
+    class SystemBuilder {
+    public:
+        template <typename... _Components>
+        SystemBuilder& reads();
+        template <typename... _Components>
+        SystemBuilder& writes();
+
+        // Runs the system on its own, for systems touching the registry in ways that can't be
+        // declared, e.g. making structural changes directly.
+        SystemBuilder& exclusive();
+
+        inline SystemId id() const { return _id; }
+
+    private:
+        friend class SystemScheduler;
+
+        SystemScheduler* _scheduler;
+        SystemId _id;
+
+        SystemBuilder(SystemScheduler* scheduler, SystemId id) : _scheduler(scheduler), _id(id) {}
+    };
+
+    explicit SystemScheduler(entt::registry& registry);
+
+    SystemBuilder add_system(const std::string_view& name, SystemFunction function);
+    void add_sync_point();
+
+    // Runs every system once and applies their deferred commands. Runs serially when the job
+    // system has no workers.
+    void run();
+
+    inline size_t system_count() const { return _systems.size(); }
+    inline const std::string& name(SystemId system) const { return _systems[system].name; }
+    // Systems that can only start once `system` finished.
+    const std::vector<SystemId>& successors(SystemId system);
+
+private:
+    friend class SystemContext;
+
+    struct _System {
+        std::string name;
+        SystemFunction function;
+        std::vector<entt::id_type> reads;
+        std::vector<entt::id_type> writes;
+        bool exclusive = false;
+        uint32_t stage = 0;
+
+        std::vector<SystemId> successors;
+        uint32_t predecessor_count = 0;
+    };
+
+    entt::registry* _registry;
+    TaggedVector<_System, MEMORY_TAG_ECS> _systems;
+    std::vector<SystemId> _stage_begin = {0};
+    TaggedVector<std::atomic<uint32_t>, MEMORY_TAG_ECS> _remaining;
+    TaggedVector<CommandBuffer, MEMORY_TAG_ECS> _command_buffers;
+    bool _dirty = true;
+
+    template <typename _Component>
+    void _declare(SystemId system, bool write);
+
+    void _compile();
+    void _run_stage(size_t begin, size_t end);
+    void _apply_commands();
+    void _submit(SystemId system, JobCounter& counter);
+    static bool _conflicts(const _System& a, const _System& b);
+};
+
+template <typename... _Components>
+SystemScheduler::SystemBuilder& SystemScheduler::SystemBuilder::reads() {
+    (_scheduler->_declare<_Components>(_id, false), ...);
+    return *this;
+}
+
+template <typename... _Components>
+SystemScheduler::SystemBuilder& SystemScheduler::SystemBuilder::writes() {
+    (_scheduler->_declare<_Components>(_id, true), ...);
+    return *this;
+}
+
+template <typename _Component>
+void SystemScheduler::_declare(SystemId system, bool write) {
+    using Component = std::remove_const_t<_Component>;
+    // Creating the storage now keeps systems from adding it to the registry while running
+    static_cast<void>(_registry->storage<Component>());
+
+    std::vector<entt::id_type>& types = write ? _systems[system].writes : _systems[system].reads;
+    types.push_back(entt::type_hash<Component>::value());
+    _dirty = true;
+}
+
+template <typename... _Components, typename _Function>
+void SystemContext::parallel_each(_Function&& function, size_t min_chunk_size) const {
+    auto view = _registry->view<_Components...>();
+    const auto* leading = view.handle();
+    if (leading == nullptr) {
+        return;
+    }
+    // Entities are taken from the leading storage, the smallest of the view's
+    JobSystem::parallel_for(
+        leading->size(),
+        [&view, leading, &function](size_t index) {
+            entt::entity entity = (*leading)[index];
+            if (view.contains(entity)) {
+                std::apply(function, std::tuple_cat(std::make_tuple(entity), view.get(entity)));
+            }
+        },
+        min_chunk_size);
+}
+
+} // namespace ky
+
+#endif
@@ -0,0 +1,336 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "scene/transform_hierarchy.h"
+
+#include "core/error.h"
+#include "core/jobs.h"
+#include "core/profiler.h"
+
+#include <algorithm>
+
+namespace ky {
+
+TransformHierarchy::TransformHierarchy(entt::registry& registry) : _registry(&registry) {
+    _registry->on_destroy<entt::entity>().connect<&TransformHierarchy::_on_destroy>(*this);
+}
+
+TransformHierarchy::~TransformHierarchy() {
+    _registry->on_destroy<entt::entity>().disconnect<&TransformHierarchy::_on_destroy>(*this);
+}
+
+void TransformHierarchy::add(entt::entity entity, entt::entity parent, const glm::vec3& position,
+                             const glm::quat& rotation, const glm::vec3& scale) {
+    KY_ERROR_CONDITION_MSG(_registry->valid(entity), "Entity is not valid");
+    KY_ERROR_CONDITION_MSG(!contains(entity), "Entity is already in the hierarchy");
+    KY_ERROR_CONDITION_MSG(parent == entt::null || contains(parent),
+                           "Parent is not in the hierarchy");
+
+    uint32_t index = entt::to_entity(entity);
+    if (index >= _links.size()) {
+        _links.resize(index + 1);
+    }
+    uint32_t node = (uint32_t)_entities.size();
+    _links[index] = _Links();
+    _links[index].entity = entity;
+    _links[index].node = node;
+    _link(entity, parent);
+
+    _entities.push_back(entity);
+    _parents.push_back(_node(parent));
+    _subtree_sizes.push_back(1);
+    _positions.push_back(position);
+    _rotations.push_back(rotation);
+    _scales.push_back(scale);
+    _world_matrices.push_back(glm::mat4(1.0f));
+    _dirty.push_back(0);
+    _mark_dirty(node);
+    _size++;
+
+    // A new root at the end keeps the depth first order, children have to be moved into their
+    // parent's range
+    if (parent != entt::null) {
+        _order_dirty = true;
+    }
+}
+
+void TransformHierarchy::remove(entt::entity entity) {
+    KY_ERROR_CONDITION_MSG(contains(entity), "Entity is not in the hierarchy");
+    _Links& links = _links[entt::to_entity(entity)];
+    while (links.first_child != entt::null) {
+        entt::entity child = links.first_child;
+        _unlink(child);
+        _link(child, entt::null);
+        uint32_t child_node = _node(child);
+        _parents[child_node] = _INVALID_NODE;
+        _mark_dirty(child_node);
+    }
+    _unlink(entity);
+    _entities[links.node] = entt::null;
+    links = _Links();
+    _size--;
+    _order_dirty = true;
+}
+
+bool TransformHierarchy::contains(entt::entity entity) const {
+    if (entity == entt::null) {
+        return false;
+    }
+    uint32_t index = entt::to_entity(entity);
+    return index < _links.size() && _links[index].entity == entity;
+}
+
+void TransformHierarchy::set_parent(entt::entity entity, entt::entity parent) {
+    KY_ERROR_CONDITION_MSG(contains(entity), "Entity is not in the hierarchy");
+    KY_ERROR_CONDITION_MSG(parent == entt::null || contains(parent),
+                           "Parent is not in the hierarchy");
+    for (entt::entity ancestor = parent; ancestor != entt::null;
+         ancestor = _links[entt::to_entity(ancestor)].parent) {
+        KY_ERROR_CONDITION_MSG(ancestor != entity, "Entity can't be parented to its own subtree");
+    }
+    if (_links[entt::to_entity(entity)].parent == parent) {
+        return;
+    }
+
+    _unlink(entity);
+    _link(entity, parent);
+    uint32_t node = _node(entity);
+    _parents[node] = _node(parent);
+    _mark_dirty(node);
+    _order_dirty = true;
+}
+
+entt::entity TransformHierarchy::parent(entt::entity entity) const {
+    KY_ERROR_CONDITION_MSG_RETURN(contains(entity), entt::null, "Entity is not in the hierarchy");
+    return _links[entt::to_entity(entity)].parent;
+}
+
+void TransformHierarchy::set_local_position(entt::entity entity, const glm::vec3& position) {
+    uint32_t node = _node(entity);
+    KY_ERROR_CONDITION_MSG(node != _INVALID_NODE, "Entity is not in the hierarchy");
+    _positions[node] = position;
+    _mark_dirty(node);
+}
+
+void TransformHierarchy::set_local_rotation(entt::entity entity, const glm::quat& rotation) {
+    uint32_t node = _node(entity);
+    KY_ERROR_CONDITION_MSG(node != _INVALID_NODE, "Entity is not in the hierarchy");
+    _rotations[node] = rotation;
+    _mark_dirty(node);
+}
+
+void TransformHierarchy::set_local_scale(entt::entity entity, const glm::vec3& scale) {
+    uint32_t node = _node(entity);
+    KY_ERROR_CONDITION_MSG(node != _INVALID_NODE, "Entity is not in the hierarchy");
+    _scales[node] = scale;
+    _mark_dirty(node);
+}
+
+void TransformHierarchy::set_local(entt::entity entity, const glm::vec3& position,
+                                   const glm::quat& rotation, const glm::vec3& scale) {
+    uint32_t node = _node(entity);
+    KY_ERROR_CONDITION_MSG(node != _INVALID_NODE, "Entity is not in the hierarchy");
+    _positions[node] = position;
+    _rotations[node] = rotation;
+    _scales[node] = scale;
+    _mark_dirty(node);
+}
+
+const glm::vec3& TransformHierarchy::local_position(entt::entity entity) const {
+    static const glm::vec3 zero(0.0f);
+    uint32_t node = _node(entity);
+    KY_ERROR_CONDITION_MSG_RETURN(node != _INVALID_NODE, zero, "Entity is not in the hierarchy");
+    return _positions[node];
+}
+
+const glm::quat& TransformHierarchy::local_rotation(entt::entity entity) const {
+    static const glm::quat identity(1.0f, 0.0f, 0.0f, 0.0f);
+    uint32_t node = _node(entity);
+    KY_ERROR_CONDITION_MSG_RETURN(node != _INVALID_NODE, identity,
+                                  "Entity is not in the hierarchy");
+    return _rotations[node];
+}
+
+const glm::vec3& TransformHierarchy::local_scale(entt::entity entity) const {
+    static const glm::vec3 one(1.0f);
+    uint32_t node = _node(entity);
+    KY_ERROR_CONDITION_MSG_RETURN(node != _INVALID_NODE, one, "Entity is not in the hierarchy");
+    return _scales[node];
+}
+
+const glm::mat4& TransformHierarchy::world_matrix(entt::entity entity) const {
+    static const glm::mat4 identity(1.0f);
+    uint32_t node = _node(entity);
+    KY_ERROR_CONDITION_MSG_RETURN(node != _INVALID_NODE, identity,
+                                  "Entity is not in the hierarchy");
+    return _world_matrices[node];
+}
+
+void TransformHierarchy::update() {
+    KY_PROFILE_SCOPE("TransformHierarchy::update");
+    if (_order_dirty) {
+        _reorder();
+    }
+    _updated_count = 0;
+    if (_dirty_nodes.empty()) {
+        return;
+    }
+
+    // Subtrees are contiguous, so in node order a dirty node either starts a new range or lies
+    // within the previous one
+    std::sort(_dirty_nodes.begin(), _dirty_nodes.end());
+    _ranges.clear();
+    uint32_t end = 0;
+    for (uint32_t node : _dirty_nodes) {
+        _dirty[node] = 0;
+        if (node < end) {
+            continue;
+        }
+        end = node + _subtree_sizes[node];
+        _ranges.push_back(_Range {node, end});
+        _updated_count += end - node;
+    }
+    _dirty_nodes.clear();
+
+    // Ranges never contain each other's parents, so they can be computed in any order
+    if (_updated_count < KY_TRANSFORM_PARALLEL_THRESHOLD || _ranges.size() == 1) {
+        for (const _Range& range : _ranges) {
+            _update_range(range);
+        }
+    } else {
+        JobSystem::parallel_for(_ranges.size(), [this](size_t i) { _update_range(_ranges[i]); });
+    }
+}
+
+void TransformHierarchy::_link(entt::entity entity, entt::entity parent) {
+    _Links& links = _links[entt::to_entity(entity)];
+    entt::entity& first =
+            parent == entt::null ? _first_root : _links[entt::to_entity(parent)].first_child;
+    links.parent = parent;
+    links.previous_sibling = entt::null;
+    links.next_sibling = first;
+    if (first != entt::null) {
+        _links[entt::to_entity(first)].previous_sibling = entity;
+    }
+    first = entity;
+}
+
+void TransformHierarchy::_unlink(entt::entity entity) {
+    _Links& links = _links[entt::to_entity(entity)];
+    if (links.previous_sibling != entt::null) {
+        _links[entt::to_entity(links.previous_sibling)].next_sibling = links.next_sibling;
+    } else if (links.parent != entt::null) {
+        _links[entt::to_entity(links.parent)].first_child = links.next_sibling;
+    } else {
+        _first_root = links.next_sibling;
+    }
+    if (links.next_sibling != entt::null) {
+        _links[entt::to_entity(links.next_sibling)].previous_sibling = links.previous_sibling;
+    }
+    links.parent = entt::null;
+    links.previous_sibling = entt::null;
+    links.next_sibling = entt::null;
+}
+
+void TransformHierarchy::_reorder() {
+    KY_PROFILE_SCOPE("TransformHierarchy::_reorder");
+    TaggedVector<entt::entity, MEMORY_TAG_ECS> entities;
+    TaggedVector<uint32_t, MEMORY_TAG_ECS> parents;
+    TaggedVector<glm::vec3, MEMORY_TAG_ECS> positions;
+    TaggedVector<glm::quat, MEMORY_TAG_ECS> rotations;
+    TaggedVector<glm::vec3, MEMORY_TAG_ECS> scales;
+    TaggedVector<glm::mat4, MEMORY_TAG_ECS> world_matrices;
+    TaggedVector<uint8_t, MEMORY_TAG_ECS> dirty;
+    entities.reserve(_size);
+    parents.reserve(_size);
+    positions.reserve(_size);
+    rotations.reserve(_size);
+    scales.reserve(_size);
+    world_matrices.reserve(_size);
+    dirty.reserve(_size);
+
+    // Depth first from every root, a node is always emitted before its children so its new
+    // index is known by the time they look it up
+    TaggedVector<entt::entity, MEMORY_TAG_ECS> stack;
+    for (entt::entity root = _first_root; root != entt::null;
+         root = _links[entt::to_entity(root)].next_sibling) {
+        stack.push_back(root);
+        while (!stack.empty()) {
+            entt::entity entity = stack.back();
+            stack.pop_back();
+            _Links& links = _links[entt::to_entity(entity)];
+            uint32_t old_node = links.node;
+            links.node = (uint32_t)entities.size();
+
+            entities.push_back(entity);
+            parents.push_back(links.parent == entt::null
+                                      ? _INVALID_NODE
+                                      : _links[entt::to_entity(links.parent)].node);
+            positions.push_back(_positions[old_node]);
+            rotations.push_back(_rotations[old_node]);
+            scales.push_back(_scales[old_node]);
+            world_matrices.push_back(_world_matrices[old_node]);
+            dirty.push_back(_dirty[old_node]);
+
+            for (entt::entity child = links.first_child; child != entt::null;
+                 child = _links[entt::to_entity(child)].next_sibling) {
+                stack.push_back(child);
+            }
+        }
+    }
+
+    _subtree_sizes.assign(entities.size(), 1);
+    for (size_t i = entities.size(); i-- > 0;) {
+        if (parents[i] != _INVALID_NODE) {
+            _subtree_sizes[parents[i]] += _subtree_sizes[i];
+        }
+    }
+    _dirty_nodes.clear();
+    for (uint32_t i = 0; i < (uint32_t)dirty.size(); i++) {
+        if (dirty[i]) {
+            _dirty_nodes.push_back(i);
+        }
+    }
+
+    _entities.swap(entities);
+    _parents.swap(parents);
+    _positions.swap(positions);
+    _rotations.swap(rotations);
+    _scales.swap(scales);
+    _world_matrices.swap(world_matrices);
+    _dirty.swap(dirty);
+    _order_dirty = false;
+}
+
+void TransformHierarchy::_update_range(const _Range& range) {
+    for (uint32_t i = range.begin; i < range.end; i++) {
+        glm::mat3 rotation = glm::mat3_cast(_rotations[i]);
+        const glm::vec3& scale = _scales[i];
+        glm::mat4 local(glm::vec4(rotation[0] * scale.x, 0.0f),
+                        glm::vec4(rotation[1] * scale.y, 0.0f),
+                        glm::vec4(rotation[2] * scale.z, 0.0f), glm::vec4(_positions[i], 1.0f));
+
+        uint32_t parent = _parents[i];
+        _world_matrices[i] = parent == _INVALID_NODE ? local : _world_matrices[parent] * local;
+    }
+}
+
+void TransformHierarchy::_on_destroy(entt::registry&, entt::entity entity) {
+    if (contains(entity)) {
+        remove(entity);
+    }
+}
+
+} // namespace ky
@@ -0,0 +1,142 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_SCENE__TRANSFORM_HIERARCHY_H
+#define KRYOS_SCENE__TRANSFORM_HIERARCHY_H
+
+#include "core/memory_tracker.h"
+
+#include <cstdint>
+#include <entt/entity/registry.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Minimum number of nodes an update has to recompute before it's spread over the job system.
+#ifndef KY_TRANSFORM_PARALLEL_THRESHOLD
+#    define KY_TRANSFORM_PARALLEL_THRESHOLD 4096
+#endif
+
+namespace ky {
+
+// Parent/child transforms of entities. Local position, rotation and scale are stored
+// structure-of-arrays in depth first order, every subtree is a contiguous range right after its
+// root. `update` only recomputes the world matrices of subtrees that changed, each in a single
+// linear pass, and spreads independent subtrees over the job system. Entities that didn't change
+// cost nothing.
+//
+// Adding, removing and reparenting entities is recorded right away and the arrays are reordered
+// once on the next `update`. Entities destroyed in the registry are removed automatically. Not
+// thread safe, modify from a single thread and read world matrices after `update`.
+class TransformHierarchy {
+public:
+    explicit TransformHierarchy(entt::registry& registry);
+    ~TransformHierarchy();
+
+    TransformHierarchy(const TransformHierarchy&) = delete;
+    TransformHierarchy& operator=(const TransformHierarchy&) = delete;
+
+    // Adds `entity` as a child of `parent`, or as a root when `parent` is null.
+    void add(entt::entity entity, entt::entity parent = entt::null,
+             const glm::vec3& position = glm::vec3(0.0f),
+             const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+             const glm::vec3& scale = glm::vec3(1.0f));
+    // Removes `entity`, its children become roots and keep their local transforms.
+    void remove(entt::entity entity);
+    bool contains(entt::entity entity) const;
+
+    // Moves `entity` and its subtree under `parent`, or to the roots when `parent` is null.
+    void set_parent(entt::entity entity, entt::entity parent);
+    entt::entity parent(entt::entity entity) const;
+
+    void set_local_position(entt::entity entity, const glm::vec3& position);
+    void set_local_rotation(entt::entity entity, const glm::quat& rotation);
+    void set_local_scale(entt::entity entity, const glm::vec3& scale);
+    void set_local(entt::entity entity, const glm::vec3& position, const glm::quat& rotation,
+                   const glm::vec3& scale);
+
+    const glm::vec3& local_position(entt::entity entity) const;
+    const glm::quat& local_rotation(entt::entity entity) const;
+    const glm::vec3& local_scale(entt::entity entity) const;
+    // World matrix as of the last `update`.
+    const glm::mat4& world_matrix(entt::entity entity) const;
+
+    // Applies structural changes and recomputes the world matrices of every changed subtree.
+    void update();
+
+    inline size_t size() const { return _size; }
+    // Number of world matrices recomputed by the last `update`.
+    inline size_t updated_count() const { return _updated_count; }
+
+private:
+    static constexpr uint32_t _INVALID_NODE = UINT32_MAX;
+
+    // Links of each entity, indexed by entity index and stable across reorders. Roots are linked
+    // as siblings starting at `_first_root`.
+    struct _Links {
+        entt::entity entity = entt::null;
+        uint32_t node = _INVALID_NODE;
+        entt::entity parent = entt::null;
+        entt::entity first_child = entt::null;
+        entt::entity next_sibling = entt::null;
+        entt::entity previous_sibling = entt::null;
+    };
+
+    // Subtree to recompute, nodes [begin, end)
+    struct _Range {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    entt::registry* _registry;
+    TaggedVector<_Links, MEMORY_TAG_ECS> _links;
+    entt::entity _first_root = entt::null;
+    size_t _size = 0;
+
+    // Nodes, in depth first order unless `_order_dirty`. Removed nodes stay in place with a null
+    // entity until the next reorder.
+    TaggedVector<entt::entity, MEMORY_TAG_ECS> _entities;
+    TaggedVector<uint32_t, MEMORY_TAG_ECS> _parents;
+    TaggedVector<uint32_t, MEMORY_TAG_ECS> _subtree_sizes;
+    TaggedVector<glm::vec3, MEMORY_TAG_ECS> _positions;
+    TaggedVector<glm::quat, MEMORY_TAG_ECS> _rotations;
+    TaggedVector<glm::vec3, MEMORY_TAG_ECS> _scales;
+    TaggedVector<glm::mat4, MEMORY_TAG_ECS> _world_matrices;
+    TaggedVector<uint8_t, MEMORY_TAG_ECS> _dirty;
+    TaggedVector<uint32_t, MEMORY_TAG_ECS> _dirty_nodes;
+    TaggedVector<_Range, MEMORY_TAG_ECS> _ranges;
+    bool _order_dirty = false;
+    size_t _updated_count = 0;
+
+    inline uint32_t _node(entt::entity entity) const {
+        return contains(entity) ? _links[entt::to_entity(entity)].node : _INVALID_NODE;
+    }
+
+    inline void _mark_dirty(uint32_t node) {
+        if (!_dirty[node]) {
+            _dirty[node] = 1;
+            _dirty_nodes.push_back(node);
+        }
+    }
+
+    void _link(entt::entity entity, entt::entity parent);
+    void _unlink(entt::entity entity);
+    void _reorder();
+    void _update_range(const _Range& range);
+    void _on_destroy(entt::registry& registry, entt::entity entity);
+};
+
+} // namespace ky
+
+#endif
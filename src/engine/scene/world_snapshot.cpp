@@ -0,0 +1,228 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "scene/world_snapshot.h"
+
+#include "core/hash.h"
+#include "core/profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace ky {
+
+using namespace world_snapshot_internal;
+
+static constexpr char _MAGIC[4] = {'K', 'Y', 'W', 'S'};
+
+WorldSnapshotWriter::WorldSnapshotWriter(const entt::registry& registry) : _registry(registry) {
+    _begin_section(entt::type_hash<entt::entity>::value(), 0, (uint32_t)alignof(entt::entity));
+    _OutputArchive archive = {this};
+    entt::snapshot(_registry).get<entt::entity>(archive);
+}
+
+void WorldSnapshotWriter::_OutputArchive::operator()(uint32_t value) {
+    if (values++ == 0) {
+        writer->_reserve(value);
+    } else {
+        writer->_sections.back().free_list = value;
+    }
+}
+
+void WorldSnapshotWriter::_OutputArchive::operator()(entt::entity entity) {
+    // Storages with in place deletion report their holes as null entities without a component
+    if (entity == entt::null) {
+        return;
+    }
+    _Section& section = writer->_sections.back();
+    std::memcpy(writer->_data.data() + section.entities_offset +
+                        (uint64_t)section.count * sizeof(entt::entity),
+                &entity, sizeof(entt::entity));
+    section.count++;
+}
+
+void WorldSnapshotWriter::_begin_section(entt::id_type id, uint32_t element_size,
+                                         uint32_t element_alignment) {
+    _Section section = {};
+    section.id = id;
+    section.element_size = element_size;
+    section.element_alignment = element_alignment;
+    _sections.push_back(section);
+}
+
+void WorldSnapshotWriter::_reserve(uint32_t capacity) {
+    _Section& section = _sections.back();
+    uint64_t alignment =
+            std::max<uint64_t>(KY_WORLD_SNAPSHOT_ALIGNMENT, section.element_alignment);
+    section.entities_offset = align(_data.size(), KY_WORLD_SNAPSHOT_ALIGNMENT);
+    section.components_offset =
+            align(section.entities_offset + (uint64_t)capacity * sizeof(entt::entity), alignment);
+    section.size = section.components_offset + (uint64_t)capacity * section.element_size -
+                   section.entities_offset;
+    _data.resize(section.entities_offset + section.size);
+}
+
+bool WorldSnapshotWriter::save(const char* path) const {
+    KY_PROFILE_SCOPE("WorldSnapshotWriter::save");
+    uint64_t table_end = sizeof(Header) + _sections.size() * sizeof(_Section);
+    uint64_t data_offset = align(table_end, KY_WORLD_SNAPSHOT_ALIGNMENT);
+
+    TaggedVector<_Section, MEMORY_TAG_ECS> sections(_sections.begin(), _sections.end());
+    for (_Section& section : sections) {
+        // Storages with holes leave the end of their arrays unused, only the used part counts
+        section.size = section.components_offset - section.entities_offset +
+                       (uint64_t)section.count * section.element_size;
+        section.hash = hash_bytes(_data.data() + section.entities_offset, section.size);
+        section.entities_offset += data_offset;
+        section.components_offset += data_offset;
+    }
+
+    Header header = {};
+    std::memcpy(header.magic, _MAGIC, sizeof(_MAGIC));
+    header.version = KY_WORLD_SNAPSHOT_VERSION;
+    header.section_count = (uint32_t)sections.size();
+    header.file_size = data_offset + _data.size();
+    header.table_hash = hash_bytes(sections.data(), sections.size() * sizeof(_Section));
+
+    FILE* file = fopen(path, "wb");
+    KY_ERROR_CONDITION_MSG_RETURN(file != nullptr, false, "Failed to open world snapshot file");
+    uint8_t padding[KY_WORLD_SNAPSHOT_ALIGNMENT] = {};
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(sections.data(), sizeof(_Section), sections.size(), file) ==
+                           sections.size() &&
+                   fwrite(padding, 1, data_offset - table_end, file) == data_offset - table_end &&
+                   fwrite(_data.data(), 1, _data.size(), file) == _data.size();
+    written = fclose(file) == 0 && written;
+    KY_ERROR_CONDITION_MSG_RETURN(written, false, "Failed to write world snapshot");
+    return true;
+}
+
+bool WorldSnapshot::open(const char* path, WorldSnapshotValidation validation) {
+    KY_PROFILE_SCOPE("WorldSnapshot::open");
+    close();
+    if (!_file.open(path)) {
+        return false;
+    }
+
+    const uint8_t* data = _file.data();
+    size_t size = _file.size();
+    const Header* header = (const Header*)data;
+    bool valid = size >= sizeof(Header) &&
+                 std::memcmp(header->magic, _MAGIC, sizeof(_MAGIC)) == 0 &&
+                 header->version == KY_WORLD_SNAPSHOT_VERSION && header->file_size == size &&
+                 header->section_count > 0 &&
+                 header->section_count <= (size - sizeof(Header)) / sizeof(_Section);
+    if (valid) {
+        const _Section* sections = (const _Section*)(data + sizeof(Header));
+        valid = hash_bytes(sections, header->section_count * sizeof(_Section)) ==
+                        header->table_hash &&
+                sections[0].id == entt::type_hash<entt::entity>::value();
+        for (uint32_t i = 0; valid && i < header->section_count; i++) {
+            const _Section& section = sections[i];
+            uint64_t components_end =
+                    section.components_offset + (uint64_t)section.count * section.element_size;
+            valid = section.entities_offset % KY_WORLD_SNAPSHOT_ALIGNMENT == 0 &&
+                    section.element_alignment != 0 &&
+                    section.components_offset % section.element_alignment == 0 &&
+                    section.entities_offset + (uint64_t)section.count * sizeof(entt::entity) <=
+                            section.components_offset &&
+                    components_end <= size &&
+                    section.entities_offset + section.size == components_end;
+        }
+    }
+    if (!valid) {
+        close();
+        KY_ERROR_MSG("%s is not a supported world snapshot", path);
+        return false;
+    }
+
+    _sections = (const _Section*)(data + sizeof(Header));
+    _section_count = header->section_count;
+    _validation = validation;
+    return true;
+}
+
+void WorldSnapshot::close() {
+    _file.close();
+    _sections = nullptr;
+    _section_count = 0;
+}
+
+bool WorldSnapshot::validate() const {
+    KY_PROFILE_SCOPE("WorldSnapshot::validate");
+    for (uint32_t i = 0; i < _section_count; i++) {
+        KY_ERROR_CONDITION_MSG_RETURN(_validate(_sections[i]), false,
+                                      "World snapshot section is corrupt");
+    }
+    return true;
+}
+
+const WorldSnapshot::_Section* WorldSnapshot::_find(entt::id_type id) const {
+    for (uint32_t i = 0; i < _section_count; i++) {
+        if (_sections[i].id == id) {
+            return &_sections[i];
+        }
+    }
+    return nullptr;
+}
+
+const WorldSnapshot::_Section* WorldSnapshot::_section(entt::id_type id, uint32_t element_size,
+                                                       uint32_t element_alignment) const {
+    const _Section* section = _find(id);
+    if (section == nullptr) {
+        return nullptr;
+    }
+    KY_ERROR_CONDITION_MSG_RETURN(section->element_size == element_size &&
+                                          section->element_alignment == element_alignment,
+                                  nullptr, "Snapshot component layout doesn't match its type");
+    if (_validation == WORLD_SNAPSHOT_VALIDATE_SECTIONS) {
+        KY_ERROR_CONDITION_MSG_RETURN(_validate(*section), nullptr,
+                                      "World snapshot section is corrupt");
+    }
+    return section;
+}
+
+bool WorldSnapshot::_validate(const _Section& section) const {
+    return hash_bytes(_file.data() + section.entities_offset, section.size) == section.hash;
+}
+
+bool WorldSnapshot::_load_entities(entt::registry& registry) const {
+    KY_PROFILE_SCOPE("WorldSnapshot::load");
+    KY_ERROR_CONDITION_MSG_RETURN(is_open(), false, "World snapshot is not open");
+    KY_ERROR_CONDITION_MSG_RETURN(registry.storage<entt::entity>().empty(), false,
+                                  "Snapshots are loaded into empty registries");
+    const _Section& section = _sections[0];
+    if (_validation == WORLD_SNAPSHOT_VALIDATE_SECTIONS) {
+        KY_ERROR_CONDITION_MSG_RETURN(_validate(section), false,
+                                      "World snapshot section is corrupt");
+    }
+
+    // Feeds the entity storage to `entt::snapshot_loader` in the order `entt::snapshot` wrote it
+    struct InputArchive {
+        const _Section& section;
+        const entt::entity* entities;
+        uint32_t values;
+
+        void operator()(uint32_t& value) {
+            value = values++ == 0 ? section.count : section.free_list;
+        }
+        void operator()(entt::entity& entity) { entity = *entities++; }
+    };
+    InputArchive archive = {section, _entities(section), 0};
+    entt::snapshot_loader(registry).get<entt::entity>(archive);
+    return true;
+}
+
+} // namespace ky
@@ -0,0 +1,318 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_SCENE__WORLD_SNAPSHOT_H
+#define KRYOS_SCENE__WORLD_SNAPSHOT_H
+
+#include "core/error.h"
+#include "core/jobs.h"
+#include "core/mapped_file.h"
+#include "core/memory_tracker.h"
+
+#include <cstring>
+#include <entt/entity/registry.hpp>
+#include <entt/entity/snapshot.hpp>
+#include <type_traits>
+
+// World snapshot file format, all values little endian:
+//
+// A 64 byte header holding the magic "KYWS", the format version, the section count, the file size
+// and the hash of the section table. The section table follows, then the sections themselves.
+// A section is the entity array of one storage followed by its component array. Both start on a
+// `KY_WORLD_SNAPSHOT_ALIGNMENT` boundary so a mapping of the file can be used in place, and each
+// section carries a hash of its bytes.
+//
+// The first section always holds the entity storage, including released entities and the free
+// list length, so entity identifiers and versions are restored exactly. Components are stored as
+// raw bytes and therefore have to be trivially copyable. Sections are matched to types by
+// `entt::type_hash` and checked against the size and alignment of the type when loaded.
+
+#define KY_WORLD_SNAPSHOT_VERSION 1
+
+#ifndef KY_WORLD_SNAPSHOT_ALIGNMENT
+#    define KY_WORLD_SNAPSHOT_ALIGNMENT 64
+#endif
+
+namespace ky {
+
+namespace world_snapshot_internal {
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t section_count;
+        uint32_t reserved;
+        uint64_t file_size;
+        uint64_t table_hash;
+        uint8_t padding[32];
+    };
+    static_assert(sizeof(Header) == 64, "Snapshot header layout changed");
+
+    struct Section {
+        entt::id_type id;
+        uint32_t count;
+        uint32_t element_size;
+        uint32_t element_alignment;
+        // Entity storage only, number of entities in use
+        uint32_t free_list;
+        uint32_t reserved;
+        uint64_t entities_offset;
+        uint64_t components_offset;
+        // Bytes from `entities_offset` to the end of the component array
+        uint64_t size;
+        uint64_t hash;
+    };
+
+    inline uint64_t align(uint64_t offset, uint64_t alignment) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    template <typename Component>
+    constexpr uint32_t element_size() {
+        return std::is_empty_v<Component> ? 0 : (uint32_t)sizeof(Component);
+    }
+
+} // namespace world_snapshot_internal
+
+// Collects storages of a registry through `entt::snapshot` into the layout of the file, which is
+// then written in a single pass by `save`.
+class WorldSnapshotWriter {
+public:
+    // Records the entity storage, component storages are added with `write`.
+    explicit WorldSnapshotWriter(const entt::registry& registry);
+
+    template <typename Component>
+    void write();
+
+    bool save(const char* path) const;
+
+private:
+    using _Section = world_snapshot_internal::Section;
+
+    // Receives the storage contents from `entt::snapshot`. The first value is the storage size,
+    // which reserves the arrays, then entity and component values in storage order.
+    struct _OutputArchive {
+        WorldSnapshotWriter* writer;
+        uint32_t values = 0;
+
+        void operator()(uint32_t value);
+        void operator()(entt::entity entity);
+        template <typename Component>
+        void operator()(const Component& component);
+    };
+
+    const entt::registry& _registry;
+    TaggedVector<_Section, MEMORY_TAG_ECS> _sections;
+    // Section data as it will appear in the file, offsets are relative to its start until saved
+    TaggedVector<uint8_t, MEMORY_TAG_ECS> _data;
+
+    void _begin_section(entt::id_type id, uint32_t element_size, uint32_t element_alignment);
+    void _reserve(uint32_t capacity);
+};
+
+enum WorldSnapshotValidation {
+    // Trust the file, for snapshots validated by other means such as a checked pack file
+    WORLD_SNAPSHOT_VALIDATE_NONE,
+    // Hash every section when it's loaded or viewed, partial loads only pay for what they use
+    WORLD_SNAPSHOT_VALIDATE_SECTIONS,
+};
+
+// Components of one section used in place from the mapped file.
+template <typename Component>
+struct SnapshotComponents {
+    const entt::entity* entities = nullptr;
+    // Null for empty component types
+    const Component* components = nullptr;
+    size_t size = 0;
+};
+
+// Memory mapped world snapshot. Loading copies the mapped arrays into the registry storages
+// without deserializing them. A full load still runs well below the speed of reading the file
+// (0.5 to 1.3 GB/s against 5 to 8 GB/s to open and validate it), most of it spent touching the
+// freshly allocated storage for the first time.
+class WorldSnapshot {
+public:
+    bool open(const char* path,
+              WorldSnapshotValidation validation = WORLD_SNAPSHOT_VALIDATE_SECTIONS);
+    void close();
+    inline bool is_open() const { return _file.is_open(); }
+
+    // Hashes every section regardless of the validation mode.
+    bool validate() const;
+
+    template <typename Component>
+    bool contains() const;
+
+    // Restores the entity storage into an empty registry followed by every given component. The
+    // component storages are filled in parallel on the job system, `on_construct` listeners of
+    // the loaded types run on job threads.
+    template <typename... Components>
+    bool load(entt::registry& registry) const;
+
+    // Loads the components of one type into `registry`, replacing components it already has and
+    // creating entities it doesn't have yet.
+    template <typename Component>
+    bool load_components(entt::registry& registry) const;
+
+    // Components of one type in place, empty when the snapshot doesn't contain the type or the
+    // section fails validation. Pointers stay valid until the snapshot is closed.
+    template <typename Component>
+    SnapshotComponents<Component> components() const;
+
+private:
+    using _Section = world_snapshot_internal::Section;
+
+    MappedFile _file;
+    const _Section* _sections = nullptr;
+    uint32_t _section_count = 0;
+    WorldSnapshotValidation _validation = WORLD_SNAPSHOT_VALIDATE_SECTIONS;
+
+    const _Section* _find(entt::id_type id) const;
+    // Finds the section of a component type, checking its layout and hash
+    const _Section* _section(entt::id_type id, uint32_t element_size,
+                             uint32_t element_alignment) const;
+    bool _validate(const _Section& section) const;
+    bool _load_entities(entt::registry& registry) const;
+    // Full loads run these in parallel and can't create entities, they'd race on the storage
+    template <typename Component>
+    bool _load_components(entt::registry& registry, bool create_entities) const;
+    template <typename Component>
+    static bool _load_storage(const WorldSnapshot& snapshot, entt::registry& registry) {
+        return snapshot._load_components<Component>(registry, false);
+    }
+
+    inline const entt::entity* _entities(const _Section& section) const {
+        return (const entt::entity*)(_file.data() + section.entities_offset);
+    }
+};
+
+template <typename Component>
+void WorldSnapshotWriter::_OutputArchive::operator()(const Component& component) {
+    _Section& section = writer->_sections.back();
+    std::memcpy(writer->_data.data() + section.components_offset +
+                        (uint64_t)(section.count - 1) * sizeof(Component),
+                &component, sizeof(Component));
+}
+
+template <typename Component>
+void WorldSnapshotWriter::write() {
+    static_assert(std::is_trivially_copyable_v<Component>,
+                  "Snapshot components are stored as raw bytes");
+    entt::id_type id = entt::type_hash<Component>::value();
+    for (const _Section& section : _sections) {
+        KY_ERROR_CONDITION_MSG(section.id != id, "Component type was already written");
+    }
+    _begin_section(id, world_snapshot_internal::element_size<Component>(),
+                   (uint32_t)alignof(Component));
+    _OutputArchive archive = {this};
+    entt::snapshot(_registry).get<Component>(archive);
+}
+
+template <typename Component>
+bool WorldSnapshot::contains() const {
+    return _find(entt::type_hash<Component>::value()) != nullptr;
+}
+
+template <typename... Components>
+bool WorldSnapshot::load(entt::registry& registry) const {
+    if (!_load_entities(registry)) {
+        return false;
+    }
+    if constexpr (sizeof...(Components) > 0) {
+        // Storages are created here so the jobs filling them only look them up
+        (registry.storage<Components>(), ...);
+        using Loader = bool (*)(const WorldSnapshot& snapshot, entt::registry& registry);
+        static constexpr Loader loaders[] = {&WorldSnapshot::_load_storage<Components>...};
+        bool loaded[sizeof...(Components)];
+        JobSystem::parallel_for(sizeof...(Components),
+                                [&](size_t i) { loaded[i] = loaders[i](*this, registry); });
+        for (bool success : loaded) {
+            if (!success) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <typename Component>
+bool WorldSnapshot::load_components(entt::registry& registry) const {
+    return _load_components<Component>(registry, true);
+}
+
+template <typename Component>
+bool WorldSnapshot::_load_components(entt::registry& registry, bool create_entities) const {
+    const _Section* section =
+            _section(entt::type_hash<Component>::value(),
+                     world_snapshot_internal::element_size<Component>(), alignof(Component));
+    KY_ERROR_CONDITION_MSG_RETURN(section != nullptr, false,
+                                  "Snapshot has no valid section for the component type");
+
+    const entt::entity* first = _entities(*section);
+    const entt::entity* last = first + section->count;
+    auto& entities = registry.storage<entt::entity>();
+    for (const entt::entity* entity = first; entity != last; entity++) {
+        if (!entities.contains(*entity)) {
+            KY_ERROR_CONDITION_MSG_RETURN(create_entities, false,
+                                          "Snapshot component belongs to a missing entity");
+            entities.emplace(*entity);
+        }
+    }
+
+    auto& storage = registry.storage<Component>();
+    if constexpr (std::is_empty_v<Component>) {
+        if (storage.empty()) {
+            storage.insert(first, last);
+        } else {
+            for (const entt::entity* entity = first; entity != last; entity++) {
+                registry.emplace_or_replace<Component>(*entity);
+            }
+        }
+    } else {
+        const Component* components =
+                (const Component*)(_file.data() + section->components_offset);
+        if (storage.empty()) {
+            // Reserved once and filled in snapshot order. Copying the packed arrays with memcpy
+            // isn't faster, the first writes to the new pages cost more than the inserts.
+            storage.reserve(section->count);
+            storage.insert(first, last, components);
+        } else {
+            for (uint32_t i = 0; i < section->count; i++) {
+                registry.emplace_or_replace<Component>(first[i], components[i]);
+            }
+        }
+    }
+    return true;
+}
+
+template <typename Component>
+SnapshotComponents<Component> WorldSnapshot::components() const {
+    SnapshotComponents<Component> result;
+    const _Section* section =
+            _section(entt::type_hash<Component>::value(),
+                     world_snapshot_internal::element_size<Component>(), alignof(Component));
+    if (section != nullptr) {
+        result.entities = _entities(*section);
+        if constexpr (!std::is_empty_v<Component>) {
+            result.components = (const Component*)(_file.data() + section->components_offset);
+        }
+        result.size = section->count;
+    }
+    return result;
+}
+
+} // namespace ky
+
+#endif
@@ -0,0 +1,80 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "core/error.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace ky {
+namespace test {
+
+    struct _Test {
+        const char* name;
+        TestFunction function;
+    };
+
+    static constexpr size_t _MAX_TESTS = 256;
+    static _Test _tests[_MAX_TESTS];
+    static size_t _test_count = 0;
+    static uint32_t _failed_checks = 0;
+
+    int register_test(const char* name, TestFunction function) {
+        if (_test_count < _MAX_TESTS) {
+            _tests[_test_count++] = _Test {name, function};
+        }
+        return (int)_test_count;
+    }
+
+    bool check(bool condition, const char* expression, const char* file, int line) {
+        if (!condition) {
+            printf("    %s:%d: check failed: %s\n", file, line, expression);
+            fflush(stdout);
+            _failed_checks++;
+        }
+        return condition;
+    }
+
+} // namespace test
+} // namespace ky
+
+// Exits with 1 when a check failed or no test matched the filter, so a misspelled CTest filter
+// doesn't pass silently.
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    size_t run = 0;
+    size_t failed = 0;
+    ky::error::init();
+    for (size_t i = 0; i < ky::test::_test_count; i++) {
+        const ky::test::_Test& test = ky::test::_tests[i];
+        if (filter != nullptr && std::strncmp(test.name, filter, std::strlen(filter)) != 0) {
+            continue;
+        }
+        printf("%s\n", test.name);
+        fflush(stdout);
+        uint32_t failed_checks = ky::test::_failed_checks;
+        test.function();
+        run++;
+        if (ky::test::_failed_checks != failed_checks) {
+            failed++;
+        }
+    }
+    ky::error::shutdown();
+
+    printf("%zu of %zu tests passed\n", run - failed, run);
+    return run > 0 && failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,286 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "core/jobs.h"
+#include "render_hardware/base/context.h"
+#include "render_hardware/null/null_device.h"
+#include "renderer/frame_graph.h"
+
+namespace ky {
+
+struct TestFrame {
+    FrameGraphResource first;
+    FrameGraphResource second;
+    FrameGraphResource third;
+    FrameGraphResource unused;
+    FrameGraphResource swapchain;
+    FrameGraphPass unused_pass;
+};
+
+// Passes only clear what they write, the tests check the decisions compiling made
+static FrameGraphPassFunction clear_pass(FrameGraphResource target) {
+    return [target](const FrameGraphPassContext& context) {
+        RenderPassDesc pass;
+        pass.colors[0].texture = context.texture(target);
+        pass.color_count = 1;
+        context.list().begin_render_pass(pass);
+        context.list().end_render_pass();
+    };
+}
+
+// A chain of three passes feeding the swapchain, with a pass nothing reads between the second
+// and the third. The first texture is done with before the third is written, so they can alias.
+static TestFrame declare_frame(FrameGraph& graph, TextureHandle swapchain) {
+    TextureDesc desc;
+    desc.width = 256;
+    desc.height = 256;
+    desc.usage = TEXTURE_USAGE_COLOR_ATTACHMENT_BIT | TEXTURE_USAGE_SAMPLED_BIT;
+
+    TestFrame frame;
+    graph.reset();
+    frame.first = graph.create_texture("first", desc);
+    frame.second = graph.create_texture("second", desc);
+    frame.third = graph.create_texture("third", desc);
+    frame.unused = graph.create_texture("unused", desc);
+    frame.swapchain = graph.import_texture("swapchain", swapchain, RESOURCE_STATE_UNDEFINED,
+                                           RESOURCE_STATE_PRESENT);
+    graph.add_pass("first", clear_pass(frame.first))
+        .write(frame.first, RESOURCE_STATE_COLOR_ATTACHMENT);
+    graph.add_pass("second", clear_pass(frame.second))
+        .read(frame.first, RESOURCE_STATE_SHADER_READ)
+        .write(frame.second, RESOURCE_STATE_COLOR_ATTACHMENT);
+    frame.unused_pass = graph.add_pass("unused", clear_pass(frame.unused))
+                            .write(frame.unused, RESOURCE_STATE_COLOR_ATTACHMENT)
+                            .pass();
+    graph.add_pass("third", clear_pass(frame.third))
+        .read(frame.second, RESOURCE_STATE_SHADER_READ)
+        .write(frame.third, RESOURCE_STATE_COLOR_ATTACHMENT);
+    graph.add_pass("composite", clear_pass(frame.swapchain))
+        .read(frame.third, RESOURCE_STATE_SHADER_READ)
+        .write(frame.swapchain, RESOURCE_STATE_COLOR_ATTACHMENT);
+    return frame;
+}
+
+static bool barrier_is(const FrameGraphBarrier& barrier, FrameGraphResource resource,
+                       ResourceState before, ResourceState after) {
+    return barrier.resource == resource && barrier.before == before && barrier.after == after;
+}
+
+static TextureHandle create_swapchain(RenderContext& context) {
+    TextureDesc desc;
+    desc.width = 256;
+    desc.height = 256;
+    desc.usage = TEXTURE_USAGE_COLOR_ATTACHMENT_BIT;
+    return context.create_texture(desc);
+}
+
+KY_TEST(frame_graph_culls_passes_nothing_reads) {
+    RenderContext context;
+    if (!KY_CHECK(context.init(RenderContextDesc()))) {
+        return;
+    }
+    TextureHandle swapchain = create_swapchain(context);
+    FrameGraph graph;
+    TestFrame frame = declare_frame(graph, swapchain);
+    if (KY_CHECK(graph.compile())) {
+        for (FrameGraphPass pass = 0; pass < graph.pass_count(); pass++) {
+            KY_CHECK(graph.pass_culled(pass) == (pass == frame.unused_pass));
+        }
+        KY_CHECK(graph.stats().culled_passes == 1);
+        KY_CHECK(graph.lifetime(frame.unused).first_pass == KY_RHI_INVALID_INDEX);
+        KY_CHECK(graph.lifetime(frame.first).first_pass == 0);
+        KY_CHECK(graph.lifetime(frame.first).last_pass == 1);
+    }
+
+    // Side effects keep the pass even though nothing reads what it writes
+    declare_frame(graph, swapchain);
+    TextureDesc desc;
+    desc.usage = TEXTURE_USAGE_COLOR_ATTACHMENT_BIT;
+    FrameGraphResource readback = graph.create_texture("readback", desc);
+    FrameGraphPass readback_pass = graph.add_pass("readback", clear_pass(readback))
+                                       .write(readback, RESOURCE_STATE_COLOR_ATTACHMENT)
+                                       .side_effects()
+                                       .pass();
+    if (KY_CHECK(graph.compile())) {
+        KY_CHECK(!graph.pass_culled(readback_pass));
+        KY_CHECK(graph.pass_culled(frame.unused_pass));
+    }
+
+    context.destroy(swapchain);
+    context.shutdown();
+}
+
+KY_TEST(frame_graph_aliases_disjoint_lifetimes) {
+    RenderContext context;
+    if (!KY_CHECK(context.init(RenderContextDesc()))) {
+        return;
+    }
+    TextureHandle swapchain = create_swapchain(context);
+    FrameGraph graph;
+    TestFrame frame = declare_frame(graph, swapchain);
+    if (KY_CHECK(graph.compile())) {
+        uint32_t first = graph.physical_resource(frame.first);
+        KY_CHECK(first != KY_RHI_INVALID_INDEX);
+        KY_CHECK(graph.physical_resource(frame.third) == first);
+        KY_CHECK(graph.physical_resource(frame.second) != first);
+        KY_CHECK(graph.physical_resource(frame.second) != KY_RHI_INVALID_INDEX);
+        KY_CHECK(graph.physical_resource(frame.unused) == KY_RHI_INVALID_INDEX);
+        KY_CHECK(graph.physical_resource(frame.swapchain) == KY_RHI_INVALID_INDEX);
+
+        const FrameGraphStats& stats = graph.stats();
+        KY_CHECK(stats.transient_resources == 3);
+        KY_CHECK(stats.physical_textures == 2);
+        KY_CHECK(stats.physical_bytes < stats.transient_bytes);
+    }
+    context.destroy(swapchain);
+    context.shutdown();
+}
+
+KY_TEST(frame_graph_derives_barriers) {
+    RenderContext context;
+    if (!KY_CHECK(context.init(RenderContextDesc()))) {
+        return;
+    }
+    TextureHandle swapchain = create_swapchain(context);
+    FrameGraph graph;
+    TestFrame frame = declare_frame(graph, swapchain);
+    if (!KY_CHECK(graph.compile())) {
+        context.destroy(swapchain);
+        context.shutdown();
+        return;
+    }
+
+    if (KY_CHECK(graph.pass_barrier_count(0) == 1)) {
+        KY_CHECK(barrier_is(graph.pass_barriers(0)[0], frame.first, RESOURCE_STATE_UNDEFINED,
+                            RESOURCE_STATE_COLOR_ATTACHMENT));
+    }
+    if (KY_CHECK(graph.pass_barrier_count(1) == 2)) {
+        const FrameGraphBarrier* barriers = graph.pass_barriers(1);
+        KY_CHECK(barrier_is(barriers[0], frame.first, RESOURCE_STATE_COLOR_ATTACHMENT,
+                            RESOURCE_STATE_SHADER_READ));
+        KY_CHECK(barrier_is(barriers[1], frame.second, RESOURCE_STATE_UNDEFINED,
+                            RESOURCE_STATE_COLOR_ATTACHMENT));
+    }
+    KY_CHECK(graph.pass_barrier_count(frame.unused_pass) == 0);
+    if (KY_CHECK(graph.pass_barrier_count(3) == 2)) {
+        const FrameGraphBarrier* barriers = graph.pass_barriers(3);
+        KY_CHECK(barrier_is(barriers[0], frame.second, RESOURCE_STATE_COLOR_ATTACHMENT,
+                            RESOURCE_STATE_SHADER_READ));
+        // The aliased texture waits on the last read of the one it replaces
+        KY_CHECK(barrier_is(barriers[1], frame.third, RESOURCE_STATE_SHADER_READ,
+                            RESOURCE_STATE_COLOR_ATTACHMENT));
+    }
+    if (KY_CHECK(graph.pass_barrier_count(4) == 2)) {
+        const FrameGraphBarrier* barriers = graph.pass_barriers(4);
+        KY_CHECK(barrier_is(barriers[0], frame.third, RESOURCE_STATE_COLOR_ATTACHMENT,
+                            RESOURCE_STATE_SHADER_READ));
+        KY_CHECK(barrier_is(barriers[1], frame.swapchain, RESOURCE_STATE_UNDEFINED,
+                            RESOURCE_STATE_COLOR_ATTACHMENT));
+    }
+    if (KY_CHECK(graph.final_barrier_count() == 1)) {
+        KY_CHECK(barrier_is(graph.final_barriers()[0], frame.swapchain,
+                            RESOURCE_STATE_COLOR_ATTACHMENT, RESOURCE_STATE_PRESENT));
+    }
+    KY_CHECK(graph.stats().barriers == 8);
+
+    context.destroy(swapchain);
+    context.shutdown();
+}
+
+KY_TEST(frame_graph_reuses_the_last_compile) {
+    RenderContext context;
+    if (!KY_CHECK(context.init(RenderContextDesc()))) {
+        return;
+    }
+    TextureHandle swapchain = create_swapchain(context);
+    FrameGraph graph;
+    declare_frame(graph, swapchain);
+    KY_CHECK(graph.compile());
+    declare_frame(graph, swapchain);
+    KY_CHECK(graph.compile());
+    KY_CHECK(graph.stats().compiles == 1);
+    KY_CHECK(graph.stats().cached_compiles == 1);
+
+    // The same graph importing another texture compiles the same, another access doesn't
+    TextureHandle other_swapchain = create_swapchain(context);
+    declare_frame(graph, other_swapchain);
+    KY_CHECK(graph.compile());
+    KY_CHECK(graph.stats().cached_compiles == 2);
+    TestFrame frame = declare_frame(graph, swapchain);
+    graph.add_pass("readback", [](const FrameGraphPassContext&) {})
+        .read(frame.second, RESOURCE_STATE_TRANSFER_SRC)
+        .side_effects();
+    KY_CHECK(graph.compile());
+    KY_CHECK(graph.stats().compiles == 2);
+    KY_CHECK(graph.stats().cached_compiles == 2);
+
+    context.destroy(other_swapchain);
+    context.destroy(swapchain);
+    context.shutdown();
+}
+
+KY_TEST(frame_graph_rejects_invalid_accesses) {
+    RenderContext context;
+    if (!KY_CHECK(context.init(RenderContextDesc()))) {
+        return;
+    }
+    TextureHandle swapchain = create_swapchain(context);
+    FrameGraph graph;
+    TestFrame frame = declare_frame(graph, swapchain);
+    graph.add_pass("both", clear_pass(frame.swapchain))
+        .read(frame.third, RESOURCE_STATE_SHADER_READ)
+        .write(frame.third, RESOURCE_STATE_COLOR_ATTACHMENT);
+    KY_CHECK(!graph.compile());
+
+    declare_frame(graph, swapchain);
+    graph.add_pass("read only", clear_pass(frame.swapchain))
+        .write(frame.swapchain, RESOURCE_STATE_SHADER_READ);
+    KY_CHECK(!graph.compile());
+
+    graph.reset();
+    graph.import_texture("missing", TextureHandle(), RESOURCE_STATE_UNDEFINED);
+    KY_CHECK(!graph.compile());
+
+    context.destroy(swapchain);
+    context.shutdown();
+}
+
+KY_TEST(frame_graph_executes_without_validation_errors) {
+    JobSystem job_system;
+    JobSystem::init(job_system, 0);
+    RenderContext context;
+    if (!KY_CHECK(context.init(RenderContextDesc()))) {
+        JobSystem::shutdown();
+        return;
+    }
+    TextureHandle swapchain = create_swapchain(context);
+    NullRenderDevice& device = static_cast<NullRenderDevice&>(context.device());
+    FrameGraph graph;
+    for (uint32_t frame = 0; frame < KY_RHI_FRAMES_IN_FLIGHT + 1; frame++) {
+        context.begin_frame();
+        declare_frame(graph, swapchain);
+        KY_CHECK(graph.execute(context));
+        KY_CHECK(device.stats().validation_errors == 0);
+        KY_CHECK(device.stats().render_passes == 4);
+        context.end_frame();
+    }
+    graph.shutdown(context);
+    context.destroy(swapchain);
+    context.shutdown();
+    JobSystem::shutdown();
+}
+
+} // namespace ky
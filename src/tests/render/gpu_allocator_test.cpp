@@ -0,0 +1,286 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "render_hardware/base/gpu_allocator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace ky {
+
+struct TestAllocation {
+    uint32_t node;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t alignment;
+    GpuAllocationKind kind;
+    uint64_t user_data;
+};
+
+// Sizes spread evenly over orders of magnitude like resources are, from constant buffers to
+// textures a sixteenth of the range
+static uint64_t random_size(std::mt19937& random, uint64_t max_size) {
+    std::uniform_real_distribution<double> exponent(0.0, std::log2((double)max_size));
+    return (uint64_t)std::exp2(exponent(random));
+}
+
+// Checks what the allocator reports against the allocations the test holds, sorting them by
+// offset on the way
+static bool check_tlsf(const TlsfAllocator& allocator, std::vector<TestAllocation>& live,
+                       uint64_t granularity) {
+    bool valid = KY_CHECK(allocator.validate());
+    std::sort(live.begin(), live.end(), [](const TestAllocation& a, const TestAllocation& b) {
+        return a.offset < b.offset;
+    });
+    uint64_t used = 0;
+    size_t index = 0;
+    allocator.for_each([&](uint32_t node, uint64_t offset, uint64_t size) {
+        valid = KY_CHECK(index < live.size()) && KY_CHECK(live[index].node == node) &&
+                KY_CHECK(live[index].offset == offset) && valid;
+        used += size;
+        index++;
+    });
+    valid = KY_CHECK(index == live.size()) && valid;
+    valid = KY_CHECK(allocator.used_bytes() == used) && valid;
+    valid = KY_CHECK(allocator.allocation_count() == live.size()) && valid;
+
+    for (size_t i = 0; i < live.size(); i++) {
+        const TestAllocation& allocation = live[i];
+        uint64_t end = allocation.offset + allocator.allocation_size(allocation.node);
+        valid = KY_CHECK(allocation.offset % allocation.alignment == 0) && valid;
+        valid = KY_CHECK(allocator.allocation_size(allocation.node) >= allocation.size) && valid;
+        valid = KY_CHECK(end <= allocator.size()) && valid;
+        valid = KY_CHECK(allocator.user_data(allocation.node) == allocation.user_data) && valid;
+        if (i + 1 < live.size()) {
+            const TestAllocation& next = live[i + 1];
+            valid = KY_CHECK(end <= next.offset) && valid;
+            // Allocations of different kinds never share a page of the granularity
+            if (next.kind != allocation.kind) {
+                valid = KY_CHECK((end - 1) / granularity < next.offset / granularity) && valid;
+            }
+        }
+    }
+    return valid;
+}
+
+KY_TEST(gpu_allocator_tlsf_random_allocations) {
+    constexpr uint64_t SIZE = 64ull * 1024 * 1024;
+    constexpr uint64_t GRANULARITY = 1024;
+    constexpr size_t OPERATIONS = 20000;
+
+    TlsfAllocator allocator;
+    allocator.init(SIZE, GRANULARITY);
+    std::mt19937 random(1234);
+    std::vector<TestAllocation> live;
+    uint64_t next_user_data = 1;
+    uint32_t failures = 0;
+    for (size_t i = 0; i < OPERATIONS; i++) {
+        // Allocates more often than it frees until the range is mostly full, then evenly
+        if (live.empty() || random() % 8 < (allocator.used_bytes() < SIZE / 2 ? 5u : 4u)) {
+            TestAllocation allocation;
+            allocation.size = random_size(random, SIZE / 16);
+            allocation.alignment = 1ull << (random() % 17);
+            allocation.kind = random() % 3 == 0 ? GPU_ALLOCATION_OPTIMAL : GPU_ALLOCATION_LINEAR;
+            allocation.user_data = next_user_data++;
+            if (allocator.allocate(allocation.size, allocation.alignment, allocation.kind,
+                                   allocation.user_data, allocation.node, allocation.offset)) {
+                live.push_back(allocation);
+            } else {
+                failures++;
+            }
+        } else {
+            size_t victim = random() % live.size();
+            allocator.free(live[victim].node);
+            live[victim] = live.back();
+            live.pop_back();
+        }
+        if (i % 500 == 0 && !check_tlsf(allocator, live, GRANULARITY)) {
+            return;
+        }
+    }
+    // The range filled up at times, so the fuzzing covered running out of space
+    KY_CHECK(failures > 0);
+    if (!check_tlsf(allocator, live, GRANULARITY)) {
+        return;
+    }
+
+    for (const TestAllocation& allocation : live) {
+        allocator.free(allocation.node);
+    }
+    KY_CHECK(allocator.validate());
+    KY_CHECK(allocator.empty());
+    TlsfStats stats = allocator.stats();
+    KY_CHECK(stats.used_bytes == 0);
+    KY_CHECK(stats.free_regions == 1);
+    KY_CHECK(stats.largest_free_region == SIZE);
+}
+
+KY_TEST(gpu_allocator_tlsf_merges_neighbours) {
+    constexpr uint64_t SIZE = 1024 * 1024;
+    constexpr uint32_t COUNT = 16;
+
+    TlsfAllocator allocator;
+    allocator.init(SIZE);
+    uint32_t nodes[COUNT];
+    for (uint32_t i = 0; i < COUNT; i++) {
+        uint64_t offset;
+        KY_CHECK(allocator.allocate(SIZE / COUNT, 1, GPU_ALLOCATION_LINEAR, 0, nodes[i], offset));
+        KY_CHECK(offset == i * SIZE / COUNT);
+    }
+    uint32_t node;
+    uint64_t offset;
+    KY_CHECK(!allocator.allocate(1, 1, GPU_ALLOCATION_LINEAR, 0, node, offset));
+    KY_CHECK(allocator.stats().free_regions == 0);
+
+    // Every other one leaves regions too small for anything larger
+    for (uint32_t i = 0; i < COUNT; i += 2) {
+        allocator.free(nodes[i]);
+    }
+    KY_CHECK(allocator.stats().free_regions == COUNT / 2);
+    KY_CHECK(allocator.stats().largest_free_region == SIZE / COUNT);
+    KY_CHECK(!allocator.allocate(SIZE / COUNT + 1, 1, GPU_ALLOCATION_LINEAR, 0, node, offset));
+
+    for (uint32_t i = 1; i < COUNT; i += 2) {
+        allocator.free(nodes[i]);
+    }
+    KY_CHECK(allocator.validate());
+    KY_CHECK(allocator.stats().free_regions == 1);
+    KY_CHECK(allocator.allocate(SIZE, 1, GPU_ALLOCATION_LINEAR, 0, node, offset));
+}
+
+struct TestBlocks {
+    uint64_t next_handle = 1;
+    uint32_t allocated = 0;
+    uint32_t freed = 0;
+};
+
+static bool test_allocate_block(void* user_data, uint32_t, uint64_t, GpuMemoryBlock& block) {
+    TestBlocks& blocks = *(TestBlocks*)user_data;
+    block.handle = blocks.next_handle++;
+    blocks.allocated++;
+    return true;
+}
+
+static void test_free_block(void* user_data, uint32_t, const GpuMemoryBlock&) {
+    ((TestBlocks*)user_data)->freed++;
+}
+
+// Allocations of the same block never overlap
+static bool check_blocks(std::vector<GpuAllocation>& live) {
+    std::sort(live.begin(), live.end(), [](const GpuAllocation& a, const GpuAllocation& b) {
+        return a.block != b.block ? a.block < b.block : a.offset < b.offset;
+    });
+    bool valid = true;
+    for (size_t i = 0; i + 1 < live.size(); i++) {
+        if (live[i].block == live[i + 1].block) {
+            valid = KY_CHECK(live[i].offset + live[i].size <= live[i + 1].offset) && valid;
+        }
+    }
+    return valid;
+}
+
+KY_TEST(gpu_allocator_blocks_random_allocations) {
+    constexpr uint64_t BLOCK_SIZE = 4 * 1024 * 1024;
+    constexpr size_t OPERATIONS = 10000;
+
+    TestBlocks blocks;
+    GpuAllocatorDesc desc;
+    desc.memory_type_count = 2;
+    desc.block_size = BLOCK_SIZE;
+    desc.granularity = 1024;
+    desc.allocate_block = test_allocate_block;
+    desc.free_block = test_free_block;
+    desc.user_data = &blocks;
+    GpuAllocator allocator;
+    if (!KY_CHECK(allocator.init(desc))) {
+        return;
+    }
+
+    std::mt19937 random(1234);
+    std::vector<GpuAllocation> live;
+    uint64_t next_id = 1;
+    for (size_t i = 0; i < OPERATIONS; i++) {
+        if (live.empty() || random() % 2 == 0) {
+            GpuAllocationDesc allocation_desc;
+            // Some exceed half a block and get a dedicated one
+            allocation_desc.size = random_size(random, BLOCK_SIZE);
+            allocation_desc.alignment = 1ull << (random() % 13);
+            allocation_desc.memory_type = random() % 2;
+            allocation_desc.kind =
+                random() % 3 == 0 ? GPU_ALLOCATION_OPTIMAL : GPU_ALLOCATION_LINEAR;
+            allocation_desc.user_data = random() % 4 != 0 ? next_id++ : 0;
+            GpuAllocation allocation;
+            if (KY_CHECK(allocator.allocate(allocation_desc, allocation))) {
+                KY_CHECK(allocation.offset % allocation_desc.alignment == 0);
+                KY_CHECK(allocation.size >= allocation_desc.size);
+                KY_CHECK(allocator.block(allocation).handle != 0);
+                live.push_back(allocation);
+            }
+        } else {
+            size_t victim = random() % live.size();
+            allocator.free(live[victim]);
+            live[victim] = live.back();
+            live.pop_back();
+        }
+        if (i % 500 == 0 && !(KY_CHECK(allocator.validate()) && check_blocks(live))) {
+            return;
+        }
+    }
+    GpuMemoryStats before = allocator.stats();
+    KY_CHECK(before.allocations == live.size());
+
+    // Moves relocatable allocations and frees the sources, like a backend once the copies ran
+    TaggedVector<GpuDefragmentationMove, MEMORY_TAG_RENDER> moves;
+    uint32_t moved = 0;
+    while (allocator.defragment(16, BLOCK_SIZE, moves) > 0) {
+        for (const GpuDefragmentationMove& move : moves) {
+            KY_CHECK(move.user_data != 0);
+            KY_CHECK(move.destination.size == move.source.size);
+            for (GpuAllocation& allocation : live) {
+                if (allocation.block == move.source.block &&
+                    allocation.offset == move.source.offset) {
+                    allocator.free(allocation);
+                    allocation = move.destination;
+                    break;
+                }
+            }
+        }
+        moved += (uint32_t)moves.size();
+        if (!(KY_CHECK(allocator.validate()) && check_blocks(live))) {
+            return;
+        }
+    }
+    GpuMemoryStats after = allocator.stats();
+    KY_CHECK(after.allocations == live.size());
+    KY_CHECK(after.used_bytes == before.used_bytes);
+    KY_CHECK(moved == 0 || after.blocks <= before.blocks);
+
+    for (const GpuAllocation& allocation : live) {
+        allocator.free(allocation);
+    }
+    GpuMemoryStats empty = allocator.stats();
+    KY_CHECK(allocator.validate());
+    KY_CHECK(empty.allocations == 0);
+    KY_CHECK(empty.used_bytes == 0);
+    KY_CHECK(empty.dedicated_blocks == 0);
+    allocator.shutdown();
+    KY_CHECK(blocks.allocated > 0);
+    KY_CHECK(blocks.freed == blocks.allocated);
+}
+
+} // namespace ky
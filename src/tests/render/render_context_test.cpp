@@ -0,0 +1,250 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "render_hardware/base/context.h"
+#include "render_hardware/null/null_device.h"
+
+#include <cstring>
+
+namespace ky {
+
+// Smallest module passing the SPIR-V checks, the null backend never compiles it
+static const uint32_t TEST_SPIRV[] = {0x07230203, 0x00010000, 0, 1, 0};
+
+struct TestScene {
+    TextureHandle target;
+    BufferHandle vertices;
+    ShaderHandle vertex_shader;
+    ShaderHandle fragment_shader;
+    PipelineHandle pipeline;
+};
+
+static TestScene create_scene(RenderContext& context) {
+    TestScene scene;
+    TextureDesc target_desc;
+    target_desc.width = 64;
+    target_desc.height = 64;
+    target_desc.usage = TEXTURE_USAGE_COLOR_ATTACHMENT_BIT;
+    scene.target = context.create_texture(target_desc);
+
+    BufferDesc vertices_desc;
+    vertices_desc.size = 3 * sizeof(float) * 3;
+    vertices_desc.usage = BUFFER_USAGE_VERTEX_BIT;
+    scene.vertices = context.create_buffer(vertices_desc);
+
+    ShaderDesc shader_desc;
+    shader_desc.code = TEST_SPIRV;
+    shader_desc.code_size = sizeof(TEST_SPIRV);
+    scene.vertex_shader = context.create_shader(shader_desc);
+    shader_desc.stage = SHADER_STAGE_FRAGMENT;
+    scene.fragment_shader = context.create_shader(shader_desc);
+
+    PipelineDesc pipeline_desc;
+    pipeline_desc.vertex_shader = scene.vertex_shader;
+    pipeline_desc.fragment_shader = scene.fragment_shader;
+    pipeline_desc.vertex_bindings[0].stride = sizeof(float) * 3;
+    pipeline_desc.vertex_binding_count = 1;
+    pipeline_desc.vertex_attribute_count = 1;
+    pipeline_desc.color_formats[0] = target_desc.format;
+    pipeline_desc.color_count = 1;
+    scene.pipeline = context.create_pipeline(pipeline_desc);
+    return scene;
+}
+
+static void destroy_scene(RenderContext& context, const TestScene& scene) {
+    context.destroy(scene.pipeline);
+    context.destroy(scene.fragment_shader);
+    context.destroy(scene.vertex_shader);
+    context.destroy(scene.vertices);
+    context.destroy(scene.target);
+}
+
+static RenderPassDesc scene_pass(const TestScene& scene) {
+    RenderPassDesc pass;
+    pass.colors[0].texture = scene.target;
+    pass.color_count = 1;
+    return pass;
+}
+
+// Submits one list in a frame of its own and returns the validation errors it caused
+template <typename _Record>
+static uint32_t submit_frame(RenderContext& context, _Record&& record) {
+    context.begin_frame();
+    CommandList* list = context.command_list();
+    record(*list);
+    context.submit(list);
+    uint32_t errors = static_cast<NullRenderDevice&>(context.device()).stats().validation_errors;
+    context.end_frame();
+    return errors;
+}
+
+KY_TEST(render_context_null_backend_is_the_default) {
+    RenderContextDesc desc;
+    KY_CHECK(desc.backend == RENDER_BACKEND_NULL);
+}
+
+KY_TEST(render_context_valid_pass_passes_validation) {
+    RenderContext context;
+    if (!KY_CHECK(context.init(RenderContextDesc()))) {
+        return;
+    }
+    TestScene scene = create_scene(context);
+    KY_CHECK(context.alive(scene.pipeline));
+
+    context.begin_frame();
+    CommandList* list = context.command_list();
+    list->barrier(TextureBarrier {scene.target, RESOURCE_STATE_UNDEFINED,
+                                  RESOURCE_STATE_COLOR_ATTACHMENT});
+    list->begin_render_pass(scene_pass(scene));
+    list->bind_pipeline(scene.pipeline);
+    list->bind_vertex_buffer(0, scene.vertices);
+    for (uint32_t i = 0; i < 16; i++) {
+        list->draw(3, 2);
+    }
+    list->end_render_pass();
+    context.submit(list);
+    const NullRenderStats& stats = static_cast<NullRenderDevice&>(context.device()).stats();
+    KY_CHECK(stats.validation_errors == 0);
+    KY_CHECK(stats.render_passes == 1);
+    KY_CHECK(stats.draws == 16);
+    KY_CHECK(stats.instances == 32);
+    context.end_frame();
+
+    destroy_scene(context, scene);
+    context.shutdown();
+}
+
+KY_TEST(render_context_invalid_commands_fail_validation) {
+    RenderContext context;
+    if (!KY_CHECK(context.init(RenderContextDesc()))) {
+        return;
+    }
+    TestScene scene = create_scene(context);
+    RenderPassDesc pass = scene_pass(scene);
+    TextureBarrier to_attachment = {scene.target, RESOURCE_STATE_UNDEFINED,
+                                    RESOURCE_STATE_COLOR_ATTACHMENT};
+
+    KY_CHECK(submit_frame(context, [&](CommandList& list) {
+                 list.bind_pipeline(scene.pipeline);
+                 list.bind_vertex_buffer(0, scene.vertices);
+                 list.draw(3);
+             }) > 0);
+    KY_CHECK(submit_frame(context, [&](CommandList& list) {
+                 list.barrier(to_attachment);
+                 list.begin_render_pass(pass);
+                 list.bind_vertex_buffer(0, scene.vertices);
+                 list.draw(3);
+                 list.end_render_pass();
+             }) > 0);
+    KY_CHECK(submit_frame(context, [&](CommandList& list) {
+                 list.barrier(to_attachment);
+                 list.begin_render_pass(pass);
+                 list.bind_pipeline(scene.pipeline);
+                 list.draw(3);
+                 list.end_render_pass();
+             }) > 0);
+    KY_CHECK(submit_frame(context, [&](CommandList& list) {
+                 list.barrier(to_attachment);
+                 list.begin_render_pass(pass);
+             }) > 0);
+    // The attachment has to be transitioned before the pass
+    KY_CHECK(submit_frame(context, [&](CommandList& list) {
+                 list.barrier(TextureBarrier {scene.target, RESOURCE_STATE_UNDEFINED,
+                                              RESOURCE_STATE_SHADER_READ});
+                 list.begin_render_pass(pass);
+                 list.end_render_pass();
+             }) > 0);
+
+    destroy_scene(context, scene);
+    context.shutdown();
+}
+
+KY_TEST(render_context_destruction_is_deferred) {
+    RenderContext context;
+    if (!KY_CHECK(context.init(RenderContextDesc()))) {
+        return;
+    }
+    BufferDesc desc;
+    desc.size = 256;
+    desc.usage = BUFFER_USAGE_STORAGE_BIT;
+    BufferHandle buffer = context.create_buffer(desc);
+    KY_CHECK(context.alive(buffer));
+    KY_CHECK(context.usable(buffer));
+
+    context.begin_frame();
+    context.destroy(buffer);
+    // Lists of this frame may still use it
+    KY_CHECK(!context.alive(buffer));
+    KY_CHECK(context.usable(buffer));
+    context.end_frame();
+    for (uint32_t i = 1; i < KY_RHI_FRAMES_IN_FLIGHT; i++) {
+        context.begin_frame();
+        KY_CHECK(context.usable(buffer));
+        context.end_frame();
+    }
+    context.begin_frame();
+    KY_CHECK(!context.usable(buffer));
+    context.end_frame();
+
+    // The slot is reused with a new generation, the old handle stays dead
+    BufferHandle reused = context.create_buffer(desc);
+    KY_CHECK(reused.index == buffer.index);
+    KY_CHECK(reused.generation != buffer.generation);
+    KY_CHECK(context.alive(reused));
+    KY_CHECK(!context.alive(buffer));
+
+    uint32_t errors = submit_frame(context, [&](CommandList& list) {
+        list.copy_buffer(reused, 0, buffer, 0, 16);
+    });
+    KY_CHECK(errors > 0);
+
+    context.destroy(reused);
+    context.shutdown();
+}
+
+KY_TEST(render_context_buffer_copies_execute_on_the_host) {
+    RenderContext context;
+    if (!KY_CHECK(context.init(RenderContextDesc()))) {
+        return;
+    }
+    uint8_t data[64];
+    for (uint32_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)i;
+    }
+    BufferDesc desc;
+    desc.size = sizeof(data);
+    desc.usage = BUFFER_USAGE_TRANSFER_SRC_BIT | BUFFER_USAGE_TRANSFER_DST_BIT;
+    BufferHandle source = context.create_buffer(desc, data);
+    BufferHandle destination = context.create_buffer(desc);
+
+    KY_CHECK(submit_frame(context, [&](CommandList& list) {
+                 list.copy_buffer(source, 16, destination, 0, 32);
+             }) == 0);
+    NullRenderDevice& device = static_cast<NullRenderDevice&>(context.device());
+    KY_CHECK(std::memcmp(device.buffer_data(destination.index), data + 16, 32) == 0);
+
+    // Out of range copies are rejected and leave the destination alone
+    KY_CHECK(submit_frame(context, [&](CommandList& list) {
+                 list.copy_buffer(source, 48, destination, 0, 32);
+             }) > 0);
+    KY_CHECK(std::memcmp(device.buffer_data(destination.index), data + 16, 32) == 0);
+
+    context.destroy(source);
+    context.destroy(destination);
+    context.shutdown();
+}
+
+} // namespace ky
@@ -0,0 +1,259 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "render_hardware/base/context.h"
+#include "render_hardware/base/shader_cache.h"
+#include "render_hardware/null/null_device.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+namespace ky {
+
+// Stands in for a compiler, emits an empty `main` of the requested stage and counts its calls
+static bool test_compile(void* user_data, const ShaderSource& source,
+                         TaggedVector<uint32_t, MEMORY_TAG_RENDER>& spirv, std::string&) {
+    (*(uint32_t*)user_data)++;
+    auto op = [](uint32_t word_count, uint32_t opcode) { return word_count << 16 | opcode; };
+    uint32_t model = source.stage == SHADER_STAGE_FRAGMENT ? 4 : 0;
+    spirv = {
+        0x07230203, 0x00010000, 0, 5, 0,
+        op(2, 17), 1,                               // Capability Shader
+        op(3, 14), 0, 1,                            // MemoryModel Logical GLSL450
+        op(5, 15), model, 1, 0x6e69616d, 0,         // EntryPoint "main"
+        op(2, 19), 2,                               // TypeVoid
+        op(3, 33), 3, 2,                            // TypeFunction
+        op(5, 54), 2, 1, 0, 3,                      // Function main
+        op(2, 248), 4,                              // Label
+        op(1, 253),                                 // Return
+        op(1, 56),                                  // FunctionEnd
+    };
+    return true;
+}
+
+struct TestDirectory {
+    std::filesystem::path path;
+
+    TestDirectory(const char* name) : path(std::filesystem::temp_directory_path() / name) {
+        std::filesystem::remove_all(path);
+    }
+    ~TestDirectory() { std::filesystem::remove_all(path); }
+};
+
+KY_TEST(shader_cache_hits_memory_then_disk) {
+    TestDirectory directory("kryos_shader_cache_test_hits");
+    std::string path = directory.path.string();
+    uint32_t compiles = 0;
+    ShaderCacheDesc desc;
+    desc.directory = path.c_str();
+    desc.compile = test_compile;
+    desc.user_data = &compiles;
+    desc.compiler_version = "test 1";
+    ShaderCache cache;
+    if (!KY_CHECK(cache.init(desc))) {
+        return;
+    }
+
+    ShaderSource source;
+    source.stage = SHADER_STAGE_FRAGMENT;
+    source.code = "void main() {}";
+    const CachedShader* compiled = cache.get(source);
+    KY_CHECK(compiled != nullptr);
+    KY_CHECK(cache.get(source) == compiled);
+    KY_CHECK(std::filesystem::exists(cache.file_path(cache.key(source))));
+
+    cache.clear_memory();
+    const CachedShader* loaded = cache.get(source);
+    if (KY_CHECK(loaded != nullptr)) {
+        KY_CHECK(loaded->reflection.stage == SHADER_STAGE_FRAGMENT);
+        KY_CHECK(loaded->entry_point == "main");
+    }
+    // A new cache on the same directory loads the module without compiling it
+    cache.init(desc);
+    KY_CHECK(cache.get(source) != nullptr);
+
+    ShaderCacheStats stats = cache.stats();
+    KY_CHECK(compiles == 1);
+    KY_CHECK(stats.compiles == 0);
+    KY_CHECK(stats.disk_hits == 1);
+    cache.shutdown();
+}
+
+KY_TEST(shader_cache_key_covers_every_input) {
+    uint32_t compiles = 0;
+    ShaderCacheDesc desc;
+    desc.compile = test_compile;
+    desc.user_data = &compiles;
+    desc.compiler_version = "test 1";
+    ShaderCache cache;
+    if (!KY_CHECK(cache.init(desc))) {
+        return;
+    }
+
+    ShaderDefine define = {"QUALITY", "1"};
+    ShaderSource source;
+    source.code = "void main() {}";
+    source.path = "a.vert";
+    source.defines = &define;
+    source.define_count = 1;
+    uint64_t key = cache.key(source);
+
+    ShaderSource renamed = source;
+    renamed.path = "b.vert";
+    KY_CHECK(cache.key(renamed) == key);
+
+    ShaderDefine other_define = {"QUALITY", "2"};
+    ShaderSource changed = source;
+    changed.defines = &other_define;
+    KY_CHECK(cache.key(changed) != key);
+    changed = source;
+    changed.define_count = 0;
+    KY_CHECK(cache.key(changed) != key);
+    changed = source;
+    changed.code = "void main() { }";
+    KY_CHECK(cache.key(changed) != key);
+    changed = source;
+    changed.stage = SHADER_STAGE_FRAGMENT;
+    KY_CHECK(cache.key(changed) != key);
+    changed = source;
+    changed.entry_point = "vertex_main";
+    KY_CHECK(cache.key(changed) != key);
+    changed = source;
+    changed.dependency_hash = 1;
+    KY_CHECK(cache.key(changed) != key);
+
+    // A changed include recompiles instead of hitting the module cached in memory
+    cache.get(source);
+    cache.get(changed);
+    KY_CHECK(compiles == 2);
+
+    desc.compiler_version = "test 2";
+    ShaderCache other_compiler;
+    other_compiler.init(desc);
+    KY_CHECK(other_compiler.key(source) != key);
+    other_compiler.shutdown();
+    cache.shutdown();
+}
+
+KY_TEST(shader_cache_replaces_invalid_files) {
+    TestDirectory directory("kryos_shader_cache_test_invalid");
+    std::string path = directory.path.string();
+    uint32_t compiles = 0;
+    ShaderCacheDesc desc;
+    desc.directory = path.c_str();
+    desc.compile = test_compile;
+    desc.user_data = &compiles;
+    ShaderCache cache;
+    if (!KY_CHECK(cache.init(desc))) {
+        return;
+    }
+
+    ShaderSource source;
+    source.code = "void main() {}";
+    cache.get(source);
+    cache.clear_memory();
+    std::string file_path = cache.file_path(cache.key(source));
+    FILE* file = fopen(file_path.c_str(), "r+b");
+    if (!KY_CHECK(file != nullptr)) {
+        return;
+    }
+    // Flips a byte of the stored code, the header still matches the key
+    fseek(file, -4, SEEK_END);
+    fputc(0xff, file);
+    fclose(file);
+
+    KY_CHECK(cache.get(source) != nullptr);
+    ShaderCacheStats stats = cache.stats();
+    KY_CHECK(stats.invalid_files == 1);
+    KY_CHECK(stats.compiles == 2);
+    KY_CHECK(stats.disk_hits == 0);
+
+    // The recompiled module replaced the file
+    cache.clear_memory();
+    KY_CHECK(cache.get(source) != nullptr);
+    KY_CHECK(cache.stats().disk_hits == 1);
+    KY_CHECK(compiles == 2);
+    cache.shutdown();
+}
+
+KY_TEST(shader_cache_pipeline_file_checks_its_device) {
+    TestDirectory directory("kryos_shader_cache_test_pipelines");
+    std::filesystem::create_directories(directory.path);
+    std::string path = (directory.path / "pipelines.kypc").string();
+    const uint64_t blob[] = {1, 2, 3};
+    if (!KY_CHECK(write_pipeline_cache_file(path.c_str(), RENDER_BACKEND_NULL, 7, blob,
+                                            sizeof(blob)))) {
+        return;
+    }
+
+    TaggedVector<uint8_t, MEMORY_TAG_RENDER> data;
+    KY_CHECK(read_pipeline_cache_file(path.c_str(), RENDER_BACKEND_NULL, 7, data));
+    KY_CHECK(data.size() == sizeof(blob));
+    KY_CHECK(!read_pipeline_cache_file(path.c_str(), RENDER_BACKEND_NULL, 8, data));
+    KY_CHECK(!read_pipeline_cache_file(path.c_str(), RENDER_BACKEND_VULKAN, 7, data));
+    std::string missing = (directory.path / "missing.kypc").string();
+    KY_CHECK(!read_pipeline_cache_file(missing.c_str(), RENDER_BACKEND_NULL, 7, data));
+}
+
+// Creates the same pipeline on a new null backend context and returns its pipeline cache hits
+static uint32_t create_cached_pipeline(const char* pipeline_cache_path,
+                                       const CachedShader& vertex, const CachedShader& fragment) {
+    RenderContext context;
+    RenderContextDesc context_desc;
+    context_desc.pipeline_cache_path = pipeline_cache_path;
+    if (!context.init(context_desc)) {
+        return 0;
+    }
+    ShaderHandle vertex_shader = context.create_shader(vertex.desc());
+    ShaderHandle fragment_shader = context.create_shader(fragment.desc());
+    PipelineDesc pipeline_desc;
+    pipeline_desc.vertex_shader = vertex_shader;
+    pipeline_desc.fragment_shader = fragment_shader;
+    pipeline_desc.color_count = 1;
+    context.destroy(context.create_pipeline(pipeline_desc));
+    context.destroy(fragment_shader);
+    context.destroy(vertex_shader);
+    uint32_t hits = static_cast<NullRenderDevice&>(context.device()).pipeline_cache_hits();
+    context.shutdown();
+    return hits;
+}
+
+KY_TEST(shader_cache_pipelines_hit_the_saved_cache) {
+    TestDirectory directory("kryos_shader_cache_test_null");
+    std::filesystem::create_directories(directory.path);
+    std::string path = (directory.path / "pipelines.kypc").string();
+    uint32_t compiles = 0;
+    ShaderCacheDesc desc;
+    desc.compile = test_compile;
+    desc.user_data = &compiles;
+    ShaderCache cache;
+    if (!KY_CHECK(cache.init(desc))) {
+        return;
+    }
+    ShaderSource source;
+    source.code = "void main() {}";
+    const CachedShader* vertex = cache.get(source);
+    source.stage = SHADER_STAGE_FRAGMENT;
+    const CachedShader* fragment = cache.get(source);
+    if (KY_CHECK(vertex != nullptr && fragment != nullptr)) {
+        KY_CHECK(create_cached_pipeline(path.c_str(), *vertex, *fragment) == 0);
+        KY_CHECK(create_cached_pipeline(path.c_str(), *vertex, *fragment) == 1);
+    }
+    cache.shutdown();
+}
+
+} // namespace ky
@@ -0,0 +1,43 @@
+// This file is part of Kryos Engine (https://github.com/Oniup/kryos-engine)
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYOS_TESTS__TEST_H
+#define KRYOS_TESTS__TEST_H
+
+// Defines a test function which is registered before `main` and run by the tests executable.
+// Pass a name prefix on the command line to only run matching tests, CTest runs the tests of
+// each `<name>_test.cpp` file on their own by passing `<name>`, so test names start with it.
+#define KY_TEST(_name)                                                            \
+    static void _name();                                                          \
+    static const int _name##_registered = ky::test::register_test(#_name, _name); \
+    static void _name()
+
+// Fails the running test when `_condition` is false and keeps going, evaluates to the condition
+// so dependent checks can be skipped.
+#define KY_CHECK(_condition) ky::test::check((_condition), #_condition, __FILE__, __LINE__)
+
+namespace ky {
+namespace test {
+
+    using TestFunction = void (*)();
+
+    int register_test(const char* name, TestFunction function);
+
+    bool check(bool condition, const char* expression, const char* file, int line);
+
+} // namespace test
+} // namespace ky
+
+#endif